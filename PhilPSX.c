@@ -6,39 +6,82 @@
  * PhilPSX.c - Copyright Phillip Potter, 2020, under GPLv3
  */
 
-/* Included for profiling purposes*/
+/* Included for timing purposes*/
 #define _POSIX_C_SOURCE 200809L
 #include <time.h>
-#include <gperftools/profiler.h>
 
 #include <pthread.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <SDL2/SDL.h>
+#include "headers/AudioOutput.h"
+#include "headers/CommandChannel.h"
+#include "headers/Console_all.h"
 #include "headers/WorkQueue.h"
 #include "headers/GpuCommand.h"
+#include "headers/PerfCounters.h"
+#include "headers/RewindBuffer.h"
+#include "headers/SaveState.h"
+#include "headers/TraceEvents.h"
 #include "headers/R3051.h"
+#include "headers/R3051Debugger.h"
 #include "headers/GPU.h"
+#include "headers/GteBench.h"
+#include "headers/RegressionRunner.h"
 #include "headers/SPU.h"
 #include "headers/CDROMDrive.h"
+#include "headers/MDEC.h"
 #include "headers/DMAArbiter.h"
 #include "headers/ControllerIO.h"
 #include "headers/SystemInterlink.h"
 
+// Number of stereo frames passed from the SPU to the audio output at a time
+#define PHILPSX_AUDIO_CHUNK_FRAMES 1024
+
+// Most frames the emulator can be asked to run ahead by
+#define PHILPSX_MAX_RUN_AHEAD_FRAMES 4
+
+// Number of frames between the save states kept for rewinding
+#define PHILPSX_REWIND_INTERVAL 6
+
+// Number of the hottest blocks printed when profiling
+#define PHILPSX_PROFILE_HOT_BLOCKS 20
+
+// Commands passed to the emulator thread, and how many can be waiting
+#define PHILPSX_COMMAND_QUIT 0
+#define PHILPSX_COMMAND_SAVE_STATE 1
+#define PHILPSX_COMMAND_LOAD_STATE 2
+#define PHILPSX_COMMAND_REWIND_PRESS 3
+#define PHILPSX_COMMAND_REWIND_RELEASE 4
+#define PHILPSX_COMMAND_DEBUG 5
+#define PHILPSX_COMMAND_CHANNEL_CAPACITY 64
+
 /*
- * This struct stores references to all emulated components.
+ * This table maps keys on the keyboard to buttons of the pad in the first
+ * port.
  */
-typedef struct {
-	R3051 *cpu;
-	GPU *gpu;
-	SPU *spu;
-	CDROMDrive *cdrom;
-	DMAArbiter *dma;
-	ControllerIO *cio;
-	SystemInterlink *smi;
-} Console;
+static const struct {
+	SDL_Keycode key;
+	uint16_t button;
+} padKeys[] = {
+	{SDLK_UP, PHILPSX_CONSOLE_BUTTON_UP},
+	{SDLK_DOWN, PHILPSX_CONSOLE_BUTTON_DOWN},
+	{SDLK_LEFT, PHILPSX_CONSOLE_BUTTON_LEFT},
+	{SDLK_RIGHT, PHILPSX_CONSOLE_BUTTON_RIGHT},
+	{SDLK_z, PHILPSX_CONSOLE_BUTTON_CROSS},
+	{SDLK_x, PHILPSX_CONSOLE_BUTTON_CIRCLE},
+	{SDLK_a, PHILPSX_CONSOLE_BUTTON_SQUARE},
+	{SDLK_s, PHILPSX_CONSOLE_BUTTON_TRIANGLE},
+	{SDLK_q, PHILPSX_CONSOLE_BUTTON_L1},
+	{SDLK_w, PHILPSX_CONSOLE_BUTTON_R1},
+	{SDLK_1, PHILPSX_CONSOLE_BUTTON_L2},
+	{SDLK_2, PHILPSX_CONSOLE_BUTTON_R2},
+	{SDLK_RETURN, PHILPSX_CONSOLE_BUTTON_START},
+	{SDLK_RSHIFT, PHILPSX_CONSOLE_BUTTON_SELECT}
+};
 
 /*
  * This struct stores refences to SDL objects.
@@ -52,18 +95,46 @@ typedef struct {
 	Console *console;
 	SDLState *sdl;
 	WorkQueue *wq;
+	AudioOutput *audio;
+	bool audioSync;
 	pthread_mutex_t quitMutex;
 	bool quitBool;
 	pthread_t renderingThread;
 	pthread_t emulatorThread;
+	int64_t frameLimit;
+	int64_t cycleLimit;
+	bool bench;
+	const char *replayPath;
+	bool replaySerialise;
+	const char *statePath;
+	int32_t runAheadFrames;
+	int64_t rewindBudget;
+	bool debug;
+	const char *profilePath;
+	const char *symbolsPath;
+	const char *tracePath;
+	CommandChannel *commands;
+	char perfSummary[160];
 } EmulatorState;
 
 // Forward declarations for functions related to setup/cleanup of emulator:
 static bool setupEmu(Console *console, int numOfArgs, char **args,
-		WorkQueue *wq, SDL_Window *window);
-static void cleanupEmu(Console *console);
+		WorkQueue *wq, SDL_Window *window, int32_t rendererMode);
+static bool setupReplay(Console *console, WorkQueue *wq, SDL_Window *window,
+		int32_t rendererMode);
+static void cleanupReplay(Console *console, int32_t rendererMode);
 static void *renderingFunction(void *arg);
 static void *emulatorFunction(void *arg);
+static void *replayFunction(void *arg);
+static void *debugInputFunction(void *arg);
+static void sendCommand(EmulatorState *es, int32_t type, int32_t argument0,
+		int32_t argument1, int32_t argument2);
+static bool runAhead(Console *console, SaveState *state, int32_t frames,
+		int16_t *samples);
+static void printBenchResults(Console *console, int64_t frames,
+		int64_t cycles, int64_t hostNanoseconds);
+static void showPerfCounters(EmulatorState *es, int64_t *lastValues);
+static uint16_t getPadButton(SDL_Keycode key);
 static bool setupSDL(void);
 
 // PhilPSX entry point
@@ -76,6 +147,270 @@ int main(int argc, char **argv)
 	int retval = 0;
 	EmulatorState es;
 	
+	// Check and time the GTE on its own if asked to, in place of emulating
+	// the console - this needs neither SDL nor a BIOS
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 9 && strncmp(argv[i], "-gtebench", 9) == 0) {
+			retval = GteBench_run(true) ? 0 : 1;
+			goto end;
+		}
+	}
+	
+	// Run a regression manifest in headless consoles if asked to, again in
+	// place of emulating the console here
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 8 && strncmp(argv[i], "-regress", 8) == 0) {
+			if (i + 1 >= argc) {
+				fprintf(stderr, "PhilPSX: -regress needs a manifest\n");
+				retval = 1;
+				goto end;
+			}
+			int32_t jobCount = 0;
+			for (int j = 1; j < argc; ++j) {
+				if (strlen(argv[j]) == 5 && strncmp(argv[j], "-jobs", 5) == 0 &&
+						j + 1 < argc)
+					jobCount = (int32_t)strtol(argv[j + 1], NULL, 10);
+			}
+			retval = RegressionRunner_run(argv[i + 1], jobCount) ? 0 : 1;
+			goto end;
+		}
+	}
+	
+	// Parse renderer from command line arguments, as this decides how the
+	// window is set up
+	int32_t rendererMode = PHILPSX_GPU_RENDERER_OPENGL;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 9 && strncmp(argv[i], "-renderer", 9) == 0) {
+			if (i + 1 < argc) {
+				if (strlen(argv[i + 1]) == 4 &&
+						strncmp(argv[i + 1], "soft", 4) == 0) {
+					rendererMode = PHILPSX_GPU_RENDERER_SOFTWARE;
+				} else if (!(strlen(argv[i + 1]) == 6 &&
+						strncmp(argv[i + 1], "opengl", 6) == 0)) {
+					fprintf(stderr, "PhilPSX: Unknown renderer %s\n",
+							argv[i + 1]);
+					retval = 1;
+					goto end;
+				}
+				break;
+			}
+		}
+	}
+	
+	// Parse run mode from command line arguments - turbo mode runs without
+	// waiting for the vertical retrace, and headless mode also hides the
+	// window and skips showing frames altogether
+	bool turbo = false;
+	bool headless = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 6 && strncmp(argv[i], "-turbo", 6) == 0)
+			turbo = true;
+		if (strlen(argv[i]) == 9 && strncmp(argv[i], "-headless", 9) == 0) {
+			turbo = true;
+			headless = true;
+		}
+	}
+	
+	// Parse benchmark mode from command line arguments - this runs headless
+	// for a fixed number of frames, with nothing that depends on host timing
+	// (pacing, frame skipping, audio, run-ahead or rewinding) able to change
+	// what is emulated, then prints the results as JSON
+	es.bench = false;
+	int64_t benchFrames = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 6 && strncmp(argv[i], "-bench", 6) == 0) {
+			if (i + 1 < argc) {
+				benchFrames = strtoll(argv[i + 1], NULL, 10);
+				if (benchFrames <= 0) {
+					fprintf(stderr, "PhilPSX: Benchmark must run for at "
+							"least one frame\n");
+					retval = 1;
+					goto end;
+				}
+				es.bench = true;
+				turbo = true;
+				headless = true;
+				break;
+			}
+		}
+	}
+	
+	// Parse frame and cycle limits from command line arguments, which end
+	// the run once either is reached
+	es.frameLimit = 0;
+	es.cycleLimit = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 7 && strncmp(argv[i], "-frames", 7) == 0) {
+			if (i + 1 < argc) {
+				es.frameLimit = strtoll(argv[i + 1], NULL, 10);
+				break;
+			}
+		}
+	}
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 7 && strncmp(argv[i], "-cycles", 7) == 0) {
+			if (i + 1 < argc) {
+				es.cycleLimit = strtoll(argv[i + 1], NULL, 10);
+				break;
+			}
+		}
+	}
+	if (es.bench) {
+		es.frameLimit = benchFrames;
+		es.cycleLimit = 0;
+	}
+	
+	// Parse GPU trace replay from command line arguments - in place of
+	// emulating the console, this replays a trace recorded with -gputrace
+	// on the GPU alone as fast as it can, and with -gpuprofile also times
+	// each command
+	es.replayPath = NULL;
+	es.replaySerialise = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 10 && strncmp(argv[i], "-gpureplay", 10) == 0) {
+			if (i + 1 < argc) {
+				es.replayPath = argv[i + 1];
+				break;
+			}
+		}
+	}
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 11 && strncmp(argv[i], "-gpuprofile", 11) == 0)
+			es.replaySerialise = true;
+	}
+	if (es.replayPath)
+		turbo = true;
+	
+	// Parse sync source from command line arguments - by default emulation
+	// is paced by the vertical retrace, but it can be paced by the audio
+	// device instead, which keeps sound free of gaps on displays that don't
+	// refresh at the console's own rate
+	es.audioSync = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 5 && strncmp(argv[i], "-sync", 5) == 0) {
+			if (i + 1 < argc) {
+				if (strlen(argv[i + 1]) == 5 &&
+						strncmp(argv[i + 1], "audio", 5) == 0) {
+					es.audioSync = true;
+				} else if (!(strlen(argv[i + 1]) == 5 &&
+						strncmp(argv[i + 1], "vsync", 5) == 0)) {
+					fprintf(stderr, "PhilPSX: Unknown sync source %s\n",
+							argv[i + 1]);
+					retval = 1;
+					goto end;
+				}
+				break;
+			}
+		}
+	}
+	if (turbo)
+		es.audioSync = false;
+	
+	// Parse save state file from command line arguments - F5 saves the
+	// console's state to it and F7 loads it back
+	es.statePath = "philpsx.state";
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 6 && strncmp(argv[i], "-state", 6) == 0) {
+			if (i + 1 < argc) {
+				es.statePath = argv[i + 1];
+				break;
+			}
+		}
+	}
+	
+	// Parse run-ahead from command line arguments - each frame, the
+	// emulator runs this many frames further on and shows the last of them,
+	// then rolls back, hiding that many frames of latency between input and
+	// the screen. There is nothing to gain from it when frames aren't shown
+	es.runAheadFrames = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 9 && strncmp(argv[i], "-runahead", 9) == 0) {
+			if (i + 1 < argc) {
+				es.runAheadFrames = (int32_t)strtol(argv[i + 1], NULL, 10);
+				if (es.runAheadFrames < 0 ||
+						es.runAheadFrames > PHILPSX_MAX_RUN_AHEAD_FRAMES) {
+					fprintf(stderr, "PhilPSX: Run-ahead must be between 0 "
+							"and %d frames\n", PHILPSX_MAX_RUN_AHEAD_FRAMES);
+					retval = 1;
+					goto end;
+				}
+				break;
+			}
+		}
+	}
+	if (headless || es.replayPath)
+		es.runAheadFrames = 0;
+	
+	// Parse debugger from command line arguments - this attaches the
+	// debugger with the console stopped before its first instruction, and
+	// reads debugger commands typed into the command prompt. Run-ahead is
+	// turned off, as it would hit breakpoints in frames that get rolled back
+	es.debug = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 6 && strncmp(argv[i], "-debug", 6) == 0)
+			es.debug = true;
+	}
+	if (es.replayPath)
+		es.debug = false;
+	if (es.debug)
+		es.runAheadFrames = 0;
+	
+	// Parse profile output and symbol map files from command line
+	// arguments - the profiler counts the cycles spent in each block of
+	// code and samples their callers, which are written to the output file
+	// as folded stacks on exit, named from the symbol map if given.
+	// Run-ahead is turned off, so that frames rolled back aren't counted
+	es.profilePath = NULL;
+	es.symbolsPath = NULL;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 8 && strncmp(argv[i], "-profile", 8) == 0) {
+			if (i + 1 < argc)
+				es.profilePath = argv[i + 1];
+		} else if (strlen(argv[i]) == 8 &&
+				strncmp(argv[i], "-symbols", 8) == 0) {
+			if (i + 1 < argc)
+				es.symbolsPath = argv[i + 1];
+		}
+	}
+	if (es.replayPath)
+		es.profilePath = NULL;
+	if (es.profilePath)
+		es.runAheadFrames = 0;
+	
+	// Parse trace file from command line arguments - when trace events are
+	// built in, how long each thread spends on what is recorded while the
+	// emulator runs and written to it as a Chrome trace on exit
+	es.tracePath = NULL;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 6 && strncmp(argv[i], "-trace", 6) == 0) {
+			if (i + 1 < argc) {
+				es.tracePath = argv[i + 1];
+				break;
+			}
+		}
+	}
+	if (es.tracePath && !TraceEvents_isEnabled()) {
+		fprintf(stderr, "PhilPSX: Trace events aren't built in, rebuild "
+				"with -DPHILPSX_TRACE_EVENTS to use -trace\n");
+		es.tracePath = NULL;
+	}
+	
+	// Parse rewind buffer size in MB from command line arguments - when
+	// given, a save state is kept every few frames within that much memory,
+	// and holding backspace steps back through them
+	es.rewindBudget = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 7 && strncmp(argv[i], "-rewind", 7) == 0) {
+			if (i + 1 < argc) {
+				es.rewindBudget = strtoll(argv[i + 1], NULL, 10) * 1024 *
+						1024;
+				break;
+			}
+		}
+	}
+	if (es.replayPath || es.bench)
+		es.rewindBudget = 0;
+	
 	// Setup SDL
 	if (!setupSDL()) {
 		fprintf(stderr, "PhilPSX: Setting up SDL failed\n");
@@ -93,7 +428,9 @@ int main(int argc, char **argv)
 			SDL_WINDOWPOS_CENTERED,
 			640,
 			480,
-			SDL_WINDOW_OPENGL);
+			((rendererMode == PHILPSX_GPU_RENDERER_OPENGL) ?
+					SDL_WINDOW_OPENGL : 0) |
+			(headless ? SDL_WINDOW_HIDDEN : 0));
 	if (!sdl.window) {
 		fprintf(stderr, "PhilPSX: Couldn't create window: %s\n",
 				SDL_GetError());
@@ -101,22 +438,40 @@ int main(int argc, char **argv)
 		goto cleanup_sdl;
 	}
 	
-	// Setup OpenGL context
-	sdl.context = SDL_GL_CreateContext(sdl.window);
-	if (!sdl.context) {
-		fprintf(stderr, "PhilPSX: Couldn't create OpenGL context: %s\n",
-				SDL_GetError());
-		retval = 1;
-		goto cleanup_window;
+	// Setup audio output, unless we are running as fast as we can - without
+	// it the SPU's samples are simply discarded, and pacing falls back to
+	// the vertical retrace
+	es.audio = NULL;
+	if (!turbo) {
+		es.audio = construct_AudioOutput();
+		if (!es.audio && es.audioSync) {
+			fprintf(stderr, "PhilPSX: No audio output, so synchronising to "
+					"the vertical retrace instead\n");
+			es.audioSync = false;
+		}
 	}
 	
-	// Setup OpenGL context to synchronise screen updates with the vertical
-	// retrace
-	if (SDL_GL_SetSwapInterval(1)) {
-		fprintf(stderr, "PhilPSX: Couldn't set OpenGL context to synchronise "
-				"screen updates with the vertical retrace: %s\n",
-				SDL_GetError());
-		goto cleanup_context;
+	// Setup OpenGL context, unless the software renderer is drawing to the
+	// window surface instead
+	sdl.context = NULL;
+	if (rendererMode == PHILPSX_GPU_RENDERER_OPENGL) {
+		sdl.context = SDL_GL_CreateContext(sdl.window);
+		if (!sdl.context) {
+			fprintf(stderr, "PhilPSX: Couldn't create OpenGL context: %s\n",
+					SDL_GetError());
+			retval = 1;
+			goto cleanup_audio;
+		}
+		
+		// Setup OpenGL context to synchronise screen updates with the
+		// vertical retrace, unless we are running as fast as we can or the
+		// audio device is setting the pace
+		if (SDL_GL_SetSwapInterval((turbo || es.audioSync) ? 0 : 1)) {
+			fprintf(stderr, "PhilPSX: Couldn't set OpenGL context to "
+					"synchronise screen updates with the vertical retrace: "
+					"%s\n", SDL_GetError());
+			goto cleanup_context;
+		}
 	}
 	
 	// Setup WorkQueue and set its reference in emulator state holder if
@@ -128,13 +483,19 @@ int main(int argc, char **argv)
 	}
 	es.wq = wq;
 	
-	// Setup console itself
+	// Setup console itself, or just its GPU when replaying a trace
 	Console console;
-	if (!setupEmu(&console, argc - 1, argv + 1, wq, sdl.window)) {
+	if (es.replayPath ? !setupReplay(&console, wq, sdl.window, rendererMode) :
+			!setupEmu(&console, argc - 1, argv + 1, wq, sdl.window,
+			rendererMode)) {
 		fprintf(stderr, "PhilPSX: Couldn't create console\n");
 		retval = 1;
 		goto cleanup_workqueue;
 	}
+	if (headless)
+		GPU_setPresentationEnabled(console.gpu, false);
+	if (es.bench)
+		GPU_setFrameskip(console.gpu, 0);
 	
 	// Set emulator state holder to reference multiple objects from the
 	// same struct - this makes passing state to threads without using global
@@ -142,11 +503,58 @@ int main(int argc, char **argv)
 	es.console = &console;
 	es.sdl = &sdl;
 	es.quitBool = false;
+	es.perfSummary[0] = '\0';
 	if (pthread_mutex_init(&es.quitMutex, NULL)) {
 		fprintf(stderr, "PhilPSX: Couldn't initialise quitMutex\n");
 		goto cleanup_console;
 	}
 	
+	// Setup command channel, which passes keys and debugger commands to the
+	// emulator thread without it having to take a lock to look for them
+	es.commands = NULL;
+	if (!es.replayPath) {
+		es.commands = construct_CommandChannel(
+				PHILPSX_COMMAND_CHANNEL_CAPACITY);
+		if (!es.commands) {
+			fprintf(stderr, "PhilPSX: Couldn't create command channel\n");
+			retval = 1;
+			goto cleanup_mutex;
+		}
+	}
+	
+	// Attach debugger if asked to, and start reading commands for it from
+	// the command prompt - the thread is left blocked reading when we quit
+	if (es.debug) {
+		pthread_t debugInputThread;
+		if (!R3051_attachDebugger(console.cpu)) {
+			fprintf(stderr, "PhilPSX: Couldn't attach debugger\n");
+		} else if (pthread_create(&debugInputThread, NULL,
+				&debugInputFunction, &es)) {
+			fprintf(stderr, "PhilPSX: Couldn't start debugger input "
+					"thread\n");
+			R3051Debugger_handleCommand(R3051_getDebugger(console.cpu),
+					PHILPSX_R3051DEBUGGER_COMMAND_CONTINUE, 0, 0);
+		} else {
+			pthread_detach(debugInputThread);
+			printf("PhilPSX: Debugger attached, type ? for commands\n");
+		}
+	}
+	
+	// Attach profiler if asked to, naming blocks from the symbol map
+	if (es.profilePath) {
+		if (!R3051_attachProfiler(console.cpu)) {
+			fprintf(stderr, "PhilPSX: Couldn't attach profiler\n");
+			es.profilePath = NULL;
+		} else if (es.symbolsPath) {
+			R3051Profiler_loadSymbols(R3051_getProfiler(console.cpu),
+					es.symbolsPath);
+		}
+	}
+	
+	// Start recording trace events if asked to
+	if (es.tracePath)
+		TraceEvents_start();
+	
 	// Create threads, preparing a quit event to push in case they fail
 	SDL_Event quitEvent;
 	quitEvent.type = SDL_QUIT;
@@ -157,7 +565,8 @@ int main(int argc, char **argv)
 							"loop: %s\n", SDL_GetError());
 		}
 	}
-	if (pthread_create(&es.emulatorThread, NULL, &emulatorFunction, &es)) {
+	if (pthread_create(&es.emulatorThread, NULL,
+			es.replayPath ? &replayFunction : &emulatorFunction, &es)) {
 		fprintf(stderr, "PhilPSX: Couldn't start emulator thread\n");
 		if (SDL_PushEvent(&quitEvent) != 1) {
 			fprintf(stderr, "PhilPSX: Couldn't push quit event to event "
@@ -165,9 +574,11 @@ int main(int argc, char **argv)
 		}
 	}
 	
-	// Enter event loop just to keep window open
+	// Enter event loop, which also passes keys on to the pad in the first
+	// port without waiting for the emulator thread
 	SDL_Event myEvent;
 	int waitStatus;
+	uint16_t padButtons = 0;
 	while (waitStatus = SDL_WaitEvent(&myEvent)) {
 		switch (myEvent.type) {
 		case SDL_QUIT:
@@ -175,8 +586,40 @@ int main(int argc, char **argv)
 			pthread_mutex_lock(&es.quitMutex);
 			es.quitBool = true;
 			pthread_mutex_unlock(&es.quitMutex);
+			sendCommand(&es, PHILPSX_COMMAND_QUIT, 0, 0, 0);
 			goto end_waitevent;
 			break;
+		case SDL_KEYDOWN:
+			// Ask the emulator thread to save or load state, or to rewind
+			// for as long as the key is held
+			if (myEvent.key.repeat)
+				break;
+			if (getPadButton(myEvent.key.keysym.sym) && console.cio) {
+				padButtons |= getPadButton(myEvent.key.keysym.sym);
+				ControllerIO_setHostInput(console.cio, 0, padButtons, NULL);
+				break;
+			}
+			if (myEvent.key.keysym.sym == SDLK_F5)
+				sendCommand(&es, PHILPSX_COMMAND_SAVE_STATE, 0, 0, 0);
+			else if (myEvent.key.keysym.sym == SDLK_F7)
+				sendCommand(&es, PHILPSX_COMMAND_LOAD_STATE, 0, 0, 0);
+			else if (myEvent.key.keysym.sym == SDLK_BACKSPACE)
+				sendCommand(&es, PHILPSX_COMMAND_REWIND_PRESS, 0, 0, 0);
+			break;
+		case SDL_KEYUP:
+			if (getPadButton(myEvent.key.keysym.sym) && console.cio) {
+				padButtons &= ~getPadButton(myEvent.key.keysym.sym);
+				ControllerIO_setHostInput(console.cio, 0, padButtons, NULL);
+			} else if (myEvent.key.keysym.sym == SDLK_BACKSPACE) {
+				sendCommand(&es, PHILPSX_COMMAND_REWIND_RELEASE, 0, 0, 0);
+			}
+			break;
+		case SDL_USEREVENT:
+			// Show the latest performance counter summary in the title bar
+			pthread_mutex_lock(&es.quitMutex);
+			SDL_SetWindowTitle(sdl.window, es.perfSummary);
+			pthread_mutex_unlock(&es.quitMutex);
+			break;
 		}
 	}
 	end_waitevent:
@@ -196,19 +639,42 @@ int main(int argc, char **argv)
 	pthread_join(es.emulatorThread, NULL);
 	
 	// Regain OpenGL context
-	if (SDL_GL_MakeCurrent(sdl.window, sdl.context)) {
+	if (sdl.context && SDL_GL_MakeCurrent(sdl.window, sdl.context)) {
 		fprintf(stderr, "PhilPSX: Switching OpenGL context back to main "
 						"thread failed: %s\n", SDL_GetError());
 		// We don't do anything else here as we are ending anyway,
 		// so not much we can do
 	}
 	
+	// Print the hottest blocks and write out the profile if profiling
+	if (es.profilePath) {
+		R3051Profiler *profiler = R3051_getProfiler(console.cpu);
+		R3051Profiler_printHotBlocks(profiler, PHILPSX_PROFILE_HOT_BLOCKS);
+		if (R3051Profiler_writeFoldedStacks(profiler, es.profilePath))
+			printf("PhilPSX: Profile written to %s\n", es.profilePath);
+	}
+	
+	// Write out trace events if recording them
+	if (es.tracePath)
+		TraceEvents_write(es.tracePath);
+	
+	// Destroy command channel, unless the debugger input thread may still
+	// push to it, in which case it is left for the process to clean up
+	if (es.commands && !es.debug)
+		destruct_CommandChannel(es.commands);
+	
 	// Destroy quit mutex
+	cleanup_mutex:
 	pthread_mutex_destroy(&es.quitMutex);
 	
-	// Cleanup console
+	// Cleanup console, along with the performance counters it kept
 	cleanup_console:
-	cleanupEmu(&console);
+	if (es.replayPath)
+		cleanupReplay(&console, rendererMode);
+	else
+		Console_cleanupComponents(&console);
+	PerfCounters_cleanup();
+	TraceEvents_cleanup();
 	
 	// Cleanup work queue
 	cleanup_workqueue:
@@ -216,10 +682,15 @@ int main(int argc, char **argv)
 	
 	// Cleanup OpenGL context
 	cleanup_context:
-	SDL_GL_DeleteContext(sdl.context);
+	if (sdl.context)
+		SDL_GL_DeleteContext(sdl.context);
+	
+	// Cleanup audio output
+	cleanup_audio:
+	if (es.audio)
+		destruct_AudioOutput(es.audio);
 	
 	// Destroy window
-	cleanup_window:
 	SDL_DestroyWindow(sdl.window);
 
 	// Shutdown SDL
@@ -237,7 +708,7 @@ int main(int argc, char **argv)
  * together properly.
  */
 static bool setupEmu(Console *console, int numOfArgs, char **args,
-		WorkQueue *wq, SDL_Window *window)
+		WorkQueue *wq, SDL_Window *window, int32_t rendererMode)
 {
 	// Parse BIOS path from command line arguments
 	bool biosSpecified = false;
@@ -269,96 +740,134 @@ static bool setupEmu(Console *console, int numOfArgs, char **args,
 		}
 	}
 
-	// Initialise components
-	// CPU
-	console->cpu = construct_R3051();
-	if (!console->cpu) {
-		fprintf(stderr, "PhilPSX: R3051 setup failed\n");
-		goto end;
+	// Parse memory card image paths from command line arguments
+	const char *memoryCardPaths[PHILPSX_CONTROLLERIO_PORT_COUNT] = {NULL};
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 9 && strncmp(args[i], "-memcard", 8) == 0 &&
+				(args[i][8] == '1' || args[i][8] == '2')) {
+			if (i + 1 < numOfArgs)
+				memoryCardPaths[args[i][8] - '1'] = args[i + 1];
+		}
 	}
-	
-	// SystemInterlink
-	console->smi = construct_SystemInterlink(args[biosPathIndex]);
-	if (!console->smi) {
-		fprintf(stderr, "PhilPSX: System Interlink setup failed\n");
-		goto cleanup_cpu;
+
+	// Parse CPU execution mode from command line arguments
+	int32_t cpuMode = PHILPSX_R3051_MODE_INTERPRETER;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 4 && strncmp(args[i], "-cpu", 4) == 0) {
+			if (i + 1 < numOfArgs) {
+				if (strlen(args[i + 1]) == 3 &&
+						strncmp(args[i + 1], "jit", 3) == 0) {
+					cpuMode = PHILPSX_R3051_MODE_RECOMPILER;
+				} else if (strlen(args[i + 1]) == 6 &&
+						strncmp(args[i + 1], "cached", 6) == 0) {
+					cpuMode = PHILPSX_R3051_MODE_CACHED_INTERPRETER;
+				} else if (!(strlen(args[i + 1]) == 11 &&
+						strncmp(args[i + 1], "interpreter", 11) == 0)) {
+					fprintf(stderr, "PhilPSX: Unknown CPU mode %s\n",
+							args[i + 1]);
+					goto end;
+				}
+				break;
+			}
+		}
 	}
-	
-	// GPU
-	console->gpu = construct_GPU();
-	if (!console->gpu) {
-		fprintf(stderr, "PhilPSX: GPU setup failed\n");
-		goto cleanup_smi;
+
+	// Parse kernel functions to run natively from command line arguments
+	const char *hleFunctions = NULL;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 4 && strncmp(args[i], "-hle", 4) == 0) {
+			if (i + 1 < numOfArgs) {
+				hleFunctions = args[i + 1];
+				break;
+			}
+		}
 	}
-	
-	// Set OpenGL state
-	GPU_setGLFunctionPointers(console->gpu);
-	if (!GPU_initGL(console->gpu)) {
-		fprintf(stderr, "PhilPSX: GPU GL setup failed\n");
-		goto cleanup_gpu;
+
+	// Parse frame skip limit from command line arguments
+	int32_t maxSkippedFrames = 0;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 10 && strncmp(args[i], "-frameskip", 10) == 0) {
+			if (i + 1 < numOfArgs) {
+				maxSkippedFrames = (int32_t)strtol(args[i + 1], NULL, 10);
+				break;
+			}
+		}
 	}
-	
-	// SPU
-	console->spu = construct_SPU();
-	if (!console->spu) {
-		fprintf(stderr, "PhilPSX: SPU setup failed\n");
-		goto cleanup_gl;
+
+	// Parse GPU trace path from command line arguments
+	const char *tracePath = NULL;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 9 && strncmp(args[i], "-gputrace", 9) == 0) {
+			if (i + 1 < numOfArgs) {
+				tracePath = args[i + 1];
+				break;
+			}
+		}
 	}
-	
-	// CDROMDrive
-	console->cdrom = construct_CDROMDrive();
-	if (!console->cdrom) {
-		fprintf(stderr, "PhilPSX: CD-ROM drive setup failed\n");
-		goto cleanup_spu;
+
+	// Parse program to side-load, and whether to side-load the one the CD
+	// boots, from command line arguments
+	const char *exePath = NULL;
+	bool fastBoot = false;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 4 && strncmp(args[i], "-exe", 4) == 0) {
+			if (i + 1 < numOfArgs)
+				exePath = args[i + 1];
+		} else if (strlen(args[i]) == 9 &&
+				strncmp(args[i], "-fastboot", 9) == 0) {
+			fastBoot = true;
+		}
 	}
-		
-	// DMAArbiter
-	console->dma = construct_DMAArbiter();
-	if (!console->dma) {
-		fprintf(stderr, "PhilPSX: DMA Arbiter setup failed\n");
-		goto cleanup_cdrom;
+
+	// Setup components
+	memset(console, 0, sizeof(Console));
+	if (!Console_setupComponents(console, args[biosPathIndex], wq,
+			rendererMode))
+		goto end;
+	if (cpuMode != PHILPSX_R3051_MODE_INTERPRETER &&
+			!R3051_setExecutionMode(console->cpu, cpuMode)) {
+		fprintf(stderr, "PhilPSX: CPU mode setup failed, falling back to "
+				"the interpreter\n");
 	}
-	
-	// ControllerIO
-	console->cio = construct_ControllerIO();
-	if (!console->cio) {
-		fprintf(stderr, "PhilPSX: Controller I/O setup failed\n");
-		goto cleanup_dma;
+	if (hleFunctions && !R3051_setHleFunctions(console->cpu, hleFunctions)) {
+		fprintf(stderr, "PhilPSX: Kernel function emulation setup failed, "
+				"using the BIOS for all kernel functions\n");
 	}
+	GPU_setFrameskip(console->gpu, maxSkippedFrames);
+	if (tracePath)
+		GPU_startTrace(console->gpu, tracePath);
 	
 	// Load CD image if one was specified
 	if (cdSpecified) {
 		if (!CDROMDrive_loadCD(console->cdrom, args[cdPathIndex])) {
 			fprintf(stderr, "PhilPSX: Loading of CD-ROM image failed\n");
-			goto cleanup_cio;
+			goto cleanup_components;
+		}
+	}
+
+	// Side-load program in place of the BIOS shell if asked to
+	if (exePath) {
+		if (!R3051_setBootExe(console->cpu, exePath)) {
+			fprintf(stderr, "PhilPSX: Loading of PS-X EXE failed\n");
+			goto cleanup_components;
+		}
+	} else if (fastBoot) {
+		if (!cdSpecified || !R3051_setBootCD(console->cpu,
+				CDROMDrive_getCD(console->cdrom)))
+			fprintf(stderr, "PhilPSX: No program to fast boot from the "
+					"CD, booting through the BIOS instead\n");
+	}
+
+	// Insert memory cards that were specified
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+		if (memoryCardPaths[i] &&
+				!ControllerIO_loadMemoryCard(console->cio, i,
+				memoryCardPaths[i])) {
+			fprintf(stderr, "PhilPSX: Loading of memory card image "
+					"failed\n");
+			goto cleanup_components;
 		}
 	}
-	
-	// Link components together and set their parameters
-	
-	// Link necessary components to the interlink
-	SystemInterlink_setCpu(console->smi, console->cpu);
-	SystemInterlink_setGpu(console->smi, console->gpu);
-	SystemInterlink_setSpu(console->smi, console->spu);
-	SystemInterlink_setCdrom(console->smi, console->cdrom);
-	SystemInterlink_setDma(console->smi, console->dma);
-	SystemInterlink_setControllerIO(console->smi, console->cio);
-	
-	// Link interlink back to those components where needed
-	R3051_setMemoryInterface(console->cpu, console->smi);
-	GPU_setMemoryInterface(console->gpu, console->smi);
-	SPU_setMemoryInterface(console->spu, console->smi);
-	CDROMDrive_setMemoryInterface(console->cdrom, console->smi);
-	DMAArbiter_setMemoryInterface(console->dma, console->smi);
-	ControllerIO_setMemoryInterface(console->cio, console->smi);
-	
-	// Now link necessary components to the DMA arbiter
-	DMAArbiter_setCpu(console->dma, console->cpu);
-	DMAArbiter_setGpu(console->dma, console->gpu);
-	DMAArbiter_setCdrom(console->dma, console->cdrom);
-	
-	// Set work queue reference in GPU
-	GPU_setWorkQueue(console->gpu, wq);
 	
 	// Set SDL_Window reference in GPU
 	GPU_setSDLWindowReference(console->gpu, window);
@@ -367,49 +876,68 @@ static bool setupEmu(Console *console, int numOfArgs, char **args,
 	return true;
 	
 	// Cleanup path:
-	cleanup_cio:
-	destruct_ControllerIO(console->cio);
+	cleanup_components:
+	Console_cleanupComponents(console);
 	
-	cleanup_dma:
-	destruct_DMAArbiter(console->dma);
+	end:
+	return false;
+}
+
+/*
+ * This sets up just the GPU of the virtual PlayStation, for replaying a
+ * trace - the other components are left as NULL.
+ */
+static bool setupReplay(Console *console, WorkQueue *wq, SDL_Window *window,
+		int32_t rendererMode)
+{
+	memset(console, 0, sizeof(Console));
+
+	// GPU
+	console->gpu = construct_GPU();
+	if (!console->gpu) {
+		fprintf(stderr, "PhilPSX: GPU setup failed\n");
+		goto end;
+	}
 	
-	cleanup_cdrom:
-	destruct_CDROMDrive(console->cdrom);
+	// Set OpenGL state, or setup the software renderer in its place
+	if (rendererMode == PHILPSX_GPU_RENDERER_SOFTWARE) {
+		if (!GPU_initSoftRenderer(console->gpu)) {
+			fprintf(stderr, "PhilPSX: GPU software renderer setup failed\n");
+			goto cleanup_gpu;
+		}
+	} else {
+		GPU_setGLFunctionPointers(console->gpu);
+		if (!GPU_initGL(console->gpu)) {
+			fprintf(stderr, "PhilPSX: GPU GL setup failed\n");
+			goto cleanup_gpu;
+		}
+	}
 	
-	cleanup_spu:
-	destruct_SPU(console->spu);
+	// Set work queue and SDL_Window references in GPU
+	GPU_setWorkQueue(console->gpu, wq);
+	GPU_setSDLWindowReference(console->gpu, window);
 	
-	cleanup_gl:
-	GPU_cleanupGL(console->gpu);
+	// Normal return:
+	return true;
 	
+	// Cleanup path:
 	cleanup_gpu:
 	destruct_GPU(console->gpu);
 	
-	cleanup_smi:
-	destruct_SystemInterlink(console->smi);
-	
-	cleanup_cpu:
-	destruct_R3051(console->cpu);
-	
 	end:
 	return false;
 }
 
 /*
- * This cleans up all the resources associated with the virtual PlayStation.
+ * This cleans up the resources set up by setupReplay.
  */
-static void cleanupEmu(Console *console)
+static void cleanupReplay(Console *console, int32_t rendererMode)
 {
-	// Cleanup resources - the CD image is cleaned up automatically
-	// by its destructor if present
-	destruct_ControllerIO(console->cio);
-	destruct_DMAArbiter(console->dma);
-	destruct_CDROMDrive(console->cdrom);
-	destruct_SPU(console->spu);
-	GPU_cleanupGL(console->gpu);
+	if (rendererMode == PHILPSX_GPU_RENDERER_SOFTWARE)
+		GPU_cleanupSoftRenderer(console->gpu);
+	else
+		GPU_cleanupGL(console->gpu);
 	destruct_GPU(console->gpu);
-	destruct_SystemInterlink(console->smi);
-	destruct_R3051(console->cpu);
 }
 
 /*
@@ -420,6 +948,8 @@ static void *renderingFunction(void *arg)
 {
 	// Announce entry
 	fprintf(stdout, "PhilPSX: Started rendering thread\n");
+	PerfCounters_setThreadName("rendering");
+	TraceEvents_setThreadName("rendering");
 
 	// Cast void argument back to objects
 	EmulatorState *es = arg;
@@ -430,8 +960,8 @@ static void *renderingFunction(void *arg)
 	// Declare local bool for quitting rendering loop
 	bool renderQuit;
 		 
-	// Make the OpenGL context current on this thread
-	if (SDL_GL_MakeCurrent(sdl->window, sdl->context)) {
+	// Make the OpenGL context current on this thread, if there is one
+	if (sdl->context && SDL_GL_MakeCurrent(sdl->window, sdl->context)) {
 		fprintf(stderr, "PhilPSX: Switching OpenGL context to rendering "
 						"thread failed: %s\n", SDL_GetError());
 		
@@ -459,7 +989,7 @@ static void *renderingFunction(void *arg)
 		// Check for items in work queue
 		GpuCommand *command = WorkQueue_waitForItem(wq);
 		if (command)
-			command->functionPointer(command);
+			GPU_executeCommand(command);
 		WorkQueue_returnItem(wq, command);
 	}
 	
@@ -476,47 +1006,325 @@ static void *emulatorFunction(void *arg)
 {
 	// Announce entry
 	fprintf(stdout, "PhilPSX: Started emulator thread\n");
+	PerfCounters_setThreadName("emulator");
+	TraceEvents_setThreadName("emulator");
 
 	// Cast void argument back to objects
 	EmulatorState *es = arg;
 	Console *console = es->console;
 	WorkQueue *wq = es->wq;
-
-	// Declare local bool for quitting rendering loop
-	bool emulatorQuit;
+	R3051Debugger *debugger = R3051_getDebugger(console->cpu);
+	
+	// Setup save states - the backup holds the state from before a load, so
+	// that it can be put back if the load fails part way through
+	SaveState *state = construct_SaveState();
+	SaveState *backupState = construct_SaveState();
+	if (!state || !backupState) {
+		fprintf(stderr, "PhilPSX: Save states are unavailable\n");
+	}
+	bool saveRequested = false;
+	bool loadRequested = false;
+	
+	// Setup run-ahead - frames on the real timeline are still drawn but not
+	// shown, and frame skipping is turned off, as it would be timing frames
+	// that get rolled back
+	int32_t runAheadFrames = es->runAheadFrames;
+	SaveState *aheadState = NULL;
+	bool runAheadPending = false;
+	int64_t aheadFrames = 0;
+	
+	// Setup rewind buffer, which shares the save state used for files
+	RewindBuffer *rewindBuffer = NULL;
+	if (es->rewindBudget > 0 && state) {
+		rewindBuffer = construct_RewindBuffer(es->rewindBudget);
+		if (!rewindBuffer)
+			fprintf(stderr, "PhilPSX: Rewinding is unavailable\n");
+	}
+	bool rewindPending = false;
+	bool rewindHeld = false;
+	int32_t rewindFrames = 0;
+	
+	if (runAheadFrames > 0) {
+		aheadState = construct_SaveState();
+		if (aheadState) {
+			GPU_setFrameskip(console->gpu, 0);
+			GPU_setPresentationEnabled(console->gpu, false);
+		} else {
+			fprintf(stderr, "PhilPSX: Run-ahead is unavailable\n");
+			runAheadFrames = 0;
+		}
+	}
 	
 	// Enter emulation loop
-	struct timespec t1, t2;
+	struct timespec t1, t2, start;
 	int64_t cycles = 0;
+	int64_t totalCycles = 0;
+	int64_t idleCycles = 0;
+	int64_t skippedFrames = 0;
+	int64_t presentedFrames = 0;
+	int64_t droppedFrames = 0;
+	int64_t audioFrame = 0;
+	int64_t underruns = 0;
+	int64_t overruns = 0;
+	int16_t samples[PHILPSX_AUDIO_CHUNK_FRAMES * 2];
+	int64_t perfValues[PHILPSX_PERF_COUNTER_COUNT];
+	memset(perfValues, 0, sizeof(perfValues));
+	int64_t batchStart = 0;
+	int64_t batchCycles = 0;
 	clock_gettime(CLOCK_REALTIME, &t1);
-	
-	// Start gperftools log
-	ProfilerStart("philpsx_emulator_thread.log");
+	start = t1;
 	
 	while (true) {
 		
-		// Check if we need to quit
-		pthread_mutex_lock(&es->quitMutex);
-		emulatorQuit = es->quitBool;
-		pthread_mutex_unlock(&es->quitMutex);
-		if (emulatorQuit)
-			goto end;
+		// Carry out commands from other threads, which only costs a load
+		// when there aren't any
+		if (!CommandChannel_isEmpty(es->commands)) {
+			ChannelCommand command;
+			while (CommandChannel_pop(es->commands, &command)) {
+				switch (command.type) {
+					case PHILPSX_COMMAND_QUIT:
+						goto end;
+					case PHILPSX_COMMAND_SAVE_STATE:
+						saveRequested = true;
+						break;
+					case PHILPSX_COMMAND_LOAD_STATE:
+						loadRequested = true;
+						break;
+					case PHILPSX_COMMAND_REWIND_PRESS:
+						rewindHeld = true;
+						break;
+					case PHILPSX_COMMAND_REWIND_RELEASE:
+						rewindHeld = false;
+						break;
+					case PHILPSX_COMMAND_DEBUG:
+						if (debugger)
+							R3051Debugger_handleCommand(debugger,
+									command.arguments[0],
+									command.arguments[1],
+									command.arguments[2]);
+						break;
+				}
+			}
+		}
+		
+		// Wait for the debugger to let us carry on if it has stopped us
+		if (debugger && R3051Debugger_isHalted(debugger)) {
+			struct timespec pause = {0, 1000000};
+			nanosleep(&pause, NULL);
+			continue;
+		}
+		
+		// Move the emulator on by one block of R3051 instructions, tracing
+		// blocks in batches
+		if (batchCycles == 0)
+			batchStart = PHILPSX_TRACE_BEGIN();
+		int64_t blockCycles = R3051_executeInstructions(console->cpu);
+		cycles += blockCycles;
+		totalCycles += blockCycles;
+		batchCycles += blockCycles;
+		
+		// Once a frame, pass the SPU's samples on to the audio output (or
+		// discard them if there isn't one), and give the audio device the
+		// chance to hold us back if it is setting the pace - the batch being
+		// traced is ended first, so it doesn't take in the wait
+		int64_t frameCount = GPU_getFrameCount(console->gpu);
+		if (batchCycles >= PHILPSX_TRACE_CPU_BATCH_CYCLES ||
+				frameCount != audioFrame) {
+			PHILPSX_TRACE_END(PHILPSX_TRACE_CPU_BATCH, batchStart,
+					(int32_t)batchCycles);
+			batchCycles = 0;
+		}
+		if (frameCount != audioFrame) {
+			audioFrame = frameCount;
+			int32_t sampleCount;
+			while ((sampleCount = SPU_readSamples(console->spu, samples,
+					PHILPSX_AUDIO_CHUNK_FRAMES)) > 0) {
+				if (es->audio)
+					AudioOutput_pushSamples(es->audio, samples, sampleCount);
+			}
+			if (es->audioSync)
+				AudioOutput_pace(es->audio);
+			
+			// Rewind and run ahead again once the GPU has no command part
+			// way through
+			rewindPending = rewindBuffer != NULL;
+			runAheadPending = runAheadFrames > 0;
+		}
+		
+		// Handle save and load requests
+		if ((saveRequested || loadRequested) && state && backupState &&
+				GPU_isIdle(console->gpu)) {
+			struct timespec stateStart, stateEnd;
+			clock_gettime(CLOCK_REALTIME, &stateStart);
+			if (saveRequested) {
+				SaveState_clear(state);
+				Console_saveState(console, state);
+				if (!SaveState_hasFailed(state) &&
+						SaveState_saveFile(state, es->statePath)) {
+					clock_gettime(CLOCK_REALTIME, &stateEnd);
+					printf("PhilPSX: Saved %d bytes of state to %s in "
+							"%ld ms\n", SaveState_getSize(state),
+							es->statePath,
+							(stateEnd.tv_sec - stateStart.tv_sec) * 1000 +
+							(stateEnd.tv_nsec - stateStart.tv_nsec) /
+							1000000);
+				} else {
+					fprintf(stderr, "PhilPSX: Couldn't save state to "
+							"%s\n", es->statePath);
+				}
+			} else if (SaveState_loadFile(state, es->statePath)) {
+				SaveState_clear(backupState);
+				Console_saveState(console, backupState);
+				if (Console_loadState(console, state)) {
+					clock_gettime(CLOCK_REALTIME, &stateEnd);
+					printf("PhilPSX: Loaded %d bytes of state from %s in "
+							"%ld ms\n", SaveState_getSize(state),
+							es->statePath,
+							(stateEnd.tv_sec - stateStart.tv_sec) * 1000 +
+							(stateEnd.tv_nsec - stateStart.tv_nsec) /
+							1000000);
+				} else {
+					fprintf(stderr, "PhilPSX: %s doesn't match this "
+							"console, keeping the current state\n",
+							es->statePath);
+					Console_loadState(console, backupState);
+				}
+			}
+			saveRequested = false;
+			loadRequested = false;
+		}
 		
-		// Move the emulator on by one block of R3051 instructions
-		cycles += R3051_executeInstructions(console->cpu);
+		// Step back one save state each frame while rewinding, or keep one
+		// every few frames otherwise, as long as the last one has been
+		// encoded
+		if (rewindPending && GPU_isIdle(console->gpu)) {
+			if (rewindHeld) {
+				if (RewindBuffer_stepBack(rewindBuffer, state) &&
+						!Console_loadState(console, state))
+					fprintf(stderr, "PhilPSX: Couldn't rewind\n");
+				rewindFrames = 0;
+			} else if (++rewindFrames >= PHILPSX_REWIND_INTERVAL &&
+					RewindBuffer_isIdle(rewindBuffer)) {
+				SaveState_clear(state);
+				Console_saveState(console, state);
+				if (!SaveState_hasFailed(state))
+					RewindBuffer_push(rewindBuffer, state);
+				rewindFrames = 0;
+			}
+			rewindPending = false;
+		}
+		
+		// Run ahead, showing the last frame of it and counting its frames
+		// apart from the real ones, or carry on the real timeline without
+		// it if rolling back failed
+		if (runAheadPending && GPU_isIdle(console->gpu)) {
+			int64_t aheadStart = GPU_getFrameCount(console->gpu);
+			if (runAhead(console, aheadState, runAheadFrames, samples)) {
+				aheadFrames += GPU_getFrameCount(console->gpu) - aheadStart;
+			} else {
+				fprintf(stderr, "PhilPSX: Couldn't roll back after running "
+						"ahead, turning run-ahead off\n");
+				runAheadFrames = 0;
+				GPU_setPresentationEnabled(console->gpu, true);
+			}
+			audioFrame = GPU_getFrameCount(console->gpu);
+			runAheadPending = false;
+		}
+
+		// End the run if we have reached a frame or cycle limit, reporting
+		// how long it took and asking the main thread to quit - benchmarks
+		// also wait for GP0 to be idle so vram can be hashed
+		int64_t realFrames = GPU_getFrameCount(console->gpu) - aheadFrames;
+		if (((es->frameLimit > 0 && realFrames >= es->frameLimit) ||
+				(es->cycleLimit > 0 && totalCycles >= es->cycleLimit)) &&
+				(!es->bench || GPU_isIdle(console->gpu))) {
+			clock_gettime(CLOCK_REALTIME, &t2);
+			int64_t start_ms = start.tv_sec * 1000 + start.tv_nsec / 1000000;
+			int64_t t2_ms = t2.tv_sec * 1000 + t2.tv_nsec / 1000000;
+			printf("PhilPSX: Emulated %ld frames (%ld cycles) in %ld ms\n",
+					realFrames, totalCycles, t2_ms - start_ms);
+			int64_t hits, misses;
+			CDROMDrive_getReadAheadStats(console->cdrom, &hits, &misses);
+			printf("PhilPSX: CD read-ahead had %ld of %ld sectors ready\n",
+					hits, hits + misses);
+			if (es->bench)
+				printBenchResults(console, realFrames, totalCycles,
+						(t2.tv_sec - start.tv_sec) * 1000000000L +
+						(t2.tv_nsec - start.tv_nsec));
+			SDL_Event quitEvent;
+			quitEvent.type = SDL_QUIT;
+			if (SDL_PushEvent(&quitEvent) != 1) {
+				fprintf(stderr, "PhilPSX: Couldn't push quit event to "
+						"event loop: %s\n", SDL_GetError());
+			}
+			break;
+		}
 		if (cycles >= 33868800) {
 			clock_gettime(CLOCK_REALTIME, &t2);
 			int64_t t1_ms = t1.tv_sec * 1000 + t1.tv_nsec / 1000000;
 			int64_t t2_ms = t2.tv_sec * 1000 + t2.tv_nsec / 1000000;
 			int64_t ms = t2_ms - t1_ms;
 			printf("Time to emulate one second of R3051 time: %ld\n", ms);
+			int64_t totalIdleCycles = R3051_getIdleCyclesSkipped(console->cpu);
+			printf("Idle cycles skipped in that time: %ld\n",
+					totalIdleCycles - idleCycles);
+			idleCycles = totalIdleCycles;
+			int64_t totalSkippedFrames =
+					GPU_getSkippedFrameCount(console->gpu);
+			printf("Frames skipped in that time: %ld\n",
+					totalSkippedFrames - skippedFrames);
+			skippedFrames = totalSkippedFrames;
+			int64_t totalPresentedFrames, totalDroppedFrames;
+			if (GPU_getPresentationStats(console->gpu, &totalPresentedFrames,
+					&totalDroppedFrames)) {
+				printf("Frames presented/replaced in that time: %ld/%ld\n",
+						totalPresentedFrames - presentedFrames,
+						totalDroppedFrames - droppedFrames);
+				presentedFrames = totalPresentedFrames;
+				droppedFrames = totalDroppedFrames;
+			}
+			if (es->audio) {
+				int64_t totalUnderruns, totalOverruns;
+				AudioOutput_getStats(es->audio, &totalUnderruns,
+						&totalOverruns);
+				printf("Audio underruns/overruns in that time: %ld/%ld\n",
+						totalUnderruns - underruns, totalOverruns - overruns);
+				underruns = totalUnderruns;
+				overruns = totalOverruns;
+			}
+			if (rewindBuffer) {
+				int32_t snapshots;
+				int64_t rewindBytes;
+				RewindBuffer_getStats(rewindBuffer, &snapshots, &rewindBytes);
+				printf("Rewind buffer holds %d states in %ld KB\n",
+						snapshots, rewindBytes / 1024);
+			}
+			for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+				int64_t sectorsWritten, flushes, sectorsFlushed;
+				if (ControllerIO_getMemoryCardStats(console->cio, i,
+						&sectorsWritten, &flushes, &sectorsFlushed) &&
+						sectorsWritten > 0) {
+					printf("Memory card %d has had %ld sectors written, "
+							"%ld flushed in %ld msyncs\n", i + 1,
+							sectorsWritten, sectorsFlushed, flushes);
+				}
+			}
+			if (PerfCounters_isEnabled())
+				showPerfCounters(es, perfValues);
 			clock_gettime(CLOCK_REALTIME, &t1);
 			cycles -= 33868800;
 		}
 	}
-	ProfilerStop();
 
 	end:
+	if (rewindBuffer)
+		destruct_RewindBuffer(rewindBuffer);
+	if (aheadState)
+		destruct_SaveState(aheadState);
+	if (backupState)
+		destruct_SaveState(backupState);
+	if (state)
+		destruct_SaveState(state);
 	fprintf(stdout, "PhilPSX: Ended emulator thread\n");
 	
 	// Set work queue to stop processing and notify
@@ -525,6 +1333,208 @@ static void *emulatorFunction(void *arg)
 	return NULL;
 }
 
+/*
+ * This function is intended to be called in a dedicated thread in place of
+ * emulatorFunction, to replay a GPU trace and then ask the main thread to
+ * quit.
+ */
+static void *replayFunction(void *arg)
+{
+	// Announce entry
+	fprintf(stdout, "PhilPSX: Started replay thread\n");
+
+	// Cast void argument back to objects
+	EmulatorState *es = arg;
+	Console *console = es->console;
+	WorkQueue *wq = es->wq;
+
+	// Replay trace, then push quit event to main loop
+	GPU_replayTrace(console->gpu, es->replayPath, es->replaySerialise);
+	SDL_Event quitEvent;
+	quitEvent.type = SDL_QUIT;
+	if (SDL_PushEvent(&quitEvent) != 1) {
+		fprintf(stderr, "PhilPSX: Couldn't push quit event to event "
+				"loop: %s\n", SDL_GetError());
+	}
+
+	fprintf(stdout, "PhilPSX: Ended replay thread\n");
+	
+	// Set work queue to stop processing and notify
+	WorkQueue_endProcessingByRenderingThread(wq);
+	
+	return NULL;
+}
+
+/*
+ * This function is intended to be called in a dedicated thread, to read
+ * debugger commands typed into the command prompt a line at a time and pass
+ * them on to the emulator thread, until the input ends.
+ */
+static void *debugInputFunction(void *arg)
+{
+	// Cast void argument back to objects
+	EmulatorState *es = arg;
+
+	char line[128];
+	while (fgets(line, sizeof(line), stdin)) {
+		int32_t command, argument0, argument1;
+		if (R3051Debugger_parseCommand(line, &command, &argument0,
+				&argument1))
+			sendCommand(es, PHILPSX_COMMAND_DEBUG, command, argument0,
+					argument1);
+		else if (line[strspn(line, " \t\r\n")] != '\0')
+			fprintf(stderr, "PhilPSX: Unknown debugger command, type ? for "
+					"commands\n");
+	}
+
+	return NULL;
+}
+
+/*
+ * This function passes a command on to the emulator thread. Quitting is
+ * retried until there is room for it, but anything else is dropped if the
+ * emulator thread has fallen that far behind.
+ */
+static void sendCommand(EmulatorState *es, int32_t type, int32_t argument0,
+		int32_t argument1, int32_t argument2)
+{
+	if (!es->commands)
+		return;
+
+	ChannelCommand command = {type, {argument0, argument1, argument2}};
+	while (!CommandChannel_push(es->commands, &command)) {
+		if (type != PHILPSX_COMMAND_QUIT) {
+			fprintf(stderr, "PhilPSX: Command channel is full, dropping "
+					"command\n");
+			return;
+		}
+		SDL_Delay(1);
+	}
+}
+
+/*
+ * This function runs the console the given number of frames ahead of the
+ * real timeline and shows the last of them, then rolls it back with a save
+ * state. Drawing is suppressed for all but the last frame, the sound of
+ * every frame is thrown away, and XA audio is left for the real timeline.
+ * It must only be called while GP0 is idle, and returns false if the state
+ * couldn't be taken or rolled back.
+ */
+static bool runAhead(Console *console, SaveState *state, int32_t frames,
+		int16_t *samples)
+{
+	// Take state, which only reads back the parts of vram drawn since last
+	// time, into a buffer that has already grown to fit it
+	SaveState_clear(state);
+	Console_saveState(console, state);
+	if (SaveState_hasFailed(state))
+		return false;
+
+	// Run frames, the last of which is drawn and shown
+	CDROMDrive_setSpeculative(console->cdrom, true);
+	for (int32_t i = 1; i <= frames; ++i) {
+		GPU_setDrawingSuppressed(console->gpu, i < frames);
+		GPU_setPresentationEnabled(console->gpu, i == frames);
+		int64_t frameCount = GPU_getFrameCount(console->gpu);
+		while (GPU_getFrameCount(console->gpu) == frameCount)
+			R3051_executeInstructions(console->cpu);
+	}
+	GPU_setPresentationEnabled(console->gpu, false);
+
+	// Let GP0 finish anything it is part way through, so that nothing is
+	// cut off on the rendering thread, but don't go on for another frame
+	int64_t frameCount = GPU_getFrameCount(console->gpu);
+	while (!GPU_isIdle(console->gpu) &&
+			GPU_getFrameCount(console->gpu) == frameCount)
+		R3051_executeInstructions(console->cpu);
+
+	// Throw away sound, then roll back
+	while (SPU_readSamples(console->spu, samples,
+			PHILPSX_AUDIO_CHUNK_FRAMES) > 0);
+	bool retVal = Console_loadState(console, state);
+	CDROMDrive_setSpeculative(console->cdrom, false);
+	return retVal;
+}
+
+/*
+ * This function prints the results of a benchmark run as a single line of
+ * JSON. The frame, cycle, instruction and command counts and the vram hash
+ * are the same on every run of the same BIOS and CD, so they show whether
+ * emulation has changed, while the rates show how fast the host ran it. It
+ * must only be called while GP0 is idle.
+ */
+static void printBenchResults(Console *console, int64_t frames,
+		int64_t cycles, int64_t hostNanoseconds)
+{
+	int64_t instructions = R3051_getInstructionCount(console->cpu);
+	int64_t gpuCommands = GPU_getCommandCount(console->gpu);
+	uint64_t frameHash = GPU_hashVram(console->gpu);
+	double seconds = (hostNanoseconds > 0) ? hostNanoseconds / 1e9 : 1e-9;
+
+	printf("{\"frames\": %ld, \"cycles\": %ld, \"instructions\": %ld, "
+			"\"gpu_commands\": %ld, \"frame_hash\": \"%016lx\", "
+			"\"host_ms\": %.3f, \"host_ms_per_frame\": %.4f, "
+			"\"cycles_per_sec\": %.0f, \"instructions_per_sec\": %.0f, "
+			"\"gpu_commands_per_sec\": %.0f}\n",
+			frames, cycles, instructions, gpuCommands, frameHash,
+			seconds * 1000.0, seconds * 1000.0 / frames, cycles / seconds,
+			instructions / seconds, gpuCommands / seconds);
+	fflush(stdout);
+}
+
+/*
+ * This function prints how much each performance counter has gone up by
+ * since the last call, skipping those that haven't moved, and hands a
+ * summary of the main ones to the main thread to show in the title bar.
+ * lastValues holds the totals from the last call, and is updated.
+ */
+static void showPerfCounters(EmulatorState *es, int64_t *lastValues)
+{
+	// Work out how far each counter has moved, over every thread
+	int64_t values[PHILPSX_PERF_COUNTER_COUNT];
+	int64_t deltas[PHILPSX_PERF_COUNTER_COUNT];
+	PerfCounters_read(PHILPSX_PERF_ALL_THREADS, values);
+	for (int32_t i = 0; i < PHILPSX_PERF_COUNTER_COUNT; ++i) {
+		deltas[i] = values[i] - lastValues[i];
+		lastValues[i] = values[i];
+	}
+
+	// Print counters
+	printf("Performance counters in that time:");
+	for (int32_t i = 0, printed = 0; i < PHILPSX_PERF_COUNTER_COUNT; ++i) {
+		if (deltas[i] == 0)
+			continue;
+		printf("%s%s=%ld", (printed++ % 4 == 0) ? "\n    " : ", ",
+				PerfCounters_getName(i), deltas[i]);
+	}
+	printf("\n");
+
+	// Sum up groups for the summary
+	int64_t primitives = 0;
+	for (int32_t i = PHILPSX_PERF_GPU_PRIMITIVES;
+			i < PHILPSX_PERF_WORKQUEUE_COMMANDS; ++i)
+		primitives += deltas[i];
+	int64_t gteOps = 0;
+	for (int32_t i = PHILPSX_PERF_GTE_OPS; i < PHILPSX_PERF_COUNTER_COUNT;
+			++i)
+		gteOps += deltas[i];
+
+	// Hand summary over to the main thread
+	pthread_mutex_lock(&es->quitMutex);
+	snprintf(es->perfSummary, sizeof(es->perfSummary), "PhilPSX - %.1fM "
+			"instructions, %ld primitives, %ld GTE ops, %ld sectors, %ld ms "
+			"queue stalls", deltas[PHILPSX_PERF_INSTRUCTIONS] / 1e6,
+			primitives, gteOps, deltas[PHILPSX_PERF_CD_SECTORS],
+			deltas[PHILPSX_PERF_WORKQUEUE_STALL_NS] / 1000000);
+	pthread_mutex_unlock(&es->quitMutex);
+	SDL_Event titleEvent;
+	titleEvent.type = SDL_USEREVENT;
+	if (SDL_PushEvent(&titleEvent) != 1) {
+		fprintf(stderr, "PhilPSX: Couldn't push title event to event "
+				"loop: %s\n", SDL_GetError());
+	}
+}
+
 /*
  * This function initialises SDL and sets the properties for the OpenGL
  * context we are going to create.
@@ -580,6 +1590,14 @@ static bool setupSDL(void)
 				"SDL_GL_CONTEXT_MINOR_VERSION: %s\n", SDL_GetError());
 		goto cleanup_sdl;
 	}
+#ifdef PHILPSX_DEBUG_BUILD
+	if (SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS,
+			SDL_GL_CONTEXT_DEBUG_FLAG) != 0) {
+		fprintf(stderr, "PhilPSX: Couldn't set attribute "
+				"SDL_GL_CONTEXT_FLAGS: %s\n", SDL_GetError());
+		goto cleanup_sdl;
+	}
+#endif
 	
 	// Normal return:
 	return true;
@@ -590,4 +1608,17 @@ static bool setupSDL(void)
 	
 	end:
 	return false;
+}
+
+/*
+ * This function returns the pad button the given key is mapped to, or 0 if
+ * it isn't mapped to one.
+ */
+static uint16_t getPadButton(SDL_Keycode key)
+{
+	for (size_t i = 0; i < sizeof(padKeys) / sizeof(padKeys[0]); ++i)
+		if (padKeys[i].key == key)
+			return padKeys[i].button;
+
+	return 0;
 }
\ No newline at end of file
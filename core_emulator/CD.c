@@ -3,6 +3,7 @@
  * 
  * CD.c - Copyright Phillip Potter, 2020, under GPLv3
  */
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -13,30 +14,94 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include "../headers/ArrayList.h"
-#include "../headers/LinkedList.h"
+#include "../headers/math_utils.h"
 #include "../headers/CD.h"
+#include "../headers/CDEcm.h"
+#include "../headers/TraceEvents.h"
 
 // List of track types
 #define PHILPSX_TRACKTYPE_AUDIO 0
 #define PHILPSX_TRACKTYPE_MODE2_2352 1
 
+// Size of a raw sector, and where the parts of it read by the drive start
+#define PHILPSX_CD_RAW_SECTOR_SIZE 2352
+#define PHILPSX_CD_WHOLE_SECTOR_START 12
+#define PHILPSX_CD_DATA_SECTOR_START 24
+
+// Number of sectors the read-ahead worker brings in past the read position -
+// at double speed, this is a little under a second of reading
+#define PHILPSX_CD_READAHEAD_SECTORS 128
+
+// Number of sector jobs that can wait for the read-ahead worker at once
+#define PHILPSX_CD_JOB_COUNT 32
+
 // Path separator for portability
 static const char pathSeparator = '/';
 
+/*
+ * This struct describes a backend for a compressed image type, which is
+ * recognised by its file ending. Images of these types are read through
+ * their backend's functions, rather than being mapped.
+ */
+typedef struct {
+	const char *fileEnding;
+	void *(*open)(const char *path);
+	void (*close)(void *image);
+	int64_t (*getSize)(void *image);
+	void (*read)(void *image, int64_t position, int8_t *dst, int32_t length);
+	void (*prefetch)(void *image, int64_t position, int64_t length);
+} CDBackend;
+
+/*
+ * This struct describes a sector the read-ahead worker has been asked to read
+ * in full and pass on to a callback.
+ */
+typedef struct {
+	int64_t sector;
+	CDSectorCallback callback;
+	void *arg;
+} CDSectorJob;
+
 // Forward declarations for functions and subcomponents private to this class
 // CD-related stuff:
-static void CD_trimLinkedList(LinkedList *list);
-static bool CD_readLineToList(LinkedList *list, int fileDescriptor);
+static char *CD_readCueFile(const char *path);
+static char *CD_skipUtf8Bom(char *text);
+static char *CD_nextLine(char **cursor);
 static bool CD_getTimesFromLine(char *line, int *minutes, int *seconds,
 		int *frames);
 static bool CD_swapState(CD *cd, int cdFileDescriptor, size_t cdFileSize,
-		int8_t *cdMapping, ArrayList *trackList);
-static void CD_convertListToString(LinkedList *list, char *dst);
+		int8_t *cdMapping, const CDBackend *backend, void *image,
+		ArrayList *trackList, int64_t *sectorIndex, int64_t sectorCount);
 static bool CD_openBin(const char *path, int *cdFileDescriptor,
 		size_t *cdFileSize, int8_t **cdMapping);
 static bool CD_addTrackToList(ArrayList *trackList, int32_t type,
 		int64_t prevEnd, int64_t trackStart, int64_t gap);
-static bool CD_handleUtf8Bom(int cueFileDescriptor);
+static int64_t *CD_buildSectorIndex(ArrayList *trackList, size_t cdFileSize,
+		int64_t *sectorCount);
+static void CD_requestReadAhead(CD *cd, int64_t sector);
+static void CD_waitForReadAhead(CD *cd);
+static void *CD_readAheadFunction(void *arg);
+static void CD_runSectorJob(CD *cd, CDSectorJob *job);
+static int64_t CD_findSector(CD *cd, int64_t sector);
+static const CDBackend *CD_findBackend(const char *path);
+static bool CD_openImage(char **path, const CDBackend **backend, void **image,
+		size_t *cdFileSize);
+
+// Backend-related stuff:
+static void *CD_ecmOpen(const char *path);
+static void CD_ecmClose(void *image);
+static int64_t CD_ecmGetSize(void *image);
+static void CD_ecmRead(void *image, int64_t position, int8_t *dst,
+		int32_t length);
+static void CD_ecmPrefetch(void *image, int64_t position, int64_t length);
+
+// List of backends for compressed images
+static const CDBackend backends[] = {
+	{".ecm", &CD_ecmOpen, &CD_ecmClose, &CD_ecmGetSize, &CD_ecmRead,
+			&CD_ecmPrefetch},
+	{".ECM", &CD_ecmOpen, &CD_ecmClose, &CD_ecmGetSize, &CD_ecmRead,
+			&CD_ecmPrefetch}
+};
 
 // CDTrack-related stuff:
 typedef struct CDTrack CDTrack;
@@ -44,7 +109,6 @@ static CDTrack *construct_CDTrack(int32_t trackNumber, int32_t type,
 		int64_t trackStart, int64_t offset);
 static void destruct_CDTrack(CDTrack *cdt);
 static void destruct_CDTrack_Passthrough(void *cdt);
-static bool CDTrack_isWithin(CDTrack *cdt, int64_t position);
 
 /*
  * This struct models a CD itself, and abstracts image type away from the
@@ -60,9 +124,43 @@ struct CD {
 	
 	// This stores the mapping to access the file's contents
 	int8_t *cdMapping;
+
+	// This stores the backend and image of a compressed image, which is
+	// used instead of the mapping
+	const CDBackend *backend;
+	void *image;
 	
 	// This allows us to keep a list of tracks from the image
 	ArrayList *trackList;
+
+	// This maps each sector (counted from the start of the disc, including
+	// the initial two-second gap) to the position of its first byte in the
+	// image, or -1 if no track covers it
+	int64_t *sectorIndex;
+	int64_t sectorCount;
+
+	// Read-ahead worker - this touches the sectors following the read
+	// position so that the image is paged in off the emulator thread. The
+	// window is the range of sectors it has finished paging in, and hits
+	// and misses count sector reads landing inside or outside of it
+	pthread_t readAheadThread;
+	pthread_mutex_t readAheadMutex;
+	pthread_cond_t requestCondition;
+	pthread_cond_t idleCondition;
+	int64_t requestedSector;
+	int64_t windowStart;
+	int64_t windowEnd;
+	int64_t readAheadHits;
+	int64_t readAheadMisses;
+	bool readAheadBusy;
+	bool readAheadQuit;
+
+	// Sector jobs waiting for the read-ahead worker, as a ring starting at
+	// jobStart - these are run ahead of read-ahead, and dropped if the ring
+	// is full
+	CDSectorJob jobs[PHILPSX_CD_JOB_COUNT];
+	int32_t jobStart;
+	int32_t jobCount;
 };
 
 /*
@@ -104,11 +202,57 @@ CD *construct_CD(void)
 	cd->cdFileDescriptor = 0;
 	cd->cdFileSize = 0;
 	cd->cdMapping = NULL;
+	cd->backend = NULL;
+	cd->image = NULL;
+	cd->sectorIndex = NULL;
+	cd->sectorCount = 0;
+	cd->requestedSector = -1;
+	cd->windowStart = 0;
+	cd->windowEnd = 0;
+	cd->readAheadHits = 0;
+	cd->readAheadMisses = 0;
+	cd->readAheadBusy = false;
+	cd->readAheadQuit = false;
+	cd->jobStart = 0;
+	cd->jobCount = 0;
+
+	// Setup and start read-ahead worker
+	if (pthread_mutex_init(&cd->readAheadMutex, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't create read-ahead mutex\n");
+		goto cleanup_tracklist;
+	}
+	if (pthread_cond_init(&cd->requestCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't create read-ahead request "
+				"condition variable\n");
+		goto cleanup_mutex;
+	}
+	if (pthread_cond_init(&cd->idleCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't create read-ahead idle "
+				"condition variable\n");
+		goto cleanup_requestcondition;
+	}
+	if (pthread_create(&cd->readAheadThread, NULL, &CD_readAheadFunction,
+			cd) != 0) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't start read-ahead thread\n");
+		goto cleanup_idlecondition;
+	}
 	
 	// Normal return:
 	return cd;
 	
 	// Cleanup path:
+	cleanup_idlecondition:
+	pthread_cond_destroy(&cd->idleCondition);
+
+	cleanup_requestcondition:
+	pthread_cond_destroy(&cd->requestCondition);
+
+	cleanup_mutex:
+	pthread_mutex_destroy(&cd->readAheadMutex);
+
+	cleanup_tracklist:
+	destruct_ArrayList(cd->trackList);
+
 	cleanup_cd:
 	free(cd);
 	cd = NULL;
@@ -122,6 +266,16 @@ CD *construct_CD(void)
  */
 void destruct_CD(CD *cd)
 {	
+	// Stop read-ahead worker before the mapping goes away
+	pthread_mutex_lock(&cd->readAheadMutex);
+	cd->readAheadQuit = true;
+	pthread_cond_signal(&cd->requestCondition);
+	pthread_mutex_unlock(&cd->readAheadMutex);
+	pthread_join(cd->readAheadThread, NULL);
+	pthread_cond_destroy(&cd->idleCondition);
+	pthread_cond_destroy(&cd->requestCondition);
+	pthread_mutex_destroy(&cd->readAheadMutex);
+
 	// Unmap CD file (if present)
 	if (cd->cdMapping) {
 		// Unmap the CD image from memory
@@ -136,9 +290,14 @@ void destruct_CD(CD *cd)
 					"destructor\n");
 		}
 	}
+
+	// Close compressed image (if present)
+	if (cd->image)
+		cd->backend->close(cd->image);
 	
-	// Destruct trackList array list
+	// Destruct trackList array list and sector index
 	destruct_ArrayList(cd->trackList);
+	free(cd->sectorIndex);
 	
 	// Free CD itself
 	free(cd);
@@ -150,7 +309,7 @@ void destruct_CD(CD *cd)
  */
 bool CD_isEmpty(CD *cd)
 {
-	return cd->cdMapping == NULL;
+	return cd->cdMapping == NULL && cd->image == NULL;
 }
 
 /*
@@ -162,11 +321,15 @@ bool CD_loadCD(CD *cd, const char *cdPath)
 	// Define various needed values
 	bool retVal = true;
 	size_t pathLength = strlen(cdPath);
-	int cueFileDescriptor = -1, cdFileDescriptor = -1;
-	LinkedList *cueLineAsList = NULL, *binPath = NULL;
+	int cdFileDescriptor = -1;
+	char *cueText = NULL;
 	ArrayList *trackList = NULL;
 	int8_t *cdMapping = NULL;
+	const CDBackend *backend = NULL;
+	void *image = NULL;
 	char *finalPath = NULL;
+	int64_t *sectorIndex = NULL;
+	size_t cdFileSize = 0;
 
 	// Check path isn't empty or not long enough
 	if (pathLength == 0) {
@@ -190,33 +353,13 @@ bool CD_loadCD(CD *cd, const char *cdPath)
 	// Display path
 	fprintf(stdout, "PhilPSX: CD: Cue file path is %s\n", cdPath);
 
-	// Open the cue file
-	cueFileDescriptor = open(cdPath, O_RDONLY);
-	if (cueFileDescriptor == -1) {
-		fprintf(stderr, "PhilPSX: CD: Couldn't open cue file\n");
-		goto cleanup_resources;
-	}
-
-	// Check if CUE file contains UTF-8 BOM, and advance past it if so
-	if (!CD_handleUtf8Bom(cueFileDescriptor)) {
-		fprintf(stderr, "PhilPSX: CD: Couldn't execute UTF-8 BOM routine\n");
-		goto cleanup_resources;
-	}
-
-	// Parse the binary file path
-	// Read line in one character at a time
-	cueLineAsList = construct_LinkedList(NULL, true, true);
-	if (!cueLineAsList) {
-		fprintf(stderr, "PhilPSX: CD: Couldn't allocate linked list to store "
-				"lines of cue file as we parse them\n");
-		goto cleanup_resources;
-	}
-	binPath = construct_LinkedList(NULL, true, true);
-	if (!binPath) {
-		fprintf(stderr, "PhilPSX: CD: Couldn't allocate linked list to store "
-				"path from cue file to binary CD image file\n");
+	// Read the whole cue file in, and skip the UTF-8 BOM if it has one
+	cueText = CD_readCueFile(cdPath);
+	if (!cueText) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't read cue file\n");
 		goto cleanup_resources;
 	}
+	char *cursor = CD_skipUtf8Bom(cueText);
 
 	// Construct new ArrayList to store paths
 	trackList = construct_ArrayList(&destruct_CDTrack_Passthrough, false, true);
@@ -226,245 +369,122 @@ bool CD_loadCD(CD *cd, const char *cdPath)
 		goto cleanup_resources;
 	}
 
-	// Keep reading until we get to end of line or file, searching for
-	// FILE header
-	bool binFound = false;
-	while (!binFound) {
-		LinkedList_wipeAllObjects(cueLineAsList);
-
-		// Read line from cue file
-		if (!CD_readLineToList(cueLineAsList, cueFileDescriptor)) {
-			fprintf(stderr, "PhilPSX: CD: Failed to read a line to the "
-					"linked list\n");
-			goto cleanup_resources;
-		}
-
-		// We have the line from the cue file, now lets trim it
-		CD_trimLinkedList(cueLineAsList);
-
-		// Convert line to C-style string to make use of standard
-		// library functions
-		char cueLine[LinkedList_getSize(cueLineAsList) + 1];
-		CD_convertListToString(cueLineAsList, cueLine);
-
-		// See if we have a FILE line
-		if (strstr(cueLine, "FILE") == cueLine) {
-			char *start = strchr(cueLine, '"');
-			char *end = strrchr(cueLine, '"');
-
-			if (start && end && start != end) {
-				// Valid file entry, isolate path
-				binFound = true;
-				++start;
-				*end = '\0';
-
-				// Copy binary path into linked list
-				size_t tempPathSize = strlen(start);
-				for (size_t i = 0; i < tempPathSize; ++i) {
-					if (!LinkedList_addObject(binPath,
-							(void *)(uintptr_t)start[i])) {
-						fprintf(stderr, "PhilPSX: CD: Couldn't add character "
-								"to linked list to form temporary path\n");
-						goto cleanup_resources;
-					}
-				}
-			}
-			else {
-				// Invalid file line, end search
+	// Keep reading lines until we find the FILE header, and isolate the
+	// path between its quotes
+	char *line;
+	char *binPath = NULL;
+	while (!binPath && (line = CD_nextLine(&cursor))) {
+		if (strstr(line, "FILE") == line) {
+			char *start = strchr(line, '"');
+			char *end = strrchr(line, '"');
+			if (!start || !end || start == end) {
 				fprintf(stderr, "PhilPSX: CD: FILE line in cue file "
 						"is malformed\n");
 				goto cleanup_resources;
 			}
+			binPath = start + 1;
+			*end = '\0';
 		}
 	}
-
-	// Prepend binPath with full path if needed
-	const char *lastSeparator = strrchr(cdPath, pathSeparator);
-	if (lastSeparator) {
-		// Prepend path to binPath here
-		++lastSeparator;
-		for (size_t i = 0; &cdPath[i] != lastSeparator; ++i) {
-			if (!LinkedList_addObjectAt(binPath, i,
-					(void *)(uintptr_t)cdPath[i])) {
-				fprintf(stderr, "PhilPSX: CD: Couldn't prepend character "
-						"to linked list to form full path\n");
-				goto cleanup_resources;
-			}
-		}
+	if (!binPath) {
+		fprintf(stderr, "PhilPSX: CD: No FILE line in cue file\n");
+		goto cleanup_resources;
 	}
 
-	// Convert linked list binPath to char array finalPath
-	finalPath = malloc(sizeof(char) * (LinkedList_getSize(binPath) + 1));
+	// Prepend binPath with the cue file's directory if needed
+	const char *lastSeparator = strrchr(cdPath, pathSeparator);
+	size_t directoryLength =
+			lastSeparator ? (size_t)(lastSeparator - cdPath + 1) : 0;
+	finalPath = malloc(directoryLength + strlen(binPath) + 1);
 	if (!finalPath) {
 		fprintf(stderr, "PhilPSX: CD: Couldn't allocate finalPath array\n");
 		goto cleanup_resources;
 	}
-	CD_convertListToString(binPath, finalPath);
-	fprintf(stdout, "PhilPSX: CD: Bin file path is %s\n", finalPath);
+	memcpy(finalPath, cdPath, directoryLength);
+	strcpy(finalPath + directoryLength, binPath);
 
-	// Open bin file, get size, and map it
-	size_t cdFileSize;
-	if (!CD_openBin(finalPath, &cdFileDescriptor, &cdFileSize, &cdMapping)) {
+	// Open compressed image if there is one, otherwise open bin file, get
+	// size, and map it
+	if (!CD_openImage(&finalPath, &backend, &image, &cdFileSize)) {
+		fprintf(stderr, "PhilPSX: CD: Failed to handle compressed image\n");
+		goto cleanup_resources;
+	}
+	fprintf(stdout, "PhilPSX: CD: Bin file path is %s\n", finalPath);
+	if (!image && !CD_openBin(finalPath, &cdFileDescriptor, &cdFileSize,
+			&cdMapping)) {
 		fprintf(stderr, "PhilPSX: CD: Failed to handle bin file\n");
 		goto cleanup_resources;
 	}
 
 	// Determine CD layout (this helps us later on to read bytes from the
-	// correct location) by continuing to parse the rest of the cue file
+	// correct location) by parsing the TRACK lines in the rest of the cue
+	// file, along with the PREGAP or INDEX line following each one
 	int64_t gap = 2352 * 150; // Two-second gap initially
-	bool cueFinished = false;
-	while (!cueFinished) {
-		LinkedList_wipeAllObjects(cueLineAsList);
-
-		// Read line from cue file
-		if (!CD_readLineToList(cueLineAsList, cueFileDescriptor)) {
-			fprintf(stderr, "PhilPSX: CD: Failed to read a line to the "
-					"linked list\n");
+	while ((line = CD_nextLine(&cursor))) {
+		if (strstr(line, "TRACK") != line)
+			continue;
+
+		// Check for type of track from the end of the line
+		char *typeWord = strrchr(line, ' ');
+		if (!typeWord) {
+			fprintf(stderr, "PhilPSX: CD: Malformed TRACK line\n");
 			goto cleanup_resources;
 		}
-		if (LinkedList_getSize(cueLineAsList) == 0) {
-			// Reached end of file
-			cueFinished = true;
-			break;
+		++typeWord;
+		int32_t type;
+		if (strstr(typeWord, "AUDIO") == typeWord)
+			type = PHILPSX_TRACKTYPE_AUDIO;
+		else if (strstr(typeWord, "MODE2/2352") == typeWord)
+			type = PHILPSX_TRACKTYPE_MODE2_2352;
+		else {
+			fprintf(stderr, "PhilPSX: CD: Unrecognised TRACK type\n");
+			goto cleanup_resources;
 		}
 
-		// We have the line from the cue file, now lets trim it
-		CD_trimLinkedList(cueLineAsList);
-
-		// Convert line to C-style string to make use of standard
-		// library functions
-		char trackLine[LinkedList_getSize(cueLineAsList) + 1];
-		CD_convertListToString(cueLineAsList, trackLine);
-
-		// Check if this is a TRACK line
-		if (strstr(trackLine, "TRACK") == trackLine) {
-			// Declare type of track
-			int32_t type;
-
-			// Check for type of track from cueLine
-			char *truncatedTrackLine = strrchr(trackLine, ' ');
-			if (truncatedTrackLine) {
-				// Check type
-				++truncatedTrackLine;
-				if (strstr(truncatedTrackLine, "AUDIO") == truncatedTrackLine)
-					type = PHILPSX_TRACKTYPE_AUDIO;
-				else if (strstr(truncatedTrackLine, "MODE2/2352") ==
-						truncatedTrackLine)
-					type = PHILPSX_TRACKTYPE_MODE2_2352;
-				else {
-					fprintf(stderr, "PhilPSX: CD: Unrecognised TRACK type\n");
-					goto cleanup_resources;
-				}
-
-				LinkedList_wipeAllObjects(cueLineAsList);
-
-				// Read the next line
-				if (!CD_readLineToList(cueLineAsList, cueFileDescriptor)) {
-					fprintf(stderr, "PhilPSX: CD: Failed to read a line to the "
-							"linked list\n");
-					goto cleanup_resources;
-				}
-				if (LinkedList_getSize(cueLineAsList) == 0) {
-					// Should be a line here, error out
-					fprintf(stderr, "PhilPSX: CD: No INDEX or PREGAP line\n");
-					goto cleanup_resources;
-				}
-
-				// We have the line from the cue file, now lets trim it
-				CD_trimLinkedList(cueLineAsList);
-
-				// Convert line to C-style string to make use of standard
-				// library functions
-				char trackLine[LinkedList_getSize(cueLineAsList) + 1];
-				CD_convertListToString(cueLineAsList, trackLine);
-
-				if (strstr(trackLine, "PREGAP") == trackLine) {
-
-					// Read PREGAP information
-					int minutes, seconds, frames;
-					if (!CD_getTimesFromLine(trackLine, &minutes,
-							&seconds, &frames)) {
-						fprintf(stderr, "PhilPSX: CD: Failed to read details "
-								"from PREGAP line\n");
-						goto cleanup_resources;
-					}
-
-					// Define tempGap
-					int64_t tempGap = frames * 2352 + seconds *176400 + minutes
-							* 10584000;
-					gap += tempGap;
-
-					LinkedList_wipeAllObjects(cueLineAsList);
-
-					// Read the next line
-					if (!CD_readLineToList(cueLineAsList, cueFileDescriptor)) {
-						fprintf(stderr, "PhilPSX: CD: Failed to read a line to "
-								"the linked list\n");
-						goto cleanup_resources;
-					}
-					if (LinkedList_getSize(cueLineAsList) == 0) {
-						fprintf(stderr, "PhilPSX: CD: No INDEX line after "
-								"PREGAP line\n");
-						goto cleanup_resources;
-					}
-
-					// We have the line from the cue file, now lets trim it
-					CD_trimLinkedList(cueLineAsList);
-
-					// Convert line to C-style string to make use of standard
-					// library functions
-					char trackLine[LinkedList_getSize(cueLineAsList) + 1];
-					CD_convertListToString(cueLineAsList, trackLine);
-
-					// Read track start information
-					if (!CD_getTimesFromLine(trackLine, &minutes,
-							&seconds, &frames)) {
-						fprintf(stderr, "PhilPSX: CD: Failed to read details "
-								"from INDEX line\n");
-						goto cleanup_resources;
-					}
-
-					// Calculate track start
-					int64_t trackStart = frames * 2352 + seconds * 176400 +
-							minutes * 10584000 + gap;
-
-					// Add track
-					if (!CD_addTrackToList(trackList, type, trackStart - tempGap
-							- 1, trackStart, gap)) {
-						fprintf(stderr, "PhilPSX: CD: Failed to add a track to "
-								"the list\n");
-						goto cleanup_resources;
-					}
-				}
-				else {
-
-					// Read track start information
-					int minutes, seconds, frames;
-					if (!CD_getTimesFromLine(trackLine, &minutes,
-							&seconds, &frames)) {
-						fprintf(stderr, "PhilPSX: CD: Failed to read details "
-								"from INDEX line\n");
-						goto cleanup_resources;
-					}
-
-					// Calculate track start
-					int64_t trackStart = frames * 2352 + seconds * 176400 +
-							minutes * 10584000 + gap;
-
-					// Add track
-					if (!CD_addTrackToList(trackList, type, trackStart - 1,
-							trackStart, gap)) {
-						fprintf(stderr, "PhilPSX: CD: Failed to add a track to "
-								"the list\n");
-						goto cleanup_resources;
-					}
-				}
+		// Read the next line
+		line = CD_nextLine(&cursor);
+		if (!line) {
+			fprintf(stderr, "PhilPSX: CD: No INDEX or PREGAP line\n");
+			goto cleanup_resources;
+		}
+
+		// Read PREGAP information if present, which adds to the gap and
+		// must be followed by the INDEX line
+		int minutes, seconds, frames;
+		int64_t tempGap = 0;
+		if (strstr(line, "PREGAP") == line) {
+			if (!CD_getTimesFromLine(line, &minutes, &seconds, &frames)) {
+				fprintf(stderr, "PhilPSX: CD: Failed to read details "
+						"from PREGAP line\n");
+				goto cleanup_resources;
 			}
-			else {
-				fprintf(stderr, "PhilPSX: CD: Malformed TRACK line\n");
+			tempGap = frames * 2352 + seconds * 176400 + minutes * 10584000;
+			gap += tempGap;
+
+			line = CD_nextLine(&cursor);
+			if (!line) {
+				fprintf(stderr, "PhilPSX: CD: No INDEX line after "
+						"PREGAP line\n");
 				goto cleanup_resources;
 			}
 		}
+
+		// Read track start information
+		if (!CD_getTimesFromLine(line, &minutes, &seconds, &frames)) {
+			fprintf(stderr, "PhilPSX: CD: Failed to read details "
+					"from INDEX line\n");
+			goto cleanup_resources;
+		}
+
+		// Calculate track start, and add track
+		int64_t trackStart = frames * 2352 + seconds * 176400 +
+				minutes * 10584000 + gap;
+		if (!CD_addTrackToList(trackList, type, trackStart - tempGap - 1,
+				trackStart, gap)) {
+			fprintf(stderr, "PhilPSX: CD: Failed to add a track to "
+					"the list\n");
+			goto cleanup_resources;
+		}
 	}
 
 	// Calculate end of last track
@@ -478,25 +498,25 @@ bool CD_loadCD(CD *cd, const char *cdPath)
 		goto cleanup_resources;
 	}
 
+	// Build sector index from track list
+	int64_t sectorCount;
+	sectorIndex = CD_buildSectorIndex(trackList, cdFileSize, &sectorCount);
+	if (!sectorIndex) {
+		fprintf(stderr, "PhilPSX: CD: Failed to build sector index\n");
+		goto cleanup_resources;
+	}
+
 	// Swap values
-	if (!CD_swapState(cd, cdFileDescriptor, cdFileSize, cdMapping, trackList)) {
+	if (!CD_swapState(cd, cdFileDescriptor, cdFileSize, cdMapping, backend,
+			image, trackList, sectorIndex, sectorCount)) {
 		fprintf(stderr, "PhilPSX: CD: Failed to swap state over to new file\n");
 		goto cleanup_resources;
 	}
 	
 	// Normal return:
 	
-	// Close cue file
-	if (close(cueFileDescriptor) != 0) {
-		fprintf(stderr, "PhilPSX: CD: Couldn't close cue file during "
-				"error cleanup\n");
-	}
-	
-	// Ckeanup linked lists
-	destruct_LinkedList(binPath);
-	destruct_LinkedList(cueLineAsList);
-	
-	// Cleanup finalPath
+	// Cleanup cue file text and finalPath
+	free(cueText);
 	free(finalPath);
 	
 	return retVal;
@@ -518,28 +538,36 @@ bool CD_loadCD(CD *cd, const char *cdPath)
 					"error cleanup\n");
 		}
 	}
+
+	if (image)
+		backend->close(image);
 	
 	if (trackList)
 		destruct_ArrayList(trackList);
-	if (binPath)
-		destruct_LinkedList(binPath);
-	if (cueLineAsList)
-		destruct_LinkedList(cueLineAsList);
 	if (finalPath)
 		free(finalPath);
-	
-	if (cueFileDescriptor != -1) {
-		// Close file
-		if (close(cueFileDescriptor) != 0) {
-			fprintf(stderr, "PhilPSX: CD: Couldn't close cue file during "
-					"error cleanup\n");
-		}
-	}
+	if (sectorIndex)
+		free(sectorIndex);
+	if (cueText)
+		free(cueText);
 
 	retVal = false;
 	return retVal;
 }
 
+/*
+ * This function returns a pointer to the specified raw sector within the
+ * mapped image, or NULL if the image doesn't hold all of it.
+ */
+const int8_t *CD_getSector(CD *cd, int64_t sector)
+{
+	int64_t start = CD_findSector(cd, sector);
+	if (start == -1 || !cd->cdMapping)
+		return NULL;
+
+	return cd->cdMapping + start;
+}
+
 /*
  * This function reads a byte from the CD image file.
  */
@@ -548,13 +576,16 @@ int8_t CD_readByte(CD *cd, int64_t position)
 	// Declare return value
 	int8_t retVal = 0;
 
-	for (int i = 0; i < ArrayList_getSize(cd->trackList); ++i) {
-		CDTrack *cdt = ArrayList_getObject(cd->trackList, i);
-		if (CDTrack_isWithin(cdt, position)) {
-			position -= cdt->offset;
-			retVal = cd->cdMapping[(int32_t)position];
-			break;
-		}
+	// Look up sector, and read byte if the image holds it
+	int64_t sector = position / PHILPSX_CD_RAW_SECTOR_SIZE;
+	if (position >= 0 && sector < cd->sectorCount &&
+			cd->sectorIndex[sector] != -1) {
+		int64_t offset = cd->sectorIndex[sector] +
+				position % PHILPSX_CD_RAW_SECTOR_SIZE;
+		if (offset < (int64_t)cd->cdFileSize && cd->cdMapping)
+			retVal = cd->cdMapping[offset];
+		else if (offset < (int64_t)cd->cdFileSize && cd->image)
+			cd->backend->read(cd->image, offset, &retVal, 1);
 	}
 
 	// Return byte
@@ -562,75 +593,85 @@ int8_t CD_readByte(CD *cd, int64_t position)
 }
 
 /*
- * This function operates under the assumption that the void * pointer inside
- * each node of the list is actually storing a type-casted char value rather
- * than a valid pointer. It trims spaces and tabs from the ends of the list
- * based on this assumption.
+ * This function reads the part of the specified sector given by mode into
+ * dst - either the 2048 bytes of user data, or the 2340 bytes following the
+ * sync pattern. Anything the image doesn't hold reads as zero. Unlike
+ * CD_getSector, this works for compressed images too. It returns the number
+ * of bytes read.
  */
-static void CD_trimLinkedList(LinkedList *list)
+int32_t CD_readSector(CD *cd, int64_t sector, int8_t *dst, int32_t mode)
 {
-	// Declare variables to store temporary char and size of the list
-	char c;
-	size_t listSize;
-
-	// Trim from beginning
-	while ((listSize = LinkedList_getSize(list)) > 0) {
-		c = (char)(uintptr_t)LinkedList_getObject(list, 0);
-		if (c == ' ' || c == '\t')
-			LinkedList_removeObject(list, 0);
-		else
-			break;
+	// Work out which part of the sector we want
+	int32_t start = PHILPSX_CD_DATA_SECTOR_START;
+	int32_t length = PHILPSX_CD_DATA_SECTOR_SIZE;
+	if (mode == PHILPSX_CD_SECTOR_WHOLE) {
+		start = PHILPSX_CD_WHOLE_SECTOR_START;
+		length = PHILPSX_CD_WHOLE_SECTOR_SIZE;
 	}
 
-	// Trim from end
-	while ((listSize = LinkedList_getSize(list)) > 0) {
-		c = (char)(uintptr_t)LinkedList_getObject(list, listSize - 1);
-		if (c == ' ' || c == '\t')
-			LinkedList_removeObject(list, listSize - 1);
-		else
-			break;
+	// Copy sector in one go where possible, otherwise read it byte by byte
+	// as it runs off the end of the image or lies outside the tracks
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	int64_t sectorStart = CD_findSector(cd, sector);
+	if (sectorStart != -1 && cd->cdMapping) {
+		memcpy(dst, cd->cdMapping + sectorStart + start, length);
+	} else if (sectorStart != -1) {
+		cd->backend->read(cd->image, sectorStart + start, dst, length);
+	} else {
+		int64_t position = sector * PHILPSX_CD_RAW_SECTOR_SIZE + start;
+		for (int32_t i = 0; i < length; ++i)
+			dst[i] = CD_readByte(cd, position + i);
 	}
+	PHILPSX_TRACE_END(PHILPSX_TRACE_CD_SECTOR, traceStart, (int32_t)sector);
+
+	return length;
 }
 
 /*
- * This function reads a line (as chars) from a file referenced by the supplied
- * file descriptor into the linked list referenced by list.
+ * This function asks the read-ahead worker to read the whole of the specified
+ * raw sector, and pass it to callback along with arg. It returns straight
+ * away, and the callback runs on the read-ahead thread. Jobs run in the order
+ * they are asked for, and are dropped if too many are waiting.
  */
-static bool CD_readLineToList(LinkedList *list, int fileDescriptor)
+void CD_readSectorAsync(CD *cd, int64_t sector, CDSectorCallback callback,
+		void *arg)
 {
-	// Define return value with default value of success
-	bool retVal = true;
-
-	while (true) {
-		char c;
-		ssize_t readResult = read(fileDescriptor, &c, 1);
-		if (readResult == -1) {
-			// Failed to read file, set retVal to false
-			fprintf(stderr, "PhilPSX: CD: Error reading file\n");
-			retVal = false;
-			break;
-		}
-		else if (readResult == 0) {
-			// No more bytes, break
-			break;
-		}
-		else if (c != '\n') {
-			if (!LinkedList_addObject(list, (void *)(uintptr_t)c)) {
-				// Failed to allocate memory for char in list so
-				// set retVal to false
-				fprintf(stderr, "PhilPSX: CD: Couldn't add character "
-						"to linked list from file\n");
-				retVal = false;
-			}
-			// Keep going, no break
-		}
-		else {
-			// Character was a newline, break
-			break;
-		}
+	pthread_mutex_lock(&cd->readAheadMutex);
+	if (cd->jobCount < PHILPSX_CD_JOB_COUNT) {
+		CDSectorJob *job = &cd->jobs[(cd->jobStart + cd->jobCount) %
+				PHILPSX_CD_JOB_COUNT];
+		job->sector = sector;
+		job->callback = callback;
+		job->arg = arg;
+		++cd->jobCount;
+		pthread_cond_signal(&cd->requestCondition);
 	}
+	pthread_mutex_unlock(&cd->readAheadMutex);
+}
 
-	return retVal;
+/*
+ * This function asks the read-ahead worker to page in the sectors from the
+ * specified one onwards, ahead of them being read. It returns straight away.
+ */
+void CD_prefetch(CD *cd, int64_t sector)
+{
+	pthread_mutex_lock(&cd->readAheadMutex);
+	if (sector < cd->windowStart ||
+			sector >= cd->windowEnd - PHILPSX_CD_READAHEAD_SECTORS / 2)
+		CD_requestReadAhead(cd, sector);
+	pthread_mutex_unlock(&cd->readAheadMutex);
+}
+
+/*
+ * This function gets the number of sector reads that were already paged in
+ * by the read-ahead worker, and the number that weren't.
+ */
+void CD_getReadAheadStats(CD *cd, int64_t *hits, int64_t *misses)
+{
+	pthread_mutex_lock(&cd->readAheadMutex);
+	*hits = cd->readAheadHits;
+	*misses = cd->readAheadMisses;
+	pthread_mutex_unlock(&cd->readAheadMutex);
 }
 
 /*
@@ -687,11 +728,15 @@ static bool CD_getTimesFromLine(char *line, int *minutes,
  * before replacing it with the new state.
  */
 static bool CD_swapState(CD *cd, int cdFileDescriptor, size_t cdFileSize,
-		int8_t *cdMapping, ArrayList *trackList)
+		int8_t *cdMapping, const CDBackend *backend, void *image,
+		ArrayList *trackList, int64_t *sectorIndex, int64_t sectorCount)
 {
 	// Define return value set to default of true
 	bool retVal = true;
 
+	// Make sure the read-ahead worker has finished with the old image
+	CD_waitForReadAhead(cd);
+
 	// Close an existing image if it is loaded, and swap new values in
 	if (cd->cdMapping) {
 
@@ -711,15 +756,22 @@ static bool CD_swapState(CD *cd, int cdFileDescriptor, size_t cdFileSize,
 		// Destruct track list
 		destruct_ArrayList(cd->trackList);
 	} else {
-		// Just destruct track list
+		// Close compressed image if it is loaded, and destruct track list
+		if (cd->image)
+			cd->backend->close(cd->image);
 		destruct_ArrayList(cd->trackList);
 	}
 	
 	// Swap values over
+	free(cd->sectorIndex);
+	cd->sectorIndex = sectorIndex;
+	cd->sectorCount = sectorCount;
 	cd->trackList = trackList;
 	cd->cdFileDescriptor = cdFileDescriptor;
 	cd->cdFileSize = cdFileSize;
 	cd->cdMapping = cdMapping;
+	cd->backend = backend;
+	cd->image = image;
 
 	// Normal return:
 	return retVal;
@@ -730,19 +782,6 @@ static bool CD_swapState(CD *cd, int cdFileDescriptor, size_t cdFileSize,
 	return retVal;
 }
 
-/*
- * This function takes a linked list representing a group of chars, and
- * deposits it into the destination buffer in C-style string format with
- * a null terminator.
- */
-static void CD_convertListToString(LinkedList *list, char *dst)
-{
-	size_t listSize = LinkedList_getSize(list);
-	for (size_t i = 0; i < listSize; ++i)
-		dst[i] = (char)(uintptr_t)LinkedList_getObject(list, i);
-	dst[listSize] = '\0';
-}
-
 /*
  * This function opens a bin file, gets its size, and maps it into the address
  * space using mmap. It returns the descriptor, size and mapping by
@@ -839,36 +878,403 @@ static bool CD_addTrackToList(ArrayList *trackList, int32_t type,
 }
 
 /*
- * This function handles the presence of a UTF-8 byte order mark by advancing
- * the marker in the cue file past it if present.
+ * This function reads the whole of the cue file at the specified path into
+ * a newly allocated buffer, adding a null terminator. It returns NULL if the
+ * file couldn't be read.
  */
-static bool CD_handleUtf8Bom(int cueFileDescriptor)
+static char *CD_readCueFile(const char *path)
 {
-	// Define return value with default of true
-	bool retVal = true;
-	
-	char bom[3];
-	ssize_t readResult = read(cueFileDescriptor, bom, 3);
-	if (readResult != 3) {
-		fprintf(stderr, "PhilPSX: CD: Couldn't check cue file for UTF-8 BOM\n");
+	char *text = NULL;
+
+	int cueFileDescriptor = open(path, O_RDONLY);
+	if (cueFileDescriptor == -1) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't open cue file\n");
 		goto end;
 	}
-	if (!(bom[0] == 0xEF && bom[1] == 0xBB && bom[2] == 0xBF)) {
-		// BOM wasn't detected, seek back to start of file
-		if (lseek(cueFileDescriptor, 0, SEEK_SET) == -1) {
-			fprintf(stderr, "PhilPSX: CD: Couldn't seek back to beginning of "
-					"cue file\n");
-			goto end;
+	off_t cueFileSize = lseek(cueFileDescriptor, 0, SEEK_END);
+	if (cueFileSize == -1 || lseek(cueFileDescriptor, 0, SEEK_SET) == -1) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't find size of cue file\n");
+		goto cleanup_openfile;
+	}
+	text = malloc((size_t)cueFileSize + 1);
+	if (!text) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't allocate memory for cue "
+				"file\n");
+		goto cleanup_openfile;
+	}
+
+	// Read until we have the whole file
+	size_t length = 0;
+	while (length < (size_t)cueFileSize) {
+		ssize_t readResult = read(cueFileDescriptor, text + length,
+				(size_t)cueFileSize - length);
+		if (readResult == -1) {
+			fprintf(stderr, "PhilPSX: CD: Error reading file\n");
+			free(text);
+			text = NULL;
+			goto cleanup_openfile;
+		}
+		else if (readResult == 0) {
+			// File got shorter, so stop here
+			break;
 		}
+		length += (size_t)readResult;
 	}
-	
-	// Normal return
-	return retVal;
-	
+	text[length] = '\0';
+
 	// Cleanup path:
+	cleanup_openfile:
+	if (close(cueFileDescriptor) != 0) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't close cue file\n");
+	}
+
 	end:
-	retVal = false;
-	return retVal;
+	return text;
+}
+
+/*
+ * This function returns the cue file text past its UTF-8 byte order mark, if
+ * it has one.
+ */
+static char *CD_skipUtf8Bom(char *text)
+{
+	const uint8_t *bom = (const uint8_t *)text;
+	if (bom[0] == 0xEF && bom[1] == 0xBB && bom[2] == 0xBF)
+		return text + 3;
+	return text;
+}
+
+/*
+ * This function splits the next line from the cue file text at cursor,
+ * trimming spaces and tabs from both ends of it in place, and moves cursor
+ * on to the line after. It returns NULL once there are no lines left.
+ */
+static char *CD_nextLine(char **cursor)
+{
+	char *line = *cursor;
+	if (*line == '\0')
+		return NULL;
+
+	// Terminate line, and move on past it
+	char *end = strchr(line, '\n');
+	if (end) {
+		*end = '\0';
+		*cursor = end + 1;
+	} else {
+		end = line + strlen(line);
+		*cursor = end;
+	}
+
+	// Trim from beginning and end
+	while (*line == ' ' || *line == '\t')
+		++line;
+	while (end > line && (end[-1] == ' ' || end[-1] == '\t'))
+		*--end = '\0';
+
+	return line;
+}
+
+/*
+ * This function builds the sector index for a track list, covering every
+ * sector up to the end of the last track. It returns NULL if the index
+ * couldn't be allocated.
+ */
+static int64_t *CD_buildSectorIndex(ArrayList *trackList, size_t cdFileSize,
+		int64_t *sectorCount)
+{
+	// Allocate index, with every sector outside a track to begin with
+	CDTrack *lastTrack =
+		ArrayList_getObject(trackList, ArrayList_getSize(trackList) - 1);
+	int64_t count = lastTrack->trackEnd / PHILPSX_CD_RAW_SECTOR_SIZE + 1;
+	int64_t *sectorIndex = malloc(sizeof(int64_t) * count);
+	if (!sectorIndex) {
+		fprintf(stderr, "PhilPSX: CD: Couldn't allocate memory for sector "
+				"index\n");
+		goto end;
+	}
+	for (int64_t i = 0; i < count; ++i)
+		sectorIndex[i] = -1;
+
+	// Fill in the sectors each track covers - tracks start and end on
+	// sector boundaries, apart from the end of the last one if the image
+	// ends part way through a sector
+	for (int i = 0; i < ArrayList_getSize(trackList); ++i) {
+		CDTrack *cdt = ArrayList_getObject(trackList, i);
+		for (int64_t position = cdt->trackStart; position <= cdt->trackEnd;
+				position += PHILPSX_CD_RAW_SECTOR_SIZE) {
+			int64_t start = position - cdt->offset;
+			if (start >= 0 && start < (int64_t)cdFileSize)
+				sectorIndex[position / PHILPSX_CD_RAW_SECTOR_SIZE] = start;
+		}
+	}
+	*sectorCount = count;
+
+	end:
+	return sectorIndex;
+}
+
+/*
+ * This function passes a read-ahead request to the worker, replacing any it
+ * hasn't picked up yet. The read-ahead mutex must be held by the caller.
+ */
+static void CD_requestReadAhead(CD *cd, int64_t sector)
+{
+	if (cd->requestedSector != sector) {
+		cd->requestedSector = sector;
+		pthread_cond_signal(&cd->requestCondition);
+	}
+}
+
+/*
+ * This function drops any outstanding read-ahead request or sector jobs, and
+ * waits for the worker to go idle, emptying the window. After this, the worker won't touch
+ * the image until asked again.
+ */
+static void CD_waitForReadAhead(CD *cd)
+{
+	pthread_mutex_lock(&cd->readAheadMutex);
+	cd->requestedSector = -1;
+	cd->jobCount = 0;
+	while (cd->readAheadBusy)
+		pthread_cond_wait(&cd->idleCondition, &cd->readAheadMutex);
+	cd->windowStart = 0;
+	cd->windowEnd = 0;
+	pthread_mutex_unlock(&cd->readAheadMutex);
+}
+
+/*
+ * This function is the body of the read-ahead thread. It runs any sector
+ * jobs first, as something is waiting on them. For each read-ahead request,
+ * it advises the kernel that the image range covering the next sectors will
+ * be needed, then touches every page of it so that any faults are taken here.
+ */
+static void *CD_readAheadFunction(void *arg)
+{
+	CD *cd = arg;
+	int64_t pageSize = sysconf(_SC_PAGESIZE);
+	TraceEvents_setThreadName("cd read-ahead");
+
+	for (;;) {
+
+		// Wait for the next request, or for the signal to quit
+		pthread_mutex_lock(&cd->readAheadMutex);
+		while (!cd->readAheadQuit && cd->requestedSector == -1 &&
+				cd->jobCount == 0)
+			pthread_cond_wait(&cd->requestCondition, &cd->readAheadMutex);
+		if (cd->readAheadQuit) {
+			pthread_mutex_unlock(&cd->readAheadMutex);
+			break;
+		}
+
+		// Run the oldest sector job if there is one
+		if (cd->jobCount > 0) {
+			CDSectorJob job = cd->jobs[cd->jobStart];
+			cd->jobStart = (cd->jobStart + 1) % PHILPSX_CD_JOB_COUNT;
+			--cd->jobCount;
+			cd->readAheadBusy = true;
+			pthread_mutex_unlock(&cd->readAheadMutex);
+
+			CD_runSectorJob(cd, &job);
+
+			pthread_mutex_lock(&cd->readAheadMutex);
+			cd->readAheadBusy = false;
+			pthread_cond_broadcast(&cd->idleCondition);
+			pthread_mutex_unlock(&cd->readAheadMutex);
+			continue;
+		}
+		int64_t start = cd->requestedSector;
+		int64_t end = min_value(start + PHILPSX_CD_READAHEAD_SECTORS,
+				cd->sectorCount);
+		cd->requestedSector = -1;
+		cd->readAheadBusy = true;
+		pthread_mutex_unlock(&cd->readAheadMutex);
+
+		// Find the image range the sectors cover - tracks are stored in
+		// order, so this runs from the first sector held to the last
+		int64_t first = -1, last = -1;
+		for (int64_t sector = start; sector < end; ++sector) {
+			if (cd->sectorIndex[sector] == -1)
+				continue;
+			if (first == -1)
+				first = cd->sectorIndex[sector];
+			last = cd->sectorIndex[sector];
+		}
+
+		// Decode range into the backend's cache for compressed images,
+		// otherwise page it in, if there is any of it
+		if (first != -1 && cd->image) {
+			cd->backend->prefetch(cd->image, first,
+					last + PHILPSX_CD_RAW_SECTOR_SIZE - first);
+		} else if (first != -1) {
+			int64_t rangeStart = first & ~(pageSize - 1);
+			int64_t rangeEnd = min_value(last + PHILPSX_CD_RAW_SECTOR_SIZE,
+					(int64_t)cd->cdFileSize);
+			madvise(cd->cdMapping + rangeStart, rangeEnd - rangeStart,
+					MADV_WILLNEED);
+			for (int64_t i = rangeStart; i < rangeEnd; i += pageSize)
+				(void)*(volatile int8_t *)(cd->cdMapping + i);
+		}
+
+		// Record window, and tell anyone waiting that we are idle
+		pthread_mutex_lock(&cd->readAheadMutex);
+		cd->windowStart = start;
+		cd->windowEnd = end;
+		cd->readAheadBusy = false;
+		pthread_cond_broadcast(&cd->idleCondition);
+		pthread_mutex_unlock(&cd->readAheadMutex);
+	}
+
+	return NULL;
+}
+
+/*
+ * This function reads the whole of a job's raw sector and passes it to the
+ * job's callback. Anything the image doesn't hold reads as zero. The sector
+ * is looked up directly rather than through CD_findSector, so that it
+ * doesn't count towards the read-ahead statistics.
+ */
+static void CD_runSectorJob(CD *cd, CDSectorJob *job)
+{
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	int8_t sector[PHILPSX_CD_RAW_SECTOR_SIZE];
+	int64_t start = -1;
+	if (job->sector >= 0 && job->sector < cd->sectorCount)
+		start = cd->sectorIndex[job->sector];
+
+	if (start == -1 ||
+			start + PHILPSX_CD_RAW_SECTOR_SIZE > (int64_t)cd->cdFileSize)
+		memset(sector, 0, sizeof(sector));
+	else if (cd->cdMapping)
+		memcpy(sector, cd->cdMapping + start, sizeof(sector));
+	else
+		cd->backend->read(cd->image, start, sector, sizeof(sector));
+	PHILPSX_TRACE_END(PHILPSX_TRACE_CD_SECTOR, traceStart,
+			(int32_t)job->sector);
+
+	job->callback(job->arg, sector);
+}
+
+/*
+ * This function finds the position of the specified sector within the
+ * image, or -1 if the image doesn't hold all of it. As every sector read
+ * comes through here, it also counts whether read-ahead had already brought
+ * the sector in, and keeps read-ahead going once reading is half way
+ * through the window.
+ */
+static int64_t CD_findSector(CD *cd, int64_t sector)
+{
+	if (sector < 0 || sector >= cd->sectorCount)
+		return -1;
+
+	pthread_mutex_lock(&cd->readAheadMutex);
+	if (sector >= cd->windowStart && sector < cd->windowEnd)
+		++cd->readAheadHits;
+	else
+		++cd->readAheadMisses;
+	if (sector < cd->windowStart ||
+			sector >= cd->windowEnd - PHILPSX_CD_READAHEAD_SECTORS / 2)
+		CD_requestReadAhead(cd, sector);
+	pthread_mutex_unlock(&cd->readAheadMutex);
+
+	int64_t start = cd->sectorIndex[sector];
+	if (start == -1 ||
+			start + PHILPSX_CD_RAW_SECTOR_SIZE > (int64_t)cd->cdFileSize)
+		return -1;
+
+	return start;
+}
+
+/*
+ * This function finds the backend for the image type of the specified path,
+ * or NULL if it isn't a compressed image.
+ */
+static const CDBackend *CD_findBackend(const char *path)
+{
+	size_t pathLength = strlen(path);
+	for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+		size_t endingLength = strlen(backends[i].fileEnding);
+		if (pathLength > endingLength && strcmp(path + pathLength -
+				endingLength, backends[i].fileEnding) == 0)
+			return &backends[i];
+	}
+	return NULL;
+}
+
+/*
+ * This function opens the image at the specified path through a backend, if
+ * it is a compressed image. Cue files often still name the uncompressed
+ * image, so if that doesn't exist, each backend's file ending is tried on
+ * the end of it too, updating the path to match. It leaves image as NULL for
+ * uncompressed images, and returns false if a compressed image couldn't be
+ * opened.
+ */
+static bool CD_openImage(char **path, const CDBackend **backend, void **image,
+		size_t *cdFileSize)
+{
+	// Look for compressed image alongside a missing bin file
+	const CDBackend *imageBackend = CD_findBackend(*path);
+	size_t pathLength = strlen(*path);
+	for (size_t i = 0; !imageBackend && access(*path, F_OK) != 0 &&
+			i < sizeof(backends) / sizeof(backends[0]); ++i) {
+		size_t endingLength = strlen(backends[i].fileEnding);
+		char *tempPath = malloc(pathLength + endingLength + 1);
+		if (!tempPath) {
+			fprintf(stderr, "PhilPSX: CD: Couldn't allocate compressed image "
+					"path\n");
+			return false;
+		}
+		memcpy(tempPath, *path, pathLength);
+		memcpy(tempPath + pathLength, backends[i].fileEnding,
+				endingLength + 1);
+		if (access(tempPath, F_OK) == 0) {
+			free(*path);
+			*path = tempPath;
+			imageBackend = &backends[i];
+		} else {
+			free(tempPath);
+		}
+	}
+
+	// Open compressed image through its backend
+	if (imageBackend) {
+		void *tempImage = imageBackend->open(*path);
+		if (!tempImage)
+			return false;
+		*backend = imageBackend;
+		*image = tempImage;
+		*cdFileSize = (size_t)imageBackend->getSize(tempImage);
+	}
+
+	return true;
+}
+
+/*
+ * These functions allow the CDEcm functions to be used through a backend.
+ */
+static void *CD_ecmOpen(const char *path)
+{
+	return construct_CDEcm(path);
+}
+
+static void CD_ecmClose(void *image)
+{
+	destruct_CDEcm((CDEcm *)image);
+}
+
+static int64_t CD_ecmGetSize(void *image)
+{
+	return CDEcm_getSize((CDEcm *)image);
+}
+
+static void CD_ecmRead(void *image, int64_t position, int8_t *dst,
+		int32_t length)
+{
+	CDEcm_read((CDEcm *)image, position, dst, length);
+}
+
+static void CD_ecmPrefetch(void *image, int64_t position, int64_t length)
+{
+	CDEcm_prefetch((CDEcm *)image, position, length);
 }
 
 /*
@@ -912,12 +1318,3 @@ static void destruct_CDTrack_Passthrough(void *cdt)
 {
 	destruct_CDTrack((CDTrack *)cdt);
 }
-
-/*
- * This function tells us whether the supplied byte reference is within
- * this track.
- */
-static bool CDTrack_isWithin(CDTrack *cdt, int64_t position)
-{
-	return position >= cdt->trackStart && position <= cdt->trackEnd;
-}
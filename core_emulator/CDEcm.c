@@ -0,0 +1,631 @@
+/*
+ * This C file models an ECM compressed CD image as a class. ECM leaves out
+ * the sync pattern, EDC and ECC of each data sector it recognises, as these
+ * can be generated again from the rest of the sector. On construction, the
+ * file is mapped and every record in it is indexed, so that any part of the
+ * original image can be found without decoding what comes before it. Reads
+ * are then served from a cache of decoded hunks, with the least recently
+ * used hunk making way once the cache is full.
+ *
+ * CDEcm.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../headers/CDEcm.h"
+#include "../headers/math_utils.h"
+
+// Record types, and the number of bytes each unit of them takes up in the
+// file and in the decoded image
+#define PHILPSX_CDECM_LITERAL 0
+#define PHILPSX_CDECM_MODE1 1
+#define PHILPSX_CDECM_MODE2_FORM1 2
+#define PHILPSX_CDECM_MODE2_FORM2 3
+#define PHILPSX_CDECM_RAW_SECTOR_SIZE 2352
+#define PHILPSX_CDECM_MODE2_SECTOR_SIZE 2336
+
+// Size of each decoded hunk, and the memory budget for the hunk cache
+#define PHILPSX_CDECM_HUNK_SIZE (PHILPSX_CDECM_RAW_SECTOR_SIZE * 8)
+#define PHILPSX_CDECM_CACHE_BUDGET (16 * 1024 * 1024)
+
+// Marker for a hunk not in the cache
+#define PHILPSX_CDECM_NOT_CACHED -1
+
+// Forward declarations for functions and subcomponents private to this class
+// Decoding stuff:
+typedef struct CDEcmRecord CDEcmRecord;
+static bool CDEcm_buildIndex(CDEcm *ecm);
+static void CDEcm_decode(CDEcm *ecm, int64_t position, int8_t *dst,
+		int64_t length);
+static void CDEcm_decodeSector(CDEcm *ecm, const CDEcmRecord *record,
+		int64_t unit, uint8_t *sector);
+static int32_t CDEcm_getInputSize(int32_t type);
+static int32_t CDEcm_getOutputSize(int32_t type);
+
+// EDC and ECC stuff:
+static void CDEcm_generateEcc(CDEcm *ecm, uint8_t *sector, bool zeroAddress);
+static void CDEcm_generateEccBlock(CDEcm *ecm, const uint8_t *src,
+		int32_t majorCount, int32_t minorCount, int32_t majorMult,
+		int32_t minorInc, uint8_t *dst);
+static void CDEcm_generateEccEdc(CDEcm *ecm, uint8_t *sector, int32_t type);
+static uint32_t CDEcm_generateEdc(CDEcm *ecm, const uint8_t *src,
+		int32_t size);
+static void CDEcm_initTables(CDEcm *ecm);
+
+// Cache stuff:
+typedef struct CDEcmHunk CDEcmHunk;
+static CDEcmHunk *CDEcm_getHunk(CDEcm *ecm, int64_t hunk);
+
+/*
+ * This struct stores a record of the ECM file - a run of units of one type,
+ * where each unit is a byte for literal records and a sector otherwise.
+ */
+struct CDEcmRecord {
+	int64_t outputStart;
+	int64_t inputStart;
+	uint32_t count;
+	int32_t type;
+};
+
+/*
+ * This struct stores a decoded hunk in the cache.
+ */
+struct CDEcmHunk {
+	int64_t hunk;
+	int64_t lastUse;
+	int8_t *data;
+};
+
+/*
+ * This struct models an ECM image.
+ */
+struct CDEcm {
+
+	// This stores the file descriptor, size and mapping of the ECM file
+	int fileDescriptor;
+	size_t fileSize;
+	const uint8_t *mapping;
+
+	// This stores the index of records, and the size of the decoded image
+	CDEcmRecord *records;
+	int64_t recordCount;
+	int64_t size;
+
+	// Hunk cache - slots maps each hunk of the image to the cache entry
+	// holding it, and the counter stamps each use so the least recently
+	// used entry can be found
+	pthread_mutex_t cacheMutex;
+	CDEcmHunk *cache;
+	int8_t *cacheData;
+	int32_t cacheCount;
+	int32_t *slots;
+	int64_t hunkCount;
+	int64_t useCounter;
+
+	// Lookup tables for generating EDC and ECC
+	uint8_t eccForward[256];
+	uint8_t eccBackward[256];
+	uint32_t edcTable[256];
+};
+
+/*
+ * This constructs a CDEcm object from the ECM file at the specified path,
+ * returning NULL if it couldn't be opened or isn't a valid ECM file.
+ */
+CDEcm *construct_CDEcm(const char *path)
+{
+	// Allocate CDEcm struct
+	CDEcm *ecm = calloc(1, sizeof(CDEcm));
+	if (!ecm) {
+		fprintf(stderr, "PhilPSX: CDEcm: Couldn't allocate memory for "
+				"CDEcm struct\n");
+		goto end;
+	}
+	CDEcm_initTables(ecm);
+
+	// Open file, get size, and map it
+	ecm->fileDescriptor = open(path, O_RDONLY);
+	if (ecm->fileDescriptor == -1) {
+		fprintf(stderr, "PhilPSX: CDEcm: Couldn't open ECM file\n");
+		goto cleanup_ecm;
+	}
+	off_t fileSize = lseek(ecm->fileDescriptor, 0, SEEK_END);
+	if (fileSize == -1) {
+		fprintf(stderr, "PhilPSX: CDEcm: Couldn't seek to end of ECM "
+				"file\n");
+		goto cleanup_file;
+	}
+	ecm->fileSize = (size_t)fileSize;
+	void *mapping = mmap(NULL, ecm->fileSize, PROT_READ, MAP_PRIVATE,
+			ecm->fileDescriptor, 0);
+	if (mapping == MAP_FAILED) {
+		fprintf(stderr, "PhilPSX: CDEcm: Couldn't map ECM file into address "
+				"space\n");
+		goto cleanup_file;
+	}
+	ecm->mapping = mapping;
+
+	// Index records
+	if (!CDEcm_buildIndex(ecm))
+		goto cleanup_mapping;
+
+	// Allocate hunk cache, keeping within budget
+	ecm->hunkCount = (ecm->size + PHILPSX_CDECM_HUNK_SIZE - 1) /
+			PHILPSX_CDECM_HUNK_SIZE;
+	ecm->cacheCount = (int32_t)min_value(ecm->hunkCount,
+			(int64_t)(PHILPSX_CDECM_CACHE_BUDGET / PHILPSX_CDECM_HUNK_SIZE));
+	ecm->cache = malloc(sizeof(CDEcmHunk) * max_value(ecm->cacheCount, 1));
+	ecm->cacheData = malloc((size_t)PHILPSX_CDECM_HUNK_SIZE *
+			max_value(ecm->cacheCount, 1));
+	ecm->slots = malloc(sizeof(int32_t) * max_value(ecm->hunkCount,
+			(int64_t)1));
+	if (!ecm->cache || !ecm->cacheData || !ecm->slots) {
+		fprintf(stderr, "PhilPSX: CDEcm: Couldn't allocate memory for hunk "
+				"cache\n");
+		goto cleanup_cache;
+	}
+	for (int32_t i = 0; i < ecm->cacheCount; ++i) {
+		ecm->cache[i].hunk = PHILPSX_CDECM_NOT_CACHED;
+		ecm->cache[i].lastUse = 0;
+		ecm->cache[i].data = ecm->cacheData +
+				(int64_t)i * PHILPSX_CDECM_HUNK_SIZE;
+	}
+	for (int64_t i = 0; i < ecm->hunkCount; ++i)
+		ecm->slots[i] = PHILPSX_CDECM_NOT_CACHED;
+	if (pthread_mutex_init(&ecm->cacheMutex, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: CDEcm: Couldn't create cache mutex\n");
+		goto cleanup_cache;
+	}
+
+	// Normal return:
+	return ecm;
+
+	// Cleanup path:
+	cleanup_cache:
+	free(ecm->slots);
+	free(ecm->cacheData);
+	free(ecm->cache);
+	free(ecm->records);
+
+	cleanup_mapping:
+	munmap((void *)ecm->mapping, ecm->fileSize);
+
+	cleanup_file:
+	close(ecm->fileDescriptor);
+
+	cleanup_ecm:
+	free(ecm);
+	ecm = NULL;
+
+	end:
+	return ecm;
+}
+
+/*
+ * This destructs a CDEcm object.
+ */
+void destruct_CDEcm(CDEcm *ecm)
+{
+	pthread_mutex_destroy(&ecm->cacheMutex);
+	free(ecm->slots);
+	free(ecm->cacheData);
+	free(ecm->cache);
+	free(ecm->records);
+	if (munmap((void *)ecm->mapping, ecm->fileSize) != 0)
+		fprintf(stderr, "PhilPSX: CDEcm: Couldn't unmap ECM file\n");
+	if (close(ecm->fileDescriptor) != 0)
+		fprintf(stderr, "PhilPSX: CDEcm: Couldn't close ECM file\n");
+	free(ecm);
+}
+
+/*
+ * This function gets the size of the decoded image.
+ */
+int64_t CDEcm_getSize(CDEcm *ecm)
+{
+	return ecm->size;
+}
+
+/*
+ * This function decodes the hunks covering the specified range of the image
+ * into the cache, ahead of them being read.
+ */
+void CDEcm_prefetch(CDEcm *ecm, int64_t position, int64_t length)
+{
+	int64_t firstHunk = max_value(position, (int64_t)0) /
+			PHILPSX_CDECM_HUNK_SIZE;
+	int64_t lastHunk = min_value((position + length - 1) /
+			PHILPSX_CDECM_HUNK_SIZE, ecm->hunkCount - 1);
+	for (int64_t hunk = firstHunk; hunk <= lastHunk; ++hunk) {
+		pthread_mutex_lock(&ecm->cacheMutex);
+		CDEcm_getHunk(ecm, hunk);
+		pthread_mutex_unlock(&ecm->cacheMutex);
+	}
+}
+
+/*
+ * This function reads the specified range of the decoded image into dst,
+ * through the hunk cache. Anything past the end of the image reads as zero.
+ */
+void CDEcm_read(CDEcm *ecm, int64_t position, int8_t *dst, int32_t length)
+{
+	while (length > 0) {
+
+		// Copy what we can from the hunk holding this position
+		int64_t hunk = position / PHILPSX_CDECM_HUNK_SIZE;
+		int32_t offset = (int32_t)(position % PHILPSX_CDECM_HUNK_SIZE);
+		int32_t count = min_value(length, PHILPSX_CDECM_HUNK_SIZE - offset);
+		if (position < 0 || hunk >= ecm->hunkCount) {
+			memset(dst, 0, count);
+		} else {
+			pthread_mutex_lock(&ecm->cacheMutex);
+			memcpy(dst, CDEcm_getHunk(ecm, hunk)->data + offset, count);
+			pthread_mutex_unlock(&ecm->cacheMutex);
+		}
+
+		position += count;
+		dst += count;
+		length -= count;
+	}
+}
+
+/*
+ * This function parses every record of the ECM file into the index, working
+ * out the size of the decoded image as it goes. It returns false if the file
+ * is malformed or the index couldn't be allocated.
+ */
+static bool CDEcm_buildIndex(CDEcm *ecm)
+{
+	// Check magic number
+	if (ecm->fileSize < 4 || memcmp(ecm->mapping, "ECM\0", 4) != 0) {
+		fprintf(stderr, "PhilPSX: CDEcm: File is not an ECM file\n");
+		goto end;
+	}
+
+	// Read records until the end marker
+	size_t position = 4;
+	int64_t output = 0;
+	int64_t capacity = 0;
+	for (;;) {
+
+		// Read type and count, whose bits follow on in each byte with its
+		// top bit set
+		if (position >= ecm->fileSize)
+			goto truncated;
+		uint8_t c = ecm->mapping[position++];
+		int32_t type = c & 0x3;
+		uint64_t count = (c >> 2) & 0x1F;
+		int32_t bits = 5;
+		while (c & 0x80) {
+			if (position >= ecm->fileSize)
+				goto truncated;
+			if (bits > 31) {
+				fprintf(stderr, "PhilPSX: CDEcm: Record count is too "
+						"large\n");
+				goto cleanup_records;
+			}
+			c = ecm->mapping[position++];
+			count |= (uint64_t)(c & 0x7F) << bits;
+			bits += 7;
+		}
+		if (count == 0xFFFFFFFF)
+			break;
+		++count;
+		if (count > 0xFFFFFFFF) {
+			fprintf(stderr, "PhilPSX: CDEcm: Record count is too large\n");
+			goto cleanup_records;
+		}
+
+		// Check the record's data is all there
+		uint64_t inputLength = count * CDEcm_getInputSize(type);
+		if (inputLength > ecm->fileSize - position)
+			goto truncated;
+
+		// Add record to index, growing it if needed
+		if (ecm->recordCount == capacity) {
+			capacity = max_value(capacity * 2, (int64_t)1024);
+			CDEcmRecord *records =
+					realloc(ecm->records, sizeof(CDEcmRecord) * capacity);
+			if (!records) {
+				fprintf(stderr, "PhilPSX: CDEcm: Couldn't allocate memory "
+						"for record index\n");
+				goto cleanup_records;
+			}
+			ecm->records = records;
+		}
+		CDEcmRecord *record = &ecm->records[ecm->recordCount++];
+		record->outputStart = output;
+		record->inputStart = (int64_t)position;
+		record->count = (uint32_t)count;
+		record->type = type;
+
+		position += inputLength;
+		output += (int64_t)count * CDEcm_getOutputSize(type);
+	}
+
+	if (output == 0) {
+		fprintf(stderr, "PhilPSX: CDEcm: ECM file is empty\n");
+		goto cleanup_records;
+	}
+	ecm->size = output;
+
+	// Normal return:
+	return true;
+
+	// Cleanup path:
+	truncated:
+	fprintf(stderr, "PhilPSX: CDEcm: ECM file is truncated\n");
+
+	cleanup_records:
+	free(ecm->records);
+	ecm->records = NULL;
+	ecm->recordCount = 0;
+
+	end:
+	return false;
+}
+
+/*
+ * This function decodes the specified range of the image into dst, straight
+ * from the records. Anything past the end of the image decodes as zero.
+ */
+static void CDEcm_decode(CDEcm *ecm, int64_t position, int8_t *dst,
+		int64_t length)
+{
+	// Find the last record starting at or before the position
+	int64_t low = 0, high = ecm->recordCount - 1;
+	while (low < high) {
+		int64_t middle = (low + high + 1) / 2;
+		if (ecm->records[middle].outputStart <= position)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+
+	// Decode units from each record in turn
+	uint8_t sector[PHILPSX_CDECM_RAW_SECTOR_SIZE];
+	for (int64_t i = low; i < ecm->recordCount && length > 0; ++i) {
+		const CDEcmRecord *record = &ecm->records[i];
+		int32_t unitSize = CDEcm_getOutputSize(record->type);
+		int64_t recordEnd = record->outputStart +
+				(int64_t)record->count * unitSize;
+		while (position < recordEnd && length > 0) {
+			int64_t unit = (position - record->outputStart) / unitSize;
+			int32_t offset = (int32_t)((position - record->outputStart) %
+					unitSize);
+			int64_t count = min_value(length, (int64_t)(unitSize - offset));
+
+			// Literal bytes are copied as they are, a run at a time
+			if (record->type == PHILPSX_CDECM_LITERAL) {
+				count = min_value(length, recordEnd - position);
+				memcpy(dst, ecm->mapping + record->inputStart + unit, count);
+			} else {
+				CDEcm_decodeSector(ecm, record, unit, sector);
+				int32_t start = (record->type == PHILPSX_CDECM_MODE1) ?
+						0 : 0x10;
+				memcpy(dst, sector + start + offset, count);
+			}
+
+			position += count;
+			dst += count;
+			length -= count;
+		}
+	}
+	if (length > 0)
+		memset(dst, 0, length);
+}
+
+/*
+ * This function rebuilds a whole sector from a unit of a sector record, with
+ * its sync pattern, EDC and ECC. Mode 2 units only cover the sector from its
+ * subheader onwards, so the header is left zeroed.
+ */
+static void CDEcm_decodeSector(CDEcm *ecm, const CDEcmRecord *record,
+		int64_t unit, uint8_t *sector)
+{
+	const uint8_t *input = ecm->mapping + record->inputStart +
+			unit * CDEcm_getInputSize(record->type);
+
+	// Set sync pattern and clear header
+	memset(sector, 0, 0x10);
+	memset(sector + 1, 0xFF, 10);
+
+	// Fill in what the record stores
+	switch (record->type) {
+		case PHILPSX_CDECM_MODE1:
+			memcpy(sector + 0xC, input, 3);
+			sector[0xF] = 1;
+			memcpy(sector + 0x10, input + 3, 0x800);
+			break;
+		case PHILPSX_CDECM_MODE2_FORM1:
+			sector[0xF] = 2;
+			memcpy(sector + 0x10, input, 4);
+			memcpy(sector + 0x14, input, 4);
+			memcpy(sector + 0x18, input + 4, 0x800);
+			break;
+		case PHILPSX_CDECM_MODE2_FORM2:
+			sector[0xF] = 2;
+			memcpy(sector + 0x10, input, 4);
+			memcpy(sector + 0x14, input, 4);
+			memcpy(sector + 0x18, input + 4, 0x914);
+			break;
+	}
+
+	CDEcm_generateEccEdc(ecm, sector, record->type);
+}
+
+/*
+ * This function gets the number of bytes each unit of a record type takes up
+ * in the ECM file.
+ */
+static int32_t CDEcm_getInputSize(int32_t type)
+{
+	switch (type) {
+		case PHILPSX_CDECM_MODE1:
+			return 0x803;
+		case PHILPSX_CDECM_MODE2_FORM1:
+			return 0x804;
+		case PHILPSX_CDECM_MODE2_FORM2:
+			return 0x918;
+		default:
+			return 1;
+	}
+}
+
+/*
+ * This function gets the number of bytes each unit of a record type takes up
+ * in the decoded image.
+ */
+static int32_t CDEcm_getOutputSize(int32_t type)
+{
+	switch (type) {
+		case PHILPSX_CDECM_MODE1:
+			return PHILPSX_CDECM_RAW_SECTOR_SIZE;
+		case PHILPSX_CDECM_MODE2_FORM1:
+		case PHILPSX_CDECM_MODE2_FORM2:
+			return PHILPSX_CDECM_MODE2_SECTOR_SIZE;
+		default:
+			return 1;
+	}
+}
+
+/*
+ * This function generates the P and Q parity of a sector's ECC. Mode 2
+ * sectors are protected as if their header were zero, so zeroAddress clears
+ * it for the calculation.
+ */
+static void CDEcm_generateEcc(CDEcm *ecm, uint8_t *sector, bool zeroAddress)
+{
+	uint8_t address[4] = {0};
+	if (zeroAddress) {
+		memcpy(address, sector + 0xC, 4);
+		memset(sector + 0xC, 0, 4);
+	}
+
+	CDEcm_generateEccBlock(ecm, sector + 0xC, 86, 24, 2, 86, sector + 0x81C);
+	CDEcm_generateEccBlock(ecm, sector + 0xC, 52, 43, 86, 88, sector + 0x8C8);
+
+	if (zeroAddress)
+		memcpy(sector + 0xC, address, 4);
+}
+
+/*
+ * This function generates one block of Reed-Solomon parity, walking the
+ * sector as a matrix of majorCount vectors of minorCount bytes each.
+ */
+static void CDEcm_generateEccBlock(CDEcm *ecm, const uint8_t *src,
+		int32_t majorCount, int32_t minorCount, int32_t majorMult,
+		int32_t minorInc, uint8_t *dst)
+{
+	int32_t size = majorCount * minorCount;
+	for (int32_t major = 0; major < majorCount; ++major) {
+		int32_t index = (major >> 1) * majorMult + (major & 1);
+		uint8_t eccA = 0, eccB = 0;
+		for (int32_t minor = 0; minor < minorCount; ++minor) {
+			uint8_t temp = src[index];
+			index += minorInc;
+			if (index >= size)
+				index -= size;
+			eccA ^= temp;
+			eccB ^= temp;
+			eccA = ecm->eccForward[eccA];
+		}
+		eccA = ecm->eccBackward[ecm->eccForward[eccA] ^ eccB];
+		dst[major] = eccA;
+		dst[major + majorCount] = eccA ^ eccB;
+	}
+}
+
+/*
+ * This function generates the EDC, and the ECC where there is one, of a
+ * sector of the given record type.
+ */
+static void CDEcm_generateEccEdc(CDEcm *ecm, uint8_t *sector, int32_t type)
+{
+	uint32_t edc;
+	switch (type) {
+		case PHILPSX_CDECM_MODE1:
+			edc = CDEcm_generateEdc(ecm, sector, 0x810);
+			for (int32_t i = 0; i < 4; ++i)
+				sector[0x810 + i] = (uint8_t)(edc >> (i * 8));
+			memset(sector + 0x814, 0, 8);
+			CDEcm_generateEcc(ecm, sector, false);
+			break;
+		case PHILPSX_CDECM_MODE2_FORM1:
+			edc = CDEcm_generateEdc(ecm, sector + 0x10, 0x808);
+			for (int32_t i = 0; i < 4; ++i)
+				sector[0x818 + i] = (uint8_t)(edc >> (i * 8));
+			CDEcm_generateEcc(ecm, sector, true);
+			break;
+		case PHILPSX_CDECM_MODE2_FORM2:
+			edc = CDEcm_generateEdc(ecm, sector + 0x10, 0x91C);
+			for (int32_t i = 0; i < 4; ++i)
+				sector[0x92C + i] = (uint8_t)(edc >> (i * 8));
+			break;
+	}
+}
+
+/*
+ * This function calculates the EDC (a 32-bit CRC) of a block of bytes.
+ */
+static uint32_t CDEcm_generateEdc(CDEcm *ecm, const uint8_t *src,
+		int32_t size)
+{
+	uint32_t edc = 0;
+	for (int32_t i = 0; i < size; ++i)
+		edc = (edc >> 8) ^ ecm->edcTable[(edc ^ src[i]) & 0xFF];
+	return edc;
+}
+
+/*
+ * This function fills in the lookup tables for generating EDC and ECC.
+ */
+static void CDEcm_initTables(CDEcm *ecm)
+{
+	for (int32_t i = 0; i < 256; ++i) {
+		int32_t j = (i << 1) ^ ((i & 0x80) ? 0x11D : 0);
+		ecm->eccForward[i] = (uint8_t)j;
+		ecm->eccBackward[i ^ j] = (uint8_t)i;
+		uint32_t edc = (uint32_t)i;
+		for (j = 0; j < 8; ++j)
+			edc = (edc >> 1) ^ ((edc & 1) ? 0xD8018001 : 0);
+		ecm->edcTable[i] = edc;
+	}
+}
+
+/*
+ * This function gets the cache entry holding the specified hunk, decoding it
+ * into the least recently used entry if it isn't there already. The cache
+ * mutex must be held by the caller.
+ */
+static CDEcmHunk *CDEcm_getHunk(CDEcm *ecm, int64_t hunk)
+{
+	// Use cached copy if there is one
+	int32_t slot = ecm->slots[hunk];
+	if (slot == PHILPSX_CDECM_NOT_CACHED) {
+
+		// Find least recently used entry, and give it to this hunk
+		slot = 0;
+		for (int32_t i = 1; i < ecm->cacheCount; ++i)
+			if (ecm->cache[i].lastUse < ecm->cache[slot].lastUse)
+				slot = i;
+		CDEcmHunk *entry = &ecm->cache[slot];
+		if (entry->hunk != PHILPSX_CDECM_NOT_CACHED)
+			ecm->slots[entry->hunk] = PHILPSX_CDECM_NOT_CACHED;
+		entry->hunk = hunk;
+		ecm->slots[hunk] = slot;
+
+		CDEcm_decode(ecm, hunk * PHILPSX_CDECM_HUNK_SIZE, entry->data,
+				PHILPSX_CDECM_HUNK_SIZE);
+	}
+
+	ecm->cache[slot].lastUse = ++ecm->useCounter;
+	return &ecm->cache[slot];
+}
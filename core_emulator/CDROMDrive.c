@@ -11,6 +11,15 @@
 #include "../headers/CDROMDrive.h"
 #include "../headers/SystemInterlink.h"
 #include "../headers/CD.h"
+#include "../headers/PerfCounters.h"
+#include "../headers/SaveState.h"
+#include "../headers/XAAudio.h"
+
+// Number of CPU cycles it takes to read a sector at single speed (75 sectors
+// a second), and the delay before raising an interrupt for a sector when we
+// don't need to keep to that
+#define PHILPSX_CDROMDRIVE_SECTOR_CYCLES 451584
+#define PHILPSX_CDROMDRIVE_FAST_SECTOR_CYCLES 16000
 
 // Forward declarations for functions private to this class
 // CDROMDrive-related stuff:
@@ -29,26 +38,41 @@ static void CDROMDrive_command_Pause(CDROMDrive *cdrom, bool secondResponse);
 static void CDROMDrive_command_ReadN(CDROMDrive *cdrom, bool secondResponse);
 static void CDROMDrive_command_ReadTOC(CDROMDrive *cdrom, bool secondResponse);
 static void CDROMDrive_command_SeekL(CDROMDrive *cdrom, bool secondResponse);
+static void CDROMDrive_command_Setfilter(CDROMDrive *cdrom);
 static void CDROMDrive_command_Setloc(CDROMDrive *cdrom);
 static void CDROMDrive_command_Setmode(CDROMDrive *cdrom);
 static void CDROMDrive_command_Test(CDROMDrive *cdrom);
+static void CDROMDrive_decodeXaSector(void *xa, const int8_t *sector);
 static bool CDROMDrive_doubleSpeed(CDROMDrive *cdrom);
 static bool CDROMDrive_enableReportInterrupts(CDROMDrive *cdrom);
 static void CDROMDrive_executeCommand(CDROMDrive *cdrom, int32_t commandNum,
 		bool secondResponse);
+static int8_t CDROMDrive_getFillValue(CDROMDrive *cdrom);
 static int8_t CDROMDrive_getInterruptEnableRegister(CDROMDrive *cdrom);
 static int8_t CDROMDrive_getInterruptFlagRegister(CDROMDrive *cdrom);
 static int8_t CDROMDrive_getStatusCode(CDROMDrive *cdrom);
 static bool CDROMDrive_idError(CDROMDrive *cdrom);
 static bool CDROMDrive_ignoreBit(CDROMDrive *cdrom);
+static bool CDROMDrive_isAdpcmSector(CDROMDrive *cdrom);
 static bool CDROMDrive_isReading(CDROMDrive *cdrom);
 static bool CDROMDrive_isSeeking(CDROMDrive *cdrom);
 static bool CDROMDrive_motorStatus(CDROMDrive *cdrom);
+static int32_t CDROMDrive_readRegisterByte(void *component, int32_t address);
+static int32_t CDROMDrive_readRegisterHalfWord(void *component,
+		int32_t address);
+static int32_t CDROMDrive_readRegisterWord(void *component, int32_t address);
+static int32_t CDROMDrive_sectorDelay(CDROMDrive *cdrom);
 static bool CDROMDrive_seekError(CDROMDrive *cdrom);
 static bool CDROMDrive_shellOpen(CDROMDrive *cdrom);
 static void CDROMDrive_triggerInterrupt(CDROMDrive *cdrom, int32_t interruptNum,
 		int32_t delay);
 static bool CDROMDrive_wholeSector(CDROMDrive *cdrom);
+static void CDROMDrive_writeRegisterByte(void *component, int32_t address,
+		int32_t value);
+static void CDROMDrive_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value);
+static void CDROMDrive_writeRegisterWord(void *component, int32_t address,
+		int32_t value);
 static bool CDROMDrive_xaAdpcm(CDROMDrive *cdrom);
 static bool CDROMDrive_xaFilter(CDROMDrive *cdrom);
 
@@ -72,14 +96,28 @@ struct CDROMDrive {
 	int32_t responseCount;
 	int32_t responseIndex;
 
-	// This stores data from the CD
-	int8_t *dataFifo; // Allocated dynamically due to size
+	// This stores data from the CD - dataSource points to the sector within
+	// the mapped image where possible, falling back to the (dynamically
+	// allocated) dataFifo buffer for sectors the image doesn't hold in full
+	const int8_t *dataSource;
+	int8_t *dataFifo;
 	int32_t dataCount;
 	int32_t dataIndex;
 
 	// This references the actual CD
 	CD *cd;
 
+	// This decodes XA-ADPCM sectors for the SPU, and stores the file and
+	// channel they must match when filtering (set via the Setfilter command)
+	XAAudio *xaAudio;
+	int32_t filterFile;
+	int32_t filterChannel;
+
+	// This is set while the frames being emulated are run ahead of the
+	// real timeline and will be rolled back, so XA-ADPCM sectors are left
+	// for the real timeline to decode
+	bool speculative;
+
 	// Interrupt registers
 	int32_t interruptEnableRegister;
 	int32_t interruptFlagRegister;
@@ -141,12 +179,22 @@ CDROMDrive *construct_CDROMDrive(void)
 		goto cleanup_cdromdrive;
 	}
 	
+	// Create XA-ADPCM decoder
+	cdrom->xaAudio = construct_XAAudio();
+	if (!cdrom->xaAudio) {
+		fprintf(stderr, "PhilPSX: CDROMDrive: Couldn't construct XAAudio "
+				"object\n");
+		goto cleanup_cd;
+	}
+	cdrom->filterFile = 0;
+	cdrom->filterChannel = 0;
+	
 	// Allocate data fifo
 	cdrom->dataFifo = calloc(0x924, sizeof(int8_t));
 	if (!cdrom->dataFifo) {
 		fprintf(stderr, "PhilPSX: CDROMDrive: Couldn't allocate memory for "
 				"dataFifo array\n");
-		goto cleanup_cd;
+		goto cleanup_xaaudio;
 	}
 	
 	// Zero out parameterFifo and responseFifo arrays
@@ -163,6 +211,7 @@ CDROMDrive *construct_CDROMDrive(void)
 	cdrom->parameterCount = 0;
 	cdrom->responseCount = 0;
 	cdrom->responseIndex = 0;
+	cdrom->dataSource = cdrom->dataFifo;
 	cdrom->dataCount = 0;
 	cdrom->dataIndex = 0;
 
@@ -210,6 +259,9 @@ CDROMDrive *construct_CDROMDrive(void)
 	return cdrom;
 	
 	// Cleanup path:
+	cleanup_xaaudio:
+	destruct_XAAudio(cdrom->xaAudio);
+
 	cleanup_cd:
 	destruct_CD(cdrom->cd);
 	
@@ -226,8 +278,11 @@ CDROMDrive *construct_CDROMDrive(void)
  */
 void destruct_CDROMDrive(CDROMDrive *cdrom)
 {
+	// The CD's read-ahead worker may be decoding into the XAAudio object, so
+	// it goes first
 	free(cdrom->dataFifo);
 	destruct_CD(cdrom->cd);
+	destruct_XAAudio(cdrom->xaAudio);
 	free(cdrom);
 }
 
@@ -237,9 +292,9 @@ void destruct_CDROMDrive(CDROMDrive *cdrom)
 void CDROMDrive_chunkCopy(CDROMDrive *cdrom, int8_t *destination,
 		int32_t startIndex, int32_t length)
 {
-	// Copy data fifo pointer and update it as well as destination with the
-	// correct offsets
-	int8_t *tempDataFifo = cdrom->dataFifo;
+	// Copy data source pointer and update it as well as destination with
+	// the correct offsets
+	const int8_t *tempDataFifo = cdrom->dataSource;
 	tempDataFifo += cdrom->dataIndex;
 	destination += startIndex;
 	
@@ -251,9 +306,8 @@ void CDROMDrive_chunkCopy(CDROMDrive *cdrom, int8_t *destination,
 		destination += cdrom->dataCount - cdrom->dataIndex;
 		length -= cdrom->dataCount - cdrom->dataIndex;
 		cdrom->dataIndex = cdrom->dataCount;
-		int8_t fillValue = CDROMDrive_wholeSector(cdrom) ?
-			cdrom->dataFifo[0x920] : cdrom->dataFifo[0x7F8];
-		memset(destination, fillValue, length * sizeof(int8_t));
+		memset(destination, CDROMDrive_getFillValue(cdrom),
+				length * sizeof(int8_t));
 	} else { // We are fine, just do the copy
 		memcpy(destination, tempDataFifo, length * sizeof(int8_t));
 		cdrom->dataIndex += length;
@@ -261,15 +315,117 @@ void CDROMDrive_chunkCopy(CDROMDrive *cdrom, int8_t *destination,
 	cdrom->beenRead = true;
 }
 
+/*
+ * This function returns the CD object the drive reads from.
+ */
+CD *CDROMDrive_getCD(CDROMDrive *cdrom)
+{
+	return cdrom->cd;
+}
+
+/*
+ * This function gets the CD read-ahead hit and miss counts.
+ */
+void CDROMDrive_getReadAheadStats(CDROMDrive *cdrom, int64_t *hits,
+		int64_t *misses)
+{
+	CD_getReadAheadStats(cdrom->cd, hits, misses);
+}
+
+/*
+ * This function moves up to frameCount stereo frames of decoded XA-ADPCM
+ * audio to frames, for the SPU's CD audio input, returning how many were
+ * moved.
+ */
+int32_t CDROMDrive_readAudioFrames(CDROMDrive *cdrom, int16_t *frames,
+		int32_t frameCount)
+{
+	return XAAudio_readFrames(cdrom->xaAudio, frames, frameCount);
+}
+
 /*
  * This function sets the contained CD object to reference the specified
  * image file.
  */
 bool CDROMDrive_loadCD(CDROMDrive *cdrom, const char *cdPath)
 {
+	// Data source may point into the old image, so empty fifo first, and
+	// throw away anything decoded from it
+	CDROMDrive_clearDataFifo(cdrom);
+	XAAudio_reset(cdrom->xaAudio);
 	return CD_loadCD(cdrom->cd, cdPath);
 }
 
+/*
+ * This function reads the drive's state back from a save state, in the
+ * order CDROMDrive_saveState wrote it. The data fifo always comes back in
+ * the fifo buffer rather than pointing into the image, and any XA-ADPCM
+ * audio decoded but not yet played is thrown away.
+ */
+void CDROMDrive_loadState(CDROMDrive *cdrom, SaveState *state)
+{
+	// Register index and fifos
+	SaveState_read(state, &cdrom->portIndex, sizeof(int32_t));
+	SaveState_read(state, cdrom->parameterFifo, sizeof(cdrom->parameterFifo));
+	SaveState_read(state, &cdrom->parameterCount, sizeof(int32_t));
+	SaveState_read(state, cdrom->responseFifo, sizeof(cdrom->responseFifo));
+	SaveState_read(state, &cdrom->responseCount, sizeof(int32_t));
+	SaveState_read(state, &cdrom->responseIndex, sizeof(int32_t));
+	CDROMDrive_clearDataFifo(cdrom);
+	int32_t dataCount = 0;
+	SaveState_read(state, &dataCount, sizeof(int32_t));
+	SaveState_read(state, &cdrom->dataIndex, sizeof(int32_t));
+	if (dataCount < 0 || dataCount > 0x924 || cdrom->dataIndex < 0 ||
+			cdrom->parameterCount < 0 || cdrom->parameterCount > 16 ||
+			cdrom->responseCount < 0 || cdrom->responseCount > 16) {
+		SaveState_fail(state);
+		CDROMDrive_clearParameterFifo(cdrom);
+		CDROMDrive_clearResponseFifo(cdrom);
+		CDROMDrive_clearDataFifo(cdrom);
+		return;
+	}
+	SaveState_read(state, cdrom->dataFifo, dataCount);
+	cdrom->dataCount = dataCount;
+
+	// XA-ADPCM filter
+	SaveState_read(state, &cdrom->filterFile, sizeof(int32_t));
+	SaveState_read(state, &cdrom->filterChannel, sizeof(int32_t));
+	XAAudio_reset(cdrom->xaAudio);
+
+	// Interrupt registers, and current command
+	SaveState_read(state, &cdrom->interruptEnableRegister, sizeof(int32_t));
+	SaveState_read(state, &cdrom->interruptFlagRegister, sizeof(int32_t));
+	SaveState_read(state, &cdrom->busy, sizeof(int32_t));
+	SaveState_read(state, &cdrom->currentCommand, sizeof(int32_t));
+	SaveState_read(state, &cdrom->needsSecondResponse, sizeof(bool));
+
+	// Status flags
+	SaveState_read(state, &cdrom->cddaPlaying, sizeof(bool));
+	SaveState_read(state, &cdrom->isSeeking, sizeof(bool));
+	SaveState_read(state, &cdrom->isReading, sizeof(bool));
+	SaveState_read(state, &cdrom->shellOpen, sizeof(bool));
+	SaveState_read(state, &cdrom->idError, sizeof(bool));
+	SaveState_read(state, &cdrom->seekError, sizeof(bool));
+	SaveState_read(state, &cdrom->motorStatus, sizeof(bool));
+	SaveState_read(state, &cdrom->commandError, sizeof(bool));
+
+	// Mode flags
+	SaveState_read(state, &cdrom->doubleSpeed, sizeof(bool));
+	SaveState_read(state, &cdrom->xaAdpcm, sizeof(bool));
+	SaveState_read(state, &cdrom->wholeSector, sizeof(bool));
+	SaveState_read(state, &cdrom->ignoreBit, sizeof(bool));
+	SaveState_read(state, &cdrom->xaFilter, sizeof(bool));
+	SaveState_read(state, &cdrom->enableReportInterrupts, sizeof(bool));
+	SaveState_read(state, &cdrom->autoPause, sizeof(bool));
+	SaveState_read(state, &cdrom->allowCddaRead, sizeof(bool));
+
+	// Position of the current read
+	SaveState_read(state, &cdrom->responseReceived, sizeof(int32_t));
+	SaveState_read(state, &cdrom->setlocPosition, sizeof(int64_t));
+	SaveState_read(state, &cdrom->setlocProcessed, sizeof(bool));
+	SaveState_read(state, &cdrom->beenRead, sizeof(bool));
+}
+
 /*
  * This function reads a byte from the index/status register.
  */
@@ -320,10 +476,9 @@ int8_t CDROMDrive_read1802(CDROMDrive *cdrom)
 	int8_t retVal = 0;
 
 	if (cdrom->dataIndex < cdrom->dataCount) {
-		retVal = cdrom->dataFifo[cdrom->dataIndex++];
+		retVal = cdrom->dataSource[cdrom->dataIndex++];
 	} else {
-		retVal = (CDROMDrive_wholeSector(cdrom)) ?
-			cdrom->dataFifo[0x920] : cdrom->dataFifo[0x7F8];
+		retVal = CDROMDrive_getFillValue(cdrom);
 	}
 	cdrom->beenRead = true;
 
@@ -357,6 +512,75 @@ int8_t CDROMDrive_read1803(CDROMDrive *cdrom)
 	return retVal;
 }
 
+/*
+ * This function moves a read on to the next sector, once one it has handed
+ * over for XA-ADPCM decoding has gone by. It does nothing if the read has
+ * since been paused.
+ */
+void CDROMDrive_readNextSector(CDROMDrive *cdrom)
+{
+	if (cdrom->isReading && cdrom->needsSecondResponse &&
+			(cdrom->currentCommand == 0x06 || cdrom->currentCommand == 0x1B))
+		CDROMDrive_command_ReadN(cdrom, true);
+}
+
+/*
+ * This function writes the drive's state to a save state - its fifos,
+ * registers, flags and read position. The sector in the data fifo is
+ * copied in full, as it may point into the image.
+ */
+void CDROMDrive_saveState(CDROMDrive *cdrom, SaveState *state)
+{
+	// Register index and fifos
+	SaveState_write(state, &cdrom->portIndex, sizeof(int32_t));
+	SaveState_write(state, cdrom->parameterFifo,
+			sizeof(cdrom->parameterFifo));
+	SaveState_write(state, &cdrom->parameterCount, sizeof(int32_t));
+	SaveState_write(state, cdrom->responseFifo, sizeof(cdrom->responseFifo));
+	SaveState_write(state, &cdrom->responseCount, sizeof(int32_t));
+	SaveState_write(state, &cdrom->responseIndex, sizeof(int32_t));
+	SaveState_write(state, &cdrom->dataCount, sizeof(int32_t));
+	SaveState_write(state, &cdrom->dataIndex, sizeof(int32_t));
+	SaveState_write(state, cdrom->dataSource, cdrom->dataCount);
+
+	// XA-ADPCM filter
+	SaveState_write(state, &cdrom->filterFile, sizeof(int32_t));
+	SaveState_write(state, &cdrom->filterChannel, sizeof(int32_t));
+
+	// Interrupt registers, and current command
+	SaveState_write(state, &cdrom->interruptEnableRegister, sizeof(int32_t));
+	SaveState_write(state, &cdrom->interruptFlagRegister, sizeof(int32_t));
+	SaveState_write(state, &cdrom->busy, sizeof(int32_t));
+	SaveState_write(state, &cdrom->currentCommand, sizeof(int32_t));
+	SaveState_write(state, &cdrom->needsSecondResponse, sizeof(bool));
+
+	// Status flags
+	SaveState_write(state, &cdrom->cddaPlaying, sizeof(bool));
+	SaveState_write(state, &cdrom->isSeeking, sizeof(bool));
+	SaveState_write(state, &cdrom->isReading, sizeof(bool));
+	SaveState_write(state, &cdrom->shellOpen, sizeof(bool));
+	SaveState_write(state, &cdrom->idError, sizeof(bool));
+	SaveState_write(state, &cdrom->seekError, sizeof(bool));
+	SaveState_write(state, &cdrom->motorStatus, sizeof(bool));
+	SaveState_write(state, &cdrom->commandError, sizeof(bool));
+
+	// Mode flags
+	SaveState_write(state, &cdrom->doubleSpeed, sizeof(bool));
+	SaveState_write(state, &cdrom->xaAdpcm, sizeof(bool));
+	SaveState_write(state, &cdrom->wholeSector, sizeof(bool));
+	SaveState_write(state, &cdrom->ignoreBit, sizeof(bool));
+	SaveState_write(state, &cdrom->xaFilter, sizeof(bool));
+	SaveState_write(state, &cdrom->enableReportInterrupts, sizeof(bool));
+	SaveState_write(state, &cdrom->autoPause, sizeof(bool));
+	SaveState_write(state, &cdrom->allowCddaRead, sizeof(bool));
+
+	// Position of the current read
+	SaveState_write(state, &cdrom->responseReceived, sizeof(int32_t));
+	SaveState_write(state, &cdrom->setlocPosition, sizeof(int64_t));
+	SaveState_write(state, &cdrom->setlocProcessed, sizeof(bool));
+	SaveState_write(state, &cdrom->beenRead, sizeof(bool));
+}
+
 /*
  * This lets us set the interrupt flag register contents manually.
  */
@@ -371,6 +595,29 @@ void CDROMDrive_setInterruptNumber(CDROMDrive *cdrom, int32_t interruptNum)
 void CDROMDrive_setMemoryInterface(CDROMDrive *cdrom, SystemInterlink *smi)
 {
 	cdrom->system = smi;
+
+	// Install handlers for the CD-ROM registers
+	SystemInterlink_registerIoHandlers(smi, 0x1F801800, 0x4,
+			PHILPSX_IO_BYTE, cdrom, CDROMDrive_readRegisterByte,
+			CDROMDrive_writeRegisterByte);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801800, 0x4,
+			PHILPSX_IO_HALFWORD, cdrom, CDROMDrive_readRegisterHalfWord,
+			CDROMDrive_writeRegisterHalfWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801800, 0x4,
+			PHILPSX_IO_WORD, cdrom, CDROMDrive_readRegisterWord,
+			CDROMDrive_writeRegisterWord);
+}
+
+/*
+ * This function sets whether the frames being emulated will be rolled back
+ * by loading a save state. While they will, XA-ADPCM sectors aren't sent for
+ * decoding, and the SPU's reads of decoded audio are held, so that the real
+ * timeline finds the audio just as it left it.
+ */
+void CDROMDrive_setSpeculative(CDROMDrive *cdrom, bool speculative)
+{
+	cdrom->speculative = speculative;
+	XAAudio_holdReads(cdrom->xaAudio, speculative);
 }
 
 /*
@@ -506,8 +753,9 @@ static bool CDROMDrive_cddaPlaying(CDROMDrive *cdrom)
  */
 static void CDROMDrive_clearDataFifo(CDROMDrive *cdrom)
 {
-	// Wipe data fifo with memset
-	memset(cdrom->dataFifo, 0, 0x924);
+	// Point back at fifo buffer - there is no need to wipe it, as nothing
+	// past dataCount is ever read from it
+	cdrom->dataSource = cdrom->dataFifo;
 	cdrom->dataCount = 0;
 	cdrom->dataIndex = 0;
 }
@@ -669,6 +917,8 @@ static void CDROMDrive_command_ReadN(CDROMDrive *cdrom, bool secondResponse)
 		cdrom->isReading = true;
 		cdrom->needsSecondResponse = true;
 		cdrom->beenRead = true;
+		CD_prefetch(cdrom->cd, cdrom->setlocPosition / 2352);
+		XAAudio_reset(cdrom->xaAudio);
 		cdrom->responseReceived = 3;
 		CDROMDrive_triggerInterrupt(cdrom, 3, 16000);
 	} else { // Second response, read sector into fifo and send stat byte
@@ -682,13 +932,41 @@ static void CDROMDrive_command_ReadN(CDROMDrive *cdrom, bool secondResponse)
 				cdrom->setlocProcessed = true;
 			}
 
-			int64_t startAddress = cdrom->setlocPosition;
-			startAddress += CDROMDrive_wholeSector(cdrom) ? 12 : 24;
-			int32_t sectorSize = CDROMDrive_wholeSector(cdrom) ? 0x924 : 0x800;
+			// Hand XA-ADPCM sectors (that match the filter if it is on)
+			// to the read-ahead worker to decode for the SPU, instead of
+			// to the data fifo - there is no interrupt for these, so we
+			// move on by ourselves once the sector has gone by
+			int64_t sector = cdrom->setlocPosition / 2352;
+			PHILPSX_PERF_ADD(PHILPSX_PERF_CD_SECTORS, 1);
+			if (CDROMDrive_isAdpcmSector(cdrom)) {
+				PHILPSX_PERF_ADD(PHILPSX_PERF_CD_XA_SECTORS, 1);
+				int32_t file = CD_readByte(cdrom->cd,
+						cdrom->setlocPosition + 16) & 0xFF;
+				int32_t channel = CD_readByte(cdrom->cd,
+						cdrom->setlocPosition + 17) & 0xFF;
+				if (!cdrom->speculative && (!CDROMDrive_xaFilter(cdrom) ||
+						(file == cdrom->filterFile &&
+						channel == cdrom->filterChannel)))
+					CD_readSectorAsync(cdrom->cd, sector,
+							&CDROMDrive_decodeXaSector, cdrom->xaAudio);
+				CD_prefetch(cdrom->cd, sector);
+				SystemInterlink_setCDROMSectorDelay(cdrom->system,
+						CDROMDrive_sectorDelay(cdrom));
+				return;
+			}
 
-			for (int32_t i = 0; i < sectorSize; ++i) {
-				cdrom->dataFifo[cdrom->dataCount++] =
-						CD_readByte(cdrom->cd, startAddress++);
+			// Point fifo at sector within the image, or read it into the
+			// fifo buffer if the image doesn't hold all of it
+			bool whole = CDROMDrive_wholeSector(cdrom);
+			const int8_t *source = CD_getSector(cdrom->cd, sector);
+			if (source) {
+				cdrom->dataSource = source + (whole ? 12 : 24);
+				cdrom->dataCount = whole ? PHILPSX_CD_WHOLE_SECTOR_SIZE :
+						PHILPSX_CD_DATA_SECTOR_SIZE;
+			} else {
+				cdrom->dataCount = CD_readSector(cdrom->cd, sector,
+						cdrom->dataFifo, whole ? PHILPSX_CD_SECTOR_WHOLE :
+						PHILPSX_CD_SECTOR_DATA);
 			}
 
 			cdrom->beenRead = false;
@@ -699,7 +977,7 @@ static void CDROMDrive_command_ReadN(CDROMDrive *cdrom, bool secondResponse)
 				CDROMDrive_getStatusCode(cdrom);
 		cdrom->needsSecondResponse = true;
 		cdrom->responseReceived = 0;
-		CDROMDrive_triggerInterrupt(cdrom, 1, 16000);
+		CDROMDrive_triggerInterrupt(cdrom, 1, CDROMDrive_sectorDelay(cdrom));
 	}
 }
 
@@ -736,6 +1014,7 @@ static void CDROMDrive_command_SeekL(CDROMDrive *cdrom, bool secondResponse)
 				CDROMDrive_getStatusCode(cdrom);
 		cdrom->isSeeking = true;
 		cdrom->needsSecondResponse = true;
+		CD_prefetch(cdrom->cd, cdrom->setlocPosition / 2352);
 		cdrom->responseReceived = 3;
 		CDROMDrive_triggerInterrupt(cdrom, 3, 16000);
 	} else { // Second response, send stat byte
@@ -749,6 +1028,23 @@ static void CDROMDrive_command_SeekL(CDROMDrive *cdrom, bool secondResponse)
 	}
 }
 
+/*
+ * This handles the Setfilter command.
+ */
+static void CDROMDrive_command_Setfilter(CDROMDrive *cdrom)
+{
+	// Store file and channel that XA-ADPCM sectors must match
+	cdrom->filterFile = cdrom->parameterFifo[0] & 0xFF;
+	cdrom->filterChannel = cdrom->parameterFifo[1] & 0xFF;
+
+	// Store status byte to response fifo
+	cdrom->responseFifo[cdrom->responseCount++] =
+			CDROMDrive_getStatusCode(cdrom);
+	cdrom->busy = 0;
+	cdrom->responseReceived = 3;
+	CDROMDrive_triggerInterrupt(cdrom, 3, 16000);
+}
+
 /*
  * This handles the Setloc command.
  */
@@ -768,6 +1064,7 @@ static void CDROMDrive_command_Setloc(CDROMDrive *cdrom)
 	cdrom->setlocPosition =
 			(frames * 2352) + (seconds * 176400) + (minutes * 10584000);
 	cdrom->setlocProcessed = false;
+	CD_prefetch(cdrom->cd, cdrom->setlocPosition / 2352);
 
 	// Deal with response code etc.
 	cdrom->responseFifo[cdrom->responseCount++] =
@@ -831,6 +1128,15 @@ static void CDROMDrive_command_Test(CDROMDrive *cdrom)
 	}
 }
 
+/*
+ * This passes a raw sector read by the read-ahead worker on to the XA-ADPCM
+ * decoder.
+ */
+static void CDROMDrive_decodeXaSector(void *xa, const int8_t *sector)
+{
+	XAAudio_decodeSector((XAAudio *)xa, sector);
+}
+
 /*
  * This tells us if the motor is at double speed setting.
  */
@@ -874,6 +1180,9 @@ static void CDROMDrive_executeCommand(CDROMDrive *cdrom, int32_t commandNum,
 			case 0x0C: // Demute
 				CDROMDrive_command_Demute(cdrom);
 				break;
+			case 0x0D: // Setfilter
+				CDROMDrive_command_Setfilter(cdrom);
+				break;
 			case 0x0E: // Setmode
 				CDROMDrive_command_Setmode(cdrom);
 				break;
@@ -886,6 +1195,9 @@ static void CDROMDrive_executeCommand(CDROMDrive *cdrom, int32_t commandNum,
 			case 0x1A: // GetID
 				CDROMDrive_command_GetID(cdrom, secondResponse);
 				break;
+			case 0x1B: // ReadS (the same as ReadN, as reads never fail)
+				CDROMDrive_command_ReadN(cdrom, secondResponse);
+				break;
 			case 0x1E: // ReadTOC
 				CDROMDrive_command_ReadTOC(cdrom, secondResponse);
 				break;
@@ -912,6 +1224,9 @@ static void CDROMDrive_executeCommand(CDROMDrive *cdrom, int32_t commandNum,
 			case 0x1A: // GetID
 				CDROMDrive_command_GetID(cdrom, secondResponse);
 				break;
+			case 0x1B: // ReadS
+				CDROMDrive_command_ReadN(cdrom, secondResponse);
+				break;
 			case 0x1E: // ReadTOC
 				CDROMDrive_command_ReadTOC(cdrom, secondResponse);
 				break;
@@ -919,6 +1234,18 @@ static void CDROMDrive_executeCommand(CDROMDrive *cdrom, int32_t commandNum,
 	}
 }
 
+/*
+ * This function returns the value read once the data fifo runs out, which
+ * is one of the bytes near the end of the sector, or zero if not that much
+ * was read.
+ */
+static int8_t CDROMDrive_getFillValue(CDROMDrive *cdrom)
+{
+	int32_t fillIndex = CDROMDrive_wholeSector(cdrom) ? 0x920 : 0x7F8;
+	return (fillIndex < cdrom->dataCount) ?
+			cdrom->dataSource[fillIndex] : 0;
+}
+
 /*
  * This returns the interrupt enable register.
  */
@@ -994,6 +1321,18 @@ static bool CDROMDrive_ignoreBit(CDROMDrive *cdrom)
 	return cdrom->ignoreBit;
 }
 
+/*
+ * This tells us if the sector at the setloc position should be sent to the
+ * SPU as XA-ADPCM audio - it has to be a mode 2 sector with the audio bit
+ * set in its subheader, and XA-ADPCM has to be turned on.
+ */
+static bool CDROMDrive_isAdpcmSector(CDROMDrive *cdrom)
+{
+	return CDROMDrive_xaAdpcm(cdrom) &&
+			CD_readByte(cdrom->cd, cdrom->setlocPosition + 15) == 2 &&
+			(CD_readByte(cdrom->cd, cdrom->setlocPosition + 18) & 0x4) != 0;
+}
+
 /*
  * This tells us if the drive is currently reading.
  */
@@ -1018,6 +1357,70 @@ static bool CDROMDrive_motorStatus(CDROMDrive *cdrom)
 	return cdrom->motorStatus;
 }
 
+/*
+ * This function handles byte reads from the CD-ROM registers.
+ */
+static int32_t CDROMDrive_readRegisterByte(void *component, int32_t address)
+{
+	CDROMDrive *cdrom = component;
+	int32_t retVal = 0;
+
+	switch (address & 0x3) {
+		case 0:
+			retVal = CDROMDrive_read1800(cdrom);
+			break;
+		case 1:
+			retVal = CDROMDrive_read1801(cdrom);
+			break;
+		case 2:
+			retVal = CDROMDrive_read1802(cdrom);
+			break;
+		case 3:
+			retVal = CDROMDrive_read1803(cdrom);
+			break;
+	}
+
+	return retVal;
+}
+
+/*
+ * This function handles halfword reads from the CD-ROM registers. The bus
+ * to the drive is only 8 bits wide, so both bytes come from the same
+ * register.
+ */
+static int32_t CDROMDrive_readRegisterHalfWord(void *component,
+		int32_t address)
+{
+	int32_t retVal = CDROMDrive_readRegisterByte(component, address) & 0xFF;
+	retVal |= (CDROMDrive_readRegisterByte(component, address) & 0xFF) << 8;
+	return retVal;
+}
+
+/*
+ * This function handles word reads from the CD-ROM registers, which aren't
+ * allowed so just return zero.
+ */
+static int32_t CDROMDrive_readRegisterWord(void *component, int32_t address)
+{
+	return 0;
+}
+
+/*
+ * This returns the delay between sectors while reading. While XA-ADPCM is
+ * turned on this is the real time a sector takes at the current speed, so
+ * that audio streams in time with the SPU - otherwise sectors arrive after a
+ * short fixed delay, to keep loading quick.
+ */
+static int32_t CDROMDrive_sectorDelay(CDROMDrive *cdrom)
+{
+	if (!CDROMDrive_xaAdpcm(cdrom))
+		return PHILPSX_CDROMDRIVE_FAST_SECTOR_CYCLES;
+
+	return CDROMDrive_doubleSpeed(cdrom) ?
+			PHILPSX_CDROMDRIVE_SECTOR_CYCLES / 2 :
+			PHILPSX_CDROMDRIVE_SECTOR_CYCLES;
+}
+
 /*
  * This tells us if there was a seek error.
  */
@@ -1063,6 +1466,51 @@ static bool CDROMDrive_wholeSector(CDROMDrive *cdrom)
 	return cdrom->wholeSector;
 }
 
+/*
+ * This function handles byte writes to the CD-ROM registers.
+ */
+static void CDROMDrive_writeRegisterByte(void *component, int32_t address,
+		int32_t value)
+{
+	CDROMDrive *cdrom = component;
+
+	switch (address & 0x3) {
+		case 0:
+			CDROMDrive_write1800(cdrom, (int8_t)value);
+			break;
+		case 1:
+			CDROMDrive_write1801(cdrom, (int8_t)value);
+			break;
+		case 2:
+			CDROMDrive_write1802(cdrom, (int8_t)value);
+			break;
+		case 3:
+			CDROMDrive_write1803(cdrom, (int8_t)value);
+			break;
+	}
+}
+
+/*
+ * This function handles halfword writes to the CD-ROM registers. The bus to
+ * the drive is only 8 bits wide, so both bytes go to the same register.
+ */
+static void CDROMDrive_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value)
+{
+	CDROMDrive_writeRegisterByte(component, address, value);
+	CDROMDrive_writeRegisterByte(component, address, value >> 8);
+}
+
+/*
+ * This function handles word writes to the CD-ROM registers, which aren't
+ * allowed so do nothing.
+ */
+static void CDROMDrive_writeRegisterWord(void *component, int32_t address,
+		int32_t value)
+{
+	;
+}
+
 /*
  * This tells us if we should be sending XA-ADPCM sectors to the SPU.
  */
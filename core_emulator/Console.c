@@ -0,0 +1,527 @@
+/*
+ * This C file models a whole virtual PlayStation as a class, linking all of
+ * its components together. The PhilPSX front end sets one up around its own
+ * window, work queue and rendering thread, while construct_Console gives one
+ * that runs on its own for embedding, drawing with the software renderer
+ * into memory and handing sound and frames to sinks. Nothing is shared
+ * between consoles, so each can be run from a thread of its own.
+ *
+ * It is assumed due to use case that non-init pthread functions will not fail,
+ * and therefore errors are not checked with these function calls, to simplify
+ * the code and make it more readable.
+ *
+ * Console.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/Console_all.h"
+#include "../headers/TraceEvents.h"
+
+// Forward declarations for functions private to this class
+static void Console_keepFrame(void *userData, const uint32_t *pixels,
+		int32_t width, int32_t height);
+static void Console_passOnSamples(Console *console);
+static void *Console_renderingFunction(void *arg);
+
+/*
+ * This constructs a console that runs on its own, from the BIOS at the given
+ * path. It has its own work queue and rendering thread, and draws with the
+ * software renderer - frames go to the frame sink rather than a window, and
+ * the last one shown can be read back with Console_getFramebuffer.
+ */
+Console *construct_Console(const char *biosPath)
+{
+	// Allocate Console struct
+	Console *console = calloc(1, sizeof(Console));
+	if (!console) {
+		fprintf(stderr, "PhilPSX: Console: Couldn't allocate memory for "
+				"Console struct\n");
+		goto end;
+	}
+
+	// Initialise frame mutex
+	if (pthread_mutex_init(&console->frameMutex, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: Console: Couldn't initialise the frame "
+				"mutex\n");
+		goto cleanup_console;
+	}
+
+	// Allocate copy of the last frame shown
+	console->frame = malloc(PHILPSX_CONSOLE_MAX_FRAME_WIDTH *
+			PHILPSX_CONSOLE_MAX_FRAME_HEIGHT * sizeof(uint32_t));
+	if (!console->frame) {
+		fprintf(stderr, "PhilPSX: Console: Couldn't allocate memory for "
+				"frame\n");
+		goto cleanup_mutex;
+	}
+
+	// Setup work queue
+	console->wq = construct_WorkQueue();
+	if (!console->wq) {
+		fprintf(stderr, "PhilPSX: Console: Couldn't construct work queue\n");
+		goto cleanup_frame;
+	}
+
+	// Setup components, keeping each frame shown in place of a window
+	if (!Console_setupComponents(console, biosPath, console->wq,
+			PHILPSX_GPU_RENDERER_SOFTWARE))
+		goto cleanup_wq;
+	GPU_setFrameSink(console->gpu, &Console_keepFrame, console);
+
+	// Start rendering thread
+	if (pthread_create(&console->renderingThread, NULL,
+			&Console_renderingFunction, console)) {
+		fprintf(stderr, "PhilPSX: Console: Couldn't create rendering "
+				"thread\n");
+		goto cleanup_components;
+	}
+	console->ownsRenderingThread = true;
+
+	// Normal return:
+	return console;
+
+	// Cleanup path:
+	cleanup_components:
+	Console_cleanupComponents(console);
+
+	cleanup_wq:
+	destruct_WorkQueue(console->wq);
+
+	cleanup_frame:
+	free(console->frame);
+
+	cleanup_mutex:
+	pthread_mutex_destroy(&console->frameMutex);
+
+	cleanup_console:
+	free(console);
+	console = NULL;
+
+	end:
+	return console;
+}
+
+/*
+ * This destructs a console constructed with construct_Console, stopping its
+ * rendering thread first.
+ */
+void destruct_Console(Console *console)
+{
+	if (console->ownsRenderingThread) {
+		WorkQueue_endProcessingByRenderingThread(console->wq);
+		pthread_join(console->renderingThread, NULL);
+	}
+	Console_cleanupComponents(console);
+	destruct_WorkQueue(console->wq);
+	free(console->frame);
+	pthread_mutex_destroy(&console->frameMutex);
+	free(console);
+}
+
+/*
+ * This cleans up all the components set up by Console_setupComponents - the
+ * CD image is cleaned up automatically by its destructor if present.
+ */
+void Console_cleanupComponents(Console *console)
+{
+	destruct_ControllerIO(console->cio);
+	destruct_DMAArbiter(console->dma);
+	destruct_MDEC(console->mdec);
+	destruct_CDROMDrive(console->cdrom);
+	destruct_SPU(console->spu);
+	if (console->rendererMode == PHILPSX_GPU_RENDERER_SOFTWARE)
+		GPU_cleanupSoftRenderer(console->gpu);
+	else
+		GPU_cleanupGL(console->gpu);
+	destruct_GPU(console->gpu);
+	destruct_SystemInterlink(console->smi);
+	destruct_R3051(console->cpu);
+}
+
+/*
+ * This function copies the last frame shown into the given buffer, as
+ * 32-bit ARGB pixels packed width to a row, which must be big enough for the
+ * largest frame. It returns false if no frame has been shown yet.
+ */
+bool Console_getFramebuffer(Console *console, uint32_t *pixels,
+		int32_t *width, int32_t *height)
+{
+	pthread_mutex_lock(&console->frameMutex);
+	bool retVal = console->frameWidth > 0;
+	if (retVal)
+		memcpy(pixels, console->frame, console->frameWidth *
+				console->frameHeight * sizeof(uint32_t));
+	*width = console->frameWidth;
+	*height = console->frameHeight;
+	pthread_mutex_unlock(&console->frameMutex);
+
+	return retVal;
+}
+
+/*
+ * This function tells the caller how many frames have been emulated so far.
+ */
+int64_t Console_getFrameCount(Console *console)
+{
+	return GPU_getFrameCount(console->gpu);
+}
+
+/*
+ * This function loads the CD image at the given path into the CD-ROM drive,
+ * returning false if it couldn't be loaded.
+ */
+bool Console_loadCD(Console *console, const char *cdPath)
+{
+	if (!CDROMDrive_loadCD(console->cdrom, cdPath)) {
+		fprintf(stderr, "PhilPSX: Console: Loading of CD-ROM image "
+				"failed\n");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * This function inserts a memory card into the given slot (0 or 1), backed
+ * by the image file at the given path, which is created blank if it doesn't
+ * exist. It returns false if the image couldn't be used.
+ */
+bool Console_loadMemoryCard(Console *console, int32_t slot,
+		const char *path)
+{
+	if (slot < 0 || slot >= PHILPSX_CONTROLLERIO_PORT_COUNT) {
+		fprintf(stderr, "PhilPSX: Console: There is no memory card slot "
+				"%d\n", slot);
+		return false;
+	}
+
+	return ControllerIO_loadMemoryCard(console->cio, slot, path);
+}
+
+/*
+ * This function reads the state of every component back from a save state,
+ * returning false if it didn't hold exactly what was expected. It must only
+ * be called while GP0 is idle, as it is whenever Console_runCycles returns.
+ */
+bool Console_loadState(Console *console, SaveState *state)
+{
+	SaveState_rewind(state);
+	SystemInterlink_loadState(console->smi, state);
+	R3051_loadState(console->cpu, state);
+	DMAArbiter_loadState(console->dma, state);
+	GPU_loadState(console->gpu, state);
+	SPU_loadState(console->spu, state);
+	CDROMDrive_loadState(console->cdrom, state);
+	MDEC_loadState(console->mdec, state);
+	ControllerIO_loadState(console->cio, state);
+	return SaveState_isFinished(state);
+}
+
+/*
+ * This function runs a console constructed with construct_Console for at
+ * least the given number of cycles, then on until GP0 is idle so that its
+ * state can be saved, and returns how many cycles were run. Sound is handed
+ * to the audio sink once a frame (or thrown away if there isn't one), and
+ * everything drawn has been shown by the time it returns.
+ */
+int64_t Console_runCycles(Console *console, int64_t cycles)
+{
+	int64_t cyclesRun = 0;
+	int64_t batchStart = 0;
+	int64_t batchCycles = 0;
+	while (cyclesRun < cycles || !GPU_isIdle(console->gpu)) {
+
+		// Run a block, tracing blocks in batches
+		if (batchCycles == 0)
+			batchStart = PHILPSX_TRACE_BEGIN();
+		int64_t blockCycles = R3051_executeInstructions(console->cpu);
+		cyclesRun += blockCycles;
+		batchCycles += blockCycles;
+		if (batchCycles >= PHILPSX_TRACE_CPU_BATCH_CYCLES) {
+			PHILPSX_TRACE_END(PHILPSX_TRACE_CPU_BATCH, batchStart,
+					(int32_t)batchCycles);
+			batchCycles = 0;
+		}
+
+		int64_t frameCount = GPU_getFrameCount(console->gpu);
+		if (frameCount != console->audioFrame) {
+			console->audioFrame = frameCount;
+			Console_passOnSamples(console);
+		}
+	}
+	if (batchCycles > 0)
+		PHILPSX_TRACE_END(PHILPSX_TRACE_CPU_BATCH, batchStart,
+				(int32_t)batchCycles);
+	Console_passOnSamples(console);
+	GPU_flushRenderer(console->gpu);
+
+	return cyclesRun;
+}
+
+/*
+ * This function writes the state of every component to a save state, in the
+ * order Console_loadState reads it back. It must only be called while GP0 is
+ * idle, as it is whenever Console_runCycles returns.
+ */
+void Console_saveState(Console *console, SaveState *state)
+{
+	SystemInterlink_saveState(console->smi, state);
+	R3051_saveState(console->cpu, state);
+	DMAArbiter_saveState(console->dma, state);
+	GPU_saveState(console->gpu, state);
+	SPU_saveState(console->spu, state);
+	CDROMDrive_saveState(console->cdrom, state);
+	MDEC_saveState(console->mdec, state);
+	ControllerIO_saveState(console->cio, state);
+}
+
+/*
+ * This function sets a function to be handed the console's sound, as
+ * interleaved 16-bit stereo at 44100Hz, from the thread running it. It
+ * should only be called between calls to Console_runCycles.
+ */
+void Console_setAudioSink(Console *console,
+		void (*audioSink)(void *userData, const int16_t *samples,
+		int32_t frameCount), void *userData)
+{
+	console->audioSink = audioSink;
+	console->audioSinkData = userData;
+}
+
+/*
+ * This function sets a function to be handed each frame shown, as 32-bit
+ * ARGB pixels packed width to a row, from the console's rendering thread. It
+ * should only be called between calls to Console_runCycles.
+ */
+void Console_setFrameSink(Console *console,
+		void (*frameSink)(void *userData, const uint32_t *pixels,
+		int32_t width, int32_t height), void *userData)
+{
+	console->frameSink = frameSink;
+	console->frameSinkData = userData;
+}
+
+/*
+ * This function sets the buttons held on the pad in the given port (0 or 1),
+ * using the PHILPSX_CONSOLE_BUTTON_* bits, along with the positions of its
+ * right stick's X and Y then its left stick's, or NULL to centre them. The
+ * pad picks them up at the next vblank. It can be called from any thread,
+ * including while Console_runCycles is running.
+ */
+void Console_setPadInput(Console *console, int32_t port, uint16_t buttons,
+		const uint8_t *axes)
+{
+	if (port < 0 || port >= PHILPSX_CONTROLLERIO_PORT_COUNT)
+		return;
+
+	ControllerIO_setHostInput(console->cio, port, buttons, axes);
+}
+
+/*
+ * This sets up all the components of the virtual PlayStation from the BIOS
+ * at the given path, and links them together properly. The GPU is set up
+ * for the given renderer, which for OpenGL needs the context to be current
+ * on the calling thread, and submits its work to the given work queue.
+ */
+bool Console_setupComponents(Console *console, const char *biosPath,
+		WorkQueue *wq, int32_t rendererMode)
+{
+	// Initialise components
+	// CPU
+	console->cpu = construct_R3051();
+	if (!console->cpu) {
+		fprintf(stderr, "PhilPSX: Console: R3051 setup failed\n");
+		goto end;
+	}
+
+	// SystemInterlink
+	console->smi = construct_SystemInterlink(biosPath);
+	if (!console->smi) {
+		fprintf(stderr, "PhilPSX: Console: System Interlink setup failed\n");
+		goto cleanup_cpu;
+	}
+
+	// GPU
+	console->gpu = construct_GPU();
+	if (!console->gpu) {
+		fprintf(stderr, "PhilPSX: Console: GPU setup failed\n");
+		goto cleanup_smi;
+	}
+
+	// Set OpenGL state, or setup the software renderer in its place
+	console->rendererMode = rendererMode;
+	if (rendererMode == PHILPSX_GPU_RENDERER_SOFTWARE) {
+		if (!GPU_initSoftRenderer(console->gpu)) {
+			fprintf(stderr, "PhilPSX: Console: GPU software renderer setup "
+					"failed\n");
+			goto cleanup_gpu;
+		}
+	} else {
+		GPU_setGLFunctionPointers(console->gpu);
+		if (!GPU_initGL(console->gpu)) {
+			fprintf(stderr, "PhilPSX: Console: GPU GL setup failed\n");
+			goto cleanup_gpu;
+		}
+	}
+
+	// SPU
+	console->spu = construct_SPU();
+	if (!console->spu) {
+		fprintf(stderr, "PhilPSX: Console: SPU setup failed\n");
+		goto cleanup_gl;
+	}
+
+	// CDROMDrive
+	console->cdrom = construct_CDROMDrive();
+	if (!console->cdrom) {
+		fprintf(stderr, "PhilPSX: Console: CD-ROM drive setup failed\n");
+		goto cleanup_spu;
+	}
+
+	// MDEC
+	console->mdec = construct_MDEC();
+	if (!console->mdec) {
+		fprintf(stderr, "PhilPSX: Console: MDEC setup failed\n");
+		goto cleanup_cdrom;
+	}
+
+	// DMAArbiter
+	console->dma = construct_DMAArbiter();
+	if (!console->dma) {
+		fprintf(stderr, "PhilPSX: Console: DMA Arbiter setup failed\n");
+		goto cleanup_mdec;
+	}
+
+	// ControllerIO
+	console->cio = construct_ControllerIO();
+	if (!console->cio) {
+		fprintf(stderr, "PhilPSX: Console: Controller I/O setup failed\n");
+		goto cleanup_dma;
+	}
+
+	// Link components together and set their parameters
+
+	// Link necessary components to the interlink
+	SystemInterlink_setCpu(console->smi, console->cpu);
+	SystemInterlink_setGpu(console->smi, console->gpu);
+	SystemInterlink_setSpu(console->smi, console->spu);
+	SystemInterlink_setCdrom(console->smi, console->cdrom);
+	SystemInterlink_setDma(console->smi, console->dma);
+	SystemInterlink_setControllerIO(console->smi, console->cio);
+
+	// Link interlink back to those components where needed
+	R3051_setMemoryInterface(console->cpu, console->smi);
+	GPU_setMemoryInterface(console->gpu, console->smi);
+	SPU_setMemoryInterface(console->spu, console->smi);
+	CDROMDrive_setMemoryInterface(console->cdrom, console->smi);
+	MDEC_setMemoryInterface(console->mdec, console->smi);
+	DMAArbiter_setMemoryInterface(console->dma, console->smi);
+	ControllerIO_setMemoryInterface(console->cio, console->smi);
+
+	// Now link necessary components to the DMA arbiter
+	DMAArbiter_setCpu(console->dma, console->cpu);
+	DMAArbiter_setGpu(console->dma, console->gpu);
+	DMAArbiter_setSpu(console->dma, console->spu);
+	DMAArbiter_setCdrom(console->dma, console->cdrom);
+	DMAArbiter_setMdec(console->dma, console->mdec);
+
+	// Set work queue reference in GPU
+	GPU_setWorkQueue(console->gpu, wq);
+
+	// Normal return:
+	return true;
+
+	// Cleanup path:
+	cleanup_dma:
+	destruct_DMAArbiter(console->dma);
+
+	cleanup_mdec:
+	destruct_MDEC(console->mdec);
+
+	cleanup_cdrom:
+	destruct_CDROMDrive(console->cdrom);
+
+	cleanup_spu:
+	destruct_SPU(console->spu);
+
+	cleanup_gl:
+	if (rendererMode == PHILPSX_GPU_RENDERER_SOFTWARE)
+		GPU_cleanupSoftRenderer(console->gpu);
+	else
+		GPU_cleanupGL(console->gpu);
+
+	cleanup_gpu:
+	destruct_GPU(console->gpu);
+
+	cleanup_smi:
+	destruct_SystemInterlink(console->smi);
+
+	cleanup_cpu:
+	destruct_R3051(console->cpu);
+
+	end:
+	return false;
+}
+
+/*
+ * This function is the GPU's frame sink for consoles constructed for
+ * embedding. It keeps a copy of each frame for Console_getFramebuffer, then
+ * hands it on to the console's own frame sink if there is one.
+ */
+static void Console_keepFrame(void *userData, const uint32_t *pixels,
+		int32_t width, int32_t height)
+{
+	Console *console = userData;
+
+	// Keep as much of the frame as fits
+	int32_t keptWidth = width < PHILPSX_CONSOLE_MAX_FRAME_WIDTH ?
+			width : PHILPSX_CONSOLE_MAX_FRAME_WIDTH;
+	int32_t keptHeight = height < PHILPSX_CONSOLE_MAX_FRAME_HEIGHT ?
+			height : PHILPSX_CONSOLE_MAX_FRAME_HEIGHT;
+	pthread_mutex_lock(&console->frameMutex);
+	for (int32_t row = 0; row < keptHeight; ++row)
+		memcpy(console->frame + row * keptWidth, pixels + row * width,
+				keptWidth * sizeof(uint32_t));
+	console->frameWidth = keptWidth;
+	console->frameHeight = keptHeight;
+	pthread_mutex_unlock(&console->frameMutex);
+
+	if (console->frameSink)
+		console->frameSink(console->frameSinkData, pixels, width, height);
+}
+
+/*
+ * This function passes all the SPU's samples on to the audio sink, or
+ * discards them if there isn't one.
+ */
+static void Console_passOnSamples(Console *console)
+{
+	int32_t sampleCount;
+	while ((sampleCount = SPU_readSamples(console->spu, console->samples,
+			PHILPSX_CONSOLE_AUDIO_CHUNK_FRAMES)) > 0) {
+		if (console->audioSink)
+			console->audioSink(console->audioSinkData, console->samples,
+					sampleCount);
+	}
+}
+
+/*
+ * This function is run in the rendering thread of a console constructed for
+ * embedding, and executes work items from the thread running the console
+ * until the work queue is told to stop.
+ */
+static void *Console_renderingFunction(void *arg)
+{
+	Console *console = arg;
+	GpuCommand *command;
+	while ((command = WorkQueue_waitForItem(console->wq))) {
+		GPU_executeCommand(command);
+		WorkQueue_returnItem(console->wq, command);
+	}
+
+	return NULL;
+}
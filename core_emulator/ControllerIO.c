@@ -1,26 +1,179 @@
 /*
  * This C file models the controllers and memory cards of the PlayStation
- * hardware as a class.
- * 
+ * hardware as a class. Each byte sent through the serial port is exchanged
+ * with whichever device is selected once the time it takes to send at the
+ * programmed baud rate has passed, which the system's scheduler keeps track
+ * of, so nothing needs to be counted in between. Both ports have a pad
+ * plugged in, which works as a digital pad or, through the configuration
+ * commands of the DualShock, an analog one, and can have a memory card
+ * inserted, backed by an image file.
+ *
+ * Input from the host is written into a snapshot for each port from any
+ * thread without locking, and latched by the emulated pads at each vblank.
+ *
+ * Memory card images are mapped into memory, so writing a sector is just a
+ * copy, with the sector marked in a dirty bitmap. At each vblank, the dirty
+ * sectors are handed to a write-back thread, which flushes the pages
+ * covering them to the image file with msync, so the emulator never waits
+ * on the disk unless it asks to - which it does when shutting down, when
+ * taking a save state and when swapping a card out.
+ *
  * ControllerIO.c - Copyright Phillip Potter, 2020, under GPLv3
  */
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "../headers/ControllerIO.h"
+#include "../headers/SaveState.h"
 #include "../headers/math_utils.h"
 
+// Size of a memory card, and of each of its sectors
+#define PHILPSX_MEMORYCARD_SIZE 131072
+#define PHILPSX_MEMORYCARD_SECTOR_SIZE 128
+#define PHILPSX_MEMORYCARD_SECTOR_COUNT \
+		(PHILPSX_MEMORYCARD_SIZE / PHILPSX_MEMORYCARD_SECTOR_SIZE)
+
+// Number of words in a bitmap with a bit for each sector of a memory card
+#define PHILPSX_MEMORYCARD_BITMAP_WORDS (PHILPSX_MEMORYCARD_SECTOR_COUNT / 32)
+
+// Cycles between a byte finishing and each kind of device acknowledging it
+#define PHILPSX_CONTROLLER_ACK_DELAY 338
+#define PHILPSX_MEMORYCARD_ACK_DELAY 170
+
+// Device talking on the selected port - none until the first byte picks
+// one, or ignored if nothing answered and the rest of the exchange is lost
+#define PHILPSX_SIO_DEVICE_NONE 0
+#define PHILPSX_SIO_DEVICE_CONTROLLER 1
+#define PHILPSX_SIO_DEVICE_MEMORYCARD 2
+#define PHILPSX_SIO_DEVICE_IGNORED 3
+
+// Forward declarations for subcomponents private to this class
+typedef struct Controller Controller;
+typedef struct MemoryCard MemoryCard;
+
 // Forward declarations for functions private to this class
 // ControllerIO-related stuff:
+static void ControllerIO_deselect(ControllerIO *cio);
+static int32_t ControllerIO_exchangeByte(ControllerIO *cio, int32_t value,
+		int32_t *ackDelay);
+static int32_t ControllerIO_readRegisterByte(void *component,
+		int32_t address);
+static int32_t ControllerIO_readRegisterHalfWord(void *component,
+		int32_t address);
+static void ControllerIO_readRxData(ControllerIO *cio, int32_t *value);
+static void ControllerIO_startTransfer(ControllerIO *cio);
 static void ControllerIO_updateBaudrateTimer(ControllerIO *cio);
-static void ControllerIO_updateJoyStat(ControllerIO *cio);
+static int32_t ControllerIO_getBaudrateReload(ControllerIO *cio);
+static void ControllerIO_waitForWriteBack(ControllerIO *cio);
+static void *ControllerIO_writeBackFunction(void *arg);
+static void ControllerIO_writeControl(ControllerIO *cio, int32_t value);
+static void ControllerIO_writeRegisterByte(void *component, int32_t address,
+		int32_t value);
+static void ControllerIO_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value);
+static void ControllerIO_writeTxData(ControllerIO *cio, int32_t value);
+
+// Controller-related stuff:
+static int32_t Controller_exchangeByte(Controller *pad, int32_t value,
+		bool *ack);
+static void Controller_finishCommand(Controller *pad);
+static int32_t Controller_getResponseByte(Controller *pad, int32_t index);
+static void Controller_loadState(Controller *pad, SaveState *state);
+static void Controller_reset(Controller *pad);
+static void Controller_saveState(Controller *pad, SaveState *state);
+
+// MemoryCard-related stuff:
+static int32_t MemoryCard_exchangeByte(MemoryCard *card, int32_t value,
+		bool *ack);
+static void MemoryCard_loadState(MemoryCard *card, SaveState *state);
+static void MemoryCard_flushSectors(MemoryCard *card,
+		const uint32_t *sectors, int64_t pageSize, int64_t *flushes,
+		int64_t *sectorsFlushed);
+static void MemoryCard_saveState(MemoryCard *card, SaveState *state);
+static void MemoryCard_unmap(MemoryCard *card);
+static void MemoryCard_writeSector(MemoryCard *card);
+
+/*
+ * This struct models a pad, along with the command being exchanged with it.
+ */
+struct Controller {
+
+	// Buttons held (one bit set for each, in the order the pad reports
+	// them) and stick positions, as latched from the host at the last vblank
+	uint16_t buttons;
+	uint8_t axes[4];
+
+	// Whether the pad is reporting its sticks, and whether it is in the
+	// DualShock's configuration mode
+	bool analogMode;
+	bool configMode;
+
+	// Command being exchanged, how many bytes have been exchanged since the
+	// pad was selected, and the parameters sent with the command so far
+	int32_t command;
+	int32_t position;
+	int32_t responseLength;
+	uint8_t parameters[6];
+
+	// Rumble mapping set by the configuration commands, which is kept so it
+	// can be read back although the motors aren't emulated
+	uint8_t rumbleMapping[6];
+};
+
+/*
+ * This struct models a memory card, along with the command being exchanged
+ * with it.
+ */
+struct MemoryCard {
+
+	// Image file backing the card (-1 if no card is inserted), and its
+	// contents, mapped straight from it
+	int fileDescriptor;
+	uint8_t *data;
+
+	// Sectors written since they were last handed to the write-back thread,
+	// which is only touched from the emulator thread, and sectors handed
+	// over that the thread hasn't flushed yet
+	uint32_t dirtySectors[PHILPSX_MEMORYCARD_BITMAP_WORDS];
+	uint32_t pendingSectors[PHILPSX_MEMORYCARD_BITMAP_WORDS];
+	bool dirty;
+
+	// Sectors written by the emulated software, and the number of msync calls
+	// and sectors they flushed, kept since the card was inserted
+	int64_t sectorsWritten;
+	int64_t flushes;
+	int64_t sectorsFlushed;
+
+	// Flag byte, which has bit 3 set until the first write since power on
+	uint8_t flag;
+
+	// Command being exchanged, how many bytes have been exchanged since the
+	// card was selected, the last byte received, and the sector being read
+	// or written along with its running checksum
+	int32_t command;
+	int32_t position;
+	int32_t previousByte;
+	int32_t sector;
+	int32_t checksum;
+	bool checksumMatched;
+	uint8_t sectorBuffer[PHILPSX_MEMORYCARD_SECTOR_SIZE];
+};
 
 /*
  * This struct encapsulates the state of the IO subsystem.
  */
 struct ControllerIO {
-	
+
 	// System object reference
 	SystemInterlink *system;
 
@@ -37,10 +190,38 @@ struct ControllerIO {
 
 	// Store number of cycles to change timer by
 	int32_t cycles;
+
+	// Whether a byte is being sent, and whether another is waiting to be
+	// sent after it (or once sending is enabled)
+	bool transferInProgress;
+	bool txPending;
+
+	// Device talking on the selected port
+	int32_t selectedDevice;
+
+	// Devices plugged into each port
+	Controller controllers[PHILPSX_CONTROLLERIO_PORT_COUNT];
+	MemoryCard memoryCards[PHILPSX_CONTROLLERIO_PORT_COUNT];
+
+	// Input from the host for each port, with the buttons held in the bottom
+	// 16 bits and the four stick positions above them, written from any
+	// thread
+	atomic_uint_fast64_t hostInput[PHILPSX_CONTROLLERIO_PORT_COUNT];
+
+	// Write-back worker - this flushes the sectors pending on each card,
+	// with the mutex guarding them, the busy flag and the statistics
+	pthread_t writeBackThread;
+	pthread_mutex_t writeBackMutex;
+	pthread_cond_t requestCondition;
+	pthread_cond_t idleCondition;
+	bool writeBackRequested;
+	bool writeBackBusy;
+	bool writeBackQuit;
 };
 
 /*
- * This function constructs a ControllerIO object.
+ * This function constructs a ControllerIO object, with a pad plugged into
+ * each port and no memory cards inserted.
  */
 ControllerIO *construct_ControllerIO(void)
 {
@@ -51,34 +232,111 @@ ControllerIO *construct_ControllerIO(void)
 				"ControllerIO struct\n");
 		goto end;
 	}
-	
+
 	// Zero out RX fifo
 	memset(cio->rxFifo, 0, sizeof(cio->rxFifo));
 	cio->rxCount = 0;
 
-	// Setup controller related variables
+	// Setup controller related variables, with nothing being sent
 	cio->joyBaud = 0;
 	cio->joyTxData = 0;
-	cio->joyStat = 0;
+	cio->joyStat = 0x5;
 	cio->joyMode = 0;
 	cio->joyCtrl = 0;
+	cio->transferInProgress = false;
+	cio->txPending = false;
+	cio->selectedDevice = PHILPSX_SIO_DEVICE_NONE;
 
 	// Setup cycle store
 	cio->cycles = 0;
-	
+
+	// Setup devices, with no buttons held and the sticks centred
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+		Controller *pad = &cio->controllers[i];
+		pad->buttons = 0;
+		memset(pad->axes, 0x80, sizeof(pad->axes));
+		pad->analogMode = false;
+		pad->configMode = false;
+		memset(pad->rumbleMapping, 0xFF, sizeof(pad->rumbleMapping));
+		Controller_reset(pad);
+
+		MemoryCard *card = &cio->memoryCards[i];
+		memset(card, 0, sizeof(MemoryCard));
+		card->fileDescriptor = -1;
+		card->data = NULL;
+		card->flag = 0x08;
+
+		atomic_init(&cio->hostInput[i], (uint64_t)0x80808080 << 16);
+	}
+
+	// Setup and start write-back worker
+	cio->writeBackRequested = false;
+	cio->writeBackBusy = false;
+	cio->writeBackQuit = false;
+	if (pthread_mutex_init(&cio->writeBackMutex, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't create write-back "
+				"mutex\n");
+		goto cleanup_controllerio;
+	}
+	if (pthread_cond_init(&cio->requestCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't create write-back "
+				"request condition variable\n");
+		goto cleanup_mutex;
+	}
+	if (pthread_cond_init(&cio->idleCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't create write-back "
+				"idle condition variable\n");
+		goto cleanup_requestcondition;
+	}
+	if (pthread_create(&cio->writeBackThread, NULL,
+			&ControllerIO_writeBackFunction, cio) != 0) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't start write-back "
+				"thread\n");
+		goto cleanup_idlecondition;
+	}
+
 	// Normal return:
 	return cio;
-	
-	// Cleanup path:	
+
+	// Cleanup path:
+	cleanup_idlecondition:
+	pthread_cond_destroy(&cio->idleCondition);
+
+	cleanup_requestcondition:
+	pthread_cond_destroy(&cio->requestCondition);
+
+	cleanup_mutex:
+	pthread_mutex_destroy(&cio->writeBackMutex);
+
+	cleanup_controllerio:
+	free(cio);
+	cio = NULL;
+
 	end:
 	return cio;
 }
 
 /*
- * This function destructs a ControllerIO object.
+ * This function destructs a ControllerIO object, flushing any sectors
+ * written to the memory cards before their image files are closed.
  */
 void destruct_ControllerIO(ControllerIO *cio)
 {
+	// Flush cards, then stop write-back worker
+	ControllerIO_flushMemoryCards(cio);
+	pthread_mutex_lock(&cio->writeBackMutex);
+	cio->writeBackQuit = true;
+	pthread_cond_signal(&cio->requestCondition);
+	pthread_mutex_unlock(&cio->writeBackMutex);
+	pthread_join(cio->writeBackThread, NULL);
+	pthread_cond_destroy(&cio->idleCondition);
+	pthread_cond_destroy(&cio->requestCondition);
+	pthread_mutex_destroy(&cio->writeBackMutex);
+
+	// Unmap cards
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i)
+		MemoryCard_unmap(&cio->memoryCards[i]);
+
 	free(cio);
 }
 
@@ -90,6 +348,194 @@ void ControllerIO_appendSyncCycles(ControllerIO *cio, int32_t cycles)
 	cio->cycles += cycles;
 }
 
+/*
+ * This function finishes sending the byte in progress, exchanging it with
+ * whichever device is selected. The device's acknowledgement raises an
+ * interrupt a little later if it is enabled. It is called by the system's
+ * scheduler.
+ */
+void ControllerIO_finishTransfer(ControllerIO *cio)
+{
+	if (!cio->transferInProgress)
+		return;
+	cio->transferInProgress = false;
+
+	// Exchange the byte, and put the reply in the RX fifo, replacing the
+	// last entry if it is full
+	int32_t ackDelay = 0;
+	int32_t reply = ControllerIO_exchangeByte(cio, cio->joyTxData,
+			&ackDelay);
+	if (cio->rxCount == 4)
+		--cio->rxCount;
+	cio->rxFifo[cio->rxCount++] = (int8_t)reply;
+
+	// Flag the RX fifo as holding data and sending as finished
+	cio->joyStat |= 0x7;
+
+	// Raise the acknowledgement, along with an interrupt if enabled
+	if (ackDelay > 0) {
+		cio->joyStat |= 0x80;
+		if ((cio->joyCtrl & 0x1000) == 0x1000) {
+			cio->joyStat |= 0x200;
+			SystemInterlink_setSIOInterruptDelay(cio->system, ackDelay);
+		}
+	}
+
+	// Send the next byte if one is waiting
+	if (cio->txPending && (cio->joyCtrl & 0x1) == 0x1)
+		ControllerIO_startTransfer(cio);
+}
+
+/*
+ * This function writes every sector written to the memory cards so far back
+ * to their image files, waiting for the write-back thread to finish.
+ */
+void ControllerIO_flushMemoryCards(ControllerIO *cio)
+{
+	ControllerIO_startWriteBack(cio);
+	ControllerIO_waitForWriteBack(cio);
+}
+
+/*
+ * This function reads the write-back statistics of the memory card in the
+ * specified slot since it was inserted: the sectors written by the emulated
+ * software, the msync calls made to flush them, and the sectors those calls
+ * covered, which is fewer if a sector was written again before its flush.
+ * It returns false, leaving them alone, if no card is inserted. It must be
+ * called from the thread running the emulator.
+ */
+bool ControllerIO_getMemoryCardStats(ControllerIO *cio, int32_t slot,
+		int64_t *sectorsWritten, int64_t *flushes, int64_t *sectorsFlushed)
+{
+	MemoryCard *card = &cio->memoryCards[slot];
+	bool present = false;
+
+	pthread_mutex_lock(&cio->writeBackMutex);
+	if (card->data) {
+		*sectorsWritten = card->sectorsWritten;
+		*flushes = card->flushes;
+		*sectorsFlushed = card->sectorsFlushed;
+		present = true;
+	}
+	pthread_mutex_unlock(&cio->writeBackMutex);
+
+	return present;
+}
+
+/*
+ * This function copies the input the host last set for each port into the
+ * pads, which happens at each vblank so a frame always sees the same input.
+ */
+void ControllerIO_latchInput(ControllerIO *cio)
+{
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+		uint64_t input = atomic_load_explicit(&cio->hostInput[i],
+				memory_order_relaxed);
+		cio->controllers[i].buttons = (uint16_t)input;
+		for (int32_t j = 0; j < 4; ++j)
+			cio->controllers[i].axes[j] = (uint8_t)(input >> (16 + j * 8));
+	}
+}
+
+/*
+ * This function inserts a memory card into the specified slot (0 or 1),
+ * backed by the image file at the specified path, which is created blank if
+ * it doesn't exist yet. The image is mapped into memory, and sectors the
+ * emulated software writes are flushed back to it a frame at a time. It
+ * returns false if the image couldn't be opened or mapped.
+ */
+bool ControllerIO_loadMemoryCard(ControllerIO *cio, int32_t slot,
+		const char *path)
+{
+	MemoryCard *card = &cio->memoryCards[slot];
+
+	// Open image, extending it to the size of a blank card if it was empty
+	// or has only just been created
+	int fileDescriptor = open(path, O_RDWR | O_CREAT, 0644);
+	if (fileDescriptor == -1) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't open memory card "
+				"image %s\n", path);
+		goto end;
+	}
+	struct stat fileInfo;
+	if (fstat(fileDescriptor, &fileInfo) != 0) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't get size of memory "
+				"card image %s\n", path);
+		goto cleanup_file;
+	}
+	if (fileInfo.st_size == 0 &&
+			ftruncate(fileDescriptor, PHILPSX_MEMORYCARD_SIZE) != 0) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't create memory card "
+				"image %s\n", path);
+		goto cleanup_file;
+	}
+	if (fileInfo.st_size != 0 && fileInfo.st_size != PHILPSX_MEMORYCARD_SIZE) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Memory card image %s isn't "
+				"128 KB\n", path);
+		goto cleanup_file;
+	}
+
+	// Map contents
+	uint8_t *data = mmap(NULL, PHILPSX_MEMORYCARD_SIZE,
+			PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't map memory card "
+				"image %s\n", path);
+		goto cleanup_file;
+	}
+
+	// Swap out any card already inserted, once it has been flushed
+	ControllerIO_flushMemoryCards(cio);
+	pthread_mutex_lock(&cio->writeBackMutex);
+	MemoryCard_unmap(card);
+	card->fileDescriptor = fileDescriptor;
+	card->data = data;
+	card->flag = 0x08;
+	card->sectorsWritten = 0;
+	card->flushes = 0;
+	card->sectorsFlushed = 0;
+	pthread_mutex_unlock(&cio->writeBackMutex);
+
+	// Normal return:
+	return true;
+
+	// Cleanup path:
+	cleanup_file:
+	close(fileDescriptor);
+
+	end:
+	return false;
+}
+
+/*
+ * This function reads the controller port's state back from a save state.
+ * The contents of memory cards aren't included, as they live in their image
+ * files.
+ */
+void ControllerIO_loadState(ControllerIO *cio, SaveState *state)
+{
+	SaveState_read(state, cio->rxFifo, sizeof(cio->rxFifo));
+	SaveState_read(state, &cio->rxCount, sizeof(int32_t));
+	SaveState_read(state, &cio->joyBaud, sizeof(int32_t));
+	SaveState_read(state, &cio->joyTxData, sizeof(int32_t));
+	SaveState_read(state, &cio->joyStat, sizeof(int32_t));
+	SaveState_read(state, &cio->joyMode, sizeof(int32_t));
+	SaveState_read(state, &cio->joyCtrl, sizeof(int32_t));
+	SaveState_read(state, &cio->cycles, sizeof(int32_t));
+	SaveState_read(state, &cio->transferInProgress, sizeof(bool));
+	SaveState_read(state, &cio->txPending, sizeof(bool));
+	SaveState_read(state, &cio->selectedDevice, sizeof(int32_t));
+	if (cio->rxCount < 0 || cio->rxCount > 4) {
+		SaveState_fail(state);
+		cio->rxCount = 0;
+	}
+
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+		Controller_loadState(&cio->controllers[i], state);
+		MemoryCard_loadState(&cio->memoryCards[i], state);
+	}
+}
+
 /*
  * This function reads bytes from the right place in the object.
  */
@@ -102,50 +548,119 @@ int8_t ControllerIO_readByte(ControllerIO *cio, int32_t address)
 	int32_t tempAddress = address & 0xFF;
 
 	// Declare return value
-	int8_t retVal = 0;
+	int32_t retVal = 0;
 
 	// Determine what to read based on this
 	switch (tempAddress) {
 		case 0x40: // JOY_RX_DATA 1st fifo entry
-			if (cio->rxCount > 0) {
-				retVal = cio->rxFifo[0];
-				--cio->rxCount;
-			}
+			ControllerIO_readRxData(cio, &retVal);
 			break;
 		case 0x44: // JOY_STAT 1st (lowest) byte
-			ControllerIO_updateJoyStat(cio);
-			retVal = (int8_t)(cio->joyStat & 0xFF);
+			retVal = cio->joyStat & 0xFF;
 			break;
 		case 0x45: // JOY_STAT 2nd byte
-			retVal = (int8_t)(logical_rshift(cio->joyStat, 8) & 0xFF);
+			retVal = logical_rshift(cio->joyStat, 8) & 0xFF;
 			break;
 		case 0x46: // JOY_STAT 3rd byte
-			retVal = (int8_t)(logical_rshift(cio->joyStat, 16) & 0xFF);
+			retVal = logical_rshift(cio->joyStat, 16) & 0xFF;
 			break;
 		case 0x47: // JOY_STAT 4th (highest) byte
-			retVal = (int8_t)(logical_rshift(cio->joyStat, 24) & 0xFF);
+			retVal = logical_rshift(cio->joyStat, 24) & 0xFF;
 			break;
 		case 0x48: // JOY_MODE lower byte
-			retVal = (int8_t)(cio->joyMode & 0xFF);
+			retVal = cio->joyMode & 0xFF;
 			break;
 		case 0x49: // JOY_MODE higher byte
-			retVal = (int8_t)(logical_rshift(cio->joyMode, 8) & 0xFF);
+			retVal = logical_rshift(cio->joyMode, 8) & 0xFF;
 			break;
 		case 0x4A: // JOY_CTRL lower byte
-			retVal = (int8_t)(cio->joyCtrl & 0xFF);
+			retVal = cio->joyCtrl & 0xFF;
 			break;
 		case 0x4B: // JOY_CTRL higher byte
-			retVal = (int8_t)(logical_rshift(cio->joyCtrl, 8) & 0xFF);
+			retVal = logical_rshift(cio->joyCtrl, 8) & 0xFF;
 			break;
 		case 0x4E: // JOY_BAUD lower byte
-			retVal = (int8_t)(cio->joyBaud & 0xFF);
+			retVal = cio->joyBaud & 0xFF;
 			break;
 		case 0x4F: // JOY_BAUD higher byte
-			retVal = (int8_t)(logical_rshift(cio->joyBaud, 8) & 0xFF);
+			retVal = logical_rshift(cio->joyBaud, 8) & 0xFF;
 			break;
 	}
 
-	return retVal;
+	return (int8_t)retVal;
+}
+
+/*
+ * This function writes the controller port's state to a save state. Memory
+ * cards are flushed first, so their image files match the state.
+ */
+void ControllerIO_saveState(ControllerIO *cio, SaveState *state)
+{
+	ControllerIO_flushMemoryCards(cio);
+
+	SaveState_write(state, cio->rxFifo, sizeof(cio->rxFifo));
+	SaveState_write(state, &cio->rxCount, sizeof(int32_t));
+	SaveState_write(state, &cio->joyBaud, sizeof(int32_t));
+	SaveState_write(state, &cio->joyTxData, sizeof(int32_t));
+	SaveState_write(state, &cio->joyStat, sizeof(int32_t));
+	SaveState_write(state, &cio->joyMode, sizeof(int32_t));
+	SaveState_write(state, &cio->joyCtrl, sizeof(int32_t));
+	SaveState_write(state, &cio->cycles, sizeof(int32_t));
+	SaveState_write(state, &cio->transferInProgress, sizeof(bool));
+	SaveState_write(state, &cio->txPending, sizeof(bool));
+	SaveState_write(state, &cio->selectedDevice, sizeof(int32_t));
+
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+		Controller_saveState(&cio->controllers[i], state);
+		MemoryCard_saveState(&cio->memoryCards[i], state);
+	}
+}
+
+/*
+ * This function sets the input from the host for the pad in the specified
+ * port (0 or 1), to be picked up at the next vblank. Buttons held have their
+ * bits set, in the order the pad reports them, and axes holds the right
+ * stick's X and Y then the left stick's, or is NULL to centre them. It can
+ * be called from any thread.
+ */
+void ControllerIO_setHostInput(ControllerIO *cio, int32_t port,
+		uint16_t buttons, const uint8_t *axes)
+{
+	uint64_t input = buttons;
+	for (int32_t i = 0; i < 4; ++i)
+		input |= (uint64_t)(axes ? axes[i] : 0x80) << (16 + i * 8);
+	atomic_store_explicit(&cio->hostInput[port], input,
+			memory_order_relaxed);
+}
+
+/*
+ * This function hands the sectors written to the memory cards since it was
+ * last called to the write-back thread, without waiting for them to be
+ * flushed. It is called at each vblank.
+ */
+void ControllerIO_startWriteBack(ControllerIO *cio)
+{
+	// Leave straight away if nothing has been written
+	bool dirty = false;
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i)
+		dirty |= cio->memoryCards[i].dirty;
+	if (!dirty)
+		return;
+
+	pthread_mutex_lock(&cio->writeBackMutex);
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+		MemoryCard *card = &cio->memoryCards[i];
+		if (!card->dirty)
+			continue;
+		for (int32_t j = 0; j < PHILPSX_MEMORYCARD_BITMAP_WORDS; ++j) {
+			card->pendingSectors[j] |= card->dirtySectors[j];
+			card->dirtySectors[j] = 0;
+		}
+		card->dirty = false;
+	}
+	cio->writeBackRequested = true;
+	pthread_cond_signal(&cio->requestCondition);
+	pthread_mutex_unlock(&cio->writeBackMutex);
 }
 
 /*
@@ -162,7 +677,7 @@ void ControllerIO_writeByte(ControllerIO *cio, int32_t address, int8_t value)
 	// Determine what to write based on this
 	switch (tempAddress) {
 		case 0x40: // JOY_TX_DATA lower byte
-			cio->joyTxData = value & 0xFF;
+			ControllerIO_writeTxData(cio, value & 0xFF);
 			break;
 		case 0x48: // JOY_MODE lower byte
 			cio->joyMode = (cio->joyMode & 0xFF00) | (value & 0xFF);
@@ -171,24 +686,22 @@ void ControllerIO_writeByte(ControllerIO *cio, int32_t address, int8_t value)
 			cio->joyMode = ((value & 0xFF) << 8) | (cio->joyMode & 0xFF);
 			break;
 		case 0x4A: // JOY_CTRL lower byte
-			cio->joyCtrl = (cio->joyCtrl & 0xFF00) | (value & 0xFF);
+			ControllerIO_writeControl(cio,
+					(cio->joyCtrl & 0xFF00) | (value & 0xFF));
 			break;
 		case 0x4B: // JOY_CTRL higher byte
-			cio->joyCtrl = ((value & 0xFF) << 8) | (cio->joyCtrl & 0xFF);
+			ControllerIO_writeControl(cio,
+					((value & 0xFF) << 8) | (cio->joyCtrl & 0xFF));
 			break;
 		case 0x4E: // JOY_BAUD lower byte
-		{
 			cio->joyBaud = (cio->joyBaud & 0xFF00) | (value & 0xFF);
-			int32_t baudRate = cio->joyBaud * (cio->joyMode & 0x3) / 2;
-			cio->joyStat = (baudRate << 11) | (cio->joyStat & 0x7FF);
-		}
+			cio->joyStat = (ControllerIO_getBaudrateReload(cio) << 11) |
+					(cio->joyStat & 0x7FF);
 			break;
 		case 0x4F: // JOY_BAUD higher byte
-		{
 			cio->joyBaud = ((value & 0xFF) << 8) | (cio->joyBaud & 0xFF);
-			int32_t baudRate = cio->joyBaud * (cio->joyMode & 0x3) / 2;
-			cio->joyStat = (baudRate << 11) | (cio->joyStat & 0x7FF);
-		}
+			cio->joyStat = (ControllerIO_getBaudrateReload(cio) << 11) |
+					(cio->joyStat & 0x7FF);
 			break;
 	}
 }
@@ -199,6 +712,172 @@ void ControllerIO_writeByte(ControllerIO *cio, int32_t address, int8_t value)
 void ControllerIO_setMemoryInterface(ControllerIO *cio, SystemInterlink *smi)
 {
 	cio->system = smi;
+
+	// Install handlers for the controller and memory card registers, with
+	// word accesses split into halfwords
+	SystemInterlink_registerIoHandlers(smi, 0x1F801040, 0x10,
+			PHILPSX_IO_BYTE, cio, ControllerIO_readRegisterByte,
+			ControllerIO_writeRegisterByte);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801040, 0x10,
+			PHILPSX_IO_HALFWORD, cio, ControllerIO_readRegisterHalfWord,
+			ControllerIO_writeRegisterHalfWord);
+}
+
+/*
+ * This function ends the exchange with whichever device was selected, as
+ * happens when the select line is released, so the next byte picks a
+ * device again.
+ */
+static void ControllerIO_deselect(ControllerIO *cio)
+{
+	cio->selectedDevice = PHILPSX_SIO_DEVICE_NONE;
+	for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+		Controller_reset(&cio->controllers[i]);
+		cio->memoryCards[i].position = 0;
+	}
+}
+
+/*
+ * This function exchanges a byte with the device selected on the selected
+ * port, returning its reply. The first byte after the port is selected picks
+ * the device - 01h for the pad and 81h for the memory card - and a device
+ * that doesn't acknowledge a byte drops out of the exchange. ackDelay is set
+ * to the cycles the device takes to acknowledge the byte, or left at 0 if it
+ * doesn't.
+ */
+static int32_t ControllerIO_exchangeByte(ControllerIO *cio, int32_t value,
+		int32_t *ackDelay)
+{
+	// Nothing answers unless a port is selected
+	if ((cio->joyCtrl & 0x2) == 0)
+		return 0xFF;
+	int32_t port = logical_rshift(cio->joyCtrl, 13) & 0x1;
+
+	// Pass byte on to the device
+	int32_t reply = 0xFF;
+	bool ack = false;
+	switch (cio->selectedDevice) {
+		case PHILPSX_SIO_DEVICE_NONE:
+			if (value == 0x01) {
+				cio->selectedDevice = PHILPSX_SIO_DEVICE_CONTROLLER;
+				*ackDelay = PHILPSX_CONTROLLER_ACK_DELAY;
+			} else if (value == 0x81 && cio->memoryCards[port].data) {
+				cio->selectedDevice = PHILPSX_SIO_DEVICE_MEMORYCARD;
+				*ackDelay = PHILPSX_MEMORYCARD_ACK_DELAY;
+			} else {
+				cio->selectedDevice = PHILPSX_SIO_DEVICE_IGNORED;
+			}
+			return 0xFF;
+		case PHILPSX_SIO_DEVICE_CONTROLLER:
+			reply = Controller_exchangeByte(&cio->controllers[port], value,
+					&ack);
+			if (ack)
+				*ackDelay = PHILPSX_CONTROLLER_ACK_DELAY;
+			break;
+		case PHILPSX_SIO_DEVICE_MEMORYCARD:
+			reply = MemoryCard_exchangeByte(&cio->memoryCards[port], value,
+					&ack);
+			if (ack)
+				*ackDelay = PHILPSX_MEMORYCARD_ACK_DELAY;
+			break;
+	}
+
+	// Drop the device out of the exchange if it didn't acknowledge
+	if (!ack)
+		cio->selectedDevice = PHILPSX_SIO_DEVICE_IGNORED;
+
+	return reply;
+}
+
+/*
+ * This function returns the value the baudrate timer is reloaded with, which
+ * is half the number of cycles each bit takes to send.
+ */
+static int32_t ControllerIO_getBaudrateReload(ControllerIO *cio)
+{
+	static const int32_t factors[4] = {1, 1, 16, 64};
+	return cio->joyBaud * factors[cio->joyMode & 0x3] / 2;
+}
+
+/*
+ * This function handles byte reads from the controller registers.
+ */
+static int32_t ControllerIO_readRegisterByte(void *component,
+		int32_t address)
+{
+	return ControllerIO_readByte(component, address);
+}
+
+/*
+ * This function handles halfword reads from the controller registers.
+ */
+static int32_t ControllerIO_readRegisterHalfWord(void *component,
+		int32_t address)
+{
+	ControllerIO *cio = component;
+
+	// Update baudrate timer
+	ControllerIO_updateBaudrateTimer(cio);
+
+	// Declare return value
+	int32_t retVal = 0;
+
+	// Determine what to read based on least significant byte of address
+	switch (address & 0xFE) {
+		case 0x40: // JOY_RX_DATA 1st fifo entry
+			ControllerIO_readRxData(cio, &retVal);
+			break;
+		case 0x44: // JOY_STAT lower halfword
+			retVal = cio->joyStat & 0xFFFF;
+			break;
+		case 0x46: // JOY_STAT higher halfword
+			retVal = logical_rshift(cio->joyStat, 16) & 0xFFFF;
+			break;
+		case 0x48: // JOY_MODE
+			retVal = cio->joyMode & 0xFFFF;
+			break;
+		case 0x4A: // JOY_CTRL
+			retVal = cio->joyCtrl & 0xFFFF;
+			break;
+		case 0x4E: // JOY_BAUD
+			retVal = cio->joyBaud & 0xFFFF;
+			break;
+	}
+
+	return retVal;
+}
+
+/*
+ * This function pops the first entry off the RX fifo into value, leaving
+ * value alone if the fifo is empty.
+ */
+static void ControllerIO_readRxData(ControllerIO *cio, int32_t *value)
+{
+	if (cio->rxCount == 0)
+		return;
+
+	*value = cio->rxFifo[0] & 0xFF;
+	memmove(cio->rxFifo, cio->rxFifo + 1, sizeof(cio->rxFifo) - 1);
+	if (--cio->rxCount == 0)
+		cio->joyStat &= ~0x2;
+}
+
+/*
+ * This function starts sending the byte in JOY_TX_DATA, which finishes once
+ * eight bits have been sent at the programmed baud rate.
+ */
+static void ControllerIO_startTransfer(ControllerIO *cio)
+{
+	cio->transferInProgress = true;
+	cio->txPending = false;
+
+	// The TX fifo is free again straight away, but sending isn't finished
+	// and the acknowledgement from the last byte is released
+	cio->joyStat = (cio->joyStat | 0x1) & ~0x84;
+
+	int32_t byteCycles = ControllerIO_getBaudrateReload(cio) * 2 * 8;
+	SystemInterlink_setSIOTransferDelay(cio->system,
+			byteCycles > 0 ? byteCycles : 1);
 }
 
 /*
@@ -210,15 +889,532 @@ static void ControllerIO_updateBaudrateTimer(ControllerIO *cio)
 	baudRate -= cio->cycles;
 	cio->cycles = 0;
 	if (baudRate < 0) {
-		baudRate = cio->joyBaud * (cio->joyMode & 0x3) / 2;
+		baudRate = ControllerIO_getBaudrateReload(cio);
 	}
 	cio->joyStat = (baudRate << 11) | (cio->joyStat & 0x7FF);
 }
 
 /*
- * This function updates joyStat.
+ * This function waits for the write-back thread to flush everything it has
+ * been handed.
  */
-static void ControllerIO_updateJoyStat(ControllerIO *cio)
+static void ControllerIO_waitForWriteBack(ControllerIO *cio)
 {
-	cio->joyStat |= 0x7;
-}
\ No newline at end of file
+	pthread_mutex_lock(&cio->writeBackMutex);
+	while (cio->writeBackRequested || cio->writeBackBusy)
+		pthread_cond_wait(&cio->idleCondition, &cio->writeBackMutex);
+	pthread_mutex_unlock(&cio->writeBackMutex);
+}
+
+/*
+ * This function is the body of the write-back thread. For each request, it
+ * takes the sectors pending on each card and flushes them to the image
+ * files.
+ */
+static void *ControllerIO_writeBackFunction(void *arg)
+{
+	ControllerIO *cio = arg;
+	int64_t pageSize = sysconf(_SC_PAGESIZE);
+
+	for (;;) {
+
+		// Wait for the next request, or for the signal to quit
+		pthread_mutex_lock(&cio->writeBackMutex);
+		while (!cio->writeBackQuit && !cio->writeBackRequested)
+			pthread_cond_wait(&cio->requestCondition,
+					&cio->writeBackMutex);
+		if (cio->writeBackQuit) {
+			pthread_mutex_unlock(&cio->writeBackMutex);
+			break;
+		}
+		cio->writeBackRequested = false;
+		cio->writeBackBusy = true;
+
+		// Flush each card's pending sectors, letting go of the mutex while
+		// doing so - cards are only swapped out once we are idle
+		for (int32_t i = 0; i < PHILPSX_CONTROLLERIO_PORT_COUNT; ++i) {
+			MemoryCard *card = &cio->memoryCards[i];
+			uint32_t sectors[PHILPSX_MEMORYCARD_BITMAP_WORDS];
+			memcpy(sectors, card->pendingSectors, sizeof(sectors));
+			memset(card->pendingSectors, 0, sizeof(card->pendingSectors));
+			if (!card->data)
+				continue;
+			int64_t flushes = 0, sectorsFlushed = 0;
+			pthread_mutex_unlock(&cio->writeBackMutex);
+			MemoryCard_flushSectors(card, sectors, pageSize, &flushes,
+					&sectorsFlushed);
+			pthread_mutex_lock(&cio->writeBackMutex);
+			card->flushes += flushes;
+			card->sectorsFlushed += sectorsFlushed;
+		}
+
+		// Tell anyone waiting that we are idle
+		cio->writeBackBusy = false;
+		pthread_cond_broadcast(&cio->idleCondition);
+		pthread_mutex_unlock(&cio->writeBackMutex);
+	}
+
+	return NULL;
+}
+
+/*
+ * This function writes JOY_CTRL. Bit 4 acknowledges the interrupt and bit 6
+ * resets the port, neither of which is kept, and releasing the select line
+ * or switching port ends the exchange with the selected device.
+ */
+static void ControllerIO_writeControl(ControllerIO *cio, int32_t value)
+{
+	int32_t previousControl = cio->joyCtrl;
+	cio->joyCtrl = value & 0xFFAF;
+
+	// Reset port, abandoning any byte being sent
+	if ((value & 0x40) == 0x40) {
+		cio->rxCount = 0;
+		cio->joyMode = 0;
+		cio->joyCtrl = 0;
+		cio->joyStat = (cio->joyStat & 0xFFFFF800) | 0x5;
+		cio->transferInProgress = false;
+		cio->txPending = false;
+	}
+
+	// Acknowledge interrupt
+	if ((value & 0x10) == 0x10)
+		cio->joyStat &= ~0x208;
+
+	// End exchange if the select line was released or the port changed
+	if ((cio->joyCtrl & 0x2) == 0 ||
+			((cio->joyCtrl ^ previousControl) & 0x2000) != 0)
+		ControllerIO_deselect(cio);
+
+	// Send any byte waiting now sending is enabled
+	if (cio->txPending && !cio->transferInProgress &&
+			(cio->joyCtrl & 0x1) == 0x1)
+		ControllerIO_startTransfer(cio);
+}
+
+/*
+ * This function handles byte writes to the controller registers.
+ */
+static void ControllerIO_writeRegisterByte(void *component, int32_t address,
+		int32_t value)
+{
+	ControllerIO_writeByte(component, address, (int8_t)value);
+}
+
+/*
+ * This function handles halfword writes to the controller registers.
+ */
+static void ControllerIO_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value)
+{
+	ControllerIO *cio = component;
+
+	// Update baudrate timer
+	ControllerIO_updateBaudrateTimer(cio);
+
+	// Determine what to write based on least significant byte of address
+	switch (address & 0xFE) {
+		case 0x40: // JOY_TX_DATA
+			ControllerIO_writeTxData(cio, value & 0xFF);
+			break;
+		case 0x48: // JOY_MODE
+			cio->joyMode = value & 0xFFFF;
+			break;
+		case 0x4A: // JOY_CTRL
+			ControllerIO_writeControl(cio, value & 0xFFFF);
+			break;
+		case 0x4E: // JOY_BAUD
+			cio->joyBaud = value & 0xFFFF;
+			cio->joyStat = (ControllerIO_getBaudrateReload(cio) << 11) |
+					(cio->joyStat & 0x7FF);
+			break;
+	}
+}
+
+/*
+ * This function writes JOY_TX_DATA, sending the byte straight away if
+ * sending is enabled and no other byte is being sent, or once it is
+ * otherwise.
+ */
+static void ControllerIO_writeTxData(ControllerIO *cio, int32_t value)
+{
+	cio->joyTxData = value;
+	cio->txPending = true;
+	if (!cio->transferInProgress && (cio->joyCtrl & 0x1) == 0x1)
+		ControllerIO_startTransfer(cio);
+}
+
+/*
+ * This function exchanges a byte with the pad, after the 01h that selected
+ * it, returning its reply and setting ack if it acknowledges the byte, which
+ * it does for all but the last byte of a command. The pad identifies itself
+ * as digital (41h), analog (73h) or in configuration mode (F3h), and the low
+ * digit of that is the number of halfwords that follow the 5Ah after it.
+ */
+static int32_t Controller_exchangeByte(Controller *pad, int32_t value,
+		bool *ack)
+{
+	int32_t index = ++pad->position;
+
+	// Command byte - outside configuration mode only polling (42h) and
+	// entering configuration mode (43h) are understood
+	if (index == 1) {
+		if (pad->configMode ? (value & 0xF0) != 0x40 :
+				value != 0x42 && value != 0x43)
+			return 0xFF;
+		pad->command = value;
+		pad->responseLength = (pad->analogMode || pad->configMode) ? 6 : 2;
+		*ack = true;
+		return pad->configMode ? 0xF3 : pad->analogMode ? 0x73 : 0x41;
+	}
+	if (index == 2) {
+		*ack = true;
+		return 0x5A;
+	}
+
+	// Parameter and response bytes, acting on the command after the last
+	int32_t responseIndex = index - 3;
+	if (responseIndex >= pad->responseLength)
+		return 0xFF;
+	pad->parameters[responseIndex] = (uint8_t)value;
+	int32_t reply = Controller_getResponseByte(pad, responseIndex);
+	if (responseIndex == pad->responseLength - 1)
+		Controller_finishCommand(pad);
+	else
+		*ack = true;
+
+	return reply;
+}
+
+/*
+ * This function acts on the command just exchanged with the pad, using the
+ * parameters sent with it.
+ */
+static void Controller_finishCommand(Controller *pad)
+{
+	switch (pad->command) {
+		case 0x43: // Enter or leave configuration mode
+			pad->configMode = pad->parameters[0] == 0x01;
+			break;
+		case 0x44: // Switch between digital and analog
+			if (pad->configMode)
+				pad->analogMode = pad->parameters[0] == 0x01;
+			break;
+		case 0x4D: // Map rumble motors
+			memcpy(pad->rumbleMapping, pad->parameters,
+					sizeof(pad->rumbleMapping));
+			break;
+	}
+}
+
+/*
+ * This function returns the byte the pad replies with at the specified
+ * position after the 5Ah of the command being exchanged. Polling returns the
+ * buttons (with a bit cleared for each one held) followed by the right and
+ * left sticks in analog mode, and entering configuration mode polls as well
+ * unless the pad is already in it. Configuration commands return constants
+ * describing the pad, some picked by the first parameter.
+ */
+static int32_t Controller_getResponseByte(Controller *pad, int32_t index)
+{
+	uint8_t response[6] = {0, 0, 0, 0, 0, 0};
+	switch (pad->command) {
+		case 0x42: // Poll
+		case 0x43: // Configuration mode
+			if (pad->command == 0x43 && pad->configMode)
+				break;
+			response[0] = (uint8_t)~pad->buttons;
+			response[1] = (uint8_t)(~pad->buttons >> 8);
+			memcpy(response + 2, pad->axes, sizeof(pad->axes));
+			break;
+		case 0x45: // Status
+			response[0] = 0x01;
+			response[1] = 0x02;
+			response[2] = pad->analogMode ? 0x01 : 0x00;
+			response[3] = 0x02;
+			response[4] = 0x01;
+			break;
+		case 0x46: // Actuator information
+			response[2] = 0x01;
+			response[3] = pad->parameters[0] == 0x01 ? 0x01 : 0x02;
+			response[4] = pad->parameters[0] == 0x01 ? 0x01 : 0x00;
+			response[5] = pad->parameters[0] == 0x01 ? 0x14 : 0x0A;
+			if (pad->parameters[0] > 0x01)
+				memset(response, 0, sizeof(response));
+			break;
+		case 0x47: // Combination information
+			response[2] = 0x02;
+			response[4] = 0x01;
+			break;
+		case 0x4C: // Mode information
+			if (pad->parameters[0] <= 0x01)
+				response[3] = pad->parameters[0] == 0x01 ? 0x07 : 0x04;
+			break;
+		case 0x4D: // Rumble mapping, returning the previous one
+			memcpy(response, pad->rumbleMapping, sizeof(response));
+			break;
+	}
+
+	return response[index];
+}
+
+/*
+ * This function reads the state of the pad back from a save state, apart from
+ * the input latched from the host, which is kept.
+ */
+static void Controller_loadState(Controller *pad, SaveState *state)
+{
+	SaveState_read(state, &pad->analogMode, sizeof(bool));
+	SaveState_read(state, &pad->configMode, sizeof(bool));
+	SaveState_read(state, &pad->command, sizeof(int32_t));
+	SaveState_read(state, &pad->position, sizeof(int32_t));
+	SaveState_read(state, &pad->responseLength, sizeof(int32_t));
+	SaveState_read(state, pad->parameters, sizeof(pad->parameters));
+	SaveState_read(state, pad->rumbleMapping, sizeof(pad->rumbleMapping));
+	if (pad->responseLength < 0 || pad->responseLength > 6) {
+		SaveState_fail(state);
+		Controller_reset(pad);
+	}
+}
+
+/*
+ * This function readies the pad for the next command, as happens when it
+ * is deselected.
+ */
+static void Controller_reset(Controller *pad)
+{
+	pad->command = 0;
+	pad->position = 0;
+	pad->responseLength = 0;
+	memset(pad->parameters, 0, sizeof(pad->parameters));
+}
+
+/*
+ * This function writes the state of the pad to a save state.
+ */
+static void Controller_saveState(Controller *pad, SaveState *state)
+{
+	SaveState_write(state, &pad->analogMode, sizeof(bool));
+	SaveState_write(state, &pad->configMode, sizeof(bool));
+	SaveState_write(state, &pad->command, sizeof(int32_t));
+	SaveState_write(state, &pad->position, sizeof(int32_t));
+	SaveState_write(state, &pad->responseLength, sizeof(int32_t));
+	SaveState_write(state, pad->parameters, sizeof(pad->parameters));
+	SaveState_write(state, pad->rumbleMapping, sizeof(pad->rumbleMapping));
+}
+
+/*
+ * This function exchanges a byte with the memory card, after the 81h that
+ * selected it, returning its reply and setting ack if it acknowledges the
+ * byte, which it does for all but the last byte of a command. Every command
+ * starts by returning the flag byte and the card's ID (5Ah, 5Dh), and reads
+ * (52h), writes (57h) and ID queries (53h) are understood. Sector numbers go
+ * up to 3FFh, and each sector's data is followed by the exclusive-or of its
+ * address and data bytes as a checksum.
+ */
+static int32_t MemoryCard_exchangeByte(MemoryCard *card, int32_t value,
+		bool *ack)
+{
+	int32_t index = ++card->position;
+	int32_t previousByte = card->previousByte;
+	card->previousByte = value;
+
+	// Command byte, and ID
+	if (index == 1) {
+		card->command = value;
+		*ack = value == 0x52 || value == 0x57 || value == 0x53;
+		return card->flag;
+	}
+	if (index <= 3) {
+		*ack = true;
+		return index == 2 ? 0x5A : 0x5D;
+	}
+
+	// Rest of command
+	*ack = true;
+	switch (card->command) {
+		case 0x52: // Read sector
+			switch (index) {
+				case 4: // Sector number MSB
+					card->sector = (value & 0xFF) << 8;
+					return 0x00;
+				case 5: // Sector number LSB
+					card->sector |= value & 0xFF;
+					return previousByte;
+				case 6:
+					return 0x5C;
+				case 7:
+					return 0x5D;
+				case 8: // Confirmed sector number MSB
+					if (card->sector >= PHILPSX_MEMORYCARD_SECTOR_COUNT) {
+						*ack = false;
+						return 0xFF;
+					}
+					card->checksum = logical_rshift(card->sector, 8) ^
+							(card->sector & 0xFF);
+					return logical_rshift(card->sector, 8);
+				case 9: // Confirmed sector number LSB
+					return card->sector & 0xFF;
+			}
+			if (index < 10 + PHILPSX_MEMORYCARD_SECTOR_SIZE) {
+				int32_t data = card->data[card->sector *
+						PHILPSX_MEMORYCARD_SECTOR_SIZE + index - 10];
+				card->checksum ^= data;
+				return data;
+			}
+			if (index == 10 + PHILPSX_MEMORYCARD_SECTOR_SIZE)
+				return card->checksum;
+			*ack = false;
+			return 0x47;
+		case 0x57: // Write sector
+			switch (index) {
+				case 4: // Sector number MSB
+					card->sector = (value & 0xFF) << 8;
+					return 0x00;
+				case 5: // Sector number LSB
+					card->sector |= value & 0xFF;
+					card->checksum = logical_rshift(card->sector, 8) ^
+							(card->sector & 0xFF);
+					return previousByte;
+			}
+			if (index < 6 + PHILPSX_MEMORYCARD_SECTOR_SIZE) {
+				card->sectorBuffer[index - 6] = (uint8_t)value;
+				card->checksum ^= value & 0xFF;
+				return previousByte;
+			}
+			switch (index - 6 - PHILPSX_MEMORYCARD_SECTOR_SIZE) {
+				case 0: // Checksum
+					card->checksumMatched = card->checksum == (value & 0xFF);
+					return previousByte;
+				case 1:
+					return 0x5C;
+				case 2:
+					return 0x5D;
+			}
+			*ack = false;
+			card->flag &= ~0x08;
+			if (card->sector >= PHILPSX_MEMORYCARD_SECTOR_COUNT)
+				return 0xFF;
+			if (!card->checksumMatched)
+				return 0x4E;
+			MemoryCard_writeSector(card);
+			return 0x47;
+		case 0x53: // Get ID
+		{
+			static const int32_t id[] = {0x5C, 0x5D, 0x04, 0x00, 0x00, 0x80};
+			*ack = index < 9;
+			return index < 10 ? id[index - 4] : 0xFF;
+		}
+	}
+
+	*ack = false;
+	return 0xFF;
+}
+
+/*
+ * This function flushes the specified sectors of the memory card to its
+ * image file, with an msync call for each run of them, adding the number of
+ * calls and sectors to flushes and sectorsFlushed.
+ */
+static void MemoryCard_flushSectors(MemoryCard *card,
+		const uint32_t *sectors, int64_t pageSize, int64_t *flushes,
+		int64_t *sectorsFlushed)
+{
+	for (int32_t sector = 0; sector < PHILPSX_MEMORYCARD_SECTOR_COUNT;) {
+
+		// Find the next run of sectors
+		if ((sectors[sector / 32] & (1U << (sector % 32))) == 0) {
+			++sector;
+			continue;
+		}
+		int32_t runStart = sector;
+		while (sector < PHILPSX_MEMORYCARD_SECTOR_COUNT &&
+				(sectors[sector / 32] & (1U << (sector % 32))) != 0)
+			++sector;
+
+		// Flush the pages covering it
+		int64_t rangeStart = ((int64_t)runStart *
+				PHILPSX_MEMORYCARD_SECTOR_SIZE) & ~(pageSize - 1);
+		int64_t rangeEnd = (int64_t)sector * PHILPSX_MEMORYCARD_SECTOR_SIZE;
+		if (msync(card->data + rangeStart, rangeEnd - rangeStart,
+				MS_SYNC) != 0) {
+			fprintf(stderr, "PhilPSX: ControllerIO: Couldn't write sectors "
+					"%d to %d back to memory card image\n", runStart,
+					sector - 1);
+		}
+		++*flushes;
+		*sectorsFlushed += sector - runStart;
+	}
+}
+
+/*
+ * This function reads the state of the memory card's current command back
+ * from a save state.
+ */
+static void MemoryCard_loadState(MemoryCard *card, SaveState *state)
+{
+	SaveState_read(state, &card->flag, sizeof(uint8_t));
+	SaveState_read(state, &card->command, sizeof(int32_t));
+	SaveState_read(state, &card->position, sizeof(int32_t));
+	SaveState_read(state, &card->previousByte, sizeof(int32_t));
+	SaveState_read(state, &card->sector, sizeof(int32_t));
+	SaveState_read(state, &card->checksum, sizeof(int32_t));
+	SaveState_read(state, &card->checksumMatched, sizeof(bool));
+	SaveState_read(state, card->sectorBuffer, sizeof(card->sectorBuffer));
+	if (card->sector < 0 || card->sector > 0xFFFF) {
+		SaveState_fail(state);
+		card->sector = 0;
+	}
+}
+
+/*
+ * This function writes the state of the memory card's current command to a
+ * save state.
+ */
+static void MemoryCard_saveState(MemoryCard *card, SaveState *state)
+{
+	SaveState_write(state, &card->flag, sizeof(uint8_t));
+	SaveState_write(state, &card->command, sizeof(int32_t));
+	SaveState_write(state, &card->position, sizeof(int32_t));
+	SaveState_write(state, &card->previousByte, sizeof(int32_t));
+	SaveState_write(state, &card->sector, sizeof(int32_t));
+	SaveState_write(state, &card->checksum, sizeof(int32_t));
+	SaveState_write(state, &card->checksumMatched, sizeof(bool));
+	SaveState_write(state, card->sectorBuffer, sizeof(card->sectorBuffer));
+}
+
+/*
+ * This function unmaps the memory card and closes its image file, if one is
+ * inserted, leaving the slot empty. Anything written must have been flushed
+ * already.
+ */
+static void MemoryCard_unmap(MemoryCard *card)
+{
+	if (!card->data)
+		return;
+
+	if (munmap(card->data, PHILPSX_MEMORYCARD_SIZE) != 0) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't unmap memory card "
+				"image\n");
+	}
+	if (close(card->fileDescriptor) != 0) {
+		fprintf(stderr, "PhilPSX: ControllerIO: Couldn't close memory card "
+				"image\n");
+	}
+	card->fileDescriptor = -1;
+	card->data = NULL;
+}
+
+/*
+ * This function stores the sector just written to the memory card in its
+ * mapping, and marks it dirty to be flushed at the next vblank.
+ */
+static void MemoryCard_writeSector(MemoryCard *card)
+{
+	memcpy(card->data + (int64_t)card->sector *
+			PHILPSX_MEMORYCARD_SECTOR_SIZE, card->sectorBuffer,
+			sizeof(card->sectorBuffer));
+	card->dirtySectors[card->sector / 32] |= 1U << (card->sector % 32);
+	card->dirty = true;
+	++card->sectorsWritten;
+}
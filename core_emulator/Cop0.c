@@ -13,6 +13,9 @@
 #include "../headers/Cop0_all.h"
 #include "../headers/math_utils.h"
 
+// Forward declarations for functions private to this class
+static void Cop0_updateInterruptPending(Cop0 *sccp);
+
 /*
  * This constructs a Cop0 object using the pre-allocated struct referenced by
  * sccp.
@@ -42,6 +45,7 @@ void Cop0_reset(Cop0 *sccp)
 											// status register to 0
 
 	sccp->conditionLine = false;
+	Cop0_updateInterruptPending(sccp);
 }
 
 /*
@@ -60,6 +64,29 @@ void Cop0_setConditionLineStatus(Cop0 *sccp, bool status)
 	sccp->conditionLine = status;
 }
 
+/*
+ * This function returns whether an interrupt is pending in the cause
+ * register and enabled by the status register, so should be taken.
+ */
+bool Cop0_isInterruptPending(Cop0 *sccp)
+{
+	return sccp->interruptPending;
+}
+
+/*
+ * This function sets bit 10 of the cause register to the state of the
+ * interrupt line from the rest of the system, leaving it alone if it is
+ * already right.
+ */
+void Cop0_setInterruptLine(Cop0 *sccp, bool asserted)
+{
+	if (((sccp->copRegisters[13] & 0x400) == 0x400) == asserted)
+		return;
+
+	sccp->copRegisters[13] ^= 0x400;
+	Cop0_updateInterruptPending(sccp);
+}
+
 /**
  * This executes the RFE Cop0 instruction.
  */
@@ -179,6 +206,11 @@ void Cop0_writeReg(Cop0 *sccp, int32_t reg, int32_t value, bool override)
 				break;
 		}
 	}
+
+	// Work out whether an interrupt is pending again if this was the status
+	// or cause register
+	if (reg == 12 || reg == 13)
+		Cop0_updateInterruptPending(sccp);
 }
 
 /*
@@ -325,4 +357,17 @@ bool Cop0_isCoProcessorUsable(Cop0 *sccp, int32_t copNum)
 	int32_t usableFlags = logical_rshift(sccp->copRegisters[12], 28);
 	usableFlags = logical_rshift(usableFlags, copNum) & 0x1;
 	return usableFlags == 1;
-}
\ No newline at end of file
+}
+
+/*
+ * This function works out whether an interrupt is pending and enabled, which
+ * it is when interrupts are enabled and any pending bit of the cause register
+ * is unmasked by the status register.
+ */
+static void Cop0_updateInterruptPending(Cop0 *sccp)
+{
+	int32_t statusRegister = sccp->copRegisters[12];
+	int32_t causeRegister = sccp->copRegisters[13];
+	sccp->interruptPending = (statusRegister & 0x1) == 0x1 &&
+			(statusRegister & causeRegister & 0xFF00) != 0;
+}
@@ -9,9 +9,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "../headers/Cop2_all.h"
+#include "../headers/PerfCounters.h"
 #include "../headers/math_utils.h"
 
+// Helpers are always inlined, as the compiler otherwise stops inlining them
+// once the handlers have been merged into Cop2_gteFunction
+#define COP2_HELPER static inline __attribute__((always_inline))
+
 // Unsigned Newton-Raphson algorithm array - values taken from NOPSX 
 // documentation to mimic NOPSX results (but with my own code of course)
 static const int32_t unrResults[] = {
@@ -39,6 +51,9 @@ static const int32_t unrResults[] = {
 	0x01, 0x01, 0x00, 0x00, 0x00
 };
 
+// Zero translation vector, for calculations that don't add one
+static const int32_t noTranslation[3] = {0, 0, 0};
+
 // Forward declarations for functions private to this class
 static void Cop2_handleRTPS(Cop2 *gte, int32_t opcode);
 static void Cop2_handleNCLIP(Cop2 *gte, int32_t opcode);
@@ -62,6 +77,40 @@ static void Cop2_handleRTPT(Cop2 *gte, int32_t opcode);
 static void Cop2_handleGPF(Cop2 *gte, int32_t opcode);
 static void Cop2_handleGPL(Cop2 *gte, int32_t opcode);
 static void Cop2_handleNCCT(Cop2 *gte, int32_t opcode);
+COP2_HELPER void Cop2_checkMac(int32_t *flag, const int64_t *mac);
+COP2_HELPER void Cop2_checkMac0(int32_t *flag, int64_t mac0);
+COP2_HELPER void Cop2_finishFlags(Cop2 *gte, int32_t flag);
+COP2_HELPER void Cop2_interpolateColour(Cop2 *gte, int32_t *flag,
+		int64_t *mac, int16_t *ir, int32_t sf, int64_t lowerBound);
+COP2_HELPER void Cop2_lightVector(Cop2 *gte, int32_t *flag, int32_t sf,
+		int64_t lowerBound, int64_t *mac, int16_t *ir);
+COP2_HELPER void Cop2_lightVectors(Cop2 *gte, int32_t sf,
+		int64_t lowerBound, int64_t (*mac)[3], int32_t *flags);
+COP2_HELPER void Cop2_multiplyColour(Cop2 *gte, int32_t *flag,
+		const int16_t *ir, int64_t *mac);
+COP2_HELPER void Cop2_multiplyMatrix(const int16_t (*matrix)[3],
+		const int32_t *translation, const int16_t (*vectors)[3],
+		int64_t (*results)[3]);
+COP2_HELPER void Cop2_multiplyVector(const int16_t (*matrix)[3],
+		const int32_t *translation, const int16_t *vector, int64_t *result);
+COP2_HELPER int32_t Cop2_packColour(const uint8_t *colour);
+COP2_HELPER int32_t Cop2_packMatrix(const int16_t (*matrix)[3],
+		int32_t index);
+COP2_HELPER int32_t Cop2_packPair(const int16_t *pair);
+COP2_HELPER int64_t Cop2_saturate(int32_t *flag, int64_t value,
+		int64_t min, int64_t max, int32_t bits);
+COP2_HELPER void Cop2_saturateStage(int32_t *flag, int64_t *mac,
+		int32_t sf, int64_t lowerBound, int16_t *ir);
+COP2_HELPER void Cop2_storeColour(Cop2 *gte, int32_t *flag,
+		const int64_t *mac, const int16_t *ir);
+COP2_HELPER void Cop2_storeResults(Cop2 *gte, const int64_t *mac,
+		const int16_t *ir);
+COP2_HELPER void Cop2_transformPerspective(Cop2 *gte, int32_t *flag,
+		const int64_t *sums, int32_t sf);
+COP2_HELPER void Cop2_unpackColour(uint8_t *colour, int32_t value);
+COP2_HELPER void Cop2_unpackMatrix(int16_t (*matrix)[3], int32_t index,
+		int32_t value);
+COP2_HELPER void Cop2_unpackPair(int16_t *pair, int32_t value);
 
 /*
  * This constructs a Cop2 object using the pre-allocated struct referenced by
@@ -69,9 +118,8 @@ static void Cop2_handleNCCT(Cop2 *gte, int32_t opcode);
  */
 void construct_Cop2(Cop2 *gte)
 {
-	// Zero out register arrays
-	memset(gte->controlRegisters, 0, sizeof(gte->controlRegisters));
-	memset(gte->dataRegisters, 0, sizeof(gte->dataRegisters));
+	// Zero out registers
+	memset(gte, 0, sizeof(Cop2));
 
 	// Reset
 	Cop2_reset(gte);
@@ -102,7 +150,10 @@ int32_t Cop2_gteFunction(Cop2 *gte, int32_t opcode)
 {
 	// Cycles to return
 	int32_t cycles = 0;
-	
+
+	// Count function
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GTE_OPS + (opcode & 0x3F), 1);
+
 	// Determine which function to handle
 	switch (opcode & 0x3F) {
 		case 0x01:
@@ -196,12 +247,13 @@ int32_t Cop2_gteFunction(Cop2 *gte, int32_t opcode)
 		default:
 			break;
 	}
-	
+
 	return cycles;
 }
 
 /*
- * This function reads from the specified control register.
+ * This function reads from the specified control register, packing its
+ * fields into a word. 16-bit values are sign extended.
  */
 int32_t Cop2_readControlReg(Cop2 *gte, int32_t reg)
 {
@@ -210,18 +262,67 @@ int32_t Cop2_readControlReg(Cop2 *gte, int32_t reg)
 
 	// Set return value to specified register
 	switch (reg) {
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+		case 4:
+			retVal = Cop2_packMatrix(gte->rotation, reg);
+			break;
+		case 5:
+		case 6:
+		case 7:
+			retVal = gte->translation[reg - 5];
+			break;
+		case 8:
+		case 9:
+		case 10:
+		case 11:
+		case 12:
+			retVal = Cop2_packMatrix(gte->light, reg - 8);
+			break;
+		case 13:
+		case 14:
+		case 15:
+			retVal = gte->background[reg - 13];
+			break;
+		case 16:
+		case 17:
+		case 18:
+		case 19:
+		case 20:
+			retVal = Cop2_packMatrix(gte->colour, reg - 16);
+			break;
+		case 21:
+		case 22:
+		case 23:
+			retVal = gte->farColour[reg - 21];
+			break;
+		case 24:
+			retVal = gte->ofx;
+			break;
+		case 25:
+			retVal = gte->ofy;
+			break;
 		case 26:
 			// Actually unsigned, but we do sign extension
 			// as this is a hardware bug
+			retVal = (int16_t)gte->h;
+			break;
 		case 27:
+			retVal = gte->dqa;
+			break;
+		case 28:
+			retVal = gte->dqb;
+			break;
 		case 29:
+			retVal = gte->zsf3;
+			break;
 		case 30:
-			retVal = gte->controlRegisters[reg];
-			if ((retVal & 0x8000) == 0x8000)
-				retVal |= 0xFFFF0000;
+			retVal = gte->zsf4;
 			break;
-		default:
-			retVal = gte->controlRegisters[reg];
+		case 31:
+			retVal = gte->flag;
 			break;
 	}
 
@@ -229,7 +330,9 @@ int32_t Cop2_readControlReg(Cop2 *gte, int32_t reg)
 }
 
 /*
- * This function reads from the specified data register.
+ * This function reads from the specified data register, packing its fields
+ * into a word. Signed 16-bit values are sign extended, and unsigned ones zero
+ * extended.
  */
 int32_t Cop2_readDataReg(Cop2 *gte, int32_t reg)
 {
@@ -238,30 +341,69 @@ int32_t Cop2_readDataReg(Cop2 *gte, int32_t reg)
 
 	// Set return value to specified register
 	switch (reg) {
+		case 0:
+		case 2:
+		case 4:
+			retVal = Cop2_packPair(gte->vectors[reg / 2]); // VXYn
+			break;
 		case 1:
 		case 3:
 		case 5:
+			retVal = gte->vectors[reg / 2][2]; // VZn
+			break;
+		case 6:
+			retVal = Cop2_packColour(gte->rgbc);
+			break;
+		case 7:
+			retVal = gte->otz;
+			break;
 		case 8:
 		case 9:
 		case 10:
 		case 11:
-			// Read and sign extend if necessary
-			retVal = gte->dataRegisters[reg];
-			if ((retVal & 0x8000) == 0x8000)
-				retVal |= 0xFFFF0000;
+			retVal = gte->ir[reg - 8];
+			break;
+		case 12:
+		case 13:
+		case 14:
+			retVal = Cop2_packPair(gte->sxy[reg - 12]);
+			break;
+		case 15:
+			// SXYP - mirror of SXY2
+			retVal = Cop2_packPair(gte->sxy[2]);
+			break;
+		case 16:
+		case 17:
+		case 18:
+		case 19:
+			retVal = gte->sz[reg - 16];
+			break;
+		case 20:
+		case 21:
+		case 22:
+			retVal = Cop2_packColour(gte->rgb[reg - 20]);
 			break;
 		case 23:
 		case 28:
 			break;
-		case 29:
-			retVal = ((gte->dataRegisters[11] << 3) & 0x7C00) |
-					(logical_rshift(gte->dataRegisters[10], 2) & 0x3E0) |
-					(logical_rshift(gte->dataRegisters[9], 7) & 0x1F);
+		case 24:
+		case 25:
+		case 26:
+		case 27:
+			retVal = gte->mac[reg - 24];
+			break;
+		case 29: // ORGB
+			retVal = ((gte->ir[3] & 0xF80) << 3) |
+					((gte->ir[2] & 0xF80) >> 2) |
+					((gte->ir[1] & 0xF80) >> 7);
+			break;
+		case 30:
+			retVal = gte->lzcs;
 			break;
 		case 31: // LZCR
 		{
 			// Determine whether we are counting leading 1s or 0s
-			int32_t bit, lzcs = gte->dataRegisters[30];
+			int32_t bit, lzcs = gte->lzcs;
 			if (lzcs < 0)
 				bit = 0x80000000;
 			else
@@ -277,83 +419,166 @@ int32_t Cop2_readDataReg(Cop2 *gte, int32_t reg)
 			}
 		}
 			break;
-		default:
-			retVal = gte->dataRegisters[reg];
-			break;
 	}
 
 	return retVal;
 }
 
 /*
- * This function writes to the specified control register.
+ * This function writes to the specified control register, unpacking the word
+ * into its fields. As none of them have side effects, override makes no
+ * difference here.
  */
 void Cop2_writeControlReg(Cop2 *gte, int32_t reg, int32_t value, bool override)
 {
-	if (override) {
-		gte->controlRegisters[reg] = value;
-	} else {
-
-		// Determine course of action
-		switch (reg) {
-			default:
-				gte->controlRegisters[reg] = value;
-				break;
-		}
+	// Determine course of action
+	switch (reg) {
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+		case 4:
+			Cop2_unpackMatrix(gte->rotation, reg, value);
+			break;
+		case 5:
+		case 6:
+		case 7:
+			gte->translation[reg - 5] = value;
+			break;
+		case 8:
+		case 9:
+		case 10:
+		case 11:
+		case 12:
+			Cop2_unpackMatrix(gte->light, reg - 8, value);
+			break;
+		case 13:
+		case 14:
+		case 15:
+			gte->background[reg - 13] = value;
+			break;
+		case 16:
+		case 17:
+		case 18:
+		case 19:
+		case 20:
+			Cop2_unpackMatrix(gte->colour, reg - 16, value);
+			break;
+		case 21:
+		case 22:
+		case 23:
+			gte->farColour[reg - 21] = value;
+			break;
+		case 24:
+			gte->ofx = value;
+			break;
+		case 25:
+			gte->ofy = value;
+			break;
+		case 26:
+			gte->h = (uint16_t)value;
+			break;
+		case 27:
+			gte->dqa = (int16_t)value;
+			break;
+		case 28:
+			gte->dqb = value;
+			break;
+		case 29:
+			gte->zsf3 = (int16_t)value;
+			break;
+		case 30:
+			gte->zsf4 = (int16_t)value;
+			break;
+		case 31:
+			gte->flag = value;
+			break;
 	}
 }
 
 /*
- * This function writes to the specified data register.
+ * This function writes to the specified data register, unpacking the word
+ * into its fields. If override is set, side effects of the write are skipped
+ * - registers with no storage of their own are still left alone.
  */
 void Cop2_writeDataReg(Cop2 *gte, int32_t reg, int32_t value, bool override)
 {
-	if (override) {
-		gte->dataRegisters[reg] = value;
-	} else {
-
-		// Determine course of action
+	// Deal with registers that don't simply store the value written
+	if (!override) {
 		switch (reg) {
 			case 7:
-			case 23:
 			case 29:
 			case 31:
-				break;
-			case 14:
-				// SXY2 - mirror of SXYP
-
-				// Set SXY2 and SXYP
-				gte->dataRegisters[14] = value; // SXY2
-				gte->dataRegisters[15] = value; // SXYP
-
-				break;
+				return;
 			case 15:
 				// SXYP - mirror of SXY2 but causes SXY1 to move to SXY0,
 				// and SXY2 to move to SXY1
-
-				// Move SXY1 to SXY0
-				gte->dataRegisters[12] = gte->dataRegisters[13];
-
-				// Move SXY2 to SXY1
-				gte->dataRegisters[13] = gte->dataRegisters[14];
-
-				// Set SXY2 and SXYP
-				gte->dataRegisters[14] = value; // SXY2
-				gte->dataRegisters[15] = value; // SXYP
-
+				memcpy(gte->sxy[0], gte->sxy[1], sizeof(gte->sxy[0]));
+				memcpy(gte->sxy[1], gte->sxy[2], sizeof(gte->sxy[1]));
 				break;
 			case 28:
 				// IRGB
-				gte->dataRegisters[9] = (0x1F & value) << 7; // IR1
-				gte->dataRegisters[10] = (0x3E0 & value) << 2; // IR2
-				gte->dataRegisters[11] =
-						logical_rshift((0x7C00 & value), 3); // IR3
-				break;
-			default:
-				gte->dataRegisters[reg] = value;
-				break;
+				gte->ir[1] = (0x1F & value) << 7; // IR1
+				gte->ir[2] = (0x3E0 & value) << 2; // IR2
+				gte->ir[3] = logical_rshift((0x7C00 & value), 3); // IR3
+				return;
 		}
 	}
+
+	// Determine course of action
+	switch (reg) {
+		case 0:
+		case 2:
+		case 4:
+			Cop2_unpackPair(gte->vectors[reg / 2], value); // VXYn
+			break;
+		case 1:
+		case 3:
+		case 5:
+			gte->vectors[reg / 2][2] = (int16_t)value; // VZn
+			break;
+		case 6:
+			Cop2_unpackColour(gte->rgbc, value);
+			break;
+		case 7:
+			gte->otz = (uint16_t)value;
+			break;
+		case 8:
+		case 9:
+		case 10:
+		case 11:
+			gte->ir[reg - 8] = (int16_t)value;
+			break;
+		case 12:
+		case 13:
+		case 14:
+			Cop2_unpackPair(gte->sxy[reg - 12], value);
+			break;
+		case 15:
+			// SXYP - writes go to SXY2
+			Cop2_unpackPair(gte->sxy[2], value);
+			break;
+		case 16:
+		case 17:
+		case 18:
+		case 19:
+			gte->sz[reg - 16] = (uint16_t)value;
+			break;
+		case 20:
+		case 21:
+		case 22:
+			Cop2_unpackColour(gte->rgb[reg - 20], value);
+			break;
+		case 24:
+		case 25:
+		case 26:
+		case 27:
+			gte->mac[reg - 24] = value;
+			break;
+		case 30:
+			gte->lzcs = value;
+			break;
+	}
 }
 
 /*
@@ -362,313 +587,20 @@ void Cop2_writeDataReg(Cop2 *gte, int32_t reg, int32_t value, bool override)
 static void Cop2_handleRTPS(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Retrieve rotation matrix values
-	int64_t rt11 =
-			0xFFFF & gte->controlRegisters[0]; // RT11
-	int64_t rt12 =
-			0xFFFF & logical_rshift(gte->controlRegisters[0], 16); // RT12
-	int64_t rt13 =
-			0xFFFF & gte->controlRegisters[1]; // RT13
-	int64_t rt21 =
-			0xFFFF & logical_rshift(gte->controlRegisters[1], 16); // RT21
-	int64_t rt22 =
-			0xFFFF & gte->controlRegisters[2]; // RT22
-	int64_t rt23 =
-			0xFFFF & logical_rshift(gte->controlRegisters[2], 16); // RT23
-	int64_t rt31 =
-			0xFFFF & gte->controlRegisters[3]; // RT31
-	int64_t rt32 =
-			0xFFFF & logical_rshift(gte->controlRegisters[3], 16); // RT32
-	int64_t rt33 =
-			0xFFFF & gte->controlRegisters[4]; // RT33
-
-	// Sign extend rotation matrix values if necessary
-	if ((rt11 & 0x8000L) == 0x8000L)
-		rt11 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt12 & 0x8000L) == 0x8000L)
-		rt12 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt13 & 0x8000L) == 0x8000L)
-		rt13 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt21 & 0x8000L) == 0x8000L)
-		rt21 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt22 & 0x8000L) == 0x8000L)
-		rt22 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt23 & 0x8000L) == 0x8000L)
-		rt23 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt31 & 0x8000L) == 0x8000L)
-		rt31 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt32 & 0x8000L) == 0x8000L)
-		rt32 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt33 & 0x8000L) == 0x8000L)
-		rt33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve vector 0 values
-	int64_t vx0 = 0xFFFF & gte->dataRegisters[0]; // VX0
-	int64_t vy0 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-	int64_t vz0 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-
-	// Sign extend vector 0 values if necessary
-	if ((vx0 & 0x8000L) == 0x8000L)
-		vx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vy0 & 0x8000L) == 0x8000L)
-		vy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vz0 & 0x8000L) == 0x8000L)
-		vz0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve translation vector values
-	int64_t trX = 0xFFFFFFFFL & gte->controlRegisters[5]; // TRX
-	int64_t trY = 0xFFFFFFFFL & gte->controlRegisters[6]; // TRY
-	int64_t trZ = 0xFFFFFFFFL & gte->controlRegisters[7]; // TRZ
-
-	// Sign extend translation vector values if necessary
-	if ((trX & 0x80000000L) == 0x80000000L)
-		trX |= 0xFFFFFFFF00000000L;
-	if ((trY & 0x80000000L) == 0x80000000L)
-		trY |= 0xFFFFFFFF00000000L;
-	if ((trZ & 0x80000000L) == 0x80000000L)
-		trZ |= 0xFFFFFFFF00000000L;
-
-	// Retrieve offset and distance values
-	int64_t ofx = 0xFFFFFFFFL & gte->controlRegisters[24];
-	int64_t ofy = 0xFFFFFFFFL & gte->controlRegisters[25];
-	int64_t h = 0xFFFF & gte->controlRegisters[26];
-	int64_t dqa = 0xFFFF & gte->controlRegisters[27];
-	int64_t dqb = 0xFFFFFFFFL & gte->controlRegisters[28];
-
-	// Sign extend signed values if needed
-	if ((ofx & 0x80000000L) == 0x80000000L)
-		ofx |= 0xFFFFFFFF00000000L;
-	if ((ofy & 0x80000000L) == 0x80000000L)
-		ofy |= 0xFFFFFFFF00000000L;
-	if ((dqa & 0x8000L) == 0x8000L)
-		dqa |= 0xFFFFFFFFFFFF0000L;
-	if ((dqb & 0x80000000L) == 0x80000000L)
-		dqb |= 0xFFFFFFFF00000000L;
-
-	// Perform first stage of calculations
-	int64_t mac1 = trX * 0x1000 + rt11 * vx0 + rt12 * vy0 + rt13 * vz0;
-	int64_t mac2 = trY * 0x1000 + rt21 * vx0 + rt22 * vy0 + rt23 * vz0;
-	int64_t mac3 = trZ * 0x1000 + rt31 * vx0 + rt32 * vy0 + rt33 * vz0;
-
-	// Shift all three results by (sf * 12), preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Set MAC1, MAC2 and MAC3 flags as needed
-
-	// MAC1
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	// MAC2
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	// MAC3
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Set IR1, IR2 and IR3 - dealing with flags too,
-	// saturation should be -0x8000..0x7FFF, regardless of lm bit
-
-	// IR1
-	int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-	if (mac1 < -0x8000) {
-		ir1 = -0x8000;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 > 0x7FFF) {
-		ir1 = 0x7FFF;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = (int32_t)mac1;
-	}
-
-	// IR2
-	if (mac2 < -0x8000) {
-		ir2 = -0x8000;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 > 0x7FFF) {
-		ir2 = 0x7FFF;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = (int32_t)mac2;
-	}
-
-	// IR3
-	if (mac3 < -0x8000) {
-		ir3 = -0x8000;
-
-		// Deal with quirk in IR3 flag handling
-		if (sf == 0) {
-			uint64_t u_mac3 = (uint64_t)mac3;
-			bool needsSignExtension = (u_mac3 & 0x8000000000000000UL) ==
-										0x8000000000000000UL;
-			int64_t temp = u_mac3 >> 12;
-			if (needsSignExtension)
-				temp |= 0xFFF0000000000000UL;
-			if (temp > 0x7FFF || temp < -0x8000)
-				gte->controlRegisters[31] |= 0x400000;
-		} else {
-			gte->controlRegisters[31] |= 0x400000;
-		}
-	} else if (mac3 > 0x7FFF) {
-		ir3 = 0x7FFF;
-
-		// Deal with quirk in IR3 flag handling
-		if (sf == 0) {
-			int64_t temp = mac3 >> 12;
-			if (temp > 0x7FFF || temp < -0x8000)
-				gte->controlRegisters[31] |= 0x400000;
-		} else {
-			gte->controlRegisters[31] |= 0x400000;
-		}
-	} else {
-		ir3 = (int32_t)mac3;
-	}
-
-	// Write back to real registers
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	// Calculate SZ3 and move FIFO along, also setting SZ3 flag if needed
-	gte->dataRegisters[16] = gte->dataRegisters[17]; // SZ1 to SZ0
-	gte->dataRegisters[17] = gte->dataRegisters[18]; // SZ2 to SZ1
-	gte->dataRegisters[18] = gte->dataRegisters[19]; // SZ3 to SZ2
-	uint64_t u_mac3 = (uint64_t)mac3;
-	bool needsSignExtension = (u_mac3 & 0x8000000000000000UL) ==
-								0x8000000000000000UL;
-	int32_t shiftBy = (1 - sf) * 12;
-	int64_t temp_sz3 = u_mac3 >> shiftBy;
-	if (needsSignExtension && shiftBy == 12)
-		temp_sz3 |= 0xFFF0000000000000UL;
-	if (temp_sz3 < 0) {
-		temp_sz3 = 0;
-		gte->controlRegisters[31] |= 0x40000;
-	} else if (temp_sz3 > 0xFFFF) {
-		temp_sz3 = 0xFFFF;
-		gte->controlRegisters[31] |= 0x40000;
-	}
-	gte->dataRegisters[19] = (int32_t)temp_sz3;
-
-	// Begin second phase of calculations - use Unsigned Newton-Raphson
-	// division algorithm from NOPSX documentation
-	int64_t mac0 = 0, sx2 = 0, sy2 = 0, ir0 = 0;
-	int64_t divisionResult = 0;
-	if (h < temp_sz3 * 2) {
-
-		// Count leading zeroes in SZ3
-		int64_t z = 0, temp_sz3_2 = temp_sz3;
-		for (int32_t i = 0; i < 16; ++i) {
-			if ((temp_sz3_2 & 0x8000) == 0) {
-				++z;
-				temp_sz3_2 = temp_sz3_2 << 1;
-			} else {
-				break;
-			}
-		}
-
-		divisionResult = h << z;
-		int64_t d = temp_sz3 << z;
-		int64_t u =
-				unrResults[logical_rshift(((int32_t)d - 0x7FC0), 7)] + 0x101;
-		d = logical_rshift((0x2000080 - (d * u)), 8);
-		d = logical_rshift((0x80 + (d * u)), 8);
-		divisionResult = min_value(0x1FFFFL,
-				logical_rshift(((divisionResult * d) + 0x8000L), 16));
-
-	} else {
-		divisionResult = 0x1FFFFL;
-		gte->controlRegisters[31] |= 0x20000;
-	}
-
-	// Use division result and set MAC0 flag if needed
-	mac0 = divisionResult * ir1 + ofx;
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-	mac0 &= 0xFFFFFFFFL;
-	if ((mac0 & 0x80000000L) == 0x80000000L)
-		mac0 |= 0xFFFFFFFF00000000L;
-	sx2 = mac0 / 0x10000;
-	mac0 = divisionResult * ir2 + ofy;
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-	mac0 &= 0xFFFFFFFFL;
-	if ((mac0 & 0x80000000L) == 0x80000000L)
-		mac0 |= 0xFFFFFFFF00000000L;
-	sy2 = mac0 / 0x10000;
-	mac0 = divisionResult * dqa + dqb;
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-	mac0 &= 0xFFFFFFFFL;
-	if ((mac0 & 0x80000000L) == 0x80000000L)
-		mac0 |= 0xFFFFFFFF00000000L;
-	ir0 = mac0 / 0x1000;
-
-	// Adjust results for saturation and set flags if needed
-	if (sx2 > 0x3FFL) {
-		sx2 = 0x3FFL;
-		gte->controlRegisters[31] |= 0x4000;
-	} else if (sx2 < -0x400) {
-		sx2 = -0x400;
-		gte->controlRegisters[31] |= 0x4000;
-	}
-
-	if (sy2 > 0x3FFL) {
-		sy2 = 0x3FFL;
-		gte->controlRegisters[31] |= 0x2000;
-	} else if (sy2 < -0x400) {
-		sy2 = -0x400;
-		gte->controlRegisters[31] |= 0x2000;
-	}
-
-	if (ir0 < 0) {
-		ir0 = 0;
-		gte->controlRegisters[31] |= 0x1000;
-	} else if (ir0 > 0x1000) {
-		ir0 = 0x1000;
-		gte->controlRegisters[31] |= 0x1000;
-	}
-
-	// Store values back to correct registers
-
-	// SXY FIFO registers
-	gte->dataRegisters[12] = gte->dataRegisters[13]; // SXY1 to SXY0
-	gte->dataRegisters[13] = gte->dataRegisters[14]; // SXY2 to SXY1
-	gte->dataRegisters[14] =
-			(((int32_t)sy2 & 0xFFFF) << 16) | ((int32_t)sx2 & 0xFFFF); // SXY2
-	gte->dataRegisters[15] = gte->dataRegisters[14]; // SXYP mirror of SXY2
-
-	// MAC0
-	gte->dataRegisters[24] = (int32_t)mac0;
-
-	// IR0
-	gte->dataRegisters[8] = (int32_t)ir0;
+	// Perform first stage of calculations, then the perspective
+	// transformation
+	int64_t sums[3];
+	Cop2_multiplyVector(gte->rotation, gte->translation, gte->vectors[0],
+			sums);
+	Cop2_transformPerspective(gte, &flag, sums, sf);
 
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -677,46 +609,26 @@ static void Cop2_handleRTPS(Cop2 *gte, int32_t opcode)
 static void Cop2_handleNCLIP(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Retrieve SXY values
-	int64_t sx0 = 0xFFFF & gte->dataRegisters[12]; // SX0
-	int64_t sy0 = 0xFFFF & logical_rshift(gte->dataRegisters[12], 16); // SY0
-	int64_t sx1 = 0xFFFF & gte->dataRegisters[13]; // SX1
-	int64_t sy1 = 0xFFFF & logical_rshift(gte->dataRegisters[13], 16); // SY1
-	int64_t sx2 = 0xFFFF & gte->dataRegisters[14]; // SX2
-	int64_t sy2 = 0xFFFF & logical_rshift(gte->dataRegisters[14], 16); // SY2
-
-	// Sign extend if necessary
-	if ((sx0 & 0x8000L) == 0x8000L)
-		sx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((sy0 & 0x8000L) == 0x8000L)
-		sy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((sx1 & 0x8000L) == 0x8000L)
-		sx1 |= 0xFFFFFFFFFFFF0000L;
-	if ((sy1 & 0x8000L) == 0x8000L)
-		sy1 |= 0xFFFFFFFFFFFF0000L;
-	if ((sx2 & 0x8000L) == 0x8000L)
-		sx2 |= 0xFFFFFFFFFFFF0000L;
-	if ((sy2 & 0x8000L) == 0x8000L)
-		sy2 |= 0xFFFFFFFFFFFF0000L;
+	int64_t sx0 = gte->sxy[0][0];
+	int64_t sy0 = gte->sxy[0][1];
+	int64_t sx1 = gte->sxy[1][0];
+	int64_t sy1 = gte->sxy[1][1];
+	int64_t sx2 = gte->sxy[2][0];
+	int64_t sy2 = gte->sxy[2][1];
 
 	// Perform calculation
 	int64_t mac0 = sx0 * sy1 + sx1 * sy2 + sx2 * sy0 -
 			sx0 * sy2 - sx1 * sy0 - sx2 * sy1;
 
 	// Check and set flags if needed
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-
-	// Calculate flag bit 31
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	Cop2_checkMac0(&flag, mac0);
+	Cop2_finishFlags(gte, flag);
 
 	// Store MAC0 result back to register
-	gte->dataRegisters[24] = (int32_t)mac0;
+	gte->mac[0] = (int32_t)mac0;
 }
 
 /*
@@ -725,152 +637,34 @@ static void Cop2_handleNCLIP(Cop2 *gte, int32_t opcode)
 static void Cop2_handleOP(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Fetch IR values
-	int64_t ir1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-	int64_t ir2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-	int64_t ir3 = 0xFFFF & gte->dataRegisters[11]; // IR3
-
-	// Fetch RT11, RT22, RT33 values
-	int64_t d1 = 0xFFFF & gte->controlRegisters[0]; // RT11
-	int64_t d2 = 0xFFFF & gte->controlRegisters[2]; // RT22
-	int64_t d3 = 0xFFFF & gte->controlRegisters[4]; // RT33
-
-	// Sign extend both sets of values
-	if ((ir1 & 0x8000L) == 0x8000L)
-		ir1 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir2 & 0x8000L) == 0x8000L)
-		ir2 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir3 & 0x8000L) == 0x8000L)
-		ir3 |= 0xFFFFFFFFFFFF0000L;
-	if ((d1 & 0x8000L) == 0x8000L)
-		d1 |= 0xFFFFFFFFFFFF0000L;
-	if ((d2 & 0x8000L) == 0x8000L)
-		d2 |= 0xFFFFFFFFFFFF0000L;
-	if ((d3 & 0x8000L) == 0x8000L)
-		d3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Perform calculation
-	int64_t temp1 = ir3 * d2 - ir2 * d3;
-	int64_t temp2 = ir1 * d3 - ir3 * d1;
-	int64_t temp3 = ir2 * d1 - ir1 * d2;
-
-	// Shift result by (sf * 12) bits, preserving sign bit
-	temp1 = temp1 >> (sf * 12);
-	temp2 = temp2 >> (sf * 12);
-	temp3 = temp3 >> (sf * 12);
-
-	// Store results in MAC1, MAC2 and MAC3 registers
-	gte->dataRegisters[25] = (int32_t)temp1; // MAC1
-	gte->dataRegisters[26] = (int32_t)temp2; // MAC2
-	gte->dataRegisters[27] = (int32_t)temp3; // MAC3
-
-	// Set relevant MAC1, MAC2 and MAC3 flag bits
-
-	// MAC1
-	if (temp1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (temp1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	// MAC2
-	if (temp2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (temp2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	// MAC3
-	if (temp3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (temp3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Set IR1, IR2 and IR3 registers and saturation flag bits
-	switch (lm) {
-		case 0: // Saturate to -0x8000..0x7FFF
-		{
-			// IR1
-			if (temp1 < -0x8000) {
-				gte->dataRegisters[9] = -0x8000;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else if (temp1 > 0x7FFF) {
-				gte->dataRegisters[9] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else {
-				gte->dataRegisters[9] = (int32_t)temp1;
-			}
-
-			// IR2
-			if (temp2 < -0x8000) {
-				gte->dataRegisters[10] = -0x8000;
-				gte->controlRegisters[31] |= 0x800000;
-			} else if (temp2 > 0x7FFF) {
-				gte->dataRegisters[10] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x800000;
-			} else {
-				gte->dataRegisters[10] = (int32_t)temp2;
-			}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-			// IR3
-			if (temp3 < -0x8000) {
-				gte->dataRegisters[11] = -0x8000;
-				gte->controlRegisters[31] |= 0x400000;
-			} else if (temp3 > 0x7FFF) {
-				gte->dataRegisters[11] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x400000;
-			} else {
-				gte->dataRegisters[11] = (int32_t)temp3;
-			}
-		}
-			break;
-		case 1: // Saturate to 0..0x7FFF
-		{
-			// IR1
-			if (temp1 < 0) {
-				gte->dataRegisters[9] = 0;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else if (temp1 > 0x7FFF) {
-				gte->dataRegisters[9] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else {
-				gte->dataRegisters[9] = (int32_t)temp1;
-			}
+	// Fetch IR values and RT11, RT22, RT33 values
+	int64_t ir1 = gte->ir[1], ir2 = gte->ir[2], ir3 = gte->ir[3];
+	int64_t d1 = gte->rotation[0][0];
+	int64_t d2 = gte->rotation[1][1];
+	int64_t d3 = gte->rotation[2][2];
 
-			// IR2
-			if (temp2 < 0) {
-				gte->dataRegisters[10] = 0;
-				gte->controlRegisters[31] |= 0x800000;
-			} else if (temp2 > 0x7FFF) {
-				gte->dataRegisters[10] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x800000;
-			} else {
-				gte->dataRegisters[10] = (int32_t)temp2;
-			}
+	// Perform calculation
+	int64_t mac[3] = {
+		ir3 * d2 - ir2 * d3,
+		ir1 * d3 - ir3 * d1,
+		ir2 * d1 - ir1 * d2
+	};
 
-			// IR3
-			if (temp3 < 0) {
-				gte->dataRegisters[11] = 0;
-				gte->controlRegisters[31] |= 0x400000;
-			} else if (temp3 > 0x7FFF) {
-				gte->dataRegisters[11] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x400000;
-			} else {
-				gte->dataRegisters[11] = (int32_t)temp3;
-			}
-		}
-			break;
-	}
+	// Shift and saturate results, then store them
+	int16_t ir[3];
+	Cop2_saturateStage(&flag, mac, sf, lowerBound, ir);
+	Cop2_storeResults(gte, mac, ir);
 
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -879,212 +673,27 @@ static void Cop2_handleOP(Cop2 *gte, int32_t opcode)
 static void Cop2_handleDPCS(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve IR0 value and define IR1, IR2 and IR3
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-	int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-
-	// Sign extend IR0 value
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21];
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22];
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23];
-
-	// Sign extend far colour values
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
 	// Perform DPCS-only calculation
-	int64_t mac1 = r << 16;
-	int64_t mac2 = g << 16;
-	int64_t mac3 = b << 16;
-
-	// Check for and set MAC1, MAC2 and MAC3 flags if needed
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Perform first common stage of calculation
-	ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-	ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-	ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-	// Saturate IR1, IR2 and IR3 results, setting flags as needed
-	if (ir1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (ir1 < -0x8000L) {
-		ir1 = -0x8000L;
-		gte->controlRegisters[31] |= 0x1000000;
-	}
-
-	if (ir2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (ir2 < -0x8000L) {
-		ir2 = -0x8000L;
-		gte->controlRegisters[31] |= 0x800000;
-	}
-
-	if (ir3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (ir3 < -0x8000L) {
-		ir3 = -0x8000L;
-		gte->controlRegisters[31] |= 0x400000;
-	}
-
-	// Continue first common stage of calculation
-	mac1 = ir1 * ir0 + mac1;
-	mac2 = ir2 * ir0 + mac2;
-	mac3 = ir3 * ir0 + mac3;
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Shift MAC1, MAC2 and MAC3 by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store MAC1, MAC2 and MAC3 to IR1, IR2 and IR3
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Generate colour FIFO values and check/set flags as needed
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
+	int64_t mac[3];
+	for (int32_t i = 0; i < 3; ++i)
+		mac[i] = (int64_t)gte->rgbc[i] << 16;
+	Cop2_checkMac(&flag, mac);
 
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
-
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
+	// Interpolate towards far colour and store results
+	int16_t ir[3];
+	Cop2_interpolateColour(gte, &flag, mac, ir, sf, lowerBound);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store values back to registers
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -1093,217 +702,27 @@ static void Cop2_handleDPCS(Cop2 *gte, int32_t opcode)
 static void Cop2_handleINTPL(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve IR0, IR1, IR2 and IR3 values
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-	int64_t ir1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-	int64_t ir2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-	int64_t ir3 = 0xFFFF & gte->dataRegisters[11]; // IR3
-
-	// Sign extend IR0, IR1, IR2 and IR3 values
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir1 & 0x8000L) == 0x8000L)
-		ir1 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir2 & 0x8000L) == 0x8000L)
-		ir2 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir3 & 0x8000L) == 0x8000L)
-		ir3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21];
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22];
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23];
-
-	// Sign extend far colour values
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Retrieve code value from RGBC
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
 	// Perform INTPL-only calculation
-	int64_t mac1 = ir1 << 12;
-	int64_t mac2 = ir2 << 12;
-	int64_t mac3 = ir3 << 12;
-
-	// Check for and set MAC1, MAC2 and MAC3 flags if needed
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Perform first common stage of calculation
-	ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-	ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-	ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-	// Saturate IR1, IR2 and IR3 results, setting flags as needed
-	if (ir1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (ir1 < -0x8000L) {
-		ir1 = -0x8000L;
-		gte->controlRegisters[31] |= 0x1000000;
-	}
-
-	if (ir2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (ir2 < -0x8000L) {
-		ir2 = -0x8000L;
-		gte->controlRegisters[31] |= 0x800000;
-	}
-
-	if (ir3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (ir3 < -0x8000L) {
-		ir3 = -0x8000L;
-		gte->controlRegisters[31] |= 0x400000;
-	}
-
-	// Continue first common stage of calculation
-	mac1 = ir1 * ir0 + mac1;
-	mac2 = ir2 * ir0 + mac2;
-	mac3 = ir3 * ir0 + mac3;
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Shift MAC1, MAC2 and MAC3 by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store MAC1, MAC2 and MAC3 to IR1, IR2 and IR3
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Generate colour FIFO values and check/set flags as needed
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
+	int64_t mac[3];
+	for (int32_t i = 0; i < 3; ++i)
+		mac[i] = (int64_t)gte->ir[i + 1] * 0x1000;
+	Cop2_checkMac(&flag, mac);
 
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
+	// Interpolate towards far colour and store results
+	int16_t ir[3];
+	Cop2_interpolateColour(gte, &flag, mac, ir, sf, lowerBound);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store values back to registers
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -1312,13 +731,13 @@ static void Cop2_handleINTPL(Cop2 *gte, int32_t opcode)
 static void Cop2_handleMVMVA(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
 	// Filter out translation vector value
 	int32_t tVec = logical_rshift((opcode & 0x6000), 13);
@@ -1329,287 +748,77 @@ static void Cop2_handleMVMVA(Cop2 *gte, int32_t opcode)
 	// Filter out multiply matrix value
 	int32_t mMatrix = logical_rshift((opcode & 0x60000), 17);
 
-	// Declare and store correct translation vector values
-	int64_t tv1 = 0, tv2 = 0, tv3 = 0;
+	// Retrieve correct translation vector
+	int32_t translation[3] = {0, 0, 0};
 	switch (tVec) {
 		case 0: // TR
-			tv1 = 0xFFFFFFFFL & gte->controlRegisters[5]; // TRX
-			tv2 = 0xFFFFFFFFL & gte->controlRegisters[6]; // TRY
-			tv3 = 0xFFFFFFFFL & gte->controlRegisters[7]; // TRZ
+			memcpy(translation, gte->translation, sizeof(translation));
 			break;
 		case 1: // BK
-			tv1 = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-			tv2 = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-			tv3 = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
+			memcpy(translation, gte->background, sizeof(translation));
 			break;
 		case 2: // FC
-			tv1 = 0xFFFFFFFFL & gte->controlRegisters[21]; // RFC
-			tv2 = 0xFFFFFFFFL & gte->controlRegisters[22]; // GFC
-			tv3 = 0xFFFFFFFFL & gte->controlRegisters[23]; // BFC
+			memcpy(translation, gte->farColour, sizeof(translation));
 			break;
 		case 3: // None (do nothing as 0 already set)
 			break;
 	}
 
-	// Sign extend translation vector values
-	if ((tv1 & 0x80000000L) == 0x80000000L)
-		tv1 |= 0xFFFFFFFF00000000L;
-	if ((tv2 & 0x80000000L) == 0x80000000L)
-		tv2 |= 0xFFFFFFFF00000000L;
-	if ((tv3 & 0x80000000L) == 0x80000000L)
-		tv3 |= 0xFFFFFFFF00000000L;
-
-	// Declare and store correct multiply vector values
-	int64_t mv1 = 0, mv2 = 0, mv3 = 0;
+	// Retrieve correct multiply vector
+	int16_t vector[3];
 	switch (mVec) {
 		case 0: // V0
-			mv1 = 0xFFFF & gte->dataRegisters[0]; // VX0
-			mv2 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-			mv3 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-			break;
 		case 1: // V1
-			mv1 = 0xFFFF & gte->dataRegisters[2]; // VX1
-			mv2 = 0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-			mv3 = 0xFFFF & gte->dataRegisters[3]; // VZ1
-			break;
 		case 2: // V2
-			mv1 = 0xFFFF & gte->dataRegisters[4]; // VX2
-			mv2 = 0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-			mv3 = 0xFFFF & gte->dataRegisters[5]; // VZ2
+			memcpy(vector, gte->vectors[mVec], sizeof(vector));
 			break;
 		case 3: // [IR1,IR2,IR3]
-			mv1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-			mv2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-			mv3 = 0xFFFF & gte->dataRegisters[11]; // IR3
+			memcpy(vector, gte->ir + 1, sizeof(vector));
 			break;
 	}
 
-	// Sign extend multiply vector values
-	if ((mv1 & 0x8000L) == 0x8000L)
-		mv1 |= 0xFFFFFFFFFFFF0000L;
-	if ((mv2 & 0x8000L) == 0x8000L)
-		mv2 |= 0xFFFFFFFFFFFF0000L;
-	if ((mv3 & 0x8000L) == 0x8000L)
-		mv3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Declare and store correct multiply matrix values
-	int64_t mx11 = 0, mx12 = 0, mx13 = 0, mx21 = 0,
-			mx22 = 0, mx23 = 0, mx31 = 0, mx32 = 0, mx33 = 0;
+	// Retrieve correct multiply matrix
+	int16_t matrix[3][3];
 	switch (mMatrix) {
 		case 0: // Rotation matrix
-			mx11 =
-				0xFFFF & gte->controlRegisters[0]; // RT11;
-			mx12 =
-				0xFFFF & logical_rshift(gte->controlRegisters[0], 16); // RT12
-			mx13 =
-				0xFFFF & gte->controlRegisters[1]; // RT13
-			mx21 =
-				0xFFFF & logical_rshift(gte->controlRegisters[1], 16); // RT21
-			mx22 =
-				0xFFFF & gte->controlRegisters[2]; // RT22
-			mx23 =
-				0xFFFF & logical_rshift(gte->controlRegisters[2], 16); // RT23
-			mx31 =
-				0xFFFF & gte->controlRegisters[3]; // RT31
-			mx32 =
-				0xFFFF & logical_rshift(gte->controlRegisters[3], 16); // RT32
-			mx33 =
-				0xFFFF & gte->controlRegisters[4]; // RT33
+			memcpy(matrix, gte->rotation, sizeof(matrix));
 			break;
 		case 1: // Light matrix
-			mx11 =
-				0xFFFF & gte->controlRegisters[8]; // L11;
-			mx12 =
-				0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-			mx13 =
-				0xFFFF & gte->controlRegisters[9]; // L13
-			mx21 =
-				0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-			mx22 =
-				0xFFFF & gte->controlRegisters[10]; // L22
-			mx23 =
-				0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-			mx31 =
-				0xFFFF & gte->controlRegisters[11]; // L31
-			mx32 =
-				0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-			mx33 =
-				0xFFFF & gte->controlRegisters[12]; // L33
+			memcpy(matrix, gte->light, sizeof(matrix));
 			break;
 		case 2: // Colour matrix
-			mx11 =
-				0xFFFF & gte->controlRegisters[16]; // LR1;
-			mx12 =
-				0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-			mx13 =
-				0xFFFF & gte->controlRegisters[17]; // LR3
-			mx21 =
-				0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-			mx22 =
-				0xFFFF & gte->controlRegisters[18]; // LG2
-			mx23 =
-				0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-			mx31 =
-				0xFFFF & gte->controlRegisters[19]; // LB1
-			mx32 =
-				0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-			mx33 =
-				0xFFFF & gte->controlRegisters[20]; // LB3
+			memcpy(matrix, gte->colour, sizeof(matrix));
 			break;
 		case 3: // Reserved (garbage matrix)
-			mx11 = -0x60;
-			mx12 = 0x60;
-			mx13 = 0xFFFF & gte->dataRegisters[8]; // IR0
-			mx21 = 0xFFFF & gte->controlRegisters[1]; // RT13
-			mx22 = 0xFFFF & gte->controlRegisters[1]; // RT13
-			mx23 = 0xFFFF & gte->controlRegisters[1]; // RT13
-			mx31 = 0xFFFF & gte->controlRegisters[2]; // RT22
-			mx32 = 0xFFFF & gte->controlRegisters[2]; // RT22
-			mx33 = 0xFFFF & gte->controlRegisters[2]; // RT22                
-			break;
-	}
-
-	// Sign extend multiply matrix values
-	if ((mx11 & 0x8000L) == 0x8000L && mMatrix != 3)
-		mx11 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx12 & 0x8000L) == 0x8000L && mMatrix != 3)
-		mx12 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx13 & 0x8000L) == 0x8000L)
-		mx13 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx21 & 0x8000L) == 0x8000L)
-		mx21 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx22 & 0x8000L) == 0x8000L)
-		mx22 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx23 & 0x8000L) == 0x8000L)
-		mx23 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx31 & 0x8000L) == 0x8000L)
-		mx31 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx32 & 0x8000L) == 0x8000L)
-		mx32 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx33 & 0x8000L) == 0x8000L)
-		mx33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Declare temporary variables and do calculations
-	int64_t temp1 = 0, temp2 = 0, temp3 = 0;
-	if (tVec != 2) {
-		temp1 = tv1 * 0x1000L + mx11 * mv1 + mx12 * mv2 + mx13 * mv3;
-		temp2 = tv2 * 0x1000L + mx21 * mv1 + mx22 * mv2 + mx23 * mv3;
-		temp3 = tv3 * 0x1000L + mx31 * mv1 + mx32 * mv2 + mx33 * mv3;
-	} else { // Account for faulty FC vector calculation on real hardware
-		temp1 = mx13 * mv3;
-		temp2 = mx23 * mv3;
-		temp3 = mx33 * mv3;
-	}
-
-	// Shift results right by (sf * 12) bits, preserving sign bit
-	temp1 = temp1 >> (sf * 12);
-	temp2 = temp2 >> (sf * 12);
-	temp3 = temp3 >> (sf * 12);
-
-	// Set MAC1, MAC2 and MAC3 registers
-	gte->dataRegisters[25] = (int32_t)temp1; // MAC1
-	gte->dataRegisters[26] = (int32_t)temp2; // MAC2
-	gte->dataRegisters[27] = (int32_t)temp3; // MAC3
-
-	// Set relevant MAC1, MAC2 and MAC3 flag bits
-
-	// MAC1
-	if (temp1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (temp1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	// MAC2
-	if (temp2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (temp2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	// MAC3
-	if (temp3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (temp3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Set IR1, IR2 and IR3 registers and saturation flag bits
-	switch (lm) {
-		case 0: // Saturate to -0x8000..0x7FFF
-		{
-			// IR1
-			if (temp1 < -0x8000) {
-				gte->dataRegisters[9] = -0x8000;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else if (temp1 > 0x7FFF) {
-				gte->dataRegisters[9] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else {
-				gte->dataRegisters[9] = (int32_t)temp1;
-			}
-
-			// IR2
-			if (temp2 < -0x8000) {
-				gte->dataRegisters[10] = -0x8000;
-				gte->controlRegisters[31] |= 0x800000;
-			} else if (temp2 > 0x7FFF) {
-				gte->dataRegisters[10] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x800000;
-			} else {
-				gte->dataRegisters[10] = (int32_t)temp2;
-			}
-
-			// IR3
-			if (temp3 < -0x8000) {
-				gte->dataRegisters[11] = -0x8000;
-				gte->controlRegisters[31] |= 0x400000;
-			} else if (temp3 > 0x7FFF) {
-				gte->dataRegisters[11] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x400000;
-			} else {
-				gte->dataRegisters[11] = (int32_t)temp3;
+			matrix[0][0] = -0x60;
+			matrix[0][1] = 0x60;
+			matrix[0][2] = gte->ir[0];
+			for (int32_t i = 0; i < 3; ++i) {
+				matrix[1][i] = gte->rotation[0][2]; // RT13
+				matrix[2][i] = gte->rotation[1][1]; // RT22
 			}
-		}
 			break;
-		case 1: // Saturate to 0..0x7FFF
-		{
-			// IR1
-			if (temp1 < 0) {
-				gte->dataRegisters[9] = 0;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else if (temp1 > 0x7FFF) {
-				gte->dataRegisters[9] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else {
-				gte->dataRegisters[9] = (int32_t)temp1;
-			}
-
-			// IR2
-			if (temp2 < 0) {
-				gte->dataRegisters[10] = 0;
-				gte->controlRegisters[31] |= 0x800000;
-			} else if (temp2 > 0x7FFF) {
-				gte->dataRegisters[10] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x800000;
-			} else {
-				gte->dataRegisters[10] = (int32_t)temp2;
-			}
+	}
 
-			// IR3
-			if (temp3 < 0) {
-				gte->dataRegisters[11] = 0;
-				gte->controlRegisters[31] |= 0x400000;
-			} else if (temp3 > 0x7FFF) {
-				gte->dataRegisters[11] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x400000;
-			} else {
-				gte->dataRegisters[11] = (int32_t)temp3;
-			}
+	// Account for faulty FC vector calculation on real hardware, which only
+	// uses the last column of the matrix
+	if (tVec == 2) {
+		for (int32_t i = 0; i < 3; ++i) {
+			translation[i] = 0;
+			matrix[i][0] = 0;
+			matrix[i][1] = 0;
 		}
-			break;
 	}
 
+	// Do calculations, then shift and saturate results and store them
+	int64_t mac[3];
+	int16_t ir[3];
+	Cop2_multiplyVector(matrix, translation, vector, mac);
+	Cop2_saturateStage(&flag, mac, sf, lowerBound, ir);
+	Cop2_storeResults(gte, mac, ir);
+
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -1618,746 +827,53 @@ static void Cop2_handleMVMVA(Cop2 *gte, int32_t opcode)
 static void Cop2_handleNCDS(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21]; // RFC
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22]; // GFC
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23]; // BFC
-
-	// Sign extend far colour values if needed
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Retrieve IR0 value
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-
-	// Sign extend IR0 value if necessary
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Retrieve V0 values
-	int64_t vx0 = 0xFFFF & gte->dataRegisters[0]; // VX0
-	int64_t vy0 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-	int64_t vz0 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-
-	// Sign extend V0 values if necessary
-	if ((vx0 & 0x8000L) == 0x8000L)
-		vx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vy0 & 0x8000L) == 0x8000L)
-		vy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vz0 & 0x8000L) == 0x8000L)
-		vz0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Perform first stage of calculation
-	int64_t mac1 = l11 * vx0 + l12 * vy0 + l13 * vz0;
-	int64_t mac2 = l21 * vx0 + l22 * vy0 + l23 * vz0;
-	int64_t mac3 = l31 * vx0 + l32 * vy0 + l33 * vz0;
-
-	// Shift right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Set flags and mask bits for MAC1, MAC2 and MAC3
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Setup IR1, IR2 and IR3
-	int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
+	// Light V0, then apply RGBC and interpolate towards far colour
+	int64_t mac[3];
+	int16_t ir[3];
+	Cop2_lightVector(gte, &flag, sf, lowerBound, mac, ir);
+	Cop2_multiplyColour(gte, &flag, ir, mac);
+	Cop2_interpolateColour(gte, &flag, mac, ir, sf, lowerBound);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
+	// Calculate bit 31 of flag register
+	Cop2_finishFlags(gte, flag);
+}
 
-	// Perform second stage of calculation
-	mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-	mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-	mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-	// Shift right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Set flags and mask bits for MAC1, MAC2 and MAC3 (again)
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Setup IR1, IR2 and IR3 (again)
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Perform first NCCx stage calculation
-	mac1 = r * ir1;
-	mac2 = g * ir2;
-	mac3 = b * ir3;
-
-	// Shift results left by four bits
-	mac1 = mac1 << 4;
-	mac2 = mac2 << 4;
-	mac3 = mac3 << 4;
-
-	// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Perform NCDx only calculation
-	ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-	ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-	ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-	// Saturate IR1, IR2 and IR3 if needed, but ignoring lm bit
-	if (ir1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (ir1 < -0x8000L) {
-		ir1 = -0x8000L;
-		gte->controlRegisters[31] |= 0x1000000;
-	}
-
-	if (ir2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (ir2 < -0x8000L) {
-		ir2 = -0x8000L;
-		gte->controlRegisters[31] |= 0x800000;
-	}
-
-	if (ir3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (ir3 < -0x8000L) {
-		ir3 = -0x8000L;
-		gte->controlRegisters[31] |= 0x400000;
-	}
-
-	// Next stage of NCDx only calculation
-	mac1 = ir1 * ir0 + mac1;
-	mac2 = ir2 * ir0 + mac2;
-	mac3 = ir3 * ir0 + mac3;
-
-	// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Perform second NCCx stage calculation,
-	// shifting MAC1, MAC2 and MAC3 by (sf * 12), and preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store results back to IR1, IR2 and IR3
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Calculate result to be stored to colour FIFO
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	// Check values and saturate + set flags if needed
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
-
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
-
-	// Calculate and set flag bit 31
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store all values back
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
-}
-
-/*
- * This function handles the CDP GTE function.
- */
-static void Cop2_handleCDP(Cop2 *gte, int32_t opcode)
-{
-	// Clear flag register
-	gte->controlRegisters[31] = 0;
+/*
+ * This function handles the CDP GTE function.
+ */
+static void Cop2_handleCDP(Cop2 *gte, int32_t opcode)
+{
+	// Clear flag register
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21]; // RFC
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22]; // GFC
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23]; // BFC
-
-	// Sign extend far colour values if needed
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Load IR0, IR1, IR2 and IR3 values
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-	int64_t ir1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-	int64_t ir2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-	int64_t ir3 = 0xFFFF & gte->dataRegisters[11]; // IR3
-
-	// Sign extend IR0, IR1, IR2 and IR3 values if needed
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir1 & 0x8000L) == 0x8000L)
-		ir1 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir2 & 0x8000L) == 0x8000L)
-		ir2 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir3 & 0x8000L) == 0x8000L)
-		ir3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Perform first stage of calculation
-	int64_t mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-	int64_t mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-	int64_t mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-	// Shift results right by (sf * 12), preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for MAC1, MAC2 and MAC3 flags and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store results to IR1, IR2 and IR3        
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
+	// Perform first stage of calculation on IR1, IR2 and IR3
+	int64_t mac[3];
+	int16_t ir[3];
+	Cop2_multiplyVector(gte->colour, gte->background, gte->ir + 1, mac);
+	Cop2_saturateStage(&flag, mac, sf, lowerBound, ir);
 
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Perform second stage of calculation
-	mac1 = (r * ir1) << 4;
-	mac2 = (g * ir2) << 4;
-	mac3 = (b * ir3) << 4;
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Perform first part of CDP-only stage of calculation
-	ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-	ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-	ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-	// Check for IR1, IR2 and IR3 values, saturating and flag setting if needed
-	if (ir1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (ir1 < -0x8000L) {
-		ir1 = -0x8000L;
-		gte->controlRegisters[31] |= 0x1000000;
-	}
-
-	if (ir2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (ir2 < -0x8000L) {
-		ir2 = -0x8000L;
-		gte->controlRegisters[31] |= 0x800000;
-	}
-
-	if (ir3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (ir3 < -0x8000L) {
-		ir3 = -0x8000L;
-		gte->controlRegisters[31] |= 0x400000;
-	}
-
-	// Perform second part of CDP-only stage of calculation
-	mac1 = ir1 * ir0 + mac1;
-	mac2 = ir2 * ir0 + mac2;
-	mac3 = ir3 * ir0 + mac3;
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Shift MAC1, MAC2 and MAC3 right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store results to IR1, IR2 and IR3 again    
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Generate colour FIFO values
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	// Check for colour FIFO flags and set if needed
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
-
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
+	// Apply RGBC and interpolate towards far colour
+	Cop2_multiplyColour(gte, &flag, ir, mac);
+	Cop2_interpolateColour(gte, &flag, mac, ir, sf, lowerBound);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store values back to registers
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -2368,466 +884,32 @@ static void Cop2_handleNCDT(Cop2 *gte, int32_t opcode)
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21]; // RFC
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22]; // GFC
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23]; // BFC
-
-	// Sign extend far colour values if needed
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Retrieve IR0 value
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-
-	// Sign extend IR0 value if necessary
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Repeat calculation for V0, V1 and V2
-	for (int32_t i = 0; i < 3; ++i) {
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve Vx values
-		int64_t vxAny = 0, vyAny = 0, vzAny = 0;
-		switch (i) {
-			case 0:
-				vxAny =
-					0xFFFF & gte->dataRegisters[0]; // VX0
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-				vzAny =
-					0xFFFF & gte->dataRegisters[1]; // VZ0
-				break;
-			case 1:
-				vxAny =
-					0xFFFF & gte->dataRegisters[2]; // VX1
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-				vzAny =
-					0xFFFF & gte->dataRegisters[3]; // VZ1
-				break;
-			case 2:
-				vxAny =
-					0xFFFF & gte->dataRegisters[4]; // VX2
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-				vzAny =
-					0xFFFF & gte->dataRegisters[5]; // VZ2
-				break;
-		}
-
-		// Sign extend Vx values if necessary
-		if ((vxAny & 0x8000L) == 0x8000L) {
-			vxAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vyAny & 0x8000L) == 0x8000L) {
-			vyAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vzAny & 0x8000L) == 0x8000L) {
-			vzAny |= 0xFFFFFFFFFFFF0000L;
-		}
-
-		// Perform first stage of calculation
-		int64_t mac1 = l11 * vxAny + l12 * vyAny + l13 * vzAny;
-		int64_t mac2 = l21 * vxAny + l22 * vyAny + l23 * vzAny;
-		int64_t mac3 = l31 * vxAny + l32 * vyAny + l33 * vzAny;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Setup IR1, IR2 and IR3
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
+	// Light all three vectors at once
+	int64_t mac[3][3];
+	int32_t flags[3];
+	Cop2_lightVectors(gte, sf, lowerBound, mac, flags);
 
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Perform second stage of calculation
-		mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-		mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-		mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3 (again)
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Setup IR1, IR2 and IR3 (again)
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Perform first NCCx stage calculation
-		mac1 = r * ir1;
-		mac2 = g * ir2;
-		mac3 = b * ir3;
-
-		// Shift results left by four bits
-		mac1 = mac1 << 4;
-		mac2 = mac2 << 4;
-		mac3 = mac3 << 4;
-
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Perform NCDx only calculation
-		ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-		ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-		ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-		// Saturate IR1, IR2 and IR3 if needed, but ignoring lm bit
-		if (ir1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (ir1 < -0x8000L) {
-			ir1 = -0x8000L;
-			gte->controlRegisters[31] |= 0x1000000;
-		}
-
-		if (ir2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (ir2 < -0x8000L) {
-			ir2 = -0x8000L;
-			gte->controlRegisters[31] |= 0x800000;
-		}
-
-		if (ir3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (ir3 < -0x8000L) {
-			ir3 = -0x8000L;
-			gte->controlRegisters[31] |= 0x400000;
-		}
-
-		// Next stage of NCDx only calculation
-		mac1 = ir1 * ir0 + mac1;
-		mac2 = ir2 * ir0 + mac2;
-		mac3 = ir3 * ir0 + mac3;
-
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Perform second NCCx stage calculation,
-		// shifting MAC1, MAC2 and MAC3 by (sf * 12), and preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Store results back to IR1, IR2 and IR3
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Calculate result to be stored to colour FIFO
-		int64_t rOut = mac1 / 16;
-		int64_t gOut = mac2 / 16;
-		int64_t bOut = mac3 / 16;
-
-		// Check values and saturate + set flags if needed
-		if (rOut < 0) {
-			rOut = 0;
-			gte->controlRegisters[31] |= 0x200000;
-		} else if (rOut > 0xFF) {
-			rOut = 0xFF;
-			gte->controlRegisters[31] |= 0x200000;
-		}
-
-		if (gOut < 0) {
-			gOut = 0;
-			gte->controlRegisters[31] |= 0x100000;
-		} else if (gOut > 0xFF) {
-			gOut = 0xFF;
-			gte->controlRegisters[31] |= 0x100000;
-		}
-
-		if (bOut < 0) {
-			bOut = 0;
-			gte->controlRegisters[31] |= 0x80000;
-		} else if (bOut > 0xFF) {
-			bOut = 0xFF;
-			gte->controlRegisters[31] |= 0x80000;
-		}
-
-		// Calculate and set flag bit 31
-		if ((gte->controlRegisters[31] & 0x7F87E000) != 0) {
-			gte->controlRegisters[31] |= 0x80000000;
-		}
+	// Finish calculation for each vector in turn - the loop is unrolled so
+	// the compiler can drop work whose results the next vector overwrites
+#pragma GCC unroll 3
+	for (int32_t i = 0; i < 3; ++i) {
 
-		// Store all values back
-		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-		gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-		gte->dataRegisters[27] = (int32_t)mac3; // MAC3
+		// Restore flag register from first stage
+		int32_t flag = flags[i];
 
-		gte->dataRegisters[9] = (int32_t)ir1; // IR1
-		gte->dataRegisters[10] = (int32_t)ir2; // IR2
-		gte->dataRegisters[11] = (int32_t)ir3; // IR3
+		// Saturate lighting, then apply RGBC and interpolate towards far
+		// colour
+		int16_t ir[3];
+		Cop2_saturateStage(&flag, mac[i], sf, lowerBound, ir);
+		Cop2_multiplyColour(gte, &flag, ir, mac[i]);
+		Cop2_interpolateColour(gte, &flag, mac[i], ir, sf, lowerBound);
+		Cop2_storeColour(gte, &flag, mac[i], ir);
 
-		gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-		gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-		gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+		// Calculate bit 31 of flag register
+		Cop2_finishFlags(gte, flag);
 	}
 }
 
@@ -2837,351 +919,24 @@ static void Cop2_handleNCDT(Cop2 *gte, int32_t opcode)
 static void Cop2_handleNCCS(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Retrieve V0 values
-	int64_t vx0 = 0xFFFF & gte->dataRegisters[0]; // VX0
-	int64_t vy0 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-	int64_t vz0 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-
-	// Sign extend V0 values if necessary
-	if ((vx0 & 0x8000L) == 0x8000L)
-		vx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vy0 & 0x8000L) == 0x8000L)
-		vy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vz0 & 0x8000L) == 0x8000L)
-		vz0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Perform first stage of calculation
-	int64_t mac1 = l11 * vx0 + l12 * vy0 + l13 * vz0;
-	int64_t mac2 = l21 * vx0 + l22 * vy0 + l23 * vz0;
-	int64_t mac3 = l31 * vx0 + l32 * vy0 + l33 * vz0;
-
-	// Shift right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Set flags and mask bits for MAC1, MAC2 and MAC3
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Setup IR1, IR2 and IR3
-	int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Perform second stage of calculation
-	mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-	mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-	mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-	// Shift right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Set flags and mask bits for MAC1, MAC2 and MAC3 (again)
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Setup IR1, IR2 and IR3 (again)
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
+	// Light V0, then apply RGBC
+	int64_t mac[3];
+	int16_t ir[3];
+	Cop2_lightVector(gte, &flag, sf, lowerBound, mac, ir);
+	Cop2_multiplyColour(gte, &flag, ir, mac);
+	Cop2_saturateStage(&flag, mac, sf, lowerBound, ir);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Perform first NCCx stage calculation
-	mac1 = r * ir1;
-	mac2 = g * ir2;
-	mac3 = b * ir3;
-
-	// Shift results left by four bits
-	mac1 = mac1 << 4;
-	mac2 = mac2 << 4;
-	mac3 = mac3 << 4;
-
-	// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Perform second NCCx stage calculation,
-	// shifting MAC1, MAC2 and MAC3 by (sf * 12), and preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store results back to IR1, IR2 and IR3
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Calculate result to be stored to colour FIFO
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	// Check values and saturate + set flags if needed
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
-
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
-
-	// Calculate and set flag bit 31
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store all values back
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+	// Calculate bit 31 of flag register
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -3190,255 +945,27 @@ static void Cop2_handleNCCS(Cop2 *gte, int32_t opcode)
 static void Cop2_handleCC(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Load IR1, IR2 and IR3 values
-	int64_t ir1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-	int64_t ir2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-	int64_t ir3 = 0xFFFF & gte->dataRegisters[11]; // IR3
-
-	// Sign extend IR1, IR2 and IR3 values if needed
-	if ((ir1 & 0x8000L) == 0x8000L)
-		ir1 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir2 & 0x8000L) == 0x8000L)
-		ir2 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir3 & 0x8000L) == 0x8000L)
-		ir3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Perform first stage of calculation
-	int64_t mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-	int64_t mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-	int64_t mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-	// Shift results right by (sf * 12), preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for MAC1, MAC2 and MAC3 flags and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store results to IR1, IR2 and IR3 
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Perform second stage of calculation
-	mac1 = (r * ir1) << 4;
-	mac2 = (g * ir2) << 4;
-	mac3 = (b * ir3) << 4;
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Shift MAC1, MAC2 and MAC3 right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store results to IR1, IR2 and IR3 again    
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Generate colour FIFO values
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	// Check for colour FIFO flags and set if needed
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
+	// Perform first stage of calculation on IR1, IR2 and IR3
+	int64_t mac[3];
+	int16_t ir[3];
+	Cop2_multiplyVector(gte->colour, gte->background, gte->ir + 1, mac);
+	Cop2_saturateStage(&flag, mac, sf, lowerBound, ir);
 
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
+	// Apply RGBC
+	Cop2_multiplyColour(gte, &flag, ir, mac);
+	Cop2_saturateStage(&flag, mac, sf, lowerBound, ir);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store values back to registers
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -3447,272 +974,22 @@ static void Cop2_handleCC(Cop2 *gte, int32_t opcode)
 static void Cop2_handleNCS(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Retrieve V0 values
-	int64_t vx0 = 0xFFFF & gte->dataRegisters[0]; // VX0
-	int64_t vy0 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-	int64_t vz0 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-
-	// Sign extend V0 values if necessary
-	if ((vx0 & 0x8000L) == 0x8000L)
-		vx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vy0 & 0x8000L) == 0x8000L)
-		vy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vz0 & 0x8000L) == 0x8000L)
-		vz0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Perform first stage of calculation
-	int64_t mac1 = l11 * vx0 + l12 * vy0 + l13 * vz0;
-	int64_t mac2 = l21 * vx0 + l22 * vy0 + l23 * vz0;
-	int64_t mac3 = l31 * vx0 + l32 * vy0 + l33 * vz0;
-
-	// Shift right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Set flags and mask bits for MAC1, MAC2 and MAC3
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Setup IR1, IR2 and IR3
-	int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Perform second stage of calculation
-	mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-	mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-	mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-	// Shift right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Set flags and mask bits for MAC1, MAC2 and MAC3 (again)
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Setup IR1, IR2 and IR3 (again)
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Calculate result to be stored to colour FIFO
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	// Check values and saturate + set flags if needed
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
-
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-	// Calculate and set flag bit 31
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	// Light V0
+	int64_t mac[3];
+	int16_t ir[3];
+	Cop2_lightVector(gte, &flag, sf, lowerBound, mac, ir);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
-	// Store all values back
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+	// Calculate bit 31 of flag register
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -3723,307 +1000,29 @@ static void Cop2_handleNCT(Cop2 *gte, int32_t opcode)
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Repeat function three times, using V0, V1 and V2
-	for (int32_t i = 0; i < 3; ++i) {
-
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve Vx values
-		int64_t vxAny = 0, vyAny = 0, vzAny = 0;
-		switch (i) {
-			case 0:
-				vxAny =
-					0xFFFF & gte->dataRegisters[0]; // VX0
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-				vzAny =
-					0xFFFF & gte->dataRegisters[1]; // VZ0
-				break;
-			case 1:
-				vxAny =
-					0xFFFF & gte->dataRegisters[2]; // VX1
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-				vzAny =
-					0xFFFF & gte->dataRegisters[3]; // VZ1
-				break;
-			case 2:
-				vxAny =
-					0xFFFF & gte->dataRegisters[4]; // VX2
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-				vzAny =
-					0xFFFF & gte->dataRegisters[5]; // VZ2
-				break;
-		}
-
-		// Sign extend Vx values if necessary
-		if ((vxAny & 0x8000L) == 0x8000L) {
-			vxAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vyAny & 0x8000L) == 0x8000L) {
-			vyAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vzAny & 0x8000L) == 0x8000L) {
-			vzAny |= 0xFFFFFFFFFFFF0000L;
-		}
-
-		// Perform first stage of calculation
-		int64_t mac1 = l11 * vxAny + l12 * vyAny + l13 * vzAny;
-		int64_t mac2 = l21 * vxAny + l22 * vyAny + l23 * vzAny;
-		int64_t mac3 = l31 * vxAny + l32 * vyAny + l33 * vzAny;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Setup IR1, IR2 and IR3
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Perform second stage of calculation
-		mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-		mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-		mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3 (again)
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Setup IR1, IR2 and IR3 (again)
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Calculate result to be stored to colour FIFO
-		int64_t rOut = mac1 / 16;
-		int64_t gOut = mac2 / 16;
-		int64_t bOut = mac3 / 16;
-
-		// Check values and saturate + set flags if needed
-		if (rOut < 0) {
-			rOut = 0;
-			gte->controlRegisters[31] |= 0x200000;
-		} else if (rOut > 0xFF) {
-			rOut = 0xFF;
-			gte->controlRegisters[31] |= 0x200000;
-		}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-		if (gOut < 0) {
-			gOut = 0;
-			gte->controlRegisters[31] |= 0x100000;
-		} else if (gOut > 0xFF) {
-			gOut = 0xFF;
-			gte->controlRegisters[31] |= 0x100000;
-		}
-
-		if (bOut < 0) {
-			bOut = 0;
-			gte->controlRegisters[31] |= 0x80000;
-		} else if (bOut > 0xFF) {
-			bOut = 0xFF;
-			gte->controlRegisters[31] |= 0x80000;
-		}
+	// Light all three vectors at once
+	int64_t mac[3][3];
+	int32_t flags[3];
+	Cop2_lightVectors(gte, sf, lowerBound, mac, flags);
 
-		// Calculate and set flag bit 31
-		if ((gte->controlRegisters[31] & 0x7F87E000) != 0) {
-			gte->controlRegisters[31] |= 0x80000000;
-		}
+	// Finish calculation for each vector in turn - the loop is unrolled so
+	// the compiler can drop work whose results the next vector overwrites
+#pragma GCC unroll 3
+	for (int32_t i = 0; i < 3; ++i) {
 
-		// Store all values back
-		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-		gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-		gte->dataRegisters[27] = (int32_t)mac3; // MAC3
+		// Restore flag register from first stage
+		int32_t flag = flags[i];
 
-		gte->dataRegisters[9] = (int32_t)ir1; // IR1
-		gte->dataRegisters[10] = (int32_t)ir2; // IR2
-		gte->dataRegisters[11] = (int32_t)ir3; // IR3
+		// Saturate lighting and store results
+		int16_t ir[3];
+		Cop2_saturateStage(&flag, mac[i], sf, lowerBound, ir);
+		Cop2_storeColour(gte, &flag, mac[i], ir);
 
-		gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-		gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-		gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+		// Calculate bit 31 of flag register
+		Cop2_finishFlags(gte, flag);
 	}
 }
 
@@ -4033,53 +1032,23 @@ static void Cop2_handleNCT(Cop2 *gte, int32_t opcode)
 static void Cop2_handleSQR(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Fetch IR1, IR2 and IR3
-	int64_t temp1 = gte->dataRegisters[9] & 0xFFFF; // IR1
-	int64_t temp2 = gte->dataRegisters[10] & 0xFFFF; // IR2
-	int64_t temp3 = gte->dataRegisters[11] & 0xFFFF; // IR3
-
-	// Extend sign bit if necessary
-	if ((temp1 & 0x8000L) == 0x8000L)
-		temp1 |= 0xFFFFFFFFFFFF0000L;
-	if ((temp2 & 0x8000L) == 0x8000L)
-		temp2 |= 0xFFFFFFFFFFFF0000L;
-	if ((temp3 & 0x8000L) == 0x8000L)
-		temp3 |= 0xFFFFFFFFFFFF0000L;
+	// Square IR1, IR2 and IR3, shifting if specified - the results can't
+	// be negative, so only need saturating at the top
+	int64_t mac[3];
+	int16_t ir[3];
+	for (int32_t i = 0; i < 3; ++i) {
+		mac[i] = ((int64_t)gte->ir[i + 1] * gte->ir[i + 1]) >> (12 * sf);
+		ir[i] = Cop2_saturate(&flag, mac[i], 0, 0x7FFF, 0x1000000 >> i);
+	}
+	Cop2_storeResults(gte, mac, ir);
 
-	// Perform calculations
-	temp1 = temp1 * temp1;
-	temp2 = temp2 * temp2;
-	temp3 = temp3 * temp3;
-
-	// Shift if specified
-	temp1 = logical_rshift(temp1, (12 * sf));
-	temp2 = logical_rshift(temp2, (12 * sf));
-	temp3 = logical_rshift(temp3, (12 * sf));
-
-	// Set MAC1, MAC2 and MAC3 registers
-	gte->dataRegisters[25] = (int32_t)temp1; // MAC1
-	gte->dataRegisters[26] = (int32_t)temp2; // MAC2
-	gte->dataRegisters[27] = (int32_t)temp3; // MAC3
-
-	// Set IR1, IR2 and IR3 registers
-	gte->dataRegisters[9] = (temp1 > 0x7FFF) ? 0x7FFF : (int32_t)temp1; // IR1
-	gte->dataRegisters[10] = (temp2 > 0x7FFF) ? 0x7FFF : (int32_t)temp2; // IR2
-	gte->dataRegisters[11] = (temp3 > 0x7FFF) ? 0x7FFF : (int32_t)temp3; // IR3
-
-	// Set flags
-	if (temp1 > 0x7FFF)
-		gte->controlRegisters[31] |= 0x1000000;
-	if (temp2 > 0x7FFF)
-		gte->controlRegisters[31] |= 0x800000;
-	if (temp3 > 0x7FFF)
-		gte->controlRegisters[31] |= 0x400000;
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	// Calculate bit 31 of flag register
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -4088,447 +1057,55 @@ static void Cop2_handleSQR(Cop2 *gte, int32_t opcode)
 static void Cop2_handleDCPL(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
-
-	// Filter out sf bit
-	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
-
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve IR0, IR1, IR2 and IR3 values
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-	int64_t ir1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-	int64_t ir2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-	int64_t ir3 = 0xFFFF & gte->dataRegisters[11]; // IR3
-
-	// Sign extend IR0, IR1, IR2 and IR3 values
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir1 & 0x8000L) == 0x8000L)
-		ir1 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir2 & 0x8000L) == 0x8000L)
-		ir2 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir3 & 0x8000L) == 0x8000L)
-		ir3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21];
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22];
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23];
-
-	// Sign extend far colour values
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Perform DCPL-only calculation
-	int64_t mac1 = (r * ir1) << 4;
-	int64_t mac2 = (g * ir2) << 4;
-	int64_t mac3 = (b * ir3) << 4;
-
-	// Check for and set MAC1, MAC2 and MAC3 flags if needed
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Perform first common stage of calculation
-	ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-	ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-	ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-	// Saturate IR1, IR2 and IR3 results, setting flags as needed
-	if (ir1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (ir1 < -0x8000L) {
-		ir1 = -0x8000L;
-		gte->controlRegisters[31] |= 0x1000000;
-	}
-
-	if (ir2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (ir2 < -0x8000L) {
-		ir2 = -0x8000L;
-		gte->controlRegisters[31] |= 0x800000;
-	}
-
-	if (ir3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (ir3 < -0x8000L) {
-		ir3 = -0x8000L;
-		gte->controlRegisters[31] |= 0x400000;
-	}
-
-	// Continue first common stage of calculation
-	mac1 = ir1 * ir0 + mac1;
-	mac2 = ir2 * ir0 + mac2;
-	mac3 = ir3 * ir0 + mac3;
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Shift MAC1, MAC2 and MAC3 by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store MAC1, MAC2 and MAC3 to IR1, IR2 and IR3
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Generate colour FIFO values and check/set flags as needed
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
-
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
-
-	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store values back to registers
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
-}
-
-/*
- * This function handles the DPCT GTE function.
- */
-static void Cop2_handleDPCT(Cop2 *gte, int32_t opcode)
-{
-	// Filter out sf bit
-	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
-
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve IR0 value and define IR1, IR2 and IR3
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-
-	// Sign extend IR0 value
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21];
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22];
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23];
-
-	// Sign extend far colour values
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Repeat calculation three times
-	for (int32_t i = 0; i < 3; ++i) {
-
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve CODE value from RGBC and RGB values from RGB0
-		int64_t r = 0xFF & gte->dataRegisters[20]; // R0
-		int64_t g = 0xFF & logical_rshift(gte->dataRegisters[20], 8); // G0
-		int64_t b = 0xFF & logical_rshift(gte->dataRegisters[20], 16); // B0
-		int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-		// Perform DPCT-only calculation
-		int64_t mac1 = r << 16;
-		int64_t mac2 = g << 16;
-		int64_t mac3 = b << 16;
-
-		// Check for and set MAC1, MAC2 and MAC3 flags if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Perform first common stage of calculation
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-		ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-		ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-		// Saturate IR1, IR2 and IR3 results, setting flags as needed
-		if (ir1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (ir1 < -0x8000L) {
-			ir1 = -0x8000L;
-			gte->controlRegisters[31] |= 0x1000000;
-		}
-
-		if (ir2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (ir2 < -0x8000L) {
-			ir2 = -0x8000L;
-			gte->controlRegisters[31] |= 0x800000;
-		}
-
-		if (ir3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (ir3 < -0x8000L) {
-			ir3 = -0x8000L;
-			gte->controlRegisters[31] |= 0x400000;
-		}
-
-		// Continue first common stage of calculation
-		mac1 = ir1 * ir0 + mac1;
-		mac2 = ir2 * ir0 + mac2;
-		mac3 = ir3 * ir0 + mac3;
-
-		// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Shift MAC1, MAC2 and MAC3 by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
+	int32_t flag = 0;
 
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+	// Filter out sf bit
+	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-		// Store MAC1, MAC2 and MAC3 to IR1, IR2 and IR3
-		int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
+	// Apply RGBC to IR1, IR2 and IR3, then interpolate towards far colour
+	int64_t mac[3];
+	int16_t ir[3];
+	Cop2_multiplyColour(gte, &flag, gte->ir + 1, mac);
+	Cop2_interpolateColour(gte, &flag, mac, ir, sf, lowerBound);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
+	// Calculate bit 31 of flag register
+	Cop2_finishFlags(gte, flag);
+}
 
-		// Generate colour FIFO values and check/set flags as needed
-		int64_t rOut = mac1 / 16;
-		int64_t gOut = mac2 / 16;
-		int64_t bOut = mac3 / 16;
-
-		if (rOut < 0) {
-			rOut = 0;
-			gte->controlRegisters[31] |= 0x200000;
-		} else if (rOut > 0xFF) {
-			rOut = 0xFF;
-			gte->controlRegisters[31] |= 0x200000;
-		}
+/*
+ * This function handles the DPCT GTE function.
+ */
+static void Cop2_handleDPCT(Cop2 *gte, int32_t opcode)
+{
+	// Filter out sf bit
+	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-		if (gOut < 0) {
-			gOut = 0;
-			gte->controlRegisters[31] |= 0x100000;
-		} else if (gOut > 0xFF) {
-			gOut = 0xFF;
-			gte->controlRegisters[31] |= 0x100000;
-		}
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-		if (bOut < 0) {
-			bOut = 0;
-			gte->controlRegisters[31] |= 0x80000;
-		} else if (bOut > 0xFF) {
-			bOut = 0xFF;
-			gte->controlRegisters[31] |= 0x80000;
-		}
+	// Repeat calculation three times, each time on RGB0 as the FIFO moves
+	for (int32_t i = 0; i < 3; ++i) {
 
-		// Calculate bit 31 of flag register
-		if ((gte->controlRegisters[31] & 0x7F87E000) != 0) {
-			gte->controlRegisters[31] |= 0x80000000;
-		}
+		// Clear flag register
+		int32_t flag = 0;
 
-		// Store values back to registers
-		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-		gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-		gte->dataRegisters[27] = (int32_t)mac3; // MAC3
+		// Perform DPCT-only calculation
+		int64_t mac[3];
+		for (int32_t j = 0; j < 3; ++j)
+			mac[j] = (int64_t)gte->rgb[0][j] << 16;
+		Cop2_checkMac(&flag, mac);
 
-		gte->dataRegisters[9] = (int32_t)ir1; // IR1
-		gte->dataRegisters[10] = (int32_t)ir2; // IR2
-		gte->dataRegisters[11] = (int32_t)ir3; // IR3
+		// Interpolate towards far colour and store results
+		int16_t ir[3];
+		Cop2_interpolateColour(gte, &flag, mac, ir, sf, lowerBound);
+		Cop2_storeColour(gte, &flag, mac, ir);
 
-		gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-		gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-		gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+		// Calculate bit 31 of flag register
+		Cop2_finishFlags(gte, flag);
 	}
 }
 
@@ -4538,43 +1115,20 @@ static void Cop2_handleDPCT(Cop2 *gte, int32_t opcode)
 static void Cop2_handleAVSZ3(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
-
-	// Retrieve ZSF3, SZ1, SZ2 and SZ3
-	int64_t zsf3 = 0xFFFF & gte->controlRegisters[29]; // ZSF3
-	int64_t sz1 = 0xFFFF & gte->dataRegisters[17]; // SZ1
-	int64_t sz2 = 0xFFFF & gte->dataRegisters[18]; // SZ2
-	int64_t sz3 = 0xFFFF & gte->dataRegisters[19]; // SZ3
-
-	// Sign extend ZSF3 if needed
-	if ((zsf3 & 0x8000L) == 0x8000L)
-		zsf3 |= 0xFFFFFFFFFFFF0000L;
+	int32_t flag = 0;
 
 	// Perform calculation
-	int64_t mac0 = zsf3 * (sz1 + sz2 + sz3);
-	int64_t otz = mac0 / 0x1000;
+	int64_t mac0 = (int64_t)gte->zsf3 *
+			(gte->sz[1] + gte->sz[2] + gte->sz[3]);
 
 	// Set flags where needed, and apply saturation to OTZ if needed
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-
-	if (otz < 0) {
-		otz = 0;
-		gte->controlRegisters[31] |= 0x40000;
-	} else if (otz > 0xFFFFL) {
-		otz = 0xFFFFL;
-		gte->controlRegisters[31] |= 0x40000;
-	}
-
-	// Calculate flag bit 31
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	Cop2_checkMac0(&flag, mac0);
+	int64_t otz = Cop2_saturate(&flag, mac0 / 0x1000, 0, 0xFFFF, 0x40000);
+	Cop2_finishFlags(gte, flag);
 
 	// Store results back to registers
-	gte->dataRegisters[24] = (int32_t)mac0;
-	gte->dataRegisters[7] = (int32_t)otz;
+	gte->mac[0] = (int32_t)mac0;
+	gte->otz = (uint16_t)otz;
 }
 
 /*
@@ -4583,44 +1137,20 @@ static void Cop2_handleAVSZ3(Cop2 *gte, int32_t opcode)
 static void Cop2_handleAVSZ4(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
-
-	// Retrieve ZSF4, SZ0, SZ1, SZ2 and SZ3
-	int64_t zsf4 = 0xFFFF & gte->controlRegisters[30]; // ZSF4
-	int64_t sz0 = 0xFFFF & gte->dataRegisters[16]; // SZ0
-	int64_t sz1 = 0xFFFF & gte->dataRegisters[17]; // SZ1
-	int64_t sz2 = 0xFFFF & gte->dataRegisters[18]; // SZ2
-	int64_t sz3 = 0xFFFF & gte->dataRegisters[19]; // SZ3
-
-	// Sign extend ZSF4 if needed
-	if ((zsf4 & 0x8000L) == 0x8000L)
-		zsf4 |= 0xFFFFFFFFFFFF0000L;
+	int32_t flag = 0;
 
 	// Perform calculation
-	int64_t mac0 = zsf4 * (sz0 + sz1 + sz2 + sz3);
-	int64_t otz = mac0 / 0x1000;
+	int64_t mac0 = (int64_t)gte->zsf4 *
+			(gte->sz[0] + gte->sz[1] + gte->sz[2] + gte->sz[3]);
 
 	// Set flags where needed, and apply saturation to OTZ if needed
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-
-	if (otz < 0) {
-		otz = 0;
-		gte->controlRegisters[31] |= 0x40000;
-	} else if (otz > 0xFFFFL) {
-		otz = 0xFFFFL;
-		gte->controlRegisters[31] |= 0x40000;
-	}
-
-	// Calculate flag bit 31
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	Cop2_checkMac0(&flag, mac0);
+	int64_t otz = Cop2_saturate(&flag, mac0 / 0x1000, 0, 0xFFFF, 0x40000);
+	Cop2_finishFlags(gte, flag);
 
 	// Store results back to registers
-	gte->dataRegisters[24] = (int32_t)mac0;
-	gte->dataRegisters[7] = (int32_t)otz;
+	gte->mac[0] = (int32_t)mac0;
+	gte->otz = (uint16_t)otz;
 }
 
 /*
@@ -4631,360 +1161,24 @@ static void Cop2_handleRTPT(Cop2 *gte, int32_t opcode)
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve rotation matrix values
-	int64_t rt11 =
-			0xFFFF & gte->controlRegisters[0]; // RT11
-	int64_t rt12 =
-			0xFFFF & logical_rshift(gte->controlRegisters[0], 16); // RT12
-	int64_t rt13 =
-			0xFFFF & gte->controlRegisters[1]; // RT13
-	int64_t rt21 =
-			0xFFFF & logical_rshift(gte->controlRegisters[1], 16); // RT21
-	int64_t rt22 =
-			0xFFFF & gte->controlRegisters[2]; // RT22
-	int64_t rt23 =
-			0xFFFF & logical_rshift(gte->controlRegisters[2], 16); // RT23
-	int64_t rt31 =
-			0xFFFF & gte->controlRegisters[3]; // RT31
-	int64_t rt32 =
-			0xFFFF & logical_rshift(gte->controlRegisters[3], 16); // RT32
-	int64_t rt33 =
-			0xFFFF & gte->controlRegisters[4]; // RT33
-
-	// Sign extend rotation matrix values if necessary
-	if ((rt11 & 0x8000L) == 0x8000L)
-		rt11 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt12 & 0x8000L) == 0x8000L)
-		rt12 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt13 & 0x8000L) == 0x8000L)
-		rt13 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt21 & 0x8000L) == 0x8000L)
-		rt21 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt22 & 0x8000L) == 0x8000L)
-		rt22 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt23 & 0x8000L) == 0x8000L)
-		rt23 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt31 & 0x8000L) == 0x8000L)
-		rt31 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt32 & 0x8000L) == 0x8000L)
-		rt32 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt33 & 0x8000L) == 0x8000L)
-		rt33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve translation vector values
-	int64_t trX = 0xFFFFFFFFL & gte->controlRegisters[5]; // TRX
-	int64_t trY = 0xFFFFFFFFL & gte->controlRegisters[6]; // TRY
-	int64_t trZ = 0xFFFFFFFFL & gte->controlRegisters[7]; // TRZ
-
-	// Sign extend translation vector values if necessary
-	if ((trX & 0x80000000L) == 0x80000000L)
-		trX |= 0xFFFFFFFF00000000L;
-	if ((trY & 0x80000000L) == 0x80000000L)
-		trY |= 0xFFFFFFFF00000000L;
-	if ((trZ & 0x80000000L) == 0x80000000L)
-		trZ |= 0xFFFFFFFF00000000L;
-
-	// Retrieve offset and distance values
-	int64_t ofx = 0xFFFFFFFFL & gte->controlRegisters[24];
-	int64_t ofy = 0xFFFFFFFFL & gte->controlRegisters[25];
-	int64_t h = 0xFFFF & gte->controlRegisters[26];
-	int64_t dqa = 0xFFFF & gte->controlRegisters[27];
-	int64_t dqb = 0xFFFFFFFFL & gte->controlRegisters[28];
-
-	// Sign extend signed values if needed
-	if ((ofx & 0x80000000L) == 0x80000000L)
-		ofx |= 0xFFFFFFFF00000000L;
-	if ((ofy & 0x80000000L) == 0x80000000L)
-		ofy |= 0xFFFFFFFF00000000L;
-	if ((dqa & 0x8000L) == 0x8000L)
-		dqa |= 0xFFFFFFFFFFFF0000L;
-	if ((dqb & 0x80000000L) == 0x80000000L)
-		dqb |= 0xFFFFFFFF00000000L;
-
-	// Do calculation three times, using a different vector
-	// with each iteration
+	// Perform first stage of calculations for all three vectors at once
+	int64_t sums[3][3];
+	Cop2_multiplyMatrix(gte->rotation, gte->translation, gte->vectors, sums);
+
+	// Finish calculation for each vector in turn - the loop is unrolled so
+	// the compiler can drop work whose results the next vector overwrites
+#pragma GCC unroll 3
 	for (int32_t i = 0; i < 3; ++i) {
 
 		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve correct vector values
-		int64_t vxAny = 0, vyAny = 0, vzAny = 0;
-
-		switch (i) {
-			case 0:
-				vxAny =
-					0xFFFF & gte->dataRegisters[0]; // VX0
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-				vzAny =
-					0xFFFF & gte->dataRegisters[1]; // VZ0
-				break;
-			case 1:
-				vxAny =
-					0xFFFF & gte->dataRegisters[2]; // VX1
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-				vzAny =
-					0xFFFF & gte->dataRegisters[3]; // VZ1
-				break;
-			case 2:
-				vxAny =
-					0xFFFF & gte->dataRegisters[4]; // VX2
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-				vzAny =
-					0xFFFF & gte->dataRegisters[5]; // VZ2
-				break;
-		}
-
-
-		// Sign extend vector values if necessary
-		if ((vxAny & 0x8000L) == 0x8000L) {
-			vxAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vyAny & 0x8000L) == 0x8000L) {
-			vyAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vzAny & 0x8000L) == 0x8000L) {
-			vzAny |= 0xFFFFFFFFFFFF0000L;
-		}
-
-		// Perform first stage of calculations
-		int64_t mac1 =
-				trX * 0x1000 + rt11 * vxAny + rt12 * vyAny + rt13 * vzAny;
-		int64_t mac2 =
-				trY * 0x1000 + rt21 * vxAny + rt22 * vyAny + rt23 * vzAny;
-		int64_t mac3 =
-				trZ * 0x1000 + rt31 * vxAny + rt32 * vyAny + rt33 * vzAny;
-
-		// Shift all three results by (sf * 12), preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set MAC1, MAC2 and MAC3 flags as needed
-		// MAC1
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		// MAC2
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		// MAC3
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Set IR1, IR2 and IR3 - dealing with flags too
-		// saturation should be -0x8000..0x7FFF, regardless of lm bit
-		// IR1
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		if (mac1 < -0x8000) {
-			ir1 = -0x8000;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 > 0x7FFF) {
-			ir1 = 0x7FFF;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = (int32_t)mac1;
-		}
-
-		// IR2
-		if (mac2 < -0x8000) {
-			ir2 = -0x8000;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 > 0x7FFF) {
-			ir2 = 0x7FFF;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = (int32_t)mac2;
-		}
-
-		// IR3
-		if (mac3 < -0x8000) {
-			ir3 = -0x8000;
-
-			// Deal with quirk in IR3 flag handling
-			if (sf == 0) {
-				uint64_t u_mac3 = (uint64_t)mac3;
-				bool needsSignExtension = (u_mac3 & 0x8000000000000000UL) ==
-											0x8000000000000000UL;
-				int64_t temp = u_mac3 >> 12;
-				if (needsSignExtension)
-					temp |= 0xFFF0000000000000UL;
-				if (temp > 0x7FFF || temp < -0x8000) {
-					gte->controlRegisters[31] |= 0x400000;
-				}
-			} else {
-				gte->controlRegisters[31] |= 0x400000;
-			}
-		} else if (mac3 > 0x7FFF) {
-			ir3 = 0x7FFF;
-
-			// Deal with quirk in IR3 flag handling
-			if (sf == 0) {
-				int64_t temp = mac3 >> 12;
-				if (temp > 0x7FFF || temp < -0x8000) {
-					gte->controlRegisters[31] |= 0x400000;
-				}
-			} else {
-				gte->controlRegisters[31] |= 0x400000;
-			}
-		} else {
-			ir3 = (int32_t)mac3;
-		}
-
-		// Write back to real registers
-		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-		gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-		gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-		gte->dataRegisters[9] = (int32_t)ir1; // IR1
-		gte->dataRegisters[10] = (int32_t)ir2; // IR2
-		gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-		// Calculate SZ3 and move FIFO along, also setting SZ3 flag if needed
-		gte->dataRegisters[16] = gte->dataRegisters[17]; // SZ1 to SZ0
-		gte->dataRegisters[17] = gte->dataRegisters[18]; // SZ2 to SZ1
-		gte->dataRegisters[18] = gte->dataRegisters[19]; // SZ3 to SZ2
-		uint64_t u_mac3 = (uint64_t)mac3;
-		bool needsSignExtension = (u_mac3 & 0x8000000000000000UL) ==
-									0x8000000000000000UL;
-		int32_t shiftBy = (1 - sf) * 12;
-		int64_t temp_sz3 = u_mac3 >> shiftBy;
-		if (needsSignExtension && shiftBy == 12)
-			temp_sz3 |= 0xFFF0000000000000UL;
-		if (temp_sz3 < 0) {
-			temp_sz3 = 0;
-			gte->controlRegisters[31] |= 0x40000;
-		} else if (temp_sz3 > 0xFFFF) {
-			temp_sz3 = 0xFFFF;
-			gte->controlRegisters[31] |= 0x40000;
-		}
-		gte->dataRegisters[19] = (int32_t)temp_sz3;
-
-		// Begin second phase of calculations - use Unsigned Newton-Raphson
-		// division algorithm from NOPSX documentation
-		int64_t mac0 = 0, sx2 = 0, sy2 = 0, ir0 = 0;
-		int64_t divisionResult = 0;
-		if (h < temp_sz3 * 2) {
-
-			// Count leading zeroes in SZ3
-			int64_t z = 0, temp_sz3_2 = temp_sz3;
-			for (int32_t j = 0; j < 16; ++j) {
-				if ((temp_sz3_2 & 0x8000) == 0) {
-					++z;
-					temp_sz3_2 = temp_sz3_2 << 1;
-				} else {
-					break;
-				}
-			}
-
-			divisionResult = h << z;
-			int64_t d = temp_sz3 << z;
-			int64_t u =
-				unrResults[logical_rshift(((int32_t)d - 0x7FC0), 7)] + 0x101;
-			d = logical_rshift((0x2000080 - (d * u)), 8);
-			d = logical_rshift((0x80 + (d * u)), 8);
-			divisionResult = min_value(0x1FFFFL,
-					logical_rshift(((divisionResult * d) + 0x8000L), 16));
-
-		} else {
-			divisionResult = 0x1FFFFL;
-			gte->controlRegisters[31] |= 0x20000;
-		}
-
-		// Use division result and set MAC0 flags if needed
-		mac0 = divisionResult * ir1 + ofx;
-		if (mac0 > 0x80000000L) {
-			gte->controlRegisters[31] |= 0x10000;
-		} else if (mac0 < -0x80000000L) {
-			gte->controlRegisters[31] |= 0x8000;
-		}
-		mac0 &= 0xFFFFFFFFL;
-		if ((mac0 & 0x80000000L) == 0x80000000L)
-			mac0 |= 0xFFFFFFFF00000000L;
-		sx2 = mac0 / 0x10000;
-		mac0 = divisionResult * ir2 + ofy;
-		if (mac0 > 0x80000000L) {
-			gte->controlRegisters[31] |= 0x10000;
-		} else if (mac0 < -0x80000000L) {
-			gte->controlRegisters[31] |= 0x8000;
-		}
-		mac0 &= 0xFFFFFFFFL;
-		if ((mac0 & 0x80000000L) == 0x80000000L)
-			mac0 |= 0xFFFFFFFF00000000L;
-		sy2 = mac0 / 0x10000;
-		mac0 = divisionResult * dqa + dqb;
-		if (mac0 > 0x80000000L) {
-			gte->controlRegisters[31] |= 0x10000;
-		} else if (mac0 < -0x80000000L) {
-			gte->controlRegisters[31] |= 0x8000;
-		}
-		mac0 &= 0xFFFFFFFFL;
-		if ((mac0 & 0x80000000L) == 0x80000000L)
-			mac0 |= 0xFFFFFFFF00000000L;
-		ir0 = mac0 / 0x1000;
-
-		// Adjust results for saturation and set flags if needed
-		if (sx2 > 0x3FFL) {
-			sx2 = 0x3FFL;
-			gte->controlRegisters[31] |= 0x4000;
-		} else if (sx2 < -0x400) {
-			sx2 = -0x400;
-			gte->controlRegisters[31] |= 0x4000;
-		}
-
-		if (sy2 > 0x3FFL) {
-			sy2 = 0x3FFL;
-			gte->controlRegisters[31] |= 0x2000;
-		} else if (sy2 < -0x400) {
-			sy2 = -0x400;
-			gte->controlRegisters[31] |= 0x2000;
-		}
-
-		if (ir0 < 0) {
-			ir0 = 0;
-			gte->controlRegisters[31] |= 0x1000;
-		} else if (ir0 > 0x1000) {
-			ir0 = 0x1000;
-			gte->controlRegisters[31] |= 0x1000;
-		}
+		int32_t flag = 0;
 
-		// Store values back to correct registers
-		// SXY FIFO registers
-		gte->dataRegisters[12] =
-			gte->dataRegisters[13]; // SXY1 to SXY0
-		gte->dataRegisters[13] =
-			gte->dataRegisters[14]; // SXY2 to SXY1
-		gte->dataRegisters[14] =
-			(((int32_t)sy2 & 0xFFFF) << 16) | ((int32_t)sx2 & 0xFFFF); // SXY2
-		gte->dataRegisters[15] =
-			gte->dataRegisters[14]; // SXYP mirror of SXY2
-
-		// MAC0
-		gte->dataRegisters[24] = (int32_t)mac0;
-
-		// IR0
-		gte->dataRegisters[8] = (int32_t)ir0;
+		// Perform perspective transformation
+		Cop2_transformPerspective(gte, &flag, sums[i], sf);
 
+		// Calculate bit 31 of flag register
+		Cop2_finishFlags(gte, flag);
 	}
-
-	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
 }
 
 /*
@@ -4993,137 +1187,24 @@ static void Cop2_handleRTPT(Cop2 *gte, int32_t opcode)
 static void Cop2_handleGPF(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Define MAC1, MAC2 and MAC3 and set to 0
-	int64_t mac1 = 0, mac2 = 0, mac3 = 0;
-
-	// Retrieve IR0, IR1, IR2 and IR3
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-	int64_t ir1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-	int64_t ir2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-	int64_t ir3 = 0xFFFF & gte->dataRegisters[11]; // IR3
-
-	// Sign extend these four if necessary
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir1 & 0x8000L) == 0x8000L)
-		ir1 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir2 & 0x8000L) == 0x8000L)
-		ir2 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir3 & 0x8000L) == 0x8000L)
-		ir3 |= 0xFFFFFFFFFFFF0000L;
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
 	// Perform calculations
-	mac1 = ((ir1 * ir0) + mac1) >> (sf * 12);
-	mac2 = ((ir2 * ir0) + mac2) >> (sf * 12);
-	mac3 = ((ir3 * ir0) + mac3) >> (sf * 12);
-
-	// Check/set flags for MAC1, MAC2 and MAC3
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store MAC1, MAC2 and MAC3 to IR1, IR2 and IR3
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Fetch code value from RGBC
-	int64_t code = logical_rshift(gte->dataRegisters[6], 24);
-
-	// Calculate colour FIFO entries
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	// Saturate FIFO entries and set flags if needed
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
-
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
+	int64_t mac[3];
+	int16_t ir[3];
+	for (int32_t i = 0; i < 3; ++i)
+		mac[i] = (int64_t)gte->ir[i + 1] * gte->ir[0];
+	Cop2_saturateStage(&flag, mac, sf, lowerBound, ir);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store all values back
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -5132,168 +1213,29 @@ static void Cop2_handleGPF(Cop2 *gte, int32_t opcode)
 static void Cop2_handleGPL(Cop2 *gte, int32_t opcode)
 {
 	// Clear flag register
-	gte->controlRegisters[31] = 0;
+	int32_t flag = 0;
 
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve MAC1, MAC2 and MAC3
-	int64_t mac1 = 0xFFFFFFFFL & gte->dataRegisters[25];
-	int64_t mac2 = 0xFFFFFFFFL & gte->dataRegisters[26];
-	int64_t mac3 = 0xFFFFFFFFL & gte->dataRegisters[27];
-
-	// Sign extend these values if needed
-	if ((mac1 & 0x80000000L) == 0x80000000L)
-		mac1 |= 0xFFFFFFFF00000000L;
-	if ((mac2 & 0x80000000L) == 0x80000000L)
-		mac2 |= 0xFFFFFFFF00000000L;
-	if ((mac3 & 0x80000000L) == 0x80000000L)
-		mac3 |= 0xFFFFFFFF00000000L;
-
-	// Shift these values left by (sf * 12)
-	mac1 = mac1 << (sf * 12);
-	mac2 = mac2 << (sf * 12);
-	mac3 = mac3 << (sf * 12);
-
-	// Check/set flags for MAC1, MAC2 and MAC3
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Retrieve IR0, IR1, IR2 and IR3
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-	int64_t ir1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-	int64_t ir2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-	int64_t ir3 = 0xFFFF & gte->dataRegisters[11]; // IR3
-
-	// Sign extend these four if necessary
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir1 & 0x8000L) == 0x8000L)
-		ir1 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir2 & 0x8000L) == 0x8000L)
-		ir2 |= 0xFFFFFFFFFFFF0000L;
-	if ((ir3 & 0x8000L) == 0x8000L)
-		ir3 |= 0xFFFFFFFFFFFF0000L;
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
 
-	// Perform calculations
-	mac1 = ((ir1 * ir0) + mac1) >> (sf * 12);
-	mac2 = ((ir2 * ir0) + mac2) >> (sf * 12);
-	mac3 = ((ir3 * ir0) + mac3) >> (sf * 12);
-
-	// Check/set flags for MAC1, MAC2 and MAC3 (again)
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Store MAC1, MAC2 and MAC3 to IR1, IR2 and IR3
-	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Fetch code value from RGBC
-	int64_t code = logical_rshift(gte->dataRegisters[6], 24);
-
-	// Calculate colour FIFO entries
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	// Saturate FIFO entries and set flags if needed
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
+	// Retrieve MAC1, MAC2 and MAC3, shifting them left by (sf * 12)
+	int64_t mac[3];
+	for (int32_t i = 0; i < 3; ++i)
+		mac[i] = (int64_t)gte->mac[i + 1] * (sf == 1 ? 0x1000 : 1);
+	Cop2_checkMac(&flag, mac);
 
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
+	// Perform calculations
+	int16_t ir[3];
+	for (int32_t i = 0; i < 3; ++i)
+		mac[i] += (int64_t)gte->ir[i + 1] * gte->ir[0];
+	Cop2_saturateStage(&flag, mac, sf, lowerBound, ir);
+	Cop2_storeColour(gte, &flag, mac, ir);
 
 	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store all values back
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+	Cop2_finishFlags(gte, flag);
 }
 
 /*
@@ -5304,391 +1246,449 @@ static void Cop2_handleNCCT(Cop2 *gte, int32_t opcode)
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Repeat for vectors V0, V1 and V2
+	// Filter out lm bit, which sets the lower bound for saturation
+	int64_t lowerBound = (opcode & 0x400) == 0x400 ? 0 : -0x8000L;
+
+	// Light all three vectors at once
+	int64_t mac[3][3];
+	int32_t flags[3];
+	Cop2_lightVectors(gte, sf, lowerBound, mac, flags);
+
+	// Finish calculation for each vector in turn - the loop is unrolled so
+	// the compiler can drop work whose results the next vector overwrites
+#pragma GCC unroll 3
 	for (int32_t i = 0; i < 3; ++i) {
 
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve Vx values
-		int64_t vxAny = 0, vyAny = 0, vzAny = 0;
-		switch (i) {
-			case 0:
-				vxAny =
-					0xFFFF & gte->dataRegisters[0]; // VX0
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-				vzAny =
-					0xFFFF & gte->dataRegisters[1]; // VZ0
-				break;
-			case 1:
-				vxAny =
-					0xFFFF & gte->dataRegisters[2]; // VX1
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-				vzAny =
-					0xFFFF & gte->dataRegisters[3]; // VZ1
-				break;
-			case 2:
-				vxAny =
-					0xFFFF & gte->dataRegisters[4]; // VX2
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-				vzAny =
-					0xFFFF & gte->dataRegisters[5]; // VZ2
-				break;
-		}
+		// Restore flag register from first stage
+		int32_t flag = flags[i];
 
-		// Sign extend V0 values if necessary
-		if ((vxAny & 0x8000L) == 0x8000L) {
-			vxAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vyAny & 0x8000L) == 0x8000L) {
-			vyAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vzAny & 0x8000L) == 0x8000L) {
-			vzAny |= 0xFFFFFFFFFFFF0000L;
-		}
+		// Saturate lighting, then apply RGBC
+		int16_t ir[3];
+		Cop2_saturateStage(&flag, mac[i], sf, lowerBound, ir);
+		Cop2_multiplyColour(gte, &flag, ir, mac[i]);
+		Cop2_saturateStage(&flag, mac[i], sf, lowerBound, ir);
+		Cop2_storeColour(gte, &flag, mac[i], ir);
 
-		// Perform first stage of calculation
-		int64_t mac1 = l11 * vxAny + l12 * vyAny + l13 * vzAny;
-		int64_t mac2 = l21 * vxAny + l22 * vyAny + l23 * vzAny;
-		int64_t mac3 = l31 * vxAny + l32 * vyAny + l33 * vzAny;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
+		// Calculate bit 31 of flag register
+		Cop2_finishFlags(gte, flag);
+	}
+}
 
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
+/*
+ * This function sets the MAC1, MAC2 and MAC3 overflow bits in flag for a set
+ * of results.
+ */
+COP2_HELPER void Cop2_checkMac(int32_t *flag, const int64_t *mac)
+{
+#pragma GCC unroll 3
+	for (int32_t i = 0; i < 3; ++i) {
+		*flag |= (mac[i] > 0x80000000000L) ? 0x40000000 >> i : 0;
+		*flag |= (mac[i] < -0x80000000000L) ? 0x8000000 >> i : 0;
+	}
+}
 
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+/*
+ * This function sets the MAC0 overflow bits in flag for a result.
+ */
+COP2_HELPER void Cop2_checkMac0(int32_t *flag, int64_t mac0)
+{
+	*flag |= (mac0 > 0x80000000L) ? 0x10000 : 0;
+	*flag |= (mac0 < -0x80000000L) ? 0x8000 : 0;
+}
 
-		// Setup IR1, IR2 and IR3
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
+/*
+ * This function stores the flags worked out by a handler to the flag
+ * register, along with bit 31 which is set if any of the error flags are.
+ * Handlers build their flags in a local so they can stay in a register.
+ */
+COP2_HELPER void Cop2_finishFlags(Cop2 *gte, int32_t flag)
+{
+	gte->flag = flag | (((flag & 0x7F87E000) != 0) ? INT32_MIN : 0);
+}
 
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
+/*
+ * This function interpolates a colour in MAC1, MAC2 and MAC3 towards the far
+ * colour by IR0, leaving the shifted results in mac and their saturated
+ * values in ir. The intermediate results are saturated without regard to the
+ * lm bit.
+ */
+COP2_HELPER void Cop2_interpolateColour(Cop2 *gte, int32_t *flag,
+		int64_t *mac, int16_t *ir, int32_t sf, int64_t lowerBound)
+{
+#pragma GCC unroll 3
+	for (int32_t i = 0; i < 3; ++i) {
+		int64_t difference = (((int64_t)gte->farColour[i] * 0x1000) -
+				mac[i]) >> (sf * 12);
+		ir[i] = Cop2_saturate(flag, difference, -0x8000, 0x7FFF,
+				0x1000000 >> i);
+		mac[i] += (int64_t)ir[i] * gte->ir[0];
+	}
+	Cop2_checkMac(flag, mac);
+	Cop2_saturateStage(flag, mac, sf, lowerBound, ir);
+}
 
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
+/*
+ * This function performs the two lighting stages for V0 - the light matrix,
+ * then the light colour matrix and background colour - leaving the results
+ * of the second in mac and their saturated values in ir.
+ */
+COP2_HELPER void Cop2_lightVector(Cop2 *gte, int32_t *flag, int32_t sf,
+		int64_t lowerBound, int64_t *mac, int16_t *ir)
+{
+	Cop2_multiplyVector(gte->light, noTranslation, gte->vectors[0], mac);
+	Cop2_saturateStage(flag, mac, sf, lowerBound, ir);
+	Cop2_multiplyVector(gte->colour, gte->background, ir, mac);
+	Cop2_saturateStage(flag, mac, sf, lowerBound, ir);
+}
 
-		// Perform second stage of calculation
-		mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-		mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-		mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3 (again)
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
+/*
+ * This function performs the two lighting stages for V0, V1 and V2 at once,
+ * leaving the unshifted results of the second stage in mac. As each vector
+ * starts with a clear flag register, the flags from the first stage are kept
+ * for each vector in flags.
+ */
+COP2_HELPER void Cop2_lightVectors(Cop2 *gte, int32_t sf,
+		int64_t lowerBound, int64_t (*mac)[3], int32_t *flags)
+{
+	// Perform first stage, saturating the results for each vector
+	int64_t results[3][3];
+	int16_t intensities[3][3];
+	Cop2_multiplyMatrix(gte->light, noTranslation, gte->vectors, results);
+#pragma GCC unroll 3
+	for (int32_t i = 0; i < 3; ++i) {
+		flags[i] = 0;
+		Cop2_saturateStage(&flags[i], results[i], sf, lowerBound,
+				intensities[i]);
+	}
 
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
+	// Perform second stage
+	Cop2_multiplyMatrix(gte->colour, gte->background, intensities, mac);
+}
 
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+/*
+ * This function multiplies RGBC by IR1, IR2 and IR3, shifting the results
+ * left by four bits into mac and checking them for overflow.
+ */
+COP2_HELPER void Cop2_multiplyColour(Cop2 *gte, int32_t *flag,
+		const int16_t *ir, int64_t *mac)
+{
+	for (int32_t i = 0; i < 3; ++i)
+		mac[i] = ((int64_t)gte->rgbc[i] * ir[i]) << 4;
+	Cop2_checkMac(flag, mac);
+}
 
-		// Setup IR1, IR2 and IR3 (again)
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
+/*
+ * This function multiplies three vectors by a matrix and adds the
+ * translation (shifted left by 12 bits) to each, storing the unshifted sums
+ * in results - results[n] being the MAC1, MAC2 and MAC3 values for vector n.
+ * As elements are 16 bits, each product fits in 32, so the three vectors are
+ * worked on in parallel lanes where the host allows it, widening to 64 bits
+ * for the sums.
+ */
+COP2_HELPER void Cop2_multiplyMatrix(const int16_t (*matrix)[3],
+		const int32_t *translation, const int16_t (*vectors)[3],
+		int64_t (*results)[3])
+{
+	for (int32_t row = 0; row < 3; ++row) {
+		const int16_t *elements = matrix[row];
+		int64_t base = (int64_t)translation[row] * 0x1000;
+#if defined(__AVX2__) || defined(__SSE4_1__)
+		__m128i products1 = _mm_mullo_epi32(_mm_set1_epi32(elements[0]),
+				_mm_setr_epi32(vectors[0][0], vectors[1][0], vectors[2][0], 0));
+		__m128i products2 = _mm_mullo_epi32(_mm_set1_epi32(elements[1]),
+				_mm_setr_epi32(vectors[0][1], vectors[1][1], vectors[2][1], 0));
+		__m128i products3 = _mm_mullo_epi32(_mm_set1_epi32(elements[2]),
+				_mm_setr_epi32(vectors[0][2], vectors[1][2], vectors[2][2], 0));
+		int64_t sums[4];
+#if defined(__AVX2__)
+		__m256i sum = _mm256_add_epi64(_mm256_set1_epi64x(base),
+				_mm256_cvtepi32_epi64(products1));
+		sum = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(products2));
+		sum = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(products3));
+		_mm256_storeu_si256((__m256i *)sums, sum);
+#else
+		__m128i low = _mm_add_epi64(_mm_set1_epi64x(base),
+				_mm_cvtepi32_epi64(products1));
+		low = _mm_add_epi64(low, _mm_cvtepi32_epi64(products2));
+		low = _mm_add_epi64(low, _mm_cvtepi32_epi64(products3));
+		__m128i high = _mm_add_epi64(_mm_set1_epi64x(base),
+				_mm_cvtepi32_epi64(_mm_srli_si128(products1, 8)));
+		high = _mm_add_epi64(high,
+				_mm_cvtepi32_epi64(_mm_srli_si128(products2, 8)));
+		high = _mm_add_epi64(high,
+				_mm_cvtepi32_epi64(_mm_srli_si128(products3, 8)));
+		_mm_storeu_si128((__m128i *)sums, low);
+		_mm_storeu_si128((__m128i *)(sums + 2), high);
+#endif
+		results[0][row] = sums[0];
+		results[1][row] = sums[1];
+		results[2][row] = sums[2];
+#elif defined(__ARM_NEON)
+		const int32_t lanes1[4] = {vectors[0][0], vectors[1][0],
+				vectors[2][0], 0};
+		const int32_t lanes2[4] = {vectors[0][1], vectors[1][1],
+				vectors[2][1], 0};
+		const int32_t lanes3[4] = {vectors[0][2], vectors[1][2],
+				vectors[2][2], 0};
+		int32x4_t products1 = vmulq_n_s32(vld1q_s32(lanes1), elements[0]);
+		int32x4_t products2 = vmulq_n_s32(vld1q_s32(lanes2), elements[1]);
+		int32x4_t products3 = vmulq_n_s32(vld1q_s32(lanes3), elements[2]);
+		int64x2_t low = vaddw_s32(vdupq_n_s64(base), vget_low_s32(products1));
+		low = vaddw_s32(low, vget_low_s32(products2));
+		low = vaddw_s32(low, vget_low_s32(products3));
+		int64x2_t high = vaddw_s32(vdupq_n_s64(base),
+				vget_high_s32(products1));
+		high = vaddw_s32(high, vget_high_s32(products2));
+		high = vaddw_s32(high, vget_high_s32(products3));
+		int64_t sums[4];
+		vst1q_s64(sums, low);
+		vst1q_s64(sums + 2, high);
+		results[0][row] = sums[0];
+		results[1][row] = sums[1];
+		results[2][row] = sums[2];
+#else
+		for (int32_t i = 0; i < 3; ++i)
+			results[i][row] = base +
+					(int64_t)elements[0] * vectors[i][0] +
+					(int64_t)elements[1] * vectors[i][1] +
+					(int64_t)elements[2] * vectors[i][2];
+#endif
+	}
+}
 
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
+/*
+ * This function multiplies a single vector by a matrix and adds the
+ * translation (shifted left by 12 bits), storing the unshifted sums in
+ * result.
+ */
+COP2_HELPER void Cop2_multiplyVector(const int16_t (*matrix)[3],
+		const int32_t *translation, const int16_t *vector, int64_t *result)
+{
+#pragma GCC unroll 3
+	for (int32_t row = 0; row < 3; ++row)
+		result[row] = (int64_t)translation[row] * 0x1000 +
+				(int64_t)matrix[row][0] * vector[0] +
+				(int64_t)matrix[row][1] * vector[1] +
+				(int64_t)matrix[row][2] * vector[2];
+}
 
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
+/*
+ * This function packs a colour into a word, red in the lowest byte.
+ */
+COP2_HELPER int32_t Cop2_packColour(const uint8_t *colour)
+{
+	return (int32_t)((uint32_t)colour[0] | ((uint32_t)colour[1] << 8) |
+			((uint32_t)colour[2] << 16) | ((uint32_t)colour[3] << 24));
+}
 
-		// Perform first NCCx stage calculation
-		mac1 = r * ir1;
-		mac2 = g * ir2;
-		mac3 = b * ir3;
-
-		// Shift results left by four bits
-		mac1 = mac1 << 4;
-		mac2 = mac2 << 4;
-		mac3 = mac3 << 4;
-
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
+/*
+ * This function packs one of the five words holding a matrix - each holds
+ * two elements in row order, low half first, apart from the last which holds
+ * only the ninth element, sign extended.
+ */
+COP2_HELPER int32_t Cop2_packMatrix(const int16_t (*matrix)[3],
+		int32_t index)
+{
+	int32_t element = index * 2;
+	if (index == 4)
+		return matrix[2][2];
+	return Cop2_packPair((const int16_t[]){matrix[element / 3][element % 3],
+			matrix[(element + 1) / 3][(element + 1) % 3]});
+}
 
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
+/*
+ * This function packs a pair of 16-bit values into a word, the first in the
+ * low half.
+ */
+COP2_HELPER int32_t Cop2_packPair(const int16_t *pair)
+{
+	return (int32_t)((uint32_t)(uint16_t)pair[0] |
+			((uint32_t)(uint16_t)pair[1] << 16));
+}
 
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+/*
+ * This function clamps value to the range min..max, setting bits in flag if
+ * it was out of range. It is written to compile to conditional moves
+ * rather than branches.
+ */
+COP2_HELPER int64_t Cop2_saturate(int32_t *flag, int64_t value,
+		int64_t min, int64_t max, int32_t bits)
+{
+	int64_t result = (value < min) ? min : value;
+	result = (result > max) ? max : result;
+	*flag |= (result != value) ? bits : 0;
+	return result;
+}
 
-		// Perform second NCCx stage calculation,
-		// shifting MAC1, MAC2 and MAC3 by (sf * 12), and preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
+/*
+ * This function finishes a stage of calculation, shifting MAC1, MAC2 and
+ * MAC3 right by (sf * 12) bits and checking them for overflow, before
+ * saturating them into ir between lowerBound and 0x7FFF.
+ */
+COP2_HELPER void Cop2_saturateStage(int32_t *flag, int64_t *mac,
+		int32_t sf, int64_t lowerBound, int16_t *ir)
+{
+	for (int32_t i = 0; i < 3; ++i)
+		mac[i] >>= sf * 12;
+	Cop2_checkMac(flag, mac);
+#pragma GCC unroll 3
+	for (int32_t i = 0; i < 3; ++i)
+		ir[i] = Cop2_saturate(flag, mac[i], lowerBound, 0x7FFF,
+				0x1000000 >> i);
+}
 
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
+/*
+ * This function stores the results of a colour calculation, pushing the
+ * saturated colour onto the colour FIFO along with the CODE value from
+ * RGBC.
+ */
+COP2_HELPER void Cop2_storeColour(Cop2 *gte, int32_t *flag,
+		const int64_t *mac, const int16_t *ir)
+{
+	// Generate colour FIFO values, setting flags as needed
+	uint8_t colour[4];
+#pragma GCC unroll 3
+	for (int32_t i = 0; i < 3; ++i)
+		colour[i] = Cop2_saturate(flag, mac[i] / 16, 0, 0xFF, 0x200000 >> i);
+	colour[3] = gte->rgbc[3];
 
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+	// Store all values back
+	Cop2_storeResults(gte, mac, ir);
+	memcpy(gte->rgb[0], gte->rgb[1], sizeof(gte->rgb[0])); // RGB1 to RGB0
+	memcpy(gte->rgb[1], gte->rgb[2], sizeof(gte->rgb[1])); // RGB2 to RGB1
+	memcpy(gte->rgb[2], colour, sizeof(gte->rgb[2])); // RGB2
+}
 
-		// Store results back to IR1, IR2 and IR3
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
+/*
+ * This function stores MAC1, MAC2 and MAC3 and IR1, IR2 and IR3.
+ */
+COP2_HELPER void Cop2_storeResults(Cop2 *gte, const int64_t *mac,
+		const int16_t *ir)
+{
+	for (int32_t i = 0; i < 3; ++i) {
+		gte->mac[i + 1] = (int32_t)mac[i];
+		gte->ir[i + 1] = ir[i];
+	}
+}
 
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
+/*
+ * This function performs the perspective transformation for one vector,
+ * given the unshifted sums from the rotation stage, pushing the results onto
+ * the screen XY and Z FIFOs.
+ */
+COP2_HELPER void Cop2_transformPerspective(Cop2 *gte, int32_t *flag,
+		const int64_t *sums, int32_t sf)
+{
+	// Shift all three results by (sf * 12), preserving sign bit, and set
+	// MAC1, MAC2 and MAC3 flags as needed
+	int64_t mac[3];
+	for (int32_t i = 0; i < 3; ++i)
+		mac[i] = sums[i] >> (sf * 12);
+	Cop2_checkMac(flag, mac);
+
+	// Set IR1, IR2 and IR3 - saturation should be -0x8000..0x7FFF,
+	// regardless of lm bit. Due to a quirk, the IR3 flag is set from the
+	// unshifted result shifted right by 12 bits whatever the sf bit
+	int16_t ir[3];
+	ir[0] = Cop2_saturate(flag, mac[0], -0x8000, 0x7FFF, 0x1000000);
+	ir[1] = Cop2_saturate(flag, mac[1], -0x8000, 0x7FFF, 0x800000);
+	ir[2] = Cop2_saturate(flag, mac[2], -0x8000, 0x7FFF, 0);
+	Cop2_saturate(flag, sums[2] >> 12, -0x8000, 0x7FFF, 0x400000);
+	Cop2_storeResults(gte, mac, ir);
+
+	// Calculate SZ3 from the same value and move FIFO along, also setting
+	// SZ3 flag if needed
+	int64_t sz3 = Cop2_saturate(flag, sums[2] >> 12, 0, 0xFFFF, 0x40000);
+	gte->sz[0] = gte->sz[1]; // SZ1 to SZ0
+	gte->sz[1] = gte->sz[2]; // SZ2 to SZ1
+	gte->sz[2] = gte->sz[3]; // SZ3 to SZ2
+	gte->sz[3] = (uint16_t)sz3;
 
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
+	// Begin second phase of calculations - use Unsigned Newton-Raphson
+	// division algorithm from NOPSX documentation
+	int64_t h = gte->h;
+	int64_t divisionResult = 0;
+	if (h < sz3 * 2) {
 
-		// Calculate result to be stored to colour FIFO
-		int64_t rOut = mac1 / 16;
-		int64_t gOut = mac2 / 16;
-		int64_t bOut = mac3 / 16;
-
-		// Check values and saturate + set flags if needed
-		if (rOut < 0) {
-			rOut = 0;
-			gte->controlRegisters[31] |= 0x200000;
-		} else if (rOut > 0xFF) {
-			rOut = 0xFF;
-			gte->controlRegisters[31] |= 0x200000;
-		}
+		// Count leading zeroes in SZ3
+		int64_t z = 0;
+		while (z < 16 && ((sz3 << z) & 0x8000) == 0)
+			++z;
 
-		if (gOut < 0) {
-			gOut = 0;
-			gte->controlRegisters[31] |= 0x100000;
-		} else if (gOut > 0xFF) {
-			gOut = 0xFF;
-			gte->controlRegisters[31] |= 0x100000;
-		}
+		divisionResult = h << z;
+		int64_t d = sz3 << z;
+		int64_t u =
+				unrResults[logical_rshift(((int32_t)d - 0x7FC0), 7)] + 0x101;
+		d = logical_rshift((0x2000080 - (d * u)), 8);
+		d = logical_rshift((0x80 + (d * u)), 8);
+		divisionResult = min_value(0x1FFFFL,
+				logical_rshift(((divisionResult * d) + 0x8000L), 16));
 
-		if (bOut < 0) {
-			bOut = 0;
-			gte->controlRegisters[31] |= 0x80000;
-		} else if (bOut > 0xFF) {
-			bOut = 0xFF;
-			gte->controlRegisters[31] |= 0x80000;
-		}
+	} else {
+		divisionResult = 0x1FFFFL;
+		*flag |= 0x20000;
+	}
 
-		// Calculate and set flag bit 31
-		if ((gte->controlRegisters[31] & 0x7F87E000) != 0) {
-			gte->controlRegisters[31] |= 0x80000000;
-		}
+	// Use division result and set MAC0 flags if needed, each result being
+	// truncated to 32 bits
+	int64_t mac0 = divisionResult * ir[0] + gte->ofx;
+	Cop2_checkMac0(flag, mac0);
+	int64_t sx2 = (int32_t)mac0 / 0x10000;
+	mac0 = divisionResult * ir[1] + gte->ofy;
+	Cop2_checkMac0(flag, mac0);
+	int64_t sy2 = (int32_t)mac0 / 0x10000;
+	mac0 = divisionResult * gte->dqa + gte->dqb;
+	Cop2_checkMac0(flag, mac0);
+	int64_t ir0 = (int32_t)mac0 / 0x1000;
 
-		// Store all values back
-		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-		gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-		gte->dataRegisters[27] = (int32_t)mac3; // MAC3
+	// Adjust results for saturation and set flags if needed
+	sx2 = Cop2_saturate(flag, sx2, -0x400, 0x3FF, 0x4000);
+	sy2 = Cop2_saturate(flag, sy2, -0x400, 0x3FF, 0x2000);
+	ir0 = Cop2_saturate(flag, ir0, 0, 0x1000, 0x1000);
+
+	// Store values back to correct registers, moving SXY FIFO along
+	memcpy(gte->sxy[0], gte->sxy[1], sizeof(gte->sxy[0])); // SXY1 to SXY0
+	memcpy(gte->sxy[1], gte->sxy[2], sizeof(gte->sxy[1])); // SXY2 to SXY1
+	gte->sxy[2][0] = (int16_t)sx2;
+	gte->sxy[2][1] = (int16_t)sy2;
+	gte->mac[0] = (int32_t)mac0;
+	gte->ir[0] = (int16_t)ir0;
+}
 
-		gte->dataRegisters[9] = (int32_t)ir1; // IR1
-		gte->dataRegisters[10] = (int32_t)ir2; // IR2
-		gte->dataRegisters[11] = (int32_t)ir3; // IR3
+/*
+ * This function unpacks a word into a colour, red in the lowest byte.
+ */
+COP2_HELPER void Cop2_unpackColour(uint8_t *colour, int32_t value)
+{
+	colour[0] = (uint8_t)value;
+	colour[1] = (uint8_t)logical_rshift(value, 8);
+	colour[2] = (uint8_t)logical_rshift(value, 16);
+	colour[3] = (uint8_t)logical_rshift(value, 24);
+}
 
-		gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-		gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-		gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
-	}
+/*
+ * This function unpacks one of the five words holding a matrix, as laid out
+ * for Cop2_packMatrix.
+ */
+COP2_HELPER void Cop2_unpackMatrix(int16_t (*matrix)[3], int32_t index,
+		int32_t value)
+{
+	int32_t element = index * 2;
+	if (index == 4) {
+		matrix[2][2] = (int16_t)value;
+		return;
+	}
+	matrix[element / 3][element % 3] = (int16_t)value;
+	matrix[(element + 1) / 3][(element + 1) % 3] =
+			(int16_t)logical_rshift(value, 16);
+}
+
+/*
+ * This function unpacks a word into a pair of 16-bit values, the low half
+ * first.
+ */
+COP2_HELPER void Cop2_unpackPair(int16_t *pair, int32_t value)
+{
+	pair[0] = (int16_t)value;
+	pair[1] = (int16_t)logical_rshift(value, 16);
 }
\ No newline at end of file
@@ -3,21 +3,35 @@
  * mimic DMA behaviour of the real hardware closely. This is useful for getting
  * things into and out of various hardware like the GPU. It doesn't use a PIO
  * channel as no software actually uses it, but the constant is defined for
- * consistency.
+ * consistency. Data is moved the moment a transfer starts, while the CPU is
+ * held off the bus for as long as the transfer would take, and the transfer
+ * only finishes once that time has passed.
  * 
  * DMAArbiter.c - Copyright Phillip Potter, 2020, under GPLv3
  */
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "../headers/DMAArbiter.h"
 #include "../headers/CDROMDrive.h"
 #include "../headers/R3051.h"
 #include "../headers/GPU.h"
+#include "../headers/MDEC.h"
+#include "../headers/PerfCounters.h"
+#include "../headers/SaveState.h"
+#include "../headers/SPU.h"
 #include "../headers/SystemInterlink.h"
+#include "../headers/TraceEvents.h"
 #include "../headers/Cop0_public.h"
 #include "../headers/Components.h"
+#include "../headers/endian_utils.h"
 #include "../headers/math_utils.h"
 
 // Constant for number of DMA channels
@@ -34,10 +48,27 @@
 
 // Forward declarations for functions private to this class
 // DMAArbiter-related stuff:
+static void DMAArbiter_decodeChannelControl(DMAArbiter *dma,
+		int32_t channel);
+static void DMAArbiter_decodeControlRegister(DMAArbiter *dma);
+static void DMAArbiter_fillOrderingTable(int8_t *ram, int32_t lowestAddress,
+		int32_t numberOfWords);
 static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma);
 static void DMAArbiter_handleDMATransactions(DMAArbiter *dma);
 static int32_t DMAArbiter_handleGPU(DMAArbiter *dma);
+static int32_t DMAArbiter_handleMDEC(DMAArbiter *dma, int32_t channel);
 static int32_t DMAArbiter_handleOTC(DMAArbiter *dma);
+static int32_t DMAArbiter_handleSPU(DMAArbiter *dma);
+static int32_t DMAArbiter_readRegisterByte(void *component, int32_t address);
+static int32_t DMAArbiter_readRegisterHalfWord(void *component,
+		int32_t address);
+static int32_t DMAArbiter_readRegisterWord(void *component, int32_t address);
+static void DMAArbiter_writeRegisterByte(void *component, int32_t address,
+		int32_t value);
+static void DMAArbiter_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value);
+static void DMAArbiter_writeRegisterWord(void *component, int32_t address,
+		int32_t value);
 
 /*
  * This struct contains the state to model DMA transfers
@@ -51,7 +82,9 @@ struct DMAArbiter {
 	// Store device references
 	R3051 *cpu;
 	GPU *gpu;
+	SPU *spu;
 	CDROMDrive *cdrom;
+	MDEC *mdec;
 
 	// Global DMA registers
 	int32_t dmaControlRegister;
@@ -59,6 +92,16 @@ struct DMAArbiter {
 
 	// Per-channel registers
 	int32_t channelRegisters[3 * PHILPSX_DMA_CHANNEL_COUNT];
+
+	// The registers decoded whenever they are written - a bit for each
+	// channel that has a transfer requested, a bit for each channel that is
+	// enabled, and the priority of each channel
+	int32_t startedChannels;
+	int32_t enabledChannels;
+	int32_t channelPriority[PHILPSX_DMA_CHANNEL_COUNT];
+
+	// Channel whose transfer hasn't finished yet, or -1 if there isn't one
+	int32_t activeChannel;
 };
 
 /*
@@ -80,12 +123,20 @@ DMAArbiter *construct_DMAArbiter(void)
 	// Setup other registers
 	dma->dmaControlRegister = 0;
 	dma->dmaInterruptRegister = 0;
+
+	// Decode registers, with no transfer in progress
+	for (int32_t i = 0; i < PHILPSX_DMA_CHANNEL_COUNT; ++i)
+		DMAArbiter_decodeChannelControl(dma, i);
+	DMAArbiter_decodeControlRegister(dma);
+	dma->activeChannel = -1;
 	
 	// Set all component references to NULL
 	dma->system = NULL;
 	dma->cpu = NULL;
 	dma->gpu = NULL;
+	dma->spu = NULL;
 	dma->cdrom = NULL;
+	dma->mdec = NULL;
 	
 	// Normal return:
 	return dma;
@@ -103,6 +154,58 @@ void destruct_DMAArbiter(DMAArbiter *dma)
 	free(dma);
 }
 
+/*
+ * This function finishes the transfer in progress once the time it takes
+ * has passed, raising its interrupt if it is enabled and then starting
+ * whichever transfer is due next. It is called by the system's scheduler.
+ */
+void DMAArbiter_completeTransfer(DMAArbiter *dma)
+{
+	int32_t channel = dma->activeChannel;
+	if (channel == -1)
+		return;
+	dma->activeChannel = -1;
+
+	// Clear bit 24 of channel control register
+	dma->channelRegisters[channel * 3 + 2] &= 0xFEFFFFFF;
+	DMAArbiter_decodeChannelControl(dma, channel);
+
+	// Trigger interrupt by masking correct bit
+	int32_t tempInterruptRegister = dma->dmaInterruptRegister;
+	int32_t intMask = 0x00010000 << channel;
+	intMask |= 0x00800000;
+
+	if ((tempInterruptRegister & intMask) == intMask) {
+		intMask = 0x01000000 << channel;
+		tempInterruptRegister |= intMask;
+		dma->dmaInterruptRegister = tempInterruptRegister;
+
+		// Set flag in system's Interrupt Status Register
+		SystemInterlink_setDMAInterruptDelay(dma->system, 0);
+	}
+
+	// Start any transfer that was held back by this one, such as MDECout
+	// waiting for what MDECin just decoded
+	DMAArbiter_handleDMATransactions(dma);
+}
+
+/*
+ * This function reads the DMA registers back from a save state, decoding
+ * them again afterwards.
+ */
+void DMAArbiter_loadState(DMAArbiter *dma, SaveState *state)
+{
+	SaveState_read(state, &dma->dmaControlRegister, sizeof(int32_t));
+	SaveState_read(state, &dma->dmaInterruptRegister, sizeof(int32_t));
+	SaveState_read(state, dma->channelRegisters,
+			sizeof(dma->channelRegisters));
+	SaveState_read(state, &dma->activeChannel, sizeof(int32_t));
+
+	for (int32_t i = 0; i < PHILPSX_DMA_CHANNEL_COUNT; ++i)
+		DMAArbiter_decodeChannelControl(dma, i);
+	DMAArbiter_decodeControlRegister(dma);
+}
+
 /*
  * This function reads bytes from the DMA Arbiter.
  */
@@ -116,8 +219,7 @@ int8_t DMAArbiter_readByte(DMAArbiter *dma, int32_t address)
 	int32_t tempWord = DMAArbiter_readWord(dma, wordAddress);
 
 	// Return correct byte of word
-	int8_t tempByte =
-			(int8_t)logical_rshift(tempWord, ((~byteIndex & 0x3) * 8));
+	int8_t tempByte = (int8_t)logical_rshift(tempWord, (byteIndex * 8));
 	return tempByte;
 }
 
@@ -210,7 +312,7 @@ int32_t DMAArbiter_readWord(DMAArbiter *dma, int32_t address)
 			break;
 		case 0xE8:
 			// Impose additional restrictions on DMA6 control register
-			retVal |= 0x02000000;
+			retVal |= 0x2;
 			retVal = dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2];
 			break;
 
@@ -220,10 +322,6 @@ int32_t DMAArbiter_readWord(DMAArbiter *dma, int32_t address)
 			break;
 		case 0xF4:
 			retVal = dma->dmaInterruptRegister;
-			retVal = ((retVal << 24) & 0xFF000000) |
-					((retVal << 8) & 0xFF0000) |
-					(logical_rshift(retVal, 8) & 0xFF00) |
-					(logical_rshift(retVal, 24) & 0xFF);
 			int32_t tempInt = (retVal & 0x800000) |	(
 					(retVal & 0x7F0000) &
 					logical_rshift((retVal & 0x7F000000), 8)
@@ -233,16 +331,26 @@ int32_t DMAArbiter_readWord(DMAArbiter *dma, int32_t address)
 			} else {
 				retVal &= 0x7FFFFFFF;
 			}
-			retVal = ((retVal << 24) & 0xFF000000) |
-					((retVal << 8) & 0xFF0000) |
-					(logical_rshift(retVal, 8) & 0xFF00) |
-					(logical_rshift(retVal, 24) & 0xFF);
 			break;
 	}
 
 	return retVal;
 }
 
+/*
+ * This function writes the DMA registers to a save state, along with the
+ * channel whose transfer is still to finish. Its data has already been
+ * moved, and the system's scheduler records when it will finish.
+ */
+void DMAArbiter_saveState(DMAArbiter *dma, SaveState *state)
+{
+	SaveState_write(state, &dma->dmaControlRegister, sizeof(int32_t));
+	SaveState_write(state, &dma->dmaInterruptRegister, sizeof(int32_t));
+	SaveState_write(state, dma->channelRegisters,
+			sizeof(dma->channelRegisters));
+	SaveState_write(state, &dma->activeChannel, sizeof(int32_t));
+}
+
 /*
  * This function sets the CD-ROM reference.
  */
@@ -267,12 +375,39 @@ void DMAArbiter_setGpu(DMAArbiter *dma, GPU *gpu)
 	dma->gpu = gpu;
 }
 
+/*
+ * This function sets the MDEC reference to that of the supplied argument.
+ */
+void DMAArbiter_setMdec(DMAArbiter *dma, MDEC *mdec)
+{
+	dma->mdec = mdec;
+}
+
 /*
  * This function sets the system reference to that of the supplied argument.
  */
 void DMAArbiter_setMemoryInterface(DMAArbiter *dma, SystemInterlink *smi)
 {
 	dma->system = smi;
+
+	// Install handlers for the DMA registers
+	SystemInterlink_registerIoHandlers(smi, 0x1F801080, 0x80,
+			PHILPSX_IO_BYTE, dma, DMAArbiter_readRegisterByte,
+			DMAArbiter_writeRegisterByte);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801080, 0x80,
+			PHILPSX_IO_HALFWORD, dma, DMAArbiter_readRegisterHalfWord,
+			DMAArbiter_writeRegisterHalfWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801080, 0x80,
+			PHILPSX_IO_WORD, dma, DMAArbiter_readRegisterWord,
+			DMAArbiter_writeRegisterWord);
+}
+
+/*
+ * This function sets the SPU reference.
+ */
+void DMAArbiter_setSpu(DMAArbiter *dma, SPU *spu)
+{
+	dma->spu = spu;
 }
 
 /*
@@ -288,10 +423,10 @@ void DMAArbiter_writeByte(DMAArbiter *dma, int32_t address, int8_t value)
 	int32_t tempWord = DMAArbiter_readWord(dma, wordAddress);
 
 	// Mask out byte we are writing
-	tempWord &= ~(0xFF << ((~byteIndex & 0x3) * 8));
+	tempWord &= ~(0xFF << (byteIndex * 8));
 
 	// Merge in our byte
-	tempWord |= (value & 0xFF) << ((~byteIndex & 0x3) * 8);
+	tempWord |= (value & 0xFF) << (byteIndex * 8);
 
 	// Write word back
 	DMAArbiter_writeWord(dma, wordAddress, tempWord);
@@ -317,6 +452,7 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			break;
 		case 0x88:
 			dma->channelRegisters[PHILPSX_DMA_MDEC_IN * 3 + 2] = word;
+			DMAArbiter_decodeChannelControl(dma, PHILPSX_DMA_MDEC_IN);
 			DMAArbiter_handleDMATransactions(dma);
 			break;
 
@@ -329,6 +465,7 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			break;
 		case 0x98:
 			dma->channelRegisters[PHILPSX_DMA_MDEC_OUT * 3 + 2] = word;
+			DMAArbiter_decodeChannelControl(dma, PHILPSX_DMA_MDEC_OUT);
 			DMAArbiter_handleDMATransactions(dma);
 			break;
 
@@ -341,6 +478,7 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			break;
 		case 0xA8:
 			dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 2] = word;
+			DMAArbiter_decodeChannelControl(dma, PHILPSX_DMA_GPU);
 			DMAArbiter_handleDMATransactions(dma);
 			break;
 
@@ -353,6 +491,7 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			break;
 		case 0xB8:
 			dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 2] = word;
+			DMAArbiter_decodeChannelControl(dma, PHILPSX_DMA_CDROM);
 			DMAArbiter_handleDMATransactions(dma);
 			break;
 
@@ -365,6 +504,7 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			break;
 		case 0xC8:
 			dma->channelRegisters[PHILPSX_DMA_SPU * 3 + 2] = word;
+			DMAArbiter_decodeChannelControl(dma, PHILPSX_DMA_SPU);
 			DMAArbiter_handleDMATransactions(dma);
 			break;
 
@@ -377,6 +517,7 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			break;
 		case 0xD8:
 			dma->channelRegisters[PHILPSX_DMA_PIO * 3 + 2] = word;
+			DMAArbiter_decodeChannelControl(dma, PHILPSX_DMA_PIO);
 			DMAArbiter_handleDMATransactions(dma);
 			break;
 
@@ -389,16 +530,8 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			break;
 		case 0xE8:
 			// Impose additional restrictions on writable bits
-			word = ((word << 24) & 0xFF000000) |
-					((word << 8) & 0xFF0000) |
-					(logical_rshift(word, 8) & 0xFF00) |
-					(logical_rshift(word, 24) & 0xFF);
 			int32_t existingWord =
 					dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2];
-			existingWord = ((existingWord << 24) & 0xFF000000) |
-					((existingWord << 8) & 0xFF0000) |
-					(logical_rshift(existingWord, 8) & 0xFF00) |
-					(logical_rshift(existingWord, 24) & 0xFF);
 
 			// Mask writable bits out of original and set bit 1
 			existingWord &= 0xAEFFFFFF;
@@ -409,30 +542,17 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			existingWord |= word;
 
 			// Write back
-			existingWord = ((existingWord << 24) & 0xFF000000) |
-					((existingWord << 8) & 0xFF0000) |
-					(logical_rshift(existingWord, 8) & 0xFF00) |
-					(logical_rshift(existingWord, 24) & 0xFF);
 			dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2] = existingWord;
+			DMAArbiter_decodeChannelControl(dma, PHILPSX_DMA_OTC);
 			DMAArbiter_handleDMATransactions(dma);
 			break;
 
 			// Global registers
 		case 0xF0:
 			dma->dmaControlRegister = word;
+			DMAArbiter_decodeControlRegister(dma);
 			break;
 		case 0xF4:
-			// Swap endianness
-			word = ((word << 24) & 0xFF000000) |
-					((word << 8) & 0xFF0000) |
-					(logical_rshift(word, 8) & 0xFF00) |
-					(logical_rshift(word, 24) & 0xFF);
-			dma->dmaInterruptRegister =
-					((dma->dmaInterruptRegister << 24) & 0xFF000000) |
-					((dma->dmaInterruptRegister << 8) & 0xFF0000) |
-					(logical_rshift(dma->dmaInterruptRegister, 8) & 0xFF00) |
-					(logical_rshift(dma->dmaInterruptRegister, 24) & 0xFF);
-
 			// First deal with non-flag bits
 			dma->dmaInterruptRegister &= 0x7F000000;
 			dma->dmaInterruptRegister |= word & 0x00FFFFFF;
@@ -441,36 +561,86 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			word = ~word & 0x7F000000;
 			dma->dmaInterruptRegister = (dma->dmaInterruptRegister & word) |
 					(dma->dmaInterruptRegister & 0x00FFFFFF);
-
-			// Swap endianness back
-			dma->dmaInterruptRegister =
-					((dma->dmaInterruptRegister << 24) & 0xFF000000) |
-					((dma->dmaInterruptRegister << 8) & 0xFF0000) |
-					(logical_rshift(dma->dmaInterruptRegister, 8) & 0xFF00) |
-					(logical_rshift(dma->dmaInterruptRegister, 24) & 0xFF);
 			break;
 	}
 }
 
+/*
+ * This function works out whether a channel has a transfer requested from
+ * its channel control register, which needs bit 28 as well as bit 24 set in
+ * sync mode 0.
+ */
+static void DMAArbiter_decodeChannelControl(DMAArbiter *dma, int32_t channel)
+{
+	int32_t channelControl = dma->channelRegisters[channel * 3 + 2];
+	int32_t startMask = (channelControl & 0x600) == 0 ?
+			0x11000000 : 0x01000000;
+
+	if ((channelControl & startMask) == startMask)
+		dma->startedChannels |= 1 << channel;
+	else
+		dma->startedChannels &= ~(1 << channel);
+}
+
+/*
+ * This function works out which channels are enabled, and the priority of
+ * each, from the DMA control register.
+ */
+static void DMAArbiter_decodeControlRegister(DMAArbiter *dma)
+{
+	dma->enabledChannels = 0;
+	for (int32_t i = 0; i < PHILPSX_DMA_CHANNEL_COUNT; ++i) {
+		int32_t field = logical_rshift(dma->dmaControlRegister, i * 4);
+		dma->channelPriority[i] = field & 0x7;
+		if ((field & 0x8) == 0x8)
+			dma->enabledChannels |= 1 << i;
+	}
+}
+
+/*
+ * This function fills an ordering table lying within RAM, starting from its
+ * lowest address. Each entry points at the one below it, apart from the
+ * lowest, which marks the end of the list. Entries are written several at a
+ * time where the host allows it.
+ */
+static void DMAArbiter_fillOrderingTable(int8_t *ram, int32_t lowestAddress,
+		int32_t numberOfWords)
+{
+	int8_t *table = ram + lowestAddress;
+	int32_t i = 1;
+#if defined(__AVX2__)
+	__m256i entries = _mm256_add_epi32(_mm256_set1_epi32(lowestAddress),
+			_mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28));
+	__m256i step = _mm256_set1_epi32(32);
+	for (; i + 8 <= numberOfWords; i += 8) {
+		_mm256_storeu_si256((__m256i *)(table + i * 4), entries);
+		entries = _mm256_add_epi32(entries, step);
+	}
+#elif defined(__SSE2__)
+	__m128i entries = _mm_add_epi32(_mm_set1_epi32(lowestAddress),
+			_mm_setr_epi32(0, 4, 8, 12));
+	__m128i step = _mm_set1_epi32(16);
+	for (; i + 4 <= numberOfWords; i += 4) {
+		_mm_storeu_si128((__m128i *)(table + i * 4), entries);
+		entries = _mm_add_epi32(entries, step);
+	}
+#endif
+	for (; i < numberOfWords; ++i)
+		write_le_word(table + i * 4, lowestAddress + (i - 1) * 4);
+	write_le_word(table, 0xFFFFFF);
+}
+
 /*
  * This function handles CD-ROM DMA transfers - it assumes a sync mode of 0.
  */
 static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma)
 {
-	// Get DMA base address and correct endianness
+	// Get DMA base address
 	int32_t baseAddress = dma->channelRegisters[PHILPSX_DMA_CDROM * 3];
-	baseAddress = ((baseAddress << 24) & 0xFF000000) |
-			((baseAddress << 8) & 0xFF0000) |
-			(logical_rshift(baseAddress, 8) & 0xFF00) |
-			(logical_rshift(baseAddress, 24) & 0xFF);
 	baseAddress = Cop0_virtualToPhysical(R3051_getCop0(dma->cpu), baseAddress);
 
-	// Get number of words and correct endianness
+	// Get number of words
 	int32_t numberOfWords = dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 1];
-	numberOfWords = ((numberOfWords << 24) & 0xFF000000) |
-			((numberOfWords << 8) & 0xFF0000) |
-			(logical_rshift(numberOfWords, 8) & 0xFF00) |
-			(logical_rshift(numberOfWords, 24) & 0xFF);
 	numberOfWords &= 0xFFFF;
 	if (numberOfWords == 0)
 		numberOfWords = 0x10000;
@@ -495,6 +665,11 @@ static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma)
 							(int32_t)startingByte,
 							numberOfBytes
 							);
+					SystemInterlink_invalidateCode(
+							dma->system,
+							(int32_t)startingByte,
+							numberOfBytes
+							);
 					break;
 				default: // Doesn't end in RAM, handle normally
 					for (int32_t i = 0; i < numberOfBytes; ++i) {
@@ -522,12 +697,11 @@ static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma)
 			break;
 	}
 
-	// Decrement BC if chopping enabled (detect in little-endian mode
-	// for speed)
-	switch (dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 2] & 0x10000) {
-		case 0x10000:
-			// Set BC (again in little-endian mode for speed) to 0
-			dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 1] &= 0xFFFF;
+	// Decrement BC if chopping enabled
+	switch (dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 2] & 0x100) {
+		case 0x100:
+			// Set BC to 0
+			dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 1] &= 0xFFFF0000;
 			break;
 	}
 
@@ -535,139 +709,103 @@ static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma)
 }
 
 /*
- * This function handles DMA and makes data go to the right place.
+ * This function handles DMA and makes data go to the right place. The
+ * highest priority transfer requested is carried out straight away, and the
+ * CPU is stalled for the cycles it takes - between chunks of a chopped
+ * transfer the CPU gets the bus back, so the transfer finishes that much
+ * later. No other transfer starts until it has finished.
  */
 static void DMAArbiter_handleDMATransactions(DMAArbiter *dma)
 {
-	// Check if we need to start any DMA requests
-	int32_t dmaChannelControl[7] = { 0, 0, 0, 0, 0, 0, 0 };
-	int32_t dmaChannelStarted[7] = { 0, 0, 0, 0, 0, 0, 0 };
-	for (int32_t i = 0; i < 7; ++i) {
-		int32_t word = dma->channelRegisters[i * 3 + 2];
-		dmaChannelControl[i] = ((word << 24) & 0xFF000000) |
-				((word << 8) & 0xFF0000) |
-				(logical_rshift(word, 8) & 0xFF00) |
-				(logical_rshift(word, 24) & 0xFF);
-
-		switch (logical_rshift((dmaChannelControl[i] & 0x600), 9)) {
-			case 0: // Sync mode 0
-				if ((dmaChannelControl[i] & 0x11000000) == 0x11000000)
-					dmaChannelStarted[i] = 0x1;
-				break;
-			default: // Other
-				dmaChannelStarted[i] =
-						logical_rshift(dmaChannelControl[i], 24) & 0x1;
-				break;
-		}
-	}
-
-	// Check if each one is actually enabled
-	int32_t tempControlRegister =
-			((dma->dmaControlRegister << 24) & 0xFF000000) |
-			((dma->dmaControlRegister << 8) & 0xFF0000) |
-			(logical_rshift(dma->dmaControlRegister, 8) & 0xFF00) |
-			(logical_rshift(dma->dmaControlRegister, 24) & 0xFF);
-
+	// Leave any requests waiting until the transfer in progress finishes
+	if (dma->activeChannel != -1)
+		return;
+
+	// Find requested channels that are enabled, holding MDECout back until
+	// the MDEC has decoded something for it to read
+	int32_t readyChannels = dma->startedChannels & dma->enabledChannels;
+	if (!MDEC_hasOutput(dma->mdec))
+		readyChannels &= ~(1 << PHILPSX_DMA_MDEC_OUT);
+	if (readyChannels == 0)
+		return;
+
+	// Pick the highest priority one, with higher channels winning ties
 	int32_t highestPriority = 8;
-	int32_t highestPriorityChannelSoFar = -1;
-	for (int32_t i = 0; i < 7; ++i) {
-		switch (dmaChannelStarted[i]) {
-			case 1:
-			{
-				int32_t priority =
-						logical_rshift(tempControlRegister, (i * 4)) & 0x7;
-				int32_t enabled =
-						logical_rshift(tempControlRegister, (i * 4)) & 0x8;
-
-				if (enabled > 0) {
-					if (priority <= highestPriority) {
-						highestPriority = priority;
-						highestPriorityChannelSoFar = i;
-					}
-				}
-			}
-			break;
+	int32_t channel = -1;
+	for (int32_t i = 0; i < PHILPSX_DMA_CHANNEL_COUNT; ++i) {
+		if ((readyChannels & (1 << i)) != 0 &&
+				dma->channelPriority[i] <= highestPriority) {
+			highestPriority = dma->channelPriority[i];
+			channel = i;
 		}
 	}
 
-	int32_t cpuCycles = 0;
+	// Keep hold of block and channel control as they were when the
+	// transfer started, as the handlers update them
+	int32_t blockControl = dma->channelRegisters[channel * 3 + 1];
+	int32_t channelControl = dma->channelRegisters[channel * 3 + 2];
 
-	// Perform DMA transfer itself if one is needed
-	switch (highestPriorityChannelSoFar) {
-		case -1: // Do nothing
-			break;
-		default: // Do DMA transfer
-			// Set bus holder to DMA Arbiter
-			R3051_setBusHolder(dma->cpu, PHILPSX_COMPONENTS_DMA);
-
-			// Clear bit 28 of channel control register (remember it is
-			// stored in little-endian mode)
-			dma->channelRegisters[highestPriorityChannelSoFar * 3 + 2] &=
-					0xFFFFFFEF;
-
-			// Call correct method depending on channel or mode
-			switch (highestPriorityChannelSoFar) {
-				case 0: // MDECin
-					fprintf(stdout, "PhilPSX: DMAArbiter: MDECin DMA "
-							"triggered\n");
-					break;
-				case 1: // MDECout
-					fprintf(stdout, "PhilPSX: DMAArbiter: MDECout DMA "
-							"triggered\n");
-					break;
-				case 2: // GPU DMA
-					cpuCycles = DMAArbiter_handleGPU(dma);
-					break;
-				case 3: // CD-ROM
-					cpuCycles = DMAArbiter_handleCDROM(dma);
-					break;
-				case 4: // SPU
-					fprintf(stdout, "PhilPSX: DMAArbiter: SPU DMA "
-							"triggered\n");
-					break;
-				case 5: // PIO
-					fprintf(stdout, "PhilPSX: DMAArbiter: PIO DMA "
-							"triggered\n");
-					break;
-				case 6: // OTC DMA
-					cpuCycles = DMAArbiter_handleOTC(dma);
-					break;
-			}
+	// Set bus holder to DMA Arbiter
+	R3051_setBusHolder(dma->cpu, PHILPSX_COMPONENTS_DMA);
 
-			// Clear bit 24 of channel control register (again, remember
-			// endianness
-			dma->channelRegisters[highestPriorityChannelSoFar * 3 + 2] &=
-					0xFFFFFFFE;
-
-			// Set bus holder back to CPU
-			R3051_setBusHolder(dma->cpu, PHILPSX_COMPONENTS_CPU);
-
-			// Trigger interrupt by masking correct bit (remember endianness)
-			int32_t tempInterruptRegister =
-					((dma->dmaInterruptRegister << 24) & 0xFF000000) |
-					((dma->dmaInterruptRegister << 8) & 0xFF0000) |
-					(logical_rshift(dma->dmaInterruptRegister, 8) & 0xFF00) |
-					(logical_rshift(dma->dmaInterruptRegister, 24) & 0xFF);
-			int32_t intMask = 0x00010000 << highestPriorityChannelSoFar;
-			intMask |= 0x00800000;
-
-			if ((tempInterruptRegister & intMask) == intMask) {
-				intMask = 0x01000000 << highestPriorityChannelSoFar;
-				tempInterruptRegister |= intMask;
-				dma->dmaInterruptRegister =
-						((tempInterruptRegister << 24) & 0xFF000000) |
-						((tempInterruptRegister << 8) & 0xFF0000) |
-						(logical_rshift(tempInterruptRegister, 8) & 0xFF00) |
-						(logical_rshift(tempInterruptRegister, 24) & 0xFF);
-
-				// Set flag in system's Interrupt Status Register
-				SystemInterlink_setDMAInterruptDelay(dma->system, 0);
-			}
+	// Clear bit 28 of channel control register
+	dma->channelRegisters[channel * 3 + 2] &= 0xEFFFFFFF;
+	DMAArbiter_decodeChannelControl(dma, channel);
 
+	// Call correct method depending on channel or mode
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	int32_t dmaCycles = 0;
+	switch (channel) {
+		case 0: // MDECin
+		case 1: // MDECout
+			dmaCycles = DMAArbiter_handleMDEC(dma, channel);
+			break;
+		case 2: // GPU DMA
+			dmaCycles = DMAArbiter_handleGPU(dma);
+			break;
+		case 3: // CD-ROM
+			dmaCycles = DMAArbiter_handleCDROM(dma);
+			break;
+		case 4: // SPU
+			dmaCycles = DMAArbiter_handleSPU(dma);
+			break;
+		case 5: // PIO
+			fprintf(stdout, "PhilPSX: DMAArbiter: PIO DMA "
+					"triggered\n");
+			break;
+		case 6: // OTC DMA
+			dmaCycles = DMAArbiter_handleOTC(dma);
 			break;
 	}
+	PHILPSX_TRACE_END(PHILPSX_TRACE_DMA, traceStart, channel);
+
+	// Count words transferred, which each handler returns as its cycle
+	// count
+	PHILPSX_PERF_ADD(PHILPSX_PERF_DMA_WORDS + channel, dmaCycles);
+
+	// Set bus holder back to CPU
+	R3051_setBusHolder(dma->cpu, PHILPSX_COMPONENTS_CPU);
+
+	// Work out how long the CPU gets the bus back for between the chunks
+	// of a chopped transfer, which only applies in sync mode 0
+	int32_t cpuWindowCycles = 0;
+	if ((channelControl & 0x700) == 0x100) {
+		int32_t numberOfWords = blockControl & 0xFFFF;
+		if (numberOfWords == 0)
+			numberOfWords = 0x10000;
+		int32_t dmaWindowWords =
+				1 << (logical_rshift(channelControl, 16) & 0x7);
+		int32_t numberOfChunks =
+				(numberOfWords + dmaWindowWords - 1) / dmaWindowWords;
+		cpuWindowCycles = (numberOfChunks - 1) *
+				(1 << (logical_rshift(channelControl, 20) & 0x7));
+	}
 
-	//SystemInterlink_appendSyncCycles(dma->system, cpuCycles);
+	// Stall the CPU for the time the transfer holds the bus, and finish the
+	// transfer once the time it gives back has passed too
+	dma->activeChannel = channel;
+	SystemInterlink_appendSyncCycles(dma->system, dmaCycles);
+	SystemInterlink_setDMACompletionDelay(dma->system, cpuWindowCycles);
 }
 
 /*
@@ -675,27 +813,15 @@ static void DMAArbiter_handleDMATransactions(DMAArbiter *dma)
  */
 static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
 {
-	// Get DMA base address and correct endianness
+	// Get DMA base address
 	int32_t baseAddress = dma->channelRegisters[PHILPSX_DMA_GPU * 3];
-	baseAddress = ((baseAddress << 24) & 0xFF000000) |
-			((baseAddress << 8) & 0xFF0000) |
-			(logical_rshift(baseAddress, 8) & 0xFF00) |
-			(logical_rshift(baseAddress, 24) & 0xFF);
 	baseAddress = Cop0_virtualToPhysical(R3051_getCop0(dma->cpu), baseAddress);
 
-	// Get block control and correct endianness
+	// Get block control
 	int32_t blockControl = dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 1];
-	blockControl = ((blockControl << 24) & 0xFF000000) |
-			((blockControl << 8) & 0xFF0000) |
-			(logical_rshift(blockControl, 8) & 0xFF00) |
-			(logical_rshift(blockControl, 24) & 0xFF);
 
-	// Get channel control register and correct endianness
+	// Get channel control register
 	int32_t channelControl = dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 2];
-	channelControl = ((channelControl << 24) & 0xFF000000) |
-			((channelControl << 8) & 0xFF0000) |
-			(logical_rshift(channelControl, 8) & 0xFF00) |
-			(logical_rshift(channelControl, 24) & 0xFF);
 
 	// Act according to specified mode
 	int32_t dmaCycles = 0;
@@ -747,6 +873,15 @@ static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
 					}
 					break;
 				case 1: // Write to GPU from RAM
+					// Hand the whole transfer over in one go if it is a
+					// forward one lying entirely within RAM
+					if (backward == 0 && (tempAddress & 0xFFFFFFFCL) +
+							numOfWords * 4L <= 0x200000L) {
+						GPU_submitToGP0Block(dma->gpu,
+								SystemInterlink_getRamArray(dma->system) +
+								(tempAddress & 0xFFFFFFFCL), numOfWords);
+						break;
+					}
 					for (int32_t i = 0; i < numOfWords; ++i) {
 						GPU_submitToGP0(
 								dma->gpu,
@@ -766,8 +901,8 @@ static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
 					break;
 			}
 
-			// Set BA to 0 directly in register (little-endian) for speed
-			dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 1] &= 0xFFFF0000;
+			// Set BA to 0 directly in register
+			dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 1] &= 0xFFFF;
 
 		}
 		break;
@@ -779,32 +914,36 @@ static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
 				// Store as current address
 				int32_t currentAddress = nextAddress;
 
-				// Read word into nextAddress, update base address
-				// register and correct endianness
+				// Read word into nextAddress, and update base address
+				// register
 				nextAddress =
 						SystemInterlink_readWord(dma->system, nextAddress);
 				dma->channelRegisters[PHILPSX_DMA_GPU * 3] =
-						nextAddress & 0xFFFFFF00;
-				nextAddress = ((nextAddress << 24) & 0xFF000000) |
-						((nextAddress << 8) & 0xFF0000) |
-						(logical_rshift(nextAddress, 8) & 0xFF00) |
-						(logical_rshift(nextAddress, 24) & 0xFF);
+						nextAddress & 0xFFFFFF;
 
 				// Get number of words we need and mask them from nextAddress
 				int32_t numOfWords =
 						logical_rshift((nextAddress & 0xFF000000), 24);
 				nextAddress &= 0xFFFFFF;
 
-				// Iterate current block and send commands
-				for (int32_t i = 1; i <= numOfWords; ++i) {
-					GPU_submitToGP0(
-							dma->gpu,
-							SystemInterlink_readWord(
-							dma->system,
-							currentAddress + i * 4)
-							);
-					++dmaCycles;
+				// Send the current block's commands, in one go if they lie
+				// entirely within RAM
+				int32_t blockAddress = (currentAddress & 0xFFFFFC) + 4;
+				if (blockAddress + numOfWords * 4 <= 0x200000) {
+					GPU_submitToGP0Block(dma->gpu,
+							SystemInterlink_getRamArray(dma->system) +
+							blockAddress, numOfWords);
+				} else {
+					for (int32_t i = 1; i <= numOfWords; ++i) {
+						GPU_submitToGP0(
+								dma->gpu,
+								SystemInterlink_readWord(
+								dma->system,
+								currentAddress + i * 4)
+								);
+					}
 				}
+				dmaCycles += numOfWords;
 			} while (nextAddress != 0xFFFFFF);
 		}
 		break;
@@ -818,25 +957,96 @@ static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
 	return dmaCycles;
 }
 
+/*
+ * This function handles MDECin and MDECout DMA transfers, feeding the MDEC
+ * its commands and reading back what it has decoded.
+ */
+static int32_t DMAArbiter_handleMDEC(DMAArbiter *dma, int32_t channel)
+{
+	// Get DMA base address
+	int32_t baseAddress = dma->channelRegisters[channel * 3];
+	baseAddress = Cop0_virtualToPhysical(R3051_getCop0(dma->cpu), baseAddress);
+
+	// Get block control
+	int32_t blockControl = dma->channelRegisters[channel * 3 + 1];
+
+	// Get channel control register
+	int32_t channelControl = dma->channelRegisters[channel * 3 + 2];
+
+	// Work out number of words according to specified mode
+	int32_t numOfWords = 0;
+	switch (logical_rshift((channelControl & 0x600), 9)) {
+		case 0:
+			numOfWords = 0xFFFF & blockControl;
+			if (numOfWords == 0)
+				numOfWords = 0x10000;
+			break;
+		case 1:
+		{
+			// Get block size in words, and number of blocks
+			int32_t blockSize = 0xFFFF & blockControl;
+			if (blockSize == 0)
+				blockSize = 0x10000;
+			int32_t numOfBlocks = 0xFFFF & logical_rshift(blockControl, 16);
+			if (numOfBlocks == 0)
+				numOfBlocks = 0x10000;
+			numOfWords = blockSize * numOfBlocks;
+
+			// Set BA to 0 directly in register
+			dma->channelRegisters[channel * 3 + 1] &= 0xFFFF;
+		}
+		break;
+		default:
+			fprintf(stderr, "This transfer mode is not implemented for "
+					"MDEC DMA\n");
+			exit(1);
+			break;
+	}
+	int32_t dmaCycles = numOfWords;
+
+	// Copy the whole transfer in one go if it is a forward one lying
+	// entirely within RAM, otherwise a word at a time
+	int64_t tempAddress = baseAddress & 0xFFFFFFFCL;
+	int32_t backward = logical_rshift(channelControl, 1) & 0x1;
+	int8_t *ram = SystemInterlink_getRamArray(dma->system);
+	if (backward == 0 && tempAddress + numOfWords * 4L <= 0x200000L) {
+		if (channel == PHILPSX_DMA_MDEC_IN) {
+			MDEC_writeBlock(dma->mdec, ram + tempAddress, numOfWords);
+		} else {
+			MDEC_readBlock(dma->mdec, ram + tempAddress, numOfWords);
+			SystemInterlink_invalidateCode(dma->system, (int32_t)tempAddress,
+					numOfWords * 4);
+		}
+		return dmaCycles;
+	}
+	for (int32_t i = 0; i < numOfWords; ++i) {
+		int8_t word[4];
+		if (channel == PHILPSX_DMA_MDEC_IN) {
+			write_le_word(word, SystemInterlink_readWord(dma->system,
+					(int32_t)tempAddress));
+			MDEC_writeBlock(dma->mdec, word, 1);
+		} else {
+			MDEC_readBlock(dma->mdec, word, 1);
+			SystemInterlink_writeWord(dma->system, (int32_t)tempAddress,
+					read_le_word(word));
+		}
+		tempAddress += backward ? -4 : 4;
+	}
+
+	return dmaCycles;
+}
+
 /*
  * This function handles OTC DMA transfers - it assumes a sync mode of 0.
  */
 static int32_t DMAArbiter_handleOTC(DMAArbiter *dma)
 {
-	// Get DMA base address and correct endianness
+	// Get DMA base address
 	int32_t baseAddress = dma->channelRegisters[PHILPSX_DMA_OTC * 3];
-	baseAddress = ((baseAddress << 24) & 0xFF000000) |
-			((baseAddress << 8) & 0xFF0000) |
-			(logical_rshift(baseAddress, 8) & 0xFF00) |
-			(logical_rshift(baseAddress, 24) & 0xFF);
 	baseAddress = Cop0_virtualToPhysical(R3051_getCop0(dma->cpu), baseAddress);
 
-	// Get number of words and correct endianness
+	// Get number of words
 	int32_t numberOfWords = dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 1];
-	numberOfWords = ((numberOfWords << 24) & 0xFF000000) |
-			((numberOfWords << 8) & 0xFF0000) |
-			(logical_rshift(numberOfWords, 8) & 0xFF00) |
-			(logical_rshift(numberOfWords, 24) & 0xFF);
 	numberOfWords &= 0xFFFF;
 	if (numberOfWords == 0)
 		numberOfWords = 0x10000;
@@ -844,37 +1054,182 @@ static int32_t DMAArbiter_handleOTC(DMAArbiter *dma)
 	// Calculate time to run system for (1 clock per word for OTC)
 	int32_t dmaCycles = numberOfWords;
 
-	// Perform OTC transfer
+	// Perform OTC transfer, straight into RAM in one go if the whole table
+	// lies within it
 	int64_t currentWord = 0xFFFFFFFFL & baseAddress;
-	int32_t destinationWord = (int32_t)(currentWord - 4L);
-	destinationWord = ((destinationWord << 24) & 0xFF000000) |
-			((destinationWord << 8) & 0xFF0000) |
-			(logical_rshift(destinationWord, 8) & 0xFF00) |
-			(logical_rshift(destinationWord, 24) & 0xFF);
-
-	for (int32_t i = 0; i < numberOfWords - 1; ++i) {
-		SystemInterlink_writeWord(
-				dma->system,
-				(int32_t)currentWord,
-				destinationWord
-				);
-		currentWord -= 4L;
-		destinationWord = (int32_t)(currentWord - 4L);
-		destinationWord = ((destinationWord << 24) & 0xFF000000) |
-				((destinationWord << 8) & 0xFF0000) |
-				(logical_rshift(destinationWord, 8) & 0xFF00) |
-				(logical_rshift(destinationWord, 24) & 0xFF);
+	int64_t lowestWord = currentWord - (numberOfWords - 1) * 4L;
+	if ((currentWord & 0x3) == 0 && currentWord < 0x200000L &&
+			lowestWord >= 0) {
+		DMAArbiter_fillOrderingTable(
+				SystemInterlink_getRamArray(dma->system),
+				(int32_t)lowestWord, numberOfWords);
+		SystemInterlink_invalidateCode(dma->system, (int32_t)lowestWord,
+				numberOfWords * 4);
+	} else {
+		int32_t destinationWord = (int32_t)(currentWord - 4L);
+
+		for (int32_t i = 0; i < numberOfWords - 1; ++i) {
+			SystemInterlink_writeWord(
+					dma->system,
+					(int32_t)currentWord,
+					destinationWord
+					);
+			currentWord -= 4L;
+			destinationWord = (int32_t)(currentWord - 4L);
+		}
+		SystemInterlink_writeWord(dma->system, (int32_t)currentWord,
+				0xFFFFFF);
 	}
-	SystemInterlink_writeWord(dma->system, (int32_t)currentWord, 0xFFFFFF00);
 
-	// Decrement BC if chopping enabled (detect in little-endian mode
-	// for speed)
-	switch (dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2] & 0x10000) {
-		case 0x10000:
-			// Set BC (again in little-endian mode for speed) to 0
-			dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 1] &= 0xFFFF;
+	// Decrement BC if chopping enabled
+	switch (dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2] & 0x100) {
+		case 0x100:
+			// Set BC to 0
+			dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 1] &= 0xFFFF0000;
 			break;
 	}
 
 	return dmaCycles;
+}
+
+/*
+ * This function handles SPU DMA transfers, which copy straight between RAM
+ * and sound RAM where they can.
+ */
+static int32_t DMAArbiter_handleSPU(DMAArbiter *dma)
+{
+	// Get DMA base address
+	int32_t baseAddress = dma->channelRegisters[PHILPSX_DMA_SPU * 3];
+	baseAddress = Cop0_virtualToPhysical(R3051_getCop0(dma->cpu), baseAddress);
+
+	// Get block control
+	int32_t blockControl = dma->channelRegisters[PHILPSX_DMA_SPU * 3 + 1];
+
+	// Get channel control register
+	int32_t channelControl = dma->channelRegisters[PHILPSX_DMA_SPU * 3 + 2];
+
+	// Work out number of words according to specified mode
+	int32_t numOfWords = 0;
+	switch (logical_rshift((channelControl & 0x600), 9)) {
+		case 0:
+			numOfWords = 0xFFFF & blockControl;
+			if (numOfWords == 0)
+				numOfWords = 0x10000;
+			break;
+		case 1:
+		{
+			// Get block size in words, and number of blocks
+			int32_t blockSize = 0xFFFF & blockControl;
+			if (blockSize == 0)
+				blockSize = 0x10000;
+			int32_t numOfBlocks = 0xFFFF & logical_rshift(blockControl, 16);
+			if (numOfBlocks == 0)
+				numOfBlocks = 0x10000;
+			numOfWords = blockSize * numOfBlocks;
+
+			// Set BA to 0 directly in register
+			dma->channelRegisters[PHILPSX_DMA_SPU * 3 + 1] &= 0xFFFF;
+		}
+		break;
+		default:
+			fprintf(stderr, "This transfer mode is not implemented for "
+					"SPU DMA\n");
+			exit(1);
+			break;
+	}
+	int32_t dmaCycles = numOfWords;
+
+	// Copy the whole transfer in one go if it is a forward one lying
+	// entirely within RAM, otherwise a word at a time
+	int64_t tempAddress = baseAddress & 0xFFFFFFFCL;
+	int32_t writeToSPU = channelControl & 0x1;
+	int32_t backward = logical_rshift(channelControl, 1) & 0x1;
+	int8_t *ram = SystemInterlink_getRamArray(dma->system);
+	if (backward == 0 && tempAddress + numOfWords * 4L <= 0x200000L) {
+		if (writeToSPU) {
+			SPU_writeBlock(dma->spu, ram + tempAddress, numOfWords);
+		} else {
+			SPU_readBlock(dma->spu, ram + tempAddress, numOfWords);
+			SystemInterlink_invalidateCode(dma->system, (int32_t)tempAddress,
+					numOfWords * 4);
+		}
+		return dmaCycles;
+	}
+	for (int32_t i = 0; i < numOfWords; ++i) {
+		int8_t word[4];
+		if (writeToSPU) {
+			write_le_word(word, SystemInterlink_readWord(dma->system,
+					(int32_t)tempAddress));
+			SPU_writeBlock(dma->spu, word, 1);
+		} else {
+			SPU_readBlock(dma->spu, word, 1);
+			SystemInterlink_writeWord(dma->system, (int32_t)tempAddress,
+					read_le_word(word));
+		}
+		tempAddress += backward ? -4 : 4;
+	}
+
+	return dmaCycles;
+}
+
+/*
+ * This function handles byte reads from the DMA registers.
+ */
+static int32_t DMAArbiter_readRegisterByte(void *component, int32_t address)
+{
+	return DMAArbiter_readByte(component, address);
+}
+
+/*
+ * This function handles halfword reads from the DMA registers.
+ */
+static int32_t DMAArbiter_readRegisterHalfWord(void *component,
+		int32_t address)
+{
+	int32_t word = DMAArbiter_readWord(component, address & 0xFFFFFFFC);
+	return logical_rshift(word, (address & 0x2) * 8) & 0xFFFF;
+}
+
+/*
+ * This function handles word reads from the DMA registers.
+ */
+static int32_t DMAArbiter_readRegisterWord(void *component, int32_t address)
+{
+	return DMAArbiter_readWord(component, address);
+}
+
+/*
+ * This function handles byte writes to the DMA registers.
+ */
+static void DMAArbiter_writeRegisterByte(void *component, int32_t address,
+		int32_t value)
+{
+	DMAArbiter_writeByte(component, address, (int8_t)value);
+}
+
+/*
+ * This function handles halfword writes to the DMA registers, merging the
+ * halfword into the current value of the register.
+ */
+static void DMAArbiter_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value)
+{
+	// Get word address and shift of halfword within it
+	int32_t wordAddress = address & 0xFFFFFFFC;
+	int32_t shift = (address & 0x2) * 8;
+
+	// Merge halfword into original word and write it back
+	int32_t tempWord = DMAArbiter_readWord(component, wordAddress);
+	tempWord &= ~(0xFFFF << shift);
+	tempWord |= (value & 0xFFFF) << shift;
+	DMAArbiter_writeWord(component, wordAddress, tempWord);
+}
+
+/*
+ * This function handles word writes to the DMA registers.
+ */
+static void DMAArbiter_writeRegisterWord(void *component, int32_t address,
+		int32_t value)
+{
+	DMAArbiter_writeWord(component, address, value);
 }
\ No newline at end of file
@@ -6,18 +6,31 @@
  * GPU.c - Copyright Phillip Potter, 2020, under GPLv3
  */
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <GL/gl.h>
 #include <SDL2/SDL.h>
 #include "../headers/GPU.h"
 #include "../headers/SystemInterlink.h"
-#include "../headers/ArrayList.h"
 #include "../headers/GLFunctionPointers.h"
+#include "../headers/GLPresenter.h"
+#include "../headers/GLProgramCache.h"
+#include "../headers/GLStateCache.h"
+#include "../headers/GpuTrace.h"
+#include "../headers/GuestMemory.h"
+#include "../headers/PerfCounters.h"
+#include "../headers/SaveState.h"
+#include "../headers/SoftRenderer.h"
+#include "../headers/TraceEvents.h"
+#include "../headers/VramDirtyMap.h"
 #include "../headers/WorkQueue.h"
+#include "../headers/endian_utils.h"
 #include "../headers/math_utils.h"
 
 // OpenGL shader-specific include directives
@@ -25,12 +38,7 @@
 #include "../headers/ogl_shaders/AnyLine_FragmentShader1.h"
 #include "../headers/ogl_shaders/DisplayScreen_VertexShader1.h"
 #include "../headers/ogl_shaders/DisplayScreen_FragmentShader1.h"
-#include "../headers/ogl_shaders/GP0_02_VertexShader1.h"
-#include "../headers/ogl_shaders/GP0_02_FragmentShader1.h"
-#include "../headers/ogl_shaders/GP0_80_VertexShader1.h"
-#include "../headers/ogl_shaders/GP0_80_FragmentShader1.h"
-#include "../headers/ogl_shaders/GP0_80_VertexShader2.h"
-#include "../headers/ogl_shaders/GP0_80_FragmentShader2.h"
+#include "../headers/ogl_shaders/DisplayScreen_ComputeShader1.h"
 #include "../headers/ogl_shaders/GP0_A0_VertexShader1.h"
 #include "../headers/ogl_shaders/GP0_A0_FragmentShader1.h"
 #include "../headers/ogl_shaders/MonochromePolygon_VertexShader1.h"
@@ -41,21 +49,113 @@
 #include "../headers/ogl_shaders/ShadedPolygon_FragmentShader1.h"
 #include "../headers/ogl_shaders/ShadedTexturedPolygon_VertexShader1.h"
 #include "../headers/ogl_shaders/ShadedTexturedPolygon_FragmentShader1.h"
+#include "../headers/ogl_shaders/TextureCache_VertexShader1.h"
+#include "../headers/ogl_shaders/TextureCache_FragmentShader1.h"
 #include "../headers/ogl_shaders/TexturedPolygon_VertexShader1.h"
 #include "../headers/ogl_shaders/TexturedPolygon_FragmentShader1.h"
 #include "../headers/ogl_shaders/TexturedRectangle_VertexShader1.h"
 #include "../headers/ogl_shaders/TexturedRectangle_FragmentShader1.h"
+#include "../headers/ogl_shaders/VramTransfer_ComputeShader1.h"
 
 // Values for easier reading when dealing with GPU cycle math
 #define GPU_CYCLES_PER_FRAME 1069484
 #define GPU_CYCLES_PER_SCANLINE 3406
 #define GPU_CYCLES_VBLANK 817440
+#define GPU_CYCLES_PER_SECOND 53222400
+
+// Values for frame pacing - a frame lasts this many nanoseconds of host
+// time, and falling further behind than the resync limit gives up on
+// catching up (after a long stall, for example)
+#define GPU_FRAME_TIME_NS \
+		((int64_t)GPU_CYCLES_PER_FRAME * 1000000000 / GPU_CYCLES_PER_SECOND)
+#define GPU_PACING_RESYNC_FRAMES 8
+
+// Size of the line buffer - a command carries at most 12 parameters, so a
+// line packet holds the command word and up to 5 colour/vertex pairs
+#define GPU_LINE_PACKET_VERTICES 5
+#define GPU_LINE_PACKET_WORDS (GPU_LINE_PACKET_VERTICES * 2)
+
+// Command categories that trace replay times separately
+#define GPU_REPLAY_CATEGORIES 8
+
+// Values for primitive batching - the vertex buffer is split into segments
+// so the GPU can read one while we fill another, and vram is split into
+// 16x16 tiles (one 64-bit mask per row of tiles) to track overlap
+#define GPU_VERTEX_BUFFER_SEGMENTS 4
+#define GPU_VERTEX_BUFFER_SEGMENT_SIZE 16384
+#define GPU_MAX_BATCH_UNIFORMS 14
+#define GPU_MAX_READ_AREAS 2
+#define GPU_TILE_ROWS 32
+
+// Values for vram transfer batching - each GP0(0x02) fill or GP0(0x80) copy
+// takes two vectors of the transfer program's uniform array, which holds 64
+#define GPU_MAX_BATCHED_TRANSFERS 32
+#define GPU_TRANSFER_FILL 0x1
+#define GPU_TRANSFER_SET_MASK 0x2
+#define GPU_TRANSFER_CHECK_MASK 0x4
+
+// Values for GP0(0xA0) uploads - each staging slot holds a full vram's worth
+// of 16-bit pixels, so one transfer never has to span slots
+#define GPU_UPLOAD_BUFFER_SLOTS 4
+#define GPU_UPLOAD_BUFFER_SLOT_SIZE (1024 * 512 * 2)
+
+// Values for the texture cache - each entry is a 256x256 texture page
+// decoded through its CLUT, stored in one layer of an array texture
+#define GPU_TEXTURE_CACHE_ENTRIES 32
+
+// Memory barrier bits covering every way a texture written by image stores
+// can be used once we have finished drawing to it
+#define GPU_IMAGE_STORE_BARRIER_BITS (GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | \
+		GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | \
+		GL_FRAMEBUFFER_BARRIER_BIT)
+
+// This struct describes one vertex of a batched primitive, and mirrors the
+// attributes declared by the primitive vertex shaders
+typedef struct GpuVertex {
+	int32_t position[2];
+	int32_t colour[3];
+	int32_t texCoord[2];
+	int32_t primitive1[4];
+	int32_t primitive2[4];
+	int32_t textureCacheLayer;
+} GpuVertex;
+
+// This struct describes one entry of the texture cache, keyed by the texture
+// page, colour mode and CLUT it was decoded from - the read areas are those
+// parts of vram in OpenGL form, so the entry can be dropped when they change
+typedef struct GpuTextureCacheEntry {
+	int32_t texBaseX;
+	int32_t texBaseY;
+	int32_t texColourMode;
+	int32_t clut_x;
+	int32_t clut_y;
+	int32_t readAreas[GPU_MAX_READ_AREAS * 4];
+	int32_t readAreaCount;
+	uint32_t lastUsed;
+	bool valid;
+} GpuTextureCacheEntry;
+
+// This array maps the six batched vertices of a four-pointed primitive onto
+// its corners, matching the two triangles the GPU draws for it
+static const int32_t GPU_polygonVertexOrder[6] = {0, 1, 2, 1, 2, 3};
+
+// Size of the buffer DMA data is staged in, which is a whole vram image and
+// so is given its own guest memory mapping
+static const size_t GPU_dmaBufferSize = 1024 * 512 * 4;
 
 // Forward declarations for functions private to this class
-// GPU-related stuff:
+// GPU-related stuff - in debug builds, GL errors are checked after every call
+// while GPU_initGL runs, and after that are reported by the KHR_debug
+// callback or sampled once per frame, unless PHILPSX_CHECK_EVERY_GL_CALL is
+// also defined:
 #ifdef PHILPSX_DEBUG_BUILD
+#ifdef PHILPSX_CHECK_EVERY_GL_CALL
 #define GPU_checkOpenGLErrors(x, y) GPU_realCheckOpenGLErrors(x, y)
 #else
+#define GPU_checkOpenGLErrors(x, y) ((x)->checkOpenGLErrorsPerCall ? \
+		GPU_realCheckOpenGLErrors(x, y) : false)
+#endif
+#else
 #define GPU_checkOpenGLErrors(x, y) false
 #endif
 static void GPU_GP0_02(GPU *gpu, int32_t command, int32_t destination,
@@ -88,20 +188,82 @@ static void GPU_GP1_07(GPU *gpu, int32_t command);
 static void GPU_GP1_08(GPU *gpu, int32_t command);
 static void GPU_GP1_09(GPU *gpu, int32_t command);
 static void GPU_GP1_10(GPU *gpu, int32_t command);
-static void GPU_anyLine(GPU *gpu, int32_t command, ArrayList *paramList);
+static void GPU_addLineWord(GPU *gpu, int32_t word);
+static void GPU_anyLine(GPU *gpu, int32_t command);
 static void GPU_anyLine_implementation(GpuCommand *command);
+static void GPU_batchPolygon(GPU *gpu, GLuint program,
+		const int32_t *uniforms, int32_t uniformCount,
+		const GpuVertex *vertices, int32_t fourPoints,
+		const int32_t *vertex_x, const int32_t *vertex_y,
+		const int32_t *drawingArea, const int32_t *readAreas,
+		int32_t readAreaCount);
+static void GPU_batchPrimitive(GPU *gpu, GLuint program, GLenum mode,
+		const int32_t *uniforms, int32_t uniformCount,
+		const GpuVertex *vertices, int32_t vertexCount,
+		const int32_t *drawnArea, const int32_t *readAreas,
+		int32_t readAreaCount);
+static void GPU_batchTransfer(GPU *gpu, const int32_t *transfer);
+static void GPU_beginDrawingPass(GPU *gpu);
+static void GPU_beginTrace(GPU *gpu);
 static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 		int shaderNumber);
+static void GPU_decodeTexturePage(GPU *gpu, int32_t layer);
+#ifdef PHILPSX_DEBUG_BUILD
+static void APIENTRY GPU_debugMessageCallback(GLenum source, GLenum type,
+		GLuint id, GLenum severity, GLsizei length, const GLchar *message,
+		const void *userParam);
+#endif
 static void GPU_displayScreen(GPU *gpu);
 static void GPU_displayScreen_implementation(GpuCommand *command);
+static void GPU_endDrawingPass(GPU *gpu);
+static void GPU_flushBatch(GPU *gpu);
+static void GPU_flushRenderer_implementation(GpuCommand *command);
+static void GPU_flushTransfers(GPU *gpu);
+static void GPU_getDrawnArea(int32_t *area, const int32_t *vertex_x,
+		const int32_t *vertex_y, int32_t vertexCount, int32_t drawTopLeftX,
+		int32_t drawTopLeftY, int32_t drawBottomRightX,
+		int32_t drawBottomRightY);
+static int32_t GPU_getTextureCacheLayer(GPU *gpu, const int32_t *drawnArea,
+		int32_t texBaseX, int32_t texBaseY, int32_t texColourMode,
+		int32_t clut_x, int32_t clut_y);
+static int32_t GPU_getTextureReadAreas(int32_t *areas, int32_t texBaseX,
+		int32_t texBaseY, int32_t texColourMode, int32_t clut_x,
+		int32_t clut_y);
+static uint64_t GPU_getTileMask(const int32_t *area, int32_t *firstRow,
+		int32_t *lastRow);
+static int64_t GPU_getTime(void);
+#ifdef PHILPSX_TRACE_EVENTS
+static int32_t GPU_getTraceEvent(GpuCommand *command);
+#endif
+static int32_t GPU_getWrappedAreas(int32_t *areas, int32_t x, int32_t y,
+		int32_t width, int32_t height);
+static void GPU_invalidateTextureCache(GPU *gpu, const int32_t *area);
+static bool GPU_isGP0Idle(GPU *gpu);
+static void GPU_markVramWritten(GPU *gpu, const int32_t *area);
 static void GPU_monochromePolygon(GPU *gpu, int32_t command, int32_t vertex1,
 		int32_t vertex2, int32_t vertex3, int32_t vertex4);
 static void GPU_monochromePolygon_implementation(GpuCommand *command);
 static void GPU_monochromeRectangle(GPU *gpu, int32_t command, int32_t vertex,
 		int32_t widthAndHeight);
 static void GPU_monochromeRectangle_implementation(GpuCommand *command);
+static void GPU_paceFrame(GPU *gpu);
+static void GPU_processGP0Word(GPU *gpu, int32_t word);
+static void GPU_queueCommand(GPU *gpu,
+		void (*functionPointer)(GpuCommand *command),
+		const int32_t *parameters, int32_t parameterCount,
+		bool waitForCompletion);
 static int8_t GPU_readDMABuffer(GPU *gpu, int32_t index);
+static int32_t GPU_readRegisterByte(void *component, int32_t address);
+static int32_t GPU_readRegisterHalfWord(void *component, int32_t address);
+static int32_t GPU_readRegisterWord(void *component, int32_t address);
+static void GPU_readVram(GPU *gpu, int8_t *vram);
+static void GPU_readVramBand(GPU *gpu, int8_t *vram, int32_t firstLine,
+		int32_t lineCount);
+static void GPU_readVramState_implementation(GpuCommand *command);
 static bool GPU_realCheckOpenGLErrors(GPU *gpu, const char *message);
+static void GPU_recordTrace(GPU *gpu, int32_t type, int32_t word);
+static void GPU_releaseUploadSlots(GPU *gpu);
+static bool GPU_setupStateVramCopy(GPU *gpu);
 static void GPU_shadedPolygon(GPU *gpu, int32_t command, int32_t vertex1,
 		int32_t colour2, int32_t vertex2, int32_t colour3, int32_t vertex3,
 		int32_t colour4, int32_t vertex4);
@@ -112,6 +274,7 @@ static void GPU_shadedTexturedPolygon(GPU *gpu, int32_t command,
 		int32_t vertex3, int32_t texCoord3, int32_t colour4, int32_t vertex4,
 		int32_t texCoord4);
 static void GPU_shadedTexturedPolygon_implementation(GpuCommand *command);
+static void GPU_syncRenderer(GPU *gpu);
 static void GPU_texturedPolygon(GPU *gpu, int32_t command, int32_t vertex1,
 		int32_t texCoord1AndPalette, int32_t vertex2,
 		int32_t texCoord2AndTexPage, int32_t vertex3, int32_t texCoord3,
@@ -121,7 +284,15 @@ static void GPU_texturedRectangle(GPU *gpu, int32_t command, int32_t vertex,
 		int32_t texCoordAndPalette, int32_t widthAndHeight);
 static void GPU_texturedRectangle_implementation(GpuCommand *command);
 static void GPU_triggerVblankInterrupt(GPU *gpu);
-static void GPU_writeDMABuffer(GPU *gpu, int32_t index, int8_t value);
+static void GPU_waitForUploadSlot(GPU *gpu);
+static void GPU_waitForUploadSlot_implementation(GpuCommand *command);
+static void GPU_waitForVramRead(GPU *gpu);
+static void GPU_waitForVramRead_implementation(GpuCommand *command);
+static void GPU_writeRegisterWord(void *component, int32_t address,
+		int32_t value);
+static void GPU_writeVramBand(GPU *gpu, const int8_t *vram,
+		int32_t firstLine, int32_t lineCount);
+static void GPU_writeVramState_implementation(GpuCommand *command);
 
 /*
  * This struct contains registers and state that we need in order to model
@@ -129,25 +300,28 @@ static void GPU_writeDMABuffer(GPU *gpu, int32_t index, int8_t value);
  */
 struct GPU {
 
-	// This list stores line parameters for the line rendering commands
-	ArrayList *lineParameters;
+	// This buffer gathers colour/vertex pairs for the line rendering
+	// commands, and is sent on a packet at a time
+	int32_t lineWords[GPU_LINE_PACKET_WORDS];
+	int32_t lineWordCount;
 
 	// GL variables/references are handled by this class, and so stored here,
 	// as well as the SDL_Window reference
 	WorkQueue *wq;
 	GLFunctionPointers *gl;
+	GLStateCache *glState;
+	GLProgramCache *programCache;
+	bool checkOpenGLErrorsPerCall;
+	bool openGLDebugOutput;
 	GLuint vertexArrayObject[1];
 	GLuint vramTexture[1];
 	GLuint tempDrawTexture[1];
 	GLuint vramFramebuffer[1];
 	GLuint tempDrawFramebuffer[1];
 	GLuint emptyFramebuffer[1];
-	GLuint clutBuffer[1];
 	GLuint displayScreenProgram;
+	GLuint displayConvertProgram;
 	GLuint gp0_a0Program;
-	GLuint gp0_80Program1;
-	GLuint gp0_80Program2;
-	GLuint gp0_02Program;
 	GLuint monochromeRectangleProgram1;
 	GLuint texturedRectangleProgram1;
 	GLuint texturedPolygonProgram1;
@@ -155,13 +329,96 @@ struct GPU {
 	GLuint shadedPolygonProgram1;
 	GLuint monochromePolygonProgram1;
 	GLuint anyLineProgram1;
+	GLuint textureCacheProgram;
+	GLuint vramTransferProgram;
 	SDL_Window *window;
 
+	// This shows frames from a thread of its own, when GL is in use and a
+	// shared context could be set up - otherwise frames are drawn straight
+	// into the window
+	GLPresenter *presenter;
+
+	// This is used in place of the GL variables when drawing with the
+	// software renderer instead
+	SoftRenderer *softRenderer;
+
+	// This is handed each frame shown by the software renderer in place of
+	// the window, when set
+	void (*frameSink)(void *userData, const uint32_t *pixels, int32_t width,
+			int32_t height);
+	void *frameSinkData;
+
+	// This records which tiles of vram have been written to, for other
+	// subsystems to query - it is updated from the rendering thread
+	VramDirtyMap *vramDirtyMap;
+
+	// These let us collect primitives with compatible state into a
+	// persistently mapped vertex buffer, and draw them with one call -
+	// the tile masks record which parts of vram the pending batch draws to
+	// and reads from
+	GLuint vertexBuffer[1];
+	GpuVertex *vertexBufferData;
+	GLsync vertexBufferFences[GPU_VERTEX_BUFFER_SEGMENTS];
+	int32_t vertexBufferSegment;
+	int32_t batchFirstVertex;
+	int32_t batchVertexCount;
+	GLuint batchProgram;
+	GLenum batchMode;
+	int32_t batchUniforms[GPU_MAX_BATCH_UNIFORMS];
+	uint64_t batchDrawnTiles[GPU_TILE_ROWS];
+	uint64_t batchReadTiles[GPU_TILE_ROWS];
+	bool drawingPassActive;
+	bool fragmentShaderInterlock;
+
+	// These let vram transfers that don't overlap each other run with one
+	// compute dispatch during a drawing pass - each transfer is eight values
+	// (see GPU_batchTransfer), and the tile masks record which parts of vram
+	// the pending batch writes to and reads from
+	int32_t transferBatch[GPU_MAX_BATCHED_TRANSFERS * 8];
+	int32_t transferCount;
+	int32_t transferMaxWidth;
+	int32_t transferMaxHeight;
+	uint64_t transferWrittenTiles[GPU_TILE_ROWS];
+	uint64_t transferReadTiles[GPU_TILE_ROWS];
+
+	// These let textured primitives that use a CLUT read their texels from
+	// pages decoded once, rather than looking through the CLUT for every
+	// fragment - the tile masks record which parts of vram the valid
+	// entries were decoded from, so most vram writes can skip the entries
+	GLuint textureCacheTexture[1];
+	GLuint textureCacheFramebuffer[1];
+	GpuTextureCacheEntry textureCache[GPU_TEXTURE_CACHE_ENTRIES];
+	uint64_t textureCacheTiles[GPU_TILE_ROWS];
+	uint32_t textureCacheClock;
+
+	// These let us copy vram into a persistently mapped pixel pack buffer
+	// as soon as a GP0(0xC0) command arrives, so the emulator only has to
+	// wait for the copy when it reads the first word of the response - the
+	// clipped values describe the part of the rectangle inside vram
+	GLuint vramReadBuffer[1];
+	int8_t *vramReadBufferData;
+	GLsync vramReadFence;
+	int32_t vramReadWidth;
+	int32_t vramReadHeight;
+	int32_t vramReadClippedWidth;
+	int32_t vramReadFirstRow;
+
+	// These let the emulator write GP0(0xA0) pixels straight into a ring of
+	// persistently mapped staging slots - a slot is marked busy when its
+	// upload is queued, and the rendering thread clears the flag once the
+	// GPU has finished copying out of it
+	GLuint uploadBuffer[1];
+	int8_t *uploadBufferData;
+	GLsync uploadBufferFences[GPU_UPLOAD_BUFFER_SLOTS];
+	atomic_bool uploadSlotBusy[GPU_UPLOAD_BUFFER_SLOTS];
+	int32_t uploadSlot;
+
 	// This lets us store values for DMA transfers, and synchronise access
 	// to the associated buffer
 	int32_t dmaBufferIndex;
 	int32_t dmaNeededBytes;
 	int8_t *dmaBuffer;
+	GuestMemory *dmaMemory;
 	int32_t dmaReadInProgress;
 	int32_t dmaWriteInProgress;
 	int32_t dmaWidthInPixels;
@@ -223,8 +480,51 @@ struct GPU {
 	int32_t realHorizontalRes;
 	int32_t realVerticalRes;
 
+	// This lets us only submit state to the rendering thread when it may
+	// have changed
+	bool renderStateChanged;
+
 	// This lets us trigger only once per frame
 	bool vblankTriggered;
+
+	// Number of frames emulated so far, and whether each one is shown in
+	// the window - this can be turned off for runs that don't need to be
+	// watched
+	int64_t frameCount;
+	bool presentationEnabled;
+
+	// Number of GP0 commands started so far, for benchmarking
+	int64_t commandCount;
+
+	// Frame pacing state - when the host falls behind, drawing primitives
+	// are dropped for up to maxSkippedFrames frames in a row (0 turns this
+	// off), while vram transfers and fills still go through. Drawing can
+	// also be suppressed outright, for frames that are run ahead and thrown
+	// away
+	bool drawingSuppressed;
+	int32_t maxSkippedFrames;
+	int32_t consecutiveSkippedFrames;
+	int64_t skippedFrameCount;
+	bool frameSkipped;
+	int64_t frameDeadline;
+	int64_t lastVblankTime;
+	int64_t lastFrameTime;
+
+	// Trace capture - once a path is set, the trace starts at the next
+	// vblank where GP0 is idle, and records everything submitted from then on
+	char *tracePath;
+	GpuTrace *trace;
+
+	// Vram of the save state being written or read, handed over to the
+	// rendering thread while it copies the whole of vram in one go
+	int8_t *stateVram;
+
+	// Copy of vram as last read back or uploaded for a save state, in the
+	// save state's format, set up on first use along with a client of the
+	// dirty map - tiles that haven't been written since needn't be read back
+	// or uploaded again
+	int8_t *stateVramCopy;
+	int32_t stateDirtyClient;
 };
 
 /*
@@ -247,20 +547,26 @@ GPU *construct_GPU(void)
 		goto cleanup_gpu;
 	}
 	
-	// Setup ArrayList to store line parameters in a thread-safe manner
-	gpu->lineParameters = construct_ArrayList(NULL, true, false);
-	if (!gpu->lineParameters) {
-		fprintf(stderr, "PhilPSX: GPU: Couldn't initialise lineParameters "
-				"list\n");
-		goto cleanup_mutex;
-	}
-	
 	// Setup GLFunctionPointers struct
 	gpu->gl = calloc(1, sizeof(GLFunctionPointers));
 	if (!gpu->gl) {
 		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for "
 				"GLFunctionPointers struct\n");
-		goto cleanup_lineparameters;
+		goto cleanup_mutex;
+	}
+	
+	// Setup GL state cache in front of the function pointers
+	gpu->glState = construct_GLStateCache(gpu->gl);
+	if (!gpu->glState) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't construct GLStateCache\n");
+		goto cleanup_gl;
+	}
+	
+	// Setup vram dirty map
+	gpu->vramDirtyMap = construct_VramDirtyMap();
+	if (!gpu->vramDirtyMap) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't construct VramDirtyMap\n");
+		goto cleanup_glstate;
 	}
 	
 	// Anything set below is done for clarity - struct members not dealt
@@ -283,6 +589,12 @@ GPU *construct_GPU(void)
 	gpu->dmaWidthInPixels = -1;
 	gpu->dmaHeightInPixels = -1;
 
+	// Setup upload staging slots (actual buffer allocation handled by
+	// GPU_initGL function)
+	for (int32_t i = 0; i < GPU_UPLOAD_BUFFER_SLOTS; ++i)
+		atomic_init(&gpu->uploadSlotBusy[i], false);
+	gpu->uploadSlot = 0;
+
 	// Set FIFO buffer parameters
 	gpu->commandsInFifo = 0;
 
@@ -325,13 +637,35 @@ GPU *construct_GPU(void)
 
 	// Setup VBLANK triggered flag
 	gpu->vblankTriggered = false;
+
+	// Setup frame count and presentation flag
+	gpu->frameCount = 0;
+	gpu->presentationEnabled = true;
+
+	// Setup command count
+	gpu->commandCount = 0;
+
+	// Setup frame pacing, which is off until a skip limit is set
+	gpu->maxSkippedFrames = 0;
+	gpu->consecutiveSkippedFrames = 0;
+	gpu->skippedFrameCount = 0;
+	gpu->frameSkipped = false;
+	gpu->frameDeadline = 0;
+	gpu->lastVblankTime = 0;
+	gpu->lastFrameTime = 0;
+
+	// Make sure initial state is submitted with the first command
+	gpu->renderStateChanged = true;
 	
 	// Normal return:
 	return gpu;
 	
 	// Cleanup path:
-	cleanup_lineparameters:
-	destruct_ArrayList(gpu->lineParameters);
+	cleanup_glstate:
+	destruct_GLStateCache(gpu->glState);
+	
+	cleanup_gl:
+	free(gpu->gl);
 	
 	cleanup_mutex:
 	pthread_mutex_destroy(&gpu->dmaBufferMutex);
@@ -351,8 +685,13 @@ GPU *construct_GPU(void)
  */
 void destruct_GPU(GPU *gpu)
 {
+	if (gpu->trace)
+		destruct_GpuTrace(gpu->trace);
+	free(gpu->tracePath);
+	free(gpu->stateVramCopy);
+	destruct_VramDirtyMap(gpu->vramDirtyMap);
+	destruct_GLStateCache(gpu->glState);
 	free(gpu->gl);
-	destruct_ArrayList(gpu->lineParameters);
 	pthread_mutex_destroy(&gpu->dmaBufferMutex);
 	free(gpu);
 }
@@ -374,9 +713,41 @@ void GPU_cleanupGL(GPU *gpu)
 	// Get GLFunctionPointers reference
 	GLFunctionPointers *gl = gpu->gl;
 	
+	// Stop presenting first, as it shares textures with this context
+	if (gpu->presenter) {
+		destruct_GLPresenter(gpu->presenter);
+		gpu->presenter = NULL;
+	}
+
 	// Free OpenGL resources - we don't track these GL calls as if they fail
 	// there is nothing we can do anyway
-	gl->glDeleteBuffers(1, gpu->clutBuffer);
+	for (int32_t i = 0; i < GPU_VERTEX_BUFFER_SEGMENTS; ++i) {
+		if (gpu->vertexBufferFences[i])
+			gl->glDeleteSync(gpu->vertexBufferFences[i]);
+		gpu->vertexBufferFences[i] = NULL;
+	}
+	gl->glUnmapNamedBuffer(gpu->vertexBuffer[0]);
+	gl->glDeleteBuffers(1, gpu->vertexBuffer);
+	gpu->vertexBufferData = NULL;
+	if (gpu->vramReadFence)
+		gl->glDeleteSync(gpu->vramReadFence);
+	gpu->vramReadFence = NULL;
+	gl->glUnmapNamedBuffer(gpu->vramReadBuffer[0]);
+	gl->glDeleteBuffers(1, gpu->vramReadBuffer);
+	gpu->vramReadBufferData = NULL;
+	for (int32_t i = 0; i < GPU_UPLOAD_BUFFER_SLOTS; ++i) {
+		if (gpu->uploadBufferFences[i])
+			gl->glDeleteSync(gpu->uploadBufferFences[i]);
+		gpu->uploadBufferFences[i] = NULL;
+		atomic_store(&gpu->uploadSlotBusy[i], false);
+	}
+	gl->glUnmapNamedBuffer(gpu->uploadBuffer[0]);
+	gl->glDeleteBuffers(1, gpu->uploadBuffer);
+	gpu->uploadBufferData = NULL;
+	gl->glDeleteFramebuffers(1, gpu->textureCacheFramebuffer);
+	gl->glDeleteTextures(1, gpu->textureCacheTexture);
+	memset(gpu->textureCache, 0, sizeof(gpu->textureCache));
+	memset(gpu->textureCacheTiles, 0, sizeof(gpu->textureCacheTiles));
 	gl->glDeleteFramebuffers(1, gpu->tempDrawFramebuffer);
 	gl->glDeleteTextures(1, gpu->tempDrawTexture);
 	gl->glDeleteFramebuffers(1, gpu->emptyFramebuffer);
@@ -384,9 +755,8 @@ void GPU_cleanupGL(GPU *gpu)
 	gl->glDeleteTextures(1, gpu->vramTexture);
 	gl->glDeleteVertexArrays(1, gpu->vertexArrayObject);
 	gl->glDeleteProgram(gpu->displayScreenProgram);
+	gl->glDeleteProgram(gpu->displayConvertProgram);
 	gl->glDeleteProgram(gpu->gp0_a0Program);
-	gl->glDeleteProgram(gpu->gp0_80Program1);
-	gl->glDeleteProgram(gpu->gp0_80Program2);
 	gl->glDeleteProgram(gpu->monochromeRectangleProgram1);
 	gl->glDeleteProgram(gpu->texturedRectangleProgram1);
 	gl->glDeleteProgram(gpu->texturedPolygonProgram1);
@@ -394,10 +764,64 @@ void GPU_cleanupGL(GPU *gpu)
 	gl->glDeleteProgram(gpu->shadedPolygonProgram1);
 	gl->glDeleteProgram(gpu->monochromePolygonProgram1);
 	gl->glDeleteProgram(gpu->anyLineProgram1);
-	gl->glDeleteProgram(gpu->gp0_02Program);
+	gl->glDeleteProgram(gpu->textureCacheProgram);
+	gl->glDeleteProgram(gpu->vramTransferProgram);
+	GLStateCache_invalidate(gpu->glState);
+	destruct_GLProgramCache(gpu->programCache);
+	gpu->programCache = NULL;
 	
 	// Free allocated memory
-	free(gpu->dmaBuffer);
+	destruct_GuestMemory(gpu->dmaMemory);
+	gpu->dmaMemory = NULL;
+	gpu->dmaBuffer = NULL;
+}
+
+/*
+ * This function tears down the software renderer and the buffers set up for
+ * it by GPU_initSoftRenderer.
+ */
+void GPU_cleanupSoftRenderer(GPU *gpu)
+{
+	// Destroy renderer
+	destruct_SoftRenderer(gpu->softRenderer);
+	gpu->softRenderer = NULL;
+
+	// Free allocated memory, releasing staging slots
+	for (int32_t i = 0; i < GPU_UPLOAD_BUFFER_SLOTS; ++i)
+		atomic_store(&gpu->uploadSlotBusy[i], false);
+	free(gpu->uploadBufferData);
+	gpu->uploadBufferData = NULL;
+	free(gpu->vramReadBufferData);
+	gpu->vramReadBufferData = NULL;
+	destruct_GuestMemory(gpu->dmaMemory);
+	gpu->dmaMemory = NULL;
+	gpu->dmaBuffer = NULL;
+}
+
+/*
+ * This function executes a command taken from the work queue, recording it
+ * as a trace event named after its type. It is intended to be called from
+ * the rendering thread.
+ */
+void GPU_executeCommand(GpuCommand *command)
+{
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	command->functionPointer(command);
+
+#ifdef PHILPSX_TRACE_EVENTS
+	// Record it by type, along with the command byte for those that have
+	// one
+	if (traceStart != 0) {
+		int32_t event = GPU_getTraceEvent(command);
+		int32_t argument = PHILPSX_TRACE_NO_ARGUMENT;
+		if (event != PHILPSX_TRACE_GPU_DISPLAY &&
+				event != PHILPSX_TRACE_GPU_SYNC)
+			argument = logical_rshift(command->parameter1, 24) & 0xFF;
+		PHILPSX_TRACE_END(event, traceStart, argument);
+	}
+#else
+	(void)traceStart;
+#endif
 }
 
 /*
@@ -433,39 +857,142 @@ void GPU_executeGPUCycles(GPU *gpu)
 }
 
 /*
- * This function tells the caller how many gpu cycles should
- * be left after a round of incrementation based on the dotclock timer.
+ * This function waits for the rendering thread to finish everything queued
+ * so far, so that every frame shown has reached the window or frame sink.
+ * It is intended to be called from the emulator thread.
+ */
+void GPU_flushRenderer(GPU *gpu)
+{
+	GPU_queueCommand(gpu, &GPU_flushRenderer_implementation, NULL, 0, true);
+}
+
+/*
+ * This function tells the caller how many GP0 commands have been started so
+ * far, counting each command word (including NOPs) but not the parameters
+ * or image data following it. It is intended to be called from the emulator
+ * thread.
+ */
+int64_t GPU_getCommandCount(GPU *gpu)
+{
+	return gpu->commandCount;
+}
+
+/*
+ * This function tells the caller how many frames have been emulated so far,
+ * counting each vblank. It is intended to be called from the emulator
+ * thread.
+ */
+int64_t GPU_getFrameCount(GPU *gpu)
+{
+	return gpu->frameCount;
+}
+
+/*
+ * This function tells the caller how many nanoseconds of host time the last
+ * emulated frame took, as measured between vblanks while frame pacing is
+ * turned on. It is intended to be called from the emulator thread.
+ */
+int64_t GPU_getLastFrameTime(GPU *gpu)
+{
+	return gpu->lastFrameTime;
+}
+
+/*
+ * This function gives the number of frames shown by the presenting thread so
+ * far, and the number replaced by a newer one before they could be shown.
+ * It returns false if frames aren't shown from a thread of their own.
+ */
+bool GPU_getPresentationStats(GPU *gpu, int64_t *presented, int64_t *dropped)
+{
+	if (!gpu->presenter)
+		return false;
+
+	GLPresenter_getStats(gpu->presenter, presented, dropped);
+	return true;
+}
+
+/*
+ * This function tells the caller how many frames have had their drawing
+ * skipped by frame pacing so far. It is intended to be called from the
+ * emulator thread.
+ */
+int64_t GPU_getSkippedFrameCount(GPU *gpu)
+{
+	return gpu->skippedFrameCount;
+}
+
+/*
+ * This function returns the map of which tiles of vram have been written to,
+ * so that other subsystems can add themselves as clients of it. It is marked
+ * from the rendering thread as each command is carried out.
+ */
+VramDirtyMap *GPU_getVramDirtyMap(GPU *gpu)
+{
+	return gpu->vramDirtyMap;
+}
+
+/*
+ * This function works out a 64-bit FNV-1a hash of the whole of vram, as
+ * 1024x512 little-endian 16-bit pixels, so that runs can be checked against
+ * each other. It must only be called while GP0 is idle, as vram goes through
+ * the GP0(0xC0) read path, and returns 0 if there isn't enough memory.
  */
-int32_t GPU_howManyDotclockGpuCyclesLeft(GPU *gpu, int32_t gpuCycles)
+uint64_t GPU_hashVram(GPU *gpu)
 {
-	return gpuCycles % gpu->dotFactor;
+	uint64_t hash = 0;
+	int8_t *vram = malloc(PHILPSX_GPUTRACE_VRAM_SIZE);
+	if (!vram) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for vram "
+				"hash\n");
+		goto end;
+	}
+	GPU_readVram(gpu, vram);
+
+	hash = 0xCBF29CE484222325ULL;
+	for (int32_t i = 0; i < PHILPSX_GPUTRACE_VRAM_SIZE; ++i) {
+		hash ^= (uint8_t)vram[i];
+		hash *= 0x100000001B3ULL;
+	}
+	free(vram);
+
+	end:
+	return hash;
 }
 
 /*
- * This function tells the caller how many times to increment
- * the dotclock timer if needed.
+ * This function tells the caller how many CPU cycles from now the GPU will
+ * either enter vblank or finish the frame, whichever comes next.
  */
-int32_t GPU_howManyDotclockIncrements(GPU *gpu, int32_t gpuCycles)
+int32_t GPU_howManyCyclesToNextEvent(GPU *gpu)
 {
-	return gpuCycles / gpu->dotFactor;
+	// Get the GPU cycle count we need to pass
+	int32_t targetGpuCycles = gpu->vblankTriggered ?
+			GPU_CYCLES_PER_FRAME : GPU_CYCLES_VBLANK;
+
+	// Convert the GPU cycles left to CPU cycles, rounding up, and take off
+	// any CPU cycles not yet executed
+	int32_t gpuCyclesLeft = targetGpuCycles - gpu->gpuCycles + 1;
+	int32_t cpuCyclesLeft = (gpuCyclesLeft * 7 + 10) / 11 - gpu->cpuCycles;
+
+	return (cpuCyclesLeft < 1) ? 1 : cpuCyclesLeft;
 }
 
 /*
- * This function tells the caller how many gpu cycles should
- * be left after a round of incrementation based on the hblank timer.
+ * This function tells the caller how many gpu cycles each dot takes, for use
+ * by the dotclock timer.
  */
-int32_t GPU_howManyHblankGpuCyclesLeft(GPU *gpu, int32_t gpuCycles)
+int32_t GPU_howManyGpuCyclesPerDot(GPU *gpu)
 {
-	return gpuCycles % GPU_CYCLES_PER_SCANLINE;
+	return gpu->dotFactor;
 }
 
 /*
- * This function tells the caller how many times to increment
- * the hblank timer if needed.
+ * This function tells the caller how many gpu cycles each scanline takes,
+ * for use by the hblank timer.
  */
-int32_t GPU_howManyHblankIncrements(GPU *gpu, int32_t gpuCycles)
+int32_t GPU_howManyGpuCyclesPerScanline(GPU *gpu)
 {
-	return gpuCycles / GPU_CYCLES_PER_SCANLINE;
+	return GPU_CYCLES_PER_SCANLINE;
 }
 
 /*
@@ -477,6 +1004,10 @@ bool GPU_initGL(GPU *gpu)
 	// Get GLFunctionPointers reference
 	GLFunctionPointers *gl = gpu->gl;
 	
+	// Check every GL call during setup, so failures are caught where they
+	// happen
+	gpu->checkOpenGLErrorsPerCall = true;
+	
 	// Allocate required memory areas, including buffer to store DMA data
 	// for transfer to/from the GPU
 	int8_t *initialImage = calloc(1024 * 512 * 4, sizeof(int8_t));
@@ -485,12 +1016,13 @@ bool GPU_initGL(GPU *gpu)
 				"initialImage\n");
 		goto cleanup_memory;
 	}
-	gpu->dmaBuffer = calloc(1024 * 512 * 4, sizeof(int8_t));
-	if (!gpu->dmaBuffer) {
+	gpu->dmaMemory = construct_GuestMemory(&GPU_dmaBufferSize, 1);
+	if (!gpu->dmaMemory) {
 		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for "
 				"dmaBuffer\n");
 		goto cleanup_memory;
 	}
+	gpu->dmaBuffer = GuestMemory_getRegion(gpu->dmaMemory, 0);
 
 	// Setup vertex array object and bind it
 	gl->glCreateVertexArrays(1, gpu->vertexArrayObject);
@@ -512,12 +1044,35 @@ bool GPU_initGL(GPU *gpu)
 								"glDisable called"))
 		goto cleanup_delete_vao;
 
+	// Allow upload rows that are an odd number of 16-bit pixels wide
+	gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glPixelStorei called"))
+		goto cleanup_delete_vao;
+
+	// Check for fragment shader interlock, which keeps accesses to each
+	// pixel in primitive order within a draw call
+	GLint extensionCount = 0;
+	gl->glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glGetIntegerv called"))
+		goto cleanup_delete_vao;
+	gpu->fragmentShaderInterlock = false;
+	for (GLint i = 0; i < extensionCount; ++i) {
+		const char *extension =
+				(const char *)gl->glGetStringi(GL_EXTENSIONS, i);
+		if (strcmp(extension, "GL_ARB_fragment_shader_interlock") == 0) {
+			gpu->fragmentShaderInterlock = true;
+			break;
+		}
+	}
+
 	// Create and bind vram texture - this will be what we draw to
 	gl->glCreateTextures(GL_TEXTURE_2D, 1, gpu->vramTexture);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glCreateTextures called"))
 		goto cleanup_delete_vao;
-	gl->glActiveTexture(GL_TEXTURE0);
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE0);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glActiveTexture called"))
 		goto cleanup_delete_vram_texture;
@@ -552,7 +1107,8 @@ bool GPU_initGL(GPU *gpu)
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glCreateFramebuffers called"))
 		goto cleanup_delete_vram_texture;
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->vramFramebuffer[0]);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glBindFramebuffer called"))
 		goto cleanup_delete_vram_framebuffer;
@@ -566,7 +1122,7 @@ bool GPU_initGL(GPU *gpu)
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glDrawBuffers called"))
 		goto cleanup_delete_vram_framebuffer;
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER, 0);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glBindFramebuffer called"))
 		goto cleanup_delete_vram_framebuffer;
@@ -576,7 +1132,8 @@ bool GPU_initGL(GPU *gpu)
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glCreateFramebuffers called"))
 		goto cleanup_delete_vram_framebuffer;
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->emptyFramebuffer[0]);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glBindFramebuffer called"))
 		goto cleanup_delete_empty_framebuffer;
@@ -590,7 +1147,7 @@ bool GPU_initGL(GPU *gpu)
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glFramebufferParameteri called"))
 		goto cleanup_delete_empty_framebuffer;
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER, 0);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glBindFramebuffer called"))
 		goto cleanup_delete_empty_framebuffer;
@@ -600,7 +1157,7 @@ bool GPU_initGL(GPU *gpu)
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glCreateTextures called"))
 		goto cleanup_delete_empty_framebuffer;
-	gl->glActiveTexture(GL_TEXTURE1);
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE1);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glActiveTexture called"))
 		goto cleanup_delete_tempdraw_texture;
@@ -636,7 +1193,8 @@ bool GPU_initGL(GPU *gpu)
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glCreateFramebuffers called"))
 		goto cleanup_delete_tempdraw_texture;
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->tempDrawFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->tempDrawFramebuffer[0]);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glBindFramebuffer called"))
 		goto cleanup_delete_tempdraw_framebuffer;
@@ -650,38 +1208,156 @@ bool GPU_initGL(GPU *gpu)
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glDrawBuffers called"))
 		goto cleanup_delete_tempdraw_framebuffer;
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER, 0);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
 								"glBindFramebuffer called"))
 		goto cleanup_delete_tempdraw_framebuffer;
 
-	// Create the CLUT buffer
-	gl->glCreateBuffers(1, gpu->clutBuffer);
+	// Create texture cache texture, with one layer per entry, and leave it
+	// bound to texture unit 2 for the textured primitive shaders
+	gl->glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, gpu->textureCacheTexture);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
-								"glCreateBuffers called"))
+								"glCreateTextures called"))
 		goto cleanup_delete_tempdraw_framebuffer;
-	gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gpu->clutBuffer[0]);
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE2);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glActiveTexture called"))
+		goto cleanup_delete_texture_cache_texture;
+	gl->glBindTexture(GL_TEXTURE_2D_ARRAY, gpu->textureCacheTexture[0]);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glBindTexture called"))
+		goto cleanup_delete_texture_cache_texture;
+	gl->glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8UI, 256, 256,
+			GPU_TEXTURE_CACHE_ENTRIES);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glTexStorage3D called"))
+		goto cleanup_delete_texture_cache_texture;
+	gl->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER,
+			GL_NEAREST);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glTexParameteri called"))
+		goto cleanup_delete_texture_cache_texture;
+	gl->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+			GL_NEAREST);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glTexParameteri called"))
+		goto cleanup_delete_texture_cache_texture;
+
+	// Create framebuffer object for decoding pages into the texture cache -
+	// the right layer is attached each time
+	gl->glCreateFramebuffers(1, gpu->textureCacheFramebuffer);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glCreateFramebuffers called"))
+		goto cleanup_delete_texture_cache_texture;
+
+	// Create the vertex buffer for batched primitives, and map it
+	// persistently so vertices can be written straight into it
+	gl->glCreateBuffers(1, gpu->vertexBuffer);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glCreateBuffers called"))
+		goto cleanup_delete_texture_cache_framebuffer;
+	GLsizeiptr vertexBufferSize = GPU_VERTEX_BUFFER_SEGMENTS *
+			GPU_VERTEX_BUFFER_SEGMENT_SIZE * sizeof(GpuVertex);
+	GLbitfield vertexBufferFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+			GL_MAP_COHERENT_BIT;
+	gl->glNamedBufferStorage(gpu->vertexBuffer[0], vertexBufferSize, NULL,
+			vertexBufferFlags);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glNamedBufferStorage called"))
+		goto cleanup_delete_vertex_buffer;
+	gpu->vertexBufferData = gl->glMapNamedBufferRange(gpu->vertexBuffer[0], 0,
+			vertexBufferSize, vertexBufferFlags);
+	if (!gpu->vertexBufferData) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't map vertex buffer\n");
+		goto cleanup_delete_vertex_buffer;
+	}
+
+	// Describe the vertex layout to the vertex array object
+	gl->glVertexArrayVertexBuffer(gpu->vertexArrayObject[0], 0,
+			gpu->vertexBuffer[0], 0, sizeof(GpuVertex));
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glVertexArrayVertexBuffer called"))
+		goto cleanup_delete_vertex_buffer;
+	const GLint attributeSizes[] = {2, 3, 2, 4, 4, 1};
+	const GLuint attributeOffsets[] = {
+		offsetof(GpuVertex, position),
+		offsetof(GpuVertex, colour),
+		offsetof(GpuVertex, texCoord),
+		offsetof(GpuVertex, primitive1),
+		offsetof(GpuVertex, primitive2),
+		offsetof(GpuVertex, textureCacheLayer)
+	};
+	for (GLuint i = 0; i < 6; ++i) {
+		gl->glVertexArrayAttribIFormat(gpu->vertexArrayObject[0], i,
+				attributeSizes[i], GL_INT, attributeOffsets[i]);
+		gl->glVertexArrayAttribBinding(gpu->vertexArrayObject[0], i, 0);
+		gl->glEnableVertexArrayAttrib(gpu->vertexArrayObject[0], i);
+	}
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
-								"glBindBufferBase called"))
-		goto cleanup_delete_clut_buffer;
-	gl->glBufferStorage(GL_SHADER_STORAGE_BUFFER, 256 * 4 * 4, NULL,
-			GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+								"vertex attributes set"))
+		goto cleanup_delete_vertex_buffer;
+
+	// Create the pixel pack buffer for vram reads, and map it persistently
+	// so completed reads can be copied straight out of it
+	gl->glCreateBuffers(1, gpu->vramReadBuffer);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glCreateBuffers called"))
+		goto cleanup_delete_vertex_buffer;
+	GLsizeiptr vramReadBufferSize = 1024 * 512 * 4;
+	GLbitfield vramReadBufferFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT |
+			GL_MAP_COHERENT_BIT;
+	gl->glNamedBufferStorage(gpu->vramReadBuffer[0], vramReadBufferSize,
+			NULL, vramReadBufferFlags);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glNamedBufferStorage called"))
+		goto cleanup_delete_vram_read_buffer;
+	gpu->vramReadBufferData = gl->glMapNamedBufferRange(
+			gpu->vramReadBuffer[0], 0, vramReadBufferSize,
+			vramReadBufferFlags);
+	if (!gpu->vramReadBufferData) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't map vram read buffer\n");
+		goto cleanup_delete_vram_read_buffer;
+	}
+
+	// Create the pixel unpack buffer for uploads, and map it persistently
+	// so the emulator can write transfers straight into it
+	gl->glCreateBuffers(1, gpu->uploadBuffer);
+	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
+								"glCreateBuffers called"))
+		goto cleanup_delete_vram_read_buffer;
+	GLsizeiptr uploadBufferSize = GPU_UPLOAD_BUFFER_SLOTS *
+			GPU_UPLOAD_BUFFER_SLOT_SIZE;
+	GLbitfield uploadBufferFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+			GL_MAP_COHERENT_BIT;
+	gl->glNamedBufferStorage(gpu->uploadBuffer[0], uploadBufferSize, NULL,
+			uploadBufferFlags);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_initGL function, "
-								"glBufferStorage called"))
-		goto cleanup_delete_clut_buffer;
+								"glNamedBufferStorage called"))
+		goto cleanup_delete_upload_buffer;
+	gpu->uploadBufferData = gl->glMapNamedBufferRange(gpu->uploadBuffer[0], 0,
+			uploadBufferSize, uploadBufferFlags);
+	if (!gpu->uploadBufferData) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't map upload buffer\n");
+		goto cleanup_delete_upload_buffer;
+	}
+
+	// Setup program cache, so shader programs can be loaded from disk
+	// rather than compiled where possible
+	gpu->programCache = construct_GLProgramCache(gl);
+	if (!gpu->programCache) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't construct GLProgramCache\n");
+		goto cleanup_delete_upload_buffer;
+	}
 
 	// Create shader programs
 	if ((gpu->displayScreenProgram =
 			GPU_createShaderProgram(gpu, "DisplayScreen", 1)) == 0)
-		goto cleanup_delete_clut_buffer;
-	if ((gpu->gp0_a0Program =
-			GPU_createShaderProgram(gpu, "GP0_A0", 1)) == 0)
 		goto cleanup_shader_programs;
-	if ((gpu->gp0_80Program1 =
-			GPU_createShaderProgram(gpu, "GP0_80", 1)) == 0)
+	if ((gpu->displayConvertProgram =
+			GPU_createShaderProgram(gpu, "DisplayScreen", 2)) == 0)
 		goto cleanup_shader_programs;
-	if ((gpu->gp0_80Program2 =
-			GPU_createShaderProgram(gpu, "GP0_80", 2)) == 0)
+	if ((gpu->gp0_a0Program =
+			GPU_createShaderProgram(gpu, "GP0_A0", 1)) == 0)
 		goto cleanup_shader_programs;
 	if ((gpu->monochromeRectangleProgram1 =
 			GPU_createShaderProgram(gpu, "MonochromeRectangle", 1)) == 0)
@@ -704,18 +1380,46 @@ bool GPU_initGL(GPU *gpu)
 	if ((gpu->anyLineProgram1 =
 			GPU_createShaderProgram(gpu, "AnyLine", 1)) == 0)
 		goto cleanup_shader_programs;
-	if ((gpu->gp0_02Program =
-			GPU_createShaderProgram(gpu, "GP0_02", 1)) == 0)
+	if ((gpu->textureCacheProgram =
+			GPU_createShaderProgram(gpu, "TextureCache", 1)) == 0)
+		goto cleanup_shader_programs;
+	if ((gpu->vramTransferProgram =
+			GPU_createShaderProgram(gpu, "VramTransfer", 1)) == 0)
 		goto cleanup_shader_programs;
 	
+	// Hand error reporting over to the KHR_debug callback (core since 4.3)
+	// now that setup is done, and stop checking after every call
+#ifdef PHILPSX_DEBUG_BUILD
+	gl->glEnable(GL_DEBUG_OUTPUT);
+	gl->glDebugMessageCallback(&GPU_debugMessageCallback, gpu);
+	gpu->openGLDebugOutput = !GPU_realCheckOpenGLErrors(gpu,
+			"GPU_initGL function, debug output enabled");
+#endif
+	gpu->checkOpenGLErrorsPerCall = false;
+	
 	// Normal path:
 	free(initialImage);
 	return true;
 	
 	// Cleanup path (we don't bother with logging these GL calls,
 	// as at this point there is nothing we can do to rollback anyway):
-	cleanup_delete_clut_buffer:
-	gl->glDeleteBuffers(1, gpu->clutBuffer);
+	cleanup_delete_upload_buffer:
+	gl->glDeleteBuffers(1, gpu->uploadBuffer);
+	gpu->uploadBufferData = NULL;
+	
+	cleanup_delete_vram_read_buffer:
+	gl->glDeleteBuffers(1, gpu->vramReadBuffer);
+	gpu->vramReadBufferData = NULL;
+	
+	cleanup_delete_vertex_buffer:
+	gl->glDeleteBuffers(1, gpu->vertexBuffer);
+	gpu->vertexBufferData = NULL;
+	
+	cleanup_delete_texture_cache_framebuffer:
+	gl->glDeleteFramebuffers(1, gpu->textureCacheFramebuffer);
+	
+	cleanup_delete_texture_cache_texture:
+	gl->glDeleteTextures(1, gpu->textureCacheTexture);
 	
 	cleanup_delete_tempdraw_framebuffer:
 	gl->glDeleteFramebuffers(1, gpu->tempDrawFramebuffer);
@@ -738,12 +1442,10 @@ bool GPU_initGL(GPU *gpu)
 	cleanup_shader_programs:
 	if (gpu->displayScreenProgram != 0)
 		gl->glDeleteProgram(gpu->displayScreenProgram);
+	if (gpu->displayConvertProgram != 0)
+		gl->glDeleteProgram(gpu->displayConvertProgram);
 	if (gpu->gp0_a0Program != 0)
 		gl->glDeleteProgram(gpu->gp0_a0Program);
-	if (gpu->gp0_80Program1 != 0)
-		gl->glDeleteProgram(gpu->gp0_80Program1);
-	if (gpu->gp0_80Program2 != 0)
-		gl->glDeleteProgram(gpu->gp0_80Program2);
 	if (gpu->monochromeRectangleProgram1 != 0)
 		gl->glDeleteProgram(gpu->monochromeRectangleProgram1);
 	if (gpu->texturedRectangleProgram1 != 0)
@@ -758,18 +1460,93 @@ bool GPU_initGL(GPU *gpu)
 		gl->glDeleteProgram(gpu->monochromePolygonProgram1);
 	if (gpu->anyLineProgram1 != 0)
 		gl->glDeleteProgram(gpu->anyLineProgram1);
-	if (gpu->gp0_02Program != 0)
-		gl->glDeleteProgram(gpu->gp0_02Program);
+	if (gpu->textureCacheProgram != 0)
+		gl->glDeleteProgram(gpu->textureCacheProgram);
+	if (gpu->vramTransferProgram != 0)
+		gl->glDeleteProgram(gpu->vramTransferProgram);
+	if (gpu->programCache) {
+		destruct_GLProgramCache(gpu->programCache);
+		gpu->programCache = NULL;
+	}
 	
 	cleanup_memory:
 	if (initialImage)
 		free(initialImage);
-	if (gpu->dmaBuffer)
-		free(gpu->dmaBuffer);
+	if (gpu->dmaMemory) {
+		destruct_GuestMemory(gpu->dmaMemory);
+		gpu->dmaMemory = NULL;
+		gpu->dmaBuffer = NULL;
+	}
 	
 	return false;
 }
 
+/*
+ * This function sets up the software renderer, for drawing without OpenGL.
+ * It is called instead of GPU_initGL, with the same buffers for DMA, uploads
+ * and vram reads held in ordinary memory.
+ */
+bool GPU_initSoftRenderer(GPU *gpu)
+{
+	// Allocate required memory areas, including buffer to store DMA data
+	// for transfer to/from the GPU
+	gpu->dmaMemory = construct_GuestMemory(&GPU_dmaBufferSize, 1);
+	if (!gpu->dmaMemory) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for "
+				"dmaBuffer\n");
+		goto end;
+	}
+	gpu->dmaBuffer = GuestMemory_getRegion(gpu->dmaMemory, 0);
+	gpu->uploadBufferData = malloc(GPU_UPLOAD_BUFFER_SLOTS *
+			GPU_UPLOAD_BUFFER_SLOT_SIZE);
+	if (!gpu->uploadBufferData) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for "
+				"uploadBufferData\n");
+		goto cleanup_dmabuffer;
+	}
+	gpu->vramReadBufferData = calloc(1024 * 512 * 4, sizeof(int8_t));
+	if (!gpu->vramReadBufferData) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for "
+				"vramReadBufferData\n");
+		goto cleanup_uploadbuffer;
+	}
+
+	// Create renderer
+	gpu->softRenderer = construct_SoftRenderer(gpu->vramDirtyMap);
+	if (!gpu->softRenderer)
+		goto cleanup_vramreadbuffer;
+
+	// Normal return:
+	return true;
+
+	// Cleanup path:
+	cleanup_vramreadbuffer:
+	free(gpu->vramReadBufferData);
+	gpu->vramReadBufferData = NULL;
+
+	cleanup_uploadbuffer:
+	free(gpu->uploadBufferData);
+	gpu->uploadBufferData = NULL;
+
+	cleanup_dmabuffer:
+	destruct_GuestMemory(gpu->dmaMemory);
+	gpu->dmaMemory = NULL;
+	gpu->dmaBuffer = NULL;
+
+	end:
+	return false;
+}
+
+/*
+ * This function tells us whether GP0 is between commands, with no transfer
+ * to or from vram under way, which the GPU must be for its state to be saved
+ * or loaded. It is intended to be called from the emulator thread.
+ */
+bool GPU_isIdle(GPU *gpu)
+{
+	return GPU_isGP0Idle(gpu);
+}
+
 /*
  * This function tells us whether the GPU is in hblank phase of scanline.
  */
@@ -797,6 +1574,72 @@ bool GPU_isInVblank(GPU *gpu)
 	return gpu->gpuCycles > GPU_CYCLES_VBLANK;
 }
 
+/*
+ * This function reads the GPU's state back from a save state, in the order
+ * GPU_saveState wrote it, uploading the parts of vram that differ. It must
+ * only be called while GP0 is idle, and is intended to be called from the
+ * emulator thread.
+ */
+void GPU_loadState(GPU *gpu, SaveState *state)
+{
+	// Line packet and command fifo
+	SaveState_read(state, gpu->lineWords, sizeof(gpu->lineWords));
+	SaveState_read(state, &gpu->lineWordCount, sizeof(int32_t));
+	SaveState_read(state, gpu->fifoBuffer, sizeof(gpu->fifoBuffer));
+	SaveState_read(state, &gpu->commandsInFifo, sizeof(int32_t));
+	if (gpu->lineWordCount < 0 ||
+			gpu->lineWordCount > GPU_LINE_PACKET_WORDS ||
+			gpu->commandsInFifo < 0 || gpu->commandsInFifo > 16) {
+		SaveState_fail(state);
+		gpu->lineWordCount = 0;
+		gpu->commandsInFifo = 0;
+	}
+
+	// Registers
+	SaveState_read(state, &gpu->statusRegister, sizeof(int32_t));
+	SaveState_read(state, &gpu->xStart, sizeof(int32_t));
+	SaveState_read(state, &gpu->yStart, sizeof(int32_t));
+	SaveState_read(state, &gpu->x1, sizeof(int32_t));
+	SaveState_read(state, &gpu->x2, sizeof(int32_t));
+	SaveState_read(state, &gpu->y1, sizeof(int32_t));
+	SaveState_read(state, &gpu->y2, sizeof(int32_t));
+	SaveState_read(state, &gpu->textureWindow, sizeof(int32_t));
+	SaveState_read(state, &gpu->drawingAreaTopLeft, sizeof(int32_t));
+	SaveState_read(state, &gpu->drawingAreaBottomRight, sizeof(int32_t));
+	SaveState_read(state, &gpu->drawingOffset, sizeof(int32_t));
+	SaveState_read(state, &gpu->gpureadLatchValue, sizeof(int32_t));
+	SaveState_read(state, &gpu->gpureadLatched, sizeof(bool));
+
+	// Timing, and the values worked out from the display mode
+	SaveState_read(state, &gpu->cpuCycles, sizeof(int32_t));
+	SaveState_read(state, &gpu->gpuCycles, sizeof(int32_t));
+	SaveState_read(state, &gpu->oddOrEven, sizeof(int32_t));
+	SaveState_read(state, &gpu->horizontalRes, sizeof(int32_t));
+	SaveState_read(state, &gpu->verticalRes, sizeof(int32_t));
+	SaveState_read(state, &gpu->dotFactor, sizeof(int32_t));
+	SaveState_read(state, &gpu->interlaceEnabled, sizeof(bool));
+	SaveState_read(state, &gpu->vblankTriggered, sizeof(bool));
+	if (gpu->dotFactor <= 0) {
+		SaveState_fail(state);
+		gpu->dotFactor = 1;
+	}
+
+	// Nothing can be in flight, as the state was saved while GP0 was idle
+	gpu->dmaReadInProgress = -1;
+	gpu->dmaWriteInProgress = -1;
+	gpu->renderStateChanged = true;
+
+	// Vram, replacing it and everything derived from it on the rendering
+	// thread
+	gpu->stateVram = (int8_t *)SaveState_readRegion(state,
+			PHILPSX_GPUTRACE_VRAM_SIZE);
+	if (gpu->stateVram) {
+		GPU_queueCommand(gpu, &GPU_writeVramState_implementation, NULL, 0,
+				true);
+		gpu->stateVram = NULL;
+	}
+}
+
 /*
  * This function retrieves command responses.
  */
@@ -804,6 +1647,8 @@ int32_t GPU_readResponse(GPU *gpu)
 {
 	// Sync up to CPU
 	GPU_executeGPUCycles(gpu);
+	if (gpu->trace)
+		GPU_recordTrace(gpu, PHILPSX_GPUTRACE_READ, 0);
 
 	// Declare return value
 	int32_t retVal = 0;
@@ -813,9 +1658,7 @@ int32_t GPU_readResponse(GPU *gpu)
 			if (gpu->dmaBufferIndex == 0) {
 				switch (gpu->dmaReadInProgress) {
 					case 0xC0: // GP0(0xC0): copy rectangle (VRAM to CPU)
-						GPU_GP0_C0(gpu, gpu->fifoBuffer[0],
-								gpu->fifoBuffer[1], gpu->fifoBuffer[2]);
-						GPU_GP1_01(gpu, 0);
+						GPU_waitForVramRead(gpu);
 						break;
 				}
 			}
@@ -833,13 +1676,10 @@ int32_t GPU_readResponse(GPU *gpu)
 					+ tempRowPixelOffset;
 
 			// Organise bytes into original structure
-			retVal = (int32_t)((int64_t)(GPU_readDMABuffer(gpu, pixelIndex + 3)
-						& 0x1) << 31);
-			retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 2) & 0x1F) << 26;
-			retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 1) & 0x1F) << 21;
-			retVal |= (GPU_readDMABuffer(gpu, pixelIndex) & 0x1F) << 16;
-			retVal = logical_rshift((retVal & 0xFF000000), 8) |
-					((retVal & 0xFF0000) << 8);
+			retVal = (GPU_readDMABuffer(gpu, pixelIndex + 3) & 0x1) << 15;
+			retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 2) & 0x1F) << 10;
+			retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 1) & 0x1F) << 5;
+			retVal |= GPU_readDMABuffer(gpu, pixelIndex) & 0x1F;
 
 			// Increment dmaBufferIndex by 4
 			gpu->dmaBufferIndex += 4;
@@ -856,13 +1696,11 @@ int32_t GPU_readResponse(GPU *gpu)
 							 + tempRowPixelOffset;
 
 				// Organise bytes into original structure
-				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 3) & 0x1) << 15;
-				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 2) & 0x1F) << 10;
-				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 1) & 0x1F) << 5;
-				retVal |= GPU_readDMABuffer(gpu, pixelIndex) & 0x1F;
-				retVal = (retVal & 0xFFFF0000) |
-						 logical_rshift((retVal & 0xFF00), 8) |
-						 ((retVal & 0xFF) << 8);
+				retVal |= (int32_t)((int64_t)(GPU_readDMABuffer(gpu,
+						pixelIndex + 3) & 0x1) << 31);
+				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 2) & 0x1F) << 26;
+				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 1) & 0x1F) << 21;
+				retVal |= (GPU_readDMABuffer(gpu, pixelIndex) & 0x1F) << 16;
 				gpu->dmaBufferIndex += 4;
 			}
 
@@ -883,12 +1721,6 @@ int32_t GPU_readResponse(GPU *gpu)
 			if (gpu->gpureadLatched) {
 				retVal = gpu->gpureadLatchValue;
 			}
-
-			// Reverse endianness as we are dealing with a register value
-			retVal = ((retVal << 24) & 0xFF000000) |
-					 ((retVal << 8) & 0xFF0000) |
-					 (logical_rshift(retVal, 8) & 0xFF00) |
-					 (logical_rshift(retVal, 24) & 0xFF);
 			break;
 	}
 
@@ -946,10 +1778,215 @@ int32_t GPU_readStatus(GPU *gpu)
 
 	tempStatus |= mergeVal;
 
-	return ((tempStatus << 24) & 0xFF000000) |
-			((tempStatus << 8) & 0xFF0000) |
-			(logical_rshift(tempStatus, 8) & 0xFF00) |
-			(logical_rshift(tempStatus, 24) & 0xFF);
+	return tempStatus;
+}
+
+/*
+ * This function replays a trace written by GPU_startTrace, putting its vram
+ * snapshot in place and then submitting its words as the emulator did, with
+ * the renderer brought to a finish at the end of every frame. Once done, it
+ * reports how long frames took to draw. With serialise set, the renderer is
+ * also brought to a finish after every GP0 command, so the time each
+ * category of command takes can be reported too - frame times then include
+ * the cost of waiting. It is intended to be called from the emulator thread
+ * of a GPU that has nothing else submitting to it, and returns false if the
+ * trace couldn't be read.
+ */
+bool GPU_replayTrace(GPU *gpu, const char *path, bool serialise)
+{
+	static const char *categoryNames[GPU_REPLAY_CATEGORIES] = {
+		"fill", "polygon", "line", "rectangle", "VRAM copy", "CPU to VRAM",
+		"VRAM to CPU", "other"
+	};
+
+	// Declare return value
+	bool retVal = false;
+
+	// Read snapshot into a GP0(0xA0) copy covering the whole of vram
+	int8_t *upload = malloc(PHILPSX_GPUTRACE_VRAM_SIZE + 12);
+	if (!upload) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for trace "
+				"replay\n");
+		goto end;
+	}
+	GpuTrace *trace = construct_GpuTrace(path, upload + 12, false);
+	if (!trace)
+		goto cleanup_upload;
+	write_le_word(upload, 0xA0000000);
+	write_le_word(upload + 4, 0);
+	write_le_word(upload + 8, 0x02000400);
+	GPU_submitToGP0Block(gpu, upload, PHILPSX_GPUTRACE_VRAM_SIZE / 4 + 3);
+	GPU_syncRenderer(gpu);
+
+	// Submit records, timing frames and (when serialising) commands
+	int64_t categoryTimes[GPU_REPLAY_CATEGORIES] = {0};
+	int64_t categoryCounts[GPU_REPLAY_CATEGORIES] = {0};
+	int64_t frames = 0;
+	int64_t shortestFrame = INT64_MAX;
+	int64_t longestFrame = 0;
+	int64_t startTime = GPU_getTime();
+	int64_t frameStart = startTime;
+	int64_t commandStart = 0;
+	int32_t commandByte = -1;
+	int32_t type, word;
+	while (GpuTrace_readRecord(trace, &type, &word)) {
+		switch (type) {
+			case PHILPSX_GPUTRACE_GP0:
+				if (serialise && commandByte == -1 && GPU_isGP0Idle(gpu)) {
+					commandByte = logical_rshift(word, 24) & 0xFF;
+					commandStart = GPU_getTime();
+				}
+				GPU_submitToGP0(gpu, word);
+				break;
+			case PHILPSX_GPUTRACE_GP1:
+				GPU_submitToGP1(gpu, word);
+				break;
+			case PHILPSX_GPUTRACE_READ:
+				GPU_readResponse(gpu);
+				break;
+			case PHILPSX_GPUTRACE_FRAME:
+			{
+				if (gpu->presentationEnabled)
+					GPU_displayScreen(gpu);
+				GPU_syncRenderer(gpu);
+				int64_t frameEnd = GPU_getTime();
+				int64_t frameTime = frameEnd - frameStart;
+				shortestFrame = min_value(shortestFrame, frameTime);
+				longestFrame = max_value(longestFrame, frameTime);
+				frameStart = frameEnd;
+				++frames;
+			}
+			break;
+		}
+
+		// Finish a command on the renderer once GP0 has taken all of it,
+		// counting it under its category
+		if (commandByte != -1 && GPU_isGP0Idle(gpu)) {
+			GPU_syncRenderer(gpu);
+			int32_t category = GPU_REPLAY_CATEGORIES - 1;
+			if (commandByte == 0x02)
+				category = 0;
+			else if (commandByte >= 0x20 && commandByte < 0xE0)
+				category = commandByte / 0x20;
+			categoryTimes[category] += GPU_getTime() - commandStart;
+			++categoryCounts[category];
+			commandByte = -1;
+		}
+	}
+	int64_t totalTime = GPU_getTime() - startTime;
+
+	// Report timings
+	printf("PhilPSX: GPU: Replayed %ld frames in %ld ms\n", frames,
+			totalTime / 1000000);
+	if (frames > 0)
+		printf("PhilPSX: GPU: Frame times (ms): shortest %.3f, mean %.3f, "
+				"longest %.3f\n", shortestFrame / 1000000.0,
+				totalTime / 1000000.0 / frames, longestFrame / 1000000.0);
+	for (int32_t i = 0; serialise && i < GPU_REPLAY_CATEGORIES; ++i) {
+		if (categoryCounts[i] == 0)
+			continue;
+		printf("PhilPSX: GPU: %-12s %9ld commands, %10.3f ms total, "
+				"%8.3f us each\n", categoryNames[i], categoryCounts[i],
+				categoryTimes[i] / 1000000.0,
+				categoryTimes[i] / 1000.0 / categoryCounts[i]);
+	}
+	retVal = true;
+
+	// Cleanup path:
+	destruct_GpuTrace(trace);
+
+	cleanup_upload:
+	free(upload);
+
+	end:
+	return retVal;
+}
+
+/*
+ * This function writes the GPU's state to a save state - its registers,
+ * timing and the whole of vram, of which only the parts written since the
+ * last save state are read back. It must only be called while GP0 is idle,
+ * and is intended to be called from the emulator thread.
+ */
+void GPU_saveState(GPU *gpu, SaveState *state)
+{
+	// Line packet and command fifo
+	SaveState_write(state, gpu->lineWords, sizeof(gpu->lineWords));
+	SaveState_write(state, &gpu->lineWordCount, sizeof(int32_t));
+	SaveState_write(state, gpu->fifoBuffer, sizeof(gpu->fifoBuffer));
+	SaveState_write(state, &gpu->commandsInFifo, sizeof(int32_t));
+
+	// Registers
+	SaveState_write(state, &gpu->statusRegister, sizeof(int32_t));
+	SaveState_write(state, &gpu->xStart, sizeof(int32_t));
+	SaveState_write(state, &gpu->yStart, sizeof(int32_t));
+	SaveState_write(state, &gpu->x1, sizeof(int32_t));
+	SaveState_write(state, &gpu->x2, sizeof(int32_t));
+	SaveState_write(state, &gpu->y1, sizeof(int32_t));
+	SaveState_write(state, &gpu->y2, sizeof(int32_t));
+	SaveState_write(state, &gpu->textureWindow, sizeof(int32_t));
+	SaveState_write(state, &gpu->drawingAreaTopLeft, sizeof(int32_t));
+	SaveState_write(state, &gpu->drawingAreaBottomRight, sizeof(int32_t));
+	SaveState_write(state, &gpu->drawingOffset, sizeof(int32_t));
+	SaveState_write(state, &gpu->gpureadLatchValue, sizeof(int32_t));
+	SaveState_write(state, &gpu->gpureadLatched, sizeof(bool));
+
+	// Timing, and the values worked out from the display mode
+	SaveState_write(state, &gpu->cpuCycles, sizeof(int32_t));
+	SaveState_write(state, &gpu->gpuCycles, sizeof(int32_t));
+	SaveState_write(state, &gpu->oddOrEven, sizeof(int32_t));
+	SaveState_write(state, &gpu->horizontalRes, sizeof(int32_t));
+	SaveState_write(state, &gpu->verticalRes, sizeof(int32_t));
+	SaveState_write(state, &gpu->dotFactor, sizeof(int32_t));
+	SaveState_write(state, &gpu->interlaceEnabled, sizeof(bool));
+	SaveState_write(state, &gpu->vblankTriggered, sizeof(bool));
+
+	// Vram, read back straight into the state on the rendering thread
+	gpu->stateVram = SaveState_reserve(state, PHILPSX_GPUTRACE_VRAM_SIZE);
+	if (gpu->stateVram) {
+		GPU_queueCommand(gpu, &GPU_readVramState_implementation, NULL, 0,
+				true);
+		gpu->stateVram = NULL;
+	}
+}
+
+/*
+ * This function sets whether drawing primitives are dropped from every frame,
+ * starting straight away, for frames that are run ahead of the real timeline
+ * and then rolled back. Vram transfers and fills still go through, as with
+ * frame skipping. It is intended to be called from the emulator thread.
+ */
+void GPU_setDrawingSuppressed(GPU *gpu, bool suppressed)
+{
+	gpu->drawingSuppressed = suppressed;
+	gpu->frameSkipped = suppressed;
+}
+
+/*
+ * This function sets a function to be handed each frame shown, as 32-bit
+ * ARGB pixels, in place of the window. The frame sink is called from the
+ * rendering thread, and only the software renderer uses it. Passing NULL
+ * shows frames in the window again.
+ */
+void GPU_setFrameSink(GPU *gpu,
+		void (*frameSink)(void *userData, const uint32_t *pixels,
+		int32_t width, int32_t height), void *userData)
+{
+	gpu->frameSink = frameSink;
+	gpu->frameSinkData = userData;
+}
+
+/*
+ * This function sets how many frames in a row frame pacing may skip the
+ * drawing of when the host falls behind, with 0 turning it off. It is
+ * intended to be called from the emulator thread.
+ */
+void GPU_setFrameskip(GPU *gpu, int32_t maxSkippedFrames)
+{
+	gpu->maxSkippedFrames = max_value(maxSkippedFrames, 0);
+	gpu->consecutiveSkippedFrames = 0;
+	gpu->frameSkipped = false;
+	gpu->frameDeadline = 0;
 }
 
 /*
@@ -967,6 +2004,26 @@ void GPU_setGLFunctionPointers(GPU *gpu)
 void GPU_setMemoryInterface(GPU *gpu, SystemInterlink *smi)
 {
 	gpu->system = smi;
+
+	// Install handlers for the GP0 and GP1 registers, which ignore writes
+	// narrower than a word
+	SystemInterlink_registerIoHandlers(smi, 0x1F801810, 0x8,
+			PHILPSX_IO_BYTE, gpu, GPU_readRegisterByte, NULL);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801810, 0x8,
+			PHILPSX_IO_HALFWORD, gpu, GPU_readRegisterHalfWord, NULL);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801810, 0x8,
+			PHILPSX_IO_WORD, gpu, GPU_readRegisterWord,
+			GPU_writeRegisterWord);
+}
+
+/*
+ * This function sets whether each frame is shown in the window. With it
+ * turned off, frames are still drawn into vram but the display step is
+ * skipped entirely, so nothing waits on the window.
+ */
+void GPU_setPresentationEnabled(GPU *gpu, bool enabled)
+{
+	gpu->presentationEnabled = enabled;
 }
 
 /*
@@ -977,14 +2034,27 @@ void GPU_setResolution(GPU *gpu, int32_t horizontal, int32_t vertical)
 {
 	gpu->realHorizontalRes = horizontal;
 	gpu->realVerticalRes = vertical;
+	gpu->renderStateChanged = true;
 }
 
 /*
- * This function sets the SDL_Window reference inside the GPU object.
+ * This function sets the SDL_Window reference inside the GPU object. When
+ * GL is in use, it also starts presenting frames from a thread of their
+ * own, which needs the GL context to be current on the calling thread.
  */
 void GPU_setSDLWindowReference(GPU *gpu, SDL_Window *window)
 {
 	gpu->window = window;
+
+	// Fall back to drawing straight into the window if we can't present
+	// from a thread
+	if (window && gpu->programCache && !gpu->presenter) {
+		gpu->presenter = construct_GLPresenter(gpu->gl, window);
+		if (!gpu->presenter)
+			fprintf(stderr, "PhilPSX: GPU: Couldn't start presenting "
+					"thread, so presenting from the rendering thread "
+					"instead\n");
+	}
 }
 
 /*
@@ -996,6 +2066,25 @@ void GPU_setWorkQueue(GPU *gpu, WorkQueue *wq)
 	gpu->wq = wq;
 }
 
+/*
+ * This function asks for everything submitted to the GPU to be recorded to
+ * a trace file at path, for replaying with GPU_replayTrace. The trace starts
+ * at the next vblank where GP0 is between commands, with a snapshot of vram
+ * and the words needed to put the GPU's registers back as they were, and
+ * ends when the GPU is destructed.
+ */
+void GPU_startTrace(GPU *gpu, const char *path)
+{
+	free(gpu->tracePath);
+	gpu->tracePath = malloc(strlen(path) + 1);
+	if (!gpu->tracePath) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for trace "
+				"path\n");
+		return;
+	}
+	strcpy(gpu->tracePath, path);
+}
+
 /*
  * This function submits GP0 commands/packets.
  */
@@ -1003,1227 +2092,246 @@ void GPU_submitToGP0(GPU *gpu, int32_t word)
 {
 	// Sync up to CPU
 	GPU_executeGPUCycles(gpu);
+	if (gpu->trace)
+		GPU_recordTrace(gpu, PHILPSX_GPUTRACE_GP0, word);
 
-	// Exit if DMA read is in progress
-	switch (gpu->dmaReadInProgress) {
-		case -1: // No read
+	GPU_processGP0Word(gpu, word);
+}
+
+/*
+ * This function submits a block of GP0 words straight from little-endian
+ * memory, as DMA does for block mode transfers and each linked-list node.
+ * The GPU is brought up to date with the CPU once for the whole block, and
+ * image data for a CPU to VRAM copy is copied into the staging slot in bulk.
+ */
+void GPU_submitToGP0Block(GPU *gpu, const int8_t *data, int32_t wordCount)
+{
+	// Sync up to CPU
+	GPU_executeGPUCycles(gpu);
+	if (gpu->trace)
+		for (int32_t i = 0; i < wordCount; ++i)
+			GPU_recordTrace(gpu, PHILPSX_GPUTRACE_GP0,
+					read_le_word(data + i * 4));
+
+	int32_t i = 0;
+	while (i < wordCount) {
+
+		// Copy all but the last word of any image data in one go - the last
+		// word goes through the normal path so it can finish the transfer
+		if (gpu->dmaReadInProgress == -1 && gpu->dmaWriteInProgress != -1) {
+			int32_t copyWords = min_value(
+					(gpu->dmaNeededBytes - gpu->dmaBufferIndex - 1) / 4,
+					wordCount - i);
+			if (copyWords > 0) {
+				memcpy(gpu->uploadBufferData +
+						gpu->uploadSlot * GPU_UPLOAD_BUFFER_SLOT_SIZE +
+						gpu->dmaBufferIndex, data + i * 4, copyWords * 4);
+				gpu->dmaBufferIndex += copyWords * 4;
+				i += copyWords;
+				continue;
+			}
+		}
+
+		GPU_processGP0Word(gpu, read_le_word(data + i * 4));
+		++i;
+	}
+}
+
+/*
+ * This function submits GP1 commands/packets.
+ */
+void GPU_submitToGP1(GPU *gpu, int32_t word)
+{
+	// Sync up to CPU
+	GPU_executeGPUCycles(gpu);
+	if (gpu->trace)
+		GPU_recordTrace(gpu, PHILPSX_GPUTRACE_GP1, word);
+
+	// Submit to correct method
+	switch (logical_rshift(word, 24) & 0xFF) {
+		case 0:
+		case 0x40:
+		case 0x80:
+		case 0xC0:
+			GPU_GP1_00(gpu, word);
+			break;
+		case 0x1:
+		case 0x41:
+		case 0x81:
+		case 0xC1:
+			GPU_GP1_01(gpu, word);
+			break;
+		case 0x2:
+		case 0x42:
+		case 0x82:
+		case 0xC2:
+			GPU_GP1_02(gpu, word);
+			break;
+		case 0x3:
+		case 0x43:
+		case 0x83:
+		case 0xC3:
+			GPU_GP1_03(gpu, word);
+			break;
+		case 0x4:
+		case 0x44:
+		case 0x84:
+		case 0xC4:
+			GPU_GP1_04(gpu, word);
+			break;
+		case 0x5:
+		case 0x45:
+		case 0x85:
+		case 0xC5:
+			GPU_GP1_05(gpu, word);
+			break;
+		case 0x6:
+		case 0x46:
+		case 0x86:
+		case 0xC6:
+			GPU_GP1_06(gpu, word);
+			break;
+		case 0x7:
+		case 0x47:
+		case 0x87:
+		case 0xC7:
+			GPU_GP1_07(gpu, word);
+			break;
+		case 0x8:
+		case 0x48:
+		case 0x88:
+		case 0xC8:
+			GPU_GP1_08(gpu, word);
+			break;
+		case 0x9:
+		case 0x49:
+		case 0x89:
+		case 0xC9:
+			GPU_GP1_09(gpu, word);
+			break;
+		case 0x10:
+		case 0x11:
+		case 0x12:
+		case 0x13:
+		case 0x14:
+		case 0x15:
+		case 0x16:
+		case 0x17:
+		case 0x18:
+		case 0x19:
+		case 0x1A:
+		case 0x1B:
+		case 0x1C:
+		case 0x1D:
+		case 0x1E:
+		case 0x1F:
+		case 0x50:
+		case 0x51:
+		case 0x52:
+		case 0x53:
+		case 0x54:
+		case 0x55:
+		case 0x56:
+		case 0x57:
+		case 0x58:
+		case 0x59:
+		case 0x5A:
+		case 0x5B:
+		case 0x5C:
+		case 0x5D:
+		case 0x5E:
+		case 0x5F:
+		case 0x90:
+		case 0x91:
+		case 0x92:
+		case 0x93:
+		case 0x94:
+		case 0x95:
+		case 0x96:
+		case 0x97:
+		case 0x98:
+		case 0x99:
+		case 0x9A:
+		case 0x9B:
+		case 0x9C:
+		case 0x9D:
+		case 0x9E:
+		case 0x9F:
+		case 0xD0:
+		case 0xD1:
+		case 0xD2:
+		case 0xD3:
+		case 0xD4:
+		case 0xD5:
+		case 0xD6:
+		case 0xD7:
+		case 0xD8:
+		case 0xD9:
+		case 0xDA:
+		case 0xDB:
+		case 0xDC:
+		case 0xDD:
+		case 0xDE:
+		case 0xDF:
+			GPU_GP1_10(gpu, word);
+			break;
+		default:
+			fprintf(stderr, "PhilPSX: GPU: GP1 SUBMIT: %08X\n",
+					word);
 			break;
-		default: // Read happening, return from method
-			return;
 	}
+}
 
-	// Switch endianness
-	int32_t commandByte = word & 0xFF;
-	word = ((word << 24) & 0xFF000000) |
-			((word << 8) & 0xFF0000) |
-			(logical_rshift(word, 8) & 0xFF00) |
-			(logical_rshift(word, 24) & 0xFF);
+/*
+ * This function fills a rectangle in the VRAM by queuing it on the rendering
+ * thread.
+ */
+static void GPU_GP0_02(GPU *gpu, int32_t command, int32_t destination,
+		int32_t dimensions)
+{
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_FILL, 1);
 
-	switch (gpu->dmaWriteInProgress) {
-		default: // Write in progress, handle appropriately
-			// Swap word order back as we are dumping this data straight to VRAM
-			word = ((word << 24) & 0xFF000000) |
-					((word << 8) & 0xFF0000) |
-					(logical_rshift(word, 8) & 0xFF00) |
-					(logical_rshift(word, 24) & 0xFF);
-
-			// Split first pixel into buffer
-			GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++,
-					(int8_t)(logical_rshift(word, 24) & 0xFF));
-			GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++,
-					(int8_t)(logical_rshift(word, 16) & 0xFF));
-			GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++, (int8_t)0);
-			GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++, (int8_t)0);
-
-			// Test for second pixel and split as well if needed
-			if (gpu->dmaBufferIndex != gpu->dmaNeededBytes) {
-				GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++,
-						(int8_t)(logical_rshift(word, 8) & 0xFF));
-				GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++,
-						(int8_t)(word & 0xFF));
-				GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++, (int8_t)0);
-				GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++, (int8_t)0);
-			}
+	// Perform filling on GL thread
+	int32_t parameters[] = {command, destination, dimensions};
+	GPU_queueCommand(gpu, &GPU_GP0_02_implementation, parameters, 3, false);
+}
 
-			if (gpu->dmaBufferIndex == gpu->dmaNeededBytes) {
-				switch (gpu->dmaWriteInProgress) {
-					case 0xA0: // GP0(0xA0): copy rectangle (CPU to VRAM)
-						GPU_GP0_A0(gpu, gpu->fifoBuffer[0],
-								gpu->fifoBuffer[1], gpu->fifoBuffer[2]);
-						GPU_GP1_01(gpu, 0);
-						break;
-				}
-				gpu->dmaWriteInProgress = -1;
+/*
+ * This function contains the implementation of GP0_02.
+ */
+static void GPU_GP0_02_implementation(GpuCommand *command)
+{
+	// Get GPU object
+	GPU *gpu = command->gpu;
 
-				// Set bit 26 (ready to receive command word) of status register
-				gpu->statusRegister |= 0x04000000;
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_fillRectangle(gpu->softRenderer, command);
+		return;
+	}
 
-				// Clear bit 27 (VRAM to CPU ready) of status register
-				gpu->statusRegister &= 0xF7FFFFFF;
-
-				// Set bit 28 (DMA ready) of status register
-				gpu->statusRegister |= 0x10000000;
-			}
-			break;
-		case -1: // No write in progress, deal with normally
-			switch (gpu->commandsInFifo) {
-				case 0: // Deal with command
-					switch (commandByte) {
-						case 0x1F: // Trigger interrupt
-							GPU_GP0_1F(gpu);
-							break;
-						case 0x00:
-						case 0x03:
-						case 0x04:
-						case 0x05:
-						case 0x06:
-						case 0x07:
-						case 0x08:
-						case 0x09:
-						case 0x0A:
-						case 0x0B:
-						case 0x0C:
-						case 0x0D:
-						case 0x0E:
-						case 0x0F:
-						case 0x10:
-						case 0x11:
-						case 0x12:
-						case 0x13:
-						case 0x14:
-						case 0x15:
-						case 0x16:
-						case 0x17:
-						case 0x18:
-						case 0x19:
-						case 0x1A:
-						case 0x1B:
-						case 0x1C:
-						case 0x1D:
-						case 0x1E:
-						case 0xE0:
-						case 0xE7:
-						case 0xE8:
-						case 0xE9:
-						case 0xEA:
-						case 0xEB:
-						case 0xEC:
-						case 0xED:
-						case 0xEE:
-						case 0xEF: // NOP (do nothing)
-							break;
-						case 0x01: // Clear cache, but not clear
-								   // (it actually does nothing)
-							break;
-						case 0x02: // GP0(0x02): fill rectangle in VRAM
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0x24: // GP0(0x24): textured three-point polygon,
-								   // opaque, texture-blending
-						case 0x25: // GP0(0x25): textured three-point polygon,
-								   // opaque, raw-texture
-						case 0x26: // GP0(0x26): textured three-point polygon,
-								   // semi-transparent, texture-blending
-						case 0x27: // GP0(0x27): textured three-point polygon,
-								   // semi-transparent, raw-texture
-						case 0x2C: // GP0(0x2C): textured four-point polygon,
-								   // opaque, texture-blending
-						case 0x2D: // GP0(0x2D): textured four-point polygon,
-								   // opaque, raw-texture
-						case 0x2E: // GP0(0x2E): textured four-point polygon,
-								   // semi-transparent, texture-blending
-						case 0x2F: // GP0(0x2F): textured four-point polygon,
-								   // semi-transparent, raw-texture
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0x34: // GP0(0x34): shaded textured three-point
-								   // polygon, opaque, texture-blending
-						case 0x35: // GP0(0x35): undocumented, textured
-								   // three-point polygon, opaque, no blending
-						case 0x36: // GP0(0x36): shaded textured three-point
-								   // polygon, semi-transparent,
-								   // texture-blending
-						case 0x37: // GP0(0x37): undocumented, textured
-								   // three-point polygon, semi-transparent,
-								   // no blending
-						case 0x3C: // GP0(0x3C): shaded textured four-point
-								   // polygon, opaque, texture-blending
-						case 0x3D: // GP0(0x3D): undocumented, textured
-								   // four-point polygon, opaque, no blending
-						case 0x3E: // GP0(0x3E): shaded textured four-point
-								   // polygon, semi-transparent,
-								   // texture-blending
-						case 0x3F: // GP0(0x3F): undocumented, textured
-								   // four-point polygon, semi-transparent,
-								   // no blending
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0x20: // GP0(0x20): monochrome three-point polygon,
-								   // opaque
-						case 0x21: // GP0(0x21): undocumented command, same as
-								   // GP0(0x20)
-						case 0x22: // GP0(0x22): monochrome three-point polygon,
-								   // semi-transparent
-						case 0x23: // GP0(0x23): undocumented command, same as
-								   // GP0(0x22)
-						case 0x28: // GP0(0x28): monochrome four-point polygon,
-								   // opaque
-						case 0x29: // GP0(0x29): undocumented command, same as
-								   // GP0(0x28)
-						case 0x2A: // GP0(0x2A): monochrome four-point polygon,
-								   // semi-transparent
-						case 0x2B: // GP0(0x2B): undocumented command, same as
-								   // GP0(0x2A)
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0x30: // GP0(0x30): shaded three-point polygon,
-								   // opaque
-						case 0x31: // GP0(0x31): undocumented command, same as
-								   // GP0(0x30)
-						case 0x32: // GP0(0x32): shaded three-point polygon,
-								   // semi-transparent
-						case 0x33: // GP0(0x33): undocumented command, same as
-								   // GP0(0x32)
-						case 0x38: // GP0(0x38): shaded four-point polygon,
-								   // opaque
-						case 0x39: // GP0(0x39): undocumented command, same as
-								   // GP0(0x38)
-						case 0x3A: // GP0(0x3A): shaded four-point polygon,
-								   // semi-transparent
-						case 0x3B: // GP0(0x3B): undocumented command, same as
-								   // GP0(0x3A)
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0x40: // GP0(0x40): monochrome line, opaque
-						case 0x42: // GP0(0x42): monochrome line,
-								   // semi-transparent
-						case 0x48: // GP0(0x48): monochrome poly-line, opaque
-						case 0x4A: // GP0(0x4A): monochrome poly-line,
-								   // semi-transparent
-						case 0x50: // GP0(0x50): shaded line, opaque
-						case 0x52: // GP0(0x52): shaded line, semi-transparent
-						case 0x58: // GP0(0x58): shaded poly-line, opaque
-						case 0x5A: // GP0(0x5A): shaded poly-line,
-								   // semi-transparent
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0x60: // GP0(0x60): monochrome rectangle, variable
-								   // size, opaque
-						case 0x62: // GP0(0x62): monochrome rectangle, variable
-								   // size, semi-transparent
-						case 0x68: // GP0(0x68): monochrome rectangle, 1x1,
-								   // opaque
-						case 0x6A: // GP0(0x6A): monochrome rectangle, 1x1,
-								   // semi-transparent
-						case 0x70: // GP0(0x70): monochrome rectangle, 8x8,
-								   // opaque
-						case 0x72: // GP0(0x72): monochrome rectangle, 8x8,
-								   // semi-transparent
-						case 0x78: // GP0(0x78): monochrome rectangle, 16x16,
-								   // opaque
-						case 0x7A: // GP0(0x7A): monochrome rectangle, 16x16,
-								   // semi-transparent
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0x64: // GP0(0x64): textured rectangle, variable
-								   // size, opaque, texture-blending
-						case 0x65: // GP0(0x65): textured rectangle, variable
-								   // size, opaque, raw-texture
-						case 0x66: // GP0(0x66): textured rectangle, variable
-								   // size, semi-transparent, texture-blending
-						case 0x67: // GP0(0x67): textured rectangle, variable
-								   // size, semi-transparent, raw-texture
-						case 0x6C: // GP0(0x6C): textured rectangle, 1x1
-							       // (nonsense), opaque, texture-blending
-						case 0x6D: // GP0(0x6D): textured rectangle, 1x1
-								   // (nonsense), opaque, raw-texture
-						case 0x6E: // GP0(0x6E): textured rectangle, 1x1
-								   // (nonsense), semi-transparent,
-								   // texture-blending
-						case 0x6F: // GP0(0x6F): textured rectangle,
-								   // 1x1 (nonsense), semi-transparent,
-								   // raw-texture
-						case 0x74: // GP0(0x74): textured rectangle, 8x8,
-								   // opaque, texture-blending
-						case 0x75: // GP0(0x75): textured rectangle, 8x8,
-								   // opaque, raw-texture
-						case 0x76: // GP0(0x76): textured rectangle, 8x8,
-								   // semi-transparent, texture-blending
-						case 0x77: // GP0(0x77): textured rectangle, 8x8,
-								   // semi-transparent, raw-texture
-						case 0x7C: // GP0(0x7C): textured rectangle, 16x16,
-								   // opaque, texture-blending
-						case 0x7D: // GP0(0x7D): textured rectangle, 16x16,
-								   // opaque, raw-texture
-						case 0x7E: // GP0(0x7E): textured rectangle, 16x16,
-								   // semi-transparent, texture-blending
-						case 0x7F: // GP0(0x7F): textured rectangle, 16x16,
-								   // semi-transparent, raw-texture
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0x80:
-						case 0x81:
-						case 0x82:
-						case 0x83:
-						case 0x84:
-						case 0x85:
-						case 0x86:
-						case 0x87:
-						case 0x88:
-						case 0x89:
-						case 0x8A:
-						case 0x8B:
-						case 0x8C:
-						case 0x8D:
-						case 0x8E:
-						case 0x8F:
-						case 0x90:
-						case 0x91:
-						case 0x92:
-						case 0x93:
-						case 0x94:
-						case 0x95:
-						case 0x96:
-						case 0x97:
-						case 0x98:
-						case 0x99:
-						case 0x9A:
-						case 0x9B:
-						case 0x9C:
-						case 0x9D:
-						case 0x9E:
-						case 0x9F: // GP0(0x80): copy rectangle (VRAM to VRAM)
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0xA0:
-						case 0xA1:
-						case 0xA2:
-						case 0xA3:
-						case 0xA4:
-						case 0xA5:
-						case 0xA6:
-						case 0xA7:
-						case 0xA8:
-						case 0xA9:
-						case 0xAA:
-						case 0xAB:
-						case 0xAC:
-						case 0xAD:
-						case 0xAE:
-						case 0xAF:
-						case 0xB0:
-						case 0xB1:
-						case 0xB2:
-						case 0xB3:
-						case 0xB4:
-						case 0xB5:
-						case 0xB6:
-						case 0xB7:
-						case 0xB8:
-						case 0xB9:
-						case 0xBA:
-						case 0xBB:
-						case 0xBC:
-						case 0xBD:
-						case 0xBE:
-						case 0xBF: // GP0(0xA0): copy rectangle (CPU to VRAM)
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0xC0:
-						case 0xC1:
-						case 0xC2:
-						case 0xC3:
-						case 0xC4:
-						case 0xC5:
-						case 0xC6:
-						case 0xC7:
-						case 0xC8:
-						case 0xC9:
-						case 0xCA:
-						case 0xCB:
-						case 0xCC:
-						case 0xCD:
-						case 0xCE:
-						case 0xCF:
-						case 0xD0:
-						case 0xD1:
-						case 0xD2:
-						case 0xD3:
-						case 0xD4:
-						case 0xD5:
-						case 0xD6:
-						case 0xD7:
-						case 0xD8:
-						case 0xD9:
-						case 0xDA:
-						case 0xDB:
-						case 0xDC:
-						case 0xDD:
-						case 0xDE:
-						case 0xDF: // GP0(0xC0): copy rectangle (VRAM to CPU)
-							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-							break;
-						case 0xE1: // GP0(0xE1): draw mode ("texpage") setting
-							GPU_GP0_E1(gpu, word);
-							break;
-						case 0xE2: // GP0(0xE2): texture window setting
-							GPU_GP0_E2(gpu, word);
-							break;
-						case 0xE3: // GP0(0xE3): set drawing area (top-left)
-							GPU_GP0_E3(gpu, word);
-							break;
-						case 0xE4: // GP0(0xE4): set drawing area (bottom-right)
-							GPU_GP0_E4(gpu, word);
-							break;
-						case 0xE5: // GP0(0xE5): set drawing offset
-							GPU_GP0_E5(gpu, word);
-							break;
-						case 0xE6: // GP0(0xE6): set mask setting bits
-							GPU_GP0_E6(gpu, word);
-							break;
-						default:
-							fprintf(stderr, "PhilPSX: GPU: GP0 SUBMIT: %08X\n",
-									word);
-							break;
-					}
-					break;
-				default: // Command at index 0 in FIFO requires more parameters
-					switch (logical_rshift(gpu->fifoBuffer[0], 24) & 0xFF) {
-						case 0x02: // GP0(0x02): fill rectangle in VRAM
-							if (gpu->commandsInFifo < 3) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 3) {
-									GPU_GP0_02(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2]);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x24: // GP0(0x24): textured three-point polygon,
-								   // opaque, texture-blending
-						case 0x25: // GP0(0x25): textured three-point polygon,
-								   // opaque, raw-texture
-						case 0x26: // GP0(0x26): textured three-point polygon,
-								   // semi-transparent, texture-blending
-						case 0x27: // GP0(0x27): textured three-point polygon,
-								   // semi-transparent, raw-texture
-							if (gpu->commandsInFifo < 7) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 7) {
-									GPU_texturedPolygon(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3],
-											gpu->fifoBuffer[4],
-											gpu->fifoBuffer[5],
-											gpu->fifoBuffer[6],
-											0, 0);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x2C: // GP0(0x2C): textured four-point polygon,
-								   // opaque, texture-blending
-						case 0x2D: // GP0(0x2D): textured four-point polygon,
-								   // opaque, raw-texture
-						case 0x2E: // GP0(0x2E): textured four-point polygon,
-								   // semi-transparent, texture-blending
-						case 0x2F: // GP0(0x2F): textured four-point polygon,
-								   // semi-transparent, raw-texture
-							if (gpu->commandsInFifo < 9) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 9) {
-									GPU_texturedPolygon(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3],
-											gpu->fifoBuffer[4],
-											gpu->fifoBuffer[5],
-											gpu->fifoBuffer[6],
-											gpu->fifoBuffer[7],
-											gpu->fifoBuffer[8]);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x34: // Shaded textured three-point polygon,
-								   // opaque, texture-blending
-						case 0x35: // Undocumented, textured three-point
-								   // polygon, opaque, no blending
-						case 0x36: // Shaded textured three-point polygon,
-								   // semi-transparent, texture-blending
-						case 0x37: // Undocumented, textured three-point
-								   // polygon, semi-transparent, no blending
-							if (gpu->commandsInFifo < 9) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 9) {
-									GPU_shadedTexturedPolygon(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3],
-											gpu->fifoBuffer[4],
-											gpu->fifoBuffer[5],
-											gpu->fifoBuffer[6],
-											gpu->fifoBuffer[7],
-											gpu->fifoBuffer[8],
-											0, 0, 0);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x3C: // Shaded textured four-point polygon,
-								   // opaque, texture-blending
-						case 0x3D: // Undocumented, textured four-point polygon,
-								   // opaque, no blending
-						case 0x3E: // Shaded textured four-point polygon,
-								   // semi-transparent, texture-blending
-						case 0x3F: // Undocumented, textured four-point polygon,
-								   // semi-transparent, no blending
-							if (gpu->commandsInFifo < 12) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 12) {
-									GPU_shadedTexturedPolygon(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3],
-											gpu->fifoBuffer[4],
-											gpu->fifoBuffer[5],
-											gpu->fifoBuffer[6],
-											gpu->fifoBuffer[7],
-											gpu->fifoBuffer[8],
-											gpu->fifoBuffer[9],
-											gpu->fifoBuffer[10],
-											gpu->fifoBuffer[11]);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x20: // GP0(0x20): monochrome three-point polygon,
-								   // opaque
-						case 0x21: // GP0(0x21): undocumented command, same as
-								   // GP0(0x20)
-						case 0x22: // GP0(0x22): monochrome three-point polygon,
-								   // semi-transparent
-						case 0x23: // GP0(0x23): undocumented command, same as
-								   // GP0(0x22)
-							if (gpu->commandsInFifo < 4) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 4) {
-									GPU_monochromePolygon(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3],
-											0);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x28: // GP0(0x28): monochrome four-point polygon,
-								   // opaque
-						case 0x29: // GP0(0x29): undocumented command, same as
-								   // GP0(0x28)
-						case 0x2A: // GP0(0x2A): monochrome four-point polygon,
-								   // semi-transparent
-						case 0x2B: // GP0(0x2B): undocumented command, same as
-								   // GP0(0x2B)
-							if (gpu->commandsInFifo < 5) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 5) {
-									GPU_monochromePolygon(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3],
-											gpu->fifoBuffer[4]);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x30: // GP0(0x30): shaded three-point polygon,
-								   // opaque
-						case 0x31: // GP0(0x31): undocumented command, same as
-								   // GP0(0x30)
-						case 0x32: // GP0(0x32): shaded three-point polygon,
-								   // semi-transparent
-						case 0x33: // GP0(0x33): undocumented command, same as
-								   // GP0(0x32)
-							if (gpu->commandsInFifo < 6) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 6) {
-									GPU_shadedPolygon(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3],
-											gpu->fifoBuffer[4],
-											gpu->fifoBuffer[5],
-											0, 0);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x38: // GP0(0x38): shaded four-point polygon,
-								   // opaque
-						case 0x39: // GP0(0x39): undocumented command, same as
-								   // GP0(0x38)
-						case 0x3A: // GP0(0x3A): shaded four-point polygon,
-								   // semi-transparent
-						case 0x3B: // GP0(0x3B): undocumented command, same as
-								   // GP0(0x3A)
-							if (gpu->commandsInFifo < 8) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 8) {
-									GPU_shadedPolygon(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3],
-											gpu->fifoBuffer[4],
-											gpu->fifoBuffer[5],
-											gpu->fifoBuffer[6],
-											gpu->fifoBuffer[7]);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x40: // GP0(0x40): monochrome line, opaque
-						case 0x42: // GP0(0x42): monochrome line,
-								   // semi-transparent
-							if (ArrayList_getSize(gpu->lineParameters) < 4) {
-								ArrayList_addObject(gpu->lineParameters,
-										(void *)(intptr_t)(gpu->fifoBuffer[0]
-										& 0xFFFFFF));
-								ArrayList_addObject(gpu->lineParameters,
-										(void *)(intptr_t)word);
-								if (ArrayList_getSize(gpu->lineParameters)
-										== 4) {
-									GPU_anyLine(gpu,
-											gpu->fifoBuffer[0],
-											gpu->lineParameters);
-									ArrayList_wipeAllObjects(
-											gpu->lineParameters);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x50: // GP0(0x50): shaded line, opaque
-						case 0x52: // GP0(0x52): shaded line, semi-transparent
-							if (ArrayList_getSize(gpu->lineParameters) < 4) {
-								if (ArrayList_getSize(gpu->lineParameters)
-										== 0) {
-									ArrayList_addObject(gpu->lineParameters,
-											(void *)(intptr_t)(
-											gpu->fifoBuffer[0] & 0xFFFFFF));
-								}
-								ArrayList_addObject(gpu->lineParameters,
-										(void *)(intptr_t)word);
-								if (ArrayList_getSize(gpu->lineParameters)
-										== 4) {
-									GPU_anyLine(gpu,
-											gpu->fifoBuffer[0],
-											gpu->lineParameters);
-									ArrayList_wipeAllObjects(
-											gpu->lineParameters);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x48: // GP0(0x48): monochrome poly-line, opaque
-						case 0x4A: // GP0(0x4A): monochrome poly-line,
-								   // semi-transparent
-							// Variable number of components, so stop at
-							// termination code
-							if (word != 0x55555555 && word != 0x50005000) {
-								ArrayList_addObject(gpu->lineParameters,
-										(void *)(intptr_t)(gpu->fifoBuffer[0]
-										& 0xFFFFFF));
-								ArrayList_addObject(gpu->lineParameters,
-										(void *)(intptr_t)word);
-							} else {
-								GPU_anyLine(gpu,
-										gpu->fifoBuffer[0],
-										gpu->lineParameters);
-								ArrayList_wipeAllObjects(gpu->lineParameters);
-								GPU_GP1_01(gpu, 0);
-							}
-							break;
-						case 0x58: // GP0(0x58): shaded poly-line, opaque
-						case 0x5A: // GP0(0x5A): shaded poly-line,
-								   // semi-transparent
-							// Variable number of components, so stop at
-							// termination code
-							if (word != 0x55555555 && word != 0x50005000) {
-								if (ArrayList_getSize(gpu->lineParameters)
-										== 0) {
-									ArrayList_addObject(gpu->lineParameters,
-											(void *)(intptr_t)(
-											gpu->fifoBuffer[0] & 0xFFFFFF));
-								}
-								ArrayList_addObject(gpu->lineParameters,
-										(void *)(intptr_t)word);
-							} else {
-								GPU_anyLine(gpu,
-										gpu->fifoBuffer[0],
-										gpu->lineParameters);
-								ArrayList_wipeAllObjects(gpu->lineParameters);
-								GPU_GP1_01(gpu, 0);
-							}
-							break;
-						case 0x60: // GP0(0x60): monochrome rectangle, variable
-								   // size, opaque
-						case 0x62: // GP0(0x62): monochrome rectangle, variable
-								   // size, semi-transparent
-							if (gpu->commandsInFifo < 3) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 3) {
-									GPU_monochromeRectangle(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2]);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x68: // GP0(0x68): monochrome rectangle, 1x1,
-								   // opaque
-						case 0x6A: // GP0(0x6A): monochrome rectangle, 1x1,
-								   // semi-transparent
-						case 0x70: // GP0(0x70): monochrome rectangle, 8x8,
-								   // opaque
-						case 0x72: // GP0(0x72): monochrome rectangle, 8x8,
-								   // semi-transparent
-						case 0x78: // GP0(0x78): monochrome rectangle, 16x16,
-								   // opaque
-						case 0x7A: // GP0(0x7A): monochrome rectangle, 16x16,
-								   // semi-transparent
-							if (gpu->commandsInFifo < 2) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 2) {
-									int32_t rectangleSize = 0;
-									switch (logical_rshift(
-											gpu->fifoBuffer[0], 24) & 0xFF) {
-										case 0x68:
-										case 0x6A: // 1x1 size
-											rectangleSize = 0x00010001;
-											break;
-										case 0x70:
-										case 0x72: // 8x8 size
-											rectangleSize = 0x00080008;
-											break;
-										case 0x78:
-										case 0x7A: // 16x16 size
-											rectangleSize = 0x00100010;
-											break;
-									}
-									GPU_monochromeRectangle(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											rectangleSize);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x64: // GP0(0x64): textured rectangle, variable
-								   // size, opaque, texture-blending
-						case 0x65: // GP0(0x65): textured rectangle, variable
-								   // size, opaque, raw-texture
-						case 0x66: // GP0(0x66): textured rectangle, variable
-								   // size, semi-transparent, texture-blending
-						case 0x67: // GP0(0x67): textured rectangle, variable
-								   // size, semi-transparent, raw-texture
-							if (gpu->commandsInFifo < 4) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 4) {
-									GPU_texturedRectangle(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3]);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x6C: // GP0(0x6C): textured rectangle, 1x1
-								   // (nonsense), opaque, texture-blending
-						case 0x6D: // GP0(0x6D): textured rectangle, 1x1
-								   // (nonsense), opaque, raw-texture
-						case 0x6E: // GP0(0x6E): textured rectangle, 1x1
-								   // (nonsense), semi-transparent, texture-blending
-						case 0x6F: // GP0(0x6F): textured rectangle, 1x1
-								   // (nonsense), semi-transparent, raw-texture
-						case 0x74: // GP0(0x74): textured rectangle, 8x8,
-								   // opaque, texture-blending
-						case 0x75: // GP0(0x75): textured rectangle, 8x8,
-								   // opaque, raw-texture
-						case 0x76: // GP0(0x76): textured rectangle, 8x8,
-								   // semi-transparent, texture-blending
-						case 0x77: // GP0(0x77): textured rectangle, 8x8,
-								   // semi-transparent, raw-texture
-						case 0x7C: // GP0(0x7C): textured rectangle, 16x16,
-								   // opaque, texture-blending
-						case 0x7D: // GP0(0x7D): textured rectangle, 16x16,
-								   // opaque, raw-texture
-						case 0x7E: // GP0(0x7E): textured rectangle, 16x16,
-								   // semi-transparent, texture-blending
-						case 0x7F: // GP0(0x7F): textured rectangle, 16x16,
-								   // semi-transparent, raw-texture
-							if (gpu->commandsInFifo < 3) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 3) {
-									int32_t rectangleSize = 0;
-									switch (logical_rshift(
-											gpu->fifoBuffer[0], 24) & 0xFF) {
-										case 0x6C:
-										case 0x6D:
-										case 0x6E:
-										case 0x6F: // 1x1 size
-											rectangleSize = 0x00010001;
-											break;
-										case 0x74:
-										case 0x75:
-										case 0x76:
-										case 0x77: // 8x8 size
-											rectangleSize = 0x00080008;
-											break;
-										case 0x7C:
-										case 0x7D:
-										case 0x7E:
-										case 0x7F: // 16x16 size
-											rectangleSize = 0x00100010;
-											break;
-									}
-									GPU_texturedRectangle(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											rectangleSize);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0x80:
-						case 0x81:
-						case 0x82:
-						case 0x83:
-						case 0x84:
-						case 0x85:
-						case 0x86:
-						case 0x87:
-						case 0x88:
-						case 0x89:
-						case 0x8A:
-						case 0x8B:
-						case 0x8C:
-						case 0x8D:
-						case 0x8E:
-						case 0x8F:
-						case 0x90:
-						case 0x91:
-						case 0x92:
-						case 0x93:
-						case 0x94:
-						case 0x95:
-						case 0x96:
-						case 0x97:
-						case 0x98:
-						case 0x99:
-						case 0x9A:
-						case 0x9B:
-						case 0x9C:
-						case 0x9D:
-						case 0x9E:
-						case 0x9F: // GP0(0x80): copy rectangle (VRAM to VRAM)
-							if (gpu->commandsInFifo < 4) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 4) {
-									GPU_GP0_80(gpu,
-											gpu->fifoBuffer[0],
-											gpu->fifoBuffer[1],
-											gpu->fifoBuffer[2],
-											gpu->fifoBuffer[3]);
-									GPU_GP1_01(gpu, 0);
-								}
-							}
-							break;
-						case 0xA0:
-						case 0xA1:
-						case 0xA2:
-						case 0xA3:
-						case 0xA4:
-						case 0xA5:
-						case 0xA6:
-						case 0xA7:
-						case 0xA8:
-						case 0xA9:
-						case 0xAA:
-						case 0xAB:
-						case 0xAC:
-						case 0xAD:
-						case 0xAE:
-						case 0xAF:
-						case 0xB0:
-						case 0xB1:
-						case 0xB2:
-						case 0xB3:
-						case 0xB4:
-						case 0xB5:
-						case 0xB6:
-						case 0xB7:
-						case 0xB8:
-						case 0xB9:
-						case 0xBA:
-						case 0xBB:
-						case 0xBC:
-						case 0xBD:
-						case 0xBE:
-						case 0xBF: // GP0(0xA0): copy rectangle (CPU to VRAM)
-							if (gpu->commandsInFifo < 3) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 3) {
-									// Clear bit 28 (DMA ready) of status
-									// register
-									gpu->statusRegister &= 0xEFFFFFFF;
-
-									// Clear bit 26 (ready to receive command
-									// word) of status register
-									gpu->statusRegister &= 0xFBFFFFFF;
-
-									// Trigger DMA input
-									gpu->dmaWriteInProgress = 0xA0;
-									gpu->dmaBufferIndex = 0;
-									gpu->dmaWidthInPixels =
-											gpu->fifoBuffer[2] & 0xFFFF;
-									gpu->dmaWidthInPixels =
-											((gpu->dmaWidthInPixels - 1)
-											& 0x3FF) + 1;
-									gpu->dmaHeightInPixels = logical_rshift(
-											gpu->fifoBuffer[2],
-											16) & 0xFFFF;
-									gpu->dmaHeightInPixels =
-											((gpu->dmaHeightInPixels - 1)
-											& 0x1FF) + 1;
-									gpu->dmaWidthInPixels =
-											(gpu->dmaWidthInPixels == 0) ?
-											0x400 : gpu->dmaWidthInPixels;
-									gpu->dmaHeightInPixels =
-											(gpu->dmaHeightInPixels == 0) ?
-											0x200 : gpu->dmaHeightInPixels;
-									gpu->dmaNeededBytes =
-											gpu->dmaWidthInPixels *
-											gpu->dmaHeightInPixels;
-									gpu->dmaNeededBytes *= 4;
-								}
-							}
-							break;
-						case 0xC0:
-						case 0xC1:
-						case 0xC2:
-						case 0xC3:
-						case 0xC4:
-						case 0xC5:
-						case 0xC6:
-						case 0xC7:
-						case 0xC8:
-						case 0xC9:
-						case 0xCA:
-						case 0xCB:
-						case 0xCC:
-						case 0xCD:
-						case 0xCE:
-						case 0xCF:
-						case 0xD0:
-						case 0xD1:
-						case 0xD2:
-						case 0xD3:
-						case 0xD4:
-						case 0xD5:
-						case 0xD6:
-						case 0xD7:
-						case 0xD8:
-						case 0xD9:
-						case 0xDA:
-						case 0xDB:
-						case 0xDC:
-						case 0xDD:
-						case 0xDE:
-						case 0xDF: // GP0(0xC0): copy rectangle (VRAM to CPU)
-							if (gpu->commandsInFifo < 3) {
-								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
-								if (gpu->commandsInFifo == 3) {
-									// Clear bit 28 (DMA ready) of status
-									// register
-									gpu->statusRegister &= 0xEFFFFFFF;
-
-									// Set bit 27 (ready to send VRAM to CPU)
-									gpu->statusRegister |= 0x08000000;
-
-									// Clear bit 26 (ready to receive command
-									// word) of status register
-									gpu->statusRegister &= 0xFBFFFFFF;
-
-									// Trigger DMA output
-									gpu->dmaReadInProgress = 0xC0;
-									gpu->dmaBufferIndex = 0;
-									gpu->dmaWidthInPixels =
-											gpu->fifoBuffer[2] & 0xFFFF;
-									gpu->dmaWidthInPixels =
-											((gpu->dmaWidthInPixels - 1)
-											& 0x3FF) + 1;
-									gpu->dmaHeightInPixels = logical_rshift(
-											gpu->fifoBuffer[2], 16) & 0xFFFF;
-									gpu->dmaHeightInPixels =
-											((gpu->dmaHeightInPixels - 1)
-											& 0x1FF) + 1;
-									gpu->dmaWidthInPixels =
-											(gpu->dmaWidthInPixels == 0) ?
-											0x400 : gpu->dmaWidthInPixels;
-									gpu->dmaHeightInPixels =
-											(gpu->dmaHeightInPixels == 0) ?
-											0x200 : gpu->dmaHeightInPixels;
-									gpu->dmaNeededBytes =
-											gpu->dmaWidthInPixels *
-											gpu->dmaHeightInPixels;
-									gpu->dmaNeededBytes *= 4;
-								}
-							}
-							break;
-					}
-					break;
-			}
-			break;
-	}
-}
-
-/*
- * This function submits GP1 commands/packets.
- */
-void GPU_submitToGP1(GPU *gpu, int32_t word)
-{
-	// Sync up to CPU
-	GPU_executeGPUCycles(gpu);
-
-	// Switch endianness
-	word = ((word << 24) & 0xFF000000) |
-			((word << 8) & 0xFF0000) |
-			(logical_rshift(word, 8) & 0xFF00) |
-			(logical_rshift(word, 24) & 0xFF);
-
-	// Submit to correct method
-	switch (logical_rshift(word, 24) & 0xFF) {
-		case 0:
-		case 0x40:
-		case 0x80:
-		case 0xC0:
-			GPU_GP1_00(gpu, word);
-			break;
-		case 0x1:
-		case 0x41:
-		case 0x81:
-		case 0xC1:
-			GPU_GP1_01(gpu, word);
-			break;
-		case 0x2:
-		case 0x42:
-		case 0x82:
-		case 0xC2:
-			GPU_GP1_02(gpu, word);
-			break;
-		case 0x3:
-		case 0x43:
-		case 0x83:
-		case 0xC3:
-			GPU_GP1_03(gpu, word);
-			break;
-		case 0x4:
-		case 0x44:
-		case 0x84:
-		case 0xC4:
-			GPU_GP1_04(gpu, word);
-			break;
-		case 0x5:
-		case 0x45:
-		case 0x85:
-		case 0xC5:
-			GPU_GP1_05(gpu, word);
-			break;
-		case 0x6:
-		case 0x46:
-		case 0x86:
-		case 0xC6:
-			GPU_GP1_06(gpu, word);
-			break;
-		case 0x7:
-		case 0x47:
-		case 0x87:
-		case 0xC7:
-			GPU_GP1_07(gpu, word);
-			break;
-		case 0x8:
-		case 0x48:
-		case 0x88:
-		case 0xC8:
-			GPU_GP1_08(gpu, word);
-			break;
-		case 0x9:
-		case 0x49:
-		case 0x89:
-		case 0xC9:
-			GPU_GP1_09(gpu, word);
-			break;
-		case 0x10:
-		case 0x11:
-		case 0x12:
-		case 0x13:
-		case 0x14:
-		case 0x15:
-		case 0x16:
-		case 0x17:
-		case 0x18:
-		case 0x19:
-		case 0x1A:
-		case 0x1B:
-		case 0x1C:
-		case 0x1D:
-		case 0x1E:
-		case 0x1F:
-		case 0x50:
-		case 0x51:
-		case 0x52:
-		case 0x53:
-		case 0x54:
-		case 0x55:
-		case 0x56:
-		case 0x57:
-		case 0x58:
-		case 0x59:
-		case 0x5A:
-		case 0x5B:
-		case 0x5C:
-		case 0x5D:
-		case 0x5E:
-		case 0x5F:
-		case 0x90:
-		case 0x91:
-		case 0x92:
-		case 0x93:
-		case 0x94:
-		case 0x95:
-		case 0x96:
-		case 0x97:
-		case 0x98:
-		case 0x99:
-		case 0x9A:
-		case 0x9B:
-		case 0x9C:
-		case 0x9D:
-		case 0x9E:
-		case 0x9F:
-		case 0xD0:
-		case 0xD1:
-		case 0xD2:
-		case 0xD3:
-		case 0xD4:
-		case 0xD5:
-		case 0xD6:
-		case 0xD7:
-		case 0xD8:
-		case 0xD9:
-		case 0xDA:
-		case 0xDB:
-		case 0xDC:
-		case 0xDD:
-		case 0xDE:
-		case 0xDF:
-			GPU_GP1_10(gpu, word);
-			break;
-		default:
-			fprintf(stderr, "PhilPSX: GPU: GP1 SUBMIT: %08X\n",
-					word);
-			break;
-	}
-}
-
-/*
- * This function fills a rectangle in the VRAM by queuing it on the rendering
- * thread.
- */
-static void GPU_GP0_02(GPU *gpu, int32_t command, int32_t destination,
-		int32_t dimensions)
-{
-	// Perform copying on GL thread, making sure to set pointers
-	GpuCommand gp0_02;
-	gp0_02.functionPointer = &GPU_GP0_02_implementation;
-	gp0_02.gpu = gpu;
-
-	// Store parameters in object then submit it to work queue
-	gp0_02.parameter1 = command;
-	gp0_02.parameter2 = destination;
-	gp0_02.parameter3 = dimensions;
-	WorkQueue_addItem(gpu->wq, &gp0_02, false);
-}
-
-/*
- * This function contains the implementation of GP0_02.
- */
-static void GPU_GP0_02_implementation(GpuCommand *command)
-{
-	// Get GL function pointers and GPU objects
-	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
-
-	// Determine needed dimensions
-	int32_t width = command->parameter3 & 0xFFFF;
-	width = ((width & 0x3FF) + 0xF) & ~(0xF);
-	int32_t height = logical_rshift(command->parameter3, 16) & 0xFFFF;
-	height &= 0x1FF;
-	if (width == 0 || height == 0)
-		return;
+	// Determine needed dimensions
+	int32_t width = command->parameter3 & 0xFFFF;
+	width = ((width & 0x3FF) + 0xF) & ~(0xF);
+	int32_t height = logical_rshift(command->parameter3, 16) & 0xFFFF;
+	height &= 0x1FF;
+	if (width == 0 || height == 0)
+		return;
 
 	// Determine starting position
 	int32_t x = command->parameter2 & 0x3F0;
 	int32_t y = logical_rshift(command->parameter2, 16) & 0x1FF;
 
-	// Adjust y to account for OpenGL coordinate system
-	y = 511 - y;
-	y -= height - 1;
-
-	// Split colours out
-	int32_t red = command->parameter1 & 0xFF;
-	int32_t green = logical_rshift(command->parameter1, 8) & 0xFF;
-	int32_t blue = logical_rshift(command->parameter1, 16) & 0xFF;
-
-	// Bind vram FBO to framebuffer, setting viewport and uniforms
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_02_implementation function, "
-			"glBindFramebuffer called");
-	gl->glViewport(x, y, width, height);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_02_implementation function, "
-			"glViewport called");
-	gl->glUseProgram(gpu->gp0_02Program);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_02_implementation function, "
-			"glUseProgram called");
-	gl->glUniform1i(0, red);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_02_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(1, green);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_02_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(2, blue);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_02_implementation function, "
-			"glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_02_implementation function, "
-			"glDrawArrays called");
-	gl->glMemoryBarrier(GL_ALL_BARRIER_BITS);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_02_implementation function, "
-			"glMemoryBarrier called");
+	// Batch fill with the colour in vram's format, ignoring the mask
+	// settings
+	int32_t colour = ((command->parameter1 & 0xFF) >> 3) |
+			((logical_rshift(command->parameter1, 8) & 0xFF) >> 3) << 5 |
+			((logical_rshift(command->parameter1, 16) & 0xFF) >> 3) << 10;
+	int32_t transfer[] = {0, 0, x, y, width, height, colour,
+			GPU_TRANSFER_FILL};
+	GPU_batchTransfer(gpu, transfer);
 }
 
 /*
@@ -2234,8 +2342,10 @@ static void GPU_GP0_1F(GPU *gpu)
 	// Set IRQ flag in status register
 	gpu->statusRegister |= 0x01000000;
 
-	// Set flag in interrupt status register to trigger IRQ if enabled
-	SystemInterlink_setGPUInterruptDelay(gpu->system, 0);
+	// Set flag in interrupt status register to trigger IRQ if enabled - there
+	// is no system when replaying a trace
+	if (gpu->system)
+		SystemInterlink_setGPUInterruptDelay(gpu->system, 0);
 }
 
 /*
@@ -2245,18 +2355,14 @@ static void GPU_GP0_1F(GPU *gpu)
 static void GPU_GP0_80(GPU *gpu, int32_t command, int32_t sourceCoord,
 		int32_t destinationCoord, int32_t widthAndHeight)
 {
-	// Perform copying on GL thread, making sure to set pointers
-	GpuCommand gp0_80;
-	gp0_80.functionPointer = &GPU_GP0_80_implementation;
-	gp0_80.gpu = gpu;
-	
-	// Store parameters in object then submit it to work queue
-	gp0_80.parameter1 = command;
-	gp0_80.parameter2 = sourceCoord;
-	gp0_80.parameter3 = destinationCoord;
-	gp0_80.parameter4 = widthAndHeight;
-	gp0_80.statusRegister = gpu->statusRegister;
-	WorkQueue_addItem(gpu->wq, &gp0_80, false);
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_VRAM_COPY, 1);
+
+	// Perform copying on GL thread
+	int32_t parameters[] = {command, sourceCoord, destinationCoord,
+			widthAndHeight};
+	GPU_queueCommand(gpu, &GPU_GP0_80_implementation, parameters, 4, false);
 }
 
 /*
@@ -2264,17 +2370,20 @@ static void GPU_GP0_80(GPU *gpu, int32_t command, int32_t sourceCoord,
  */
 static void GPU_GP0_80_implementation(GpuCommand *command)
 {
-	// Get GL function pointers and GPU objects
+	// Get GPU object
 	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_copyRectangle(gpu->softRenderer, command);
+		return;
+	}
 
 	// Determine needed dimensions
 	int32_t width = command->parameter4 & 0xFFFF;
 	width = ((width - 1) & 0x3FF) + 1;
 	int32_t height = logical_rshift(command->parameter4, 16) & 0xFFFF;
 	height = ((height - 1) & 0x1FF) + 1;
-	width = (width == 0) ? 0x400 : width;
-	height = (height == 0) ? 0x200 : height;
 
 	// Determine source coordinate
 	int32_t source_x = command->parameter2 & 0x3FF;
@@ -2284,137 +2393,55 @@ static void GPU_GP0_80_implementation(GpuCommand *command)
 	int32_t destination_x = command->parameter3 & 0x3FF;
 	int32_t destination_y = logical_rshift(command->parameter3, 16) & 0x1FF;
 
-	// Adjust source and destination to account for OpenGL coordinate system
-	source_y = 511 - source_y;
-	source_y -= height - 1;
-	destination_y = 511 - destination_y;
-	destination_y -= height - 1;
-
 	// Split out masking bits from status register
-	int32_t setMask = logical_rshift(command->statusRegister, 11) & 0x1;
-	int32_t checkMask = logical_rshift(command->statusRegister, 12) & 0x1;
-
-	// Switch active texture unit to temp draw texture
-	gl->glActiveTexture(GL_TEXTURE1);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glActiveTexture called");
-
-	// Unbind temp draw texture from framebuffer object
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->tempDrawFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glFramebufferTexture2D called");
-
-	// Bind temp draw texture to image unit
-	gl->glBindImageTexture(0, gpu->tempDrawTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindImageTexture called");
-
-	// Switch active texture unit back to 0
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glActiveTexture called");
-
-	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glFramebufferTexture2D called");
-	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindImageTexture called");
-
-	// Bind to empty framebuffer, setting viewport and uniforms correctly
-	// for each program run
-
-	// Copy original rectangle to temp draw texture
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindFramebuffer called");
-	gl->glViewport(source_x, source_y, width, height);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glViewport called");
-	gl->glUseProgram(gpu->gp0_80Program1);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glUseProgram called");
-	gl->glUniform1i(0, source_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(1, source_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glDrawArrays called");
-	gl->glMemoryBarrier(GL_ALL_BARRIER_BITS);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glMemoryBarrier called");
-
-	// Write back from temp draw texture to new location
-	gl->glViewport(destination_x, destination_y, width, height);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glViewport called");
-	gl->glUseProgram(gpu->gp0_80Program2);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glUseProgram called");
-	gl->glUniform1i(0, destination_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(1, destination_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(2, setMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(3, checkMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glDrawArrays called");
-	gl->glMemoryBarrier(GL_ALL_BARRIER_BITS);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glMemoryBarrier called");
-
-	// Unbind textures from image units
-	gl->glBindImageTexture(0, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindImageTexture called");
-	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindImageTexture called");
-
-	// Rebind temp draw texture to FBO
-	gl->glActiveTexture(GL_TEXTURE1);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->tempDrawFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->tempDrawTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glFramebufferTexture2D called");
+	int32_t flags = 0;
+	if (command->statusRegister & 0x800)
+		flags |= GPU_TRANSFER_SET_MASK;
+	if (command->statusRegister & 0x1000)
+		flags |= GPU_TRANSFER_CHECK_MASK;
+
+	// Batch copy straight away if it doesn't overlap itself, or only reads
+	// each pixel it writes
+	int32_t transfer[] = {source_x, source_y, destination_x, destination_y,
+			width, height, 0, flags};
+	int32_t rowShift = (destination_y - source_y) & 0x1FF;
+	int32_t columnShift = (destination_x - source_x) & 0x3FF;
+	bool rowsOverlap = rowShift < height || 512 - rowShift < height;
+	bool columnsOverlap = columnShift < width || 1024 - columnShift < width;
+	if (!rowsOverlap || !columnsOverlap ||
+			(rowShift == 0 && columnShift == 0)) {
+		GPU_batchTransfer(gpu, transfer);
+		return;
+	}
 
-	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_GP0_80_implementation function, "
-			"glFramebufferTexture2D called");
+	// Otherwise each pixel has to be read before it is written over, so
+	// split the copy into bands no deeper than the distance it moves, with
+	// the band furthest along first - each band overlaps the one before,
+	// so it waits for it in a batch of its own. A copy wrapping all the way
+	// round vram onto itself can still read pixels it has already written
+	if (rowShift >= 256)
+		rowShift -= 512;
+	if (columnShift >= 512)
+		columnShift -= 1024;
+	bool byRows = rowShift != 0;
+	int32_t length = byRows ? height : width;
+	int32_t shift = byRows ? rowShift : columnShift;
+	int32_t bandSize = shift > 0 ? shift : -shift;
+	for (int32_t band = 0; band < length; band += bandSize) {
+		int32_t start = (shift > 0) ?
+				max_value(length - band - bandSize, 0) : band;
+		int32_t size = min_value(bandSize, length - band);
+		if (byRows) {
+			transfer[1] = source_y + start;
+			transfer[3] = destination_y + start;
+			transfer[5] = size;
+		} else {
+			transfer[0] = source_x + start;
+			transfer[2] = destination_x + start;
+			transfer[4] = size;
+		}
+		GPU_batchTransfer(gpu, transfer);
+	}
 }
 
 /*
@@ -2424,18 +2451,16 @@ static void GPU_GP0_80_implementation(GpuCommand *command)
 static void GPU_GP0_A0(GPU *gpu, int32_t command,
 		int32_t destination, int32_t dimensions)
 {
-	// Perform copying on GL thread, making sure to set pointers
-	GpuCommand gp0_a0;
-	gp0_a0.functionPointer = &GPU_GP0_A0_implementation;
-	gp0_a0.gpu = gpu;
-	
-	// Store parameters in object then submit it to work queue, waiting for
-	// it to finish executing
-	gp0_a0.parameter1 = command;
-	gp0_a0.parameter2 = destination;
-	gp0_a0.parameter3 = dimensions;
-	gp0_a0.statusRegister = gpu->statusRegister;
-	WorkQueue_addItem(gpu->wq, &gp0_a0, true);
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_VRAM_WRITE, 1);
+
+	// Perform copying on GL thread without waiting for it, handing over
+	// the staging slot and moving on to the next one
+	int32_t parameters[] = {command, destination, dimensions, gpu->uploadSlot};
+	atomic_store(&gpu->uploadSlotBusy[gpu->uploadSlot], true);
+	GPU_queueCommand(gpu, &GPU_GP0_A0_implementation, parameters, 4, false);
+	gpu->uploadSlot = (gpu->uploadSlot + 1) % GPU_UPLOAD_BUFFER_SLOTS;
 }
 
 /*
@@ -2447,6 +2472,19 @@ static void GPU_GP0_A0_implementation(GpuCommand *command)
 	GPU *gpu = command->gpu;
 	GLFunctionPointers *gl = gpu->gl;
 
+	// Hand over to the software renderer if it is in use, which is done
+	// with the staging slot as soon as it returns
+	if (gpu->softRenderer) {
+		int32_t slot = command->parameter4;
+		SoftRenderer_writeRectangle(gpu->softRenderer, command,
+				gpu->uploadBufferData + slot * GPU_UPLOAD_BUFFER_SLOT_SIZE);
+		atomic_store(&gpu->uploadSlotBusy[slot], false);
+		return;
+	}
+
+	// Draw any batched primitives, as this touches vram directly
+	GPU_endDrawingPass(gpu);
+
 	// Determine needed dimensions
 	int32_t width = command->parameter3 & 0xFFFF;
 	width = ((width - 1) & 0x3FF) + 1;
@@ -2463,24 +2501,43 @@ static void GPU_GP0_A0_implementation(GpuCommand *command)
 	y = 511 - y;
 	y -= height - 1;
 
+	// Record that the area being written to has changed
+	int32_t area[] = {x, y, x + width - 1, y + height - 1};
+	GPU_markVramWritten(gpu, area);
+
 	// Split out masking bits from status register
 	int32_t setMask = logical_rshift(command->statusRegister, 11) & 0x1;
 	int32_t checkMask = logical_rshift(command->statusRegister, 12) & 0x1;
 
-	// Copy DMA buffer pixels to temp draw texture, utilising dmaBufferMutex
-	// to ensure mutual exclusion
-	gl->glActiveTexture(GL_TEXTURE1);
+	// Hand back any staging slots the GPU has finished with
+	GPU_releaseUploadSlots(gpu);
+
+	// Copy staging slot pixels to temp draw texture - the two bytes of each
+	// pixel land in the red and green channels, which is all the shader
+	// reads - then fence off the slot so it can be released later
+	int32_t slot = command->parameter4;
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE1);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glActiveTexture called");
-	pthread_mutex_lock(&gpu->dmaBufferMutex);
+	gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gpu->uploadBuffer[0]);
+	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
+			"glBindBuffer called");
 	gl->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
-			GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, gpu->dmaBuffer);
+			GL_RG_INTEGER, GL_UNSIGNED_BYTE,
+			(const GLvoid *)((intptr_t)slot * GPU_UPLOAD_BUFFER_SLOT_SIZE));
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glTexSubImage2D called");
-	pthread_mutex_unlock(&gpu->dmaBufferMutex);
+	gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
+			"glBindBuffer called");
+	gpu->uploadBufferFences[slot] =
+			gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
+			"glFenceSync called");
 
 	// Unbind temp draw texture from framebuffer object
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->tempDrawFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->tempDrawFramebuffer[0]);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glBindFramebuffer called");
 	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
@@ -2495,12 +2552,13 @@ static void GPU_GP0_A0_implementation(GpuCommand *command)
 			"glBindImageTexture called");
 
 	// Switch active texture unit back to 0
-	gl->glActiveTexture(GL_TEXTURE0);
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE0);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glActiveTexture called");
 
 	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->vramFramebuffer[0]);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glBindFramebuffer called");
 	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
@@ -2513,34 +2571,38 @@ static void GPU_GP0_A0_implementation(GpuCommand *command)
 			"glBindImageTexture called");
 
 	// Bind to empty framebuffer, setting viewport and uniforms correctly
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->emptyFramebuffer[0]);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glBindFramebuffer called");
-	gl->glViewport(x, y, width, height);
+	GLStateCache_viewport(gpu->glState, x, y, width, height);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glViewport called");
-	gl->glUseProgram(gpu->gp0_a0Program);
+	GLStateCache_useProgram(gpu->glState, gpu->gp0_a0Program);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glUseProgram called");
-	gl->glUniform1i(0, x);
+	GLStateCache_uniform1i(gpu->glState, 0, x);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glUniform1i called");
-	gl->glUniform1i(1, y);
+	GLStateCache_uniform1i(gpu->glState, 1, y);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glUniform1i called");
-	gl->glUniform1i(2, height);
+	GLStateCache_uniform1i(gpu->glState, 2, height);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glUniform1i called");
-	gl->glUniform1i(3, setMask);
+	GLStateCache_uniform1i(gpu->glState, 3, setMask);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glUniform1i called");
-	gl->glUniform1i(4, checkMask);
+	GLStateCache_uniform1i(gpu->glState, 4, checkMask);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glUniform1i called");
 	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glDrawArrays called");
-	gl->glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	gl->glMemoryBarrier(GPU_IMAGE_STORE_BARRIER_BITS);
+	PHILPSX_TRACE_END(PHILPSX_TRACE_MEMORY_BARRIER, traceStart,
+			PHILPSX_TRACE_NO_ARGUMENT);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glMemoryBarrier called");
 
@@ -2555,10 +2617,11 @@ static void GPU_GP0_A0_implementation(GpuCommand *command)
 			"glBindImageTexture called");
 
 	// Rebind temp draw texture to FBO
-	gl->glActiveTexture(GL_TEXTURE1);
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE1);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->tempDrawFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->tempDrawFramebuffer[0]);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glBindFramebuffer called");
 	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
@@ -2567,10 +2630,11 @@ static void GPU_GP0_A0_implementation(GpuCommand *command)
 			"glFramebufferTexture2D called");
 
 	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE0);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->vramFramebuffer[0]);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_A0_implementation function, "
 			"glBindFramebuffer called");
 	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
@@ -2581,21 +2645,19 @@ static void GPU_GP0_A0_implementation(GpuCommand *command)
 
 /*
  * This method copys a rectangle from the VRAM by queuing it on the rendering
- * thread.
+ * thread. The copy lands in the vram read buffer, and GPU_waitForVramRead
+ * collects it when the response is first read.
  */
 static void GPU_GP0_C0(GPU *gpu, int32_t command,
 		int32_t destination, int32_t dimensions)
 {
-	// Perform copying on GL thread, making sure to set pointers
-	GpuCommand gp0_c0;
-	gp0_c0.functionPointer = &GPU_GP0_C0_implementation;
-	gp0_c0.gpu = gpu;
-	
-	// Store parameters in object then submit it to work queue
-	gp0_c0.parameter1 = command;
-	gp0_c0.parameter2 = destination;
-	gp0_c0.parameter3 = dimensions;
-	WorkQueue_addItem(gpu->wq, &gp0_c0, true);
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_VRAM_READ, 1);
+
+	// Perform copying on GL thread without waiting for it
+	int32_t parameters[] = {command, destination, dimensions};
+	GPU_queueCommand(gpu, &GPU_GP0_C0_implementation, parameters, 3, false);
 }
 
 /*
@@ -2615,6 +2677,21 @@ static void GPU_GP0_C0_implementation(GpuCommand *command)
 	width = (width == 0) ? 0x400 : width;
 	height = (height == 0) ? 0x200 : height;
 
+	// Hand over to the software renderer if it is in use, which reads the
+	// whole rectangle straight away
+	if (gpu->softRenderer) {
+		SoftRenderer_readRectangle(gpu->softRenderer, command,
+				gpu->vramReadBufferData);
+		gpu->vramReadWidth = width;
+		gpu->vramReadHeight = height;
+		gpu->vramReadClippedWidth = width;
+		gpu->vramReadFirstRow = 0;
+		return;
+	}
+
+	// Draw any batched primitives, as this touches vram directly
+	GPU_endDrawingPass(gpu);
+
 	// Determine starting position
 	int32_t x = command->parameter2 & 0x3FF;
 	int32_t y = logical_rshift(command->parameter2, 16) & 0x1FF;
@@ -2624,27 +2701,43 @@ static void GPU_GP0_C0_implementation(GpuCommand *command)
 	y -= height - 1;
 
 	// Bind VRAM FBO
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->vramFramebuffer[0]);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_C0_implementation function, "
 			"glBindFramebuffer called");
 
-	// Read pixels into byte buffer, utilising dmaBufferMutex to ensure mutual
-	// exclusion
-	pthread_mutex_lock(&gpu->dmaBufferMutex);
+	// Read pixels into the vram read buffer
+	gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, gpu->vramReadBuffer[0]);
+	GPU_checkOpenGLErrors(gpu, "GPU_GP0_C0_implementation function, "
+			"glBindBuffer called");
 	gl->glReadPixels(x, y, width, height, GL_RGBA_INTEGER,
-			GL_UNSIGNED_BYTE, gpu->dmaBuffer);
+			GL_UNSIGNED_BYTE, 0);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_C0_implementation function, "
 			"glReadPixels called");
-	pthread_mutex_unlock(&gpu->dmaBufferMutex);
+	gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	GPU_checkOpenGLErrors(gpu, "GPU_GP0_C0_implementation function, "
+			"glBindBuffer called");
 
-	// Bind to 0 FBO
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// Fence off the read and flush it, so the copy gets going while the
+	// emulator carries on - any unclaimed earlier read is dropped
+	if (gpu->vramReadFence)
+		gl->glDeleteSync(gpu->vramReadFence);
+	gpu->vramReadFence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_C0_implementation function, "
-			"glBindFramebuffer called");
+			"glFenceSync called");
+	gl->glFlush();
 
-	gl->glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	// Record which rows and columns glReadPixels actually wrote, as it
+	// clips the rectangle to the edges of vram
+	gpu->vramReadWidth = width;
+	gpu->vramReadHeight = height;
+	gpu->vramReadClippedWidth = (x + width > 1024) ? 1024 - x : width;
+	gpu->vramReadFirstRow = (y < 0) ? -y : 0;
+
+	// Bind to 0 FBO
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER, 0);
 	GPU_checkOpenGLErrors(gpu, "GPU_GP0_C0_implementation function, "
-			"glMemoryBarrier called");
+			"glBindFramebuffer called");
 }
 
 /*
@@ -2659,6 +2752,7 @@ static void GPU_GP0_E1(GPU *gpu, int32_t command)
 	// Set bit 15 of status register
 	gpu->statusRegister &= 0xFFFF7FFF;
 	gpu->statusRegister |= (command << 4) & 0x8000;
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2668,6 +2762,7 @@ static void GPU_GP0_E2(GPU *gpu, int32_t command)
 {
 	// Store in texture window variable
 	gpu->textureWindow = command & 0xFFFFF;
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2677,6 +2772,7 @@ static void GPU_GP0_E3(GPU *gpu, int32_t command)
 {
 	// Store in top-left drawing area variable
 	gpu->drawingAreaTopLeft = command & 0xFFFFF;
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2686,6 +2782,7 @@ static void GPU_GP0_E4(GPU *gpu, int32_t command)
 {
 	// Store in bottom-right drawing area variable
 	gpu->drawingAreaBottomRight = command & 0xFFFFF;
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2695,6 +2792,7 @@ static void GPU_GP0_E5(GPU *gpu, int32_t command)
 {
 	// Store in drawing offset variable
 	gpu->drawingOffset = command & 0x3FFFFF;
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2705,6 +2803,7 @@ static void GPU_GP0_E6(GPU *gpu, int32_t command)
 	// Set the two bits (11 and 12) in the status register
 	gpu->statusRegister &= 0xFFFFE7FF;
 	gpu->statusRegister |= (command & 0x3) << 11;
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2796,6 +2895,7 @@ static void GPU_GP1_05(GPU *gpu, int32_t command)
 	// Set X half-word address (0-1023)
 	gpu->xStart = command & 0x3FF;
 	gpu->yStart = logical_rshift(command, 10) & 0x1FF;
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2806,6 +2906,7 @@ static void GPU_GP1_06(GPU *gpu, int32_t command)
 	// Set X1 and X2
 	gpu->x1 = 0xFFF & command;
 	gpu->x2 = 0xFFF & logical_rshift(command, 12);
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2816,6 +2917,7 @@ static void GPU_GP1_07(GPU *gpu, int32_t command)
 	// Set Y1 and Y2
 	gpu->y1 = 0x3FF & command;
 	gpu->y2 = 0x3FF & logical_rshift(command, 10);
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2850,6 +2952,7 @@ static void GPU_GP1_08(GPU *gpu, int32_t command)
 
 	// Reverse flag
 	gpu->statusRegister |= (command & 0x80) << 7;
+	gpu->renderStateChanged = true;
 
 	// Now set cache values for horizontal resolution and dot factor
 	switch (tempHoriz2) {
@@ -2907,6 +3010,7 @@ static void GPU_GP1_09(GPU *gpu, int32_t command)
 
 	// Merge in command bit
 	gpu->statusRegister |= (command & 0x1) << 15;
+	gpu->renderStateChanged = true;
 }
 
 /*
@@ -2959,36 +3063,62 @@ static void GPU_GP1_10(GPU *gpu, int32_t command)
 	}
 }
 
+/*
+ * This function adds a word to the line buffer. Words alternate between
+ * colour and vertex, and once the buffer is full it is sent on as a packet,
+ * keeping the last colour/vertex pair back to start the next one.
+ */
+static void GPU_addLineWord(GPU *gpu, int32_t word)
+{
+	gpu->lineWords[gpu->lineWordCount++] = word;
+	if (gpu->lineWordCount == GPU_LINE_PACKET_WORDS) {
+		GPU_anyLine(gpu, gpu->fifoBuffer[0]);
+		gpu->lineWords[0] = gpu->lineWords[GPU_LINE_PACKET_WORDS - 2];
+		gpu->lineWords[1] = gpu->lineWords[GPU_LINE_PACKET_WORDS - 1];
+		gpu->lineWordCount = 2;
+	}
+}
+
 /*
  * This function renders all forms of line primitive supported by the
- * PlayStation hardware by queuing them on the rendering
- * thread.
+ * PlayStation hardware by queuing the contents of the line buffer on the
+ * rendering thread as one packet. The vertex count goes in the bottom byte
+ * of the command word, which the line commands don't otherwise use.
  */
-static void GPU_anyLine(GPU *gpu, int32_t command, ArrayList *paramList)
+static void GPU_anyLine(GPU *gpu, int32_t command)
 {
-	// Perform draw on GL thread, making sure to set pointers
-	GpuCommand anyLine;
-	anyLine.functionPointer = &GPU_anyLine_implementation;
-	anyLine.gpu = gpu;
-	
-	// Store parameters in object then submit it to work queue
-	anyLine.parameter1 = command;
-	anyLine.statusRegister = gpu->statusRegister;
-	anyLine.drawingAreaBottomRight = gpu->drawingAreaBottomRight;
-	anyLine.drawingAreaTopLeft = gpu->drawingAreaTopLeft;
-	anyLine.drawingOffset = gpu->drawingOffset;
-	WorkQueue_addItem(gpu->wq, &anyLine, false);
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_LINE, 1);
+
+	// Nothing to draw if this frame is being skipped, or we don't have a
+	// whole segment
+	int32_t vertexCount = gpu->lineWordCount / 2;
+	if (gpu->frameSkipped || vertexCount < 2)
+		return;
+
+	int32_t parameters[GPU_LINE_PACKET_WORDS + 1];
+	parameters[0] = (command & 0xFFFFFF00) | vertexCount;
+	memcpy(parameters + 1, gpu->lineWords,
+			sizeof(int32_t) * gpu->lineWordCount);
+	GPU_queueCommand(gpu, &GPU_anyLine_implementation, parameters,
+			gpu->lineWordCount + 1, false);
 }
 
 /*
- * This function contains the implementation of GPU_anyLine.
+ * This function contains the implementation of GPU_anyLine, drawing each
+ * segment of a line packet.
  */
 static void GPU_anyLine_implementation(GpuCommand *command)
 {
-	// Get GL function pointers and GPU objects
+	// Get GPU object
 	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
-	ArrayList *paramList = gpu->lineParameters;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_drawLine(gpu->softRenderer, command);
+		return;
+	}
 
 	// Extract command byte
 	int32_t commandByte = logical_rshift(command->parameter1, 24) & 0xFF;
@@ -3030,43 +3160,25 @@ static void GPU_anyLine_implementation(GpuCommand *command)
 	drawTopLeftY = 511 - drawTopLeftY;
 	drawBottomRightY = 511 - drawBottomRightY;
 
-	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glFramebufferTexture2D called");
-	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glBindImageTexture called");
-
-	// Bind to empty framebuffer, setting viewport correctly
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glBindFramebuffer called");
-	gl->glViewport(0, 0, 1024, 512);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glViewport called");
-
-	// Determine how many lines we are dealing with, then draw them
-	// all in a loop
-	size_t paramListSize = ArrayList_getSize(paramList);
-	for (size_t i = 0; i < paramListSize / 2 - 1; ++i) {
-
-		// Pull parameters from list
-		int32_t firstColour = (int32_t)(intptr_t)ArrayList_getObject(paramList, i * 2);
-		int32_t firstVertex =
-				(int32_t)(intptr_t)ArrayList_getObject(paramList, i * 2 + 1);
-		int32_t secondColour =
-				(int32_t)(intptr_t)ArrayList_getObject(paramList, i * 2 + 2);
-		int32_t secondVertex =
-				(int32_t)(intptr_t)ArrayList_getObject(paramList, i * 2 + 3);
+	// Pull colour/vertex pairs from command
+	int32_t vertexCount = command->parameter1 & 0xFF;
+	const int32_t lineWords[GPU_LINE_PACKET_WORDS] = {
+		command->parameter2, command->parameter3, command->parameter4,
+		command->parameter5, command->parameter6, command->parameter7,
+		command->parameter8, command->parameter9, command->parameter10,
+		command->parameter11
+	};
+	int32_t uniforms[] = {semiTransparencyMode, setMask, checkMask,
+			drawTopLeftX, drawTopLeftY, drawBottomRightX, drawBottomRightY,
+			dither};
+
+	// Add each segment to the current batch in turn - adjoining segments
+	// share an end point, so batching keeps them in order
+	for (int32_t i = 0; i < vertexCount - 1; ++i) {
+		int32_t firstColour = lineWords[i * 2];
+		int32_t firstVertex = lineWords[i * 2 + 1];
+		int32_t secondColour = lineWords[i * 2 + 2];
+		int32_t secondVertex = lineWords[i * 2 + 3];
 
 		// Get first colour and vertex, sign extending vertex if needed
 		int32_t firstRed = firstColour & 0xFF;
@@ -3104,96 +3216,407 @@ static void GPU_anyLine_implementation(GpuCommand *command)
 		second_x += drawXOffset;
 		second_y += drawYOffset;
 
-		// Draw line to vram texture, setting uniforms correctly
-		gl->glUseProgram(gpu->anyLineProgram1);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUseProgram called");
-		gl->glUniform1i(0, first_x);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(1, first_y);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(2, second_x);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(3, second_y);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(4, firstRed);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(5, firstGreen);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(6, firstBlue);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(7, secondRed);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(8, secondGreen);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(9, secondBlue);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(10, semiTransparencyEnabled);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(11, semiTransparencyMode);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(12, setMask);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(13, checkMask);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(14, drawTopLeftX);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(15, drawTopLeftY);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(16, drawBottomRightX);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(17, drawBottomRightY);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glUniform1i(18, dither);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glUniform1i called");
-		gl->glDrawArrays(GL_LINES, 0, 2);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glDrawArrays called");
-		gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-		GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glMemoryBarrier called");
+		// Build vertices
+		GpuVertex vertices[] = {
+			{
+				.position = {first_x, first_y},
+				.colour = {firstRed, firstGreen, firstBlue},
+				.primitive1 = {semiTransparencyEnabled}
+			},
+			{
+				.position = {second_x, second_y},
+				.colour = {secondRed, secondGreen, secondBlue},
+				.primitive1 = {semiTransparencyEnabled}
+			}
+		};
+
+		// Add line to the current batch
+		int32_t vertex_x[] = {first_x, second_x};
+		int32_t vertex_y[] = {first_y, second_y};
+		int32_t drawnArea[4];
+		GPU_getDrawnArea(drawnArea, vertex_x, vertex_y, 2, drawTopLeftX,
+				drawTopLeftY, drawBottomRightX, drawBottomRightY);
+		GPU_batchPrimitive(gpu, gpu->anyLineProgram1, GL_LINES, uniforms, 8,
+				vertices, 2, drawnArea, NULL, 0);
+	}
+}
+
+/*
+ * This function adds a three or four point polygon to the current batch. The
+ * two triangles of a four point polygon go in as separate primitives if the
+ * second one could see what the first one drew - either because they overlap
+ * (the outer corners lie on the same side of the shared edge) without
+ * fragment shader interlock to order them, or because the polygon reads from
+ * vram it draws to.
+ */
+static void GPU_batchPolygon(GPU *gpu, GLuint program,
+		const int32_t *uniforms, int32_t uniformCount,
+		const GpuVertex *vertices, int32_t fourPoints,
+		const int32_t *vertex_x, const int32_t *vertex_y,
+		const int32_t *drawingArea, const int32_t *readAreas,
+		int32_t readAreaCount)
+{
+	// Get area of vram the whole polygon draws to
+	int32_t drawnArea[4];
+	GPU_getDrawnArea(drawnArea, vertex_x, vertex_y, 3 + fourPoints,
+			drawingArea[0], drawingArea[1], drawingArea[2], drawingArea[3]);
+
+	// Check whether the triangles need ordering between them
+	bool splitTriangles = false;
+	if (fourPoints == 1 && !gpu->fragmentShaderInterlock) {
+		int64_t edge_x = vertex_x[2] - vertex_x[1];
+		int64_t edge_y = vertex_y[2] - vertex_y[1];
+		int64_t firstSide = edge_x * (vertex_y[0] - vertex_y[1]) -
+				edge_y * (vertex_x[0] - vertex_x[1]);
+		int64_t lastSide = edge_x * (vertex_y[3] - vertex_y[1]) -
+				edge_y * (vertex_x[3] - vertex_x[1]);
+		splitTriangles = (firstSide > 0 && lastSide > 0) ||
+				(firstSide < 0 && lastSide < 0);
+	}
+	if (fourPoints == 1) {
+		for (int32_t i = 0; i < readAreaCount; ++i) {
+			const int32_t *readArea = readAreas + i * 4;
+			if (readArea[0] <= drawnArea[2] && drawnArea[0] <= readArea[2] &&
+					readArea[1] <= drawnArea[3] &&
+					drawnArea[1] <= readArea[3])
+				splitTriangles = true;
+		}
+	}
+
+	// Add polygon as one primitive, or one triangle at a time
+	if (!splitTriangles) {
+		GPU_batchPrimitive(gpu, program, GL_TRIANGLES, uniforms,
+				uniformCount, vertices, 3 + fourPoints * 3, drawnArea,
+				readAreas, readAreaCount);
+	} else {
+		for (int32_t i = 0; i < 2; ++i) {
+			GPU_getDrawnArea(drawnArea, vertex_x + i, vertex_y + i, 3,
+					drawingArea[0], drawingArea[1], drawingArea[2],
+					drawingArea[3]);
+			GPU_batchPrimitive(gpu, program, GL_TRIANGLES, uniforms,
+					uniformCount, vertices + i * 3, 3, drawnArea, readAreas,
+					readAreaCount);
+		}
+	}
+}
+
+/*
+ * This function adds a primitive to the current batch, flushing the batch
+ * first if the primitive needs a different program or uniform values, or if
+ * it would touch vram that the batch has already drawn to or read from. It is
+ * intended to be called from the GL context thread.
+ */
+static void GPU_batchPrimitive(GPU *gpu, GLuint program, GLenum mode,
+		const int32_t *uniforms, int32_t uniformCount,
+		const GpuVertex *vertices, int32_t vertexCount,
+		const int32_t *drawnArea, const int32_t *readAreas,
+		int32_t readAreaCount)
+{
+	// Get GLFunctionPointers reference
+	GLFunctionPointers *gl = gpu->gl;
+
+	// Work out which tiles the primitive draws to, doing nothing if it
+	// can't draw anything at all
+	int32_t drawnFirstRow, drawnLastRow;
+	uint64_t drawnMask =
+			GPU_getTileMask(drawnArea, &drawnFirstRow, &drawnLastRow);
+	if (drawnMask == 0)
+		return;
+
+	// Setup vram for image load/store if needed
+	if (!gpu->drawingPassActive)
+		GPU_beginDrawingPass(gpu);
+
+	// Fragments within one draw call are unordered, so if this primitive
+	// overlaps anything the batch has drawn, or draws over anything the
+	// batch reads, it needs to go in a new batch after a memory barrier.
+	// Fragment shader interlock keeps each pixel's accesses in order, so
+	// only the reads matter then
+	bool overlap = false;
+	for (int32_t row = drawnFirstRow; row <= drawnLastRow; ++row) {
+		uint64_t tiles = gpu->batchReadTiles[row];
+		if (!gpu->fragmentShaderInterlock)
+			tiles |= gpu->batchDrawnTiles[row];
+		if ((tiles & drawnMask) != 0) {
+			overlap = true;
+			break;
+		}
+	}
+	uint64_t readMasks[GPU_MAX_READ_AREAS];
+	int32_t readFirstRows[GPU_MAX_READ_AREAS];
+	int32_t readLastRows[GPU_MAX_READ_AREAS];
+	for (int32_t i = 0; i < readAreaCount; ++i) {
+		readMasks[i] = GPU_getTileMask(readAreas + i * 4, &readFirstRows[i],
+				&readLastRows[i]);
+		for (int32_t row = readFirstRows[i]; row <= readLastRows[i]; ++row) {
+			if ((gpu->batchDrawnTiles[row] & readMasks[i]) != 0) {
+				overlap = true;
+				break;
+			}
+		}
+	}
+	if (overlap)
+		GPU_flushBatch(gpu);
+
+	// Pending vram transfers are unordered against the batch too, so run
+	// them first if this primitive draws over anything they touch, or reads
+	// anything they write
+	overlap = false;
+	for (int32_t row = drawnFirstRow; row <= drawnLastRow; ++row) {
+		if (((gpu->transferWrittenTiles[row] | gpu->transferReadTiles[row]) &
+				drawnMask) != 0) {
+			overlap = true;
+			break;
+		}
+	}
+	for (int32_t i = 0; i < readAreaCount && !overlap; ++i) {
+		for (int32_t row = readFirstRows[i]; row <= readLastRows[i]; ++row) {
+			if ((gpu->transferWrittenTiles[row] & readMasks[i]) != 0) {
+				overlap = true;
+				break;
+			}
+		}
+	}
+	if (overlap)
+		GPU_flushTransfers(gpu);
+
+	// Switch state if this primitive needs a different program or uniform
+	// values to the current batch - the state cache remembers the uniform
+	// values of each program, so only values that have changed are set
+	if (program != gpu->batchProgram || mode != gpu->batchMode ||
+			memcmp(uniforms, gpu->batchUniforms,
+			uniformCount * sizeof(int32_t)) != 0) {
+		GPU_flushBatch(gpu);
+		GLStateCache_useProgram(gpu->glState, program);
+		GPU_checkOpenGLErrors(gpu, "GPU_batchPrimitive function, "
+				"glUseProgram called");
+		for (int32_t i = 0; i < uniformCount; ++i) {
+			GLStateCache_uniform1i(gpu->glState, i, uniforms[i]);
+			GPU_checkOpenGLErrors(gpu, "GPU_batchPrimitive function, "
+					"glUniform1i called");
+		}
+		memcpy(gpu->batchUniforms, uniforms, uniformCount * sizeof(int32_t));
+		gpu->batchProgram = program;
+		gpu->batchMode = mode;
+	}
+
+	// Move on to the next segment of the vertex buffer if this one is full,
+	// fencing off the old segment and making sure the GPU has finished
+	// reading from the new one before we overwrite it
+	int32_t segmentEnd = (gpu->vertexBufferSegment + 1) *
+			GPU_VERTEX_BUFFER_SEGMENT_SIZE;
+	if (gpu->batchFirstVertex + gpu->batchVertexCount + vertexCount >
+			segmentEnd) {
+		GPU_flushBatch(gpu);
+		gpu->vertexBufferFences[gpu->vertexBufferSegment] =
+				gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		GPU_checkOpenGLErrors(gpu, "GPU_batchPrimitive function, "
+				"glFenceSync called");
+		gpu->vertexBufferSegment = (gpu->vertexBufferSegment + 1) %
+				GPU_VERTEX_BUFFER_SEGMENTS;
+		GLsync fence = gpu->vertexBufferFences[gpu->vertexBufferSegment];
+		if (fence) {
+			while (gl->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+					1000000000) == GL_TIMEOUT_EXPIRED);
+			gl->glDeleteSync(fence);
+			gpu->vertexBufferFences[gpu->vertexBufferSegment] = NULL;
+		}
+		gpu->batchFirstVertex = gpu->vertexBufferSegment *
+				GPU_VERTEX_BUFFER_SEGMENT_SIZE;
 	}
 
-	// Unbind texture from image unit
-	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
-			"glBindImageTexture called");
+	// Copy vertices into the buffer, and record which tiles of vram the
+	// batch now touches
+	memcpy(gpu->vertexBufferData + gpu->batchFirstVertex +
+			gpu->batchVertexCount, vertices, vertexCount * sizeof(GpuVertex));
+	gpu->batchVertexCount += vertexCount;
+	for (int32_t row = drawnFirstRow; row <= drawnLastRow; ++row)
+		gpu->batchDrawnTiles[row] |= drawnMask;
+	GPU_markVramWritten(gpu, drawnArea);
+	for (int32_t i = 0; i < readAreaCount; ++i) {
+		for (int32_t row = readFirstRows[i]; row <= readLastRows[i]; ++row)
+			gpu->batchReadTiles[row] |= readMasks[i];
+	}
+}
 
-	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
+/*
+ * This function adds a vram transfer to the current batch of transfers,
+ * which runs as one compute dispatch on vram while it is setup for a
+ * drawing pass. A transfer is given as eight values - source x and y,
+ * destination x and y, width, height, fill colour and flags - with
+ * positions in the PlayStation's coordinates, wrapping at the edges of
+ * vram. The pending transfers or primitives are run first if the transfer
+ * would touch vram they have written to or read from. It is intended to be
+ * called from the GL context thread.
+ */
+static void GPU_batchTransfer(GPU *gpu, const int32_t *transfer)
+{
+	// Work out which tiles the transfer writes to and reads from, leaving
+	// out the source of fills
+	int32_t writtenAreas[16];
+	int32_t readAreas[16];
+	int32_t writtenAreaCount = GPU_getWrappedAreas(writtenAreas, transfer[2],
+			transfer[3], transfer[4], transfer[5]);
+	int32_t readAreaCount = (transfer[7] & GPU_TRANSFER_FILL) ? 0 :
+			GPU_getWrappedAreas(readAreas, transfer[0], transfer[1],
+			transfer[4], transfer[5]);
+	uint64_t writtenTiles[GPU_TILE_ROWS] = {0};
+	uint64_t readTiles[GPU_TILE_ROWS] = {0};
+	for (int32_t i = 0; i < writtenAreaCount + readAreaCount; ++i) {
+		bool written = i < writtenAreaCount;
+		const int32_t *area = written ? writtenAreas + i * 4 :
+				readAreas + (i - writtenAreaCount) * 4;
+		int32_t firstRow, lastRow;
+		uint64_t mask = GPU_getTileMask(area, &firstRow, &lastRow);
+		for (int32_t row = firstRow; row <= lastRow; ++row) {
+			if (written)
+				writtenTiles[row] |= mask;
+			else
+				readTiles[row] |= mask;
+		}
+	}
+
+	// Setup vram for image load/store if needed
+	if (!gpu->drawingPassActive)
+		GPU_beginDrawingPass(gpu);
+
+	// Invocations within one dispatch are unordered, as are the pending
+	// transfers and primitives, so run whichever of them this transfer
+	// overlaps (or a full batch) first
+	bool primitiveOverlap = false;
+	bool transferOverlap = gpu->transferCount == GPU_MAX_BATCHED_TRANSFERS;
+	for (int32_t row = 0; row < GPU_TILE_ROWS; ++row) {
+		if ((writtenTiles[row] & (gpu->batchDrawnTiles[row] |
+				gpu->batchReadTiles[row])) != 0 ||
+				(readTiles[row] & gpu->batchDrawnTiles[row]) != 0)
+			primitiveOverlap = true;
+		if ((writtenTiles[row] & (gpu->transferWrittenTiles[row] |
+				gpu->transferReadTiles[row])) != 0 ||
+				(readTiles[row] & gpu->transferWrittenTiles[row]) != 0)
+			transferOverlap = true;
+	}
+	if (primitiveOverlap)
+		GPU_flushBatch(gpu);
+	if (transferOverlap)
+		GPU_flushTransfers(gpu);
+
+	// Add transfer to the batch, and record which tiles of vram the batch
+	// now touches
+	memcpy(gpu->transferBatch + gpu->transferCount * 8, transfer,
+			8 * sizeof(int32_t));
+	++gpu->transferCount;
+	gpu->transferMaxWidth = max_value(gpu->transferMaxWidth, transfer[4]);
+	gpu->transferMaxHeight = max_value(gpu->transferMaxHeight, transfer[5]);
+	for (int32_t row = 0; row < GPU_TILE_ROWS; ++row) {
+		gpu->transferWrittenTiles[row] |= writtenTiles[row];
+		gpu->transferReadTiles[row] |= readTiles[row];
+	}
+	for (int32_t i = 0; i < writtenAreaCount; ++i)
+		GPU_markVramWritten(gpu, writtenAreas + i * 4);
+}
+
+/*
+ * This function sets up vram for drawing primitives with image load/store,
+ * so that it can stay setup across many batches. It is intended to be
+ * called from the GL context thread.
+ */
+static void GPU_beginDrawingPass(GPU *gpu)
+{
+	// Get GLFunctionPointers reference
+	GLFunctionPointers *gl = gpu->gl;
+
+	// Unbind vram texture from FBO so we can attach it to image unit
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE0);
+	GPU_checkOpenGLErrors(gpu, "GPU_beginDrawingPass function, "
 			"glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->vramFramebuffer[0]);
+	GPU_checkOpenGLErrors(gpu, "GPU_beginDrawingPass function, "
 			"glBindFramebuffer called");
 	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_anyLine_implementation function, "
+			GL_TEXTURE_2D, 0, 0);
+	GPU_checkOpenGLErrors(gpu, "GPU_beginDrawingPass function, "
 			"glFramebufferTexture2D called");
+	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
+			GL_READ_WRITE, GL_RGBA8UI);
+	GPU_checkOpenGLErrors(gpu, "GPU_beginDrawingPass function, "
+			"glBindImageTexture called");
+
+	// Bind to empty framebuffer, setting viewport correctly
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->emptyFramebuffer[0]);
+	GPU_checkOpenGLErrors(gpu, "GPU_beginDrawingPass function, "
+			"glBindFramebuffer called");
+	GLStateCache_viewport(gpu->glState, 0, 0, 1024, 512);
+	GPU_checkOpenGLErrors(gpu, "GPU_beginDrawingPass function, "
+			"glViewport called");
+
+	// Other routines use their own programs, so make sure the first batch
+	// switches back to its program
+	gpu->batchProgram = 0;
+	gpu->drawingPassActive = true;
 }
 
 /*
- * This function creates a shader program using the specified name. It is
- * intended to be called from the GL context thread.
+ * This function starts a requested trace, snapshotting vram and then
+ * recording words that put the registers (other than those only set by
+ * GP1(0x00)) back as they are now. It must only be called while GP0 is
+ * idle, as the snapshot goes through the GP0(0xC0) read path.
+ */
+static void GPU_beginTrace(GPU *gpu)
+{
+	// Take snapshot, and create trace with it
+	int8_t *vram = malloc(PHILPSX_GPUTRACE_VRAM_SIZE);
+	if (!vram) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for trace "
+				"vram snapshot\n");
+		goto end;
+	}
+	GPU_readVram(gpu, vram);
+	gpu->trace = construct_GpuTrace(gpu->tracePath, vram, true);
+	if (!gpu->trace)
+		goto cleanup_vram;
+
+	// Record register state, as the display and drawing settings commands
+	// would set it
+	int32_t status = gpu->statusRegister;
+	int32_t gp1Words[] = {
+		0x03000000 | (logical_rshift(status, 23) & 0x1),
+		0x04000000 | (logical_rshift(status, 29) & 0x3),
+		0x05000000 | gpu->xStart | (gpu->yStart << 10),
+		0x06000000 | gpu->x1 | (gpu->x2 << 12),
+		0x07000000 | gpu->y1 | (gpu->y2 << 10),
+		0x08000000 | (logical_rshift(status, 17) & 0x3F) |
+				(logical_rshift(status, 10) & 0x40) |
+				(logical_rshift(status, 7) & 0x80)
+	};
+	int32_t gp0Words[] = {
+		0xE1000000 | (status & 0x7FF) | (logical_rshift(status, 4) & 0x800),
+		0xE2000000 | gpu->textureWindow,
+		0xE3000000 | gpu->drawingAreaTopLeft,
+		0xE4000000 | gpu->drawingAreaBottomRight,
+		0xE5000000 | gpu->drawingOffset,
+		0xE6000000 | (logical_rshift(status, 11) & 0x3)
+	};
+	for (int32_t i = 0; i < 6; ++i)
+		GPU_recordTrace(gpu, PHILPSX_GPUTRACE_GP1, gp1Words[i]);
+	for (int32_t i = 0; i < 6; ++i)
+		GPU_recordTrace(gpu, PHILPSX_GPUTRACE_GP0, gp0Words[i]);
+
+	cleanup_vram:
+	free(vram);
+
+	// Forget the request either way, so it isn't tried again
+	end:
+	free(gpu->tracePath);
+	gpu->tracePath = NULL;
+}
+
+/*
+ * This function creates a shader program using the specified name, loading
+ * it from the program cache if it was stored by an earlier run, and storing
+ * it there otherwise. Programs with a compute shader have no other shaders.
+ * It is intended to be called from the GL context thread.
  */
 static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 		int shaderNumber)
@@ -3204,27 +3627,22 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 	// Define source strings for shaders
 	const char *vertexShaderSource;
 	const char *fragmentShaderSource;
+	const char *computeShaderSource = NULL;
 	if (strncmp(name, "AnyLine", strlen("AnyLine")) == 0) {
 		vertexShaderSource = GPU_getAnyLine_VertexShader1Source();
 		fragmentShaderSource = GPU_getAnyLine_FragmentShader1Source();
 	}
 	else if (strncmp(name, "DisplayScreen", strlen("DisplayScreen")) == 0) {
-		vertexShaderSource = GPU_getDisplayScreen_VertexShader1Source();
-		fragmentShaderSource = GPU_getDisplayScreen_FragmentShader1Source();
-	}
-	else if (strncmp(name, "GP0_02", strlen("GP0_02")) == 0) {
-		vertexShaderSource = GPU_getGP0_02_VertexShader1Source();
-		fragmentShaderSource = GPU_getGP0_02_FragmentShader1Source();
-	}
-	else if (strncmp(name, "GP0_80", strlen("GP0_80")) == 0) {
 		switch (shaderNumber) {
 			case 1:
-				vertexShaderSource = GPU_getGP0_80_VertexShader1Source();
-				fragmentShaderSource = GPU_getGP0_80_FragmentShader1Source();
+				vertexShaderSource =
+						GPU_getDisplayScreen_VertexShader1Source();
+				fragmentShaderSource =
+						GPU_getDisplayScreen_FragmentShader1Source();
 				break;
 			case 2:
-				vertexShaderSource = GPU_getGP0_80_VertexShader2Source();
-				fragmentShaderSource = GPU_getGP0_80_FragmentShader2Source();
+				computeShaderSource =
+						GPU_getDisplayScreen_ComputeShader1Source();
 				break;
 		}
 	}
@@ -3257,6 +3675,10 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 		fragmentShaderSource =
 				GPU_getShadedTexturedPolygon_FragmentShader1Source();
 	}
+	else if (strncmp(name, "TextureCache", strlen("TextureCache")) == 0) {
+		vertexShaderSource = GPU_getTextureCache_VertexShader1Source();
+		fragmentShaderSource = GPU_getTextureCache_FragmentShader1Source();
+	}
 	else if (strncmp(name, "TexturedPolygon", strlen("TexturedPolygon")) == 0) {
 		vertexShaderSource = GPU_getTexturedPolygon_VertexShader1Source();
 		fragmentShaderSource = GPU_getTexturedPolygon_FragmentShader1Source();
@@ -3268,9 +3690,28 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 		fragmentShaderSource =
 				GPU_getTexturedRectangle_FragmentShader1Source();
 	}
+	else if (strncmp(name, "VramTransfer", strlen("VramTransfer")) == 0) {
+		computeShaderSource = GPU_getVramTransfer_ComputeShader1Source();
+	}
+
+	// Compute shaders are compiled on their own, and cached in place of the
+	// vertex shader
+	if (computeShaderSource) {
+		vertexShaderSource = computeShaderSource;
+		fragmentShaderSource = "";
+	}
+
+	// Load program from the cache if we can, so there is nothing to compile
+	char cacheName[64];
+	snprintf(cacheName, sizeof(cacheName), "%s_%d", name, shaderNumber);
+	GLuint program = GLProgramCache_loadProgram(gpu->programCache,
+			cacheName, vertexShaderSource, fragmentShaderSource);
+	if (program != 0)
+		return program;
 	
 	// Compile shaders now
-	GLuint vs = gl->glCreateShader(GL_VERTEX_SHADER);
+	GLuint vs = gl->glCreateShader(computeShaderSource ? GL_COMPUTE_SHADER :
+			GL_VERTEX_SHADER);
 	GPU_checkOpenGLErrors(gpu, "GPU createShaderProgram function, "
 								"glCreateShader called");
 	GLint vsSourceLength[1] = { strlen(vertexShaderSource) };
@@ -3281,16 +3722,19 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
 								"glCompileShader called");
 
-	GLuint fs = gl->glCreateShader(GL_FRAGMENT_SHADER);
-	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
-								"glCreateShader called");
-	GLint fsSourceLength[1] = { strlen(fragmentShaderSource) };
-	gl->glShaderSource(fs, 1, &fragmentShaderSource, fsSourceLength);
-	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
-								"glShaderSource called");
-	gl->glCompileShader(fs);
-	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
-								"glCompileShader called");
+	GLuint fs = 0;
+	if (!computeShaderSource) {
+		fs = gl->glCreateShader(GL_FRAGMENT_SHADER);
+		GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
+									"glCreateShader called");
+		GLint fsSourceLength[1] = { strlen(fragmentShaderSource) };
+		gl->glShaderSource(fs, 1, &fragmentShaderSource, fsSourceLength);
+		GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
+									"glShaderSource called");
+		gl->glCompileShader(fs);
+		GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
+									"glCompileShader called");
+	}
 
 	// Check compilation status, cleaning up if it failed
 	GLuint compilationStatus[1];
@@ -3298,21 +3742,23 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
 								"glGetShaderiv called");
 	if (compilationStatus[0] == GL_FALSE) {
-		fprintf(stderr, "PhilPSX: GPU: %s vertex shader compilation failed\n",
-				name);
+		fprintf(stderr, "PhilPSX: GPU: %s %s shader compilation failed\n",
+				name, computeShaderSource ? "compute" : "vertex");
 		goto cleanup_shaders;
 	}
-	gl->glGetShaderiv(fs, GL_COMPILE_STATUS, compilationStatus);
-	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
-								"glGetShaderiv called");
-	if (compilationStatus[0] == GL_FALSE) {
-		fprintf(stderr, "PhilPSX: GPU: %s fragment shader compilation failed\n",
-				name);
-		goto cleanup_shaders;
+	if (fs) {
+		gl->glGetShaderiv(fs, GL_COMPILE_STATUS, compilationStatus);
+		GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
+									"glGetShaderiv called");
+		if (compilationStatus[0] == GL_FALSE) {
+			fprintf(stderr, "PhilPSX: GPU: %s fragment shader compilation "
+					"failed\n", name);
+			goto cleanup_shaders;
+		}
 	}
 
 	// Create and link program
-	GLuint program = gl->glCreateProgram();
+	program = gl->glCreateProgram();
 	if (program == 0) {
 		fprintf(stderr, "PhilPSX: GPU: %s OpenGL shader program creation "
 						"failed\n", name);
@@ -3323,17 +3769,21 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 	gl->glAttachShader(program, vs);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
 								"glAttachShader called")) {
-		fprintf(stderr, "PhilPSX: GPU: Attaching %s OpenGL vertex shader "
-						"to program object failed\n", name);
+		fprintf(stderr, "PhilPSX: GPU: Attaching %s OpenGL %s shader "
+						"to program object failed\n", name,
+						computeShaderSource ? "compute" : "vertex");
 		goto cleanup_program;
 	}
-	gl->glAttachShader(program, fs);
-	if (GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
-								"glAttachShader")) {
-		fprintf(stderr, "PhilPSX: GPU: Attaching %s OpenGL fragment shader "
-						"to program object failed\n", name);
-		goto cleanup_program;
+	if (fs) {
+		gl->glAttachShader(program, fs);
+		if (GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
+									"glAttachShader")) {
+			fprintf(stderr, "PhilPSX: GPU: Attaching %s OpenGL fragment "
+							"shader to program object failed\n", name);
+			goto cleanup_program;
+		}
 	}
+	GLProgramCache_prepareProgram(gpu->programCache, program);
 	gl->glLinkProgram(program);
 	if (GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
 								"glLinkProgram called")) {
@@ -3346,15 +3796,23 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 	gl->glDetachShader(program, vs);
 	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
 								"glDetachShader called");
-	gl->glDetachShader(program, fs);
-	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
-								"glDetachShader called");
+	if (fs) {
+		gl->glDetachShader(program, fs);
+		GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
+									"glDetachShader called");
+	}
 	gl->glDeleteShader(vs);
 	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
 								"glDeleteShader called");
-	gl->glDeleteShader(fs);
-	GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
-								"glDeleteShader called");
+	if (fs) {
+		gl->glDeleteShader(fs);
+		GPU_checkOpenGLErrors(gpu, "GPU_createShaderProgram function, "
+									"glDeleteShader called");
+	}
+
+	// Store program so the next run can skip compiling it
+	GLProgramCache_storeProgram(gpu->programCache, cacheName,
+			vertexShaderSource, fragmentShaderSource, program);
 
 	// Normal return path:
 	return program;
@@ -3372,91 +3830,677 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 	return 0;
 }
 
+#ifdef PHILPSX_DEBUG_BUILD
+/*
+ * This function is the KHR_debug callback, and reports anything more serious
+ * than a notification from the GL driver.
+ */
+static void APIENTRY GPU_debugMessageCallback(GLenum source, GLenum type,
+		GLuint id, GLenum severity, GLsizei length, const GLchar *message,
+		const void *userParam)
+{
+	if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+		return;
+
+	fprintf(stderr, "PhilPSX: GPU: OpenGL debug message: %s\n", message);
+}
+#endif
+
+/*
+ * This function decodes the texture page described by a texture cache entry
+ * into its layer of the texture cache. It expects a drawing pass to be
+ * active with an empty batch, and leaves things setup for the next batch. It
+ * is intended to be called from the GL context thread.
+ */
+static void GPU_decodeTexturePage(GPU *gpu, int32_t layer)
+{
+	// Get GLFunctionPointers reference and entry
+	GLFunctionPointers *gl = gpu->gl;
+	GpuTextureCacheEntry *entry = &gpu->textureCache[layer];
+
+	// Attach layer to texture cache FBO, setting viewport to cover it
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->textureCacheFramebuffer[0]);
+	GPU_checkOpenGLErrors(gpu, "GPU_decodeTexturePage function, "
+			"glBindFramebuffer called");
+	gl->glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			gpu->textureCacheTexture[0], 0, layer);
+	GPU_checkOpenGLErrors(gpu, "GPU_decodeTexturePage function, "
+			"glFramebufferTextureLayer called");
+	GLStateCache_viewport(gpu->glState, 0, 0, 256, 256);
+	GPU_checkOpenGLErrors(gpu, "GPU_decodeTexturePage function, "
+			"glViewport called");
+
+	// Decode page from vram, which is still bound to its image unit
+	GLStateCache_useProgram(gpu->glState, gpu->textureCacheProgram);
+	GPU_checkOpenGLErrors(gpu, "GPU_decodeTexturePage function, "
+			"glUseProgram called");
+	int32_t uniforms[] = {entry->texBaseX, entry->texBaseY,
+			entry->texColourMode, entry->clut_x, entry->clut_y};
+	for (int32_t i = 0; i < 5; ++i) {
+		GLStateCache_uniform1i(gpu->glState, i, uniforms[i]);
+		GPU_checkOpenGLErrors(gpu, "GPU_decodeTexturePage function, "
+				"glUniform1i called");
+	}
+	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	GPU_checkOpenGLErrors(gpu, "GPU_decodeTexturePage function, "
+			"glDrawArrays called");
+
+	// Go back to empty framebuffer for the next batch, making sure it
+	// switches back to its program
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->emptyFramebuffer[0]);
+	GPU_checkOpenGLErrors(gpu, "GPU_decodeTexturePage function, "
+			"glBindFramebuffer called");
+	GLStateCache_viewport(gpu->glState, 0, 0, 1024, 512);
+	GPU_checkOpenGLErrors(gpu, "GPU_decodeTexturePage function, "
+			"glViewport called");
+	gpu->batchProgram = 0;
+}
+
+/*
+ * This function displays the screen at the end of each frame, by queuing
+ * this work on the rendering thread.
+ */
+static void GPU_displayScreen(GPU *gpu)
+{	
+	// Perform draw on GL thread, passing the colour depth as the command only
+	// gets the low half of the status register
+	int32_t parameters[] = {gpu->dotFactor, gpu->interlaceEnabled ? 1 : 0,
+			(gpu->statusRegister >> 21) & 0x1};
+	GPU_queueCommand(gpu, &GPU_displayScreen_implementation, parameters, 3,
+			false);
+}
+
+/*
+ * This function contains the implementation of GPU_displayScreen.
+ */
+static void GPU_displayScreen_implementation(GpuCommand *command)
+{
+	// Get GL function pointers and GPU objects
+	GPU *gpu = command->gpu;
+	GLFunctionPointers *gl = gpu->gl;
+
+	// Determine resolution parameters
+	int32_t topX = command->xStart;
+	int32_t topY = command->yStart;
+
+	int32_t pixelsPerLine = (((command->x2 - command->x1) /
+			command->parameter1) + 2) & 0xFFFFFFFC;
+	int32_t lines = command->y2 - command->y1;
+	if (command->parameter2 == 1)
+		lines *= 2;
+
+	// Hand over to the software renderer if it is in use, which gives the
+	// frame to the frame sink in place of the window if there is one
+	if (gpu->softRenderer) {
+		if (gpu->frameSink) {
+			const uint32_t *pixels = SoftRenderer_readDisplay(
+					gpu->softRenderer, topX, topY, pixelsPerLine, lines);
+			if (pixels)
+				gpu->frameSink(gpu->frameSinkData, pixels, pixelsPerLine,
+						lines);
+		} else {
+			SoftRenderer_displayScreen(gpu->softRenderer, gpu->window, topX,
+					topY, pixelsPerLine, lines, command->realHorizontalRes,
+					command->realVerticalRes);
+		}
+		return;
+	}
+
+	// Draw any batched primitives, as this touches vram directly
+	GPU_endDrawingPass(gpu);
+
+	int32_t bottomY = 511 - (topY + lines);
+
+	// Convert the frame into a texture for the presenting thread if there
+	// is one, so we never wait for the display here
+	if (gpu->presenter) {
+		if (pixelsPerLine > PHILPSX_GLPRESENTER_MAX_WIDTH)
+			pixelsPerLine = PHILPSX_GLPRESENTER_MAX_WIDTH;
+		if (lines > PHILPSX_GLPRESENTER_MAX_HEIGHT)
+			lines = PHILPSX_GLPRESENTER_MAX_HEIGHT;
+		GLuint frameTexture = GLPresenter_beginFrame(gpu->presenter);
+		GLStateCache_useProgram(gpu->glState, gpu->displayConvertProgram);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glUseProgram called");
+		GLStateCache_uniform1i(gpu->glState, 0, pixelsPerLine);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glUniform1i called");
+		GLStateCache_uniform1i(gpu->glState, 1, lines);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glUniform1i called");
+		GLStateCache_uniform1i(gpu->glState, 2, topX);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glUniform1i called");
+		GLStateCache_uniform1i(gpu->glState, 3, bottomY);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glUniform1i called");
+		GLStateCache_uniform1i(gpu->glState, 4, command->parameter3);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glUniform1i called");
+		gl->glBindImageTexture(2, frameTexture, 0, false, 0, GL_WRITE_ONLY,
+				GL_RGBA8);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glBindImageTexture called");
+		gl->glDispatchCompute((pixelsPerLine + 15) / 16, (lines + 15) / 16,
+				1);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glDispatchCompute called");
+		gl->glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT |
+				GL_TEXTURE_FETCH_BARRIER_BIT);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glMemoryBarrier called");
+		gl->glBindImageTexture(2, 0, 0, false, 0, GL_WRITE_ONLY, GL_RGBA8);
+		GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, glBindImageTexture called");
+		GLPresenter_endFrame(gpu->presenter, pixelsPerLine, lines,
+				command->realHorizontalRes, command->realVerticalRes);
+		goto end;
+	}
+
+	// Bind to screen framebuffer
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER, 0);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+								"glBindFramebuffer called");
+
+	GLStateCache_viewport(gpu->glState, 0, 0, command->realHorizontalRes,
+			command->realVerticalRes);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glViewport called");
+	GLStateCache_useProgram(gpu->glState, gpu->displayScreenProgram);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glUseProgram called");
+	GLStateCache_uniform1i(gpu->glState, 0, command->realHorizontalRes);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glUniform1i called");
+	GLStateCache_uniform1i(gpu->glState, 1, command->realVerticalRes);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glUniform1i called");
+	GLStateCache_uniform1i(gpu->glState, 2, pixelsPerLine);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glUniform1i called");
+	GLStateCache_uniform1i(gpu->glState, 3, lines);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glUniform1i called");
+	GLStateCache_uniform1i(gpu->glState, 4, topX);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glUniform1i called");
+	GLStateCache_uniform1i(gpu->glState, 5, bottomY);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glUniform1i called");
+	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
+			"glDrawArrays called");
+
+	// Swap buffers
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	SDL_GL_SwapWindow(gpu->window);
+	PHILPSX_TRACE_END(PHILPSX_TRACE_SWAP, traceStart,
+			PHILPSX_TRACE_NO_ARGUMENT);
+
+	// Sample errors once per frame if the driver isn't reporting them
+	end:
+#ifdef PHILPSX_DEBUG_BUILD
+	if (!gpu->openGLDebugOutput)
+		GPU_realCheckOpenGLErrors(gpu, "GPU_displayScreen_implementation "
+				"function, frame drawn");
+#endif
+	return;
+}
+
+/*
+ * This function draws any batched primitives and hands vram back to the
+ * framebuffer, ready for the routines that don't use image load/store. It
+ * is intended to be called from the GL context thread.
+ */
+static void GPU_endDrawingPass(GPU *gpu)
+{
+	// Get GLFunctionPointers reference
+	GLFunctionPointers *gl = gpu->gl;
+
+	// Nothing to do if we aren't drawing
+	if (!gpu->drawingPassActive)
+		return;
+
+	// Draw what is left in the batches, and make everything drawn in this
+	// pass visible to routines that use vram as a texture or framebuffer
+	GPU_flushTransfers(gpu);
+	GPU_flushBatch(gpu);
+	gl->glMemoryBarrier(GPU_IMAGE_STORE_BARRIER_BITS);
+	GPU_checkOpenGLErrors(gpu, "GPU_endDrawingPass function, "
+			"glMemoryBarrier called");
+
+	// Unbind texture from image unit
+	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
+	GPU_checkOpenGLErrors(gpu, "GPU_endDrawingPass function, "
+			"glBindImageTexture called");
+
+	// Rebind vram texture to FBO
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE0);
+	GPU_checkOpenGLErrors(gpu, "GPU_endDrawingPass function, "
+			"glActiveTexture called");
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->vramFramebuffer[0]);
+	GPU_checkOpenGLErrors(gpu, "GPU_endDrawingPass function, "
+			"glBindFramebuffer called");
+	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
+	GPU_checkOpenGLErrors(gpu, "GPU_endDrawingPass function, "
+			"glFramebufferTexture2D called");
+
+	// Bind to zero framebuffer
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER, 0);
+	GPU_checkOpenGLErrors(gpu, "GPU_endDrawingPass function, "
+			"glBindFramebuffer called");
+	gpu->drawingPassActive = false;
+}
+
+/*
+ * This function draws all primitives in the current batch with one call,
+ * then places a memory barrier so the next batch sees the changes to vram.
+ * It is intended to be called from the GL context thread.
+ */
+static void GPU_flushBatch(GPU *gpu)
+{
+	// Get GLFunctionPointers reference
+	GLFunctionPointers *gl = gpu->gl;
+
+	// Nothing to do for an empty batch
+	if (gpu->batchVertexCount == 0)
+		return;
+
+	// Draw batch and make its writes visible
+	gl->glDrawArrays(gpu->batchMode, gpu->batchFirstVertex,
+			gpu->batchVertexCount);
+	GPU_checkOpenGLErrors(gpu, "GPU_flushBatch function, "
+			"glDrawArrays called");
+	gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	GPU_checkOpenGLErrors(gpu, "GPU_flushBatch function, "
+			"glMemoryBarrier called");
+
+	// Start a new batch after this one
+	gpu->batchFirstVertex += gpu->batchVertexCount;
+	gpu->batchVertexCount = 0;
+	memset(gpu->batchDrawnTiles, 0, sizeof(gpu->batchDrawnTiles));
+	memset(gpu->batchReadTiles, 0, sizeof(gpu->batchReadTiles));
+}
+
+/*
+ * This function contains the implementation of GPU_flushRenderer, which has
+ * nothing to do as the emulator thread only waits for it to be reached.
+ */
+static void GPU_flushRenderer_implementation(GpuCommand *command)
+{
+	(void)command;
+}
+
+/*
+ * This function runs all vram transfers in the current batch with one
+ * compute dispatch, with a layer of work groups for each transfer, then
+ * places a memory barrier so later batches see the changes to vram. It is
+ * intended to be called from the GL context thread.
+ */
+static void GPU_flushTransfers(GPU *gpu)
+{
+	// Get GLFunctionPointers reference
+	GLFunctionPointers *gl = gpu->gl;
+
+	// Nothing to do for an empty batch
+	if (gpu->transferCount == 0)
+		return;
+
+	// Run batch and make its writes visible
+	GLStateCache_useProgram(gpu->glState, gpu->vramTransferProgram);
+	GPU_checkOpenGLErrors(gpu, "GPU_flushTransfers function, "
+			"glUseProgram called");
+	gl->glUniform4iv(0, gpu->transferCount * 2, gpu->transferBatch);
+	GPU_checkOpenGLErrors(gpu, "GPU_flushTransfers function, "
+			"glUniform4iv called");
+	gl->glDispatchCompute((gpu->transferMaxWidth + 15) / 16,
+			(gpu->transferMaxHeight + 15) / 16, gpu->transferCount);
+	GPU_checkOpenGLErrors(gpu, "GPU_flushTransfers function, "
+			"glDispatchCompute called");
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	PHILPSX_TRACE_END(PHILPSX_TRACE_MEMORY_BARRIER, traceStart,
+			PHILPSX_TRACE_NO_ARGUMENT);
+	GPU_checkOpenGLErrors(gpu, "GPU_flushTransfers function, "
+			"glMemoryBarrier called");
+
+	// Switch back to the program of the primitive batch, which may still
+	// have primitives left to draw
+	if (gpu->batchProgram != 0) {
+		GLStateCache_useProgram(gpu->glState, gpu->batchProgram);
+		GPU_checkOpenGLErrors(gpu, "GPU_flushTransfers function, "
+				"glUseProgram called");
+	}
+
+	// Start a new batch after this one
+	gpu->transferCount = 0;
+	gpu->transferMaxWidth = 0;
+	gpu->transferMaxHeight = 0;
+	memset(gpu->transferWrittenTiles, 0, sizeof(gpu->transferWrittenTiles));
+	memset(gpu->transferReadTiles, 0, sizeof(gpu->transferReadTiles));
+}
+
+/*
+ * This function works out the area of vram a primitive can draw to, from the
+ * bounding box of its vertices (allowing an extra pixel either side for
+ * rasterisation) clipped to the drawing area. All coordinates are in
+ * OpenGL form, and the area is stored as left, bottom, right and top.
+ */
+static void GPU_getDrawnArea(int32_t *area, const int32_t *vertex_x,
+		const int32_t *vertex_y, int32_t vertexCount, int32_t drawTopLeftX,
+		int32_t drawTopLeftY, int32_t drawBottomRightX,
+		int32_t drawBottomRightY)
+{
+	// Find bounding box
+	int32_t left = vertex_x[0];
+	int32_t right = vertex_x[0];
+	int32_t bottom = vertex_y[0];
+	int32_t top = vertex_y[0];
+	for (int32_t i = 1; i < vertexCount; ++i) {
+		left = min_value(left, vertex_x[i]);
+		right = max_value(right, vertex_x[i]);
+		bottom = min_value(bottom, vertex_y[i]);
+		top = max_value(top, vertex_y[i]);
+	}
+
+	// Clip to drawing area
+	area[0] = max_value(left - 1, drawTopLeftX);
+	area[1] = max_value(bottom - 1, drawBottomRightY);
+	area[2] = min_value(right + 1, drawBottomRightX);
+	area[3] = min_value(top + 1, drawTopLeftY);
+}
+
+/*
+ * This function finds the texture cache layer holding the given texture page
+ * decoded through the given CLUT, decoding it into the least recently used
+ * layer if it isn't there yet. It returns -1 if the primitive should read
+ * vram directly instead, which is the case for 15-bit pages (which have no
+ * CLUT to look through) and for primitives that can draw over the vram they
+ * read from. It is intended to be called from the GL context thread.
+ */
+static int32_t GPU_getTextureCacheLayer(GPU *gpu, const int32_t *drawnArea,
+		int32_t texBaseX, int32_t texBaseY, int32_t texColourMode,
+		int32_t clut_x, int32_t clut_y)
+{
+	// Check that this primitive can use the texture cache
+	if (texColourMode > 1)
+		return -1;
+	int32_t readAreas[GPU_MAX_READ_AREAS * 4];
+	int32_t readAreaCount = GPU_getTextureReadAreas(readAreas, texBaseX,
+			texBaseY, texColourMode, clut_x, clut_y);
+	for (int32_t i = 0; i < readAreaCount; ++i) {
+		const int32_t *readArea = readAreas + i * 4;
+		if (readArea[0] <= drawnArea[2] && drawnArea[0] <= readArea[2] &&
+				readArea[1] <= drawnArea[3] && drawnArea[1] <= readArea[3])
+			return -1;
+	}
+
+	// Look for a matching entry, noting the least recently used one
+	++gpu->textureCacheClock;
+	int32_t oldest = 0;
+	for (int32_t i = 0; i < GPU_TEXTURE_CACHE_ENTRIES; ++i) {
+		GpuTextureCacheEntry *entry = &gpu->textureCache[i];
+		if (entry->valid && entry->texBaseX == texBaseX &&
+				entry->texBaseY == texBaseY &&
+				entry->texColourMode == texColourMode &&
+				entry->clut_x == clut_x && entry->clut_y == clut_y) {
+			entry->lastUsed = gpu->textureCacheClock;
+			return i;
+		}
+		GpuTextureCacheEntry *oldestEntry = &gpu->textureCache[oldest];
+		if (oldestEntry->valid && (!entry->valid ||
+				entry->lastUsed < oldestEntry->lastUsed))
+			oldest = i;
+	}
+
+	// Fill in replacement entry, recording the tiles it reads from
+	GpuTextureCacheEntry *entry = &gpu->textureCache[oldest];
+	*entry = (GpuTextureCacheEntry){
+		.texBaseX = texBaseX,
+		.texBaseY = texBaseY,
+		.texColourMode = texColourMode,
+		.clut_x = clut_x,
+		.clut_y = clut_y,
+		.readAreaCount = readAreaCount,
+		.lastUsed = gpu->textureCacheClock,
+		.valid = true
+	};
+	memcpy(entry->readAreas, readAreas, sizeof(readAreas));
+	for (int32_t i = 0; i < readAreaCount; ++i) {
+		int32_t firstRow, lastRow;
+		uint64_t mask = GPU_getTileMask(readAreas + i * 4, &firstRow,
+				&lastRow);
+		for (int32_t row = firstRow; row <= lastRow; ++row)
+			gpu->textureCacheTiles[row] |= mask;
+	}
+
+	// Decode page once everything batched so far has been drawn, as the
+	// batch may use the layer we are replacing and transfers may write to
+	// the page
+	if (!gpu->drawingPassActive)
+		GPU_beginDrawingPass(gpu);
+	GPU_flushTransfers(gpu);
+	GPU_flushBatch(gpu);
+	GPU_decodeTexturePage(gpu, oldest);
+	return oldest;
+}
+
+/*
+ * This function works out the areas of vram a textured primitive can read
+ * from - the texture page, and the CLUT if the colour mode uses one. It
+ * returns the number of areas, storing each as left, bottom, right and top
+ * in OpenGL form.
+ */
+static int32_t GPU_getTextureReadAreas(int32_t *areas, int32_t texBaseX,
+		int32_t texBaseY, int32_t texColourMode, int32_t clut_x,
+		int32_t clut_y)
+{
+	// Get texture page and CLUT widths in vram pixels for this colour mode
+	int32_t pageWidth = 256;
+	int32_t clutWidth = 0;
+	switch (texColourMode) {
+		case 0: // 4-bit colour mode
+			pageWidth = 64;
+			clutWidth = 16;
+			break;
+		case 1: // 8-bit colour mode
+			pageWidth = 128;
+			clutWidth = 256;
+			break;
+	}
+
+	// Store texture page area
+	areas[0] = texBaseX;
+	areas[1] = texBaseY - 255;
+	areas[2] = texBaseX + pageWidth - 1;
+	areas[3] = texBaseY;
+	if (clutWidth == 0)
+		return 1;
+
+	// Store CLUT area
+	areas[4] = clut_x;
+	areas[5] = clut_y;
+	areas[6] = clut_x + clutWidth - 1;
+	areas[7] = clut_y;
+	return 2;
+}
+
 /*
- * This function displays the screen at the end of each frame, by queuing
- * this work on the rendering thread.
+ * This function converts an area of vram into a mask of 16x16 tile columns,
+ * along with the first and last tile rows it covers. An area that lies
+ * outside vram gives an empty mask.
  */
-static void GPU_displayScreen(GPU *gpu)
-{	
-	// Perform draw on GL thread, making sure to set pointers
-	GpuCommand displayScreen;
-	displayScreen.functionPointer = &GPU_displayScreen_implementation;
-	displayScreen.gpu = gpu;
-
-	// Store parameters in object then submit it to work queue
-	displayScreen.xStart = gpu->xStart;
-	displayScreen.yStart = gpu->yStart;
-	displayScreen.x1 = gpu->x1;
-	displayScreen.x2 = gpu->x2;
-	displayScreen.y1 = gpu->y1;
-	displayScreen.y2 = gpu->y2;
-	displayScreen.realHorizontalRes = gpu->realHorizontalRes;
-	displayScreen.realVerticalRes = gpu->realVerticalRes;
-	displayScreen.parameter1 = gpu->dotFactor;
-	displayScreen.parameter2 = gpu->interlaceEnabled ? 1 : 0;
-	WorkQueue_addItem(gpu->wq, &displayScreen, false);
+static uint64_t GPU_getTileMask(const int32_t *area, int32_t *firstRow,
+		int32_t *lastRow)
+{
+	// Clamp area to vram
+	int32_t left = max_value(area[0], 0);
+	int32_t bottom = max_value(area[1], 0);
+	int32_t right = min_value(area[2], 1023);
+	int32_t top = min_value(area[3], 511);
+	if (left > right || bottom > top) {
+		*firstRow = 0;
+		*lastRow = -1;
+		return 0;
+	}
+
+	// Build mask
+	int32_t firstColumn = left / 16;
+	int32_t lastColumn = right / 16;
+	*firstRow = bottom / 16;
+	*lastRow = top / 16;
+	return (UINT64_MAX >> (63 - (lastColumn - firstColumn))) << firstColumn;
 }
 
 /*
- * This function contains the implementation of GPU_displayScreen.
+ * This function gets the time from the host's monotonic clock, in
+ * nanoseconds.
  */
-static void GPU_displayScreen_implementation(GpuCommand *command)
+static int64_t GPU_getTime(void)
 {
-	// Get GL function pointers and GPU objects
-	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
-
-	// Bind to screen framebuffer
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-								"glBindFramebuffer called");
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
 
-	// Determine resolution parameters
-	int32_t topX = command->xStart;
-	int32_t topY = command->yStart;
+#ifdef PHILPSX_TRACE_EVENTS
+/*
+ * This function works out which trace event a command is recorded as from
+ * its implementation. Anything that isn't drawing, a vram transfer or
+ * showing a frame is synchronisation of some kind.
+ */
+static int32_t GPU_getTraceEvent(GpuCommand *command)
+{
+	void (*functionPointer)(GpuCommand *command) = command->functionPointer;
+	if (functionPointer == &GPU_monochromePolygon_implementation ||
+			functionPointer == &GPU_shadedPolygon_implementation ||
+			functionPointer == &GPU_shadedTexturedPolygon_implementation ||
+			functionPointer == &GPU_texturedPolygon_implementation)
+		return PHILPSX_TRACE_GPU_POLYGON;
+	if (functionPointer == &GPU_monochromeRectangle_implementation ||
+			functionPointer == &GPU_texturedRectangle_implementation)
+		return PHILPSX_TRACE_GPU_RECTANGLE;
+	if (functionPointer == &GPU_anyLine_implementation)
+		return PHILPSX_TRACE_GPU_LINE;
+	if (functionPointer == &GPU_GP0_02_implementation)
+		return PHILPSX_TRACE_GPU_FILL;
+	if (functionPointer == &GPU_GP0_80_implementation)
+		return PHILPSX_TRACE_GPU_VRAM_COPY;
+	if (functionPointer == &GPU_GP0_A0_implementation)
+		return PHILPSX_TRACE_GPU_VRAM_WRITE;
+	if (functionPointer == &GPU_GP0_C0_implementation)
+		return PHILPSX_TRACE_GPU_VRAM_READ;
+	if (functionPointer == &GPU_displayScreen_implementation)
+		return PHILPSX_TRACE_GPU_DISPLAY;
+	return PHILPSX_TRACE_GPU_SYNC;
+}
+#endif
 
-	int32_t pixelsPerLine = (((command->x2 - command->x1) /
-			command->parameter1) + 2) & 0xFFFFFFFC;
-	int32_t lines = command->y2 - command->y1;
-	if (command->parameter2 == 1)
-		lines *= 2;
+/*
+ * This function splits a rectangle of vram, with its top left corner given
+ * in the PlayStation's coordinates, into the pieces left where it wraps at
+ * the edges of vram. It returns the number of pieces (up to four), storing
+ * each as left, bottom, right and top in OpenGL form.
+ */
+static int32_t GPU_getWrappedAreas(int32_t *areas, int32_t x, int32_t y,
+		int32_t width, int32_t height)
+{
+	// Work out the columns and rows either side of the edges
+	x &= 0x3FF;
+	y &= 0x1FF;
+	int32_t columns[2][2] = {{x, min_value(x + width, 1024) - 1},
+			{0, x + width - 1025}};
+	int32_t rows[2][2] = {{y, min_value(y + height, 512) - 1},
+			{0, y + height - 513}};
+
+	// Store each piece that isn't empty
+	int32_t areaCount = 0;
+	for (int32_t row = 0; row < 2; ++row) {
+		for (int32_t column = 0; column < 2; ++column) {
+			if (columns[column][1] < columns[column][0] ||
+					rows[row][1] < rows[row][0])
+				continue;
+			int32_t *area = areas + areaCount * 4;
+			area[0] = columns[column][0];
+			area[1] = 511 - rows[row][1];
+			area[2] = columns[column][1];
+			area[3] = 511 - rows[row][0];
+			++areaCount;
+		}
+	}
+	return areaCount;
+}
 
-	int32_t bottomX = topX + pixelsPerLine;
-	int32_t bottomY = topY + lines;
+/*
+ * This function drops any texture cache entries decoded from the given area
+ * of vram, which is in OpenGL form, as it is about to be written to. The
+ * tile masks of the remaining entries are then rebuilt. It is intended to be
+ * called from the GL context thread.
+ */
+static void GPU_invalidateTextureCache(GPU *gpu, const int32_t *area)
+{
+	// Nothing to do if no entry was decoded from these tiles
+	int32_t firstRow, lastRow;
+	uint64_t mask = GPU_getTileMask(area, &firstRow, &lastRow);
+	bool overlap = false;
+	for (int32_t row = firstRow; row <= lastRow; ++row) {
+		if ((gpu->textureCacheTiles[row] & mask) != 0) {
+			overlap = true;
+			break;
+		}
+	}
+	if (!overlap)
+		return;
 
-	topY = 511 - topY;
-	bottomY = 511 - bottomY;
+	// Drop entries decoded from this area, and rebuild tile masks
+	memset(gpu->textureCacheTiles, 0, sizeof(gpu->textureCacheTiles));
+	for (int32_t i = 0; i < GPU_TEXTURE_CACHE_ENTRIES; ++i) {
+		GpuTextureCacheEntry *entry = &gpu->textureCache[i];
+		if (!entry->valid)
+			continue;
+		for (int32_t j = 0; j < entry->readAreaCount; ++j) {
+			const int32_t *readArea = entry->readAreas + j * 4;
+			if (readArea[0] <= area[2] && area[0] <= readArea[2] &&
+					readArea[1] <= area[3] && area[1] <= readArea[3])
+				entry->valid = false;
+		}
+		if (!entry->valid)
+			continue;
+		for (int32_t j = 0; j < entry->readAreaCount; ++j) {
+			int32_t entryFirstRow, entryLastRow;
+			uint64_t entryMask = GPU_getTileMask(entry->readAreas + j * 4,
+					&entryFirstRow, &entryLastRow);
+			for (int32_t row = entryFirstRow; row <= entryLastRow; ++row)
+				gpu->textureCacheTiles[row] |= entryMask;
+		}
+	}
+}
 
-	gl->glViewport(0, 0, command->realHorizontalRes, command->realVerticalRes);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glViewport called");
-	gl->glUseProgram(gpu->displayScreenProgram);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glUseProgram called");
-	gl->glUniform1i(0, command->realHorizontalRes);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(1, command->realVerticalRes);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(2, pixelsPerLine);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(3, lines);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(4, topX);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(5, bottomY);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	GPU_checkOpenGLErrors(gpu, "GPU_displayScreen_implementation function, "
-			"glDrawArrays called");
+/*
+ * This function tells us whether GP0 is between commands, with no transfer
+ * to or from vram under way.
+ */
+static bool GPU_isGP0Idle(GPU *gpu)
+{
+	return gpu->commandsInFifo == 0 && gpu->dmaReadInProgress == -1 &&
+			gpu->dmaWriteInProgress == -1;
+}
 
-	// Swap buffers
-	SDL_GL_SwapWindow(gpu->window);
+/*
+ * This function records that an area of vram (in OpenGL's coordinates, as
+ * left, bottom, right and top) has been written to, dropping texture cache
+ * entries decoded from it and marking it in the vram dirty map. It is
+ * intended to be called from the GL context thread.
+ */
+static void GPU_markVramWritten(GPU *gpu, const int32_t *area)
+{
+	GPU_invalidateTextureCache(gpu, area);
+	VramDirtyMap_markArea(gpu->vramDirtyMap, area[0], 511 - area[3],
+			area[2] - area[0] + 1, area[3] - area[1] + 1);
 }
 
 /*
@@ -3466,22 +4510,19 @@ static void GPU_displayScreen_implementation(GpuCommand *command)
 static void GPU_monochromePolygon(GPU *gpu, int32_t command, int32_t vertex1,
 		int32_t vertex2, int32_t vertex3, int32_t vertex4)
 {
-	// Perform draw on GL thread, making sure to set pointers
-	GpuCommand monochromePolygon;
-	monochromePolygon.functionPointer = &GPU_monochromePolygon_implementation;
-	monochromePolygon.gpu = gpu;
-	
-	// Store parameters in object then submit it to work queue
-	monochromePolygon.parameter1 = command;
-	monochromePolygon.parameter2 = vertex1;
-	monochromePolygon.parameter3 = vertex2;
-	monochromePolygon.parameter4 = vertex3;
-	monochromePolygon.parameter5 = vertex4;
-	monochromePolygon.statusRegister = gpu->statusRegister;
-	monochromePolygon.drawingOffset = gpu->drawingOffset;
-	monochromePolygon.drawingAreaTopLeft = gpu->drawingAreaTopLeft;
-	monochromePolygon.drawingAreaBottomRight = gpu->drawingAreaBottomRight;
-	WorkQueue_addItem(gpu->wq, &monochromePolygon, false);
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_POLYGON, 1);
+
+	// Nothing to draw if this frame is being skipped
+	if (gpu->frameSkipped)
+		return;
+
+	// Perform draw on GL thread, leaving out the fourth vertex for three
+	// point polygons
+	int32_t parameters[] = {command, vertex1, vertex2, vertex3, vertex4};
+	GPU_queueCommand(gpu, &GPU_monochromePolygon_implementation, parameters,
+			(command & 0x08000000) ? 5 : 4, false);
 }
 
 /*
@@ -3489,9 +4530,14 @@ static void GPU_monochromePolygon(GPU *gpu, int32_t command, int32_t vertex1,
  */
 static void GPU_monochromePolygon_implementation(GpuCommand *command)
 {
-	// Get GL function pointers and GPU objects
+	// Get GPU object
 	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_drawPolygon(gpu->softRenderer, command);
+		return;
+	}
 
 	// Extract command byte
 	int32_t commandByte = logical_rshift(command->parameter1, 24) & 0xFF;
@@ -3573,352 +4619,1413 @@ static void GPU_monochromePolygon_implementation(GpuCommand *command)
 	int32_t setMask = logical_rshift(command->statusRegister, 11) & 0x1;
 	int32_t checkMask = logical_rshift(command->statusRegister, 12) & 0x1;
 
-	// Setup drawing area variables
-	int32_t drawXOffset = command->drawingOffset & 0x7FF;
-	int32_t drawYOffset = logical_rshift(command->drawingOffset, 11) & 0x7FF;
-	if ((drawXOffset & 0x400) == 0x400)
-		drawXOffset |= 0xFFFFF800;
-	if ((drawYOffset & 0x400) == 0x400)
-		drawYOffset |= 0xFFFFF800;
+	// Setup drawing area variables
+	int32_t drawXOffset = command->drawingOffset & 0x7FF;
+	int32_t drawYOffset = logical_rshift(command->drawingOffset, 11) & 0x7FF;
+	if ((drawXOffset & 0x400) == 0x400)
+		drawXOffset |= 0xFFFFF800;
+	if ((drawYOffset & 0x400) == 0x400)
+		drawYOffset |= 0xFFFFF800;
+
+	int32_t drawTopLeftX = command->drawingAreaTopLeft & 0x3FF;
+	int32_t drawTopLeftY =
+			logical_rshift(command->drawingAreaTopLeft, 10) & 0x1FF;
+	int32_t drawBottomRightX = command->drawingAreaBottomRight & 0x3FF;
+	int32_t drawBottomRightY =
+			logical_rshift(command->drawingAreaBottomRight, 10) & 0x1FF;
+
+	// Convert Y values to OpenGL form
+	drawYOffset = -drawYOffset;
+	drawTopLeftY = 511 - drawTopLeftY;
+	drawBottomRightY = 511 - drawBottomRightY;
+
+	// Adjust coordinates with offsets
+	for (int32_t i = 0; i < 4; ++i) {
+		vertex_x[i] += drawXOffset;
+		vertex_y[i] += drawYOffset;
+	}
+
+	// Build vertices, splitting four-pointed polygons into two triangles
+	GpuVertex vertices[6];
+	int32_t vertexCount = 3 + fourPoints * 3;
+	for (int32_t i = 0; i < vertexCount; ++i) {
+		int32_t vertex = GPU_polygonVertexOrder[i];
+		vertices[i] = (GpuVertex){
+			.position = {vertex_x[vertex], vertex_y[vertex]},
+			.colour = {red, green, blue},
+			.primitive1 = {semiTransparencyEnabled}
+		};
+	}
+
+	// Add polygon to the current batch
+	int32_t uniforms[] = {semiTransparencyMode, setMask, checkMask,
+			drawTopLeftX, drawTopLeftY, drawBottomRightX, drawBottomRightY};
+	int32_t drawingArea[] = {drawTopLeftX, drawTopLeftY, drawBottomRightX,
+			drawBottomRightY};
+	GPU_batchPolygon(gpu, gpu->monochromePolygonProgram1, uniforms, 7,
+			vertices, fourPoints, vertex_x, vertex_y, drawingArea, NULL, 0);
+}
+
+/*
+ * This function draws a monochrome rectangle, with various options, by queuing
+ * this work on the rendering thread.
+ */
+static void GPU_monochromeRectangle(GPU *gpu, int32_t command, int32_t vertex,
+		int32_t widthAndHeight)
+{
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_RECTANGLE, 1);
+
+	// Nothing to draw if this frame is being skipped
+	if (gpu->frameSkipped)
+		return;
+
+	// Perform draw on GL thread
+	int32_t parameters[] = {command, vertex, widthAndHeight};
+	GPU_queueCommand(gpu, &GPU_monochromeRectangle_implementation,
+			parameters, 3, false);
+}
+
+/*
+ * This function contains the implementation of GPU_monochromeRectangle.
+ */
+static void GPU_monochromeRectangle_implementation(GpuCommand *command)
+{
+	// Get GPU object
+	GPU *gpu = command->gpu;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_drawRectangle(gpu->softRenderer, command);
+		return;
+	}
+
+	// Extract command byte
+	int32_t commandByte = logical_rshift(command->parameter1, 24) & 0xFF;
+
+	// Detect if we are in opaque or semi-transparent mode
+	// (opaque by default)
+	int32_t semiTransparencyEnabled = 0;
+	int32_t semiTransparencyMode = (command->statusRegister >> 5) & 0x3;
+	switch (commandByte) {
+		case 0x62:
+		case 0x6A:
+		case 0x72:
+		case 0x7A: // Semi-transparent mode
+			semiTransparencyEnabled = 1;
+	}
+
+	// Get colour
+	int32_t red = command->parameter1 & 0xFF;
+	int32_t green = logical_rshift(command->parameter1, 8) & 0xFF;
+	int32_t blue = logical_rshift(command->parameter1, 16) & 0xFF;
+
+	// Get width and height
+	int32_t width = command->parameter3 & 0xFFFF;
+	width = ((width - 1) & 0x3FF) + 1;
+	int32_t height = logical_rshift(command->parameter3, 16) & 0xFFFF;
+	height = ((height - 1) & 0x1FF) + 1;
+	width = (width == 0) ? 0x400 : width;
+	height = (height == 0) ? 0x200 : height;
+
+	// Get vertex parameters and sign-extend if needed
+	int32_t x = command->parameter2 & 0x7FF;
+	int32_t y = logical_rshift(command->parameter2, 16) & 0x7FF;
+	if ((x & 0x400) == 0x400)
+		x |= 0xFFFFF800;
+	if ((y & 0x400) == 0x400)
+		y |= 0xFFFFF800;
+
+	// As we go from bottom-left corner in OpenGL viewport, adjust y
+	y = 511 - y;
+	y -= height - 1;
+
+	// Split out masking bits from status register
+	int32_t setMask = logical_rshift(command->statusRegister, 11) & 0x1;
+	int32_t checkMask = logical_rshift(command->statusRegister, 12) & 0x1;
+
+	// Setup drawing area variables
+	int32_t drawXOffset = command->drawingOffset & 0x7FF;
+	int32_t drawYOffset = logical_rshift(command->drawingOffset, 11) & 0x7FF;
+	if ((drawXOffset & 0x400) == 0x400)
+		drawXOffset |= 0xFFFFF800;
+	if ((drawYOffset & 0x400) == 0x400)
+		drawYOffset |= 0xFFFFF800;
+
+	int32_t drawTopLeftX = command->drawingAreaTopLeft & 0x3FF;
+	int32_t drawTopLeftY =
+			logical_rshift(command->drawingAreaTopLeft, 10) & 0x1FF;
+	int32_t drawBottomRightX = command->drawingAreaBottomRight & 0x3FF;
+	int32_t drawBottomRightY =
+			logical_rshift(command->drawingAreaBottomRight, 10) & 0x1FF;
+
+	// Convert Y values to OpenGL basis
+	drawYOffset = -drawYOffset;
+	drawTopLeftY = 511 - drawTopLeftY;
+	drawBottomRightY = 511 - drawBottomRightY;
+
+	// Adjust coordinates with offsets
+	x += drawXOffset;
+	y += drawYOffset;
+
+	// Build vertices from the rectangle corners, as two triangles
+	int32_t corner_x[] = {x, x, x + width, x + width};
+	int32_t corner_y[] = {y, y + height, y, y + height};
+	GpuVertex vertices[6];
+	for (int32_t i = 0; i < 6; ++i) {
+		int32_t corner = GPU_polygonVertexOrder[i];
+		vertices[i] = (GpuVertex){
+			.position = {corner_x[corner], corner_y[corner]},
+			.colour = {red, green, blue},
+			.primitive1 = {semiTransparencyEnabled}
+		};
+	}
+
+	// Add rectangle to the current batch
+	int32_t uniforms[] = {semiTransparencyMode, setMask, checkMask,
+			drawTopLeftX, drawTopLeftY, drawBottomRightX, drawBottomRightY};
+	int32_t drawnArea[4];
+	GPU_getDrawnArea(drawnArea, corner_x, corner_y, 4, drawTopLeftX,
+			drawTopLeftY, drawBottomRightX, drawBottomRightY);
+	GPU_batchPrimitive(gpu, gpu->monochromeRectangleProgram1, GL_TRIANGLES,
+			uniforms, 7, vertices, 6, drawnArea, NULL, 0);
+}
+
+/*
+ * This function measures how long the frame just finished took on the host,
+ * and decides whether the drawing of the next one should be skipped to catch
+ * up. Frames are kept to a deadline that moves on by one frame each vblank,
+ * and a frame is skipped when the host is more than a frame behind it and
+ * the skip limit hasn't been reached. Emulation itself carries on as normal,
+ * so sound and input stay real-time. It is intended to be called from the
+ * emulator thread.
+ */
+static void GPU_paceFrame(GPU *gpu)
+{
+	// Frames with drawing suppressed are always skipped, but aren't counted
+	// or timed, as they are only being run ahead
+	if (gpu->drawingSuppressed) {
+		gpu->frameSkipped = true;
+		return;
+	}
+
+	// Nothing to do if frame pacing is turned off
+	if (gpu->maxSkippedFrames == 0) {
+		gpu->frameSkipped = false;
+		return;
+	}
+
+	// Measure host time since the last vblank
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t nowNs = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+	if (gpu->lastVblankTime != 0)
+		gpu->lastFrameTime = nowNs - gpu->lastVblankTime;
+	gpu->lastVblankTime = nowNs;
+
+	// Move deadline on, starting again from now if we have fallen too far
+	// behind to catch up
+	if (gpu->frameDeadline == 0)
+		gpu->frameDeadline = nowNs;
+	gpu->frameDeadline += GPU_FRAME_TIME_NS;
+	int64_t lag = nowNs - gpu->frameDeadline;
+	if (lag > GPU_FRAME_TIME_NS * GPU_PACING_RESYNC_FRAMES) {
+		gpu->frameDeadline = nowNs;
+		lag = 0;
+	}
+
+	// Skip next frame if we are behind and allowed to
+	if (lag > GPU_FRAME_TIME_NS &&
+			gpu->consecutiveSkippedFrames < gpu->maxSkippedFrames) {
+		gpu->frameSkipped = true;
+		++gpu->consecutiveSkippedFrames;
+		++gpu->skippedFrameCount;
+	} else {
+		gpu->frameSkipped = false;
+		gpu->consecutiveSkippedFrames = 0;
+	}
+}
+
+/*
+ * This function handles a single GP0 word, once the GPU has been brought up
+ * to date with the CPU.
+ */
+static void GPU_processGP0Word(GPU *gpu, int32_t word)
+{
+	// Exit if DMA read is in progress
+	switch (gpu->dmaReadInProgress) {
+		case -1: // No read
+			break;
+		default: // Read happening, return from method
+			return;
+	}
+
+	// Get command byte
+	int32_t commandByte = logical_rshift(word, 24) & 0xFF;
+
+	switch (gpu->dmaWriteInProgress) {
+		default: // Write in progress, handle appropriately
+			// Store both pixels in the current staging slot, or just the
+			// first if it is the last pixel of the transfer
+			{
+				int8_t *slotData = gpu->uploadBufferData +
+						gpu->uploadSlot * GPU_UPLOAD_BUFFER_SLOT_SIZE +
+						gpu->dmaBufferIndex;
+				if (gpu->dmaNeededBytes - gpu->dmaBufferIndex >= 4) {
+					write_le_word(slotData, word);
+					gpu->dmaBufferIndex += 4;
+				} else {
+					write_le_halfword(slotData, word);
+					gpu->dmaBufferIndex += 2;
+				}
+			}
+
+			if (gpu->dmaBufferIndex == gpu->dmaNeededBytes) {
+				switch (gpu->dmaWriteInProgress) {
+					case 0xA0: // GP0(0xA0): copy rectangle (CPU to VRAM)
+						GPU_GP0_A0(gpu, gpu->fifoBuffer[0],
+								gpu->fifoBuffer[1], gpu->fifoBuffer[2]);
+						GPU_GP1_01(gpu, 0);
+						break;
+				}
+				gpu->dmaWriteInProgress = -1;
+
+				// Set bit 26 (ready to receive command word) of status register
+				gpu->statusRegister |= 0x04000000;
+
+				// Clear bit 27 (VRAM to CPU ready) of status register
+				gpu->statusRegister &= 0xF7FFFFFF;
+
+				// Set bit 28 (DMA ready) of status register
+				gpu->statusRegister |= 0x10000000;
+			}
+			break;
+		case -1: // No write in progress, deal with normally
+			switch (gpu->commandsInFifo) {
+				case 0: // Deal with command
+					++gpu->commandCount;
+					switch (commandByte) {
+						case 0x1F: // Trigger interrupt
+							GPU_GP0_1F(gpu);
+							break;
+						case 0x00:
+						case 0x03:
+						case 0x04:
+						case 0x05:
+						case 0x06:
+						case 0x07:
+						case 0x08:
+						case 0x09:
+						case 0x0A:
+						case 0x0B:
+						case 0x0C:
+						case 0x0D:
+						case 0x0E:
+						case 0x0F:
+						case 0x10:
+						case 0x11:
+						case 0x12:
+						case 0x13:
+						case 0x14:
+						case 0x15:
+						case 0x16:
+						case 0x17:
+						case 0x18:
+						case 0x19:
+						case 0x1A:
+						case 0x1B:
+						case 0x1C:
+						case 0x1D:
+						case 0x1E:
+						case 0xE0:
+						case 0xE7:
+						case 0xE8:
+						case 0xE9:
+						case 0xEA:
+						case 0xEB:
+						case 0xEC:
+						case 0xED:
+						case 0xEE:
+						case 0xEF: // NOP (do nothing)
+							break;
+						case 0x01: // Clear cache, but not clear
+								   // (it actually does nothing)
+							break;
+						case 0x02: // GP0(0x02): fill rectangle in VRAM
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0x24: // GP0(0x24): textured three-point polygon,
+								   // opaque, texture-blending
+						case 0x25: // GP0(0x25): textured three-point polygon,
+								   // opaque, raw-texture
+						case 0x26: // GP0(0x26): textured three-point polygon,
+								   // semi-transparent, texture-blending
+						case 0x27: // GP0(0x27): textured three-point polygon,
+								   // semi-transparent, raw-texture
+						case 0x2C: // GP0(0x2C): textured four-point polygon,
+								   // opaque, texture-blending
+						case 0x2D: // GP0(0x2D): textured four-point polygon,
+								   // opaque, raw-texture
+						case 0x2E: // GP0(0x2E): textured four-point polygon,
+								   // semi-transparent, texture-blending
+						case 0x2F: // GP0(0x2F): textured four-point polygon,
+								   // semi-transparent, raw-texture
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0x34: // GP0(0x34): shaded textured three-point
+								   // polygon, opaque, texture-blending
+						case 0x35: // GP0(0x35): undocumented, textured
+								   // three-point polygon, opaque, no blending
+						case 0x36: // GP0(0x36): shaded textured three-point
+								   // polygon, semi-transparent,
+								   // texture-blending
+						case 0x37: // GP0(0x37): undocumented, textured
+								   // three-point polygon, semi-transparent,
+								   // no blending
+						case 0x3C: // GP0(0x3C): shaded textured four-point
+								   // polygon, opaque, texture-blending
+						case 0x3D: // GP0(0x3D): undocumented, textured
+								   // four-point polygon, opaque, no blending
+						case 0x3E: // GP0(0x3E): shaded textured four-point
+								   // polygon, semi-transparent,
+								   // texture-blending
+						case 0x3F: // GP0(0x3F): undocumented, textured
+								   // four-point polygon, semi-transparent,
+								   // no blending
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0x20: // GP0(0x20): monochrome three-point polygon,
+								   // opaque
+						case 0x21: // GP0(0x21): undocumented command, same as
+								   // GP0(0x20)
+						case 0x22: // GP0(0x22): monochrome three-point polygon,
+								   // semi-transparent
+						case 0x23: // GP0(0x23): undocumented command, same as
+								   // GP0(0x22)
+						case 0x28: // GP0(0x28): monochrome four-point polygon,
+								   // opaque
+						case 0x29: // GP0(0x29): undocumented command, same as
+								   // GP0(0x28)
+						case 0x2A: // GP0(0x2A): monochrome four-point polygon,
+								   // semi-transparent
+						case 0x2B: // GP0(0x2B): undocumented command, same as
+								   // GP0(0x2A)
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0x30: // GP0(0x30): shaded three-point polygon,
+								   // opaque
+						case 0x31: // GP0(0x31): undocumented command, same as
+								   // GP0(0x30)
+						case 0x32: // GP0(0x32): shaded three-point polygon,
+								   // semi-transparent
+						case 0x33: // GP0(0x33): undocumented command, same as
+								   // GP0(0x32)
+						case 0x38: // GP0(0x38): shaded four-point polygon,
+								   // opaque
+						case 0x39: // GP0(0x39): undocumented command, same as
+								   // GP0(0x38)
+						case 0x3A: // GP0(0x3A): shaded four-point polygon,
+								   // semi-transparent
+						case 0x3B: // GP0(0x3B): undocumented command, same as
+								   // GP0(0x3A)
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0x40: // GP0(0x40): monochrome line, opaque
+						case 0x42: // GP0(0x42): monochrome line,
+								   // semi-transparent
+						case 0x48: // GP0(0x48): monochrome poly-line, opaque
+						case 0x4A: // GP0(0x4A): monochrome poly-line,
+								   // semi-transparent
+						case 0x50: // GP0(0x50): shaded line, opaque
+						case 0x52: // GP0(0x52): shaded line, semi-transparent
+						case 0x58: // GP0(0x58): shaded poly-line, opaque
+						case 0x5A: // GP0(0x5A): shaded poly-line,
+								   // semi-transparent
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0x60: // GP0(0x60): monochrome rectangle, variable
+								   // size, opaque
+						case 0x62: // GP0(0x62): monochrome rectangle, variable
+								   // size, semi-transparent
+						case 0x68: // GP0(0x68): monochrome rectangle, 1x1,
+								   // opaque
+						case 0x6A: // GP0(0x6A): monochrome rectangle, 1x1,
+								   // semi-transparent
+						case 0x70: // GP0(0x70): monochrome rectangle, 8x8,
+								   // opaque
+						case 0x72: // GP0(0x72): monochrome rectangle, 8x8,
+								   // semi-transparent
+						case 0x78: // GP0(0x78): monochrome rectangle, 16x16,
+								   // opaque
+						case 0x7A: // GP0(0x7A): monochrome rectangle, 16x16,
+								   // semi-transparent
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0x64: // GP0(0x64): textured rectangle, variable
+								   // size, opaque, texture-blending
+						case 0x65: // GP0(0x65): textured rectangle, variable
+								   // size, opaque, raw-texture
+						case 0x66: // GP0(0x66): textured rectangle, variable
+								   // size, semi-transparent, texture-blending
+						case 0x67: // GP0(0x67): textured rectangle, variable
+								   // size, semi-transparent, raw-texture
+						case 0x6C: // GP0(0x6C): textured rectangle, 1x1
+							       // (nonsense), opaque, texture-blending
+						case 0x6D: // GP0(0x6D): textured rectangle, 1x1
+								   // (nonsense), opaque, raw-texture
+						case 0x6E: // GP0(0x6E): textured rectangle, 1x1
+								   // (nonsense), semi-transparent,
+								   // texture-blending
+						case 0x6F: // GP0(0x6F): textured rectangle,
+								   // 1x1 (nonsense), semi-transparent,
+								   // raw-texture
+						case 0x74: // GP0(0x74): textured rectangle, 8x8,
+								   // opaque, texture-blending
+						case 0x75: // GP0(0x75): textured rectangle, 8x8,
+								   // opaque, raw-texture
+						case 0x76: // GP0(0x76): textured rectangle, 8x8,
+								   // semi-transparent, texture-blending
+						case 0x77: // GP0(0x77): textured rectangle, 8x8,
+								   // semi-transparent, raw-texture
+						case 0x7C: // GP0(0x7C): textured rectangle, 16x16,
+								   // opaque, texture-blending
+						case 0x7D: // GP0(0x7D): textured rectangle, 16x16,
+								   // opaque, raw-texture
+						case 0x7E: // GP0(0x7E): textured rectangle, 16x16,
+								   // semi-transparent, texture-blending
+						case 0x7F: // GP0(0x7F): textured rectangle, 16x16,
+								   // semi-transparent, raw-texture
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0x80:
+						case 0x81:
+						case 0x82:
+						case 0x83:
+						case 0x84:
+						case 0x85:
+						case 0x86:
+						case 0x87:
+						case 0x88:
+						case 0x89:
+						case 0x8A:
+						case 0x8B:
+						case 0x8C:
+						case 0x8D:
+						case 0x8E:
+						case 0x8F:
+						case 0x90:
+						case 0x91:
+						case 0x92:
+						case 0x93:
+						case 0x94:
+						case 0x95:
+						case 0x96:
+						case 0x97:
+						case 0x98:
+						case 0x99:
+						case 0x9A:
+						case 0x9B:
+						case 0x9C:
+						case 0x9D:
+						case 0x9E:
+						case 0x9F: // GP0(0x80): copy rectangle (VRAM to VRAM)
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0xA0:
+						case 0xA1:
+						case 0xA2:
+						case 0xA3:
+						case 0xA4:
+						case 0xA5:
+						case 0xA6:
+						case 0xA7:
+						case 0xA8:
+						case 0xA9:
+						case 0xAA:
+						case 0xAB:
+						case 0xAC:
+						case 0xAD:
+						case 0xAE:
+						case 0xAF:
+						case 0xB0:
+						case 0xB1:
+						case 0xB2:
+						case 0xB3:
+						case 0xB4:
+						case 0xB5:
+						case 0xB6:
+						case 0xB7:
+						case 0xB8:
+						case 0xB9:
+						case 0xBA:
+						case 0xBB:
+						case 0xBC:
+						case 0xBD:
+						case 0xBE:
+						case 0xBF: // GP0(0xA0): copy rectangle (CPU to VRAM)
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0xC0:
+						case 0xC1:
+						case 0xC2:
+						case 0xC3:
+						case 0xC4:
+						case 0xC5:
+						case 0xC6:
+						case 0xC7:
+						case 0xC8:
+						case 0xC9:
+						case 0xCA:
+						case 0xCB:
+						case 0xCC:
+						case 0xCD:
+						case 0xCE:
+						case 0xCF:
+						case 0xD0:
+						case 0xD1:
+						case 0xD2:
+						case 0xD3:
+						case 0xD4:
+						case 0xD5:
+						case 0xD6:
+						case 0xD7:
+						case 0xD8:
+						case 0xD9:
+						case 0xDA:
+						case 0xDB:
+						case 0xDC:
+						case 0xDD:
+						case 0xDE:
+						case 0xDF: // GP0(0xC0): copy rectangle (VRAM to CPU)
+							gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+							break;
+						case 0xE1: // GP0(0xE1): draw mode ("texpage") setting
+							GPU_GP0_E1(gpu, word);
+							break;
+						case 0xE2: // GP0(0xE2): texture window setting
+							GPU_GP0_E2(gpu, word);
+							break;
+						case 0xE3: // GP0(0xE3): set drawing area (top-left)
+							GPU_GP0_E3(gpu, word);
+							break;
+						case 0xE4: // GP0(0xE4): set drawing area (bottom-right)
+							GPU_GP0_E4(gpu, word);
+							break;
+						case 0xE5: // GP0(0xE5): set drawing offset
+							GPU_GP0_E5(gpu, word);
+							break;
+						case 0xE6: // GP0(0xE6): set mask setting bits
+							GPU_GP0_E6(gpu, word);
+							break;
+						default:
+							fprintf(stderr, "PhilPSX: GPU: GP0 SUBMIT: %08X\n",
+									word);
+							break;
+					}
+					break;
+				default: // Command at index 0 in FIFO requires more parameters
+					switch (logical_rshift(gpu->fifoBuffer[0], 24) & 0xFF) {
+						case 0x02: // GP0(0x02): fill rectangle in VRAM
+							if (gpu->commandsInFifo < 3) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 3) {
+									GPU_GP0_02(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x24: // GP0(0x24): textured three-point polygon,
+								   // opaque, texture-blending
+						case 0x25: // GP0(0x25): textured three-point polygon,
+								   // opaque, raw-texture
+						case 0x26: // GP0(0x26): textured three-point polygon,
+								   // semi-transparent, texture-blending
+						case 0x27: // GP0(0x27): textured three-point polygon,
+								   // semi-transparent, raw-texture
+							if (gpu->commandsInFifo < 7) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 7) {
+									GPU_texturedPolygon(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3],
+											gpu->fifoBuffer[4],
+											gpu->fifoBuffer[5],
+											gpu->fifoBuffer[6],
+											0, 0);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x2C: // GP0(0x2C): textured four-point polygon,
+								   // opaque, texture-blending
+						case 0x2D: // GP0(0x2D): textured four-point polygon,
+								   // opaque, raw-texture
+						case 0x2E: // GP0(0x2E): textured four-point polygon,
+								   // semi-transparent, texture-blending
+						case 0x2F: // GP0(0x2F): textured four-point polygon,
+								   // semi-transparent, raw-texture
+							if (gpu->commandsInFifo < 9) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 9) {
+									GPU_texturedPolygon(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3],
+											gpu->fifoBuffer[4],
+											gpu->fifoBuffer[5],
+											gpu->fifoBuffer[6],
+											gpu->fifoBuffer[7],
+											gpu->fifoBuffer[8]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x34: // Shaded textured three-point polygon,
+								   // opaque, texture-blending
+						case 0x35: // Undocumented, textured three-point
+								   // polygon, opaque, no blending
+						case 0x36: // Shaded textured three-point polygon,
+								   // semi-transparent, texture-blending
+						case 0x37: // Undocumented, textured three-point
+								   // polygon, semi-transparent, no blending
+							if (gpu->commandsInFifo < 9) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 9) {
+									GPU_shadedTexturedPolygon(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3],
+											gpu->fifoBuffer[4],
+											gpu->fifoBuffer[5],
+											gpu->fifoBuffer[6],
+											gpu->fifoBuffer[7],
+											gpu->fifoBuffer[8],
+											0, 0, 0);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x3C: // Shaded textured four-point polygon,
+								   // opaque, texture-blending
+						case 0x3D: // Undocumented, textured four-point polygon,
+								   // opaque, no blending
+						case 0x3E: // Shaded textured four-point polygon,
+								   // semi-transparent, texture-blending
+						case 0x3F: // Undocumented, textured four-point polygon,
+								   // semi-transparent, no blending
+							if (gpu->commandsInFifo < 12) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 12) {
+									GPU_shadedTexturedPolygon(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3],
+											gpu->fifoBuffer[4],
+											gpu->fifoBuffer[5],
+											gpu->fifoBuffer[6],
+											gpu->fifoBuffer[7],
+											gpu->fifoBuffer[8],
+											gpu->fifoBuffer[9],
+											gpu->fifoBuffer[10],
+											gpu->fifoBuffer[11]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x20: // GP0(0x20): monochrome three-point polygon,
+								   // opaque
+						case 0x21: // GP0(0x21): undocumented command, same as
+								   // GP0(0x20)
+						case 0x22: // GP0(0x22): monochrome three-point polygon,
+								   // semi-transparent
+						case 0x23: // GP0(0x23): undocumented command, same as
+								   // GP0(0x22)
+							if (gpu->commandsInFifo < 4) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 4) {
+									GPU_monochromePolygon(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3],
+											0);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x28: // GP0(0x28): monochrome four-point polygon,
+								   // opaque
+						case 0x29: // GP0(0x29): undocumented command, same as
+								   // GP0(0x28)
+						case 0x2A: // GP0(0x2A): monochrome four-point polygon,
+								   // semi-transparent
+						case 0x2B: // GP0(0x2B): undocumented command, same as
+								   // GP0(0x2B)
+							if (gpu->commandsInFifo < 5) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 5) {
+									GPU_monochromePolygon(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3],
+											gpu->fifoBuffer[4]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x30: // GP0(0x30): shaded three-point polygon,
+								   // opaque
+						case 0x31: // GP0(0x31): undocumented command, same as
+								   // GP0(0x30)
+						case 0x32: // GP0(0x32): shaded three-point polygon,
+								   // semi-transparent
+						case 0x33: // GP0(0x33): undocumented command, same as
+								   // GP0(0x32)
+							if (gpu->commandsInFifo < 6) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 6) {
+									GPU_shadedPolygon(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3],
+											gpu->fifoBuffer[4],
+											gpu->fifoBuffer[5],
+											0, 0);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x38: // GP0(0x38): shaded four-point polygon,
+								   // opaque
+						case 0x39: // GP0(0x39): undocumented command, same as
+								   // GP0(0x38)
+						case 0x3A: // GP0(0x3A): shaded four-point polygon,
+								   // semi-transparent
+						case 0x3B: // GP0(0x3B): undocumented command, same as
+								   // GP0(0x3A)
+							if (gpu->commandsInFifo < 8) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 8) {
+									GPU_shadedPolygon(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3],
+											gpu->fifoBuffer[4],
+											gpu->fifoBuffer[5],
+											gpu->fifoBuffer[6],
+											gpu->fifoBuffer[7]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x40: // GP0(0x40): monochrome line, opaque
+						case 0x42: // GP0(0x42): monochrome line,
+								   // semi-transparent
+							if (gpu->lineWordCount < 4) {
+								GPU_addLineWord(gpu,
+										gpu->fifoBuffer[0] & 0xFFFFFF);
+								GPU_addLineWord(gpu, word);
+								if (gpu->lineWordCount == 4) {
+									GPU_anyLine(gpu, gpu->fifoBuffer[0]);
+									gpu->lineWordCount = 0;
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x50: // GP0(0x50): shaded line, opaque
+						case 0x52: // GP0(0x52): shaded line, semi-transparent
+							if (gpu->lineWordCount < 4) {
+								if (gpu->lineWordCount == 0)
+									GPU_addLineWord(gpu,
+											gpu->fifoBuffer[0] & 0xFFFFFF);
+								GPU_addLineWord(gpu, word);
+								if (gpu->lineWordCount == 4) {
+									GPU_anyLine(gpu, gpu->fifoBuffer[0]);
+									gpu->lineWordCount = 0;
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x48: // GP0(0x48): monochrome poly-line, opaque
+						case 0x4A: // GP0(0x4A): monochrome poly-line,
+								   // semi-transparent
+							// Variable number of components, so stop at
+							// termination code
+							if (word != 0x55555555 && word != 0x50005000) {
+								GPU_addLineWord(gpu,
+										gpu->fifoBuffer[0] & 0xFFFFFF);
+								GPU_addLineWord(gpu, word);
+							} else {
+								GPU_anyLine(gpu, gpu->fifoBuffer[0]);
+								gpu->lineWordCount = 0;
+								GPU_GP1_01(gpu, 0);
+							}
+							break;
+						case 0x58: // GP0(0x58): shaded poly-line, opaque
+						case 0x5A: // GP0(0x5A): shaded poly-line,
+								   // semi-transparent
+							// Variable number of components, so stop at
+							// termination code
+							if (word != 0x55555555 && word != 0x50005000) {
+								if (gpu->lineWordCount == 0)
+									GPU_addLineWord(gpu,
+											gpu->fifoBuffer[0] & 0xFFFFFF);
+								GPU_addLineWord(gpu, word);
+							} else {
+								GPU_anyLine(gpu, gpu->fifoBuffer[0]);
+								gpu->lineWordCount = 0;
+								GPU_GP1_01(gpu, 0);
+							}
+							break;
+						case 0x60: // GP0(0x60): monochrome rectangle, variable
+								   // size, opaque
+						case 0x62: // GP0(0x62): monochrome rectangle, variable
+								   // size, semi-transparent
+							if (gpu->commandsInFifo < 3) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 3) {
+									GPU_monochromeRectangle(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x68: // GP0(0x68): monochrome rectangle, 1x1,
+								   // opaque
+						case 0x6A: // GP0(0x6A): monochrome rectangle, 1x1,
+								   // semi-transparent
+						case 0x70: // GP0(0x70): monochrome rectangle, 8x8,
+								   // opaque
+						case 0x72: // GP0(0x72): monochrome rectangle, 8x8,
+								   // semi-transparent
+						case 0x78: // GP0(0x78): monochrome rectangle, 16x16,
+								   // opaque
+						case 0x7A: // GP0(0x7A): monochrome rectangle, 16x16,
+								   // semi-transparent
+							if (gpu->commandsInFifo < 2) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 2) {
+									int32_t rectangleSize = 0;
+									switch (logical_rshift(
+											gpu->fifoBuffer[0], 24) & 0xFF) {
+										case 0x68:
+										case 0x6A: // 1x1 size
+											rectangleSize = 0x00010001;
+											break;
+										case 0x70:
+										case 0x72: // 8x8 size
+											rectangleSize = 0x00080008;
+											break;
+										case 0x78:
+										case 0x7A: // 16x16 size
+											rectangleSize = 0x00100010;
+											break;
+									}
+									GPU_monochromeRectangle(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											rectangleSize);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x64: // GP0(0x64): textured rectangle, variable
+								   // size, opaque, texture-blending
+						case 0x65: // GP0(0x65): textured rectangle, variable
+								   // size, opaque, raw-texture
+						case 0x66: // GP0(0x66): textured rectangle, variable
+								   // size, semi-transparent, texture-blending
+						case 0x67: // GP0(0x67): textured rectangle, variable
+								   // size, semi-transparent, raw-texture
+							if (gpu->commandsInFifo < 4) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 4) {
+									GPU_texturedRectangle(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x6C: // GP0(0x6C): textured rectangle, 1x1
+								   // (nonsense), opaque, texture-blending
+						case 0x6D: // GP0(0x6D): textured rectangle, 1x1
+								   // (nonsense), opaque, raw-texture
+						case 0x6E: // GP0(0x6E): textured rectangle, 1x1
+								   // (nonsense), semi-transparent, texture-blending
+						case 0x6F: // GP0(0x6F): textured rectangle, 1x1
+								   // (nonsense), semi-transparent, raw-texture
+						case 0x74: // GP0(0x74): textured rectangle, 8x8,
+								   // opaque, texture-blending
+						case 0x75: // GP0(0x75): textured rectangle, 8x8,
+								   // opaque, raw-texture
+						case 0x76: // GP0(0x76): textured rectangle, 8x8,
+								   // semi-transparent, texture-blending
+						case 0x77: // GP0(0x77): textured rectangle, 8x8,
+								   // semi-transparent, raw-texture
+						case 0x7C: // GP0(0x7C): textured rectangle, 16x16,
+								   // opaque, texture-blending
+						case 0x7D: // GP0(0x7D): textured rectangle, 16x16,
+								   // opaque, raw-texture
+						case 0x7E: // GP0(0x7E): textured rectangle, 16x16,
+								   // semi-transparent, texture-blending
+						case 0x7F: // GP0(0x7F): textured rectangle, 16x16,
+								   // semi-transparent, raw-texture
+							if (gpu->commandsInFifo < 3) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 3) {
+									int32_t rectangleSize = 0;
+									switch (logical_rshift(
+											gpu->fifoBuffer[0], 24) & 0xFF) {
+										case 0x6C:
+										case 0x6D:
+										case 0x6E:
+										case 0x6F: // 1x1 size
+											rectangleSize = 0x00010001;
+											break;
+										case 0x74:
+										case 0x75:
+										case 0x76:
+										case 0x77: // 8x8 size
+											rectangleSize = 0x00080008;
+											break;
+										case 0x7C:
+										case 0x7D:
+										case 0x7E:
+										case 0x7F: // 16x16 size
+											rectangleSize = 0x00100010;
+											break;
+									}
+									GPU_texturedRectangle(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											rectangleSize);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0x80:
+						case 0x81:
+						case 0x82:
+						case 0x83:
+						case 0x84:
+						case 0x85:
+						case 0x86:
+						case 0x87:
+						case 0x88:
+						case 0x89:
+						case 0x8A:
+						case 0x8B:
+						case 0x8C:
+						case 0x8D:
+						case 0x8E:
+						case 0x8F:
+						case 0x90:
+						case 0x91:
+						case 0x92:
+						case 0x93:
+						case 0x94:
+						case 0x95:
+						case 0x96:
+						case 0x97:
+						case 0x98:
+						case 0x99:
+						case 0x9A:
+						case 0x9B:
+						case 0x9C:
+						case 0x9D:
+						case 0x9E:
+						case 0x9F: // GP0(0x80): copy rectangle (VRAM to VRAM)
+							if (gpu->commandsInFifo < 4) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 4) {
+									GPU_GP0_80(gpu,
+											gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2],
+											gpu->fifoBuffer[3]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+						case 0xA0:
+						case 0xA1:
+						case 0xA2:
+						case 0xA3:
+						case 0xA4:
+						case 0xA5:
+						case 0xA6:
+						case 0xA7:
+						case 0xA8:
+						case 0xA9:
+						case 0xAA:
+						case 0xAB:
+						case 0xAC:
+						case 0xAD:
+						case 0xAE:
+						case 0xAF:
+						case 0xB0:
+						case 0xB1:
+						case 0xB2:
+						case 0xB3:
+						case 0xB4:
+						case 0xB5:
+						case 0xB6:
+						case 0xB7:
+						case 0xB8:
+						case 0xB9:
+						case 0xBA:
+						case 0xBB:
+						case 0xBC:
+						case 0xBD:
+						case 0xBE:
+						case 0xBF: // GP0(0xA0): copy rectangle (CPU to VRAM)
+							if (gpu->commandsInFifo < 3) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 3) {
+									// Clear bit 28 (DMA ready) of status
+									// register
+									gpu->statusRegister &= 0xEFFFFFFF;
 
-	int32_t drawTopLeftX = command->drawingAreaTopLeft & 0x3FF;
-	int32_t drawTopLeftY =
-			logical_rshift(command->drawingAreaTopLeft, 10) & 0x1FF;
-	int32_t drawBottomRightX = command->drawingAreaBottomRight & 0x3FF;
-	int32_t drawBottomRightY =
-			logical_rshift(command->drawingAreaBottomRight, 10) & 0x1FF;
+									// Clear bit 26 (ready to receive command
+									// word) of status register
+									gpu->statusRegister &= 0xFBFFFFFF;
 
-	// Convert Y values to OpenGL form
-	drawYOffset = -drawYOffset;
-	drawTopLeftY = 511 - drawTopLeftY;
-	drawBottomRightY = 511 - drawBottomRightY;
+									// Trigger DMA input
+									gpu->dmaWriteInProgress = 0xA0;
+									gpu->dmaBufferIndex = 0;
+									gpu->dmaWidthInPixels =
+											gpu->fifoBuffer[2] & 0xFFFF;
+									gpu->dmaWidthInPixels =
+											((gpu->dmaWidthInPixels - 1)
+											& 0x3FF) + 1;
+									gpu->dmaHeightInPixels = logical_rshift(
+											gpu->fifoBuffer[2],
+											16) & 0xFFFF;
+									gpu->dmaHeightInPixels =
+											((gpu->dmaHeightInPixels - 1)
+											& 0x1FF) + 1;
+									gpu->dmaWidthInPixels =
+											(gpu->dmaWidthInPixels == 0) ?
+											0x400 : gpu->dmaWidthInPixels;
+									gpu->dmaHeightInPixels =
+											(gpu->dmaHeightInPixels == 0) ?
+											0x200 : gpu->dmaHeightInPixels;
+									gpu->dmaNeededBytes =
+											gpu->dmaWidthInPixels *
+											gpu->dmaHeightInPixels;
+									gpu->dmaNeededBytes *= 2;
 
-	// Adjust coordinates with offsets
-	for (int32_t i = 0; i < 4; ++i) {
-		vertex_x[i] += drawXOffset;
-		vertex_y[i] += drawYOffset;
-	}
+									// Make sure the GPU has finished with
+									// the staging slot we are about to fill
+									if (atomic_load(&gpu->uploadSlotBusy[
+											gpu->uploadSlot]))
+										GPU_waitForUploadSlot(gpu);
+								}
+							}
+							break;
+						case 0xC0:
+						case 0xC1:
+						case 0xC2:
+						case 0xC3:
+						case 0xC4:
+						case 0xC5:
+						case 0xC6:
+						case 0xC7:
+						case 0xC8:
+						case 0xC9:
+						case 0xCA:
+						case 0xCB:
+						case 0xCC:
+						case 0xCD:
+						case 0xCE:
+						case 0xCF:
+						case 0xD0:
+						case 0xD1:
+						case 0xD2:
+						case 0xD3:
+						case 0xD4:
+						case 0xD5:
+						case 0xD6:
+						case 0xD7:
+						case 0xD8:
+						case 0xD9:
+						case 0xDA:
+						case 0xDB:
+						case 0xDC:
+						case 0xDD:
+						case 0xDE:
+						case 0xDF: // GP0(0xC0): copy rectangle (VRAM to CPU)
+							if (gpu->commandsInFifo < 3) {
+								gpu->fifoBuffer[gpu->commandsInFifo++] = word;
+								if (gpu->commandsInFifo == 3) {
+									// Clear bit 28 (DMA ready) of status
+									// register
+									gpu->statusRegister &= 0xEFFFFFFF;
 
-	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glFramebufferTexture2D called");
-	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glBindImageTexture called");
+									// Set bit 27 (ready to send VRAM to CPU)
+									gpu->statusRegister |= 0x08000000;
 
-	// Bind to empty framebuffer, setting viewport correctly
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glBindFramebuffer called");
-	gl->glViewport(0, 0, 1024, 512);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glViewport called");
+									// Clear bit 26 (ready to receive command
+									// word) of status register
+									gpu->statusRegister &= 0xFBFFFFFF;
 
-	// Set uniforms and render first triangle to vram texture
-	gl->glUseProgram(gpu->monochromePolygonProgram1);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUseProgram called");
-	gl->glUniform3iv(0, 1, vertex_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform3iv called");
-	gl->glUniform3iv(1, 1, vertex_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform3iv called");
-	gl->glUniform1i(2, red);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(3, green);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(4, blue);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(5, semiTransparencyEnabled);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(6, semiTransparencyMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(7, setMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(8, checkMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(9, drawTopLeftX);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(10, drawTopLeftY);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(11, drawBottomRightX);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glUniform1i(12, drawBottomRightY);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLES, 0, 3);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glDrawArrays called");
-	gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glMemoryBarrier called");
+									// Trigger DMA output
+									gpu->dmaReadInProgress = 0xC0;
+									gpu->dmaBufferIndex = 0;
+									gpu->dmaWidthInPixels =
+											gpu->fifoBuffer[2] & 0xFFFF;
+									gpu->dmaWidthInPixels =
+											((gpu->dmaWidthInPixels - 1)
+											& 0x3FF) + 1;
+									gpu->dmaHeightInPixels = logical_rshift(
+											gpu->fifoBuffer[2], 16) & 0xFFFF;
+									gpu->dmaHeightInPixels =
+											((gpu->dmaHeightInPixels - 1)
+											& 0x1FF) + 1;
+									gpu->dmaWidthInPixels =
+											(gpu->dmaWidthInPixels == 0) ?
+											0x400 : gpu->dmaWidthInPixels;
+									gpu->dmaHeightInPixels =
+											(gpu->dmaHeightInPixels == 0) ?
+											0x200 : gpu->dmaHeightInPixels;
+									gpu->dmaNeededBytes =
+											gpu->dmaWidthInPixels *
+											gpu->dmaHeightInPixels;
+									gpu->dmaNeededBytes *= 4;
 
-	// Check if we need a second triangle
-	if (fourPoints == 1) {
-		gl->glUniform3iv(0, 1, vertex_x + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation "
-			"function, glUniform3iv called");
-		gl->glUniform3iv(1, 1, vertex_y + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation "
-			"function, glUniform3iv called");
-		gl->glDrawArrays(GL_TRIANGLES, 0, 3);
-		GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation "
-			"function, glDrawArrays called");
-		gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-		GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation "
-			"function, glMemoryBarrier called");
+									// Start reading vram on the GL thread
+									// now, so it can overlap with emulation
+									GPU_GP0_C0(gpu, gpu->fifoBuffer[0],
+											gpu->fifoBuffer[1],
+											gpu->fifoBuffer[2]);
+									GPU_GP1_01(gpu, 0);
+								}
+							}
+							break;
+					}
+					break;
+			}
+			break;
 	}
-
-	// Unbind texture from image unit
-	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glBindImageTexture called");
-
-	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glFramebufferTexture2D called");
-
-	// Bind to zero framebuffer
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromePolygon_implementation function, "
-			"glBindFramebuffer called");
 }
 
 /*
- * This function draws a monochrome rectangle, with various options, by queuing
- * this work on the rendering thread.
+ * This function queues a command on the rendering thread, first submitting
+ * any state that may have changed since the last command. Only the bottom
+ * half of the status register is relevant to rendering, so the rest is
+ * masked out to avoid sending state packets for readiness flags and such.
  */
-static void GPU_monochromeRectangle(GPU *gpu, int32_t command, int32_t vertex,
-		int32_t widthAndHeight)
+static void GPU_queueCommand(GPU *gpu,
+		void (*functionPointer)(GpuCommand *command),
+		const int32_t *parameters, int32_t parameterCount,
+		bool waitForCompletion)
 {
-	// Perform draw on GL thread, making sure to set pointers
-	GpuCommand monochromeRectangle;
-	monochromeRectangle.functionPointer =
-			&GPU_monochromeRectangle_implementation;
-	monochromeRectangle.gpu = gpu;
-
-	// Store parameters in object then submit it to work queue
-	monochromeRectangle.parameter1 = command;
-	monochromeRectangle.parameter2 = vertex;
-	monochromeRectangle.parameter3 = widthAndHeight;
-	monochromeRectangle.statusRegister = gpu->statusRegister;
-	monochromeRectangle.drawingAreaBottomRight = gpu->drawingAreaBottomRight;
-	monochromeRectangle.drawingAreaTopLeft = gpu->drawingAreaTopLeft;
-	monochromeRectangle.drawingOffset = gpu->drawingOffset;
-	WorkQueue_addItem(gpu->wq, &monochromeRectangle, false);
+	// Submit state if needed
+	if (gpu->renderStateChanged) {
+		WorkQueue *wq = gpu->wq;
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_STATUS_REGISTER,
+				gpu->statusRegister & 0xFFFF);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_DRAWING_AREA_TOP_LEFT,
+				gpu->drawingAreaTopLeft);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_DRAWING_AREA_BOTTOM_RIGHT,
+				gpu->drawingAreaBottomRight);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_DRAWING_OFFSET,
+				gpu->drawingOffset);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_TEXTURE_WINDOW,
+				gpu->textureWindow);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_X_START, gpu->xStart);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_Y_START, gpu->yStart);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_X1, gpu->x1);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_X2, gpu->x2);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_Y1, gpu->y1);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_Y2, gpu->y2);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_REAL_HORIZONTAL_RES,
+				gpu->realHorizontalRes);
+		WorkQueue_setState(wq, PHILPSX_GPUCOMMAND_REAL_VERTICAL_RES,
+				gpu->realVerticalRes);
+		gpu->renderStateChanged = false;
+	}
+	
+	// Submit command
+	WorkQueue_addItem(gpu->wq, functionPointer, gpu, parameters,
+			parameterCount, waitForCompletion);
 }
 
 /*
- * This function contains the implementation of GPU_monochromeRectangle.
+ * This function lets us read the DMA buffer in a thread-safe way.
  */
-static void GPU_monochromeRectangle_implementation(GpuCommand *command)
+static int8_t GPU_readDMABuffer(GPU *gpu, int32_t index)
 {
-	// Get GL function pointers and GPU objects
-	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
-
-	// Extract command byte
-	int32_t commandByte = logical_rshift(command->parameter1, 24) & 0xFF;
-
-	// Detect if we are in opaque or semi-transparent mode
-	// (opaque by default)
-	int32_t semiTransparencyEnabled = 0;
-	int32_t semiTransparencyMode = (command->statusRegister >> 5) & 0x3;
-	switch (commandByte) {
-		case 0x62:
-		case 0x6A:
-		case 0x72:
-		case 0x7A: // Semi-transparent mode
-			semiTransparencyEnabled = 1;
-	}
-
-	// Get colour
-	int32_t red = command->parameter1 & 0xFF;
-	int32_t green = logical_rshift(command->parameter1, 8) & 0xFF;
-	int32_t blue = logical_rshift(command->parameter1, 16) & 0xFF;
-
-	// Get width and height
-	int32_t width = command->parameter3 & 0xFFFF;
-	width = ((width - 1) & 0x3FF) + 1;
-	int32_t height = logical_rshift(command->parameter3, 16) & 0xFFFF;
-	height = ((height - 1) & 0x1FF) + 1;
-	width = (width == 0) ? 0x400 : width;
-	height = (height == 0) ? 0x200 : height;
-
-	// Get vertex parameters and sign-extend if needed
-	int32_t x = command->parameter2 & 0x7FF;
-	int32_t y = logical_rshift(command->parameter2, 16) & 0x7FF;
-	if ((x & 0x400) == 0x400)
-		x |= 0xFFFFF800;
-	if ((y & 0x400) == 0x400)
-		y |= 0xFFFFF800;
-
-	// As we go from bottom-left corner in OpenGL viewport, adjust y
-	y = 511 - y;
-	y -= height - 1;
-
-	// Split out masking bits from status register
-	int32_t setMask = logical_rshift(command->statusRegister, 11) & 0x1;
-	int32_t checkMask = logical_rshift(command->statusRegister, 12) & 0x1;
-
-	// Setup drawing area variables
-	int32_t drawXOffset = command->drawingOffset & 0x7FF;
-	int32_t drawYOffset = logical_rshift(command->drawingOffset, 11) & 0x7FF;
-	if ((drawXOffset & 0x400) == 0x400)
-		drawXOffset |= 0xFFFFF800;
-	if ((drawYOffset & 0x400) == 0x400)
-		drawYOffset |= 0xFFFFF800;
-
-	int32_t drawTopLeftX = command->drawingAreaTopLeft & 0x3FF;
-	int32_t drawTopLeftY =
-			logical_rshift(command->drawingAreaTopLeft, 10) & 0x1FF;
-	int32_t drawBottomRightX = command->drawingAreaBottomRight & 0x3FF;
-	int32_t drawBottomRightY =
-			logical_rshift(command->drawingAreaBottomRight, 10) & 0x1FF;
+	pthread_mutex_lock(&gpu->dmaBufferMutex);
+	int8_t value = gpu->dmaBuffer[index];
+	pthread_mutex_unlock(&gpu->dmaBufferMutex);
 
-	// Convert Y values to OpenGL basis
-	drawYOffset = -drawYOffset;
-	drawTopLeftY = 511 - drawTopLeftY;
-	drawBottomRightY = 511 - drawBottomRightY;
+	return value;
+}
 
-	// Adjust coordinates with offsets
-	x += drawXOffset;
-	y += drawYOffset;
+/*
+ * This function handles byte reads from the GPU registers.
+ */
+static int32_t GPU_readRegisterByte(void *component, int32_t address)
+{
+	int32_t word = GPU_readRegisterWord(component, address & 0xFFFFFFFC);
+	return (int8_t)logical_rshift(word, (address & 0x3) * 8);
+}
 
-	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glFramebufferTexture2D called");
-	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glBindImageTexture called");
+/*
+ * This function handles halfword reads from the GPU registers.
+ */
+static int32_t GPU_readRegisterHalfWord(void *component, int32_t address)
+{
+	int32_t word = GPU_readRegisterWord(component, address & 0xFFFFFFFC);
+	return logical_rshift(word, (address & 0x2) * 8) & 0xFFFF;
+}
 
-	// Bind to empty framebuffer, setting viewport correctly
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glBindFramebuffer called");
-	gl->glViewport(x, y, width, height);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glViewport called");
-
-	// Set rectangle colour pixels in correct manner to vram texture,
-	// setting uniforms correctly
-	gl->glUseProgram(gpu->monochromeRectangleProgram1);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUseProgram called");
-	gl->glUniform1i(0, x);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(1, y);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(2, height);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(3, red);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(4, green);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(5, blue);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(6, semiTransparencyEnabled);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(7, semiTransparencyMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(8, setMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(9, checkMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(10, drawTopLeftX);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(11, drawTopLeftY);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(12, drawBottomRightX);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(13, drawBottomRightY);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glDrawArrays called");
-	gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glMemoryBarrier called");
+/*
+ * This function handles word reads from the GPU registers, which return the
+ * response to the last command or the GPU status.
+ */
+static int32_t GPU_readRegisterWord(void *component, int32_t address)
+{
+	GPU *gpu = component;
 
-	// Unbind texture from image unit
-	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glBindImageTexture called");
+	if ((address & 0xFFFFFFFC) == 0x1F801810)
+		return GPU_readResponse(gpu);
+	else
+		return GPU_readStatus(gpu);
+}
 
-	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_monochromeRectangle_implementation "
-			"function, glFramebufferTexture2D called");
+/*
+ * This function reads the whole of vram into a buffer of 1024x512
+ * little-endian 16-bit pixels, top row first. It goes through the GP0(0xC0)
+ * read path, so must only be called while GP0 is idle.
+ */
+static void GPU_readVram(GPU *gpu, int8_t *vram)
+{
+	// Copy vram into the DMA buffer, waiting for it to get there
+	GPU_GP0_C0(gpu, 0xC0000000, 0, 0x02000400);
+	GPU_waitForVramRead(gpu);
+
+	// Organise bytes into original structure, with rows in the DMA buffer
+	// going from the bottom of vram up
+	pthread_mutex_lock(&gpu->dmaBufferMutex);
+	for (int32_t y = 0; y < 512; ++y) {
+		const int8_t *row = gpu->dmaBuffer + (511 - y) * 1024 * 4;
+		for (int32_t x = 0; x < 1024; ++x) {
+			const int8_t *pixel = row + x * 4;
+			int32_t value = ((pixel[3] & 0x1) << 15) |
+					((pixel[2] & 0x1F) << 10) | ((pixel[1] & 0x1F) << 5) |
+					(pixel[0] & 0x1F);
+			write_le_halfword(vram + (y * 1024 + x) * 2, value);
+		}
+	}
+	pthread_mutex_unlock(&gpu->dmaBufferMutex);
 }
 
 /*
- * This function lets us read the DMA buffer in a thread-safe way.
+ * This function reads lineCount lines of vram, starting from firstLine (top
+ * row first), into the same lines of vram, which is 1024x512 little-endian
+ * 16-bit pixels. It reads them into the DMA buffer with one call, so the
+ * caller must hold dmaBufferMutex and have the vram framebuffer bound.
  */
-static int8_t GPU_readDMABuffer(GPU *gpu, int32_t index)
+static void GPU_readVramBand(GPU *gpu, int8_t *vram, int32_t firstLine,
+		int32_t lineCount)
+{
+	// Read lines, which arrive going from the bottom of the band up
+	gpu->gl->glReadPixels(0, 512 - firstLine - lineCount, 1024, lineCount,
+			GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, gpu->dmaBuffer);
+	GPU_checkOpenGLErrors(gpu, "GPU_readVramBand function, glReadPixels "
+			"called");
+
+	// Organise bytes into original structure
+	for (int32_t y = 0; y < lineCount; ++y) {
+		const int8_t *row = gpu->dmaBuffer + (lineCount - 1 - y) * 1024 * 4;
+		int8_t *dest = vram + (firstLine + y) * 1024 * 2;
+		for (int32_t x = 0; x < 1024; ++x) {
+			const int8_t *pixel = row + x * 4;
+			int32_t value = ((pixel[3] & 0x1) << 15) |
+					((pixel[2] & 0x1F) << 10) | ((pixel[1] & 0x1F) << 5) |
+					(pixel[0] & 0x1F);
+			write_le_halfword(dest + x * 2, value);
+		}
+	}
+}
+
+/*
+ * This function contains the implementation of the vram readback for
+ * GPU_saveState, which converts vram into the save state as 1024x512
+ * little-endian 16-bit pixels, top row first. Only rows of tiles written
+ * since the last save state are read back, with neighbouring rows read
+ * together, and the rest come from the copy kept of vram.
+ */
+static void GPU_readVramState_implementation(GpuCommand *command)
 {
+	// Get GPU object
+	GPU *gpu = command->gpu;
+
+	// Hand over to the software renderer if it is in use, which holds vram
+	// in this format already
+	if (gpu->softRenderer) {
+		SoftRenderer_readVram(gpu->softRenderer, gpu->stateVram);
+		return;
+	}
+
+	// Draw any batched primitives, as this touches vram directly
+	GPU_endDrawingPass(gpu);
+
+	// Read vram into the copy, or straight into the state if there isn't
+	// one, utilising dmaBufferMutex to ensure mutual exclusion
+	bool haveCopy = GPU_setupStateVramCopy(gpu);
+	int8_t *vram = haveCopy ? gpu->stateVramCopy : gpu->stateVram;
 	pthread_mutex_lock(&gpu->dmaBufferMutex);
-	int8_t value = gpu->dmaBuffer[index];
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER,
+			gpu->vramFramebuffer[0]);
+	GPU_checkOpenGLErrors(gpu, "GPU_readVramState_implementation function, "
+			"glBindFramebuffer called");
+	for (int32_t row = 0; row < PHILPSX_VRAMDIRTYMAP_ROWS;) {
+		if (haveCopy && VramDirtyMap_getTileRow(gpu->vramDirtyMap,
+				gpu->stateDirtyClient, row) == 0) {
+			++row;
+			continue;
+		}
+		int32_t firstRow = row;
+		while (row < PHILPSX_VRAMDIRTYMAP_ROWS && (!haveCopy ||
+				VramDirtyMap_getTileRow(gpu->vramDirtyMap,
+				gpu->stateDirtyClient, row) != 0))
+			++row;
+		GPU_readVramBand(gpu, vram,
+				firstRow * PHILPSX_VRAMDIRTYMAP_TILE_SIZE,
+				(row - firstRow) * PHILPSX_VRAMDIRTYMAP_TILE_SIZE);
+	}
+	GLStateCache_bindFramebuffer(gpu->glState, GL_FRAMEBUFFER, 0);
+	GPU_checkOpenGLErrors(gpu, "GPU_readVramState_implementation function, "
+			"glBindFramebuffer called");
 	pthread_mutex_unlock(&gpu->dmaBufferMutex);
 
-	return value;
+	// Copy is now up to date, so hand it over to the state
+	if (haveCopy) {
+		VramDirtyMap_clearAll(gpu->vramDirtyMap, gpu->stateDirtyClient);
+		memcpy(gpu->stateVram, gpu->stateVramCopy,
+				PHILPSX_GPUTRACE_VRAM_SIZE);
+	}
 }
 
 /*
@@ -3978,6 +6085,68 @@ static bool GPU_realCheckOpenGLErrors(GPU *gpu, const char *message)
 	return errorDetected;
 }
 
+/*
+ * This function adds a record to the trace being captured, if there is one.
+ * The trace is abandoned if the file can't be written to.
+ */
+static void GPU_recordTrace(GPU *gpu, int32_t type, int32_t word)
+{
+	if (!gpu->trace || GpuTrace_writeRecord(gpu->trace, type, word))
+		return;
+
+	fprintf(stderr, "PhilPSX: GPU: Couldn't write to trace file, stopping "
+			"trace\n");
+	destruct_GpuTrace(gpu->trace);
+	gpu->trace = NULL;
+}
+
+/*
+ * This function releases any busy staging slots whose uploads the GPU has
+ * finished with, without waiting for those that are still in flight. It is
+ * intended to be called from the GL context thread.
+ */
+static void GPU_releaseUploadSlots(GPU *gpu)
+{
+	// Get GL function pointers
+	GLFunctionPointers *gl = gpu->gl;
+
+	for (int32_t i = 0; i < GPU_UPLOAD_BUFFER_SLOTS; ++i) {
+		GLsync fence = gpu->uploadBufferFences[i];
+		if (!fence)
+			continue;
+		GLenum result = gl->glClientWaitSync(fence, 0, 0);
+		if (result == GL_ALREADY_SIGNALED ||
+				result == GL_CONDITION_SATISFIED) {
+			gl->glDeleteSync(fence);
+			gpu->uploadBufferFences[i] = NULL;
+			atomic_store(&gpu->uploadSlotBusy[i], false);
+		}
+	}
+}
+
+/*
+ * This function sets up the copy of vram kept for save states the first time
+ * one is taken or loaded, returning whether it is available. A new client of
+ * the dirty map starts out fully dirty, so the first use reads or uploads
+ * all of vram. It is intended to be called from the GL context thread.
+ */
+static bool GPU_setupStateVramCopy(GPU *gpu)
+{
+	if (gpu->stateVramCopy)
+		return true;
+
+	gpu->stateDirtyClient = VramDirtyMap_addClient(gpu->vramDirtyMap);
+	if (gpu->stateDirtyClient == -1)
+		return false;
+	gpu->stateVramCopy = malloc(PHILPSX_GPUTRACE_VRAM_SIZE);
+	if (!gpu->stateVramCopy) {
+		fprintf(stderr, "PhilPSX: GPU: Couldn't allocate memory for save "
+				"state vram copy\n");
+		return false;
+	}
+	return true;
+}
+
 /**
  * This function draws a shaded three or four point polygon, by queuing
  * this work on the rendering thread.
@@ -3986,25 +6155,20 @@ static void GPU_shadedPolygon(GPU *gpu, int32_t command, int32_t vertex1,
 		int32_t colour2, int32_t vertex2, int32_t colour3, int32_t vertex3,
 		int32_t colour4, int32_t vertex4)
 {
-	// Perform draw on GL thread, making sure to set pointers
-	GpuCommand shadedPolygon;
-	shadedPolygon.functionPointer = &GPU_shadedPolygon_implementation;
-	shadedPolygon.gpu = gpu;
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_POLYGON, 1);
+
+	// Nothing to draw if this frame is being skipped
+	if (gpu->frameSkipped)
+		return;
 
-	// Store parameters in object then submit it to work queue
-	shadedPolygon.parameter1 = command;
-	shadedPolygon.parameter2 = vertex1;
-	shadedPolygon.parameter3 = colour2;
-	shadedPolygon.parameter4 = vertex2;
-	shadedPolygon.parameter5 = colour3;
-	shadedPolygon.parameter6 = vertex3;
-	shadedPolygon.parameter7 = colour4;
-	shadedPolygon.parameter8 = vertex4;
-	shadedPolygon.statusRegister = gpu->statusRegister;
-	shadedPolygon.drawingOffset = gpu->drawingOffset;
-	shadedPolygon.drawingAreaTopLeft = gpu->drawingAreaTopLeft;
-	shadedPolygon.drawingAreaBottomRight = gpu->drawingAreaBottomRight;
-	WorkQueue_addItem(gpu->wq, &shadedPolygon, false);
+	// Perform draw on GL thread, leaving out the fourth vertex for three
+	// point polygons
+	int32_t parameters[] = {command, vertex1, colour2, vertex2, colour3,
+			vertex3, colour4, vertex4};
+	GPU_queueCommand(gpu, &GPU_shadedPolygon_implementation, parameters,
+			(command & 0x08000000) ? 8 : 6, false);
 }
 
 /*
@@ -4012,9 +6176,14 @@ static void GPU_shadedPolygon(GPU *gpu, int32_t command, int32_t vertex1,
  */
 static void GPU_shadedPolygon_implementation(GpuCommand *command)
 {
-	// Get GL function pointers and GPU objects
+	// Get GPU object
 	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_drawPolygon(gpu->softRenderer, command);
+		return;
+	}
 
 	// Extract command byte
 	int32_t commandByte = logical_rshift(command->parameter1, 24) & 0xFF;
@@ -4135,129 +6304,26 @@ static void GPU_shadedPolygon_implementation(GpuCommand *command)
 		vertex_y[i] += drawYOffset;
 	}
 
-	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glFramebufferTexture2D called");
-	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glBindImageTexture called");
-
-	// Bind to empty framebuffer, setting viewport correctly
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glViewport(0, 0, 1024, 512);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glViewport called");
-
-	// Set uniforms and render first triangle to vram texture
-	gl->glUseProgram(gpu->shadedPolygonProgram1);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUseProgram called");
-	gl->glUniform3iv(0, 1, vertex_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(1, 1, vertex_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(2, 1, redArray);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(3, 1, greenArray);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(4, 1, blueArray);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform1i(5, dither);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(6, semiTransparencyEnabled);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(7, semiTransparencyMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(8, setMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(9, checkMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(10, drawTopLeftX);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(11, drawTopLeftY);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(12, drawBottomRightX);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(13, drawBottomRightY);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLES, 0, 3);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glDrawArrays called");
-	gl->glMemoryBarrier(GL_ALL_BARRIER_BITS);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glMemoryBarrier called");
-
-	// Check if we need a second triangle
-	if (fourPoints == 1) {
-		gl->glUniform3iv(0, 1, vertex_x + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(1, 1, vertex_y + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(2, 1, redArray + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(3, 1, greenArray + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(4, 1, blueArray + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glDrawArrays(GL_TRIANGLES, 0, 3);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-				"function, glDrawArrays called");
-		gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-				"function, glMemoryBarrier called");
+	// Build vertices, splitting four-pointed polygons into two triangles
+	GpuVertex vertices[6];
+	int32_t vertexCount = 3 + fourPoints * 3;
+	for (int32_t i = 0; i < vertexCount; ++i) {
+		int32_t vertex = GPU_polygonVertexOrder[i];
+		vertices[i] = (GpuVertex){
+			.position = {vertex_x[vertex], vertex_y[vertex]},
+			.colour = {redArray[vertex], greenArray[vertex],
+					blueArray[vertex]},
+			.primitive1 = {semiTransparencyEnabled}
+		};
 	}
 
-	// Unbind textures from image units
-	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glBindImageTexture called");
-
-	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glFramebufferTexture2D called");
-
-	// Bind to zero framebuffer
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedPolygon_implementation "
-			"function, glBindFramebuffer called");
+	// Add polygon to the current batch
+	int32_t uniforms[] = {dither, semiTransparencyMode, setMask, checkMask,
+			drawTopLeftX, drawTopLeftY, drawBottomRightX, drawBottomRightY};
+	int32_t drawingArea[] = {drawTopLeftX, drawTopLeftY, drawBottomRightX,
+			drawBottomRightY};
+	GPU_batchPolygon(gpu, gpu->shadedPolygonProgram1, uniforms, 8,
+			vertices, fourPoints, vertex_x, vertex_y, drawingArea, NULL, 0);
 }
 
 /*
@@ -4270,31 +6336,21 @@ static void GPU_shadedTexturedPolygon(GPU *gpu, int32_t command,
 		int32_t vertex3, int32_t texCoord3, int32_t colour4, int32_t vertex4,
 		int32_t texCoord4)
 {
-	// Perform draw on GL thread, making sure to set pointers
-	GpuCommand shadedTexturedPolygon;
-	shadedTexturedPolygon.functionPointer =
-			&GPU_shadedTexturedPolygon_implementation;
-	shadedTexturedPolygon.gpu = gpu;
-
-	// Store parameters in object then submit it to work queue
-	shadedTexturedPolygon.parameter1 = command;
-	shadedTexturedPolygon.parameter2 = vertex1;
-	shadedTexturedPolygon.parameter3 = texCoord1AndPalette;
-	shadedTexturedPolygon.parameter4 = colour2;
-	shadedTexturedPolygon.parameter5 = vertex2;
-	shadedTexturedPolygon.parameter6 = texCoord2AndTexPage;
-	shadedTexturedPolygon.parameter7 = colour3;
-	shadedTexturedPolygon.parameter8 = vertex3;
-	shadedTexturedPolygon.parameter9 = texCoord3;
-	shadedTexturedPolygon.parameter10 = colour4;
-	shadedTexturedPolygon.parameter11 = vertex4;
-	shadedTexturedPolygon.parameter12 = texCoord4;
-	shadedTexturedPolygon.statusRegister = gpu->statusRegister;
-	shadedTexturedPolygon.drawingOffset = gpu->drawingOffset;
-	shadedTexturedPolygon.drawingAreaTopLeft = gpu->drawingAreaTopLeft;
-	shadedTexturedPolygon.drawingAreaBottomRight = gpu->drawingAreaBottomRight;
-	shadedTexturedPolygon.textureWindow = gpu->textureWindow;
-	WorkQueue_addItem(gpu->wq, &shadedTexturedPolygon, false);
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_POLYGON, 1);
+
+	// Nothing to draw if this frame is being skipped
+	if (gpu->frameSkipped)
+		return;
+
+	// Perform draw on GL thread, leaving out the fourth vertex for three
+	// point polygons
+	int32_t parameters[] = {command, vertex1, texCoord1AndPalette, colour2,
+			vertex2, texCoord2AndTexPage, colour3, vertex3, texCoord3,
+			colour4, vertex4, texCoord4};
+	GPU_queueCommand(gpu, &GPU_shadedTexturedPolygon_implementation,
+			parameters, (command & 0x08000000) ? 12 : 9, false);
 }
 
 /*
@@ -4302,9 +6358,14 @@ static void GPU_shadedTexturedPolygon(GPU *gpu, int32_t command,
  */
 static void GPU_shadedTexturedPolygon_implementation(GpuCommand *command)
 {
-	// Get GL function pointers and GPU objects
+	// Get GPU object
 	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_drawPolygon(gpu->softRenderer, command);
+		return;
+	}
 
 	// Extract command byte
 	int32_t commandByte = logical_rshift(command->parameter1, 24) & 0xFF;
@@ -4471,171 +6532,58 @@ static void GPU_shadedTexturedPolygon_implementation(GpuCommand *command)
 	// Set transparency mode
 	int32_t semiTransparencyMode = logical_rshift(texPage, 5) & 0x3;
 
-	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glFramebufferTexture2D called");
-	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glBindImageTexture called");
-
-	// Bind to empty framebuffer, setting viewport correctly
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glViewport(0, 0, 1024, 512);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glViewport called");
-
-	// Set uniforms and render first triangle to vram texture
-	gl->glUseProgram(gpu->shadedTexturedPolygonProgram1);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUseProgram called");
-	gl->glUniform3iv(0, 1, vertex_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(1, 1, vertex_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(2, 1, texture_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(3, 1, texture_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform1i(4, texBaseX);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(5, texBaseY);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(6, texColourMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(7, texWidthMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(8, texHeightMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(9, texWinOffsetX);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(10, texWinOffsetY);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform3iv(11, 1, redArray);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(12, 1, greenArray);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(13, 1, blueArray);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform1i(14, dither);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(15, disableBlending);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(16, clut_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(17, clut_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(18, setMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(19, checkMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(20, semiTransparencyEnabled);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(21, semiTransparencyMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(22, drawTopLeftX);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(23, drawTopLeftY);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(24, drawBottomRightX);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(25, drawBottomRightY);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLES, 0, 3);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glDrawArrays called");
-	gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glMemoryBarrier called");
-
-	// Check if we need a second triangle
-	if (fourPoints == 1) {
-		gl->glUniform3iv(0, 1, vertex_x + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(1, 1, vertex_y + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(2, 1, texture_x + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(3, 1, texture_y + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(11, 1, redArray + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(12, 1, greenArray + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(13, 1, blueArray + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glDrawArrays(GL_TRIANGLES, 0, 3);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glDrawArrays called");
-		gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-		GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-				"function, glMemoryBarrier called");
+	// Find the page in the texture cache, if the polygon can use it
+	int32_t drawnArea[4];
+	GPU_getDrawnArea(drawnArea, vertex_x, vertex_y, 3 + fourPoints,
+			drawTopLeftX, drawTopLeftY, drawBottomRightX, drawBottomRightY);
+	int32_t textureCacheLayer = GPU_getTextureCacheLayer(gpu, drawnArea,
+			texBaseX, texBaseY, texColourMode, clut_x, clut_y);
+
+	// Build vertices, splitting four-pointed polygons into two triangles
+	GpuVertex vertices[6];
+	int32_t vertexCount = 3 + fourPoints * 3;
+	for (int32_t i = 0; i < vertexCount; ++i) {
+		int32_t vertex = GPU_polygonVertexOrder[i];
+		vertices[i] = (GpuVertex){
+			.position = {vertex_x[vertex], vertex_y[vertex]},
+			.colour = {redArray[vertex], greenArray[vertex],
+					blueArray[vertex]},
+			.texCoord = {texture_x[vertex], texture_y[vertex]},
+			.primitive1 = {texBaseX, texBaseY, texColourMode,
+					semiTransparencyMode},
+			.primitive2 = {clut_x, clut_y, disableBlending,
+					semiTransparencyEnabled},
+			.textureCacheLayer = textureCacheLayer
+		};
 	}
 
-	// Unbind texture from image unit
-	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glBindImageTexture called");
+	// Add polygon to the current batch, noting the texture page and CLUT
+	// it reads from
+	int32_t uniforms[] = {texWidthMask, texHeightMask, texWinOffsetX,
+			texWinOffsetY, dither, setMask, checkMask, drawTopLeftX,
+			drawTopLeftY, drawBottomRightX, drawBottomRightY};
+	int32_t drawingArea[] = {drawTopLeftX, drawTopLeftY, drawBottomRightX,
+			drawBottomRightY};
+	int32_t readAreas[GPU_MAX_READ_AREAS * 4];
+	int32_t readAreaCount = GPU_getTextureReadAreas(readAreas, texBaseX,
+			texBaseY, texColourMode, clut_x, clut_y);
+	GPU_batchPolygon(gpu, gpu->shadedTexturedPolygonProgram1, uniforms, 11,
+			vertices, fourPoints, vertex_x, vertex_y, drawingArea, readAreas,
+			readAreaCount);
+}
 
-	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glFramebufferTexture2D called");
+/*
+ * This function waits for the renderer to finish everything queued so far,
+ * by reading back a single pixel of vram. It goes through the GP0(0xC0) read
+ * path, so does nothing while a GP0(0xC0) response is still being read.
+ */
+static void GPU_syncRenderer(GPU *gpu)
+{
+	if (gpu->dmaReadInProgress != -1)
+		return;
 
-	// Bind to zero framebuffer
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_shadedTexturedPolygon_implementation "
-			"function, glBindFramebuffer called");
+	GPU_GP0_C0(gpu, 0xC0000000, 0, 0x00010001);
+	GPU_waitForVramRead(gpu);
 }
 
 /*
@@ -4647,27 +6595,20 @@ static void GPU_texturedPolygon(GPU *gpu, int32_t command, int32_t vertex1,
 		int32_t texCoord2AndTexPage, int32_t vertex3, int32_t texCoord3,
 		int32_t vertex4, int32_t texCoord4)
 {
-	// Perform draw on GL thread, making sure to set pointers
-	GpuCommand texturedPolygon;
-	texturedPolygon.functionPointer = &GPU_texturedPolygon_implementation;
-	texturedPolygon.gpu = gpu;
-
-	// Store parameters in object then submit it to work queue
-	texturedPolygon.parameter1 = command;
-	texturedPolygon.parameter2 = vertex1;
-	texturedPolygon.parameter3 = texCoord1AndPalette;
-	texturedPolygon.parameter4 = vertex2;
-	texturedPolygon.parameter5 = texCoord2AndTexPage;
-	texturedPolygon.parameter6 = vertex3;
-	texturedPolygon.parameter7 = texCoord3;
-	texturedPolygon.parameter8 = vertex4;
-	texturedPolygon.parameter9 = texCoord4;
-	texturedPolygon.statusRegister = gpu->statusRegister;
-	texturedPolygon.drawingOffset = gpu->drawingOffset;
-	texturedPolygon.drawingAreaTopLeft = gpu->drawingAreaTopLeft;
-	texturedPolygon.drawingAreaBottomRight = gpu->drawingAreaBottomRight;
-	texturedPolygon.textureWindow = gpu->textureWindow;
-	WorkQueue_addItem(gpu->wq, &texturedPolygon, false);
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_POLYGON, 1);
+
+	// Nothing to draw if this frame is being skipped
+	if (gpu->frameSkipped)
+		return;
+
+	// Perform draw on GL thread, leaving out the fourth vertex for three
+	// point polygons
+	int32_t parameters[] = {command, vertex1, texCoord1AndPalette, vertex2,
+			texCoord2AndTexPage, vertex3, texCoord3, vertex4, texCoord4};
+	GPU_queueCommand(gpu, &GPU_texturedPolygon_implementation, parameters,
+			(command & 0x08000000) ? 9 : 7, false);
 }
 
 /*
@@ -4675,9 +6616,14 @@ static void GPU_texturedPolygon(GPU *gpu, int32_t command, int32_t vertex1,
  */
 static void GPU_texturedPolygon_implementation(GpuCommand *command)
 {
-	// Get GL function pointers and GPU objects
+	// Get GPU object
 	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_drawPolygon(gpu->softRenderer, command);
+		return;
+	}
 
 	// Extract command byte
 	int32_t commandByte = logical_rshift(command->parameter1, 24) & 0xFF;
@@ -4832,162 +6778,43 @@ static void GPU_texturedPolygon_implementation(GpuCommand *command)
 	// Set transparency mode
 	int32_t semiTransparencyMode = logical_rshift(texPage, 5) & 0x3;
 
-	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glFramebufferTexture2D called");
-	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glBindImageTexture called");
-
-	// Bind to empty framebuffer, setting viewport correctly
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glViewport(0, 0, 1024, 512);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glViewport called");
-
-	// Set uniforms and render first triangle to vram texture
-	gl->glUseProgram(gpu->texturedPolygonProgram1);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUseProgram called");
-	gl->glUniform3iv(0, 1, vertex_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(1, 1, vertex_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(2, 1, texture_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform3iv(3, 1, texture_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform3iv called");
-	gl->glUniform1i(4, texBaseX);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(5, texBaseY);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(6, texColourMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(7, texWidthMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(8, texHeightMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(9, texWinOffsetX);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(10, texWinOffsetY);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(11, red);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(12, green);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(13, blue);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(14, rawTextureEnabled);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(15, dither);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(16, clut_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(17, clut_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(18, setMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(19, checkMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(20, semiTransparencyEnabled);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(21, semiTransparencyMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(22, drawTopLeftX);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(23, drawTopLeftY);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(24, drawBottomRightX);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(25, drawBottomRightY);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLES, 0, 3);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glDrawArrays called");
-	gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glMemoryBarrier called");
-
-	// Check if we need a second triangle
-	if (fourPoints == 1) {
-		gl->glUniform3iv(0, 1, vertex_x + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(1, 1, vertex_y + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(2, 1, texture_x + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glUniform3iv(3, 1, texture_y + 1);
-		GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-				"function, glUniform3iv called");
-		gl->glDrawArrays(GL_TRIANGLES, 0, 3);
-		GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-				"function, glDrawArrays called");
-		gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-		GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-				"function, glMemoryBarrier called");
+	// Find the page in the texture cache, if the polygon can use it
+	int32_t drawnArea[4];
+	GPU_getDrawnArea(drawnArea, vertex_x, vertex_y, 3 + fourPoints,
+			drawTopLeftX, drawTopLeftY, drawBottomRightX, drawBottomRightY);
+	int32_t textureCacheLayer = GPU_getTextureCacheLayer(gpu, drawnArea,
+			texBaseX, texBaseY, texColourMode, clut_x, clut_y);
+
+	// Build vertices, splitting four-pointed polygons into two triangles
+	GpuVertex vertices[6];
+	int32_t vertexCount = 3 + fourPoints * 3;
+	for (int32_t i = 0; i < vertexCount; ++i) {
+		int32_t vertex = GPU_polygonVertexOrder[i];
+		vertices[i] = (GpuVertex){
+			.position = {vertex_x[vertex], vertex_y[vertex]},
+			.colour = {red, green, blue},
+			.texCoord = {texture_x[vertex], texture_y[vertex]},
+			.primitive1 = {texBaseX, texBaseY, texColourMode,
+					semiTransparencyMode},
+			.primitive2 = {clut_x, clut_y, rawTextureEnabled,
+					semiTransparencyEnabled},
+			.textureCacheLayer = textureCacheLayer
+		};
 	}
 
-	// Unbind texture from image unit
-	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glBindImageTexture called");
-
-	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glFramebufferTexture2D called");
-
-	// Bind to zero framebuffer
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedPolygon_implementation "
-			"function, glBindFramebuffer called");
+	// Add polygon to the current batch, noting the texture page and CLUT
+	// it reads from
+	int32_t uniforms[] = {texWidthMask, texHeightMask, texWinOffsetX,
+			texWinOffsetY, dither, setMask, checkMask, drawTopLeftX,
+			drawTopLeftY, drawBottomRightX, drawBottomRightY};
+	int32_t drawingArea[] = {drawTopLeftX, drawTopLeftY, drawBottomRightX,
+			drawBottomRightY};
+	int32_t readAreas[GPU_MAX_READ_AREAS * 4];
+	int32_t readAreaCount = GPU_getTextureReadAreas(readAreas, texBaseX,
+			texBaseY, texColourMode, clut_x, clut_y);
+	GPU_batchPolygon(gpu, gpu->texturedPolygonProgram1, uniforms, 11,
+			vertices, fourPoints, vertex_x, vertex_y, drawingArea, readAreas,
+			readAreaCount);
 }
 
 /**
@@ -4997,22 +6824,19 @@ static void GPU_texturedPolygon_implementation(GpuCommand *command)
 static void GPU_texturedRectangle(GPU *gpu, int32_t command, int32_t vertex,
 		int32_t texCoordAndPalette, int32_t widthAndHeight)
 {
-	// Perform draw on GL thread, making sure to set pointers
-	GpuCommand texturedRectangle;
-	texturedRectangle.functionPointer = &GPU_texturedRectangle_implementation;
-	texturedRectangle.gpu = gpu;
+	// Count primitive
+	PHILPSX_PERF_ADD(PHILPSX_PERF_GPU_PRIMITIVES +
+			PHILPSX_PERF_PRIMITIVE_RECTANGLE, 1);
+
+	// Nothing to draw if this frame is being skipped
+	if (gpu->frameSkipped)
+		return;
 
-	// Store parameters in object then submit it to work queue
-	texturedRectangle.parameter1 = command;
-	texturedRectangle.parameter2 = vertex;
-	texturedRectangle.parameter3 = texCoordAndPalette;
-	texturedRectangle.parameter4 = widthAndHeight;
-	texturedRectangle.statusRegister = gpu->statusRegister;
-	texturedRectangle.drawingAreaBottomRight = gpu->drawingAreaBottomRight;
-	texturedRectangle.drawingAreaTopLeft = gpu->drawingAreaTopLeft;
-	texturedRectangle.drawingOffset = gpu->drawingOffset;
-	texturedRectangle.textureWindow = gpu->textureWindow;
-	WorkQueue_addItem(gpu->wq, &texturedRectangle, false);
+	// Perform draw on GL thread
+	int32_t parameters[] = {command, vertex, texCoordAndPalette,
+			widthAndHeight};
+	GPU_queueCommand(gpu, &GPU_texturedRectangle_implementation, parameters,
+			4, false);
 }
 
 /*
@@ -5020,9 +6844,14 @@ static void GPU_texturedRectangle(GPU *gpu, int32_t command, int32_t vertex,
  */
 static void GPU_texturedRectangle_implementation(GpuCommand *command)
 {
-	// Get GL function pointers and GPU objects
+	// Get GPU object
 	GPU *gpu = command->gpu;
-	GLFunctionPointers *gl = gpu->gl;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_drawRectangle(gpu->softRenderer, command);
+		return;
+	}
 
 	// Extract command byte
 	int32_t commandByte = logical_rshift(command->parameter1, 24) & 0xFF;
@@ -5135,156 +6964,264 @@ static void GPU_texturedRectangle_implementation(GpuCommand *command)
 	// Get texture colour mode
 	int32_t texColourMode = logical_rshift(command->statusRegister, 7) & 0x3;
 
-	// Unbind vram texture from FBO so we can attach it to image unit
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, 0, 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glFramebufferTexture2D called");
-	gl->glBindImageTexture(1, gpu->vramTexture[0], 0, false, 0,
-			GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glBindImageTexture called");
-
-	// Bind to empty framebuffer, setting viewport correctly
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->emptyFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glBindFramebuffer called");
-	gl->glViewport(x, y, width, height);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glViewport called");
-
-	// Copy texture pixels in correct manner to vram texture,
-	// setting uniforms correctly
-	gl->glUseProgram(gpu->texturedRectangleProgram1);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUseProgram called");
-	gl->glUniform1i(0, x);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(1, y);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(2, height);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(3, texBaseX);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(4, texBaseY);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(5, tex_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(6, tex_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(7, texColourMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(8, texWidthMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(9, texHeightMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(10, texWinOffsetX);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(11, texWinOffsetY);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(12, red);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(13, green);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(14, blue);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(15, rawTextureEnabled);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(16, clut_x);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(17, clut_y);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(18, setMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(19, checkMask);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(20, semiTransparencyEnabled);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(21, semiTransparencyMode);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(22, drawTopLeftX);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(23, drawTopLeftY);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(24, drawBottomRightX);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glUniform1i(25, drawBottomRightY);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glUniform1i called");
-	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glDrawArrays called");
-	gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glMemoryBarrier called");
-
-	// Unbind textures from image units
-	gl->glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA8UI);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glBindImageTexture called");
+	// Find the page in the texture cache, if the rectangle can use it
+	int32_t corner_x[] = {x, x, x + width, x + width};
+	int32_t corner_y[] = {y, y + height, y, y + height};
+	int32_t drawnArea[4];
+	GPU_getDrawnArea(drawnArea, corner_x, corner_y, 4, drawTopLeftX,
+			drawTopLeftY, drawBottomRightX, drawBottomRightY);
+	int32_t textureCacheLayer = GPU_getTextureCacheLayer(gpu, drawnArea,
+			texBaseX, texBaseY, texColourMode, clut_x, clut_y);
+
+	// Build vertices from the rectangle corners, as two triangles
+	GpuVertex vertices[6];
+	for (int32_t i = 0; i < 6; ++i) {
+		int32_t corner = GPU_polygonVertexOrder[i];
+		vertices[i] = (GpuVertex){
+			.position = {corner_x[corner], corner_y[corner]},
+			.colour = {red, green, blue},
+			.texCoord = {tex_x, tex_y},
+			.primitive1 = {x, y, height, semiTransparencyEnabled},
+			.primitive2 = {clut_x, clut_y, rawTextureEnabled},
+			.textureCacheLayer = textureCacheLayer
+		};
+	}
 
-	// Rebind vram texture to FBO
-	gl->glActiveTexture(GL_TEXTURE0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glActiveTexture called");
-	gl->glBindFramebuffer(GL_FRAMEBUFFER, gpu->vramFramebuffer[0]);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glBindFramebuffer called");
-	gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-			GL_TEXTURE_2D, gpu->vramTexture[0], 0);
-	GPU_checkOpenGLErrors(gpu, "GPU_texturedRectangle_implementation "
-			"function, glFramebufferTexture2D called");
+	// Add rectangle to the current batch, noting the texture page and CLUT
+	// it reads from
+	int32_t uniforms[] = {texBaseX, texBaseY, texColourMode, texWidthMask,
+			texHeightMask, texWinOffsetX, texWinOffsetY, setMask, checkMask,
+			semiTransparencyMode, drawTopLeftX, drawTopLeftY,
+			drawBottomRightX, drawBottomRightY};
+	int32_t readAreas[GPU_MAX_READ_AREAS * 4];
+	int32_t readAreaCount = GPU_getTextureReadAreas(readAreas, texBaseX,
+			texBaseY, texColourMode, clut_x, clut_y);
+	GPU_batchPrimitive(gpu, gpu->texturedRectangleProgram1, GL_TRIANGLES,
+			uniforms, 14, vertices, 6, drawnArea, readAreas, readAreaCount);
 }
 
 /*
- * This function triggers a vblank interrupt, also updating the screen.
+ * This function triggers a vblank interrupt, also updating the screen,
+ * latching the host's input into the pads for the next frame and starting
+ * write-back of the frame's memory card writes.
  */
 static void GPU_triggerVblankInterrupt(GPU *gpu)
 {
 	// Trigger the interrupt
 	SystemInterlink_setGPUInterruptDelay(gpu->system, 0);
 
-	// Update screen
-	GPU_displayScreen(gpu);
+	// Latch input and start write-back
+	ControllerIO *cio = SystemInterlink_getControllerIO(gpu->system);
+	if (cio) {
+		ControllerIO_latchInput(cio);
+		ControllerIO_startWriteBack(cio);
+	}
+
+	// Mark end of frame in the trace being captured, or start a requested
+	// one if GP0 is between commands
+	if (gpu->trace)
+		GPU_recordTrace(gpu, PHILPSX_GPUTRACE_FRAME, 0);
+	else if (gpu->tracePath && GPU_isGP0Idle(gpu))
+		GPU_beginTrace(gpu);
+
+	// Count frame, and decide whether the next one should be skipped
+	++gpu->frameCount;
+	bool frameSkipped = gpu->frameSkipped;
+	GPU_paceFrame(gpu);
+
+	// Update screen unless presentation is turned off, or the frame just
+	// finished wasn't drawn
+	if (gpu->presentationEnabled && !frameSkipped)
+		GPU_displayScreen(gpu);
+}
+
+/*
+ * This function waits for the GPU to finish with the current staging slot,
+ * by queuing a wait on the rendering thread.
+ */
+static void GPU_waitForUploadSlot(GPU *gpu)
+{
+	// Release the slot on GL thread, waiting for it to finish executing
+	int32_t parameters[] = {gpu->uploadSlot};
+	GPU_queueCommand(gpu, &GPU_waitForUploadSlot_implementation, parameters,
+			1, true);
+}
+
+/*
+ * This function contains the implementation of GPU_waitForUploadSlot.
+ */
+static void GPU_waitForUploadSlot_implementation(GpuCommand *command)
+{
+	// Get GL function pointers and GPU objects
+	GPU *gpu = command->gpu;
+	GLFunctionPointers *gl = gpu->gl;
+
+	// Wait for the slot's upload to finish, then release it
+	int32_t slot = command->parameter1;
+	GLsync fence = gpu->uploadBufferFences[slot];
+	if (fence) {
+		int64_t traceStart = PHILPSX_TRACE_BEGIN();
+		while (gl->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+				1000000000) == GL_TIMEOUT_EXPIRED);
+		PHILPSX_TRACE_END(PHILPSX_TRACE_MEMORY_BARRIER, traceStart,
+				PHILPSX_TRACE_NO_ARGUMENT);
+		gl->glDeleteSync(fence);
+		gpu->uploadBufferFences[slot] = NULL;
+	}
+	atomic_store(&gpu->uploadSlotBusy[slot], false);
+}
+
+/*
+ * This function collects the result of the last GP0(0xC0) read by queuing a
+ * wait on the rendering thread.
+ */
+static void GPU_waitForVramRead(GPU *gpu)
+{
+	// Collect the copy on GL thread, waiting for it to finish executing
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	GPU_queueCommand(gpu, &GPU_waitForVramRead_implementation, NULL, 0,
+			true);
+	PHILPSX_TRACE_END(PHILPSX_TRACE_VRAM_READ_WAIT, traceStart,
+			PHILPSX_TRACE_NO_ARGUMENT);
+}
+
+/*
+ * This function contains the implementation of GPU_waitForVramRead.
+ */
+static void GPU_waitForVramRead_implementation(GpuCommand *command)
+{
+	// Get GL function pointers and GPU objects
+	GPU *gpu = command->gpu;
+	GLFunctionPointers *gl = gpu->gl;
+
+	// Wait for the pending read to land in the vram read buffer
+	if (gpu->vramReadFence) {
+		int64_t traceStart = PHILPSX_TRACE_BEGIN();
+		while (gl->glClientWaitSync(gpu->vramReadFence,
+				GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) ==
+				GL_TIMEOUT_EXPIRED);
+		PHILPSX_TRACE_END(PHILPSX_TRACE_MEMORY_BARRIER, traceStart,
+				PHILPSX_TRACE_NO_ARGUMENT);
+		gl->glDeleteSync(gpu->vramReadFence);
+		gpu->vramReadFence = NULL;
+	}
+
+	// Copy pixels into byte buffer, utilising dmaBufferMutex to ensure mutual
+	// exclusion - pixels outside vram were never read, so leave them as is
+	pthread_mutex_lock(&gpu->dmaBufferMutex);
+	for (int32_t row = gpu->vramReadFirstRow; row < gpu->vramReadHeight;
+			++row) {
+		int32_t offset = row * gpu->vramReadWidth * 4;
+		memcpy(gpu->dmaBuffer + offset, gpu->vramReadBufferData + offset,
+				gpu->vramReadClippedWidth * 4);
+	}
+	pthread_mutex_unlock(&gpu->dmaBufferMutex);
+}
+
+/*
+ * This function handles word writes to the GPU registers, which submit a
+ * command to GP0 or GP1.
+ */
+static void GPU_writeRegisterWord(void *component, int32_t address,
+		int32_t value)
+{
+	GPU *gpu = component;
+
+	if ((address & 0xFFFFFFFC) == 0x1F801810)
+		GPU_submitToGP0(gpu, value);
+	else
+		GPU_submitToGP1(gpu, value);
+}
+
+/*
+ * This function uploads lineCount lines of vram, starting from firstLine
+ * (top row first), from the same lines of vram, which is 1024x512
+ * little-endian 16-bit pixels, with one call. It converts them in the DMA
+ * buffer, so the caller must hold dmaBufferMutex.
+ */
+static void GPU_writeVramBand(GPU *gpu, const int8_t *vram,
+		int32_t firstLine, int32_t lineCount)
+{
+	// Record that the band has changed
+	int32_t area[] = {0, 512 - firstLine - lineCount, 1023, 511 - firstLine};
+	GPU_markVramWritten(gpu, area);
+
+	// Convert pixels, bottom row first to match the OpenGL coordinate system
+	for (int32_t y = 0; y < lineCount; ++y) {
+		const int8_t *source = vram + (firstLine + y) * 1024 * 2;
+		int8_t *row = gpu->dmaBuffer + (lineCount - 1 - y) * 1024 * 4;
+		for (int32_t x = 0; x < 1024; ++x) {
+			int32_t value = read_le_halfword(source + x * 2);
+			int8_t *pixel = row + x * 4;
+			pixel[0] = (int8_t)(value & 0x1F);
+			pixel[1] = (int8_t)((value >> 5) & 0x1F);
+			pixel[2] = (int8_t)((value >> 10) & 0x1F);
+			pixel[3] = (int8_t)((value >> 15) & 0x1);
+		}
+	}
+
+	// Upload the band to the vram texture
+	gpu->gl->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, area[1], 1024, lineCount,
+			GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, gpu->dmaBuffer);
+	GPU_checkOpenGLErrors(gpu, "GPU_writeVramBand function, "
+			"glTexSubImage2D called");
 }
 
 /*
- * This function lets us write to the DMA buffer in a thread-safe way.
+ * This function contains the implementation of the vram upload for
+ * GPU_loadState, which converts the save state's vram and replaces vram with
+ * it, dropping everything decoded from the old contents. Only rows of tiles
+ * that have been written since the copy of vram was taken, or that differ
+ * from it, are uploaded, with neighbouring rows uploaded together.
  */
-static void GPU_writeDMABuffer(GPU *gpu, int32_t index, int8_t value)
+static void GPU_writeVramState_implementation(GpuCommand *command)
 {
+	// Get GPU object
+	GPU *gpu = command->gpu;
+
+	// Hand over to the software renderer if it is in use
+	if (gpu->softRenderer) {
+		SoftRenderer_writeVram(gpu->softRenderer, gpu->stateVram);
+		return;
+	}
+
+	// Draw any batched primitives, as this touches vram directly
+	GPU_endDrawingPass(gpu);
+
+	// Upload each band that changes, utilising dmaBufferMutex to ensure
+	// mutual exclusion
+	bool haveCopy = GPU_setupStateVramCopy(gpu);
+	const int32_t bandSize = 1024 * 2 * PHILPSX_VRAMDIRTYMAP_TILE_SIZE;
 	pthread_mutex_lock(&gpu->dmaBufferMutex);
-	gpu->dmaBuffer[index] = value;
+	GLStateCache_activeTexture(gpu->glState, GL_TEXTURE0);
+	GPU_checkOpenGLErrors(gpu, "GPU_writeVramState_implementation function, "
+			"glActiveTexture called");
+	for (int32_t row = 0; row < PHILPSX_VRAMDIRTYMAP_ROWS;) {
+		if (haveCopy && VramDirtyMap_getTileRow(gpu->vramDirtyMap,
+				gpu->stateDirtyClient, row) == 0 &&
+				memcmp(gpu->stateVram + row * bandSize,
+				gpu->stateVramCopy + row * bandSize, bandSize) == 0) {
+			++row;
+			continue;
+		}
+		int32_t firstRow = row;
+		while (row < PHILPSX_VRAMDIRTYMAP_ROWS && (!haveCopy ||
+				VramDirtyMap_getTileRow(gpu->vramDirtyMap,
+				gpu->stateDirtyClient, row) != 0 ||
+				memcmp(gpu->stateVram + row * bandSize,
+				gpu->stateVramCopy + row * bandSize, bandSize) != 0))
+			++row;
+		GPU_writeVramBand(gpu, gpu->stateVram,
+				firstRow * PHILPSX_VRAMDIRTYMAP_TILE_SIZE,
+				(row - firstRow) * PHILPSX_VRAMDIRTYMAP_TILE_SIZE);
+		if (haveCopy)
+			memcpy(gpu->stateVramCopy + firstRow * bandSize,
+					gpu->stateVram + firstRow * bandSize,
+					(row - firstRow) * bandSize);
+	}
 	pthread_mutex_unlock(&gpu->dmaBufferMutex);
+
+	// Copy now matches vram, including where we have just written it
+	if (haveCopy)
+		VramDirtyMap_clearAll(gpu->vramDirtyMap, gpu->stateDirtyClient);
 }
\ No newline at end of file
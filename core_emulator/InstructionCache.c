@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include "../headers/InstructionCache_all.h"
 #include "../headers/Cop0_public.h"
+#include "../headers/endian_utils.h"
 #include "../headers/math_utils.h"
 
 /*
@@ -19,39 +20,21 @@
 InstructionCache *construct_InstructionCache(InstructionCache *cache)
 {
 	// Setup cache arrays
-	cache->cacheData = calloc(4096, sizeof(int8_t));
-	if (!cache->cacheData) {
+	const size_t regionSizes[] = {
+		PHILPSX_ICACHE_LINE_COUNT * PHILPSX_ICACHE_LINE_WORDS *
+				sizeof(int32_t),
+		PHILPSX_ICACHE_LINE_COUNT * sizeof(uint32_t)
+	};
+	cache->memory = construct_GuestMemory(regionSizes, 2);
+	if (!cache->memory) {
 		fprintf(stderr, "PhilPSX: R3051: InstructionCache: Couldn't allocate "
-				"memory for cacheData array\n");
-		goto end;
+				"memory for cacheData and cacheTag arrays\n");
+		return NULL;
 	}
+	cache->cacheData = GuestMemory_getRegion(cache->memory, 0);
+	cache->cacheTag = GuestMemory_getRegion(cache->memory, 1);
 
-	cache->cacheTag = calloc(256, sizeof(int32_t));
-	if (!cache->cacheTag) {
-		fprintf(stderr, "PhilPSX: R3051: InstructionCache: Couldn't allocate "
-				"memory for cacheTag array\n");
-		goto cleanup_cachedata;
-	}
-
-	cache->cacheValid = calloc(256, sizeof(bool));
-	if (!cache->cacheValid) {
-		fprintf(stderr, "PhilPSX: R3051: InstructionCache: Couldn't allocate "
-				"memory for cacheValid array\n");
-		goto cleanup_cachetag;
-	}
-
-	// Normal return:
 	return cache;
-
-	// Cleanup path:
-	cleanup_cachetag:
-	free(cache->cacheTag);
-	
-	cleanup_cachedata:
-	free(cache->cacheData);
-	
-	end:
-	return NULL;
 }
 
 /*
@@ -60,9 +43,7 @@ InstructionCache *construct_InstructionCache(InstructionCache *cache)
  */
 void destruct_InstructionCache(InstructionCache *cache)
 {
-	free(cache->cacheValid);
-	free(cache->cacheTag);
-	free(cache->cacheData);
+	destruct_GuestMemory(cache->memory);
 }
 
 /*
@@ -72,17 +53,8 @@ void destruct_InstructionCache(InstructionCache *cache)
 bool InstructionCache_checkForHit(InstructionCache *cache,
 		int32_t address)
 {
-	// Define return value
-	bool retVal = false;
-
-	int32_t tagIndex = logical_rshift(address, 4) & 0xFF;
-	int32_t expectedTag = logical_rshift(address, 12) & 0xFFFFF;
-	if (cache->cacheTag[tagIndex] ==
-			expectedTag && cache->cacheValid[tagIndex])
-		retVal = true;
-
-	// Return hit status
-	return retVal;
+	return cache->cacheTag[logical_rshift(address, 4) & 0xFF] ==
+			(((uint32_t)address & 0xFFFFF000U) | PHILPSX_ICACHE_VALID);
 }
 
 /*
@@ -91,20 +63,7 @@ bool InstructionCache_checkForHit(InstructionCache *cache,
 int32_t InstructionCache_readWord(InstructionCache *cache,
 		int32_t address)
 {
-	// Define word value
-	int32_t wordVal = 0;
-
-	int32_t dataIndex = address & 0xFFC;
-	wordVal = (cache->cacheData[dataIndex] & 0xFF) << 24;
-	++dataIndex;
-	wordVal |= (cache->cacheData[dataIndex] & 0xFF) << 16;
-	++dataIndex;
-	wordVal |= (cache->cacheData[dataIndex] & 0xFF) << 8;
-	++dataIndex;
-	wordVal |= cache->cacheData[dataIndex] & 0xFF;
-	
-	// Return word value
-	return wordVal;
+	return cache->cacheData[logical_rshift(address, 2) & 0x3FF];
 }
 
 /*
@@ -113,17 +72,11 @@ int32_t InstructionCache_readWord(InstructionCache *cache,
 int8_t InstructionCache_readByte(InstructionCache *cache,
 		int32_t address)
 {
-	// Define byte value
-	int8_t byteVal = 0;
-
-	// Get address of byte
-	int32_t dataIndex = address & 0xFFF;
+	// Get word containing byte
+	int32_t wordVal = cache->cacheData[logical_rshift(address, 2) & 0x3FF];
 
 	// Retrieve byte
-	byteVal = cache->cacheData[dataIndex];
-
-	// Return work value
-	return byteVal;
+	return (int8_t)logical_rshift(wordVal, (address & 0x3) * 8);
 }
 
 /*
@@ -133,22 +86,12 @@ void InstructionCache_writeWord(InstructionCache *cache, Cop0 *sccp,
 		int32_t address, int32_t value)
 {
 	// Update correct word
-	int32_t dataIndex = address & 0xFFC;
-	cache->cacheData[dataIndex] = (int8_t)logical_rshift(value, 24);
-	++dataIndex;
-	cache->cacheData[dataIndex] = (int8_t)logical_rshift(value, 16);
-	++dataIndex;
-	cache->cacheData[dataIndex] = (int8_t)logical_rshift(value, 8);
-	++dataIndex;
-	cache->cacheData[dataIndex] = (int8_t)value;
+	cache->cacheData[logical_rshift(address, 2) & 0x3FF] = value;
 
 	// Invalidate line if cache is isolated
-	if (Cop0_isDataCacheIsolated(sccp)) {
-		int32_t tagIndex = logical_rshift(address, 4) & 0xFF;
-		int32_t tag = logical_rshift(address, 12) & 0xFFFFF;
-		cache->cacheTag[tagIndex] = tag;
-		cache->cacheValid[tagIndex] = false;
-	}
+	if (Cop0_isDataCacheIsolated(sccp))
+		cache->cacheTag[logical_rshift(address, 4) & 0xFF] =
+				(uint32_t)address & 0xFFFFF000U;
 }
 
 /*
@@ -158,46 +101,40 @@ void InstructionCache_writeWord(InstructionCache *cache, Cop0 *sccp,
 void InstructionCache_writeByte(InstructionCache *cache, Cop0 *sccp,
 		int32_t address, int8_t value)
 {
-	// Update correct byte
-	int32_t dataIndex = address & 0xFFF;
-
-	// Write byte and invalidate cache line
-	cache->cacheData[dataIndex] = value;
+	// Merge byte into correct word
+	int32_t dataIndex = logical_rshift(address, 2) & 0x3FF;
+	int32_t shift = (address & 0x3) * 8;
+	cache->cacheData[dataIndex] = (cache->cacheData[dataIndex] &
+			~(0xFF << shift)) | ((value & 0xFF) << shift);
 
 	// Invalidate line if cache is isolated
-	if (Cop0_isDataCacheIsolated(sccp)) {
-		int32_t tagIndex = logical_rshift(address, 4) & 0xFF;
-		int32_t tag = logical_rshift(address, 12) & 0xFFFFF;
-		cache->cacheTag[tagIndex] = tag;
-		cache->cacheValid[tagIndex] = false;
-	}
+	if (Cop0_isDataCacheIsolated(sccp))
+		cache->cacheTag[logical_rshift(address, 4) & 0xFF] =
+				(uint32_t)address & 0xFFFFF000U;
 }
 
 /*
- * This function refills a cache line using an address.
+ * This function refills a cache line using an address. If the line is held
+ * in host memory, lineData should point to the start of it so it can be
+ * copied directly, otherwise it should be NULL.
  */
 void InstructionCache_refillLine(InstructionCache *cache, Cop0 *sccp,
-		SystemInterlink *system, int32_t address)
+		SystemInterlink *system, int32_t address, const int8_t *lineData)
 {
 	// Refill a line - four words
 	// Check if cache is isolated first
 	if (Cop0_isDataCacheIsolated(sccp))
 		return;
 
-	// Calculate tag index and tag
-	int32_t tagIndex = logical_rshift(address, 4) & 0xFF;
-	int32_t tag = logical_rshift(address, 12) & 0xFFFFF;
-
 	// Write tag and valid flag
-	cache->cacheTag[tagIndex] = tag;
-	cache->cacheValid[tagIndex] = true;
+	cache->cacheTag[logical_rshift(address, 4) & 0xFF] =
+			((uint32_t)address & 0xFFFFF000U) | PHILPSX_ICACHE_VALID;
 
 	// Refill cache line
-	int64_t startingAddress = address & 0xFFFFFFF0L;
-	for (int32_t i = 0; i < 16; ++i) {
-		cache->cacheData[(int32_t)(startingAddress & 0xFFF)] =
-				SystemInterlink_readByte(system,
-				(int32_t)startingAddress);
-		++startingAddress;
+	int32_t *line = &cache->cacheData[logical_rshift(address, 2) & 0x3FC];
+	int32_t startingAddress = address & 0xFFFFFFF0;
+	for (int32_t i = 0; i < PHILPSX_ICACHE_LINE_WORDS; ++i) {
+		line[i] = lineData ? read_le_word(lineData + i * 4) :
+				SystemInterlink_readWord(system, startingAddress + i * 4);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,981 @@
+/*
+ * This C file models the MDEC (motion decoder) of the PlayStation as a class.
+ * Commands and their parameters arrive through the command register, usually
+ * by DMA, and the decoded pixels are read back through the data register.
+ *
+ * Compressed macroblocks are run-length decoded and dequantised into 8x8
+ * blocks of coefficients, put through an inverse DCT (with SSE2, AVX2 or NEON
+ * where they are available), then converted from YUV to 15-bit or 24-bit RGB,
+ * or to 4-bit or 8-bit greyscale. All the data for a decode command is
+ * gathered before any of it is decoded - at that point the start of each
+ * macroblock is found in one quick pass, and the macroblocks are then shared
+ * out between a pool of worker threads, with the emulator thread decoding
+ * the first share itself. As each macroblock has its own place in the output
+ * buffer, no two threads ever write to the same part of it.
+ *
+ * It is assumed due to use case that non-init pthread functions will not fail,
+ * and therefore errors are not checked with these function calls, to simplify
+ * the code and make it more readable.
+ *
+ * MDEC.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "../headers/MDEC.h"
+#include "../headers/SaveState.h"
+#include "../headers/SystemInterlink.h"
+#include "../headers/endian_utils.h"
+#include "../headers/math_utils.h"
+
+// Limit for the worker pool, and the fewest macroblocks worth sharing out
+// between it
+#define PHILPSX_MDEC_MAX_THREADS 8
+#define PHILPSX_MDEC_MIN_SHARED_MACROBLOCKS 16
+
+// Size of the parameter buffer in halfwords (the most a command can take),
+// and the most macroblocks it can hold (a greyscale one can be as small as
+// two halfwords)
+#define PHILPSX_MDEC_INPUT_SIZE 0x20000
+#define PHILPSX_MDEC_MAX_MACROBLOCKS (PHILPSX_MDEC_INPUT_SIZE / 2)
+
+// Size of the output buffer in bytes - the largest output comes from
+// 24-bit macroblocks, which take at least twelve halfwords each
+#define PHILPSX_MDEC_OUTPUT_SIZE ((PHILPSX_MDEC_INPUT_SIZE / 12 + 1) * 768)
+
+// Commands
+#define PHILPSX_MDEC_DECODE 1
+#define PHILPSX_MDEC_SET_QUANT_TABLES 2
+#define PHILPSX_MDEC_SET_SCALE_TABLE 3
+
+// Output depths
+#define PHILPSX_MDEC_DEPTH_4BIT 0
+#define PHILPSX_MDEC_DEPTH_8BIT 1
+#define PHILPSX_MDEC_DEPTH_24BIT 2
+#define PHILPSX_MDEC_DEPTH_15BIT 3
+
+// End of block code, which also pads the data between macroblocks
+#define PHILPSX_MDEC_END_OF_BLOCK 0xFE00
+
+// Forward declarations for functions and subcomponents private to this class
+// MDEC-related stuff:
+typedef struct MDECWorker MDECWorker;
+static int32_t MDEC_clamp(int32_t value, int32_t minimum, int32_t maximum);
+static void MDEC_decodeBlock(const uint16_t *input, int32_t *position,
+		const uint8_t *quantTable, int16_t *block);
+static void MDEC_decodeCommand(MDEC *mdec);
+static void MDEC_decodeMacroblock(MDEC *mdec, int32_t index);
+static void MDEC_decodeShare(MDEC *mdec, int32_t index);
+static void MDEC_executeCommand(MDEC *mdec);
+static int32_t MDEC_findBlockEnd(const uint16_t *input, int32_t position,
+		int32_t count);
+static void MDEC_idct(const int16_t *scaleTable, const int16_t *scalePairs,
+		int16_t *block);
+static void MDEC_idctPass(const int16_t *scaleTable,
+		const int16_t *scalePairs, const int16_t *source,
+		int16_t *destination);
+static void MDEC_outputGreyscale(MDEC *mdec, const int16_t *block,
+		int8_t *output);
+static void MDEC_outputRgb(MDEC *mdec, const int16_t *blocks,
+		int8_t *output);
+static int32_t MDEC_readRegisterHalfWord(void *component, int32_t address);
+static int32_t MDEC_readRegisterWord(void *component, int32_t address);
+static int32_t MDEC_readStatus(MDEC *mdec);
+static void MDEC_reset(MDEC *mdec);
+static int32_t MDEC_signExtend(int32_t code);
+static void MDEC_stopWorkers(MDEC *mdec, int32_t threadCount);
+static void *MDEC_workerFunction(void *arg);
+static void MDEC_writeRegisterWord(void *component, int32_t address,
+		int32_t value);
+
+/*
+ * This struct holds what each worker thread needs to know about itself.
+ */
+struct MDECWorker {
+	MDEC *mdec;
+	pthread_t thread;
+	int32_t index;
+};
+
+/*
+ * This struct models the MDEC's tables, the command being received and the
+ * output waiting to be read, along with the worker pool.
+ */
+struct MDEC {
+
+	// System reference
+	SystemInterlink *system;
+
+	// Quantisation tables for luminance and colour, in zigzag order, and the
+	// scale table for the inverse DCT (already divided by 8), along with the
+	// same table with its rows interleaved in pairs for the SIMD paths
+	uint8_t luminanceTable[64];
+	uint8_t colourTable[64];
+	int16_t scaleTable[64];
+	int16_t scalePairs[64];
+
+	// Current command, the number of parameter words it is still waiting
+	// for, and the parameters received so far (as halfwords)
+	int32_t command;
+	int32_t wordsRemaining;
+	uint16_t *input;
+	int32_t inputCount;
+
+	// Whether data in and data out requests are enabled for DMA
+	bool dataInEnabled;
+	bool dataOutEnabled;
+
+	// Start of each macroblock of the current decode command in the input
+	int32_t *macroblockStarts;
+	int32_t macroblockCount;
+
+	// Decoded output, and how far through it has been read
+	int8_t *output;
+	int32_t outputSize;
+	int32_t outputPosition;
+
+	// Worker pool - the emulator thread counts as the first thread, so
+	// threadCount is one more than the number of workers
+	MDECWorker *workers;
+	int32_t threadCount;
+	pthread_mutex_t workMutex;
+	pthread_cond_t workCondition;
+	pthread_cond_t doneCondition;
+	int64_t batchNumber;
+	int32_t workersRunning;
+	bool quit;
+};
+
+// Raster position of each coefficient, indexed by its position in zigzag
+// order
+static const uint8_t MDEC_zigzagToRaster[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10,
+	17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/*
+ * This constructs an MDEC object in its reset state, and starts its worker
+ * threads.
+ */
+MDEC *construct_MDEC(void)
+{
+	// Allocate memory for struct
+	MDEC *mdec = calloc(1, sizeof(MDEC));
+	if (!mdec) {
+		fprintf(stderr, "PhilPSX: MDEC: Couldn't allocate memory for "
+				"MDEC struct\n");
+		goto end;
+	}
+
+	// Allocate parameter, macroblock and output buffers
+	mdec->input = malloc(PHILPSX_MDEC_INPUT_SIZE * sizeof(uint16_t));
+	if (!mdec->input) {
+		fprintf(stderr, "PhilPSX: MDEC: Couldn't allocate memory for "
+				"parameter buffer\n");
+		goto cleanup_mdec;
+	}
+	mdec->macroblockStarts =
+			malloc(PHILPSX_MDEC_MAX_MACROBLOCKS * sizeof(int32_t));
+	if (!mdec->macroblockStarts) {
+		fprintf(stderr, "PhilPSX: MDEC: Couldn't allocate memory for "
+				"macroblock list\n");
+		goto cleanup_input;
+	}
+	mdec->output = malloc(PHILPSX_MDEC_OUTPUT_SIZE);
+	if (!mdec->output) {
+		fprintf(stderr, "PhilPSX: MDEC: Couldn't allocate memory for "
+				"output buffer\n");
+		goto cleanup_macroblockstarts;
+	}
+
+	// Setup worker synchronisation
+	if (pthread_mutex_init(&mdec->workMutex, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: MDEC: Couldn't create work mutex\n");
+		goto cleanup_output;
+	}
+	if (pthread_cond_init(&mdec->workCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: MDEC: Couldn't create work condition "
+				"variable\n");
+		goto cleanup_workmutex;
+	}
+	if (pthread_cond_init(&mdec->doneCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: MDEC: Couldn't create done condition "
+				"variable\n");
+		goto cleanup_workcondition;
+	}
+
+	// Use a thread per processor, leaving one for the emulator thread
+	int32_t threadCount = (int32_t)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	threadCount = max_value(threadCount, 1);
+	threadCount = min_value(threadCount, PHILPSX_MDEC_MAX_THREADS);
+	mdec->threadCount = threadCount;
+
+	// Start workers - the first entry stands for the emulator thread
+	mdec->workers = calloc(threadCount, sizeof(MDECWorker));
+	if (!mdec->workers) {
+		fprintf(stderr, "PhilPSX: MDEC: Couldn't allocate memory for "
+				"workers\n");
+		goto cleanup_donecondition;
+	}
+	for (int32_t i = 1; i < threadCount; ++i) {
+		mdec->workers[i].mdec = mdec;
+		mdec->workers[i].index = i;
+		if (pthread_create(&mdec->workers[i].thread, NULL,
+				&MDEC_workerFunction, &mdec->workers[i]) != 0) {
+			fprintf(stderr, "PhilPSX: MDEC: Couldn't start worker "
+					"thread\n");
+			MDEC_stopWorkers(mdec, i);
+			goto cleanup_workers;
+		}
+	}
+
+	// Set reset state
+	MDEC_reset(mdec);
+
+	// Normal return:
+	return mdec;
+
+	// Cleanup path:
+	cleanup_workers:
+	free(mdec->workers);
+
+	cleanup_donecondition:
+	pthread_cond_destroy(&mdec->doneCondition);
+
+	cleanup_workcondition:
+	pthread_cond_destroy(&mdec->workCondition);
+
+	cleanup_workmutex:
+	pthread_mutex_destroy(&mdec->workMutex);
+
+	cleanup_output:
+	free(mdec->output);
+
+	cleanup_macroblockstarts:
+	free(mdec->macroblockStarts);
+
+	cleanup_input:
+	free(mdec->input);
+
+	cleanup_mdec:
+	free(mdec);
+	mdec = NULL;
+
+	end:
+	return mdec;
+}
+
+/*
+ * This destructs an MDEC object, stopping its worker threads.
+ */
+void destruct_MDEC(MDEC *mdec)
+{
+	MDEC_stopWorkers(mdec, mdec->threadCount);
+	free(mdec->workers);
+	pthread_cond_destroy(&mdec->doneCondition);
+	pthread_cond_destroy(&mdec->workCondition);
+	pthread_mutex_destroy(&mdec->workMutex);
+	free(mdec->output);
+	free(mdec->macroblockStarts);
+	free(mdec->input);
+	free(mdec);
+}
+
+/*
+ * This function tells us whether there is decoded output waiting to be read,
+ * so that an MDECout DMA request can be held back until there is.
+ */
+bool MDEC_hasOutput(MDEC *mdec)
+{
+	return mdec->outputPosition < mdec->outputSize;
+}
+
+/*
+ * This function reads the MDEC's state back from a save state, in the order
+ * MDEC_saveState wrote it.
+ */
+void MDEC_loadState(MDEC *mdec, SaveState *state)
+{
+	// Tables
+	SaveState_read(state, mdec->luminanceTable, sizeof(mdec->luminanceTable));
+	SaveState_read(state, mdec->colourTable, sizeof(mdec->colourTable));
+	SaveState_read(state, mdec->scaleTable, sizeof(mdec->scaleTable));
+	SaveState_read(state, mdec->scalePairs, sizeof(mdec->scalePairs));
+
+	// Current command and its parameters, checking they fit
+	SaveState_read(state, &mdec->command, sizeof(int32_t));
+	SaveState_read(state, &mdec->wordsRemaining, sizeof(int32_t));
+	SaveState_read(state, &mdec->inputCount, sizeof(int32_t));
+	if (mdec->wordsRemaining < 0 || mdec->inputCount < 0 ||
+			mdec->inputCount + mdec->wordsRemaining * 2 >
+			PHILPSX_MDEC_INPUT_SIZE) {
+		SaveState_fail(state);
+		MDEC_reset(mdec);
+		return;
+	}
+	SaveState_read(state, mdec->input, mdec->inputCount * sizeof(uint16_t));
+
+	// DMA enables
+	SaveState_read(state, &mdec->dataInEnabled, sizeof(bool));
+	SaveState_read(state, &mdec->dataOutEnabled, sizeof(bool));
+
+	// Output not yet read, which starts the output buffer again
+	int32_t outputLeft = 0;
+	SaveState_read(state, &outputLeft, sizeof(int32_t));
+	if (outputLeft < 0 || outputLeft > PHILPSX_MDEC_OUTPUT_SIZE) {
+		SaveState_fail(state);
+		MDEC_reset(mdec);
+		return;
+	}
+	SaveState_read(state, mdec->output, outputLeft);
+	mdec->outputSize = outputLeft;
+	mdec->outputPosition = 0;
+}
+
+/*
+ * This function copies the specified number of words of decoded output to
+ * data, for DMA. Reading past the end of the output gives zeroes.
+ */
+void MDEC_readBlock(MDEC *mdec, int8_t *data, int32_t wordCount)
+{
+	int32_t length = min_value(wordCount * 4,
+			mdec->outputSize - mdec->outputPosition);
+	memcpy(data, &mdec->output[mdec->outputPosition], length);
+	memset(data + length, 0, wordCount * 4 - length);
+	mdec->outputPosition += length;
+}
+
+/*
+ * This function reads a word from the MDEC registers - the data register
+ * gives the next word of output, and the control register gives the status.
+ */
+int32_t MDEC_readWord(MDEC *mdec, int32_t address)
+{
+	if ((address & 0xFFFFFFFC) == 0x1F801820) {
+		int8_t word[4];
+		MDEC_readBlock(mdec, word, 1);
+		return read_le_word(word);
+	}
+
+	return MDEC_readStatus(mdec);
+}
+
+/*
+ * This function writes the MDEC's state to a save state - its tables, the
+ * command being received and the output not yet read. Decoding is finished
+ * before the command that started it returns, so nothing else is in flight.
+ */
+void MDEC_saveState(MDEC *mdec, SaveState *state)
+{
+	// Tables
+	SaveState_write(state, mdec->luminanceTable,
+			sizeof(mdec->luminanceTable));
+	SaveState_write(state, mdec->colourTable, sizeof(mdec->colourTable));
+	SaveState_write(state, mdec->scaleTable, sizeof(mdec->scaleTable));
+	SaveState_write(state, mdec->scalePairs, sizeof(mdec->scalePairs));
+
+	// Current command and its parameters
+	SaveState_write(state, &mdec->command, sizeof(int32_t));
+	SaveState_write(state, &mdec->wordsRemaining, sizeof(int32_t));
+	SaveState_write(state, &mdec->inputCount, sizeof(int32_t));
+	SaveState_write(state, mdec->input, mdec->inputCount * sizeof(uint16_t));
+
+	// DMA enables
+	SaveState_write(state, &mdec->dataInEnabled, sizeof(bool));
+	SaveState_write(state, &mdec->dataOutEnabled, sizeof(bool));
+
+	// Output not yet read
+	int32_t outputLeft = mdec->outputSize - mdec->outputPosition;
+	SaveState_write(state, &outputLeft, sizeof(int32_t));
+	SaveState_write(state, mdec->output + mdec->outputPosition, outputLeft);
+}
+
+/*
+ * This function sets the system reference to that of the supplied argument.
+ */
+void MDEC_setMemoryInterface(MDEC *mdec, SystemInterlink *smi)
+{
+	mdec->system = smi;
+
+	// Install handlers for the command/data and control/status registers,
+	// which ignore writes narrower than a word
+	SystemInterlink_registerIoHandlers(smi, 0x1F801820, 0x8,
+			PHILPSX_IO_HALFWORD, mdec, MDEC_readRegisterHalfWord, NULL);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801820, 0x8,
+			PHILPSX_IO_WORD, mdec, MDEC_readRegisterWord,
+			MDEC_writeRegisterWord);
+}
+
+/*
+ * This function feeds the specified number of words from data to the command
+ * register, for DMA.
+ */
+void MDEC_writeBlock(MDEC *mdec, const int8_t *data, int32_t wordCount)
+{
+	for (int32_t i = 0; i < wordCount; ++i)
+		MDEC_writeWord(mdec, 0x1F801820, read_le_word(data + i * 4));
+}
+
+/*
+ * This function writes a word to the MDEC registers - the command register
+ * takes commands and their parameters, and the control register resets the
+ * MDEC and enables DMA requests.
+ */
+void MDEC_writeWord(MDEC *mdec, int32_t address, int32_t word)
+{
+	// Control register
+	if ((address & 0xFFFFFFFC) == 0x1F801824) {
+		if (word & 0x80000000)
+			MDEC_reset(mdec);
+		mdec->dataInEnabled = (word & 0x40000000) != 0;
+		mdec->dataOutEnabled = (word & 0x20000000) != 0;
+		return;
+	}
+
+	// Parameter of current command
+	if (mdec->wordsRemaining > 0) {
+		mdec->input[mdec->inputCount++] = (uint16_t)word;
+		mdec->input[mdec->inputCount++] = (uint16_t)logical_rshift(word, 16);
+		if (--mdec->wordsRemaining == 0)
+			MDEC_executeCommand(mdec);
+		return;
+	}
+
+	// New command, which replaces any output not yet read
+	mdec->command = word;
+	mdec->inputCount = 0;
+	mdec->outputSize = 0;
+	mdec->outputPosition = 0;
+	switch (logical_rshift(word, 29)) {
+		case PHILPSX_MDEC_DECODE:
+			mdec->wordsRemaining = word & 0xFFFF;
+			break;
+		case PHILPSX_MDEC_SET_QUANT_TABLES:
+			mdec->wordsRemaining = (word & 0x1) ? 32 : 16;
+			break;
+		case PHILPSX_MDEC_SET_SCALE_TABLE:
+			mdec->wordsRemaining = 32;
+			break;
+		default:
+			mdec->wordsRemaining = 0;
+			break;
+	}
+}
+
+/*
+ * This function limits a value to the specified range.
+ */
+static int32_t MDEC_clamp(int32_t value, int32_t minimum, int32_t maximum)
+{
+	return min_value(max_value(value, minimum), maximum);
+}
+
+/*
+ * This function run-length decodes and dequantises a block of coefficients
+ * into raster order, leaving position just after its end of block code. The
+ * block must already be known to be complete.
+ */
+static void MDEC_decodeBlock(const uint16_t *input, int32_t *position,
+		const uint8_t *quantTable, int16_t *block)
+{
+	memset(block, 0, 64 * sizeof(int16_t));
+
+	// Skip padding, then take the DC coefficient and quantisation scale
+	int32_t i = *position;
+	while (input[i] == PHILPSX_MDEC_END_OF_BLOCK)
+		++i;
+	int32_t code = input[i++];
+	int32_t scale = code >> 10;
+	int32_t value = MDEC_signExtend(code) * quantTable[0];
+
+	// Store each coefficient, then move on by the run of zeroes before the
+	// next one until we go past the end of the block
+	int32_t k = 0;
+	for (;;) {
+		if (scale == 0)
+			value = MDEC_signExtend(code) * 2;
+		value = MDEC_clamp(value, -0x400, 0x3FF);
+		if (scale > 0)
+			block[MDEC_zigzagToRaster[k]] = (int16_t)value;
+		else
+			block[k] = (int16_t)value;
+
+		code = input[i++];
+		k += (code >> 10) + 1;
+		if (k > 63)
+			break;
+		value = (MDEC_signExtend(code) * quantTable[k] * scale + 4) /
+				8;
+	}
+
+	*position = i;
+}
+
+/*
+ * This function finds the start of each complete macroblock of a decode
+ * command, then decodes them all, sharing them out between the worker pool
+ * when there are enough of them.
+ */
+static void MDEC_decodeCommand(MDEC *mdec)
+{
+	// Find macroblocks, leaving out an incomplete one at the end
+	int32_t depth = logical_rshift(mdec->command, 27) & 0x3;
+	bool colour = depth == PHILPSX_MDEC_DEPTH_24BIT ||
+			depth == PHILPSX_MDEC_DEPTH_15BIT;
+	int32_t blocksPerMacroblock = colour ? 6 : 1;
+	int32_t position = 0;
+	mdec->macroblockCount = 0;
+	while (mdec->macroblockCount < PHILPSX_MDEC_MAX_MACROBLOCKS) {
+		int32_t end = position;
+		for (int32_t i = 0; i < blocksPerMacroblock && end >= 0; ++i)
+			end = MDEC_findBlockEnd(mdec->input, end, mdec->inputCount);
+		if (end < 0)
+			break;
+		mdec->macroblockStarts[mdec->macroblockCount++] = position;
+		position = end;
+	}
+
+	// Size output to suit
+	static const int32_t bytesPerMacroblock[4] = { 32, 64, 768, 512 };
+	mdec->outputSize = mdec->macroblockCount * bytesPerMacroblock[depth];
+	mdec->outputPosition = 0;
+
+	// Decode everything ourselves if it isn't worth waking the workers
+	if (mdec->threadCount == 1 ||
+			mdec->macroblockCount < PHILPSX_MDEC_MIN_SHARED_MACROBLOCKS) {
+		for (int32_t i = 0; i < mdec->macroblockCount; ++i)
+			MDEC_decodeMacroblock(mdec, i);
+		return;
+	}
+
+	// Wake workers, then decode the first share ourselves
+	pthread_mutex_lock(&mdec->workMutex);
+	++mdec->batchNumber;
+	mdec->workersRunning = mdec->threadCount - 1;
+	pthread_cond_broadcast(&mdec->workCondition);
+	pthread_mutex_unlock(&mdec->workMutex);
+	MDEC_decodeShare(mdec, 0);
+
+	// Wait for workers to finish
+	pthread_mutex_lock(&mdec->workMutex);
+	while (mdec->workersRunning > 0)
+		pthread_cond_wait(&mdec->doneCondition, &mdec->workMutex);
+	pthread_mutex_unlock(&mdec->workMutex);
+}
+
+/*
+ * This function decodes one macroblock of the current decode command into
+ * its place in the output buffer.
+ */
+static void MDEC_decodeMacroblock(MDEC *mdec, int32_t index)
+{
+	int32_t depth = logical_rshift(mdec->command, 27) & 0x3;
+	int32_t position = mdec->macroblockStarts[index];
+
+	switch (depth) {
+		case PHILPSX_MDEC_DEPTH_4BIT:
+		case PHILPSX_MDEC_DEPTH_8BIT:
+		{
+			int16_t block[64];
+			MDEC_decodeBlock(mdec->input, &position, mdec->luminanceTable,
+					block);
+			MDEC_idct(mdec->scaleTable, mdec->scalePairs, block);
+			MDEC_outputGreyscale(mdec, block,
+					&mdec->output[index * (depth ? 64 : 32)]);
+		}
+		break;
+		default:
+		{
+			// Blocks arrive as Cr, Cb, then the four luminance blocks
+			int16_t blocks[6 * 64];
+			for (int32_t i = 0; i < 6; ++i) {
+				MDEC_decodeBlock(mdec->input, &position,
+						(i < 2) ? mdec->colourTable : mdec->luminanceTable,
+						&blocks[i * 64]);
+				MDEC_idct(mdec->scaleTable, mdec->scalePairs,
+						&blocks[i * 64]);
+			}
+			MDEC_outputRgb(mdec, blocks, &mdec->output[index *
+					((depth == PHILPSX_MDEC_DEPTH_24BIT) ? 768 : 512)]);
+		}
+		break;
+	}
+}
+
+/*
+ * This function decodes the specified thread's share of the macroblocks,
+ * which are split into one contiguous run per thread.
+ */
+static void MDEC_decodeShare(MDEC *mdec, int32_t index)
+{
+	int32_t first = (int32_t)((int64_t)mdec->macroblockCount * index /
+			mdec->threadCount);
+	int32_t last = (int32_t)((int64_t)mdec->macroblockCount * (index + 1) /
+			mdec->threadCount);
+	for (int32_t i = first; i < last; ++i)
+		MDEC_decodeMacroblock(mdec, i);
+}
+
+/*
+ * This function carries out the current command, now that all of its
+ * parameters have arrived.
+ */
+static void MDEC_executeCommand(MDEC *mdec)
+{
+	switch (logical_rshift(mdec->command, 29)) {
+		case PHILPSX_MDEC_DECODE:
+			MDEC_decodeCommand(mdec);
+			break;
+		case PHILPSX_MDEC_SET_QUANT_TABLES:
+			// Luminance table, then colour table if one was sent
+			for (int32_t i = 0; i < 64; ++i)
+				mdec->luminanceTable[i] =
+						(uint8_t)(mdec->input[i / 2] >> ((i & 1) * 8));
+			if (mdec->command & 0x1)
+				for (int32_t i = 0; i < 64; ++i)
+					mdec->colourTable[i] = (uint8_t)(mdec->input[32 + i / 2] >>
+							((i & 1) * 8));
+			break;
+		case PHILPSX_MDEC_SET_SCALE_TABLE:
+			// Store table divided by 8, then interleave pairs of its rows so
+			// the SIMD paths can multiply and add two rows at a time
+			for (int32_t i = 0; i < 64; ++i)
+				mdec->scaleTable[i] = (int16_t)mdec->input[i] / 8;
+			for (int32_t pair = 0; pair < 4; ++pair) {
+				for (int32_t x = 0; x < 8; ++x) {
+					mdec->scalePairs[pair * 16 + x * 2] =
+							mdec->scaleTable[pair * 16 + x];
+					mdec->scalePairs[pair * 16 + x * 2 + 1] =
+							mdec->scaleTable[pair * 16 + 8 + x];
+				}
+			}
+			break;
+	}
+}
+
+/*
+ * This function finds where the block starting at position ends, returning
+ * the position just after its end of block code, or -1 if the block isn't
+ * complete.
+ */
+static int32_t MDEC_findBlockEnd(const uint16_t *input, int32_t position,
+		int32_t count)
+{
+	// Skip padding and DC coefficient
+	while (position < count && input[position] == PHILPSX_MDEC_END_OF_BLOCK)
+		++position;
+	if (position++ >= count)
+		return -1;
+
+	// Follow runs until we go past the end of the block
+	int32_t k = 0;
+	while (k <= 63) {
+		if (position >= count)
+			return -1;
+		k += (input[position++] >> 10) + 1;
+	}
+
+	return position;
+}
+
+/*
+ * This function performs the inverse DCT on a block in place, as two passes
+ * which each multiply the transpose of their input by the scale table.
+ */
+static void MDEC_idct(const int16_t *scaleTable, const int16_t *scalePairs,
+		int16_t *block)
+{
+	int16_t temp[64];
+	MDEC_idctPass(scaleTable, scalePairs, block, temp);
+	MDEC_idctPass(scaleTable, scalePairs, temp, block);
+}
+
+/*
+ * This function performs one pass of the inverse DCT, so that each element
+ * of destination is the sum of a column of source multiplied by a column of
+ * the scale table. The sums fit comfortably in 32 bits, and the results in
+ * 16 bits, for any coefficients the run-length decoder can produce.
+ */
+static void MDEC_idctPass(const int16_t *scaleTable,
+		const int16_t *scalePairs, const int16_t *source,
+		int16_t *destination)
+{
+#if defined(__AVX2__)
+	(void)scaleTable;
+	__m256i rounding = _mm256_set1_epi32(0x0FFF);
+	for (int32_t y = 0; y < 8; ++y) {
+		__m256i sum = rounding;
+		for (int32_t pair = 0; pair < 4; ++pair) {
+			int32_t sources = (uint16_t)source[y + pair * 16] |
+					((uint32_t)(uint16_t)source[y + pair * 16 + 8] << 16);
+			__m256i scales = _mm256_loadu_si256(
+					(const __m256i *)&scalePairs[pair * 16]);
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(
+					_mm256_set1_epi32(sources), scales));
+		}
+		sum = _mm256_srai_epi32(sum, 13);
+		_mm_storeu_si128((__m128i *)&destination[y * 8], _mm_packs_epi32(
+				_mm256_castsi256_si128(sum),
+				_mm256_extracti128_si256(sum, 1)));
+	}
+#elif defined(__SSE2__)
+	(void)scaleTable;
+	__m128i rounding = _mm_set1_epi32(0x0FFF);
+	for (int32_t y = 0; y < 8; ++y) {
+		__m128i low = rounding;
+		__m128i high = rounding;
+		for (int32_t pair = 0; pair < 4; ++pair) {
+			int32_t sources = (uint16_t)source[y + pair * 16] |
+					((uint32_t)(uint16_t)source[y + pair * 16 + 8] << 16);
+			__m128i repeated = _mm_set1_epi32(sources);
+			low = _mm_add_epi32(low, _mm_madd_epi16(repeated,
+					_mm_loadu_si128((const __m128i *)&scalePairs[
+					pair * 16])));
+			high = _mm_add_epi32(high, _mm_madd_epi16(repeated,
+					_mm_loadu_si128((const __m128i *)&scalePairs[
+					pair * 16 + 8])));
+		}
+		_mm_storeu_si128((__m128i *)&destination[y * 8], _mm_packs_epi32(
+				_mm_srai_epi32(low, 13), _mm_srai_epi32(high, 13)));
+	}
+#elif defined(__ARM_NEON)
+	(void)scalePairs;
+	for (int32_t y = 0; y < 8; ++y) {
+		int32x4_t low = vdupq_n_s32(0x0FFF);
+		int32x4_t high = vdupq_n_s32(0x0FFF);
+		for (int32_t z = 0; z < 8; ++z) {
+			int16x8_t scales = vld1q_s16(&scaleTable[z * 8]);
+			low = vmlal_n_s16(low, vget_low_s16(scales), source[y + z * 8]);
+			high = vmlal_n_s16(high, vget_high_s16(scales),
+					source[y + z * 8]);
+		}
+		vst1q_s16(&destination[y * 8], vcombine_s16(
+				vqmovn_s32(vshrq_n_s32(low, 13)),
+				vqmovn_s32(vshrq_n_s32(high, 13))));
+	}
+#else
+	(void)scalePairs;
+	for (int32_t y = 0; y < 8; ++y) {
+		for (int32_t x = 0; x < 8; ++x) {
+			int32_t sum = 0x0FFF;
+			for (int32_t z = 0; z < 8; ++z)
+				sum += source[y + z * 8] * scaleTable[x + z * 8];
+			destination[x + y * 8] =
+					(int16_t)MDEC_clamp(sum >> 13, -0x8000, 0x7FFF);
+		}
+	}
+#endif
+}
+
+/*
+ * This function converts a block of luminance to 8-bit or 4-bit greyscale
+ * (two pixels to a byte, the first in the low nibble).
+ */
+static void MDEC_outputGreyscale(MDEC *mdec, const int16_t *block,
+		int8_t *output)
+{
+	int32_t depth = logical_rshift(mdec->command, 27) & 0x3;
+	int32_t flip = (mdec->command & 0x04000000) ? 0 : 0x80;
+
+	for (int32_t i = 0; i < 64; ++i) {
+		int32_t grey = (MDEC_clamp(block[i], -128, 127) ^ flip) & 0xFF;
+		if (depth == PHILPSX_MDEC_DEPTH_8BIT)
+			output[i] = (int8_t)grey;
+		else if (i & 1)
+			output[i / 2] |= (int8_t)((grey >> 4) << 4);
+		else
+			output[i / 2] = (int8_t)(grey >> 4);
+	}
+}
+
+/*
+ * This function converts a macroblock's colour and luminance blocks to a
+ * 16x16 block of 24-bit or 15-bit RGB pixels. The colour blocks cover the
+ * whole macroblock at half resolution, and the luminance blocks cover the
+ * top left, top right, bottom left and bottom right quarters in that order.
+ */
+static void MDEC_outputRgb(MDEC *mdec, const int16_t *blocks,
+		int8_t *output)
+{
+	int32_t depth = logical_rshift(mdec->command, 27) & 0x3;
+	int32_t flip = (mdec->command & 0x04000000) ? 0 : 0x80;
+	int32_t bit15 = (mdec->command & 0x02000000) ? 0x8000 : 0;
+	const int16_t *crBlock = &blocks[0];
+	const int16_t *cbBlock = &blocks[64];
+
+	for (int32_t y = 0; y < 16; ++y) {
+		for (int32_t x = 0; x < 16; ++x) {
+			// Work out colour differences in 10-bit fixed point
+			int32_t cr = crBlock[(x / 2) + (y / 2) * 8];
+			int32_t cb = cbBlock[(x / 2) + (y / 2) * 8];
+			int32_t redDelta = (1436 * cr) >> 10;
+			int32_t greenDelta = (-352 * cb - 731 * cr) >> 10;
+			int32_t blueDelta = (1815 * cb) >> 10;
+
+			// Add them to luminance
+			const int16_t *yBlock = &blocks[(2 + (x / 8) + (y / 8) * 2) * 64];
+			int32_t luminance = yBlock[(x & 7) + (y & 7) * 8];
+			int32_t red = (MDEC_clamp(luminance + redDelta, -128, 127) ^
+					flip) & 0xFF;
+			int32_t green = (MDEC_clamp(luminance + greenDelta, -128, 127) ^
+					flip) & 0xFF;
+			int32_t blue = (MDEC_clamp(luminance + blueDelta, -128, 127) ^
+					flip) & 0xFF;
+
+			// Store pixel
+			int32_t pixel = x + y * 16;
+			if (depth == PHILPSX_MDEC_DEPTH_24BIT) {
+				output[pixel * 3] = (int8_t)red;
+				output[pixel * 3 + 1] = (int8_t)green;
+				output[pixel * 3 + 2] = (int8_t)blue;
+			} else {
+				write_le_halfword(&output[pixel * 2], (red >> 3) |
+						((green >> 3) << 5) | ((blue >> 3) << 10) | bit15);
+			}
+		}
+	}
+}
+
+/*
+ * This function handles halfword reads from the MDEC registers.
+ */
+static int32_t MDEC_readRegisterHalfWord(void *component, int32_t address)
+{
+	int32_t word = MDEC_readWord(component, address & 0xFFFFFFFC);
+	return logical_rshift(word, (address & 0x2) * 8) & 0xFFFF;
+}
+
+/*
+ * This function handles word reads from the MDEC registers.
+ */
+static int32_t MDEC_readRegisterWord(void *component, int32_t address)
+{
+	return MDEC_readWord(component, address);
+}
+
+/*
+ * This function assembles the status register.
+ */
+static int32_t MDEC_readStatus(MDEC *mdec)
+{
+	bool outputWaiting = MDEC_hasOutput(mdec);
+	int32_t status = 0;
+
+	if (!outputWaiting)
+		status |= 0x80000000;
+	if (mdec->wordsRemaining > 0 || outputWaiting)
+		status |= 0x20000000;
+	if (mdec->dataInEnabled && mdec->wordsRemaining > 0)
+		status |= 0x10000000;
+	if (mdec->dataOutEnabled && outputWaiting)
+		status |= 0x08000000;
+
+	// Output format bits of the current command, the current block (always
+	// reported as the first colour block, as we decode a command at once)
+	// and the parameter words remaining minus 1
+	status |= (logical_rshift(mdec->command, 25) & 0xF) << 23;
+	status |= 0x4 << 16;
+	status |= (mdec->wordsRemaining - 1) & 0xFFFF;
+
+	return status;
+}
+
+/*
+ * This function aborts any command and discards any output, leaving the
+ * tables as they were.
+ */
+static void MDEC_reset(MDEC *mdec)
+{
+	mdec->command = 0;
+	mdec->wordsRemaining = 0;
+	mdec->inputCount = 0;
+	mdec->dataInEnabled = false;
+	mdec->dataOutEnabled = false;
+	mdec->macroblockCount = 0;
+	mdec->outputSize = 0;
+	mdec->outputPosition = 0;
+}
+
+/*
+ * This function sign extends the 10-bit coefficient in the bottom of a code.
+ */
+static int32_t MDEC_signExtend(int32_t code)
+{
+	return ((code & 0x3FF) ^ 0x200) - 0x200;
+}
+
+/*
+ * This function tells the first threadCount - 1 workers to quit, and waits
+ * for them to do so.
+ */
+static void MDEC_stopWorkers(MDEC *mdec, int32_t threadCount)
+{
+	pthread_mutex_lock(&mdec->workMutex);
+	mdec->quit = true;
+	pthread_cond_broadcast(&mdec->workCondition);
+	pthread_mutex_unlock(&mdec->workMutex);
+
+	for (int32_t i = 1; i < threadCount; ++i)
+		pthread_join(mdec->workers[i].thread, NULL);
+}
+
+/*
+ * This function is the body of each worker thread, decoding its share of
+ * each decode command as it arrives.
+ */
+static void *MDEC_workerFunction(void *arg)
+{
+	MDECWorker *worker = arg;
+	MDEC *mdec = worker->mdec;
+	int64_t lastBatch = 0;
+
+	for (;;) {
+
+		// Wait for the next command, or for the signal to quit
+		pthread_mutex_lock(&mdec->workMutex);
+		while (!mdec->quit && mdec->batchNumber == lastBatch)
+			pthread_cond_wait(&mdec->workCondition, &mdec->workMutex);
+		if (mdec->quit) {
+			pthread_mutex_unlock(&mdec->workMutex);
+			break;
+		}
+		lastBatch = mdec->batchNumber;
+		pthread_mutex_unlock(&mdec->workMutex);
+
+		MDEC_decodeShare(mdec, worker->index);
+
+		// Tell the emulator thread we are done
+		pthread_mutex_lock(&mdec->workMutex);
+		if (--mdec->workersRunning == 0)
+			pthread_cond_signal(&mdec->doneCondition);
+		pthread_mutex_unlock(&mdec->workMutex);
+	}
+
+	return NULL;
+}
+
+/*
+ * This function handles word writes to the MDEC registers.
+ */
+static void MDEC_writeRegisterWord(void *component, int32_t address,
+		int32_t value)
+{
+	MDEC_writeWord(component, address, value);
+}
@@ -8,12 +8,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../headers/R3051.h"
+#include "../headers/R3051_all.h"
+#include "../headers/R3051BlockCache_all.h"
+#include "../headers/R3051Jit.h"
 #include "../headers/Components.h"
-#include "../headers/Cop0_all.h"
-#include "../headers/Cop2_all.h"
-#include "../headers/InstructionCache_all.h"
+#include "../headers/PerfCounters.h"
+#include "../headers/SaveState.h"
 #include "../headers/SystemInterlink.h"
+#include "../headers/endian_utils.h"
 #include "../headers/math_utils.h"
 
 // Data widths for read and write functions
@@ -35,6 +37,9 @@
 #define PHILPSX_EXCEPTION_RESET 13
 #define PHILPSX_EXCEPTION_NULL 14
 
+// Instruction handler function pointer type, used by the cached interpreter
+typedef void (*R3051InstructionHandler)(R3051 *cpu, int32_t instruction);
+
 // Forward declarations for functions and subcomponents private to this class
 // R3051-related stuff:
 static void R3051_ADD(R3051 *cpu, int32_t instruction);
@@ -106,81 +111,46 @@ static void R3051_SWR(R3051 *cpu, int32_t instruction);
 static void R3051_SYSCALL(R3051 *cpu, int32_t instruction);
 static void R3051_XOR(R3051 *cpu, int32_t instruction);
 static void R3051_XORI(R3051 *cpu, int32_t instruction);
+static R3051InstructionHandler R3051_decodeInstruction(int32_t instruction);
+static void R3051_detectIdleLoop(R3051 *cpu, int32_t blockAddress);
+static bool R3051_executeBlock(R3051 *cpu);
+static bool R3051_executeCachedBlock(R3051 *cpu);
 static void R3051_executeOpcode(R3051 *cpu, int32_t instruction,
 		int32_t tempBranchAddress);
+static void R3051_executeUndecodedOpcode(R3051 *cpu, int32_t instruction);
+static void R3051_finishInstruction(R3051 *cpu);
+static void R3051_flushSyncCycles(R3051 *cpu);
 static int32_t R3051_getHiReg(R3051 *cpu);
 static int32_t R3051_getLoReg(R3051 *cpu);
 static int32_t R3051_getProgramCounter(R3051 *cpu);
 static bool R3051_handleException(R3051 *cpu);
 static bool R3051_handleInterrupts(R3051 *cpu);
+static void R3051_interpretInstruction(R3051 *cpu);
 static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address);
 static int64_t R3051_readInstructionWord(R3051 *cpu, int32_t address,
 		int32_t tempBranchAddress);
 static void R3051_reset(R3051 *cpu);
-static int32_t R3051_swapWordEndianness(R3051 *cpu, int32_t word);
 static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 		int32_t value);
 
 // MIPSException-related stuff:
-typedef struct MIPSException MIPSException;
 static void MIPSException_reset(MIPSException *exception);
 
-/*
- * This inner struct models a processor exception, which can occur during
- * any stage of the pipeline.
- */
-struct MIPSException {
-	
-	// Exception variables
-	int32_t exceptionReason;
-	int32_t programCounterOrigin;
-	int32_t badAddress;
-	int32_t coProcessorNum;
-	bool isInBranchDelaySlot;
-};
+// R3051DecodedInstruction-related stuff:
+typedef struct R3051DecodedInstruction R3051DecodedInstruction;
 
 /*
- * This struct contains registers, and pointers to subcomponents.
+ * This inner struct models an instruction of a cached block, which has been
+ * decoded so that it can be dispatched straight to its handler.
  */
-struct R3051 {
-	
-	// Component ID
-	int32_t componentId;
-
-	// Register definitions
-	int32_t generalRegisters[32];
-	int32_t programCounter;
-	int32_t hiReg;
-	int32_t loReg;
-
-	// Jump address holder and boolean
-	int32_t jumpAddress;
-	bool jumpPending;
-
-	// Co-processor definitions
-	Cop0 sccp;
-	Cop2 gte;
-
-	// Bus holder definition
-	int32_t busHolder;
-
-	// System link
-	SystemInterlink *system;
+struct R3051DecodedInstruction {
 
-	// This stores the current exception
-	MIPSException exception;
+	// Handler and the instruction word it is called with
+	R3051InstructionHandler handler;
+	int32_t instruction;
 
-	// This stores the instruction cache
-	InstructionCache instructionCache;
-
-	// This tells us if the last instruction was a branch/jump instruction
-	bool prevWasBranch;
-	bool isBranch;
-
-	// This counts the cycles of the current instruction
-	int32_t cycles;
-	int32_t gteCycles;
-	int64_t totalCycles;
+	// This tells us if the rest of the block must be checked afterwards
+	bool needsRevalidation;
 };
 
 /*
@@ -199,6 +169,16 @@ R3051 *construct_R3051(void)
 	// Set SystemInterlink reference to NULL
 	cpu->system = NULL;
 
+	// Allocate page table, which is filled in once we have a system
+	cpu->memoryPages = calloc(PHILPSX_R3051_PAGE_COUNT,
+			sizeof(R3051MemoryPage));
+	if (!cpu->memoryPages) {
+		fprintf(stderr, "PhilPSX: R3051: Couldn't allocate memory for page "
+				"table\n");
+		goto cleanup_r3051;
+	}
+	cpu->codePages = NULL;
+
 	// Set component ID
 	cpu->componentId = PHILPSX_COMPONENTS_CPU;
 
@@ -206,6 +186,7 @@ R3051 *construct_R3051(void)
 	cpu->cycles = 0;
 	cpu->gteCycles = 0;
 	cpu->totalCycles = 0;
+	cpu->pendingSyncCycles = 0;
 
 	// Setup registers (remember, r1 should always be 0)
 	memset(cpu->generalRegisters, 0, sizeof(cpu->generalRegisters));
@@ -224,7 +205,7 @@ R3051 *construct_R3051(void)
 	// Setup instruction cache
 	if (!construct_InstructionCache(&cpu->instructionCache)) {
 		fprintf(stderr, "PhilPSX: R3051: Couldn't construct instruction cache");
-		goto cleanup_r3051;
+		goto cleanup_pagetable;
 	}
 
 	// Setup the branch marker
@@ -242,10 +223,41 @@ R3051 *construct_R3051(void)
 	// Set bus holder
 	cpu->busHolder = PHILPSX_COMPONENTS_CPU;
 
+	// Start in interpretive mode, as the recompiler is optional
+	cpu->executionMode = PHILPSX_R3051_MODE_INTERPRETER;
+	cpu->blockCache = NULL;
+	cpu->jit = NULL;
+
+	// Leave all kernel functions to the BIOS by default
+	cpu->hle = NULL;
+
+	// Boot through the BIOS shell by default
+	cpu->exeLoader = NULL;
+	cpu->exeBootPending = false;
+
+	// Start without a debugger
+	cpu->debugger = NULL;
+	cpu->debuggerArmed = false;
+
+	// Start without a profiler
+	cpu->profiler = NULL;
+
+	// Setup idle loop detection
+	cpu->hadSideEffects = false;
+	cpu->idleLoopValid = false;
+	cpu->idleLoopAddress = 0;
+	cpu->idleCyclesSkipped = 0;
+
+	// Setup instruction count
+	cpu->instructionCount = 0;
+
 	// Normal return:
 	return cpu;
 
 	// Cleanup path:
+	cleanup_pagetable:
+	free(cpu->memoryPages);
+
 	cleanup_r3051:
 	free(cpu);
 	cpu = NULL;
@@ -259,90 +271,142 @@ R3051 *construct_R3051(void)
  */
 void destruct_R3051(R3051 *cpu)
 {
+	if (cpu->profiler)
+		destruct_R3051Profiler(cpu->profiler);
+	if (cpu->debugger)
+		destruct_R3051Debugger(cpu->debugger);
+	if (cpu->exeLoader)
+		destruct_R3051ExeLoader(cpu->exeLoader);
+	if (cpu->hle)
+		destruct_R3051Hle(cpu->hle);
+	if (cpu->jit)
+		destruct_R3051Jit(cpu->jit);
+	if (cpu->blockCache)
+		destruct_R3051BlockCache(cpu->blockCache);
 	destruct_InstructionCache(&cpu->instructionCache);
+	free(cpu->memoryPages);
 	free(cpu);
 }
 
 /*
- * This function moves the whole processor on by one block of instructions.
+ * This function attaches a debugger to the processor, which starts with it
+ * stopped. It returns false if the debugger couldn't be constructed.
  */
-int64_t R3051_executeInstructions(R3051 *cpu)
+bool R3051_attachDebugger(R3051 *cpu)
 {
-	// Enter loop
-	do {
-		// Setup cycle count and instruction
-		cpu->cycles = 0;
-		int32_t instruction = 0;
+	if (cpu->debugger)
+		return true;
 
-		// Check address is OK, throwing exception if not
-		int32_t tempAddress =
-				(int32_t)((cpu->programCounter & 0xFFFFFFFFL) - 4L);
+	cpu->debugger = construct_R3051Debugger(cpu);
+	if (!cpu->debugger)
+		return false;
+	R3051Debugger_handleCommand(cpu->debugger,
+			PHILPSX_R3051DEBUGGER_COMMAND_HALT, 0, 0);
+	return true;
+}
 
-		// Perform read of instruction
-		int64_t tempInstruction = R3051_readInstructionWord(
-				cpu,
-				cpu->programCounter,
-				tempAddress
-				);
-		if (tempInstruction == -1L) {
-			cpu->cycles += 1;
-			cpu->totalCycles += 1;
-			SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
-			continue;
-		}
+/*
+ * This function attaches a profiler to the processor, which records each
+ * block run from then on. It returns false if the profiler couldn't be
+ * constructed.
+ */
+bool R3051_attachProfiler(R3051 *cpu)
+{
+	if (cpu->profiler)
+		return true;
+
+	cpu->profiler = construct_R3051Profiler();
+	return cpu->profiler != NULL;
+}
+
+/*
+ * This function completes an instruction that has already been fetched, by
+ * executing it and then dealing with exceptions, interrupts, the program
+ * counter and cycle counts. The fetch must already have added its stall
+ * cycles. It is shared by the interpreter and the recompiler so that both
+ * account for cycles identically.
+ */
+void R3051_completeInstruction(R3051 *cpu, int32_t instruction,
+		int32_t tempAddress)
+{
+	// Execute
+	R3051_executeOpcode(cpu, instruction, tempAddress);
+	R3051_finishInstruction(cpu);
+}
 
-		// Cast long to int
-		instruction = (int32_t)tempInstruction;
+/*
+ * This function moves the whole processor on by one block of instructions.
+ */
+int64_t R3051_executeInstructions(R3051 *cpu)
+{
+	// Only attempt to use cached blocks until one is declined, at which
+	// point we interpret up to the end of the block so that the instruction
+	// cache is populated before the next attempt
+	bool tryBlockCache = cpu->blockCache != NULL;
 
-		// We now have instruction value. Swap bytes if we are in
-		// little endian mode
-		instruction = R3051_swapWordEndianness(cpu, instruction);
+	// Note where this block starts for idle loop detection
+	int32_t blockAddress = cpu->programCounter;
+	cpu->hadSideEffects = false;
+#ifdef PHILPSX_PERF_COUNTERS
+	int64_t firstInstruction = cpu->instructionCount;
+#endif
 
-		// Execute
-		R3051_executeOpcode(cpu, instruction, tempAddress);
+	// Enter loop
+	do {
+		// Let the debugger stop us, or have us interpret this instruction on
+		// its own, if it is asking about each one
+		if (cpu->debuggerArmed) {
+			int32_t action = R3051Debugger_checkExecution(cpu->debugger);
+			if (action == PHILPSX_R3051DEBUGGER_BREAK) {
+				cpu->hadSideEffects = true;
+				break;
+			}
+			if (action == PHILPSX_R3051DEBUGGER_INTERPRET) {
+				R3051_interpretInstruction(cpu);
+				continue;
+			}
+		}
 
-		// Handle exception if there was one
-		if (R3051_handleException(cpu)) {
-			cpu->cycles += 1;
-			cpu->totalCycles += 1;
-			SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+		// Run kernel functions natively if enabled, unless we are in a
+		// branch delay slot
+		if (cpu->hle && !cpu->prevWasBranch &&
+				R3051Hle_handleCall(cpu->hle, cpu))
 			continue;
-		}
 
-		// Handle interrupt if there was one
-		if (cpu->isBranch && R3051_handleInterrupts(cpu)) {
-			cpu->cycles += 1;
-			cpu->totalCycles += 1;
-			SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+		// Side-load a program in place of the BIOS shell if we have one
+		if (cpu->exeBootPending && !cpu->prevWasBranch &&
+				R3051ExeLoader_handleBoot(cpu->exeLoader, cpu)) {
+			cpu->exeBootPending = false;
 			continue;
 		}
 
-		// Jump if pending, else add four to program counter
-		if (cpu->jumpPending && cpu->prevWasBranch) {
-			cpu->programCounter = cpu->jumpAddress;
-			cpu->jumpPending = false;
-		} else {
-			tempAddress = (int32_t)((cpu->programCounter & 0xFFFFFFFFL) + 4L);
-			cpu->programCounter = tempAddress;
+		// Run a cached block if we are not in a branch delay slot
+		if (tryBlockCache && !cpu->prevWasBranch && !cpu->isBranch) {
+			if (R3051_executeBlock(cpu))
+				continue;
+			tryBlockCache = false;
 		}
 
-		// Increment cycle count
-		cpu->cycles += (cpu->gteCycles == 0) ? 1 : cpu->gteCycles;
-		cpu->totalCycles += (cpu->gteCycles == 0) ? 1 : cpu->gteCycles;
-		cpu->gteCycles = 0;
+		// Otherwise interpret the next instruction
+		R3051_interpretInstruction(cpu);
+	} while (!cpu->prevWasBranch);
 
-		// Setup whether the instruction just gone was a branch, and clear
-		// current branch status
-		cpu->prevWasBranch = cpu->isBranch;
-		cpu->isBranch = false;
+	// Bring the system up to date with this block
+	R3051_flushSyncCycles(cpu);
+	PHILPSX_PERF_ADD(PHILPSX_PERF_INSTRUCTIONS,
+			cpu->instructionCount - firstInstruction);
 
-		// Return number of cycles instruction took
-		SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
-	} while (!cpu->prevWasBranch);
+	// Skip ahead to the next event if we are spinning in an idle loop
+	R3051_detectIdleLoop(cpu, blockAddress);
 	
 	// Return cycle count for this block after resetting it in the CPU object
 	int64_t retVal = cpu->totalCycles;
 	cpu->totalCycles = 0;
+
+	// Let the profiler know about this block if one is attached
+	if (cpu->profiler)
+		R3051Profiler_recordBlock(cpu->profiler, blockAddress, retVal,
+				cpu->generalRegisters[31]);
 	return retVal;
 }
 
@@ -370,6 +434,134 @@ Cop2 *R3051_getCop2(R3051 *cpu)
 	return &cpu->gte;
 }
 
+/*
+ * This function returns the debugger attached to the processor, or NULL if
+ * there isn't one.
+ */
+R3051Debugger *R3051_getDebugger(R3051 *cpu)
+{
+	return cpu->debugger;
+}
+
+/*
+ * This function returns the total number of cycles skipped by jumping ahead
+ * to the next event while spinning in idle loops.
+ */
+int64_t R3051_getIdleCyclesSkipped(R3051 *cpu)
+{
+	return cpu->idleCyclesSkipped;
+}
+
+/*
+ * This function returns the total number of instructions executed so far,
+ * whichever execution mode ran them. Kernel functions run natively are not
+ * counted.
+ */
+int64_t R3051_getInstructionCount(R3051 *cpu)
+{
+	return cpu->instructionCount;
+}
+
+/*
+ * This function returns the profiler attached to the processor, or NULL if
+ * there isn't one.
+ */
+R3051Profiler *R3051_getProfiler(R3051 *cpu)
+{
+	return cpu->profiler;
+}
+
+/*
+ * This function throws away any code that has been cached from the page
+ * containing the specified physical address, as it has been written to.
+ */
+void R3051_invalidateCodePage(R3051 *cpu, int32_t physicalAddress)
+{
+	if (cpu->blockCache)
+		R3051BlockCache_invalidatePage(cpu->blockCache, physicalAddress);
+}
+
+/*
+ * This function reads the processor's state back from a save state, in the
+ * order R3051_saveState wrote it. Cached code is looked after by the system
+ * interlink as it loads RAM, while the idle loop detection starts afresh.
+ */
+void R3051_loadState(R3051 *cpu, SaveState *state)
+{
+	// Registers and co-processors
+	SaveState_read(state, cpu->generalRegisters,
+			sizeof(cpu->generalRegisters));
+	SaveState_read(state, &cpu->programCounter, sizeof(int32_t));
+	SaveState_read(state, &cpu->hiReg, sizeof(int32_t));
+	SaveState_read(state, &cpu->loReg, sizeof(int32_t));
+	SaveState_read(state, &cpu->jumpAddress, sizeof(int32_t));
+	SaveState_read(state, &cpu->jumpPending, sizeof(bool));
+	SaveState_read(state, &cpu->sccp, sizeof(Cop0));
+	SaveState_read(state, &cpu->gte, sizeof(Cop2));
+	SaveState_read(state, &cpu->busHolder, sizeof(int32_t));
+	SaveState_read(state, &cpu->exception, sizeof(MIPSException));
+
+	// Instruction cache
+	SaveState_read(state, cpu->instructionCache.cacheTag,
+			PHILPSX_ICACHE_LINE_COUNT * sizeof(uint32_t));
+	SaveState_read(state, cpu->instructionCache.cacheData,
+			PHILPSX_ICACHE_LINE_COUNT * PHILPSX_ICACHE_LINE_WORDS *
+			sizeof(int32_t));
+
+	// Branch and cycle state
+	SaveState_read(state, &cpu->prevWasBranch, sizeof(bool));
+	SaveState_read(state, &cpu->isBranch, sizeof(bool));
+	SaveState_read(state, &cpu->cycles, sizeof(int32_t));
+	SaveState_read(state, &cpu->gteCycles, sizeof(int32_t));
+	SaveState_read(state, &cpu->totalCycles, sizeof(int64_t));
+	SaveState_read(state, &cpu->pendingSyncCycles, sizeof(int64_t));
+
+	// Side-loading, which can only still be pending if we have a program
+	SaveState_read(state, &cpu->exeBootPending, sizeof(bool));
+	cpu->exeBootPending = cpu->exeBootPending && cpu->exeLoader;
+
+	// Forget any idle loop found before
+	cpu->idleLoopValid = false;
+}
+
+/*
+ * This function writes the processor's state to a save state - the
+ * registers, co-processors, instruction cache and cycle counts.
+ */
+void R3051_saveState(R3051 *cpu, SaveState *state)
+{
+	// Registers and co-processors
+	SaveState_write(state, cpu->generalRegisters,
+			sizeof(cpu->generalRegisters));
+	SaveState_write(state, &cpu->programCounter, sizeof(int32_t));
+	SaveState_write(state, &cpu->hiReg, sizeof(int32_t));
+	SaveState_write(state, &cpu->loReg, sizeof(int32_t));
+	SaveState_write(state, &cpu->jumpAddress, sizeof(int32_t));
+	SaveState_write(state, &cpu->jumpPending, sizeof(bool));
+	SaveState_write(state, &cpu->sccp, sizeof(Cop0));
+	SaveState_write(state, &cpu->gte, sizeof(Cop2));
+	SaveState_write(state, &cpu->busHolder, sizeof(int32_t));
+	SaveState_write(state, &cpu->exception, sizeof(MIPSException));
+
+	// Instruction cache
+	SaveState_write(state, cpu->instructionCache.cacheTag,
+			PHILPSX_ICACHE_LINE_COUNT * sizeof(uint32_t));
+	SaveState_write(state, cpu->instructionCache.cacheData,
+			PHILPSX_ICACHE_LINE_COUNT * PHILPSX_ICACHE_LINE_WORDS *
+			sizeof(int32_t));
+
+	// Branch and cycle state
+	SaveState_write(state, &cpu->prevWasBranch, sizeof(bool));
+	SaveState_write(state, &cpu->isBranch, sizeof(bool));
+	SaveState_write(state, &cpu->cycles, sizeof(int32_t));
+	SaveState_write(state, &cpu->gteCycles, sizeof(int32_t));
+	SaveState_write(state, &cpu->totalCycles, sizeof(int64_t));
+	SaveState_write(state, &cpu->pendingSyncCycles, sizeof(int64_t));
+
+	// Side-loading
+	SaveState_write(state, &cpu->exeBootPending, sizeof(bool));
+}
+
 /*
  * This function sets the current holder of the system bus.
  */
@@ -378,12 +570,140 @@ void R3051_setBusHolder(R3051 *cpu, int32_t holder)
 	cpu->busHolder = holder;
 }
 
+/*
+ * This function sets the execution mode of the processor, constructing the
+ * recompiler if needed. It returns false if the mode could not be set up, in
+ * which case the processor stays in interpretive mode.
+ */
+bool R3051_setExecutionMode(R3051 *cpu, int32_t mode)
+{
+	// Tear down the recompiler and block cache if we have them
+	if (cpu->jit) {
+		destruct_R3051Jit(cpu->jit);
+		cpu->jit = NULL;
+	}
+	if (cpu->blockCache) {
+		destruct_R3051BlockCache(cpu->blockCache);
+		cpu->blockCache = NULL;
+	}
+	cpu->executionMode = PHILPSX_R3051_MODE_INTERPRETER;
+
+	switch (mode) {
+		case PHILPSX_R3051_MODE_INTERPRETER:
+			break;
+		case PHILPSX_R3051_MODE_RECOMPILER:
+			// Block data points into the code buffer, so isn't freed
+			cpu->blockCache = construct_R3051BlockCache(NULL);
+			if (!cpu->blockCache) {
+				fprintf(stderr, "PhilPSX: R3051: Couldn't construct block "
+						"cache\n");
+				return false;
+			}
+			cpu->jit = construct_R3051Jit(cpu->blockCache);
+			if (!cpu->jit) {
+				fprintf(stderr, "PhilPSX: R3051: Couldn't construct "
+						"recompiler\n");
+				destruct_R3051BlockCache(cpu->blockCache);
+				cpu->blockCache = NULL;
+				return false;
+			}
+			cpu->executionMode = mode;
+			break;
+		case PHILPSX_R3051_MODE_CACHED_INTERPRETER:
+			cpu->blockCache = construct_R3051BlockCache(free);
+			if (!cpu->blockCache) {
+				fprintf(stderr, "PhilPSX: R3051: Couldn't construct block "
+						"cache\n");
+				return false;
+			}
+			cpu->executionMode = mode;
+			break;
+		default:
+			fprintf(stderr, "PhilPSX: R3051: Unknown execution mode %d\n",
+					mode);
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * This function has the program a CD boots side-loaded in place of the BIOS
+ * shell, once the kernel has set itself up, skipping the shell and the CD
+ * boot sequence. It returns false if the CD has no program to boot, in
+ * which case the BIOS boots it as normal.
+ */
+bool R3051_setBootCD(R3051 *cpu, CD *cd)
+{
+	R3051ExeLoader *loader = construct_R3051ExeLoader();
+	if (!loader || !R3051ExeLoader_loadCD(loader, cd)) {
+		if (loader)
+			destruct_R3051ExeLoader(loader);
+		return false;
+	}
+
+	if (cpu->exeLoader)
+		destruct_R3051ExeLoader(cpu->exeLoader);
+	cpu->exeLoader = loader;
+	cpu->exeBootPending = true;
+	return true;
+}
+
+/*
+ * This function has the PS-X EXE program at path side-loaded in place of the
+ * BIOS shell, once the kernel has set itself up. It returns false if the
+ * program couldn't be loaded, in which case the BIOS boots as normal.
+ */
+bool R3051_setBootExe(R3051 *cpu, const char *path)
+{
+	R3051ExeLoader *loader = construct_R3051ExeLoader();
+	if (!loader || !R3051ExeLoader_loadFile(loader, path)) {
+		if (loader)
+			destruct_R3051ExeLoader(loader);
+		return false;
+	}
+
+	if (cpu->exeLoader)
+		destruct_R3051ExeLoader(cpu->exeLoader);
+	cpu->exeLoader = loader;
+	cpu->exeBootPending = true;
+	return true;
+}
+
+/*
+ * This function sets which BIOS kernel functions are run natively instead
+ * of through the BIOS code, as a comma-separated list of names. NULL or an
+ * empty list leaves them all to the BIOS. It returns false if the list could
+ * not be used, in which case they are all left to the BIOS.
+ */
+bool R3051_setHleFunctions(R3051 *cpu, const char *functions)
+{
+	// Tear down existing high-level emulation if we have it
+	if (cpu->hle) {
+		destruct_R3051Hle(cpu->hle);
+		cpu->hle = NULL;
+	}
+
+	if (!functions || *functions == '\0')
+		return true;
+
+	cpu->hle = construct_R3051Hle(functions);
+	if (!cpu->hle) {
+		fprintf(stderr, "PhilPSX: R3051: Couldn't construct kernel function "
+				"emulation\n");
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * This function sets the system interlink reference.
  */
 void R3051_setMemoryInterface(R3051 *cpu, SystemInterlink *system)
 {
 	cpu->system = system;
+	R3051_mapMemoryPages(cpu);
 }
 
 /*
@@ -1100,14 +1420,12 @@ static void R3051_LH(R3051 *cpu, int32_t instruction)
 		return;
 	}
 
-	// Load half-word and swap endianness, sign extend
+	// Load half-word and sign extend
 	int32_t tempHalfWord = 0xFFFF & R3051_readDataValue(
 			cpu,
 			PHILPSX_R3051_HALFWORD,
 			(int32_t)address
 			);
-	tempHalfWord = ((tempHalfWord << 8) & 0xFF00) |
-			logical_rshift(tempHalfWord, 8);
 	if ((tempHalfWord & 0x8000) == 0x8000) {
 		tempHalfWord |= 0xFFFF0000;
 	}
@@ -1149,17 +1467,13 @@ static void R3051_LHU(R3051 *cpu, int32_t instruction)
 		return;
 	}
 
-	// Load half-word and swap endianness, zero extend
+	// Load half-word and zero extend
 	int32_t tempHalfWord = 0xFFFF & R3051_readDataValue(
 			cpu,
 			PHILPSX_R3051_HALFWORD,
 			(int32_t)address
 			);
 
-	// Swap byte order
-	tempHalfWord = ((tempHalfWord << 8) & 0xFF00) |
-			logical_rshift(tempHalfWord, 8);
-
 	// Write half-word to correct register
 	cpu->generalRegisters[rt] = tempHalfWord;
 	cpu->generalRegisters[0] = 0;
@@ -1218,9 +1532,6 @@ static void R3051_LW(R3051 *cpu, int32_t instruction)
 			(int32_t)address
 			);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	// Write word to correct register
 	cpu->generalRegisters[rt] = tempWord;
 	cpu->generalRegisters[0] = 0;
@@ -1264,9 +1575,6 @@ static void R3051_LWC2(R3051 *cpu, int32_t instruction)
 			(int32_t)address
 			);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	// Write word to correct COP2 data register
 	Cop2_writeDataReg(&cpu->gte, rt, tempWord, false);
 }
@@ -1310,9 +1618,6 @@ static void R3051_LWL(R3051 *cpu, int32_t instruction)
 			tempAddress
 			);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	// Shift word value left by required amount
 	tempWord = tempWord << (byteShiftIndex * 8);
 
@@ -1363,9 +1668,6 @@ static void R3051_LWR(R3051 *cpu, int32_t instruction)
 	int32_t byteShiftIndex = (int32_t)(address & 0x3);
 	int32_t tempWord = R3051_readDataValue(cpu, PHILPSX_R3051_WORD, tempAddress);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	// Shift word value left by required amount
 	tempWord = logical_rshift(tempWord, (byteShiftIndex * 8));
 
@@ -1667,14 +1969,10 @@ static void R3051_SH(R3051 *cpu, int32_t instruction)
 		return;
 	}
 
-	// Load half-word from register and swap endianness, then write to memory
-	// (checking for exceptions and stalls)
+	// Load half-word from register, then write to memory (checking for
+	// exceptions and stalls)
 	int32_t tempHalfWord = 0xFFFF & cpu->generalRegisters[rt];
 
-	// Swap byte order
-	tempHalfWord = ((tempHalfWord << 8) & 0xFF00) |
-			logical_rshift(tempHalfWord, 8);
-
 	R3051_writeDataValue(
 			cpu,
 			PHILPSX_R3051_HALFWORD,
@@ -1969,9 +2267,6 @@ static void R3051_SW(R3051 *cpu, int32_t instruction)
 	// (checking for exceptions and stalls)
 	int32_t tempWord = cpu->generalRegisters[rt];
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	R3051_writeDataValue(cpu, PHILPSX_R3051_WORD, (int32_t)address, tempWord);
 }
 
@@ -2009,9 +2304,6 @@ static void R3051_SWC2(R3051 *cpu, int32_t instruction)
 	// Load word from register, set byte order and write to memory
 	int32_t tempWord = Cop2_readDataReg(&cpu->gte, rt);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	R3051_writeDataValue(cpu, PHILPSX_R3051_WORD, (int32_t)address, tempWord);
 }
 
@@ -2050,15 +2342,13 @@ static void R3051_SWL(R3051 *cpu, int32_t instruction)
 	int32_t byteShiftIndex = (int32_t)(~address & 0x3);
 	int32_t tempWord = cpu->generalRegisters[rt];
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
-	// Shift word value left by required amount
-	tempWord = tempWord << (byteShiftIndex * 8);
+	// Shift word value right by required amount
+	tempWord = logical_rshift(tempWord, (byteShiftIndex * 8));
 
 	// Fetch memory contents, and calculate mask
+	R3051_flushSyncCycles(cpu);
 	int32_t tempVal = SystemInterlink_readWord(cpu->system, tempAddress);
-	int32_t mask = ~(0xFFFFFFFF << (byteShiftIndex * 8));
+	int32_t mask = ~logical_rshift(0xFFFFFFFF, (byteShiftIndex * 8));
 	tempVal &= mask;
 
 	// Merge contents
@@ -2103,15 +2393,13 @@ static void R3051_SWR(R3051 *cpu, int32_t instruction)
 	int32_t byteShiftIndex = (int32_t)(address & 0x3);
 	int32_t tempWord = cpu->generalRegisters[rt];
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
-	// Shift word value right by required amount
-	tempWord = logical_rshift(tempWord, (byteShiftIndex * 8));
+	// Shift word value left by required amount
+	tempWord = tempWord << (byteShiftIndex * 8);
 
-	// Fetch rt contents, and calculate mask
+	// Fetch memory contents, and calculate mask
+	R3051_flushSyncCycles(cpu);
 	int32_t tempVal = SystemInterlink_readWord(cpu->system, tempAddress);
-	int32_t mask = ~logical_rshift(0xFFFFFFFF, (byteShiftIndex * 8));
+	int32_t mask = ~(0xFFFFFFFF << (byteShiftIndex * 8));
 	tempVal &= mask;
 
 	// Merge contents
@@ -2168,6 +2456,201 @@ static void R3051_XORI(R3051 *cpu, int32_t instruction)
 	cpu->generalRegisters[0] = 0;
 }
 
+/*
+ * This function works out which handler implements an instruction, so that
+ * the cached interpreter can skip the decoding switch on later visits.
+ * Instructions whose behaviour depends on co-processor state are left to
+ * R3051_executeUndecodedOpcode, as are those which always throw exceptions.
+ */
+static R3051InstructionHandler R3051_decodeInstruction(int32_t instruction)
+{
+	// Deal with opcode
+	int32_t opcode = logical_rshift(instruction, 26);
+	switch (opcode) {
+		case 0: // SPECIAL
+			switch (instruction & 0x3F) {
+				case 0: return R3051_SLL;
+				case 2: return R3051_SRL;
+				case 3: return R3051_SRA;
+				case 4: return R3051_SLLV;
+				case 6: return R3051_SRLV;
+				case 7: return R3051_SRAV;
+				case 8: return R3051_JR;
+				case 9: return R3051_JALR;
+				case 12: return R3051_SYSCALL;
+				case 13: return R3051_BREAK;
+				case 16: return R3051_MFHI;
+				case 17: return R3051_MTHI;
+				case 18: return R3051_MFLO;
+				case 19: return R3051_MTLO;
+				case 24: return R3051_MULT;
+				case 25: return R3051_MULTU;
+				case 26: return R3051_DIV;
+				case 27: return R3051_DIVU;
+				case 32: return R3051_ADD;
+				case 33: return R3051_ADDU;
+				case 34: return R3051_SUB;
+				case 35: return R3051_SUBU;
+				case 36: return R3051_AND;
+				case 37: return R3051_OR;
+				case 38: return R3051_XOR;
+				case 39: return R3051_NOR;
+				case 42: return R3051_SLT;
+				case 43: return R3051_SLTU;
+			}
+			break;
+		case 1: // BCOND
+			switch (logical_rshift(instruction, 16) & 0x1F) {
+				case 0: return R3051_BLTZ;
+				case 1: return R3051_BGEZ;
+				case 16: return R3051_BLTZAL;
+				case 17: return R3051_BGEZAL;
+			}
+			break;
+		case 2: return R3051_J;
+		case 3: return R3051_JAL;
+		case 4: return R3051_BEQ;
+		case 5: return R3051_BNE;
+		case 6: return R3051_BLEZ;
+		case 7: return R3051_BGTZ;
+		case 8: return R3051_ADDI;
+		case 9: return R3051_ADDIU;
+		case 10: return R3051_SLTI;
+		case 11: return R3051_SLTIU;
+		case 12: return R3051_ANDI;
+		case 13: return R3051_ORI;
+		case 14: return R3051_XORI;
+		case 15: return R3051_LUI;
+		case 32: return R3051_LB;
+		case 33: return R3051_LH;
+		case 34: return R3051_LWL;
+		case 35: return R3051_LW;
+		case 36: return R3051_LBU;
+		case 37: return R3051_LHU;
+		case 38: return R3051_LWR;
+		case 40: return R3051_SB;
+		case 41: return R3051_SH;
+		case 42: return R3051_SWL;
+		case 43: return R3051_SW;
+		case 46: return R3051_SWR;
+		case 50: return R3051_LWC2;
+		case 58: return R3051_SWC2;
+	}
+
+	// Anything else goes through the full decoder
+	return R3051_executeUndecodedOpcode;
+}
+
+/*
+ * This function checks if the block just run was one iteration of an idle
+ * loop, meaning it branched back to its own start, had no side effects and
+ * left the registers as they were. Every iteration after that is the same
+ * until an event happens, so we skip the cycle count straight to it.
+ */
+static void R3051_detectIdleLoop(R3051 *cpu, int32_t blockAddress)
+{
+	// Blocks end just after their branch, so only a taken branch leaving us
+	// back at the delay slot we started from can be an idle loop
+	if (cpu->programCounter != blockAddress || cpu->hadSideEffects ||
+			!cpu->jumpPending) {
+		cpu->idleLoopValid = false;
+		return;
+	}
+
+	// Skip ahead if registers haven't changed since the last iteration
+	if (cpu->idleLoopValid && cpu->idleLoopAddress == blockAddress &&
+			cpu->idleHiReg == cpu->hiReg && cpu->idleLoReg == cpu->loReg &&
+			memcmp(cpu->idleGeneralRegisters, cpu->generalRegisters,
+			sizeof(cpu->generalRegisters)) == 0) {
+		int64_t skippedCycles = SystemInterlink_skipToNextEvent(cpu->system,
+				cpu->totalCycles);
+		cpu->totalCycles += skippedCycles;
+		cpu->idleCyclesSkipped += skippedCycles;
+		return;
+	}
+
+	// Otherwise store register state to compare against next time round
+	cpu->idleLoopValid = true;
+	cpu->idleLoopAddress = blockAddress;
+	cpu->idleHiReg = cpu->hiReg;
+	cpu->idleLoReg = cpu->loReg;
+	memcpy(cpu->idleGeneralRegisters, cpu->generalRegisters,
+			sizeof(cpu->generalRegisters));
+}
+
+/*
+ * This function runs the cached block at the current program counter using
+ * whichever execution mode is selected, and is followed by the branch delay
+ * slot being interpreted. It returns false if no block could be run.
+ */
+static bool R3051_executeBlock(R3051 *cpu)
+{
+	if (cpu->executionMode == PHILPSX_R3051_MODE_RECOMPILER)
+		return R3051Jit_executeBlock(cpu->jit, cpu);
+	else
+		return R3051_executeCachedBlock(cpu);
+}
+
+/*
+ * This function runs the block at the current program counter through its
+ * pre-decoded instructions, decoding it first if this is the first visit.
+ * Cycle counts are the same as if each instruction had been interpreted.
+ */
+static bool R3051_executeCachedBlock(R3051 *cpu)
+{
+	// Find block
+	R3051Block *block = R3051BlockCache_getBlock(cpu->blockCache, cpu);
+	if (!block)
+		return false;
+
+	// Decode block if we need to
+	if (!block->data) {
+		R3051DecodedInstruction *decoded = calloc(block->instructionCount,
+				sizeof(R3051DecodedInstruction));
+		if (!decoded) {
+			fprintf(stderr, "PhilPSX: R3051: Couldn't allocate memory for "
+					"decoded block\n");
+			return false;
+		}
+		for (int32_t i = 0; i < block->instructionCount; ++i) {
+			const int8_t *bytes = block->sourceBytes + i * 4;
+			int32_t instruction = (bytes[0] & 0xFF) |
+					((bytes[1] & 0xFF) << 8) |
+					((bytes[2] & 0xFF) << 16) |
+					((bytes[3] & 0xFF) << 24);
+			decoded[i].handler = R3051_decodeInstruction(instruction);
+			decoded[i].instruction = instruction;
+			decoded[i].needsRevalidation =
+					R3051BlockCache_needsRevalidation(instruction);
+		}
+		block->data = decoded;
+	}
+
+	// Run instructions, leaving the block early if one of them didn't fall
+	// through to the next or might have changed the code
+	R3051DecodedInstruction *decoded = block->data;
+	for (int32_t i = 0; i < block->instructionCount; ++i) {
+		// Account for the fetch
+		cpu->cycles = block->stallCycles[i];
+		cpu->totalCycles += block->stallCycles[i];
+
+		// Execute and deal with the aftermath
+		decoded[i].handler(cpu, decoded[i].instruction);
+		R3051_finishInstruction(cpu);
+
+		// Check we can carry on
+		int32_t nextAddress = block->virtualAddress + (i + 1) * 4;
+		if (i == block->instructionCount - 1 ||
+				cpu->programCounter != nextAddress)
+			break;
+		if (decoded[i].needsRevalidation &&
+				!R3051Block_revalidate(block, cpu, i + 1))
+			break;
+	}
+
+	return true;
+}
+
 /*
  * This function executes an opcode in interpretive mode.
  */
@@ -2631,6 +3114,83 @@ static void R3051_executeOpcode(R3051 *cpu, int32_t instruction,
 	}
 }
 
+
+/*
+ * This function executes an instruction which has no handler of its own,
+ * by going through the full decoder.
+ */
+static void R3051_executeUndecodedOpcode(R3051 *cpu, int32_t instruction)
+{
+	int32_t tempBranchAddress =
+			(int32_t)((cpu->programCounter & 0xFFFFFFFFL) - 4L);
+	R3051_executeOpcode(cpu, instruction, tempBranchAddress);
+}
+
+/*
+ * This function deals with the aftermath of an executed instruction,
+ * handling exceptions, interrupts, the program counter and cycle counts.
+ */
+static void R3051_finishInstruction(R3051 *cpu)
+{
+	// Count the instruction
+	++cpu->instructionCount;
+
+	// Handle exception if there was one
+	if (R3051_handleException(cpu)) {
+		PHILPSX_PERF_ADD(PHILPSX_PERF_EXCEPTIONS, 1);
+		cpu->hadSideEffects = true;
+		cpu->cycles += 1;
+		cpu->totalCycles += 1;
+		R3051_appendSyncCycles(cpu, cpu->cycles);
+		return;
+	}
+
+	// Handle interrupt if there was one
+	if (cpu->isBranch && R3051_handleInterrupts(cpu)) {
+		PHILPSX_PERF_ADD(PHILPSX_PERF_INTERRUPTS, 1);
+		cpu->hadSideEffects = true;
+		cpu->cycles += 1;
+		cpu->totalCycles += 1;
+		R3051_appendSyncCycles(cpu, cpu->cycles);
+		return;
+	}
+
+	// Jump if pending, else add four to program counter
+	if (cpu->jumpPending && cpu->prevWasBranch) {
+		cpu->programCounter = cpu->jumpAddress;
+		cpu->jumpPending = false;
+	} else {
+		int32_t tempAddress =
+				(int32_t)((cpu->programCounter & 0xFFFFFFFFL) + 4L);
+		cpu->programCounter = tempAddress;
+	}
+
+	// Increment cycle count
+	cpu->cycles += (cpu->gteCycles == 0) ? 1 : cpu->gteCycles;
+	cpu->totalCycles += (cpu->gteCycles == 0) ? 1 : cpu->gteCycles;
+	cpu->gteCycles = 0;
+
+	// Setup whether the instruction just gone was a branch, and clear
+	// current branch status
+	cpu->prevWasBranch = cpu->isBranch;
+	cpu->isBranch = false;
+
+	// Return number of cycles instruction took
+	R3051_appendSyncCycles(cpu, cpu->cycles);
+}
+
+/*
+ * This function hands on any cycles the system hasn't been told about yet.
+ */
+static void R3051_flushSyncCycles(R3051 *cpu)
+{
+	if (cpu->pendingSyncCycles != 0) {
+		SystemInterlink_appendSyncCycles(cpu->system,
+				(int32_t)cpu->pendingSyncCycles);
+		cpu->pendingSyncCycles = 0;
+	}
+}
+
 /*
  * This function returns the hi register.
  */
@@ -2922,67 +3482,116 @@ static bool R3051_handleException(R3051 *cpu)
  */
 static bool R3051_handleInterrupts(R3051 *cpu)
 {
-	// Resync system timers
-	SystemInterlink_resyncAllTimers(cpu->system);
+	// Handle any system events that are due, noting that this block can't
+	// then be an idle loop as it may have seen state change underneath it
+	R3051_flushSyncCycles(cpu);
+	if (SystemInterlink_processEvents(cpu->system))
+		cpu->hadSideEffects = true;
 
-	// Resync GPU
-	SystemInterlink_executeGPUCycles(cpu->system);
+	// Pass the system's interrupt line on to bit 10 of the COP0 cause
+	// register, which only does any work when the line has changed
+	Cop0_setInterruptLine(&cpu->sccp,
+			SystemInterlink_irqLineAsserted(cpu->system));
 
-	// Increment all interrupt counters
-	SystemInterlink_incrementInterruptCounters(cpu->system);
+	// Signal that no interrupt occurred if none is pending and enabled
+	if (!Cop0_isInterruptPending(&cpu->sccp))
+		return false;
 
-	// Get interrupt status and mask registers
-	int32_t interruptStatus = R3051_swapWordEndianness(
-			cpu,
-			SystemInterlink_readWord(cpu->system, 0x1F801070)
-			) & 0x7FF;
-	int32_t interruptMask = R3051_swapWordEndianness(
-			cpu,
-			SystemInterlink_readWord(cpu->system, 0x1F801074)
-			) & 0x7FF;
+	// Trigger interrupt
+	cpu->exception.exceptionReason = PHILPSX_EXCEPTION_INT;
+	cpu->exception.programCounterOrigin = cpu->programCounter;
+	cpu->exception.isInBranchDelaySlot = cpu->prevWasBranch;
+	R3051_handleException(cpu);
 
-	// Mask the interrupt status register
-	interruptStatus &= interruptMask;
+	// Signal that interrupt occurred and was handled by exception routine
+	return true;
+}
 
-	// Set bit 10 of COP0 cause register if needed
-	if (interruptStatus != 0) {
-		int32_t causeRegister = Cop0_readReg(&cpu->sccp, 13);
-		causeRegister |= 0x400;
-		Cop0_writeReg(&cpu->sccp, 13, causeRegister, true);
-	} else {
-		int32_t causeRegister = Cop0_readReg(&cpu->sccp, 13);
-		causeRegister &= 0xFFFFFBFF;
-		Cop0_writeReg(&cpu->sccp, 13, causeRegister, true);
+/*
+ * This function fetches and interprets a single instruction.
+ */
+static void R3051_interpretInstruction(R3051 *cpu)
+{
+	// Setup cycle count and instruction
+	cpu->cycles = 0;
+	int32_t instruction = 0;
+
+	// Check address is OK, throwing exception if not
+	int32_t tempAddress =
+			(int32_t)((cpu->programCounter & 0xFFFFFFFFL) - 4L);
+
+	// Perform read of instruction
+	int64_t tempInstruction = R3051_readInstructionWord(
+			cpu,
+			cpu->programCounter,
+			tempAddress
+			);
+	if (tempInstruction == -1L) {
+		cpu->cycles += 1;
+		cpu->totalCycles += 1;
+		R3051_appendSyncCycles(cpu, cpu->cycles);
+		return;
 	}
 
-	// Get status reg and cause reg from COP0
-	int32_t statusRegister = Cop0_readReg(&cpu->sccp, 12);
-	int32_t causeRegister = Cop0_readReg(&cpu->sccp, 13);
+	// Cast long to int
+	instruction = (int32_t)tempInstruction;
 
-	// Check if interrupts are enabled, if not then do nothing
-	if ((statusRegister & 0x1) == 0x1) {
+	// Execute and deal with the aftermath
+	R3051_completeInstruction(cpu, instruction, tempAddress);
+}
 
-		// Use IM mask from status register to mask interrupt bits
-		// in cause register
-		statusRegister &= 0x0000FF00;
-		causeRegister &= 0x0000FF00;
-		causeRegister &= statusRegister;
+/*
+ * This function fills in the page table from the system's RAM and BIOS
+ * arrays, for kuseg, kseg0 and kseg1. Everything else (including scratchpad,
+ * which is smaller than a page and can be disabled) is left unmapped so it
+ * goes through the system interlink, as are pages the debugger is watching.
+ */
+void R3051_mapMemoryPages(R3051 *cpu)
+{
+	// Clear existing mappings
+	memset(cpu->memoryPages, 0,
+			PHILPSX_R3051_PAGE_COUNT * sizeof(R3051MemoryPage));
+	cpu->codePages = SystemInterlink_getCodePageBitmap(cpu->system);
 
-		// If resulting value is non-zero, trigger interrupt
-		if (causeRegister != 0) {
-			cpu->exception.exceptionReason = PHILPSX_EXCEPTION_INT;
-			cpu->exception.programCounterOrigin = cpu->programCounter;
-			cpu->exception.isInBranchDelaySlot = cpu->prevWasBranch;
-			R3051_handleException(cpu);
+	int8_t *ram = SystemInterlink_getRamArray(cpu->system);
+	int8_t *bios = SystemInterlink_getBiosArray(cpu->system);
+	const int64_t segments[] = {0x00000000L, 0x80000000L, 0xA0000000L};
 
-			// Signal that interrupt occurred and was handled
-			// by exception routine
-			return true;
+	for (int32_t i = 0; i < 3; ++i) {
+		bool cacheable = Cop0_isCacheable(&cpu->sccp,
+				(int32_t)segments[i]);
+
+		// Map RAM, which is readable and writable
+		for (int32_t offset = 0; offset < 0x200000;
+				offset += PHILPSX_R3051_PAGE_SIZE) {
+			R3051MemoryPage *page = &cpu->memoryPages[
+					(segments[i] + offset) >> PHILPSX_R3051_PAGE_SHIFT];
+			page->readData = ram + offset;
+			page->writeData = ram + offset;
+			page->physicalAddress = offset;
+			page->stallCycles = SystemInterlink_howManyStallCycles(
+					cpu->system, offset);
+			page->cacheable = cacheable;
+		}
+
+		// Map BIOS, which is read-only
+		for (int32_t offset = 0; offset < 0x80000;
+				offset += PHILPSX_R3051_PAGE_SIZE) {
+			R3051MemoryPage *page = &cpu->memoryPages[
+					(segments[i] + 0x1FC00000L + offset) >>
+					PHILPSX_R3051_PAGE_SHIFT];
+			page->readData = bios + offset;
+			page->writeData = NULL;
+			page->physicalAddress = 0x1FC00000 + offset;
+			page->stallCycles = SystemInterlink_howManyStallCycles(
+					cpu->system, page->physicalAddress);
+			page->cacheable = cacheable;
 		}
 	}
 
-	// Signal that no interrupt occurred
-	return false;
+	// Leave pages with watchpoints to the slow path
+	if (cpu->debugger)
+		R3051Debugger_unmapWatchedPages(cpu->debugger);
 }
 
 /*
@@ -2997,9 +3606,42 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 	// Get cache control register and other related values
 	bool dataCacheIsolated = Cop0_isDataCacheIsolated(&cpu->sccp);
 
-	// Get physical address
+	// Read RAM and BIOS straight from the page table if we can
+	R3051MemoryPage *page = &cpu->memoryPages[
+			logical_rshift(address, PHILPSX_R3051_PAGE_SHIFT)];
+	if (page->readData && !dataCacheIsolated) {
+		int8_t *data = page->readData +
+				(address & (PHILPSX_R3051_PAGE_SIZE - 1));
+		switch (width) {
+			case PHILPSX_R3051_BYTE:
+				value = data[0] & 0xFF;
+				break;
+			case PHILPSX_R3051_HALFWORD:
+				value = read_le_halfword(data);
+				break;
+			case PHILPSX_R3051_WORD:
+				value = read_le_word(page->readData +
+						(address & (PHILPSX_R3051_PAGE_SIZE - 4)));
+				break;
+		}
+		cpu->cycles += page->stallCycles;
+		cpu->totalCycles += page->stallCycles;
+		return value;
+	}
+
+	// Get physical address, and check it against any watchpoints
 	int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address);
 	int64_t tempPhysicalAddress = physicalAddress & 0xFFFFFFFFL;
+	if (cpu->debugger)
+		R3051Debugger_checkAccess(cpu->debugger, physicalAddress, false);
+
+	// Apart from scratchpad and the interrupt registers, anything read from
+	// here may change without an event happening, so polling it is not idle
+	if (dataCacheIsolated ||
+			((tempPhysicalAddress < 0x1F800000L ||
+			tempPhysicalAddress >= 0x1F800400L) &&
+			(tempPhysicalAddress & 0xFFFFFFF8L) != 0x1F801070L))
+		cpu->hadSideEffects = true;
 
 	// Is cache isolated? Although we don't have a data cache (it is used as
 	// scratchpad instead) we should read from instruction cache if so
@@ -3019,10 +3661,10 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 						(int32_t)tempPhysicalAddress
 						);
 				++tempPhysicalAddress;
-				value = (value << 8) | (0xFF & InstructionCache_readByte(
+				value |= (0xFF & InstructionCache_readByte(
 						&cpu->instructionCache,
 						(int32_t)tempPhysicalAddress
-						));
+						)) << 8;
 				break;
 			case PHILPSX_R3051_WORD:
 				value = InstructionCache_readWord(&cpu->instructionCache,
@@ -3046,15 +3688,10 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 							);
 					break;
 				case PHILPSX_R3051_HALFWORD:
-					value = 0xFF & SystemInterlink_readByte(
+					value = SystemInterlink_readHalfWord(
 							cpu->system,
-							(int32_t)tempPhysicalAddress
+							physicalAddress
 							);
-					++tempPhysicalAddress;
-					value = (value << 8) | (0xFF & SystemInterlink_readByte(
-							cpu->system,
-							(int32_t)tempPhysicalAddress
-							));
 					break;
 				case PHILPSX_R3051_WORD:
 					value = SystemInterlink_readWord(
@@ -3067,7 +3704,8 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 			return value;
 		}
 
-		// Read from system
+		// Read from system, which must first be brought up to date
+		R3051_flushSyncCycles(cpu);
 		int32_t delayCycles = SystemInterlink_howManyStallCycles(
 				cpu->system,
 				physicalAddress
@@ -3084,19 +3722,10 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 						);
 				break;
 			case PHILPSX_R3051_HALFWORD:
-				value = 0xFF & SystemInterlink_readByte(
+				value = SystemInterlink_readHalfWord(
 						cpu->system,
-						(int32_t)tempPhysicalAddress
+						physicalAddress
 						);
-				tempPhysicalAddress =
-						SystemInterlink_okToIncrement(
-						cpu->system,
-						tempPhysicalAddress) ?
-							tempPhysicalAddress + 1 : tempPhysicalAddress;
-				value = (value << 8) | (0xFF & SystemInterlink_readByte(
-						cpu->system,
-						(int32_t)tempPhysicalAddress
-						));
 				break;
 			case PHILPSX_R3051_WORD:
 				value = SystemInterlink_readWord(cpu->system, physicalAddress);
@@ -3141,11 +3770,23 @@ static int64_t R3051_readInstructionWord(R3051 *cpu, int32_t address,
 	bool instructionCacheEnabled =
 			SystemInterlink_instructionCacheEnabled(cpu->system);
 
-	// Get physical address
-	int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address);
+	// Get physical address and cacheability, from the page table if the
+	// address is mapped
+	R3051MemoryPage *page = &cpu->memoryPages[
+			logical_rshift(address, PHILPSX_R3051_PAGE_SHIFT)];
+	int32_t physicalAddress;
+	bool cacheable;
+	if (page->readData) {
+		physicalAddress = page->physicalAddress +
+				(address & (PHILPSX_R3051_PAGE_SIZE - 1));
+		cacheable = page->cacheable;
+	} else {
+		physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address);
+		cacheable = Cop0_isCacheable(&cpu->sccp, address);
+	}
 
 	// Check if address is cacheable or not
-	if (Cop0_isCacheable(&cpu->sccp, address) && instructionCacheEnabled) {
+	if (cacheable && instructionCacheEnabled) {
 
 		// Check cache for hit
 		if (InstructionCache_checkForHit(&cpu->instructionCache,
@@ -3163,19 +3804,20 @@ static int64_t R3051_readInstructionWord(R3051 *cpu, int32_t address,
 			} else {
 				// Begin transaction
 
-				cpu->cycles += SystemInterlink_howManyStallCycles(
-						cpu->system,
-						physicalAddress
-						);
-				cpu->totalCycles += SystemInterlink_howManyStallCycles(
+				int32_t stallCycles = page->readData ? page->stallCycles :
+						SystemInterlink_howManyStallCycles(
 						cpu->system,
 						physicalAddress
 						);
+				cpu->cycles += stallCycles;
+				cpu->totalCycles += stallCycles;
 				InstructionCache_refillLine(
 						&cpu->instructionCache,
 						&cpu->sccp,
 						cpu->system,
-						physicalAddress
+						physicalAddress,
+						page->readData ? page->readData + (address &
+							(PHILPSX_R3051_PAGE_SIZE - 16)) : NULL
 						);
 				wordVal = InstructionCache_readWord(
 						&cpu->instructionCache,
@@ -3195,15 +3837,22 @@ static int64_t R3051_readInstructionWord(R3051 *cpu, int32_t address,
 		} else {
 			// Begin transaction
 
-			cpu->cycles += SystemInterlink_howManyStallCycles(
-					cpu->system,
-					physicalAddress
-					);
-			cpu->totalCycles += SystemInterlink_howManyStallCycles(
-					cpu->system,
-					physicalAddress
-					);
-			wordVal = SystemInterlink_readWord(cpu->system, physicalAddress);
+			if (page->readData) {
+				wordVal = read_le_word(page->readData +
+						(address & (PHILPSX_R3051_PAGE_SIZE - 4)));
+				cpu->cycles += page->stallCycles;
+				cpu->totalCycles += page->stallCycles;
+			} else {
+				int32_t stallCycles = SystemInterlink_howManyStallCycles(
+						cpu->system,
+						physicalAddress
+						);
+				cpu->cycles += stallCycles;
+				cpu->totalCycles += stallCycles;
+				R3051_flushSyncCycles(cpu);
+				wordVal = SystemInterlink_readWord(cpu->system,
+						physicalAddress);
+			}
 
 			// End transaction
 		}
@@ -3221,19 +3870,6 @@ static void R3051_reset(R3051 *cpu)
 	cpu->programCounter = Cop0_getResetExceptionVector(&cpu->sccp);
 }
 
-/*
- * This is a utility function to swap the endianness of a word. It can be
- * used to allow the processor to operate in both endian modes by transparently
- * swapping the byte order before writing or after writing.
- */
-static int32_t R3051_swapWordEndianness(R3051 *cpu, int32_t word)
-{
-	return (word << 24) |
-			((word << 8) & 0xFF0000) |
-			(logical_rshift(word, 8) & 0xFF00) |
-			(logical_rshift(word, 24) & 0xFF);
-}
-
 /*
  * This instruction writes a data value of the specified width, and abstracts
  * this functionality from the MEM stage.
@@ -3241,12 +3877,46 @@ static int32_t R3051_swapWordEndianness(R3051 *cpu, int32_t word)
 static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 		int32_t value)
 {
+	// Writes always have side effects as far as idle loops are concerned
+	cpu->hadSideEffects = true;
+
 	// Get cache control register and other related values
 	bool dataCacheIsolated = Cop0_isDataCacheIsolated(&cpu->sccp);
 
-	// Get physical address
+	// Write RAM straight through the page table if we can, invalidating
+	// any cached code in the page
+	R3051MemoryPage *page = &cpu->memoryPages[
+			logical_rshift(address, PHILPSX_R3051_PAGE_SHIFT)];
+	if (page->writeData && !dataCacheIsolated) {
+		int32_t offset = address & (PHILPSX_R3051_PAGE_SIZE - 1);
+		int8_t *data = page->writeData + offset;
+		switch (width) {
+			case PHILPSX_R3051_BYTE:
+				data[0] = (int8_t)value;
+				break;
+			case PHILPSX_R3051_HALFWORD:
+				write_le_halfword(data, value);
+				break;
+			case PHILPSX_R3051_WORD:
+				offset &= ~3;
+				write_le_word(page->writeData + offset, value);
+				break;
+		}
+		int32_t physicalAddress = page->physicalAddress + offset;
+		if (cpu->codePages[logical_rshift(physicalAddress, 17)] &
+				(1U << (logical_rshift(physicalAddress, 12) & 0x1F)))
+			SystemInterlink_invalidateCode(cpu->system, physicalAddress,
+					width / 8);
+		cpu->cycles += page->stallCycles;
+		cpu->totalCycles += page->stallCycles;
+		return;
+	}
+
+	// Get physical address, and check it against any watchpoints
 	int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address);
 	int64_t tempPhysicalAddress = physicalAddress & 0xFFFFFFFFL;
+	if (cpu->debugger)
+		R3051Debugger_checkAccess(cpu->debugger, physicalAddress, true);
 
 	// Is cache isolated?
 	if (dataCacheIsolated) { // Yes
@@ -3266,14 +3936,14 @@ static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 						&cpu->instructionCache,
 						&cpu->sccp,
 						(int32_t)tempPhysicalAddress,
-						(int8_t)logical_rshift(value, 8)
+						(int8_t)value
 						);
 				++tempPhysicalAddress;
 				InstructionCache_writeByte(
 						&cpu->instructionCache,
 						&cpu->sccp,
 						(int32_t)tempPhysicalAddress,
-						(int8_t)value
+						(int8_t)logical_rshift(value, 8)
 						);
 				break;
 			case PHILPSX_R3051_WORD:
@@ -3302,16 +3972,11 @@ static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 							(int8_t)value);
 					break;
 				case PHILPSX_R3051_HALFWORD:
-					SystemInterlink_writeByte(
+					SystemInterlink_writeHalfWord(
 							cpu->system,
-							(int32_t)tempPhysicalAddress,
-							(int8_t)logical_rshift(value, 8)
+							physicalAddress,
+							value
 							);
-					++tempPhysicalAddress;
-					SystemInterlink_writeByte(
-							cpu->system,
-							(int32_t)tempPhysicalAddress,
-							(int8_t)value);
 					break;
 				case PHILPSX_R3051_WORD:
 					SystemInterlink_writeWord(
@@ -3325,7 +3990,8 @@ static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 			return;
 		}
 
-		// Write directly to system
+		// Write directly to system, which must first be brought up to date
+		R3051_flushSyncCycles(cpu);
 		int32_t delayCycles = SystemInterlink_howManyStallCycles(
 				cpu->system,
 				physicalAddress
@@ -3343,21 +4009,10 @@ static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 						);
 				break;
 			case PHILPSX_R3051_HALFWORD:
-				SystemInterlink_writeByte(
+				SystemInterlink_writeHalfWord(
 						cpu->system,
-						(int32_t)tempPhysicalAddress,
-						(int8_t)logical_rshift(value, 8)
-						);
-				tempPhysicalAddress =
-						SystemInterlink_okToIncrement(
-							cpu->system,
-							tempPhysicalAddress
-							) ?
-							tempPhysicalAddress + 1 : tempPhysicalAddress;
-				SystemInterlink_writeByte(
-						cpu->system,
-						(int32_t)tempPhysicalAddress,
-						(int8_t)value
+						physicalAddress,
+						value
 						);
 				break;
 			case PHILPSX_R3051_WORD:
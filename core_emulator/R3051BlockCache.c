@@ -0,0 +1,497 @@
+/*
+ * This C file models the block cache of the R3051 processor as a class. It
+ * finds the basic blocks of code the processor is about to run and keeps
+ * them checked against memory, so that the cached interpreter and the
+ * recompiler only need to translate each block once.
+ *
+ * R3051BlockCache.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/R3051BlockCache_all.h"
+#include "../headers/R3051_all.h"
+#include "../headers/Components.h"
+#include "../headers/SystemInterlink.h"
+#include "../headers/endian_utils.h"
+#include "../headers/math_utils.h"
+
+// Physical memory regions we can build blocks from
+#define PHILPSX_R3051BLOCKCACHE_RAM_SIZE 0x200000L
+#define PHILPSX_R3051BLOCKCACHE_BIOS_START 0x1FC00000L
+#define PHILPSX_R3051BLOCKCACHE_BIOS_SIZE 0x80000L
+
+// Forward declarations for functions and subcomponents private to this class
+// R3051Block-related stuff:
+static R3051Block *construct_R3051Block(R3051 *cpu, int32_t address,
+		int32_t physicalAddress, bool cached);
+static void destruct_R3051Block(R3051Block *block,
+		void (*destructBlockData)(void *data));
+static bool R3051Block_isResident(R3051Block *block, R3051 *cpu,
+		int32_t index);
+static bool R3051Block_isUnmodified(R3051Block *block, R3051 *cpu,
+		int32_t index);
+
+// R3051BlockCache-related stuff:
+static int32_t R3051BlockCache_decodeWord(const int8_t *bytes);
+static void R3051BlockCache_freeRetiredBlocks(R3051BlockCache *cache);
+static R3051Block **R3051BlockCache_getBlockSlot(R3051BlockCache *cache,
+		int32_t physicalAddress);
+static bool R3051BlockCache_isBlockTerminator(int32_t instruction);
+
+/*
+ * This constructs a new R3051BlockCache object. The supplied function is
+ * used to free the translated form of each block, and can be NULL if there
+ * is nothing to free.
+ */
+R3051BlockCache *construct_R3051BlockCache(
+		void (*destructBlockData)(void *data))
+{
+	// Allocate R3051BlockCache struct
+	R3051BlockCache *cache = malloc(sizeof(R3051BlockCache));
+	if (!cache) {
+		fprintf(stderr, "PhilPSX: R3051BlockCache: Couldn't allocate memory "
+				"for R3051BlockCache struct\n");
+		goto end;
+	}
+	cache->destructBlockData = destructBlockData;
+	cache->retiredBlocks = NULL;
+
+	// Allocate block lookup tables
+	cache->ramBlocks = calloc(PHILPSX_R3051BLOCKCACHE_RAM_SIZE / 4,
+			sizeof(R3051Block *));
+	if (!cache->ramBlocks) {
+		fprintf(stderr, "PhilPSX: R3051BlockCache: Couldn't allocate memory "
+				"for ramBlocks array\n");
+		goto cleanup_r3051blockcache;
+	}
+
+	cache->biosBlocks = calloc(PHILPSX_R3051BLOCKCACHE_BIOS_SIZE / 4,
+			sizeof(R3051Block *));
+	if (!cache->biosBlocks) {
+		fprintf(stderr, "PhilPSX: R3051BlockCache: Couldn't allocate memory "
+				"for biosBlocks array\n");
+		goto cleanup_ramblocks;
+	}
+
+	// Normal return:
+	return cache;
+
+	// Cleanup path:
+	cleanup_ramblocks:
+	free(cache->ramBlocks);
+
+	cleanup_r3051blockcache:
+	free(cache);
+	cache = NULL;
+
+	end:
+	return cache;
+}
+
+/*
+ * This destructs an R3051BlockCache object.
+ */
+void destruct_R3051BlockCache(R3051BlockCache *cache)
+{
+	R3051BlockCache_flush(cache);
+	free(cache->biosBlocks);
+	free(cache->ramBlocks);
+	free(cache);
+}
+
+/*
+ * This function throws away all blocks.
+ */
+void R3051BlockCache_flush(R3051BlockCache *cache)
+{
+	for (int32_t i = 0; i < PHILPSX_R3051BLOCKCACHE_RAM_SIZE / 4; ++i) {
+		if (cache->ramBlocks[i]) {
+			destruct_R3051Block(cache->ramBlocks[i],
+					cache->destructBlockData);
+			cache->ramBlocks[i] = NULL;
+		}
+	}
+	for (int32_t i = 0; i < PHILPSX_R3051BLOCKCACHE_BIOS_SIZE / 4; ++i) {
+		if (cache->biosBlocks[i]) {
+			destruct_R3051Block(cache->biosBlocks[i],
+					cache->destructBlockData);
+			cache->biosBlocks[i] = NULL;
+		}
+	}
+	R3051BlockCache_freeRetiredBlocks(cache);
+}
+
+/*
+ * This function returns the block starting at the current program counter,
+ * building it first if needed. It returns NULL if the block can't be run
+ * yet, in which case the interpreter should be used instead. A block
+ * returned with NULL data has not yet been translated. This must not be
+ * called from a branch delay slot.
+ */
+R3051Block *R3051BlockCache_getBlock(R3051BlockCache *cache, R3051 *cpu)
+{
+	// No block is running now, so blocks invalidated while one was can go
+	R3051BlockCache_freeRetiredBlocks(cache);
+
+	// Leave anything unusual to the interpreter, as it might stall or
+	// throw an exception during the fetch
+	int32_t address = cpu->programCounter;
+	if ((address & 0x3) != 0 ||
+			!Cop0_isAddressAllowed(&cpu->sccp, address) ||
+			cpu->busHolder != PHILPSX_COMPONENTS_CPU)
+		return NULL;
+
+	// Find block slot, only RAM and BIOS code can be cached
+	int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address);
+	R3051Block **slot = R3051BlockCache_getBlockSlot(cache, physicalAddress);
+	if (!slot)
+		return NULL;
+
+	// Work out whether instructions will come from the instruction cache
+	bool cached = Cop0_isCacheable(&cpu->sccp, address) &&
+			SystemInterlink_instructionCacheEnabled(cpu->system);
+
+	// Check any existing block is still the right one
+	R3051Block *block = *slot;
+	if (block) {
+		if (block->virtualAddress != address || block->cached != cached) {
+			destruct_R3051Block(block, cache->destructBlockData);
+			block = *slot = NULL;
+		} else if (cached && !R3051Block_isResident(block, cpu, 0)) {
+			// Let the interpreter refill the cache, but keep the block
+			return NULL;
+		} else if (block->verifyContents &&
+				!R3051Block_isUnmodified(block, cpu, 0)) {
+			destruct_R3051Block(block, cache->destructBlockData);
+			block = *slot = NULL;
+		}
+	}
+
+	// Build block if we need to
+	if (!block) {
+		block = construct_R3051Block(cpu, address, physicalAddress, cached);
+		*slot = block;
+	}
+
+	return block;
+}
+
+/*
+ * This function invalidates all blocks in the page containing the specified
+ * physical address, as it has been written to. A block that is currently
+ * running stays allocated until the next call to R3051BlockCache_getBlock,
+ * and R3051Block_revalidate tells it to stop.
+ */
+void R3051BlockCache_invalidatePage(R3051BlockCache *cache,
+		int32_t physicalAddress)
+{
+	R3051Block **slot = R3051BlockCache_getBlockSlot(cache,
+			physicalAddress & ~(PHILPSX_R3051BLOCKCACHE_PAGE_SIZE - 1));
+	if (!slot)
+		return;
+
+	for (int32_t i = 0; i < PHILPSX_R3051BLOCKCACHE_PAGE_SIZE / 4; ++i) {
+		R3051Block *block = slot[i];
+		if (block) {
+			block->invalidated = true;
+			block->nextRetired = cache->retiredBlocks;
+			cache->retiredBlocks = block;
+			slot[i] = NULL;
+		}
+	}
+}
+
+/*
+ * This function tells us if an instruction could change the code of the
+ * block it is in, or the way that code is fetched, in which case the rest
+ * of the block has to be revalidated after it.
+ */
+bool R3051BlockCache_needsRevalidation(int32_t instruction)
+{
+	int32_t opcode = logical_rshift(instruction, 26);
+	switch (opcode) {
+		case 16: // COP0
+		case 40: // SB
+		case 41: // SH
+		case 42: // SWL
+		case 43: // SW
+		case 46: // SWR
+		case 58: // SWC2
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * This function is called part way through a block after any instruction
+ * that could change the code or how it is fetched, and tells us whether the
+ * rest of the block from the specified instruction onwards can still be run.
+ */
+bool R3051Block_revalidate(R3051Block *block, R3051 *cpu, int32_t index)
+{
+	// Check the code hasn't been written to
+	if (block->invalidated)
+		return false;
+
+	// Check fetches are still allowed and still come from the same place
+	if (!Cop0_isAddressAllowed(&cpu->sccp, block->virtualAddress))
+		return false;
+	bool cached = Cop0_isCacheable(&cpu->sccp, block->virtualAddress) &&
+			SystemInterlink_instructionCacheEnabled(cpu->system);
+	if (cached != block->cached)
+		return false;
+
+	// Check instructions are still present and unchanged
+	if (cached && !R3051Block_isResident(block, cpu, index))
+		return false;
+
+	return !block->verifyContents ||
+			R3051Block_isUnmodified(block, cpu, index);
+}
+
+/*
+ * This constructs a new block starting at the specified address. It returns
+ * NULL if no instructions could be included.
+ */
+static R3051Block *construct_R3051Block(R3051 *cpu, int32_t address,
+		int32_t physicalAddress, bool cached)
+{
+	// Get pointer to the memory holding the code
+	int64_t tempPhysicalAddress = physicalAddress & 0xFFFFFFFFL;
+	int8_t *memory = NULL;
+	bool readOnly = false;
+	if (tempPhysicalAddress < PHILPSX_R3051BLOCKCACHE_RAM_SIZE) {
+		memory = SystemInterlink_getRamArray(cpu->system) +
+				tempPhysicalAddress;
+	} else {
+		memory = SystemInterlink_getBiosArray(cpu->system) +
+				(tempPhysicalAddress - PHILPSX_R3051BLOCKCACHE_BIOS_START);
+		readOnly = true;
+	}
+
+	// Work out how many instructions to include - we stop after a branch
+	// or jump (leaving the delay slot to the interpreter), at the end of a
+	// page, or at the first instruction not present in the cache
+	int32_t instructionCount = 0;
+	while (instructionCount < PHILPSX_R3051BLOCKCACHE_MAX_BLOCK_LENGTH) {
+		int32_t instructionAddress = physicalAddress + instructionCount * 4;
+		if (instructionCount > 0 && (instructionAddress &
+				(PHILPSX_R3051BLOCKCACHE_PAGE_SIZE - 1)) == 0)
+			break;
+		if (cached && !InstructionCache_checkForHit(&cpu->instructionCache,
+				instructionAddress))
+			break;
+
+		int32_t instruction = cached ?
+			InstructionCache_readWord(&cpu->instructionCache,
+				instructionAddress) :
+			R3051BlockCache_decodeWord(memory + instructionCount * 4);
+		++instructionCount;
+		if (R3051BlockCache_isBlockTerminator(instruction))
+			break;
+	}
+	if (instructionCount == 0)
+		goto end;
+
+	// Allocate block
+	R3051Block *block = malloc(sizeof(R3051Block));
+	if (!block) {
+		fprintf(stderr, "PhilPSX: R3051BlockCache: Couldn't allocate memory "
+				"for R3051Block struct\n");
+		goto end;
+	}
+	block->virtualAddress = address;
+	block->physicalAddress = physicalAddress;
+	block->instructionCount = instructionCount;
+	block->cached = cached;
+	block->memory = readOnly ? NULL : memory;
+	block->invalidated = false;
+	block->nextRetired = NULL;
+	block->data = NULL;
+
+	// Take a copy of the instruction bytes
+	block->sourceBytes = malloc(instructionCount * 4);
+	if (!block->sourceBytes) {
+		fprintf(stderr, "PhilPSX: R3051BlockCache: Couldn't allocate memory "
+				"for sourceBytes array\n");
+		goto cleanup_block;
+	}
+	if (cached) {
+		for (int32_t i = 0; i < instructionCount; ++i)
+			write_le_word(block->sourceBytes + i * 4,
+					InstructionCache_readWord(&cpu->instructionCache,
+					physicalAddress + i * 4));
+	} else {
+		memcpy(block->sourceBytes, memory, instructionCount * 4);
+	}
+
+	// Writes to memory invalidate the block from now on, and cache refills
+	// can only bring in what is in memory - so unless the cache is already
+	// stale, we never need to look at the contents again
+	block->verifyContents = cached &&
+			memcmp(block->sourceBytes, memory, instructionCount * 4) != 0;
+	if (!readOnly)
+		SystemInterlink_markCodePage(cpu->system, physicalAddress);
+
+	// Work out fetch stall cycles, cache hits don't stall
+	block->stallCycles = calloc(instructionCount, sizeof(int32_t));
+	if (!block->stallCycles) {
+		fprintf(stderr, "PhilPSX: R3051BlockCache: Couldn't allocate memory "
+				"for stallCycles array\n");
+		goto cleanup_sourcebytes;
+	}
+	if (!cached) {
+		for (int32_t i = 0; i < instructionCount; ++i)
+			block->stallCycles[i] = SystemInterlink_howManyStallCycles(
+					cpu->system, physicalAddress + i * 4);
+	}
+
+	// Normal return:
+	return block;
+
+	// Cleanup path:
+	cleanup_sourcebytes:
+	free(block->sourceBytes);
+
+	cleanup_block:
+	free(block);
+
+	end:
+	return NULL;
+}
+
+/*
+ * This destructs a block, along with its translated form if the supplied
+ * function is not NULL.
+ */
+static void destruct_R3051Block(R3051Block *block,
+		void (*destructBlockData)(void *data))
+{
+	if (block->data && destructBlockData)
+		destructBlockData(block->data);
+	free(block->stallCycles);
+	free(block->sourceBytes);
+	free(block);
+}
+
+/*
+ * This function tells us if the cache lines holding the block from the
+ * specified instruction onwards are all present in the instruction cache.
+ */
+static bool R3051Block_isResident(R3051Block *block, R3051 *cpu,
+		int32_t index)
+{
+	int64_t startAddress = (block->physicalAddress & 0xFFFFFFFFL) + index * 4;
+	int64_t endAddress = (block->physicalAddress & 0xFFFFFFFFL) +
+			block->instructionCount * 4;
+	for (int64_t lineAddress = startAddress & 0xFFFFFFF0L;
+			lineAddress < endAddress; lineAddress += 16) {
+		if (!InstructionCache_checkForHit(&cpu->instructionCache,
+				(int32_t)lineAddress))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * This function tells us if the instruction bytes of the block from the
+ * specified instruction onwards are the same as when it was built. This is
+ * only needed for blocks built from a stale instruction cache.
+ */
+static bool R3051Block_isUnmodified(R3051Block *block, R3051 *cpu,
+		int32_t index)
+{
+	// Work out how much to compare
+	int32_t offset = index * 4;
+	size_t length = (block->instructionCount - index) * 4;
+
+	// Compare against wherever the processor will be fetching from
+	if (block->cached) {
+		for (int32_t i = index; i < block->instructionCount; ++i) {
+			if (InstructionCache_readWord(&cpu->instructionCache,
+					block->physicalAddress + i * 4) !=
+					R3051BlockCache_decodeWord(block->sourceBytes + i * 4))
+				return false;
+		}
+		return true;
+	} else if (block->memory) {
+		return memcmp(block->memory + offset, block->sourceBytes + offset,
+				length) == 0;
+	}
+
+	// Read-only memory can't change
+	return true;
+}
+
+/*
+ * This function converts four instruction bytes as stored in memory into
+ * an instruction word.
+ */
+static int32_t R3051BlockCache_decodeWord(const int8_t *bytes)
+{
+	return read_le_word(bytes);
+}
+
+/*
+ * This function frees blocks that were invalidated while a block might have
+ * been running.
+ */
+static void R3051BlockCache_freeRetiredBlocks(R3051BlockCache *cache)
+{
+	while (cache->retiredBlocks) {
+		R3051Block *block = cache->retiredBlocks;
+		cache->retiredBlocks = block->nextRetired;
+		destruct_R3051Block(block, cache->destructBlockData);
+	}
+}
+
+/*
+ * This function returns the lookup table slot for a block starting at the
+ * specified physical address, or NULL if code there can't be cached.
+ */
+static R3051Block **R3051BlockCache_getBlockSlot(R3051BlockCache *cache,
+		int32_t physicalAddress)
+{
+	int64_t tempAddress = physicalAddress & 0xFFFFFFFFL;
+
+	if (tempAddress < PHILPSX_R3051BLOCKCACHE_RAM_SIZE) {
+		return &cache->ramBlocks[tempAddress >> 2];
+	} else if (tempAddress >= PHILPSX_R3051BLOCKCACHE_BIOS_START &&
+			tempAddress < PHILPSX_R3051BLOCKCACHE_BIOS_START +
+			PHILPSX_R3051BLOCKCACHE_BIOS_SIZE) {
+		return &cache->biosBlocks[(tempAddress -
+				PHILPSX_R3051BLOCKCACHE_BIOS_START) >> 2];
+	}
+
+	return NULL;
+}
+
+/*
+ * This function tells us if an instruction ends a block, which is the case
+ * for all branches and jumps as the interpreter returns after them.
+ */
+static bool R3051BlockCache_isBlockTerminator(int32_t instruction)
+{
+	int32_t opcode = logical_rshift(instruction, 26);
+	switch (opcode) {
+		case 0: // SPECIAL - JR and JALR
+			return (instruction & 0x3F) == 8 || (instruction & 0x3F) == 9;
+		case 1: // BCOND
+		case 2: // J
+		case 3: // JAL
+		case 4: // BEQ
+		case 5: // BNE
+		case 6: // BLEZ
+		case 7: // BGTZ
+			return true;
+		case 18: // COP2 - BC2F and BC2T
+			return (logical_rshift(instruction, 21) & 0x1F) == 8;
+	}
+
+	return false;
+}
@@ -0,0 +1,581 @@
+/*
+ * This C file models the debugger of the R3051 processor as a class.
+ * Breakpoints and watchpoints are kept as bitmaps with a bit for each word of
+ * a page, which are only allocated for pages that have any, so that the
+ * processor can tell whether a page needs looking at with one load.
+ *
+ * Breakpoints are by virtual address. The processor only asks about each
+ * instruction while any are set or a step is under way, and it interprets
+ * instructions on pages with breakpoints one at a time, so cached blocks and
+ * the recompiler can carry on elsewhere. Watchpoints are by physical
+ * address, and pages holding any are taken out of the processor's page
+ * table, so only their accesses reach the debugger on the slow path. With
+ * nothing set, the processor runs exactly as it would without a debugger.
+ *
+ * Everything here runs on the emulator thread - commands from elsewhere
+ * must be passed over to it.
+ *
+ * R3051Debugger.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/R3051Debugger.h"
+#include "../headers/R3051_all.h"
+#include "../headers/SystemInterlink.h"
+
+// Number of pages in the physical address space, which is mirrored across
+// kuseg, kseg0 and kseg1, and the size of each page's bitmap in words
+#define PHILPSX_R3051DEBUGGER_PHYSICAL_PAGE_COUNT \
+		(0x20000000 >> PHILPSX_R3051_PAGE_SHIFT)
+#define PHILPSX_R3051DEBUGGER_BITMAP_WORDS (PHILPSX_R3051_PAGE_SIZE / 4 / 32)
+
+// Most bytes shown by one memory command
+#define PHILPSX_R3051DEBUGGER_MAX_DUMP_LENGTH 4096
+
+// Forward declarations for functions private to this class
+static bool R3051Debugger_clearBit(uint32_t **bitmaps, int32_t address);
+static void R3051Debugger_halt(R3051Debugger *debugger, const char *reason);
+static bool R3051Debugger_readByte(R3051Debugger *debugger, int32_t address,
+		int32_t *value);
+static void R3051Debugger_resume(R3051Debugger *debugger);
+static bool R3051Debugger_setBit(uint32_t **bitmaps, int32_t address);
+static void R3051Debugger_showMemory(R3051Debugger *debugger,
+		int32_t address, int32_t length);
+static void R3051Debugger_showRegisters(R3051Debugger *debugger);
+static void R3051Debugger_updateArmed(R3051Debugger *debugger);
+
+// Names of the general registers
+static const char *const registerNames[32] = {
+	"zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+	"t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+	"s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+	"t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
+};
+
+/*
+ * This struct holds the breakpoints and watchpoints, along with what the
+ * processor is doing as far as the debugger is concerned.
+ */
+struct R3051Debugger {
+
+	// Processor being debugged
+	R3051 *cpu;
+
+	// Whether the processor is stopped, and whether it is stepping or running
+	// to an address - the breakpoint at the address it stopped at is skipped
+	// when it carries on
+	bool halted;
+	bool stepping;
+	int32_t stepsLeft;
+	bool runningTo;
+	int32_t runToAddress;
+	bool skipBreakpoint;
+
+	// Breakpoint bitmaps for each virtual page, and read and write watchpoint
+	// bitmaps for each physical page, NULL where a page has none
+	uint32_t **breakpoints;
+	uint32_t **readWatchpoints;
+	uint32_t **writeWatchpoints;
+	int32_t breakpointCount;
+};
+
+/*
+ * This constructs an R3051Debugger object for the given processor, with no
+ * breakpoints or watchpoints and the processor running.
+ */
+R3051Debugger *construct_R3051Debugger(R3051 *cpu)
+{
+	// Allocate R3051Debugger struct
+	R3051Debugger *debugger = malloc(sizeof(R3051Debugger));
+	if (!debugger) {
+		fprintf(stderr, "PhilPSX: R3051Debugger: Couldn't allocate memory "
+				"for R3051Debugger struct\n");
+		goto end;
+	}
+
+	// Allocate bitmap tables
+	debugger->breakpoints = calloc(PHILPSX_R3051_PAGE_COUNT,
+			sizeof(uint32_t *));
+	if (!debugger->breakpoints) {
+		fprintf(stderr, "PhilPSX: R3051Debugger: Couldn't allocate memory "
+				"for breakpoint table\n");
+		goto cleanup_debugger;
+	}
+	debugger->readWatchpoints = calloc(
+			PHILPSX_R3051DEBUGGER_PHYSICAL_PAGE_COUNT, sizeof(uint32_t *));
+	if (!debugger->readWatchpoints) {
+		fprintf(stderr, "PhilPSX: R3051Debugger: Couldn't allocate memory "
+				"for read watchpoint table\n");
+		goto cleanup_breakpoints;
+	}
+	debugger->writeWatchpoints = calloc(
+			PHILPSX_R3051DEBUGGER_PHYSICAL_PAGE_COUNT, sizeof(uint32_t *));
+	if (!debugger->writeWatchpoints) {
+		fprintf(stderr, "PhilPSX: R3051Debugger: Couldn't allocate memory "
+				"for write watchpoint table\n");
+		goto cleanup_readwatchpoints;
+	}
+
+	// Set other properties
+	debugger->cpu = cpu;
+	debugger->halted = false;
+	debugger->stepping = false;
+	debugger->stepsLeft = 0;
+	debugger->runningTo = false;
+	debugger->runToAddress = 0;
+	debugger->skipBreakpoint = false;
+	debugger->breakpointCount = 0;
+
+	// Normal return:
+	return debugger;
+
+	// Cleanup path:
+	cleanup_readwatchpoints:
+	free(debugger->readWatchpoints);
+
+	cleanup_breakpoints:
+	free(debugger->breakpoints);
+
+	cleanup_debugger:
+	free(debugger);
+	debugger = NULL;
+
+	end:
+	return debugger;
+}
+
+/*
+ * This destructs an R3051Debugger object.
+ */
+void destruct_R3051Debugger(R3051Debugger *debugger)
+{
+	for (int32_t i = 0; i < PHILPSX_R3051_PAGE_COUNT; ++i)
+		free(debugger->breakpoints[i]);
+	for (int32_t i = 0; i < PHILPSX_R3051DEBUGGER_PHYSICAL_PAGE_COUNT; ++i) {
+		free(debugger->readWatchpoints[i]);
+		free(debugger->writeWatchpoints[i]);
+	}
+	free(debugger->writeWatchpoints);
+	free(debugger->readWatchpoints);
+	free(debugger->breakpoints);
+	free(debugger);
+}
+
+/*
+ * This function checks a read or write of the given physical address
+ * against the watchpoints, stopping the processor if one is hit. It stops
+ * once the instruction making the access has finished, or at the end of the
+ * block under the cached interpreter or recompiler. It is called for every access the
+ * page table doesn't handle, so it must be quick for unwatched pages.
+ */
+void R3051Debugger_checkAccess(R3051Debugger *debugger,
+		int32_t physicalAddress, bool write)
+{
+	int32_t address = physicalAddress & 0x1FFFFFFF;
+	uint32_t *bitmap = (write ? debugger->writeWatchpoints :
+			debugger->readWatchpoints)[address >> PHILPSX_R3051_PAGE_SHIFT];
+	if (!bitmap)
+		return;
+
+	int32_t word = (address & (PHILPSX_R3051_PAGE_SIZE - 1)) >> 2;
+	if ((bitmap[word / 32] & (1U << (word % 32))) == 0)
+		return;
+
+	char reason[64];
+	snprintf(reason, sizeof(reason), "%s of 0x%08X",
+			write ? "Write" : "Read", address);
+	R3051Debugger_halt(debugger, reason);
+}
+
+/*
+ * This function decides what the processor should do about the instruction
+ * at its program counter. It is only called while the processor is armed,
+ * meaning it is stopped or stepping, or there is a breakpoint somewhere.
+ */
+int32_t R3051Debugger_checkExecution(R3051Debugger *debugger)
+{
+	if (debugger->halted)
+		return PHILPSX_R3051DEBUGGER_BREAK;
+
+	// The breakpoint we stopped at last (if any) is let through once
+	bool skipBreakpoint = debugger->skipBreakpoint;
+	debugger->skipBreakpoint = false;
+
+	// Stepping interprets every instruction until the count runs out
+	if (debugger->stepping) {
+		if (debugger->stepsLeft == 0) {
+			debugger->stepping = false;
+			R3051Debugger_halt(debugger, "Stepped");
+			return PHILPSX_R3051DEBUGGER_BREAK;
+		}
+		--debugger->stepsLeft;
+		return PHILPSX_R3051DEBUGGER_INTERPRET;
+	}
+
+	// Otherwise only pages with breakpoints or the address we are running to
+	// need looking at more closely
+	int32_t address = debugger->cpu->programCounter;
+	uint32_t page = (uint32_t)address >> PHILPSX_R3051_PAGE_SHIFT;
+	bool pageMarked = false;
+	if (debugger->runningTo &&
+			(uint32_t)debugger->runToAddress >> PHILPSX_R3051_PAGE_SHIFT ==
+			page) {
+		pageMarked = true;
+		if (address == debugger->runToAddress && !skipBreakpoint) {
+			debugger->runningTo = false;
+			R3051Debugger_halt(debugger, "Reached run-to address");
+			return PHILPSX_R3051DEBUGGER_BREAK;
+		}
+	}
+	uint32_t *bitmap = debugger->breakpoints[page];
+	if (bitmap) {
+		pageMarked = true;
+		int32_t word = (address & (PHILPSX_R3051_PAGE_SIZE - 1)) >> 2;
+		if ((bitmap[word / 32] & (1U << (word % 32))) && !skipBreakpoint) {
+			R3051Debugger_halt(debugger, "Breakpoint");
+			return PHILPSX_R3051DEBUGGER_BREAK;
+		}
+	}
+
+	return pageMarked ? PHILPSX_R3051DEBUGGER_INTERPRET :
+			PHILPSX_R3051DEBUGGER_RUN;
+}
+
+/*
+ * This function carries out a debugger command, with arguments as described
+ * by R3051Debugger_parseCommand.
+ */
+void R3051Debugger_handleCommand(R3051Debugger *debugger, int32_t command,
+		int32_t argument0, int32_t argument1)
+{
+	R3051 *cpu = debugger->cpu;
+
+	switch (command) {
+		case PHILPSX_R3051DEBUGGER_COMMAND_HALT:
+			if (!debugger->halted)
+				R3051Debugger_halt(debugger, "Halted");
+			break;
+		case PHILPSX_R3051DEBUGGER_COMMAND_CONTINUE:
+			R3051Debugger_resume(debugger);
+			break;
+		case PHILPSX_R3051DEBUGGER_COMMAND_STEP:
+			debugger->stepping = true;
+			debugger->stepsLeft = argument0 > 0 ? argument0 : 1;
+			R3051Debugger_resume(debugger);
+			break;
+		case PHILPSX_R3051DEBUGGER_COMMAND_RUN_TO:
+			debugger->runningTo = true;
+			debugger->runToAddress = argument0 & ~3;
+			R3051Debugger_resume(debugger);
+			break;
+		case PHILPSX_R3051DEBUGGER_COMMAND_BREAK:
+			if (R3051Debugger_setBit(debugger->breakpoints, argument0))
+				++debugger->breakpointCount;
+			printf("Breakpoint set at 0x%08X\n", argument0 & ~3);
+			break;
+		case PHILPSX_R3051DEBUGGER_COMMAND_WATCH_READ:
+		case PHILPSX_R3051DEBUGGER_COMMAND_WATCH_WRITE:
+		{
+			// Watch the physical address, taking its pages out of the page
+			// table
+			bool write = command == PHILPSX_R3051DEBUGGER_COMMAND_WATCH_WRITE;
+			int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp,
+					argument0) & 0x1FFFFFFF;
+			R3051Debugger_setBit(write ? debugger->writeWatchpoints :
+					debugger->readWatchpoints, physicalAddress);
+			R3051_mapMemoryPages(cpu);
+			printf("Watching %s of 0x%08X\n", write ? "writes" : "reads",
+					physicalAddress & ~3);
+			break;
+		}
+		case PHILPSX_R3051DEBUGGER_COMMAND_REMOVE:
+		{
+			// Clear everything at the address, putting pages back in the
+			// page table if they are no longer watched
+			int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp,
+					argument0) & 0x1FFFFFFF;
+			if (R3051Debugger_clearBit(debugger->breakpoints, argument0))
+				--debugger->breakpointCount;
+			if (R3051Debugger_clearBit(debugger->readWatchpoints,
+					physicalAddress) | R3051Debugger_clearBit(
+					debugger->writeWatchpoints, physicalAddress))
+				R3051_mapMemoryPages(cpu);
+			printf("Removed breakpoints and watchpoints at 0x%08X\n",
+					argument0 & ~3);
+			break;
+		}
+		case PHILPSX_R3051DEBUGGER_COMMAND_REGISTERS:
+			R3051Debugger_showRegisters(debugger);
+			break;
+		case PHILPSX_R3051DEBUGGER_COMMAND_MEMORY:
+			R3051Debugger_showMemory(debugger, argument0, argument1);
+			break;
+		case PHILPSX_R3051DEBUGGER_COMMAND_HELP:
+			printf("Debugger commands (addresses and counts in hex):\n"
+					"  h            halt\n"
+					"  c            continue\n"
+					"  s [N]        step N instructions (default 1)\n"
+					"  t ADDR       run to ADDR\n"
+					"  b ADDR       set breakpoint at ADDR\n"
+					"  rw ADDR      watch reads of ADDR\n"
+					"  ww ADDR      watch writes to ADDR\n"
+					"  d ADDR       remove breakpoints/watchpoints at ADDR\n"
+					"  r            show R3051, Cop0 and Cop2 registers\n"
+					"  m ADDR [N]   show N bytes of memory (default 40)\n");
+			break;
+	}
+
+	R3051Debugger_updateArmed(debugger);
+}
+
+/*
+ * This function returns true if the debugger has the processor stopped, in
+ * which case it shouldn't be asked to run until the debugger lets it go.
+ */
+bool R3051Debugger_isHalted(R3051Debugger *debugger)
+{
+	return debugger->halted;
+}
+
+/*
+ * This function turns a line of text typed by the user into a debugger
+ * command and its arguments, returning false if it isn't one. Addresses and
+ * counts are in hex: "h" halts, "c" continues, "s N" steps N instructions,
+ * "t ADDR" runs to an address, "b ADDR", "rw ADDR" and "ww ADDR" set a
+ * breakpoint or a read or write watchpoint, "d ADDR" removes them, "r" shows
+ * registers, "m ADDR N" shows N bytes of memory and "?" lists them all.
+ */
+bool R3051Debugger_parseCommand(const char *line, int32_t *command,
+		int32_t *argument0, int32_t *argument1)
+{
+	static const struct {
+		const char *name;
+		int32_t command;
+		int32_t requiredArguments;
+	} commands[] = {
+		{"h", PHILPSX_R3051DEBUGGER_COMMAND_HALT, 0},
+		{"c", PHILPSX_R3051DEBUGGER_COMMAND_CONTINUE, 0},
+		{"s", PHILPSX_R3051DEBUGGER_COMMAND_STEP, 0},
+		{"t", PHILPSX_R3051DEBUGGER_COMMAND_RUN_TO, 1},
+		{"b", PHILPSX_R3051DEBUGGER_COMMAND_BREAK, 1},
+		{"rw", PHILPSX_R3051DEBUGGER_COMMAND_WATCH_READ, 1},
+		{"ww", PHILPSX_R3051DEBUGGER_COMMAND_WATCH_WRITE, 1},
+		{"d", PHILPSX_R3051DEBUGGER_COMMAND_REMOVE, 1},
+		{"r", PHILPSX_R3051DEBUGGER_COMMAND_REGISTERS, 0},
+		{"m", PHILPSX_R3051DEBUGGER_COMMAND_MEMORY, 1},
+		{"?", PHILPSX_R3051DEBUGGER_COMMAND_HELP, 0}
+	};
+
+	// Split line into name and up to two arguments
+	char name[8];
+	unsigned int arguments[2] = {0, 0};
+	int fields = sscanf(line, "%7s %x %x", name, &arguments[0],
+			&arguments[1]);
+	if (fields < 1)
+		return false;
+
+	for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i) {
+		if (strcmp(name, commands[i].name) != 0)
+			continue;
+		if (fields - 1 < commands[i].requiredArguments)
+			return false;
+		*command = commands[i].command;
+		*argument0 = (int32_t)arguments[0];
+		*argument1 = fields > 2 ? (int32_t)arguments[1] : 0;
+		if (*command == PHILPSX_R3051DEBUGGER_COMMAND_MEMORY && fields < 3)
+			*argument1 = 0x40;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * This function takes every page with watchpoints out of the processor's
+ * page table, so that their accesses take the slow path past the debugger.
+ * It is called whenever the page table has been filled in.
+ */
+void R3051Debugger_unmapWatchedPages(R3051Debugger *debugger)
+{
+	R3051MemoryPage *pages = debugger->cpu->memoryPages;
+	for (int32_t i = 0; i < PHILPSX_R3051_PAGE_COUNT; ++i) {
+		if (!pages[i].readData)
+			continue;
+		int32_t physicalPage = (pages[i].physicalAddress & 0x1FFFFFFF) >>
+				PHILPSX_R3051_PAGE_SHIFT;
+		if (debugger->readWatchpoints[physicalPage])
+			pages[i].readData = NULL;
+		if (debugger->writeWatchpoints[physicalPage])
+			pages[i].writeData = NULL;
+	}
+}
+
+/*
+ * This function clears the bit for the word at the given address, freeing
+ * its page's bitmap once it is empty. It returns true if the bit was set.
+ */
+static bool R3051Debugger_clearBit(uint32_t **bitmaps, int32_t address)
+{
+	uint32_t page = (uint32_t)address >> PHILPSX_R3051_PAGE_SHIFT;
+	uint32_t *bitmap = bitmaps[page];
+	if (!bitmap)
+		return false;
+
+	int32_t word = (address & (PHILPSX_R3051_PAGE_SIZE - 1)) >> 2;
+	if ((bitmap[word / 32] & (1U << (word % 32))) == 0)
+		return false;
+	bitmap[word / 32] &= ~(1U << (word % 32));
+
+	// Free bitmap if nothing else on the page is marked
+	for (int32_t i = 0; i < PHILPSX_R3051DEBUGGER_BITMAP_WORDS; ++i)
+		if (bitmap[i])
+			return true;
+	free(bitmap);
+	bitmaps[page] = NULL;
+	return true;
+}
+
+/*
+ * This function stops the processor, showing why and where.
+ */
+static void R3051Debugger_halt(R3051Debugger *debugger, const char *reason)
+{
+	debugger->halted = true;
+	debugger->stepping = false;
+	debugger->cpu->debuggerArmed = true;
+
+	int32_t address = debugger->cpu->programCounter;
+	int32_t instruction = 0;
+	bool readable = true;
+	for (int32_t i = 0; i < 4; ++i) {
+		int32_t value;
+		readable &= R3051Debugger_readByte(debugger, address + i, &value);
+		instruction |= value << (i * 8);
+	}
+	if (readable)
+		printf("%s at 0x%08X (instruction 0x%08X)\n", reason, address,
+				instruction);
+	else
+		printf("%s at 0x%08X\n", reason, address);
+}
+
+/*
+ * This function reads a byte of RAM, BIOS or scratchpad at the given virtual
+ * address for showing, returning false if it is anywhere else, as reading
+ * I/O ports could change what they do.
+ */
+static bool R3051Debugger_readByte(R3051Debugger *debugger, int32_t address,
+		int32_t *value)
+{
+	R3051 *cpu = debugger->cpu;
+	int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address) &
+			0x1FFFFFFF;
+	if (physicalAddress < 0x200000 ||
+			(physicalAddress >= 0x1FC00000 && physicalAddress < 0x1FC80000) ||
+			(physicalAddress >= 0x1F800000 && physicalAddress < 0x1F800400)) {
+		*value = SystemInterlink_readByte(cpu->system, physicalAddress) &
+				0xFF;
+		return true;
+	}
+
+	*value = 0;
+	return false;
+}
+
+/*
+ * This function lets the processor carry on from where it stopped.
+ */
+static void R3051Debugger_resume(R3051Debugger *debugger)
+{
+	if (debugger->halted)
+		debugger->skipBreakpoint = true;
+	debugger->halted = false;
+}
+
+/*
+ * This function sets the bit for the word at the given address, allocating
+ * its page's bitmap if needed. It returns true if the bit wasn't already
+ * set.
+ */
+static bool R3051Debugger_setBit(uint32_t **bitmaps, int32_t address)
+{
+	uint32_t page = (uint32_t)address >> PHILPSX_R3051_PAGE_SHIFT;
+	if (!bitmaps[page]) {
+		bitmaps[page] = calloc(PHILPSX_R3051DEBUGGER_BITMAP_WORDS,
+				sizeof(uint32_t));
+		if (!bitmaps[page]) {
+			fprintf(stderr, "PhilPSX: R3051Debugger: Couldn't allocate "
+					"memory for page bitmap\n");
+			return false;
+		}
+	}
+
+	int32_t word = (address & (PHILPSX_R3051_PAGE_SIZE - 1)) >> 2;
+	bool wasSet = bitmaps[page][word / 32] & (1U << (word % 32));
+	bitmaps[page][word / 32] |= 1U << (word % 32);
+	return !wasSet;
+}
+
+/*
+ * This function shows the given number of bytes of memory from the given
+ * virtual address, sixteen to a line, with unreadable bytes as "--".
+ */
+static void R3051Debugger_showMemory(R3051Debugger *debugger,
+		int32_t address, int32_t length)
+{
+	if (length <= 0 || length > PHILPSX_R3051DEBUGGER_MAX_DUMP_LENGTH)
+		length = PHILPSX_R3051DEBUGGER_MAX_DUMP_LENGTH;
+
+	for (int32_t offset = 0; offset < length; offset += 16) {
+		printf("%08X:", address + offset);
+		for (int32_t i = offset; i < offset + 16 && i < length; ++i) {
+			int32_t value;
+			if (R3051Debugger_readByte(debugger, address + i, &value))
+				printf(" %02X", value);
+			else
+				printf(" --");
+		}
+		printf("\n");
+	}
+}
+
+/*
+ * This function shows the general registers, program counter, HI and LO,
+ * the Cop0 registers that exist, and the Cop2 data and control registers.
+ */
+static void R3051Debugger_showRegisters(R3051Debugger *debugger)
+{
+	R3051 *cpu = debugger->cpu;
+	static const int32_t cop0Registers[] = {1, 8, 12, 13, 14, 15};
+
+	printf("pc   %08X  hi   %08X  lo   %08X\n", cpu->programCounter,
+			cpu->hiReg, cpu->loReg);
+	for (int32_t i = 0; i < 32; ++i)
+		printf("%-4s %08X%s", registerNames[i], cpu->generalRegisters[i],
+				i % 4 == 3 ? "\n" : "  ");
+	printf("cop0:");
+	for (size_t i = 0; i < sizeof(cop0Registers) / sizeof(int32_t); ++i)
+		printf(" r%d=%08X", cop0Registers[i],
+				Cop0_readReg(&cpu->sccp, cop0Registers[i]));
+	printf("\n");
+	for (int32_t i = 0; i < 32; ++i)
+		printf("d%-2d %08X%s", i, Cop2_readDataReg(&cpu->gte, i),
+				i % 8 == 7 ? "\n" : " ");
+	for (int32_t i = 0; i < 32; ++i)
+		printf("c%-2d %08X%s", i, Cop2_readControlReg(&cpu->gte, i),
+				i % 8 == 7 ? "\n" : " ");
+}
+
+/*
+ * This function tells the processor whether it needs to ask about each
+ * instruction, which it only does while stopped, stepping or running to an
+ * address, or while any breakpoint is set.
+ */
+static void R3051Debugger_updateArmed(R3051Debugger *debugger)
+{
+	debugger->cpu->debuggerArmed = debugger->halted || debugger->stepping ||
+			debugger->runningTo || debugger->breakpointCount > 0;
+}
@@ -0,0 +1,499 @@
+/*
+ * This C file models the side-loading of PS-X EXE programs into the R3051
+ * processor as a class. The program is read and checked up front, either
+ * from a file or from the boot file named by SYSTEM.CNF on a CD, and then
+ * copied into RAM at the point the BIOS would have entered its shell, once
+ * the kernel has set itself up. The registers are then set up as the BIOS
+ * would have set them for the program, so the shell, its intro and the CD
+ * boot sequence are all skipped.
+ *
+ * R3051ExeLoader.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "../headers/R3051ExeLoader.h"
+#include "../headers/R3051_all.h"
+#include "../headers/SystemInterlink.h"
+#include "../headers/endian_utils.h"
+
+// Layout of a PS-X EXE - a 2 KB header followed by the text, copied to RAM
+// at the text address
+#define PHILPSX_R3051EXELOADER_HEADER_SIZE 0x800
+#define PHILPSX_R3051EXELOADER_PC 0x10
+#define PHILPSX_R3051EXELOADER_GP 0x14
+#define PHILPSX_R3051EXELOADER_TEXT_ADDRESS 0x18
+#define PHILPSX_R3051EXELOADER_TEXT_SIZE 0x1C
+#define PHILPSX_R3051EXELOADER_BSS_ADDRESS 0x28
+#define PHILPSX_R3051EXELOADER_BSS_SIZE 0x2C
+#define PHILPSX_R3051EXELOADER_STACK_ADDRESS 0x30
+#define PHILPSX_R3051EXELOADER_STACK_SIZE 0x34
+
+// Physical address of the BIOS shell, which the kernel jumps to once it is
+// set up, and the size of RAM programs must fit in
+#define PHILPSX_R3051EXELOADER_SHELL_ADDRESS 0x30000
+#define PHILPSX_R3051EXELOADER_RAM_SIZE 0x200000
+
+// Approximate cost of loading, as most of the real work is skipped
+#define PHILPSX_R3051EXELOADER_BOOT_CYCLES 12
+
+// ISO 9660 layout - sectors are numbered from the start of the data track,
+// two seconds into the disc, and the primary volume descriptor holds the
+// root directory's record
+#define PHILPSX_R3051EXELOADER_PREGAP_SECTORS 150
+#define PHILPSX_R3051EXELOADER_VOLUME_DESCRIPTOR 16
+#define PHILPSX_R3051EXELOADER_ROOT_RECORD 156
+#define PHILPSX_R3051EXELOADER_DIRECTORY_FLAG 0x2
+
+// Longest boot path and SYSTEM.CNF we handle
+#define PHILPSX_R3051EXELOADER_MAX_PATH 256
+#define PHILPSX_R3051EXELOADER_MAX_CONFIG 0x800
+
+// Register numbers set up for the program
+#define PHILPSX_R3051EXELOADER_A0 4
+#define PHILPSX_R3051EXELOADER_A1 5
+#define PHILPSX_R3051EXELOADER_GP_REGISTER 28
+#define PHILPSX_R3051EXELOADER_SP 29
+#define PHILPSX_R3051EXELOADER_FP 30
+
+// Forward declarations for functions private to this class
+static bool R3051ExeLoader_findBootPath(const char *config, char *path);
+static bool R3051ExeLoader_findFile(CD *cd, const char *path,
+		int32_t *sector, int32_t *size);
+static bool R3051ExeLoader_findRecord(CD *cd, int32_t directorySector,
+		int32_t directorySize, const char *name, size_t nameLength,
+		int32_t *sector, int32_t *size, bool *isDirectory);
+static bool R3051ExeLoader_inRam(int32_t address, int32_t size);
+static bool R3051ExeLoader_parse(R3051ExeLoader *loader, int8_t *image,
+		int32_t imageSize, const char *name);
+static int8_t *R3051ExeLoader_readFile(CD *cd, int32_t sector, int32_t size);
+
+/*
+ * This struct holds the program to be side-loaded, along with what the
+ * header says about where it goes.
+ */
+struct R3051ExeLoader {
+
+	// Whole file, with the text following the header
+	int8_t *image;
+
+	// Where the text goes, entry point and global pointer
+	int32_t textAddress;
+	int32_t textSize;
+	int32_t programCounter;
+	int32_t globalPointer;
+
+	// Area zeroed before the program starts, and the stack it starts with -
+	// a stack address of 0 leaves the one set up by the BIOS
+	int32_t bssAddress;
+	int32_t bssSize;
+	int32_t stackAddress;
+	int32_t stackSize;
+};
+
+/*
+ * This constructs an R3051ExeLoader object, with no program loaded yet.
+ */
+R3051ExeLoader *construct_R3051ExeLoader(void)
+{
+	R3051ExeLoader *loader = calloc(1, sizeof(R3051ExeLoader));
+	if (!loader) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: Couldn't allocate memory "
+				"for R3051ExeLoader struct\n");
+	}
+
+	return loader;
+}
+
+/*
+ * This destructs an R3051ExeLoader object.
+ */
+void destruct_R3051ExeLoader(R3051ExeLoader *loader)
+{
+	free(loader->image);
+	free(loader);
+}
+
+/*
+ * This function copies the program into RAM and starts it, if the processor
+ * is about to enter the BIOS shell. It returns true if it did, in which case
+ * the processor goes straight on to the program's entry point.
+ */
+bool R3051ExeLoader_handleBoot(R3051ExeLoader *loader, R3051 *cpu)
+{
+	if ((cpu->programCounter & 0x1FFFFFFF) !=
+			PHILPSX_R3051EXELOADER_SHELL_ADDRESS)
+		return false;
+
+	// Copy text and zero the BSS through the system, so that any code
+	// cached from those pages is thrown away
+	const int8_t *text = loader->image + PHILPSX_R3051EXELOADER_HEADER_SIZE;
+	int32_t textAddress = loader->textAddress & 0x1FFFFFFF;
+	for (int32_t i = 0; i < loader->textSize; i += 4)
+		SystemInterlink_writeWord(cpu->system, textAddress + i,
+				read_le_word(text + i));
+	int32_t bssAddress = loader->bssAddress & 0x1FFFFFFF;
+	for (int32_t i = 0; i < loader->bssSize; ++i)
+		SystemInterlink_writeByte(cpu->system, bssAddress + i, 0);
+
+	// Forget instructions cached from before
+	memset(cpu->instructionCache.cacheTag, 0,
+			PHILPSX_ICACHE_LINE_COUNT * sizeof(uint32_t));
+
+	// Setup registers as the BIOS would, with no arguments
+	cpu->generalRegisters[PHILPSX_R3051EXELOADER_A0] = 0;
+	cpu->generalRegisters[PHILPSX_R3051EXELOADER_A1] = 0;
+	cpu->generalRegisters[PHILPSX_R3051EXELOADER_GP_REGISTER] =
+			loader->globalPointer;
+	if (loader->stackAddress != 0) {
+		int32_t stack = loader->stackAddress + loader->stackSize;
+		cpu->generalRegisters[PHILPSX_R3051EXELOADER_SP] = stack;
+		cpu->generalRegisters[PHILPSX_R3051EXELOADER_FP] = stack;
+	}
+	cpu->programCounter = loader->programCounter;
+	fprintf(stdout, "PhilPSX: R3051ExeLoader: Starting program at "
+			"0x%08X\n", (uint32_t)loader->programCounter);
+
+	// Account for cycles
+	cpu->cycles = PHILPSX_R3051EXELOADER_BOOT_CYCLES;
+	cpu->totalCycles += PHILPSX_R3051EXELOADER_BOOT_CYCLES;
+	SystemInterlink_appendSyncCycles(cpu->system,
+			PHILPSX_R3051EXELOADER_BOOT_CYCLES);
+	cpu->hadSideEffects = true;
+
+	return true;
+}
+
+/*
+ * This function loads the program a CD boots, as named by the BOOT line of
+ * SYSTEM.CNF in its root directory, or PSX.EXE if there is no SYSTEM.CNF.
+ * It returns false if the CD has no such program.
+ */
+bool R3051ExeLoader_loadCD(R3051ExeLoader *loader, CD *cd)
+{
+	bool retVal = false;
+	if (CD_isEmpty(cd)) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: No CD to boot from\n");
+		goto end;
+	}
+
+	// Find boot path from SYSTEM.CNF if there is one
+	char path[PHILPSX_R3051EXELOADER_MAX_PATH] = "PSX.EXE";
+	int32_t sector, size;
+	if (R3051ExeLoader_findFile(cd, "SYSTEM.CNF", &sector, &size)) {
+		if (size > PHILPSX_R3051EXELOADER_MAX_CONFIG)
+			size = PHILPSX_R3051EXELOADER_MAX_CONFIG;
+		char *config = (char *)R3051ExeLoader_readFile(cd, sector, size);
+		if (!config)
+			goto end;
+		config[size] = '\0';
+		bool found = R3051ExeLoader_findBootPath(config, path);
+		free(config);
+		if (!found) {
+			fprintf(stderr, "PhilPSX: R3051ExeLoader: SYSTEM.CNF has no "
+					"usable BOOT line\n");
+			goto end;
+		}
+	}
+
+	// Read program itself
+	if (!R3051ExeLoader_findFile(cd, path, &sector, &size)) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: Couldn't find %s on the "
+				"CD\n", path);
+		goto end;
+	}
+	if (size < PHILPSX_R3051EXELOADER_HEADER_SIZE || size >
+			PHILPSX_R3051EXELOADER_HEADER_SIZE +
+			PHILPSX_R3051EXELOADER_RAM_SIZE) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: %s is the wrong size for "
+				"a PS-X EXE\n", path);
+		goto end;
+	}
+	int8_t *image = R3051ExeLoader_readFile(cd, sector, size);
+	if (!image)
+		goto end;
+	retVal = R3051ExeLoader_parse(loader, image, size, path);
+
+	end:
+	return retVal;
+}
+
+/*
+ * This function loads the program in the file at path. It returns false if
+ * the file couldn't be read or isn't a PS-X EXE that fits in RAM.
+ */
+bool R3051ExeLoader_loadFile(R3051ExeLoader *loader, const char *path)
+{
+	bool retVal = false;
+
+	// Open file and find its size
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: Couldn't open %s\n", path);
+		goto end;
+	}
+	if (fseek(file, 0, SEEK_END) != 0) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: Couldn't seek in %s\n",
+				path);
+		goto cleanup_file;
+	}
+	long size = ftell(file);
+	if (size < PHILPSX_R3051EXELOADER_HEADER_SIZE || size >
+			PHILPSX_R3051EXELOADER_HEADER_SIZE +
+			PHILPSX_R3051EXELOADER_RAM_SIZE) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: %s is the wrong size for "
+				"a PS-X EXE\n", path);
+		goto cleanup_file;
+	}
+	rewind(file);
+
+	// Read it in one go
+	int8_t *image = malloc(size);
+	if (!image) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: Couldn't allocate memory "
+				"for %s\n", path);
+		goto cleanup_file;
+	}
+	if (fread(image, 1, size, file) != (size_t)size) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: Couldn't read %s\n", path);
+		free(image);
+		goto cleanup_file;
+	}
+	retVal = R3051ExeLoader_parse(loader, image, size, path);
+
+	// Cleanup path:
+	cleanup_file:
+	fclose(file);
+
+	end:
+	return retVal;
+}
+
+/*
+ * This function finds the path named by the BOOT line of a SYSTEM.CNF, with
+ * the cdrom: prefix and version number taken off, and stores it in path. It
+ * returns false if there is no such line.
+ */
+static bool R3051ExeLoader_findBootPath(const char *config, char *path)
+{
+	const char *next;
+	for (const char *line = config; *line != '\0'; line = next) {
+		next = line + strcspn(line, "\n");
+		if (*next == '\n')
+			++next;
+
+		// Look for BOOT = cdrom:
+		line += strspn(line, " \t");
+		if (strncasecmp(line, "BOOT", 4) != 0)
+			continue;
+		const char *value = line + 4;
+		value += strspn(value, " \t");
+		if (*value != '=')
+			continue;
+		++value;
+		value += strspn(value, " \t");
+		if (strncasecmp(value, "cdrom:", 6) != 0)
+			continue;
+		value += 6;
+		value += strspn(value, "\\/");
+
+		// Copy path up to the version number or end of line
+		size_t length = strcspn(value, ";\r\n \t");
+		if (length == 0 || length >= PHILPSX_R3051EXELOADER_MAX_PATH)
+			continue;
+		memcpy(path, value, length);
+		path[length] = '\0';
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * This function finds the file at path on the CD, with directories split by
+ * backslashes (or forward slashes), storing its first sector and its size.
+ * It returns false if there is no such file.
+ */
+static bool R3051ExeLoader_findFile(CD *cd, const char *path,
+		int32_t *sector, int32_t *size)
+{
+	// Check primary volume descriptor
+	int8_t descriptor[PHILPSX_CD_DATA_SECTOR_SIZE];
+	CD_readSector(cd, PHILPSX_R3051EXELOADER_PREGAP_SECTORS +
+			PHILPSX_R3051EXELOADER_VOLUME_DESCRIPTOR, descriptor,
+			PHILPSX_CD_SECTOR_DATA);
+	if (descriptor[0] != 1 || memcmp(descriptor + 1, "CD001", 5) != 0) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: CD has no ISO 9660 file "
+				"system\n");
+		return false;
+	}
+
+	// Walk down from the root directory
+	const int8_t *root = descriptor + PHILPSX_R3051EXELOADER_ROOT_RECORD;
+	int32_t currentSector = read_le_word(root + 2);
+	int32_t currentSize = read_le_word(root + 10);
+	bool isDirectory = true;
+	while (true) {
+		path += strspn(path, "\\/");
+		size_t length = strcspn(path, "\\/");
+		if (length == 0)
+			break;
+		if (!isDirectory || !R3051ExeLoader_findRecord(cd, currentSector,
+				currentSize, path, length, &currentSector, &currentSize,
+				&isDirectory))
+			return false;
+		path += length;
+	}
+	if (isDirectory)
+		return false;
+
+	*sector = currentSector;
+	*size = currentSize;
+	return true;
+}
+
+/*
+ * This function looks through the directory starting at directorySector for
+ * a record called name (ignoring case and the version number), storing its
+ * first sector, its size and whether it is a directory. It returns false if
+ * there is no such record.
+ */
+static bool R3051ExeLoader_findRecord(CD *cd, int32_t directorySector,
+		int32_t directorySize, const char *name, size_t nameLength,
+		int32_t *sector, int32_t *size, bool *isDirectory)
+{
+	int8_t data[PHILPSX_CD_DATA_SECTOR_SIZE];
+	int32_t sectorCount = (directorySize + PHILPSX_CD_DATA_SECTOR_SIZE - 1) /
+			PHILPSX_CD_DATA_SECTOR_SIZE;
+	for (int32_t i = 0; i < sectorCount; ++i) {
+		CD_readSector(cd, PHILPSX_R3051EXELOADER_PREGAP_SECTORS +
+				directorySector + i, data, PHILPSX_CD_SECTOR_DATA);
+
+		// Records don't cross sectors, and a zero length ends the sector
+		int32_t offset = 0;
+		while (offset < PHILPSX_CD_DATA_SECTOR_SIZE - 33) {
+			const int8_t *record = data + offset;
+			int32_t recordLength = record[0] & 0xFF;
+			if (recordLength == 0)
+				break;
+			int32_t recordNameLength = record[32] & 0xFF;
+			if (offset + recordLength > PHILPSX_CD_DATA_SECTOR_SIZE ||
+					33 + recordNameLength > recordLength)
+				break;
+
+			// Compare name up to the version number
+			const char *recordName = (const char *)record + 33;
+			size_t compareLength = 0;
+			while (compareLength < (size_t)recordNameLength &&
+					recordName[compareLength] != ';')
+				++compareLength;
+			if (compareLength == nameLength &&
+					strncasecmp(recordName, name, nameLength) == 0) {
+				*sector = read_le_word(record + 2);
+				*size = read_le_word(record + 10);
+				*isDirectory =
+						record[25] & PHILPSX_R3051EXELOADER_DIRECTORY_FLAG;
+				return *sector >= 0 && *size >= 0;
+			}
+			offset += recordLength;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * This function tells us if size bytes from the given address all lie in
+ * the first mirror of RAM.
+ */
+static bool R3051ExeLoader_inRam(int32_t address, int32_t size)
+{
+	int32_t physicalAddress = address & 0x1FFFFFFF;
+	return size >= 0 && physicalAddress < PHILPSX_R3051EXELOADER_RAM_SIZE &&
+			size <= PHILPSX_R3051EXELOADER_RAM_SIZE - physicalAddress;
+}
+
+/*
+ * This function checks the header of a PS-X EXE file, and keeps it for
+ * booting if it is usable, replacing any program loaded before. It takes
+ * ownership of image, and returns false if it isn't usable.
+ */
+static bool R3051ExeLoader_parse(R3051ExeLoader *loader, int8_t *image,
+		int32_t imageSize, const char *name)
+{
+	// Check header
+	if (imageSize < PHILPSX_R3051EXELOADER_HEADER_SIZE ||
+			memcmp(image, "PS-X EXE", 8) != 0) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: %s isn't a PS-X EXE\n",
+				name);
+		goto cleanup_image;
+	}
+	int32_t textAddress = read_le_word(image +
+			PHILPSX_R3051EXELOADER_TEXT_ADDRESS);
+	int32_t textSize = read_le_word(image + PHILPSX_R3051EXELOADER_TEXT_SIZE);
+	int32_t bssAddress = read_le_word(image +
+			PHILPSX_R3051EXELOADER_BSS_ADDRESS);
+	int32_t bssSize = read_le_word(image + PHILPSX_R3051EXELOADER_BSS_SIZE);
+	if (textSize <= 0 || (textAddress & 0x3) != 0 || (textSize & 0x3) != 0 ||
+			textSize > imageSize - PHILPSX_R3051EXELOADER_HEADER_SIZE) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: %s has a bad text "
+				"section\n", name);
+		goto cleanup_image;
+	}
+	if (!R3051ExeLoader_inRam(textAddress, textSize) ||
+			(bssSize != 0 && !R3051ExeLoader_inRam(bssAddress, bssSize))) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: %s doesn't fit in RAM\n",
+				name);
+		goto cleanup_image;
+	}
+
+	// Keep program
+	free(loader->image);
+	loader->image = image;
+	loader->textAddress = textAddress;
+	loader->textSize = textSize;
+	loader->programCounter = read_le_word(image + PHILPSX_R3051EXELOADER_PC);
+	loader->globalPointer = read_le_word(image + PHILPSX_R3051EXELOADER_GP);
+	loader->bssAddress = bssAddress;
+	loader->bssSize = bssSize;
+	loader->stackAddress = read_le_word(image +
+			PHILPSX_R3051EXELOADER_STACK_ADDRESS);
+	loader->stackSize = read_le_word(image +
+			PHILPSX_R3051EXELOADER_STACK_SIZE);
+	fprintf(stdout, "PhilPSX: R3051ExeLoader: Loaded %s, %d bytes at "
+			"0x%08X\n", name, textSize, (uint32_t)textAddress);
+	return true;
+
+	// Cleanup path:
+	cleanup_image:
+	free(image);
+	return false;
+}
+
+/*
+ * This function reads size bytes of a file on the CD starting at sector,
+ * into a buffer with a spare byte on the end, which the caller must free.
+ * It returns NULL if there isn't enough memory.
+ */
+static int8_t *R3051ExeLoader_readFile(CD *cd, int32_t sector, int32_t size)
+{
+	int32_t sectorCount = (size + PHILPSX_CD_DATA_SECTOR_SIZE - 1) /
+			PHILPSX_CD_DATA_SECTOR_SIZE;
+	int8_t *data = malloc((size_t)sectorCount * PHILPSX_CD_DATA_SECTOR_SIZE +
+			1);
+	if (!data) {
+		fprintf(stderr, "PhilPSX: R3051ExeLoader: Couldn't allocate memory "
+				"for file on the CD\n");
+		return NULL;
+	}
+
+	for (int32_t i = 0; i < sectorCount; ++i)
+		CD_readSector(cd, PHILPSX_R3051EXELOADER_PREGAP_SECTORS + sector + i,
+				data + i * PHILPSX_CD_DATA_SECTOR_SIZE,
+				PHILPSX_CD_SECTOR_DATA);
+
+	return data;
+}
@@ -0,0 +1,435 @@
+/*
+ * This C file models high-level emulation of BIOS kernel functions for the
+ * R3051 processor as a class. Calls made through the A0h, B0h and C0h
+ * kernel vectors to any of the enabled functions are run natively instead
+ * of through the BIOS code, with the same effects on registers and memory
+ * that the caller can see, and a cycle cost approximating that of the BIOS
+ * routine.
+ *
+ * R3051Hle.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/R3051Hle.h"
+#include "../headers/R3051_all.h"
+#include "../headers/SystemInterlink.h"
+
+// Kernel vectors, and the highest function number of each we can handle
+#define PHILPSX_R3051HLE_VECTOR_A0 0
+#define PHILPSX_R3051HLE_VECTOR_B0 1
+#define PHILPSX_R3051HLE_VECTOR_C0 2
+#define PHILPSX_R3051HLE_VECTOR_COUNT 3
+#define PHILPSX_R3051HLE_MAX_FUNCTIONS 256
+
+// Approximate cost of going through a vector and returning from the
+// function, and of each loop iteration in the BIOS routines
+#define PHILPSX_R3051HLE_CALL_CYCLES 12
+#define PHILPSX_R3051HLE_LOOP_CYCLES 5
+
+// Register numbers used by the calling convention
+#define PHILPSX_R3051HLE_V0 2
+#define PHILPSX_R3051HLE_A0 4
+#define PHILPSX_R3051HLE_A1 5
+#define PHILPSX_R3051HLE_A2 6
+#define PHILPSX_R3051HLE_T1 9
+#define PHILPSX_R3051HLE_RA 31
+
+// Typedefs
+typedef struct R3051HleFunction R3051HleFunction;
+
+// This runs a kernel function natively, returning the cycles it took
+typedef int32_t (*R3051HleHandler)(R3051 *cpu);
+
+// Forward declarations for functions and subcomponents private to this class
+// R3051Hle-related stuff:
+static int32_t R3051Hle_bzero(R3051 *cpu);
+static bool R3051Hle_enableFunction(R3051Hle *hle, const char *name,
+		size_t length);
+static int32_t R3051Hle_memcpy(R3051 *cpu);
+static int32_t R3051Hle_memset(R3051 *cpu);
+static int32_t R3051Hle_readByte(R3051 *cpu, int32_t address);
+static int32_t R3051Hle_strcmp(R3051 *cpu);
+static int32_t R3051Hle_strcpy(R3051 *cpu);
+static int32_t R3051Hle_strlen(R3051 *cpu);
+static int32_t R3051Hle_strncmp(R3051 *cpu);
+static int32_t R3051Hle_tolower(R3051 *cpu);
+static int32_t R3051Hle_toupper(R3051 *cpu);
+static void R3051Hle_writeByte(R3051 *cpu, int32_t address, int32_t value);
+
+/*
+ * This inner struct describes a kernel function we can run natively.
+ */
+struct R3051HleFunction {
+
+	// Name used to enable the function, and where it lives in the kernel
+	const char *name;
+	int32_t vector;
+	int32_t number;
+
+	// Native equivalent
+	R3051HleHandler handler;
+};
+
+/*
+ * This struct contains the native handler for each enabled kernel function,
+ * indexed by vector and function number.
+ */
+struct R3051Hle {
+
+	// Handlers, which are NULL for functions left to the BIOS
+	R3051HleHandler handlers[PHILPSX_R3051HLE_VECTOR_COUNT]
+			[PHILPSX_R3051HLE_MAX_FUNCTIONS];
+};
+
+// Kernel functions we can run natively
+static const R3051HleFunction R3051Hle_functions[] = {
+	{"strcmp", PHILPSX_R3051HLE_VECTOR_A0, 0x17, R3051Hle_strcmp},
+	{"strncmp", PHILPSX_R3051HLE_VECTOR_A0, 0x18, R3051Hle_strncmp},
+	{"strcpy", PHILPSX_R3051HLE_VECTOR_A0, 0x19, R3051Hle_strcpy},
+	{"strlen", PHILPSX_R3051HLE_VECTOR_A0, 0x1B, R3051Hle_strlen},
+	{"toupper", PHILPSX_R3051HLE_VECTOR_A0, 0x25, R3051Hle_toupper},
+	{"tolower", PHILPSX_R3051HLE_VECTOR_A0, 0x26, R3051Hle_tolower},
+	{"bzero", PHILPSX_R3051HLE_VECTOR_A0, 0x28, R3051Hle_bzero},
+	{"memcpy", PHILPSX_R3051HLE_VECTOR_A0, 0x2A, R3051Hle_memcpy},
+	{"memset", PHILPSX_R3051HLE_VECTOR_A0, 0x2B, R3051Hle_memset}
+};
+
+/*
+ * This constructs a new R3051Hle object. The functions to run natively are
+ * given as a comma-separated list of names, or "all" to enable everything
+ * it knows about. It returns NULL if any name is not recognised.
+ */
+R3051Hle *construct_R3051Hle(const char *functions)
+{
+	// Allocate R3051Hle struct, with every function left to the BIOS
+	R3051Hle *hle = calloc(1, sizeof(R3051Hle));
+	if (!hle) {
+		fprintf(stderr, "PhilPSX: R3051Hle: Couldn't allocate memory for "
+				"R3051Hle struct\n");
+		goto end;
+	}
+
+	// Enable each function in the list
+	while (*functions != '\0') {
+		size_t length = strcspn(functions, ",");
+		if (!R3051Hle_enableFunction(hle, functions, length)) {
+			fprintf(stderr, "PhilPSX: R3051Hle: Unknown kernel function "
+					"%.*s\n", (int)length, functions);
+			goto cleanup_r3051hle;
+		}
+		functions += length;
+		if (*functions == ',')
+			++functions;
+	}
+
+	// Normal return:
+	return hle;
+
+	// Cleanup path:
+	cleanup_r3051hle:
+	free(hle);
+	hle = NULL;
+
+	end:
+	return hle;
+}
+
+/*
+ * This destructs an R3051Hle object.
+ */
+void destruct_R3051Hle(R3051Hle *hle)
+{
+	free(hle);
+}
+
+/*
+ * This function checks if the processor is at one of the kernel vectors
+ * about to run an enabled function, and if so runs it natively and returns
+ * to the caller. It returns true if the call was handled, and must not be
+ * called from a branch delay slot.
+ */
+bool R3051Hle_handleCall(R3051Hle *hle, R3051 *cpu)
+{
+	// Work out which vector we are at, if any
+	int32_t vector;
+	switch (cpu->programCounter & 0x1FFFFFFF) {
+		case 0xA0:
+			vector = PHILPSX_R3051HLE_VECTOR_A0;
+			break;
+		case 0xB0:
+			vector = PHILPSX_R3051HLE_VECTOR_B0;
+			break;
+		case 0xC0:
+			vector = PHILPSX_R3051HLE_VECTOR_C0;
+			break;
+		default:
+			return false;
+	}
+
+	// Find handler for the function number in t1
+	int32_t function = cpu->generalRegisters[PHILPSX_R3051HLE_T1];
+	if (function < 0 || function >= PHILPSX_R3051HLE_MAX_FUNCTIONS)
+		return false;
+	R3051HleHandler handler = hle->handlers[vector][function];
+	if (!handler)
+		return false;
+
+	// Run function and return straight to the caller
+	int32_t cycles = PHILPSX_R3051HLE_CALL_CYCLES + handler(cpu);
+	cpu->programCounter = cpu->generalRegisters[PHILPSX_R3051HLE_RA];
+
+	// Account for cycles as if the BIOS routine had run
+	cpu->cycles = cycles;
+	cpu->totalCycles += cycles;
+	SystemInterlink_appendSyncCycles(cpu->system, cycles);
+	cpu->hadSideEffects = true;
+
+	return true;
+}
+
+/*
+ * This function emulates A(28h) bzero(dst, len), which fills len bytes at
+ * dst with zero and returns dst, or 0 if dst is 0 or len is not positive.
+ */
+static int32_t R3051Hle_bzero(R3051 *cpu)
+{
+	int32_t dst = cpu->generalRegisters[PHILPSX_R3051HLE_A0];
+	int32_t len = cpu->generalRegisters[PHILPSX_R3051HLE_A1];
+
+	if (dst == 0 || len <= 0) {
+		cpu->generalRegisters[PHILPSX_R3051HLE_V0] = 0;
+		return 0;
+	}
+
+	for (int32_t i = 0; i < len; ++i)
+		R3051Hle_writeByte(cpu, dst + i, 0);
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = dst;
+
+	return len * PHILPSX_R3051HLE_LOOP_CYCLES;
+}
+
+/*
+ * This function enables the kernel function with the specified name, which
+ * is not null-terminated. "all" enables every function we know about.
+ */
+static bool R3051Hle_enableFunction(R3051Hle *hle, const char *name,
+		size_t length)
+{
+	bool all = length == 3 && strncmp(name, "all", 3) == 0;
+	bool found = all;
+
+	size_t count = sizeof(R3051Hle_functions) / sizeof(R3051HleFunction);
+	for (size_t i = 0; i < count; ++i) {
+		const R3051HleFunction *function = &R3051Hle_functions[i];
+		if (all || (strlen(function->name) == length &&
+				strncmp(function->name, name, length) == 0)) {
+			hle->handlers[function->vector][function->number] =
+					function->handler;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+/*
+ * This function emulates A(2Ah) memcpy(dst, src, len), which copies len
+ * bytes from src to dst and returns dst, or 0 if either pointer is 0 or
+ * len is not positive.
+ */
+static int32_t R3051Hle_memcpy(R3051 *cpu)
+{
+	int32_t dst = cpu->generalRegisters[PHILPSX_R3051HLE_A0];
+	int32_t src = cpu->generalRegisters[PHILPSX_R3051HLE_A1];
+	int32_t len = cpu->generalRegisters[PHILPSX_R3051HLE_A2];
+
+	if (dst == 0 || src == 0 || len <= 0) {
+		cpu->generalRegisters[PHILPSX_R3051HLE_V0] = 0;
+		return 0;
+	}
+
+	for (int32_t i = 0; i < len; ++i)
+		R3051Hle_writeByte(cpu, dst + i, R3051Hle_readByte(cpu, src + i));
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = dst;
+
+	return len * PHILPSX_R3051HLE_LOOP_CYCLES;
+}
+
+/*
+ * This function emulates A(2Bh) memset(dst, fillbyte, len), which fills len
+ * bytes at dst with fillbyte and returns dst, or 0 if dst is 0 or len is
+ * not positive.
+ */
+static int32_t R3051Hle_memset(R3051 *cpu)
+{
+	int32_t dst = cpu->generalRegisters[PHILPSX_R3051HLE_A0];
+	int32_t fillByte = cpu->generalRegisters[PHILPSX_R3051HLE_A1];
+	int32_t len = cpu->generalRegisters[PHILPSX_R3051HLE_A2];
+
+	if (dst == 0 || len <= 0) {
+		cpu->generalRegisters[PHILPSX_R3051HLE_V0] = 0;
+		return 0;
+	}
+
+	for (int32_t i = 0; i < len; ++i)
+		R3051Hle_writeByte(cpu, dst + i, fillByte);
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = dst;
+
+	return len * PHILPSX_R3051HLE_LOOP_CYCLES;
+}
+
+/*
+ * This function reads an unsigned byte from the specified virtual address.
+ */
+static int32_t R3051Hle_readByte(R3051 *cpu, int32_t address)
+{
+	return SystemInterlink_readByte(cpu->system,
+			Cop0_virtualToPhysical(&cpu->sccp, address)) & 0xFF;
+}
+
+/*
+ * This function emulates A(17h) strcmp(str1, str2), which returns the
+ * difference between the first pair of bytes that differ, or 0 if the
+ * strings match. A null pointer compares lower than any string.
+ */
+static int32_t R3051Hle_strcmp(R3051 *cpu)
+{
+	int32_t str1 = cpu->generalRegisters[PHILPSX_R3051HLE_A0];
+	int32_t str2 = cpu->generalRegisters[PHILPSX_R3051HLE_A1];
+
+	if (str1 == 0 || str2 == 0) {
+		cpu->generalRegisters[PHILPSX_R3051HLE_V0] =
+				(str1 == str2) ? 0 : (str1 == 0) ? -1 : 1;
+		return 0;
+	}
+
+	int32_t i = 0;
+	int32_t difference = 0;
+	while (true) {
+		int32_t byte1 = R3051Hle_readByte(cpu, str1 + i);
+		int32_t byte2 = R3051Hle_readByte(cpu, str2 + i);
+		++i;
+		difference = byte1 - byte2;
+		if (difference != 0 || byte1 == 0)
+			break;
+	}
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = difference;
+
+	return i * PHILPSX_R3051HLE_LOOP_CYCLES;
+}
+
+/*
+ * This function emulates A(19h) strcpy(dst, src), which copies src
+ * including its terminating zero to dst and returns dst, or 0 if either
+ * pointer is 0.
+ */
+static int32_t R3051Hle_strcpy(R3051 *cpu)
+{
+	int32_t dst = cpu->generalRegisters[PHILPSX_R3051HLE_A0];
+	int32_t src = cpu->generalRegisters[PHILPSX_R3051HLE_A1];
+
+	if (dst == 0 || src == 0) {
+		cpu->generalRegisters[PHILPSX_R3051HLE_V0] = 0;
+		return 0;
+	}
+
+	int32_t i = 0;
+	int32_t byte;
+	do {
+		byte = R3051Hle_readByte(cpu, src + i);
+		R3051Hle_writeByte(cpu, dst + i, byte);
+		++i;
+	} while (byte != 0);
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = dst;
+
+	return i * PHILPSX_R3051HLE_LOOP_CYCLES;
+}
+
+/*
+ * This function emulates A(1Bh) strlen(src), which returns the number of
+ * bytes before the terminating zero, or 0 if src is 0.
+ */
+static int32_t R3051Hle_strlen(R3051 *cpu)
+{
+	int32_t src = cpu->generalRegisters[PHILPSX_R3051HLE_A0];
+
+	int32_t length = 0;
+	if (src != 0) {
+		while (R3051Hle_readByte(cpu, src + length) != 0)
+			++length;
+	}
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = length;
+
+	return length * PHILPSX_R3051HLE_LOOP_CYCLES;
+}
+
+/*
+ * This function emulates A(18h) strncmp(str1, str2, maxlen), which behaves
+ * like strcmp but compares at most maxlen bytes.
+ */
+static int32_t R3051Hle_strncmp(R3051 *cpu)
+{
+	int32_t str1 = cpu->generalRegisters[PHILPSX_R3051HLE_A0];
+	int32_t str2 = cpu->generalRegisters[PHILPSX_R3051HLE_A1];
+	int32_t maxLength = cpu->generalRegisters[PHILPSX_R3051HLE_A2];
+
+	if (str1 == 0 || str2 == 0) {
+		cpu->generalRegisters[PHILPSX_R3051HLE_V0] =
+				(str1 == str2) ? 0 : (str1 == 0) ? -1 : 1;
+		return 0;
+	}
+
+	int32_t i = 0;
+	int32_t difference = 0;
+	while (i < maxLength) {
+		int32_t byte1 = R3051Hle_readByte(cpu, str1 + i);
+		int32_t byte2 = R3051Hle_readByte(cpu, str2 + i);
+		++i;
+		difference = byte1 - byte2;
+		if (difference != 0 || byte1 == 0)
+			break;
+	}
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = difference;
+
+	return i * PHILPSX_R3051HLE_LOOP_CYCLES;
+}
+
+/*
+ * This function emulates A(26h) tolower(char), which returns the lower
+ * case version of an ASCII character.
+ */
+static int32_t R3051Hle_tolower(R3051 *cpu)
+{
+	int32_t character = cpu->generalRegisters[PHILPSX_R3051HLE_A0] & 0xFF;
+	if (character >= 'A' && character <= 'Z')
+		character += 'a' - 'A';
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = character;
+
+	return 0;
+}
+
+/*
+ * This function emulates A(25h) toupper(char), which returns the upper
+ * case version of an ASCII character.
+ */
+static int32_t R3051Hle_toupper(R3051 *cpu)
+{
+	int32_t character = cpu->generalRegisters[PHILPSX_R3051HLE_A0] & 0xFF;
+	if (character >= 'a' && character <= 'z')
+		character -= 'a' - 'A';
+	cpu->generalRegisters[PHILPSX_R3051HLE_V0] = character;
+
+	return 0;
+}
+
+/*
+ * This function writes a byte to the specified virtual address.
+ */
+static void R3051Hle_writeByte(R3051 *cpu, int32_t address, int32_t value)
+{
+	SystemInterlink_writeByte(cpu->system,
+			Cop0_virtualToPhysical(&cpu->sccp, address), (int8_t)value);
+}
@@ -0,0 +1,682 @@
+/*
+ * This C file models a dynamic recompiler for the R3051 processor as a class.
+ * Basic blocks are translated into x86-64 host code, with common ALU
+ * instructions emitted natively and everything else calling back into the
+ * interpreter, so that the cycle counts returned are the same as those of
+ * the interpretive core.
+ *
+ * R3051Jit.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+
+/* Needed for MAP_ANONYMOUS */
+#define _DEFAULT_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "../headers/R3051Jit.h"
+#include "../headers/R3051_all.h"
+#include "../headers/R3051BlockCache_all.h"
+#include "../headers/Components.h"
+#include "../headers/SystemInterlink.h"
+#include "../headers/endian_utils.h"
+#include "../headers/math_utils.h"
+
+// Size of the executable code buffer, and the most host code any one
+// instruction can expand to
+#define PHILPSX_R3051JIT_CODE_BUFFER_SIZE 0x1000000
+#define PHILPSX_R3051JIT_MAX_INSTRUCTION_CODE 128
+
+// x86-64 registers used by the emitted code
+#define PHILPSX_X64_EAX 0
+#define PHILPSX_X64_ECX 1
+#define PHILPSX_X64_EDX 2
+#define PHILPSX_X64_EBX 3
+#define PHILPSX_X64_ESI 6
+#define PHILPSX_X64_EDI 7
+
+// x86-64 ALU opcodes (register, memory form) and their /digit extensions
+#define PHILPSX_X64_ADD 0x03
+#define PHILPSX_X64_OR 0x0B
+#define PHILPSX_X64_AND 0x23
+#define PHILPSX_X64_SUB 0x2B
+#define PHILPSX_X64_XOR 0x33
+#define PHILPSX_X64_CMP 0x3B
+#define PHILPSX_X64_EXT_ADD 0
+#define PHILPSX_X64_EXT_OR 1
+#define PHILPSX_X64_EXT_AND 4
+#define PHILPSX_X64_EXT_XOR 6
+#define PHILPSX_X64_EXT_CMP 7
+#define PHILPSX_X64_EXT_SHL 4
+#define PHILPSX_X64_EXT_SHR 5
+#define PHILPSX_X64_EXT_SAR 7
+#define PHILPSX_X64_EXT_MUL 4
+#define PHILPSX_X64_EXT_IMUL 5
+#define PHILPSX_X64_SETL 0x9C
+#define PHILPSX_X64_SETB 0x92
+#define PHILPSX_X64_JE 0x84
+#define PHILPSX_X64_JNE 0x85
+
+// Offsets of processor state used by the emitted code
+#define PHILPSX_R3051JIT_GPR(x) \
+		((int32_t)(offsetof(R3051, generalRegisters) + (x) * sizeof(int32_t)))
+#define PHILPSX_R3051JIT_PC ((int32_t)offsetof(R3051, programCounter))
+#define PHILPSX_R3051JIT_HI ((int32_t)offsetof(R3051, hiReg))
+#define PHILPSX_R3051JIT_LO ((int32_t)offsetof(R3051, loReg))
+#define PHILPSX_R3051JIT_SYSTEM ((int32_t)offsetof(R3051, system))
+#define PHILPSX_R3051JIT_CYCLES ((int32_t)offsetof(R3051, cycles))
+#define PHILPSX_R3051JIT_TOTAL_CYCLES ((int32_t)offsetof(R3051, totalCycles))
+#define PHILPSX_R3051JIT_INSTRUCTION_COUNT \
+		((int32_t)offsetof(R3051, instructionCount))
+#define PHILPSX_R3051JIT_PENDING_SYNC_CYCLES \
+		((int32_t)offsetof(R3051, pendingSyncCycles))
+
+// Forward declarations for functions and subcomponents private to this class
+// R3051Jit-related stuff:
+static void *R3051Jit_compileBlock(R3051Jit *jit, R3051Block *block);
+static void R3051Jit_emitAddQuadImmediate(R3051Jit *jit, int32_t offset,
+		int32_t value);
+static void R3051Jit_emitAluImmediate(R3051Jit *jit, int32_t extension,
+		int32_t value);
+static void R3051Jit_emitAluMemory(R3051Jit *jit, int32_t opcode,
+		int32_t reg, int32_t offset);
+static void R3051Jit_emitByte(R3051Jit *jit, int32_t value);
+static void R3051Jit_emitCall(R3051Jit *jit, uintptr_t function);
+static void R3051Jit_emitCompareImmediate(R3051Jit *jit, int32_t offset,
+		int32_t value);
+static size_t R3051Jit_emitExitJump(R3051Jit *jit, int32_t condition);
+static void R3051Jit_emitInstruction(R3051Jit *jit, R3051Block *block,
+		int32_t index, size_t *exitJumps, int32_t *exitJumpCount);
+static void R3051Jit_emitLoad(R3051Jit *jit, int32_t reg, int32_t offset);
+static void R3051Jit_emitModRM(R3051Jit *jit, int32_t reg, int32_t offset);
+static void R3051Jit_emitMoveImmediate(R3051Jit *jit, int32_t reg,
+		int32_t value);
+static bool R3051Jit_emitNativeOp(R3051Jit *jit, int32_t instruction);
+static void R3051Jit_emitQuad(R3051Jit *jit, uint64_t value);
+static void R3051Jit_emitSetCondition(R3051Jit *jit, int32_t condition,
+		int32_t rd);
+static void R3051Jit_emitShiftImmediate(R3051Jit *jit, int32_t extension,
+		int32_t amount);
+static void R3051Jit_emitStore(R3051Jit *jit, int32_t reg, int32_t offset);
+static void R3051Jit_emitStoreImmediate(R3051Jit *jit, int32_t offset,
+		int32_t value);
+static void R3051Jit_emitWord(R3051Jit *jit, int32_t value);
+
+/*
+ * This struct contains the code buffer, and a reference to the block cache
+ * that tells us which code to compile.
+ */
+struct R3051Jit {
+
+	// Executable code buffer
+	uint8_t *codeBuffer;
+	size_t codeBufferUsed;
+
+	// Block cache, whose block data points into the code buffer
+	R3051BlockCache *blockCache;
+};
+
+/*
+ * This constructs a new R3051Jit object, which compiles the blocks found by
+ * the supplied block cache. The block cache should not free block data, as
+ * it points into the code buffer.
+ */
+R3051Jit *construct_R3051Jit(R3051BlockCache *blockCache)
+{
+	// Check we can actually run the code we generate
+#if !defined(__x86_64__)
+	fprintf(stderr, "PhilPSX: R3051Jit: The recompiler is only supported on "
+			"x86-64 hosts\n");
+	return NULL;
+#endif
+
+	// Allocate R3051Jit struct
+	R3051Jit *jit = malloc(sizeof(R3051Jit));
+	if (!jit) {
+		fprintf(stderr, "PhilPSX: R3051Jit: Couldn't allocate memory for "
+				"R3051Jit struct\n");
+		goto end;
+	}
+
+	// Allocate executable code buffer
+	jit->codeBuffer = mmap(NULL, PHILPSX_R3051JIT_CODE_BUFFER_SIZE,
+			PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (jit->codeBuffer == MAP_FAILED) {
+		fprintf(stderr, "PhilPSX: R3051Jit: Couldn't map executable code "
+				"buffer\n");
+		goto cleanup_r3051jit;
+	}
+	jit->codeBufferUsed = 0;
+
+	// Set block cache reference
+	jit->blockCache = blockCache;
+
+	// Normal return:
+	return jit;
+
+	// Cleanup path:
+	cleanup_r3051jit:
+	free(jit);
+	jit = NULL;
+
+	end:
+	return jit;
+}
+
+/*
+ * This destructs an R3051Jit object. The block cache must be flushed or
+ * destroyed as well, as its blocks point into the code buffer.
+ */
+void destruct_R3051Jit(R3051Jit *jit)
+{
+	munmap(jit->codeBuffer, PHILPSX_R3051JIT_CODE_BUFFER_SIZE);
+	free(jit);
+}
+
+/*
+ * This function runs the compiled block for the current program counter,
+ * compiling it first if needed. It returns false without executing anything
+ * if the block can't be run yet, in which case the interpreter should be
+ * used instead. This must not be called from a branch delay slot.
+ */
+bool R3051Jit_executeBlock(R3051Jit *jit, R3051 *cpu)
+{
+	// Make sure there is room for the largest possible block, flushing
+	// everything if not, before we ask for it
+	size_t maxCodeSize = (PHILPSX_R3051BLOCKCACHE_MAX_BLOCK_LENGTH + 1) *
+			PHILPSX_R3051JIT_MAX_INSTRUCTION_CODE;
+	if (jit->codeBufferUsed + maxCodeSize > PHILPSX_R3051JIT_CODE_BUFFER_SIZE)
+		R3051Jit_flush(jit);
+
+	// Find block, compiling it if we need to
+	R3051Block *block = R3051BlockCache_getBlock(jit->blockCache, cpu);
+	if (!block)
+		return false;
+	if (!block->data)
+		block->data = R3051Jit_compileBlock(jit, block);
+
+	// Run block
+	void (*code)(R3051 *cpu) = (void (*)(R3051 *))(uintptr_t)block->data;
+	code(cpu);
+	return true;
+}
+
+/*
+ * This function throws away all compiled blocks and resets the code buffer.
+ */
+void R3051Jit_flush(R3051Jit *jit)
+{
+	R3051BlockCache_flush(jit->blockCache);
+	jit->codeBufferUsed = 0;
+}
+
+/*
+ * This function compiles a block into the code buffer, returning its entry
+ * point.
+ */
+static void *R3051Jit_compileBlock(R3051Jit *jit, R3051Block *block)
+{
+	// Emit prologue - rbx holds the R3051 pointer for the whole block
+	uint8_t *code = jit->codeBuffer + jit->codeBufferUsed;
+	R3051Jit_emitByte(jit, 0x53);				// push rbx
+	R3051Jit_emitByte(jit, 0x48);				// mov rbx, rdi
+	R3051Jit_emitByte(jit, 0x89);
+	R3051Jit_emitByte(jit, 0xFB);
+
+	// Emit instructions
+	size_t exitJumps[PHILPSX_R3051BLOCKCACHE_MAX_BLOCK_LENGTH * 2];
+	int32_t exitJumpCount = 0;
+	for (int32_t i = 0; i < block->instructionCount; ++i)
+		R3051Jit_emitInstruction(jit, block, i, exitJumps, &exitJumpCount);
+
+	// Point early exits at the epilogue, then emit it
+	for (int32_t i = 0; i < exitJumpCount; ++i) {
+		int32_t displacement =
+				(int32_t)(jit->codeBufferUsed - (exitJumps[i] + 4));
+		memcpy(jit->codeBuffer + exitJumps[i], &displacement,
+				sizeof(displacement));
+	}
+	R3051Jit_emitByte(jit, 0x5B);				// pop rbx
+	R3051Jit_emitByte(jit, 0xC3);				// ret
+
+	return code;
+}
+
+/*
+ * This function emits add qword [rbx + offset], value.
+ */
+static void R3051Jit_emitAddQuadImmediate(R3051Jit *jit, int32_t offset,
+		int32_t value)
+{
+	R3051Jit_emitByte(jit, 0x48);
+	R3051Jit_emitByte(jit, 0x81);
+	R3051Jit_emitModRM(jit, PHILPSX_X64_EXT_ADD, offset);
+	R3051Jit_emitWord(jit, value);
+}
+
+/*
+ * This function emits an ALU operation between eax and an immediate value.
+ */
+static void R3051Jit_emitAluImmediate(R3051Jit *jit, int32_t extension,
+		int32_t value)
+{
+	R3051Jit_emitByte(jit, 0x81);
+	R3051Jit_emitByte(jit, 0xC0 | (extension << 3));
+	R3051Jit_emitWord(jit, value);
+}
+
+/*
+ * This function emits an ALU operation between a register and
+ * [rbx + offset], storing the result in the register.
+ */
+static void R3051Jit_emitAluMemory(R3051Jit *jit, int32_t opcode,
+		int32_t reg, int32_t offset)
+{
+	R3051Jit_emitByte(jit, opcode);
+	R3051Jit_emitModRM(jit, reg, offset);
+}
+
+/*
+ * This function emits a single byte of host code.
+ */
+static void R3051Jit_emitByte(R3051Jit *jit, int32_t value)
+{
+	jit->codeBuffer[jit->codeBufferUsed++] = (uint8_t)value;
+}
+
+/*
+ * This function emits a call to a C function through rax.
+ */
+static void R3051Jit_emitCall(R3051Jit *jit, uintptr_t function)
+{
+	R3051Jit_emitByte(jit, 0x48);				// mov rax, imm64
+	R3051Jit_emitByte(jit, 0xB8);
+	R3051Jit_emitQuad(jit, function);
+	R3051Jit_emitByte(jit, 0xFF);				// call rax
+	R3051Jit_emitByte(jit, 0xD0);
+}
+
+/*
+ * This function emits cmp dword [rbx + offset], value.
+ */
+static void R3051Jit_emitCompareImmediate(R3051Jit *jit, int32_t offset,
+		int32_t value)
+{
+	R3051Jit_emitByte(jit, 0x81);
+	R3051Jit_emitModRM(jit, PHILPSX_X64_EXT_CMP, offset);
+	R3051Jit_emitWord(jit, value);
+}
+
+/*
+ * This function emits a conditional jump to the block epilogue, returning
+ * the position of the displacement so it can be filled in later.
+ */
+static size_t R3051Jit_emitExitJump(R3051Jit *jit, int32_t condition)
+{
+	R3051Jit_emitByte(jit, 0x0F);
+	R3051Jit_emitByte(jit, condition);
+	size_t position = jit->codeBufferUsed;
+	R3051Jit_emitWord(jit, 0);
+	return position;
+}
+
+/*
+ * This function emits the host code for a single instruction, including the
+ * same cycle accounting the interpreter would perform for it.
+ */
+static void R3051Jit_emitInstruction(R3051Jit *jit, R3051Block *block,
+		int32_t index, size_t *exitJumps, int32_t *exitJumpCount)
+{
+	int32_t instruction = read_le_word(block->sourceBytes + index * 4);
+	int32_t stallCycles = block->stallCycles[index];
+	int32_t address = block->virtualAddress + index * 4;
+	bool lastInstruction = index == block->instructionCount - 1;
+
+	// Try to emit the instruction natively first - these instructions can't
+	// throw exceptions, so we know exactly what the interpreter would do
+	if (!lastInstruction && R3051Jit_emitNativeOp(jit, instruction)) {
+		int32_t cycles = stallCycles + 1;
+		R3051Jit_emitStoreImmediate(jit, PHILPSX_R3051JIT_CYCLES, cycles);
+		R3051Jit_emitAddQuadImmediate(jit, PHILPSX_R3051JIT_TOTAL_CYCLES,
+				cycles);
+		R3051Jit_emitStoreImmediate(jit, PHILPSX_R3051JIT_PC, address + 4);
+		R3051Jit_emitAddQuadImmediate(jit,
+				PHILPSX_R3051JIT_INSTRUCTION_COUNT, 1);
+#ifdef PHILPSX_R3051_SYNC_EVERY_INSTRUCTION
+		R3051Jit_emitByte(jit, 0x48);			// mov rdi, [rbx + system]
+		R3051Jit_emitByte(jit, 0x8B);
+		R3051Jit_emitModRM(jit, PHILPSX_X64_EDI, PHILPSX_R3051JIT_SYSTEM);
+		R3051Jit_emitMoveImmediate(jit, PHILPSX_X64_ESI, cycles);
+		R3051Jit_emitCall(jit, (uintptr_t)&SystemInterlink_appendSyncCycles);
+#else
+		R3051Jit_emitAddQuadImmediate(jit,
+				PHILPSX_R3051JIT_PENDING_SYNC_CYCLES, cycles);
+#endif
+		return;
+	}
+
+	// Otherwise account for the fetch and hand over to the interpreter
+	R3051Jit_emitStoreImmediate(jit, PHILPSX_R3051JIT_CYCLES, stallCycles);
+	if (stallCycles != 0)
+		R3051Jit_emitAddQuadImmediate(jit, PHILPSX_R3051JIT_TOTAL_CYCLES,
+				stallCycles);
+	R3051Jit_emitByte(jit, 0x48);				// mov rdi, rbx
+	R3051Jit_emitByte(jit, 0x89);
+	R3051Jit_emitByte(jit, 0xDF);
+	R3051Jit_emitMoveImmediate(jit, PHILPSX_X64_ESI, instruction);
+	R3051Jit_emitMoveImmediate(jit, PHILPSX_X64_EDX, address - 4);
+	R3051Jit_emitCall(jit, (uintptr_t)&R3051_completeInstruction);
+	if (lastInstruction)
+		return;
+
+	// Leave the block if the instruction didn't fall through to the next
+	// one, for example due to an exception
+	R3051Jit_emitCompareImmediate(jit, PHILPSX_R3051JIT_PC, address + 4);
+	exitJumps[(*exitJumpCount)++] = R3051Jit_emitExitJump(jit,
+			PHILPSX_X64_JNE);
+
+	// Leave the block if the instruction could have changed the rest of it
+	// and it is no longer valid
+	if (R3051BlockCache_needsRevalidation(instruction)) {
+		R3051Jit_emitByte(jit, 0x48);			// mov rdi, block
+		R3051Jit_emitByte(jit, 0xBF);
+		R3051Jit_emitQuad(jit, (uintptr_t)block);
+		R3051Jit_emitByte(jit, 0x48);			// mov rsi, rbx
+		R3051Jit_emitByte(jit, 0x89);
+		R3051Jit_emitByte(jit, 0xDE);
+		R3051Jit_emitMoveImmediate(jit, PHILPSX_X64_EDX, index + 1);
+		R3051Jit_emitCall(jit, (uintptr_t)&R3051Block_revalidate);
+		R3051Jit_emitByte(jit, 0x84);			// test al, al
+		R3051Jit_emitByte(jit, 0xC0);
+		exitJumps[(*exitJumpCount)++] = R3051Jit_emitExitJump(jit,
+				PHILPSX_X64_JE);
+	}
+}
+
+/*
+ * This function emits mov reg, [rbx + offset].
+ */
+static void R3051Jit_emitLoad(R3051Jit *jit, int32_t reg, int32_t offset)
+{
+	R3051Jit_emitByte(jit, 0x8B);
+	R3051Jit_emitModRM(jit, reg, offset);
+}
+
+/*
+ * This function emits a ModRM byte and displacement addressing
+ * [rbx + offset].
+ */
+static void R3051Jit_emitModRM(R3051Jit *jit, int32_t reg, int32_t offset)
+{
+	R3051Jit_emitByte(jit, 0x80 | (reg << 3) | PHILPSX_X64_EBX);
+	R3051Jit_emitWord(jit, offset);
+}
+
+/*
+ * This function emits mov reg, value.
+ */
+static void R3051Jit_emitMoveImmediate(R3051Jit *jit, int32_t reg,
+		int32_t value)
+{
+	R3051Jit_emitByte(jit, 0xB8 + reg);
+	R3051Jit_emitWord(jit, value);
+}
+
+/*
+ * This function emits host code which performs the register operation of
+ * the specified instruction directly, if it is one we handle natively. It
+ * returns false without emitting anything otherwise.
+ */
+static bool R3051Jit_emitNativeOp(R3051Jit *jit, int32_t instruction)
+{
+	// Decode instruction fields
+	int32_t opcode = logical_rshift(instruction, 26);
+	int32_t rs = logical_rshift(instruction, 21) & 0x1F;
+	int32_t rt = logical_rshift(instruction, 16) & 0x1F;
+	int32_t rd = logical_rshift(instruction, 11) & 0x1F;
+	int32_t shamt = logical_rshift(instruction, 6) & 0x1F;
+	int32_t immediate = instruction & 0xFFFF;
+	int32_t signedImmediate = (int16_t)immediate;
+
+	switch (opcode) {
+		case 0: // SPECIAL
+			switch (instruction & 0x3F) {
+				case 0: // SLL
+				case 2: // SRL
+				case 3: // SRA
+				{
+					if (rd == 0)
+						return true;
+					int32_t extension = (instruction & 0x3F) == 0 ?
+						PHILPSX_X64_EXT_SHL :
+						(instruction & 0x3F) == 2 ?
+							PHILPSX_X64_EXT_SHR : PHILPSX_X64_EXT_SAR;
+					R3051Jit_emitLoad(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rt));
+					if (shamt != 0)
+						R3051Jit_emitShiftImmediate(jit, extension, shamt);
+					R3051Jit_emitStore(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rd));
+					return true;
+				}
+				case 4: // SLLV
+				case 6: // SRLV
+				case 7: // SRAV
+				{
+					if (rd == 0)
+						return true;
+					int32_t extension = (instruction & 0x3F) == 4 ?
+						PHILPSX_X64_EXT_SHL :
+						(instruction & 0x3F) == 6 ?
+							PHILPSX_X64_EXT_SHR : PHILPSX_X64_EXT_SAR;
+					R3051Jit_emitLoad(jit, PHILPSX_X64_ECX,
+							PHILPSX_R3051JIT_GPR(rs));
+					R3051Jit_emitLoad(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rt));
+					R3051Jit_emitByte(jit, 0xD3);	// shift eax, cl
+					R3051Jit_emitByte(jit, 0xC0 | (extension << 3));
+					R3051Jit_emitStore(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rd));
+					return true;
+				}
+				case 16: // MFHI
+				case 18: // MFLO
+					if (rd == 0)
+						return true;
+					R3051Jit_emitLoad(jit, PHILPSX_X64_EAX,
+							(instruction & 0x3F) == 16 ?
+								PHILPSX_R3051JIT_HI : PHILPSX_R3051JIT_LO);
+					R3051Jit_emitStore(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rd));
+					return true;
+				case 17: // MTHI
+				case 19: // MTLO
+					R3051Jit_emitLoad(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rs));
+					R3051Jit_emitStore(jit, PHILPSX_X64_EAX,
+							(instruction & 0x3F) == 17 ?
+								PHILPSX_R3051JIT_HI : PHILPSX_R3051JIT_LO);
+					return true;
+				case 24: // MULT
+				case 25: // MULTU
+					R3051Jit_emitLoad(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rs));
+					R3051Jit_emitByte(jit, 0xF7);	// (i)mul [rt]
+					R3051Jit_emitModRM(jit, (instruction & 0x3F) == 24 ?
+							PHILPSX_X64_EXT_IMUL : PHILPSX_X64_EXT_MUL,
+							PHILPSX_R3051JIT_GPR(rt));
+					R3051Jit_emitStore(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_LO);
+					R3051Jit_emitStore(jit, PHILPSX_X64_EDX,
+							PHILPSX_R3051JIT_HI);
+					return true;
+				case 33: // ADDU
+				case 35: // SUBU
+				case 36: // AND
+				case 37: // OR
+				case 38: // XOR
+				case 39: // NOR
+				{
+					if (rd == 0)
+						return true;
+					int32_t aluOpcode = PHILPSX_X64_ADD;
+					switch (instruction & 0x3F) {
+						case 35:
+							aluOpcode = PHILPSX_X64_SUB;
+							break;
+						case 36:
+							aluOpcode = PHILPSX_X64_AND;
+							break;
+						case 37:
+						case 39:
+							aluOpcode = PHILPSX_X64_OR;
+							break;
+						case 38:
+							aluOpcode = PHILPSX_X64_XOR;
+							break;
+					}
+					R3051Jit_emitLoad(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rs));
+					R3051Jit_emitAluMemory(jit, aluOpcode, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rt));
+					if ((instruction & 0x3F) == 39) {
+						R3051Jit_emitByte(jit, 0xF7);	// not eax
+						R3051Jit_emitByte(jit, 0xD0);
+					}
+					R3051Jit_emitStore(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rd));
+					return true;
+				}
+				case 42: // SLT
+				case 43: // SLTU
+					if (rd == 0)
+						return true;
+					R3051Jit_emitLoad(jit, PHILPSX_X64_EAX,
+							PHILPSX_R3051JIT_GPR(rs));
+					R3051Jit_emitAluMemory(jit, PHILPSX_X64_CMP,
+							PHILPSX_X64_EAX, PHILPSX_R3051JIT_GPR(rt));
+					R3051Jit_emitSetCondition(jit, (instruction & 0x3F) == 42 ?
+							PHILPSX_X64_SETL : PHILPSX_X64_SETB, rd);
+					return true;
+			}
+			break;
+		case 9: // ADDIU
+		case 12: // ANDI
+		case 13: // ORI
+		case 14: // XORI
+		{
+			if (rt == 0)
+				return true;
+			int32_t extension = PHILPSX_X64_EXT_ADD;
+			int32_t value = signedImmediate;
+			switch (opcode) {
+				case 12:
+					extension = PHILPSX_X64_EXT_AND;
+					value = immediate;
+					break;
+				case 13:
+					extension = PHILPSX_X64_EXT_OR;
+					value = immediate;
+					break;
+				case 14:
+					extension = PHILPSX_X64_EXT_XOR;
+					value = immediate;
+					break;
+			}
+			R3051Jit_emitLoad(jit, PHILPSX_X64_EAX, PHILPSX_R3051JIT_GPR(rs));
+			R3051Jit_emitAluImmediate(jit, extension, value);
+			R3051Jit_emitStore(jit, PHILPSX_X64_EAX, PHILPSX_R3051JIT_GPR(rt));
+			return true;
+		}
+		case 10: // SLTI
+			if (rt == 0)
+				return true;
+			R3051Jit_emitLoad(jit, PHILPSX_X64_EAX, PHILPSX_R3051JIT_GPR(rs));
+			R3051Jit_emitAluImmediate(jit, PHILPSX_X64_EXT_CMP,
+					signedImmediate);
+			R3051Jit_emitSetCondition(jit, PHILPSX_X64_SETL, rt);
+			return true;
+		case 15: // LUI
+			if (rt == 0)
+				return true;
+			R3051Jit_emitStoreImmediate(jit, PHILPSX_R3051JIT_GPR(rt),
+					immediate << 16);
+			return true;
+	}
+
+	// Not handled natively
+	return false;
+}
+
+/*
+ * This function emits a 64-bit value into the host code.
+ */
+static void R3051Jit_emitQuad(R3051Jit *jit, uint64_t value)
+{
+	for (int32_t i = 0; i < 8; ++i) {
+		R3051Jit_emitByte(jit, (int32_t)(value & 0xFF));
+		value >>= 8;
+	}
+}
+
+/*
+ * This function emits code to store 1 or 0 into the specified processor
+ * register depending on the flags from a previous comparison.
+ */
+static void R3051Jit_emitSetCondition(R3051Jit *jit, int32_t condition,
+		int32_t rd)
+{
+	R3051Jit_emitByte(jit, 0x0F);				// setcc al
+	R3051Jit_emitByte(jit, condition);
+	R3051Jit_emitByte(jit, 0xC0);
+	R3051Jit_emitByte(jit, 0x0F);				// movzx eax, al
+	R3051Jit_emitByte(jit, 0xB6);
+	R3051Jit_emitByte(jit, 0xC0);
+	R3051Jit_emitStore(jit, PHILPSX_X64_EAX, PHILPSX_R3051JIT_GPR(rd));
+}
+
+/*
+ * This function emits a shift of eax by an immediate amount.
+ */
+static void R3051Jit_emitShiftImmediate(R3051Jit *jit, int32_t extension,
+		int32_t amount)
+{
+	R3051Jit_emitByte(jit, 0xC1);
+	R3051Jit_emitByte(jit, 0xC0 | (extension << 3));
+	R3051Jit_emitByte(jit, amount);
+}
+
+/*
+ * This function emits mov [rbx + offset], reg.
+ */
+static void R3051Jit_emitStore(R3051Jit *jit, int32_t reg, int32_t offset)
+{
+	R3051Jit_emitByte(jit, 0x89);
+	R3051Jit_emitModRM(jit, reg, offset);
+}
+
+/*
+ * This function emits mov dword [rbx + offset], value.
+ */
+static void R3051Jit_emitStoreImmediate(R3051Jit *jit, int32_t offset,
+		int32_t value)
+{
+	R3051Jit_emitByte(jit, 0xC7);
+	R3051Jit_emitModRM(jit, 0, offset);
+	R3051Jit_emitWord(jit, value);
+}
+
+/*
+ * This function emits a 32-bit value into the host code.
+ */
+static void R3051Jit_emitWord(R3051Jit *jit, int32_t value)
+{
+	for (int32_t i = 0; i < 4; ++i) {
+		R3051Jit_emitByte(jit, value & 0xFF);
+		value = logical_rshift(value, 8);
+	}
+}
@@ -0,0 +1,553 @@
+/*
+ * This C file models the profiler of the R3051 processor as a class. After
+ * each block of code runs, the processor tells the profiler where the block
+ * started and how many cycles it took, which are added up for each block in
+ * an open addressing hash table. These counts are exact.
+ *
+ * Every so many cycles, the block being run and the return address register
+ * are also recorded as a sample in a second table, weighted by the cycles
+ * since the last one. The return address is only a guess at the caller, as
+ * leaf functions don't save it and others may have moved on from it, but it
+ * is enough to show which functions a hot block is reached from. Samples
+ * are written out as folded stacks, one "caller;block cycles" line each,
+ * which flame graph tools read directly and can convert to other formats.
+ *
+ * Addresses are named from a symbol map if one is loaded, with each line
+ * giving a hexadecimal address and a name, optionally with a type letter
+ * in between as printed by nm. Addresses without a symbol are shown in
+ * hexadecimal.
+ *
+ * Everything here runs on the emulator thread, other than the results,
+ * which should only be written out once it has stopped.
+ *
+ * R3051Profiler.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/R3051Profiler.h"
+
+// Starting size of each table, which doubles whenever it is half full
+#define PHILPSX_R3051PROFILER_INITIAL_CAPACITY 4096
+
+// Cycles between samples, making for roughly 8000 samples per emulated
+// second
+#define PHILPSX_R3051PROFILER_SAMPLE_CYCLES 4096
+
+// Longest line read from a symbol map
+#define PHILPSX_R3051PROFILER_MAX_LINE 512
+
+/*
+ * This struct holds the counts for one key, which is a block address, or a
+ * return address and block address together for samples. An entry is free
+ * if it has not been entered.
+ */
+typedef struct {
+	uint64_t key;
+	int64_t entries;
+	int64_t cycles;
+} R3051ProfileEntry;
+
+/*
+ * This struct holds a table of entries, with its size given as a power of
+ * two.
+ */
+typedef struct {
+	R3051ProfileEntry *entries;
+	int32_t capacityShift;
+	int32_t count;
+} R3051ProfileTable;
+
+/*
+ * This struct holds a symbol from the symbol map.
+ */
+typedef struct {
+	uint32_t address;
+	char *name;
+} R3051ProfileSymbol;
+
+/*
+ * This struct holds the tables of blocks and samples, along with the
+ * symbol map.
+ */
+struct R3051Profiler {
+
+	// Exact counts for each block, and sampled counts for each pair of
+	// return address and block
+	R3051ProfileTable blocks;
+	R3051ProfileTable samples;
+
+	// Cycles left until the next sample
+	int64_t cyclesToSample;
+
+	// Totals across all blocks
+	int64_t totalEntries;
+	int64_t totalCycles;
+
+	// Whether a table couldn't be grown, after which nothing more is
+	// recorded so the results stay consistent
+	bool full;
+
+	// Symbols sorted by address
+	R3051ProfileSymbol *symbols;
+	int32_t symbolCount;
+};
+
+// Forward declarations for functions private to this class
+static bool R3051Profiler_addToTable(R3051ProfileTable *table, uint64_t key,
+		int64_t entries, int64_t cycles);
+static int R3051Profiler_compareCycles(const void *first, const void *second);
+static int R3051Profiler_compareSymbols(const void *first,
+		const void *second);
+static bool R3051Profiler_constructTable(R3051ProfileTable *table,
+		int32_t capacityShift);
+static bool R3051Profiler_growTable(R3051ProfileTable *table);
+static const char *R3051Profiler_nameAddress(R3051Profiler *profiler,
+		uint32_t address, char *buffer, size_t length);
+static void R3051Profiler_writeFrame(R3051Profiler *profiler, FILE *file,
+		uint32_t address);
+
+/*
+ * This constructs a new R3051Profiler object with empty tables and no
+ * symbols.
+ */
+R3051Profiler *construct_R3051Profiler(void)
+{
+	// Allocate profiler
+	R3051Profiler *profiler = calloc(1, sizeof(R3051Profiler));
+	if (!profiler) {
+		fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't allocate memory "
+				"for R3051Profiler struct\n");
+		goto end;
+	}
+
+	// Allocate tables
+	if (!R3051Profiler_constructTable(&profiler->blocks,
+			__builtin_ctz(PHILPSX_R3051PROFILER_INITIAL_CAPACITY))) {
+		fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't allocate memory "
+				"for block table\n");
+		goto cleanup_profiler;
+	}
+	if (!R3051Profiler_constructTable(&profiler->samples,
+			__builtin_ctz(PHILPSX_R3051PROFILER_INITIAL_CAPACITY))) {
+		fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't allocate memory "
+				"for sample table\n");
+		goto cleanup_blocks;
+	}
+
+	profiler->cyclesToSample = PHILPSX_R3051PROFILER_SAMPLE_CYCLES;
+
+	// Normal return:
+	return profiler;
+
+	// Cleanup path:
+	cleanup_blocks:
+	free(profiler->blocks.entries);
+
+	cleanup_profiler:
+	free(profiler);
+	profiler = NULL;
+
+	end:
+	return profiler;
+}
+
+/*
+ * This destructs an R3051Profiler object.
+ */
+void destruct_R3051Profiler(R3051Profiler *profiler)
+{
+	for (int32_t i = 0; i < profiler->symbolCount; ++i)
+		free(profiler->symbols[i].name);
+	free(profiler->symbols);
+	free(profiler->samples.entries);
+	free(profiler->blocks.entries);
+	free(profiler);
+}
+
+/*
+ * This function loads a symbol map, replacing any loaded before. It returns
+ * false if the file couldn't be read, in which case the old symbols are
+ * kept.
+ */
+bool R3051Profiler_loadSymbols(R3051Profiler *profiler, const char *path)
+{
+	bool retVal = false;
+	R3051ProfileSymbol *symbols = NULL;
+	int32_t symbolCount = 0;
+	int32_t symbolCapacity = 0;
+
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't open symbol map "
+				"%s\n", path);
+		goto end;
+	}
+
+	// Read a symbol from each line, skipping ones that don't start with an
+	// address, along with comments
+	char line[PHILPSX_R3051PROFILER_MAX_LINE];
+	while (fgets(line, sizeof(line), file)) {
+		char *position = line;
+		while (isspace((unsigned char)*position))
+			++position;
+		if (*position == '#' || !isxdigit((unsigned char)*position))
+			continue;
+		char *afterAddress;
+		uint32_t address = (uint32_t)strtoul(position, &afterAddress, 16);
+		if (afterAddress == position ||
+				!isspace((unsigned char)*afterAddress))
+			continue;
+
+		// Skip the type letter nm puts before the name, if there is one
+		position = afterAddress;
+		while (isspace((unsigned char)*position))
+			++position;
+		if (position[0] != '\0' && isspace((unsigned char)position[1])) {
+			char *afterType = position + 1;
+			while (isspace((unsigned char)*afterType))
+				++afterType;
+			if (*afterType != '\0')
+				position = afterType;
+		}
+
+		// Take the name up to the end of the line
+		size_t nameLength = strcspn(position, " \t\r\n");
+		if (nameLength == 0)
+			continue;
+
+		// Store the symbol
+		if (symbolCount == symbolCapacity) {
+			int32_t newCapacity = symbolCapacity ? symbolCapacity * 2 : 256;
+			R3051ProfileSymbol *newSymbols = realloc(symbols,
+					newCapacity * sizeof(R3051ProfileSymbol));
+			if (!newSymbols) {
+				fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't allocate "
+						"memory for symbols\n");
+				goto cleanup_symbols;
+			}
+			symbols = newSymbols;
+			symbolCapacity = newCapacity;
+		}
+		char *name = malloc(nameLength + 1);
+		if (!name) {
+			fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't allocate "
+					"memory for symbols\n");
+			goto cleanup_symbols;
+		}
+		memcpy(name, position, nameLength);
+		name[nameLength] = '\0';
+		symbols[symbolCount].address = address;
+		symbols[symbolCount].name = name;
+		++symbolCount;
+	}
+	if (ferror(file)) {
+		fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't read symbol map "
+				"%s\n", path);
+		goto cleanup_symbols;
+	}
+
+	// Sort them for looking up, and replace the old ones
+	qsort(symbols, symbolCount, sizeof(R3051ProfileSymbol),
+			&R3051Profiler_compareSymbols);
+	for (int32_t i = 0; i < profiler->symbolCount; ++i)
+		free(profiler->symbols[i].name);
+	free(profiler->symbols);
+	profiler->symbols = symbols;
+	profiler->symbolCount = symbolCount;
+	symbols = NULL;
+	symbolCount = 0;
+	retVal = true;
+
+	// Cleanup path:
+	cleanup_symbols:
+	for (int32_t i = 0; i < symbolCount; ++i)
+		free(symbols[i].name);
+	free(symbols);
+	fclose(file);
+
+	end:
+	return retVal;
+}
+
+/*
+ * This function prints the blocks that took the most cycles, up to the
+ * given number of them, with how often each was entered and its share of
+ * all cycles.
+ */
+void R3051Profiler_printHotBlocks(R3051Profiler *profiler, int32_t count)
+{
+	printf("PhilPSX: R3051Profiler: %" PRId64 " blocks entered over %"
+			PRId64 " cycles\n", profiler->totalEntries,
+			profiler->totalCycles);
+	if (profiler->totalCycles == 0)
+		return;
+
+	// Gather the entries in use and sort them by cycles
+	R3051ProfileEntry *sorted = malloc(profiler->blocks.count *
+			sizeof(R3051ProfileEntry));
+	if (!sorted) {
+		fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't allocate memory "
+				"for sorting blocks\n");
+		return;
+	}
+	int32_t used = 0;
+	int32_t capacity = 1 << profiler->blocks.capacityShift;
+	for (int32_t i = 0; i < capacity; ++i) {
+		if (profiler->blocks.entries[i].entries != 0)
+			sorted[used++] = profiler->blocks.entries[i];
+	}
+	qsort(sorted, used, sizeof(R3051ProfileEntry),
+			&R3051Profiler_compareCycles);
+
+	// Print the hottest ones
+	if (count > used)
+		count = used;
+	char name[32];
+	for (int32_t i = 0; i < count; ++i) {
+		uint32_t address = (uint32_t)sorted[i].key;
+		printf("PhilPSX: R3051Profiler: %08" PRIX32 " %-24s %12" PRId64
+				" entries %14" PRId64 " cycles %5.1f%%\n", address,
+				R3051Profiler_nameAddress(profiler, address, name,
+				sizeof(name)), sorted[i].entries, sorted[i].cycles,
+				sorted[i].cycles * 100.0 / profiler->totalCycles);
+	}
+
+	free(sorted);
+}
+
+/*
+ * This function records that the block starting at the given address was
+ * entered and took the given number of cycles, along with the return
+ * address register at the end of it for sampling.
+ */
+void R3051Profiler_recordBlock(R3051Profiler *profiler, int32_t address,
+		int64_t cycles, int32_t returnAddress)
+{
+	if (profiler->full)
+		return;
+
+	// Count the block exactly
+	if (!R3051Profiler_addToTable(&profiler->blocks, (uint32_t)address, 1,
+			cycles))
+		goto full;
+	++profiler->totalEntries;
+	profiler->totalCycles += cycles;
+
+	// Take a sample if it is time to, counting more than one if the block
+	// took longer than the gap between them
+	profiler->cyclesToSample -= cycles;
+	if (profiler->cyclesToSample > 0)
+		return;
+	int64_t samples = 1 + -profiler->cyclesToSample /
+			PHILPSX_R3051PROFILER_SAMPLE_CYCLES;
+	profiler->cyclesToSample += samples * PHILPSX_R3051PROFILER_SAMPLE_CYCLES;
+	uint64_t key = (uint64_t)(uint32_t)returnAddress << 32 |
+			(uint32_t)address;
+	if (R3051Profiler_addToTable(&profiler->samples, key, samples,
+			samples * PHILPSX_R3051PROFILER_SAMPLE_CYCLES))
+		return;
+
+	full:
+	fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't grow table, "
+			"profiling stopped\n");
+	profiler->full = true;
+}
+
+/*
+ * This function writes the samples out as folded stacks, one line for each
+ * pair of caller and block with the cycles it was sampled for. It returns
+ * false if the file couldn't be written.
+ */
+bool R3051Profiler_writeFoldedStacks(R3051Profiler *profiler,
+		const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't open %s for "
+				"writing\n", path);
+		return false;
+	}
+
+	// Write a line for each sampled pair, leaving out the caller where the
+	// return address was never set
+	int32_t capacity = 1 << profiler->samples.capacityShift;
+	for (int32_t i = 0; i < capacity; ++i) {
+		R3051ProfileEntry *entry = &profiler->samples.entries[i];
+		if (entry->entries == 0)
+			continue;
+		uint32_t returnAddress = (uint32_t)(entry->key >> 32);
+		if (returnAddress != 0) {
+			R3051Profiler_writeFrame(profiler, file, returnAddress);
+			fputc(';', file);
+		}
+		R3051Profiler_writeFrame(profiler, file, (uint32_t)entry->key);
+		fprintf(file, " %" PRId64 "\n", entry->cycles);
+	}
+
+	bool retVal = !ferror(file);
+	if (fclose(file) != 0)
+		retVal = false;
+	if (!retVal)
+		fprintf(stderr, "PhilPSX: R3051Profiler: Couldn't write %s\n", path);
+	return retVal;
+}
+
+/*
+ * This function adds to the counts for a key, inserting it if it isn't in
+ * the table yet. It returns false if the table needed growing and couldn't
+ * be.
+ */
+static bool R3051Profiler_addToTable(R3051ProfileTable *table, uint64_t key,
+		int64_t entries, int64_t cycles)
+{
+	for (;;) {
+		// Probe from the key's hash until we find it or a free entry
+		uint32_t mask = (1u << table->capacityShift) - 1;
+		uint32_t index = (uint32_t)((key * 0x9E3779B97F4A7C15ull) >>
+				(64 - table->capacityShift));
+		R3051ProfileEntry *entry = &table->entries[index];
+		while (entry->entries != 0 && entry->key != key) {
+			index = (index + 1) & mask;
+			entry = &table->entries[index];
+		}
+
+		// Add to it if it is there
+		if (entry->entries != 0) {
+			entry->entries += entries;
+			entry->cycles += cycles;
+			return true;
+		}
+
+		// Otherwise insert it, growing the table first if that would take
+		// it over half full
+		if ((table->count + 1) * 2 <= (int32_t)(mask + 1)) {
+			entry->key = key;
+			entry->entries = entries;
+			entry->cycles = cycles;
+			++table->count;
+			return true;
+		}
+		if (!R3051Profiler_growTable(table))
+			return false;
+	}
+}
+
+/*
+ * This function orders entries by descending cycles for qsort.
+ */
+static int R3051Profiler_compareCycles(const void *first, const void *second)
+{
+	const R3051ProfileEntry *firstEntry = first;
+	const R3051ProfileEntry *secondEntry = second;
+	if (firstEntry->cycles != secondEntry->cycles)
+		return firstEntry->cycles < secondEntry->cycles ? 1 : -1;
+	return firstEntry->key < secondEntry->key ? -1 :
+			firstEntry->key > secondEntry->key;
+}
+
+/*
+ * This function orders symbols by ascending address for qsort.
+ */
+static int R3051Profiler_compareSymbols(const void *first,
+		const void *second)
+{
+	const R3051ProfileSymbol *firstSymbol = first;
+	const R3051ProfileSymbol *secondSymbol = second;
+	return firstSymbol->address < secondSymbol->address ? -1 :
+			firstSymbol->address > secondSymbol->address;
+}
+
+/*
+ * This function allocates an empty table with two to the power of the
+ * given number of entries. It returns false if it couldn't.
+ */
+static bool R3051Profiler_constructTable(R3051ProfileTable *table,
+		int32_t capacityShift)
+{
+	table->entries = calloc((size_t)1 << capacityShift,
+			sizeof(R3051ProfileEntry));
+	if (!table->entries)
+		return false;
+	table->capacityShift = capacityShift;
+	table->count = 0;
+	return true;
+}
+
+/*
+ * This function doubles the size of a table, reinserting its entries. It
+ * returns false if it couldn't, leaving the table as it was.
+ */
+static bool R3051Profiler_growTable(R3051ProfileTable *table)
+{
+	R3051ProfileTable newTable;
+	if (table->capacityShift >= 30 ||
+			!R3051Profiler_constructTable(&newTable,
+			table->capacityShift + 1))
+		return false;
+
+	int32_t capacity = 1 << table->capacityShift;
+	for (int32_t i = 0; i < capacity; ++i) {
+		R3051ProfileEntry *entry = &table->entries[i];
+		if (entry->entries != 0)
+			R3051Profiler_addToTable(&newTable, entry->key, entry->entries,
+					entry->cycles);
+	}
+
+	free(table->entries);
+	*table = newTable;
+	return true;
+}
+
+/*
+ * This function names an address by the symbol at or before it, with an
+ * offset if it isn't at the start of the symbol, falling back to
+ * hexadecimal if there is none. The name is put in the given buffer unless
+ * it is a symbol name as is.
+ */
+static const char *R3051Profiler_nameAddress(R3051Profiler *profiler,
+		uint32_t address, char *buffer, size_t length)
+{
+	// Find the last symbol at or before the address
+	int32_t low = 0;
+	int32_t high = profiler->symbolCount;
+	while (low < high) {
+		int32_t middle = low + (high - low) / 2;
+		if (profiler->symbols[middle].address <= address)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low == 0) {
+		snprintf(buffer, length, "%08" PRIX32, address);
+		return buffer;
+	}
+	R3051ProfileSymbol *symbol = &profiler->symbols[low - 1];
+	if (symbol->address == address)
+		return symbol->name;
+	snprintf(buffer, length, "%s+0x%" PRIX32, symbol->name,
+			address - symbol->address);
+	return buffer;
+}
+
+/*
+ * This function writes one frame of a folded stack. Frames are named by
+ * the symbol they are in, without an offset, so that samples from the same
+ * function are merged.
+ */
+static void R3051Profiler_writeFrame(R3051Profiler *profiler, FILE *file,
+		uint32_t address)
+{
+	char name[PHILPSX_R3051PROFILER_MAX_LINE];
+	const char *frameName = R3051Profiler_nameAddress(profiler, address,
+			name, sizeof(name));
+
+	// Cut off any offset, keeping hexadecimal addresses whole
+	size_t frameLength = strcspn(frameName, "+");
+	fwrite(frameName, 1, frameLength, file);
+}
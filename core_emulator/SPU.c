@@ -3,24 +3,287 @@
  * 
  * SPU.c - Copyright Phillip Potter, 2020, under GPLv3
  */
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "../headers/SPU.h"
+#include "../headers/SaveState.h"
 #include "../headers/SystemInterlink.h"
+#include "../headers/endian_utils.h"
+#include "../headers/math_utils.h"
+
+// Number of voices, and size of sound RAM
+#define PHILPSX_SPU_VOICE_COUNT 24
+#define PHILPSX_SPU_RAM_SIZE 0x80000
+
+// The SPU produces one stereo sample every 768 CPU cycles (44.1 kHz), and
+// its event fires once every 32 samples to work them out in a batch
+#define PHILPSX_SPU_CYCLES_PER_SAMPLE 768
+#define PHILPSX_SPU_SAMPLES_PER_EVENT 32
+
+// Number of stereo samples the output buffer can hold
+#define PHILPSX_SPU_BUFFER_FRAMES 8192
+
+// Envelope phases of each voice
+#define PHILPSX_SPU_PHASE_OFF 0
+#define PHILPSX_SPU_PHASE_ATTACK 1
+#define PHILPSX_SPU_PHASE_DECAY 2
+#define PHILPSX_SPU_PHASE_SUSTAIN 3
+#define PHILPSX_SPU_PHASE_RELEASE 4
+
+// Offsets of reverb registers from 0x1F801DC0, in halfwords
+#define PHILPSX_SPU_REVERB_DAPF1 0
+#define PHILPSX_SPU_REVERB_DAPF2 1
+#define PHILPSX_SPU_REVERB_VIIR 2
+#define PHILPSX_SPU_REVERB_VCOMB1 3
+#define PHILPSX_SPU_REVERB_VWALL 7
+#define PHILPSX_SPU_REVERB_VAPF1 8
+#define PHILPSX_SPU_REVERB_VAPF2 9
+#define PHILPSX_SPU_REVERB_MLSAME 10
+#define PHILPSX_SPU_REVERB_MLCOMB1 12
+#define PHILPSX_SPU_REVERB_MLCOMB2 14
+#define PHILPSX_SPU_REVERB_DLSAME 16
+#define PHILPSX_SPU_REVERB_MLDIFF 18
+#define PHILPSX_SPU_REVERB_MLCOMB3 20
+#define PHILPSX_SPU_REVERB_MLCOMB4 22
+#define PHILPSX_SPU_REVERB_DLDIFF 24
+#define PHILPSX_SPU_REVERB_MLAPF1 26
+#define PHILPSX_SPU_REVERB_MLAPF2 28
+#define PHILPSX_SPU_REVERB_VLIN 30
+
+// Typedefs
+typedef struct SPUVoice SPUVoice;
+
+// Forward declarations for functions private to this class
+// SPU-related stuff:
+static void SPU_checkInterrupt(SPU *spu, int32_t address, int32_t length);
+static void SPU_decodeBlock(SPU *spu, SPUVoice *voice);
+static void SPU_generateSample(SPU *spu);
+static void SPU_getCdAudio(SPU *spu, int32_t *cdAudio);
+static void SPU_keyOff(SPU *spu, int32_t voices);
+static void SPU_keyOn(SPU *spu, int32_t voices);
+static void SPU_mixVoices(SPU *spu, int32_t *mix);
+static void SPU_processReverb(SPU *spu, int32_t inputLeft,
+		int32_t inputRight);
+static int32_t SPU_readRegister(SPU *spu, int32_t offset);
+static int32_t SPU_readRegisterByte(void *component, int32_t address);
+static int32_t SPU_readRegisterHalfWord(void *component, int32_t address);
+static int32_t SPU_readRegisterWord(void *component, int32_t address);
+static int32_t SPU_readReverb(SPU *spu, int32_t offset);
+static int32_t SPU_readReverbRegister(SPU *spu, int32_t index);
+static int32_t SPU_reverbAddress(SPU *spu, int32_t offset);
+static int32_t SPU_stepEnvelope(int32_t level, int32_t *counter,
+		bool exponential, bool decrease, int32_t shift, int32_t step);
+static void SPU_stepNoise(SPU *spu);
+static void SPU_stepVoice(SPU *spu, int32_t voiceNumber);
+static int32_t SPU_stepVolume(int32_t volume, int32_t current,
+		int32_t *counter);
+static void SPU_writeRegister(SPU *spu, int32_t offset, int32_t value);
+static void SPU_writeRegisterByte(void *component, int32_t address,
+		int32_t value);
+static void SPU_writeRegisterHalfWord(void *component, int32_t address,
+		int32_t value);
+static void SPU_writeRegisterWord(void *component, int32_t address,
+		int32_t value);
+static void SPU_writeReverb(SPU *spu, int32_t offset, int32_t value);
+
+// ADPCM filter coefficients, in 1/64ths
+static const int32_t SPU_adpcmPositive[5] = { 0, 60, 115, 98, 122 };
+static const int32_t SPU_adpcmNegative[5] = { 0, 0, -52, -55, -60 };
+
+/*
+ * This table holds the weights used to interpolate between four ADPCM
+ * samples, indexed by how far along we are between the middle two. It is
+ * worked out from a Gaussian curve shaped to match the hardware's, so is
+ * close to but not an exact copy of the table in the real SPU.
+ */
+static const int16_t SPU_gaussTable[512] = {
+	0x002E, 0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0036, 0x0037,
+	0x0038, 0x003A, 0x003B, 0x003C, 0x003E, 0x003F, 0x0041, 0x0042,
+	0x0044, 0x0046, 0x0047, 0x0049, 0x004B, 0x004C, 0x004E, 0x0050,
+	0x0052, 0x0054, 0x0056, 0x0058, 0x005A, 0x005C, 0x005E, 0x0060,
+	0x0062, 0x0065, 0x0067, 0x0069, 0x006C, 0x006E, 0x0071, 0x0073,
+	0x0076, 0x0078, 0x007B, 0x007E, 0x0081, 0x0084, 0x0087, 0x008A,
+	0x008D, 0x0090, 0x0093, 0x0096, 0x009A, 0x009D, 0x00A0, 0x00A4,
+	0x00A7, 0x00AB, 0x00AF, 0x00B3, 0x00B6, 0x00BA, 0x00BE, 0x00C3,
+	0x00C7, 0x00CB, 0x00CF, 0x00D4, 0x00D8, 0x00DD, 0x00E1, 0x00E6,
+	0x00EB, 0x00F0, 0x00F5, 0x00FA, 0x00FF, 0x0105, 0x010A, 0x0110,
+	0x0115, 0x011B, 0x0121, 0x0127, 0x012D, 0x0133, 0x0139, 0x0140,
+	0x0146, 0x014D, 0x0153, 0x015A, 0x0161, 0x0168, 0x016F, 0x0177,
+	0x017E, 0x0186, 0x018E, 0x0195, 0x019D, 0x01A6, 0x01AE, 0x01B6,
+	0x01BF, 0x01C7, 0x01D0, 0x01D9, 0x01E2, 0x01EC, 0x01F5, 0x01FF,
+	0x0209, 0x0213, 0x021D, 0x0227, 0x0231, 0x023C, 0x0247, 0x0252,
+	0x025D, 0x0268, 0x0274, 0x027F, 0x028B, 0x0297, 0x02A3, 0x02B0,
+	0x02BD, 0x02C9, 0x02D6, 0x02E4, 0x02F1, 0x02FF, 0x030D, 0x031B,
+	0x0329, 0x0337, 0x0346, 0x0355, 0x0364, 0x0374, 0x0383, 0x0393,
+	0x03A3, 0x03B4, 0x03C4, 0x03D5, 0x03E6, 0x03F8, 0x0409, 0x041B,
+	0x042D, 0x043F, 0x0452, 0x0465, 0x0478, 0x048B, 0x049F, 0x04B3,
+	0x04C7, 0x04DC, 0x04F1, 0x0506, 0x051B, 0x0531, 0x0547, 0x055D,
+	0x0574, 0x058A, 0x05A2, 0x05B9, 0x05D1, 0x05E9, 0x0601, 0x061A,
+	0x0633, 0x064D, 0x0666, 0x0681, 0x069B, 0x06B6, 0x06D1, 0x06EC,
+	0x0708, 0x0724, 0x0741, 0x075D, 0x077B, 0x0798, 0x07B6, 0x07D4,
+	0x07F3, 0x0812, 0x0831, 0x0851, 0x0871, 0x0892, 0x08B3, 0x08D4,
+	0x08F6, 0x0918, 0x093A, 0x095D, 0x0980, 0x09A4, 0x09C8, 0x09EC,
+	0x0A11, 0x0A37, 0x0A5C, 0x0A82, 0x0AA9, 0x0AD0, 0x0AF7, 0x0B1F,
+	0x0B47, 0x0B70, 0x0B99, 0x0BC3, 0x0BED, 0x0C17, 0x0C42, 0x0C6D,
+	0x0C99, 0x0CC5, 0x0CF2, 0x0D1F, 0x0D4C, 0x0D7A, 0x0DA9, 0x0DD8,
+	0x0E07, 0x0E37, 0x0E67, 0x0E98, 0x0EC9, 0x0EFB, 0x0F2D, 0x0F60,
+	0x0F93, 0x0FC6, 0x0FFA, 0x102F, 0x1064, 0x1099, 0x10CF, 0x1106,
+	0x113C, 0x1174, 0x11AC, 0x11E4, 0x121D, 0x1256, 0x1290, 0x12CA,
+	0x1305, 0x1340, 0x137C, 0x13B8, 0x13F5, 0x1432, 0x1470, 0x14AE,
+	0x14EC, 0x152C, 0x156B, 0x15AB, 0x15EC, 0x162D, 0x166E, 0x16B0,
+	0x16F3, 0x1736, 0x1779, 0x17BD, 0x1802, 0x1847, 0x188C, 0x18D2,
+	0x1918, 0x195F, 0x19A6, 0x19EE, 0x1A36, 0x1A7F, 0x1AC8, 0x1B11,
+	0x1B5B, 0x1BA6, 0x1BF1, 0x1C3C, 0x1C88, 0x1CD4, 0x1D21, 0x1D6E,
+	0x1DBC, 0x1E0A, 0x1E58, 0x1EA7, 0x1EF7, 0x1F46, 0x1F97, 0x1FE7,
+	0x2038, 0x2089, 0x20DB, 0x212E, 0x2180, 0x21D3, 0x2227, 0x227A,
+	0x22CE, 0x2323, 0x2378, 0x23CD, 0x2423, 0x2479, 0x24CF, 0x2526,
+	0x257D, 0x25D4, 0x262C, 0x2684, 0x26DC, 0x2735, 0x278E, 0x27E7,
+	0x2841, 0x289B, 0x28F5, 0x2950, 0x29AA, 0x2A05, 0x2A61, 0x2ABC,
+	0x2B18, 0x2B74, 0x2BD0, 0x2C2D, 0x2C89, 0x2CE6, 0x2D43, 0x2DA1,
+	0x2DFE, 0x2E5C, 0x2EBA, 0x2F18, 0x2F76, 0x2FD5, 0x3033, 0x3092,
+	0x30F1, 0x3150, 0x31AF, 0x320E, 0x326D, 0x32CD, 0x332C, 0x338C,
+	0x33EB, 0x344B, 0x34AA, 0x350A, 0x356A, 0x35CA, 0x362A, 0x3689,
+	0x36E9, 0x3749, 0x37A9, 0x3809, 0x3868, 0x38C8, 0x3928, 0x3987,
+	0x39E7, 0x3A46, 0x3AA5, 0x3B04, 0x3B63, 0x3BC2, 0x3C21, 0x3C80,
+	0x3CDE, 0x3D3D, 0x3D9B, 0x3DF9, 0x3E56, 0x3EB4, 0x3F11, 0x3F6E,
+	0x3FCB, 0x4028, 0x4084, 0x40E1, 0x413C, 0x4198, 0x41F3, 0x424E,
+	0x42A9, 0x4303, 0x435D, 0x43B7, 0x4410, 0x4469, 0x44C1, 0x4519,
+	0x4571, 0x45C8, 0x461F, 0x4676, 0x46CC, 0x4721, 0x4776, 0x47CB,
+	0x481F, 0x4873, 0x48C6, 0x4919, 0x496B, 0x49BC, 0x4A0D, 0x4A5E,
+	0x4AAE, 0x4AFD, 0x4B4C, 0x4B9A, 0x4BE7, 0x4C34, 0x4C81, 0x4CCC,
+	0x4D18, 0x4D62, 0x4DAC, 0x4DF5, 0x4E3D, 0x4E85, 0x4ECC, 0x4F12,
+	0x4F58, 0x4F9D, 0x4FE1, 0x5024, 0x5067, 0x50A9, 0x50EA, 0x512A,
+	0x516A, 0x51A8, 0x51E6, 0x5223, 0x5260, 0x529B, 0x52D6, 0x5310,
+	0x5348, 0x5381, 0x53B8, 0x53EE, 0x5424, 0x5458, 0x548C, 0x54BF,
+	0x54F0, 0x5521, 0x5551, 0x5580, 0x55AF, 0x55DC, 0x5608, 0x5633,
+	0x565E, 0x5687, 0x56B0, 0x56D7, 0x56FD, 0x5723, 0x5747, 0x576B,
+	0x578D, 0x57AF, 0x57CF, 0x57EE, 0x580D, 0x582A, 0x5847, 0x5862,
+	0x587C, 0x5895, 0x58AD, 0x58C5, 0x58DB, 0x58F0, 0x5904, 0x5916,
+	0x5928, 0x5939, 0x5949, 0x5957, 0x5965, 0x5971, 0x597D, 0x5987,
+	0x5990, 0x5998, 0x599F, 0x59A5, 0x59AA, 0x59AE, 0x59B1, 0x59B2
+};
 
 /*
- * This struct models the SPU (sound chip) of the PlayStation, and at present
- * is a stub. It is intended merely to store and return register values in
- * combination with the utility functions provided.
+ * This struct holds the register values and playback state of one voice.
+ * Its envelope level and output are kept in arrays in the SPU struct
+ * instead, so that the voices can be mixed together in parallel.
+ */
+struct SPUVoice {
+
+	// Register values, with addresses in bytes
+	int32_t volumeLeft;
+	int32_t volumeRight;
+	int32_t pitch;
+	int32_t startAddress;
+	int32_t adsrLow;
+	int32_t adsrHigh;
+	int32_t repeatAddress;
+
+	// Address and flags of the ADPCM block being played, along with how far
+	// into it we are in 1/4096ths of a sample
+	int32_t currentAddress;
+	int32_t blockFlags;
+	int32_t pitchCounter;
+
+	// Decoded samples of the block, after the last three of the previous
+	// block which are needed for interpolation, and the two most recent
+	// samples for the ADPCM filter
+	int16_t samples[31];
+	int32_t adpcmOld;
+	int32_t adpcmOlder;
+
+	// Envelope state
+	int32_t envelopePhase;
+	int32_t envelopeCounter;
+
+	// Sweep state of the left and right volumes
+	int32_t volumeCounter[2];
+};
+
+/*
+ * This struct models the SPU (sound chip) of the PlayStation, with its 24
+ * voices, sound RAM and reverb unit. Samples are worked out in batches,
+ * either when its event fires or when its registers are accessed, and
+ * stored in a buffer for the host to play.
  */
 struct SPU {
 
 	// This stores the link to the interlink object
 	SystemInterlink *system;
 
-	// This stores all values written by the system to the SPU
-	int8_t *fakeRegisterSpace;
+	// 512 KB of sound RAM
+	int8_t *soundRam;
+
+	// This stores the last value written to each register, which is what
+	// reads return for those without state of their own
+	int8_t registerSpace[1024];
+
+	// Voices, along with the per-voice values used while mixing them -
+	// the interpolated sample, envelope level, output after the envelope,
+	// current volumes and a mask of those sent to the reverb unit
+	SPUVoice voices[PHILPSX_SPU_VOICE_COUNT];
+	int32_t voiceSample[PHILPSX_SPU_VOICE_COUNT];
+	int32_t envelopeLevel[PHILPSX_SPU_VOICE_COUNT];
+	int32_t voiceOutput[PHILPSX_SPU_VOICE_COUNT];
+	int32_t currentVolumeLeft[PHILPSX_SPU_VOICE_COUNT];
+	int32_t currentVolumeRight[PHILPSX_SPU_VOICE_COUNT];
+	int32_t reverbMask[PHILPSX_SPU_VOICE_COUNT];
+
+	// Voice bitmasks
+	int32_t pitchModulation;
+	int32_t noiseMode;
+	int32_t endx;
+
+	// Control register, and whether an interrupt has happened since it was
+	// last acknowledged
+	int32_t control;
+	bool interruptFlag;
+
+	// Sound RAM addresses in bytes
+	int32_t transferAddress;
+	int32_t interruptAddress;
+	int32_t captureAddress;
+
+	// Noise generator state
+	int32_t noiseLevel;
+	int32_t noiseTimer;
+
+	// Current main volumes and their sweep state
+	int32_t mainVolume[2];
+	int32_t mainVolumeCounter[2];
+
+	// Batch of CD audio frames taken from the CD-ROM drive, and how far
+	// through it we are
+	int16_t cdAudio[PHILPSX_SPU_SAMPLES_PER_EVENT * 2];
+	int32_t cdAudioCount;
+	int32_t cdAudioIndex;
+
+	// Reverb work area and current position within it, along with the
+	// output of the last reverb step, which is worked out at half rate
+	int32_t reverbBase;
+	int32_t reverbAddress;
+	int32_t reverbOutput[2];
+	bool reverbStep;
+
+	// Buffer of generated stereo samples waiting to be played, as a ring
+	// starting at outputStart, and how many had to be dropped as it was full
+	int16_t outputBuffer[PHILPSX_SPU_BUFFER_FRAMES * 2];
+	int32_t outputStart;
+	int32_t outputCount;
+	int64_t droppedFrames;
+
+	// Store number of CPU cycles not yet turned into samples
+	int32_t cpuCycles;
 };
 
 /*
@@ -29,32 +292,33 @@ struct SPU {
 SPU *construct_SPU(void)
 {
 	// Allocate SPU struct
-	SPU *spu = malloc(sizeof(SPU));
+	SPU *spu = calloc(1, sizeof(SPU));
 	if (!spu) {
 		fprintf(stderr, "PhilPSX: SPU: Couldn't allocate memory for "
 				"SPU struct\n");
 		goto end;
 	}
-	
-	// Allocate memory for fake register space
-	spu->fakeRegisterSpace = calloc(1024, sizeof(int8_t));
-	if (!spu->fakeRegisterSpace) {
+
+	// Allocate memory for sound RAM
+	spu->soundRam = calloc(PHILPSX_SPU_RAM_SIZE, sizeof(int8_t));
+	if (!spu->soundRam) {
 		fprintf(stderr, "PhilPSX: SPU: Couldn't allocate memory for "
-				"fakeRegisterSpace array\n");
+				"soundRam array\n");
 		goto cleanup_spu;
 	}
-	
-	// Set SystemInterlink reference to NULL
+
+	// Set SystemInterlink reference to NULL - everything else starts off
+	// zeroed, with all voices off
 	spu->system = NULL;
-	
+
 	// Normal return:
 	return spu;
-	
+
 	// Cleanup path:
 	cleanup_spu:
 	free(spu);
 	spu = NULL;
-	
+
 	end:
 	return spu;
 }
@@ -64,32 +328,205 @@ SPU *construct_SPU(void)
  */
 void destruct_SPU(SPU *spu)
 {
-	free(spu->fakeRegisterSpace);
+	free(spu->soundRam);
 	free(spu);
 }
 
 /*
- * This function writes a byte to the fake store.
+ * This function appends the CPU cycles we need to generate samples for.
  */
-void SPU_writeByte(SPU *spu, int32_t address, int8_t value)
+void SPU_appendSyncCycles(SPU *spu, int32_t cycles)
+{
+	spu->cpuCycles += cycles;
+}
+
+/*
+ * This function generates as many samples as the CPU cycles appended so far
+ * cover, keeping any left over for next time.
+ */
+void SPU_executeSPUCycles(SPU *spu)
+{
+	while (spu->cpuCycles >= PHILPSX_SPU_CYCLES_PER_SAMPLE) {
+		spu->cpuCycles -= PHILPSX_SPU_CYCLES_PER_SAMPLE;
+		SPU_generateSample(spu);
+	}
+}
+
+/*
+ * This function returns the number of stereo samples dropped so far because
+ * the output buffer was full.
+ */
+int64_t SPU_getDroppedFrameCount(SPU *spu)
 {
-	int64_t tempAddress = 0xFFFFFFFFL & address;
-	tempAddress -= 0x1F801C00L;
+	return spu->droppedFrames;
+}
 
-	// Store byte
-	spu->fakeRegisterSpace[(int32_t)tempAddress] = value;
+/*
+ * This function tells the caller how many CPU cycles are left until the
+ * next batch of samples is due.
+ */
+int32_t SPU_howManyCyclesToNextEvent(SPU *spu)
+{
+	int32_t cyclesLeft = PHILPSX_SPU_CYCLES_PER_SAMPLE *
+			PHILPSX_SPU_SAMPLES_PER_EVENT - spu->cpuCycles;
+	return (cyclesLeft < 1) ? 1 : cyclesLeft;
 }
 
 /*
- * This function reads a byte from the fake store.
+ * This function copies the specified number of words from sound RAM at the
+ * transfer address to data, for DMA.
+ */
+void SPU_readBlock(SPU *spu, int8_t *data, int32_t wordCount)
+{
+	// Bring playback up to date first, so it sees sound RAM as it was
+	SPU_executeSPUCycles(spu);
+
+	int32_t bytesLeft = wordCount * 4;
+	while (bytesLeft > 0) {
+		int32_t length = min_value(bytesLeft,
+				PHILPSX_SPU_RAM_SIZE - spu->transferAddress);
+		memcpy(data, &spu->soundRam[spu->transferAddress], length);
+		SPU_checkInterrupt(spu, spu->transferAddress, length);
+		spu->transferAddress =
+				(spu->transferAddress + length) & (PHILPSX_SPU_RAM_SIZE - 1);
+		data += length;
+		bytesLeft -= length;
+	}
+}
+
+/*
+ * This function reads the SPU's state back from a save state, in the order
+ * SPU_saveState wrote it. Samples already generated for the host are kept,
+ * as they belong to the host rather than the console.
+ */
+void SPU_loadState(SPU *spu, SaveState *state)
+{
+	// Sound RAM and registers, along with the voices
+	SaveState_read(state, spu->soundRam, PHILPSX_SPU_RAM_SIZE);
+	SaveState_read(state, spu->registerSpace, sizeof(spu->registerSpace));
+	SaveState_read(state, spu->voices, sizeof(spu->voices));
+	SaveState_read(state, spu->voiceSample, sizeof(spu->voiceSample));
+	SaveState_read(state, spu->envelopeLevel, sizeof(spu->envelopeLevel));
+	SaveState_read(state, spu->voiceOutput, sizeof(spu->voiceOutput));
+	SaveState_read(state, spu->currentVolumeLeft,
+			sizeof(spu->currentVolumeLeft));
+	SaveState_read(state, spu->currentVolumeRight,
+			sizeof(spu->currentVolumeRight));
+	SaveState_read(state, spu->reverbMask, sizeof(spu->reverbMask));
+	SaveState_read(state, &spu->pitchModulation, sizeof(int32_t));
+	SaveState_read(state, &spu->noiseMode, sizeof(int32_t));
+	SaveState_read(state, &spu->endx, sizeof(int32_t));
+
+	// Control, transfer and noise state
+	SaveState_read(state, &spu->control, sizeof(int32_t));
+	SaveState_read(state, &spu->interruptFlag, sizeof(bool));
+	SaveState_read(state, &spu->transferAddress, sizeof(int32_t));
+	SaveState_read(state, &spu->interruptAddress, sizeof(int32_t));
+	SaveState_read(state, &spu->captureAddress, sizeof(int32_t));
+	SaveState_read(state, &spu->noiseLevel, sizeof(int32_t));
+	SaveState_read(state, &spu->noiseTimer, sizeof(int32_t));
+	SaveState_read(state, spu->mainVolume, sizeof(spu->mainVolume));
+	SaveState_read(state, spu->mainVolumeCounter,
+			sizeof(spu->mainVolumeCounter));
+
+	// CD audio batch and reverb state
+	SaveState_read(state, spu->cdAudio, sizeof(spu->cdAudio));
+	SaveState_read(state, &spu->cdAudioCount, sizeof(int32_t));
+	SaveState_read(state, &spu->cdAudioIndex, sizeof(int32_t));
+	SaveState_read(state, &spu->reverbBase, sizeof(int32_t));
+	SaveState_read(state, &spu->reverbAddress, sizeof(int32_t));
+	SaveState_read(state, spu->reverbOutput, sizeof(spu->reverbOutput));
+	SaveState_read(state, &spu->reverbStep, sizeof(bool));
+	SaveState_read(state, &spu->cpuCycles, sizeof(int32_t));
+
+	// Check values used to index arrays
+	if (spu->cdAudioCount < 0 ||
+			spu->cdAudioCount > PHILPSX_SPU_SAMPLES_PER_EVENT ||
+			spu->cdAudioIndex < 0 || spu->cdAudioIndex > spu->cdAudioCount) {
+		SaveState_fail(state);
+		spu->cdAudioCount = 0;
+		spu->cdAudioIndex = 0;
+	}
+	spu->transferAddress &= PHILPSX_SPU_RAM_SIZE - 1;
+	spu->interruptAddress &= PHILPSX_SPU_RAM_SIZE - 1;
+	spu->captureAddress &= PHILPSX_SPU_RAM_SIZE - 1;
+	spu->reverbBase &= PHILPSX_SPU_RAM_SIZE - 1;
+	spu->reverbAddress &= PHILPSX_SPU_RAM_SIZE - 1;
+	for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; ++i)
+		spu->voices[i].currentAddress &= PHILPSX_SPU_RAM_SIZE - 1;
+}
+
+/*
+ * This function reads a byte from the SPU registers.
  */
 int8_t SPU_readByte(SPU *spu, int32_t address)
 {
-	int64_t tempAddress = 0xFFFFFFFFL & address;
-	tempAddress -= 0x1F801C00L;
+	SPU_executeSPUCycles(spu);
+	int32_t halfWord = SPU_readRegister(spu, address & 0x3FE);
+	return (int8_t)(halfWord >> ((address & 0x1) * 8));
+}
 
-	// Retrieve byte
-	return spu->fakeRegisterSpace[(int32_t)tempAddress];
+/*
+ * This function moves up to frameCount stereo samples from the output
+ * buffer to samples, oldest first, returning how many were moved.
+ */
+int32_t SPU_readSamples(SPU *spu, int16_t *samples, int32_t frameCount)
+{
+	frameCount = min_value(frameCount, spu->outputCount);
+	for (int32_t i = 0; i < frameCount; ++i) {
+		samples[i * 2] = spu->outputBuffer[spu->outputStart * 2];
+		samples[i * 2 + 1] = spu->outputBuffer[spu->outputStart * 2 + 1];
+		spu->outputStart = (spu->outputStart + 1) % PHILPSX_SPU_BUFFER_FRAMES;
+	}
+	spu->outputCount -= frameCount;
+
+	return frameCount;
+}
+
+/*
+ * This function writes the SPU's state to a save state - sound RAM, the
+ * registers, voices and reverb unit, but not the samples waiting to be
+ * played.
+ */
+void SPU_saveState(SPU *spu, SaveState *state)
+{
+	// Sound RAM and registers, along with the voices
+	SaveState_write(state, spu->soundRam, PHILPSX_SPU_RAM_SIZE);
+	SaveState_write(state, spu->registerSpace, sizeof(spu->registerSpace));
+	SaveState_write(state, spu->voices, sizeof(spu->voices));
+	SaveState_write(state, spu->voiceSample, sizeof(spu->voiceSample));
+	SaveState_write(state, spu->envelopeLevel, sizeof(spu->envelopeLevel));
+	SaveState_write(state, spu->voiceOutput, sizeof(spu->voiceOutput));
+	SaveState_write(state, spu->currentVolumeLeft,
+			sizeof(spu->currentVolumeLeft));
+	SaveState_write(state, spu->currentVolumeRight,
+			sizeof(spu->currentVolumeRight));
+	SaveState_write(state, spu->reverbMask, sizeof(spu->reverbMask));
+	SaveState_write(state, &spu->pitchModulation, sizeof(int32_t));
+	SaveState_write(state, &spu->noiseMode, sizeof(int32_t));
+	SaveState_write(state, &spu->endx, sizeof(int32_t));
+
+	// Control, transfer and noise state
+	SaveState_write(state, &spu->control, sizeof(int32_t));
+	SaveState_write(state, &spu->interruptFlag, sizeof(bool));
+	SaveState_write(state, &spu->transferAddress, sizeof(int32_t));
+	SaveState_write(state, &spu->interruptAddress, sizeof(int32_t));
+	SaveState_write(state, &spu->captureAddress, sizeof(int32_t));
+	SaveState_write(state, &spu->noiseLevel, sizeof(int32_t));
+	SaveState_write(state, &spu->noiseTimer, sizeof(int32_t));
+	SaveState_write(state, spu->mainVolume, sizeof(spu->mainVolume));
+	SaveState_write(state, spu->mainVolumeCounter,
+			sizeof(spu->mainVolumeCounter));
+
+	// CD audio batch and reverb state
+	SaveState_write(state, spu->cdAudio, sizeof(spu->cdAudio));
+	SaveState_write(state, &spu->cdAudioCount, sizeof(int32_t));
+	SaveState_write(state, &spu->cdAudioIndex, sizeof(int32_t));
+	SaveState_write(state, &spu->reverbBase, sizeof(int32_t));
+	SaveState_write(state, &spu->reverbAddress, sizeof(int32_t));
+	SaveState_write(state, spu->reverbOutput, sizeof(spu->reverbOutput));
+	SaveState_write(state, &spu->reverbStep, sizeof(bool));
+	SaveState_write(state, &spu->cpuCycles, sizeof(int32_t));
 }
 
 /*
@@ -98,4 +535,852 @@ int8_t SPU_readByte(SPU *spu, int32_t address)
 void SPU_setMemoryInterface(SPU *spu, SystemInterlink *smi)
 {
 	spu->system = smi;
-}
\ No newline at end of file
+
+	// Install handlers for the SPU register space
+	SystemInterlink_registerIoHandlers(smi, 0x1F801C00, 0x400,
+			PHILPSX_IO_BYTE, spu, SPU_readRegisterByte,
+			SPU_writeRegisterByte);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801C00, 0x400,
+			PHILPSX_IO_HALFWORD, spu, SPU_readRegisterHalfWord,
+			SPU_writeRegisterHalfWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801C00, 0x400,
+			PHILPSX_IO_WORD, spu, SPU_readRegisterWord,
+			SPU_writeRegisterWord);
+}
+
+/*
+ * This function copies the specified number of words from data to sound RAM
+ * at the transfer address, for DMA.
+ */
+void SPU_writeBlock(SPU *spu, const int8_t *data, int32_t wordCount)
+{
+	// Bring playback up to date first, so it doesn't see the new data early
+	SPU_executeSPUCycles(spu);
+
+	int32_t bytesLeft = wordCount * 4;
+	while (bytesLeft > 0) {
+		int32_t length = min_value(bytesLeft,
+				PHILPSX_SPU_RAM_SIZE - spu->transferAddress);
+		memcpy(&spu->soundRam[spu->transferAddress], data, length);
+		SPU_checkInterrupt(spu, spu->transferAddress, length);
+		spu->transferAddress =
+				(spu->transferAddress + length) & (PHILPSX_SPU_RAM_SIZE - 1);
+		data += length;
+		bytesLeft -= length;
+	}
+}
+
+/*
+ * This function writes a byte to the SPU registers, merging it into the
+ * rest of the halfword.
+ */
+void SPU_writeByte(SPU *spu, int32_t address, int8_t value)
+{
+	SPU_executeSPUCycles(spu);
+	int32_t offset = address & 0x3FE;
+	int32_t shift = (address & 0x1) * 8;
+	int32_t halfWord = read_le_halfword(&spu->registerSpace[offset]);
+	halfWord &= ~(0xFF << shift);
+	halfWord |= (value & 0xFF) << shift;
+	SPU_writeRegister(spu, offset, halfWord);
+}
+
+/*
+ * This function raises the SPU interrupt if it is enabled and the interrupt
+ * address lies within the specified range of sound RAM.
+ */
+static void SPU_checkInterrupt(SPU *spu, int32_t address, int32_t length)
+{
+	if ((spu->control & 0x40) == 0 || spu->interruptFlag)
+		return;
+
+	if (spu->interruptAddress >= address &&
+			spu->interruptAddress < address + length) {
+		spu->interruptFlag = true;
+		SystemInterlink_setSPUInterruptDelay(spu->system, 0);
+	}
+}
+
+/*
+ * This function decodes the ADPCM block at the voice's current address,
+ * keeping the last three samples of the previous one for interpolation.
+ */
+static void SPU_decodeBlock(SPU *spu, SPUVoice *voice)
+{
+	const uint8_t *block =
+			(const uint8_t *)&spu->soundRam[voice->currentAddress];
+	SPU_checkInterrupt(spu, voice->currentAddress, 16);
+
+	// Read header - shifts above 12 behave like 9
+	int32_t shift = block[0] & 0xF;
+	if (shift > 12)
+		shift = 9;
+	int32_t filter = min_value((block[0] >> 4) & 0x7, 4);
+	voice->blockFlags = block[1];
+	if (voice->blockFlags & 0x4)
+		voice->repeatAddress = voice->currentAddress;
+
+	// Carry the last three samples over
+	memcpy(voice->samples, &voice->samples[28], 3 * sizeof(int16_t));
+
+	// Expand the nibbles first, as they don't depend on each other
+	int32_t expanded[28];
+	for (int32_t i = 0; i < 28; ++i) {
+		int32_t nibble = (block[2 + i / 2] >> ((i & 0x1) * 4)) & 0xF;
+		expanded[i] = (int16_t)(nibble << 12) >> shift;
+	}
+
+	// Then apply the filter, which depends on the previous two samples
+	int32_t positive = SPU_adpcmPositive[filter];
+	int32_t negative = SPU_adpcmNegative[filter];
+	int32_t old = voice->adpcmOld, older = voice->adpcmOlder;
+	for (int32_t i = 0; i < 28; ++i) {
+		int32_t sample = expanded[i] +
+				((old * positive + older * negative + 32) >> 6);
+		sample = max_value(min_value(sample, 0x7FFF), -0x8000);
+		voice->samples[3 + i] = (int16_t)sample;
+		older = old;
+		old = sample;
+	}
+	voice->adpcmOld = old;
+	voice->adpcmOlder = older;
+}
+
+/*
+ * This function works out the next stereo sample, adding it to the output
+ * buffer.
+ */
+static void SPU_generateSample(SPU *spu)
+{
+	// Work out each voice's sample, then mix them together
+	for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; ++i)
+		SPU_stepVoice(spu, i);
+	int32_t mix[4];
+	SPU_mixVoices(spu, mix);
+	SPU_stepNoise(spu);
+
+	// Add CD audio if it is enabled, sending it to the reverb unit as well
+	// if that is enabled too
+	int32_t cdAudio[2];
+	SPU_getCdAudio(spu, cdAudio);
+	if (spu->control & 0x1) {
+		mix[0] += cdAudio[0];
+		mix[1] += cdAudio[1];
+		if (spu->control & 0x4) {
+			mix[2] += cdAudio[0];
+			mix[3] += cdAudio[1];
+		}
+	}
+
+	// Write CD audio and voices 1 and 3 to their capture buffers
+	write_le_halfword(&spu->soundRam[spu->captureAddress], cdAudio[0]);
+	write_le_halfword(&spu->soundRam[0x400 + spu->captureAddress],
+			cdAudio[1]);
+	write_le_halfword(&spu->soundRam[0x800 + spu->captureAddress],
+			spu->voiceOutput[1]);
+	write_le_halfword(&spu->soundRam[0xC00 + spu->captureAddress],
+			spu->voiceOutput[3]);
+	SPU_checkInterrupt(spu, spu->captureAddress, 2);
+	SPU_checkInterrupt(spu, 0x400 + spu->captureAddress, 2);
+	SPU_checkInterrupt(spu, 0x800 + spu->captureAddress, 2);
+	SPU_checkInterrupt(spu, 0xC00 + spu->captureAddress, 2);
+	spu->captureAddress = (spu->captureAddress + 2) & 0x3FF;
+
+	// Step the reverb unit every other sample
+	if (spu->reverbStep)
+		SPU_processReverb(spu, mix[2], mix[3]);
+	spu->reverbStep = !spu->reverbStep;
+
+	// Add reverb and apply main volume
+	int16_t frame[2] = { 0, 0 };
+	for (int32_t i = 0; i < 2; ++i) {
+		int32_t volume = read_le_halfword(&spu->registerSpace[0x180 + i * 2]);
+		spu->mainVolume[i] = SPU_stepVolume(volume, spu->mainVolume[i],
+				&spu->mainVolumeCounter[i]);
+		int32_t sample = max_value(min_value(mix[i] + spu->reverbOutput[i],
+				0x7FFF), -0x8000);
+		sample = (sample * spu->mainVolume[i]) >> 15;
+
+		// Only output anything if the SPU is enabled and unmuted
+		if ((spu->control & 0xC000) == 0xC000)
+			frame[i] = (int16_t)max_value(min_value(sample, 0x7FFF), -0x8000);
+	}
+
+	// Store in output buffer, unless it is full
+	if (spu->outputCount == PHILPSX_SPU_BUFFER_FRAMES) {
+		++spu->droppedFrames;
+		return;
+	}
+	int32_t position = (spu->outputStart + spu->outputCount) %
+			PHILPSX_SPU_BUFFER_FRAMES;
+	spu->outputBuffer[position * 2] = frame[0];
+	spu->outputBuffer[position * 2 + 1] = frame[1];
+	++spu->outputCount;
+}
+
+/*
+ * This function takes the next stereo frame of CD audio, after the CD
+ * volume has been applied. Frames are taken from the CD-ROM drive a batch at
+ * a time, and silence is used while it has none ready.
+ */
+static void SPU_getCdAudio(SPU *spu, int32_t *cdAudio)
+{
+	if (spu->cdAudioIndex == spu->cdAudioCount) {
+		CDROMDrive *cdrom = SystemInterlink_getCdrom(spu->system);
+		spu->cdAudioCount = cdrom ? CDROMDrive_readAudioFrames(cdrom,
+				spu->cdAudio, PHILPSX_SPU_SAMPLES_PER_EVENT) : 0;
+		spu->cdAudioIndex = 0;
+		if (spu->cdAudioCount == 0) {
+			cdAudio[0] = cdAudio[1] = 0;
+			return;
+		}
+	}
+
+	for (int32_t i = 0; i < 2; ++i) {
+		int32_t volume = (int16_t)read_le_halfword(
+				&spu->registerSpace[0x1B0 + i * 2]);
+		cdAudio[i] = (spu->cdAudio[spu->cdAudioIndex * 2 + i] * volume) >> 15;
+	}
+	++spu->cdAudioIndex;
+}
+
+/*
+ * This function starts the release phase of each of the specified voices.
+ */
+static void SPU_keyOff(SPU *spu, int32_t voices)
+{
+	for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; ++i) {
+		SPUVoice *voice = &spu->voices[i];
+		if ((voices & (1 << i)) &&
+				voice->envelopePhase != PHILPSX_SPU_PHASE_OFF) {
+			voice->envelopePhase = PHILPSX_SPU_PHASE_RELEASE;
+			voice->envelopeCounter = 0;
+		}
+	}
+}
+
+/*
+ * This function starts each of the specified voices playing from its start
+ * address.
+ */
+static void SPU_keyOn(SPU *spu, int32_t voices)
+{
+	for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; ++i) {
+		if (!(voices & (1 << i)))
+			continue;
+
+		SPUVoice *voice = &spu->voices[i];
+		voice->currentAddress = voice->startAddress;
+		voice->pitchCounter = 0;
+		memset(voice->samples, 0, sizeof(voice->samples));
+		voice->adpcmOld = 0;
+		voice->adpcmOlder = 0;
+		SPU_decodeBlock(spu, voice);
+		voice->envelopePhase = PHILPSX_SPU_PHASE_ATTACK;
+		voice->envelopeCounter = 0;
+		spu->envelopeLevel[i] = 0;
+		spu->endx &= ~(1 << i);
+	}
+}
+
+/*
+ * This function applies each voice's envelope and volumes to its sample, and
+ * sums the results into mix as left, right, reverb left and reverb right.
+ * Voices are worked on in parallel lanes where the host allows it.
+ */
+static void SPU_mixVoices(SPU *spu, int32_t *mix)
+{
+#if defined(__AVX2__)
+	__m256i left = _mm256_setzero_si256(), right = left;
+	__m256i reverbLeft = left, reverbRight = left;
+	for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; i += 8) {
+		__m256i output = _mm256_srai_epi32(_mm256_mullo_epi32(
+				_mm256_loadu_si256((const __m256i *)&spu->voiceSample[i]),
+				_mm256_loadu_si256((const __m256i *)&spu->envelopeLevel[i])),
+				15);
+		_mm256_storeu_si256((__m256i *)&spu->voiceOutput[i], output);
+		__m256i outputLeft = _mm256_srai_epi32(_mm256_mullo_epi32(output,
+				_mm256_loadu_si256(
+				(const __m256i *)&spu->currentVolumeLeft[i])), 15);
+		__m256i outputRight = _mm256_srai_epi32(_mm256_mullo_epi32(output,
+				_mm256_loadu_si256(
+				(const __m256i *)&spu->currentVolumeRight[i])), 15);
+		__m256i mask = _mm256_loadu_si256(
+				(const __m256i *)&spu->reverbMask[i]);
+		left = _mm256_add_epi32(left, outputLeft);
+		right = _mm256_add_epi32(right, outputRight);
+		reverbLeft = _mm256_add_epi32(reverbLeft,
+				_mm256_and_si256(outputLeft, mask));
+		reverbRight = _mm256_add_epi32(reverbRight,
+				_mm256_and_si256(outputRight, mask));
+	}
+	__m256i sums = _mm256_hadd_epi32(_mm256_hadd_epi32(left, right),
+			_mm256_hadd_epi32(reverbLeft, reverbRight));
+	_mm_storeu_si128((__m128i *)mix, _mm_add_epi32(
+			_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1)));
+#elif defined(__SSE4_1__)
+	__m128i left = _mm_setzero_si128(), right = left;
+	__m128i reverbLeft = left, reverbRight = left;
+	for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; i += 4) {
+		__m128i output = _mm_srai_epi32(_mm_mullo_epi32(
+				_mm_loadu_si128((const __m128i *)&spu->voiceSample[i]),
+				_mm_loadu_si128((const __m128i *)&spu->envelopeLevel[i])), 15);
+		_mm_storeu_si128((__m128i *)&spu->voiceOutput[i], output);
+		__m128i outputLeft = _mm_srai_epi32(_mm_mullo_epi32(output,
+				_mm_loadu_si128(
+				(const __m128i *)&spu->currentVolumeLeft[i])), 15);
+		__m128i outputRight = _mm_srai_epi32(_mm_mullo_epi32(output,
+				_mm_loadu_si128(
+				(const __m128i *)&spu->currentVolumeRight[i])), 15);
+		__m128i mask = _mm_loadu_si128((const __m128i *)&spu->reverbMask[i]);
+		left = _mm_add_epi32(left, outputLeft);
+		right = _mm_add_epi32(right, outputRight);
+		reverbLeft = _mm_add_epi32(reverbLeft, _mm_and_si128(outputLeft, mask));
+		reverbRight = _mm_add_epi32(reverbRight,
+				_mm_and_si128(outputRight, mask));
+	}
+	_mm_storeu_si128((__m128i *)mix, _mm_hadd_epi32(
+			_mm_hadd_epi32(left, right),
+			_mm_hadd_epi32(reverbLeft, reverbRight)));
+#elif defined(__ARM_NEON)
+	int32x4_t left = vdupq_n_s32(0), right = left;
+	int32x4_t reverbLeft = left, reverbRight = left;
+	for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; i += 4) {
+		int32x4_t output = vshrq_n_s32(vmulq_s32(
+				vld1q_s32(&spu->voiceSample[i]),
+				vld1q_s32(&spu->envelopeLevel[i])), 15);
+		vst1q_s32(&spu->voiceOutput[i], output);
+		int32x4_t outputLeft = vshrq_n_s32(vmulq_s32(output,
+				vld1q_s32(&spu->currentVolumeLeft[i])), 15);
+		int32x4_t outputRight = vshrq_n_s32(vmulq_s32(output,
+				vld1q_s32(&spu->currentVolumeRight[i])), 15);
+		int32x4_t mask = vld1q_s32(&spu->reverbMask[i]);
+		left = vaddq_s32(left, outputLeft);
+		right = vaddq_s32(right, outputRight);
+		reverbLeft = vaddq_s32(reverbLeft, vandq_s32(outputLeft, mask));
+		reverbRight = vaddq_s32(reverbRight, vandq_s32(outputRight, mask));
+	}
+	int32_t lanes[4][4];
+	vst1q_s32(lanes[0], left);
+	vst1q_s32(lanes[1], right);
+	vst1q_s32(lanes[2], reverbLeft);
+	vst1q_s32(lanes[3], reverbRight);
+	for (int32_t i = 0; i < 4; ++i)
+		mix[i] = lanes[i][0] + lanes[i][1] + lanes[i][2] + lanes[i][3];
+#else
+	mix[0] = mix[1] = mix[2] = mix[3] = 0;
+	for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; ++i) {
+		int32_t output = (spu->voiceSample[i] * spu->envelopeLevel[i]) >> 15;
+		spu->voiceOutput[i] = output;
+		int32_t outputLeft = (output * spu->currentVolumeLeft[i]) >> 15;
+		int32_t outputRight = (output * spu->currentVolumeRight[i]) >> 15;
+		mix[0] += outputLeft;
+		mix[1] += outputRight;
+		mix[2] += outputLeft & spu->reverbMask[i];
+		mix[3] += outputRight & spu->reverbMask[i];
+	}
+#endif
+}
+
+/*
+ * This function steps the reverb unit, taking the voices sent to it as input
+ * and storing what it outputs for the next two samples. The work area is
+ * only written to if reverb is enabled in the control register.
+ */
+static void SPU_processReverb(SPU *spu, int32_t inputLeft,
+		int32_t inputRight)
+{
+	int32_t input[2] = {
+		(max_value(min_value(inputLeft, 0x7FFF), -0x8000) *
+				(int16_t)SPU_readReverbRegister(spu,
+				PHILPSX_SPU_REVERB_VLIN)) >> 15,
+		(max_value(min_value(inputRight, 0x7FFF), -0x8000) *
+				(int16_t)SPU_readReverbRegister(spu,
+				PHILPSX_SPU_REVERB_VLIN + 1)) >> 15
+	};
+	int32_t iir = (int16_t)SPU_readReverbRegister(spu,
+			PHILPSX_SPU_REVERB_VIIR);
+	int32_t wall = (int16_t)SPU_readReverbRegister(spu,
+			PHILPSX_SPU_REVERB_VWALL);
+
+	for (int32_t side = 0; side < 2; ++side) {
+		int32_t other = side ^ 0x1;
+
+		// Same side and cross side reflections
+		int32_t same = SPU_readReverbRegister(spu,
+				PHILPSX_SPU_REVERB_MLSAME + side) * 8;
+		int32_t sameDelay = SPU_readReverbRegister(spu,
+				PHILPSX_SPU_REVERB_DLSAME + side) * 8;
+		int32_t previous = SPU_readReverb(spu, same - 2);
+		int32_t value = max_value(min_value(input[side] +
+				((SPU_readReverb(spu, sameDelay) * wall) >> 15) - previous,
+				0x7FFF), -0x8000);
+		SPU_writeReverb(spu, same, ((value * iir) >> 15) + previous);
+
+		int32_t diff = SPU_readReverbRegister(spu,
+				PHILPSX_SPU_REVERB_MLDIFF + side) * 8;
+		int32_t diffDelay = SPU_readReverbRegister(spu,
+				PHILPSX_SPU_REVERB_DLDIFF + other) * 8;
+		previous = SPU_readReverb(spu, diff - 2);
+		value = max_value(min_value(input[side] +
+				((SPU_readReverb(spu, diffDelay) * wall) >> 15) - previous,
+				0x7FFF), -0x8000);
+		SPU_writeReverb(spu, diff, ((value * iir) >> 15) + previous);
+	}
+
+	for (int32_t side = 0; side < 2; ++side) {
+		// Early echo from the four comb filters
+		static const int32_t combs[4] = {
+			PHILPSX_SPU_REVERB_MLCOMB1, PHILPSX_SPU_REVERB_MLCOMB2,
+			PHILPSX_SPU_REVERB_MLCOMB3, PHILPSX_SPU_REVERB_MLCOMB4
+		};
+		int32_t output = 0;
+		for (int32_t i = 0; i < 4; ++i) {
+			int32_t comb = SPU_readReverbRegister(spu, combs[i] + side) * 8;
+			output += (SPU_readReverb(spu, comb) *
+					(int16_t)SPU_readReverbRegister(spu,
+					PHILPSX_SPU_REVERB_VCOMB1 + i)) >> 15;
+		}
+		output = max_value(min_value(output, 0x7FFF), -0x8000);
+
+		// Late reverb from the two all-pass filters
+		for (int32_t i = 0; i < 2; ++i) {
+			int32_t allPass = SPU_readReverbRegister(spu,
+					PHILPSX_SPU_REVERB_MLAPF1 + i * 2 + side) * 8;
+			int32_t delay = SPU_readReverbRegister(spu,
+					PHILPSX_SPU_REVERB_DAPF1 + i) * 8;
+			int32_t volume = (int16_t)SPU_readReverbRegister(spu,
+					PHILPSX_SPU_REVERB_VAPF1 + i);
+			int32_t delayed = SPU_readReverb(spu, allPass - delay);
+			output = max_value(min_value(output - ((volume * delayed) >> 15),
+					0x7FFF), -0x8000);
+			SPU_writeReverb(spu, allPass, output);
+			output = max_value(min_value(((output * volume) >> 15) + delayed,
+					0x7FFF), -0x8000);
+		}
+
+		// Apply reverb output volume
+		spu->reverbOutput[side] = (output * (int16_t)read_le_halfword(
+				&spu->registerSpace[0x184 + side * 2])) >> 15;
+	}
+
+	// Move on through the work area
+	spu->reverbAddress = SPU_reverbAddress(spu, 2);
+}
+
+/*
+ * This function reads an SPU register, given its offset from 0x1F801C00.
+ */
+static int32_t SPU_readRegister(SPU *spu, int32_t offset)
+{
+	// Voice registers
+	if (offset < 0x180) {
+		int32_t voiceNumber = offset >> 4;
+		if ((offset & 0xE) == 0xC)
+			return spu->envelopeLevel[voiceNumber];
+		return read_le_halfword(&spu->registerSpace[offset]);
+	}
+
+	// Current voice volumes
+	if (offset >= 0x200 && offset < 0x260) {
+		int32_t voiceNumber = (offset - 0x200) >> 2;
+		return ((offset & 0x2) ? spu->currentVolumeRight[voiceNumber] :
+				spu->currentVolumeLeft[voiceNumber]) & 0xFFFF;
+	}
+
+	switch (offset) {
+		case 0x19C: // ENDX
+			return spu->endx & 0xFFFF;
+		case 0x19E:
+			return logical_rshift(spu->endx, 16);
+		case 0x1AE: // SPUSTAT
+		{
+			int32_t status = spu->control & 0x3F;
+			if (spu->interruptFlag)
+				status |= 0x40;
+			if (spu->control & 0x20)
+				status |= 0x80;
+			switch (spu->control & 0x30) {
+				case 0x20: // DMA write
+					status |= 0x100;
+					break;
+				case 0x30: // DMA read
+					status |= 0x200;
+					break;
+			}
+			if (spu->captureAddress >= 0x200)
+				status |= 0x800;
+			return status;
+		}
+		case 0x1B8: // Current main volume
+			return spu->mainVolume[0] & 0xFFFF;
+		case 0x1BA:
+			return spu->mainVolume[1] & 0xFFFF;
+		default:
+			return read_le_halfword(&spu->registerSpace[offset]);
+	}
+}
+
+/*
+ * This function handles byte reads from the SPU registers.
+ */
+static int32_t SPU_readRegisterByte(void *component, int32_t address)
+{
+	return SPU_readByte(component, address);
+}
+
+/*
+ * This function handles halfword reads from the SPU registers.
+ */
+static int32_t SPU_readRegisterHalfWord(void *component, int32_t address)
+{
+	SPU *spu = component;
+	SPU_executeSPUCycles(spu);
+	return SPU_readRegister(spu, address & 0x3FE);
+}
+
+/*
+ * This function handles word reads from the SPU registers.
+ */
+static int32_t SPU_readRegisterWord(void *component, int32_t address)
+{
+	SPU *spu = component;
+	SPU_executeSPUCycles(spu);
+	return SPU_readRegister(spu, address & 0x3FC) |
+			(SPU_readRegister(spu, (address & 0x3FC) + 2) << 16);
+}
+
+/*
+ * This function reads a sample from the reverb work area, at the specified
+ * offset in bytes from the current position.
+ */
+static int32_t SPU_readReverb(SPU *spu, int32_t offset)
+{
+	return (int16_t)read_le_halfword(
+			&spu->soundRam[SPU_reverbAddress(spu, offset)]);
+}
+
+/*
+ * This function reads one of the reverb registers at 0x1F801DC0, given its
+ * index in halfwords.
+ */
+static int32_t SPU_readReverbRegister(SPU *spu, int32_t index)
+{
+	return read_le_halfword(&spu->registerSpace[0x1C0 + index * 2]);
+}
+
+/*
+ * This function works out the sound RAM address at the specified offset in
+ * bytes from the current reverb position, wrapping around within the work
+ * area.
+ */
+static int32_t SPU_reverbAddress(SPU *spu, int32_t offset)
+{
+	int32_t size = PHILPSX_SPU_RAM_SIZE - spu->reverbBase;
+	int32_t position = (spu->reverbAddress - spu->reverbBase + offset) % size;
+	if (position < 0)
+		position += size;
+	return (spu->reverbBase + position) & 0x7FFFE;
+}
+
+/*
+ * This function steps an envelope level (an ADSR phase or volume sweep) on
+ * by one sample. The level changes by step, scaled by shift, once every
+ * so many samples as counted by counter. Exponential increases slow down
+ * towards the top, and exponential decreases are proportional to the level.
+ */
+static int32_t SPU_stepEnvelope(int32_t level, int32_t *counter,
+		bool exponential, bool decrease, int32_t shift, int32_t step)
+{
+	if (--*counter > 0)
+		return level;
+
+	int32_t cycles = 1 << max_value(0, shift - 11);
+	step *= 1 << max_value(0, 11 - shift);
+	if (exponential && !decrease && level > 0x6000)
+		cycles *= 4;
+	if (exponential && decrease)
+		step = (step * level) >> 15;
+	*counter = cycles;
+
+	return max_value(min_value(level + step, 0x7FFF), 0);
+}
+
+/*
+ * This function steps the noise generator on by one sample.
+ */
+static void SPU_stepNoise(SPU *spu)
+{
+	int32_t step = ((spu->control >> 8) & 0x3) + 4;
+	int32_t shift = (spu->control >> 10) & 0xF;
+	int32_t level = spu->noiseLevel;
+	int32_t parity = ((level >> 15) ^ (level >> 12) ^ (level >> 11) ^
+			(level >> 10) ^ 1) & 0x1;
+
+	spu->noiseTimer -= step;
+	if (spu->noiseTimer < 0) {
+		spu->noiseLevel = (int16_t)(level * 2 + parity);
+		spu->noiseTimer += 0x20000 >> shift;
+		if (spu->noiseTimer < 0)
+			spu->noiseTimer += 0x20000 >> shift;
+	}
+}
+
+/*
+ * This function works out the next sample of the specified voice before its
+ * envelope is applied, along with its current volumes, and steps its
+ * envelope and position on.
+ */
+static void SPU_stepVoice(SPU *spu, int32_t voiceNumber)
+{
+	SPUVoice *voice = &spu->voices[voiceNumber];
+	if (voice->envelopePhase == PHILPSX_SPU_PHASE_OFF) {
+		spu->voiceSample[voiceNumber] = 0;
+		return;
+	}
+
+	// Take sample from noise generator, or interpolate between the four
+	// ADPCM samples around our position
+	if (spu->noiseMode & (1 << voiceNumber)) {
+		spu->voiceSample[voiceNumber] = spu->noiseLevel;
+	} else {
+		const int16_t *samples = &voice->samples[voice->pitchCounter >> 12];
+		int32_t fraction = (voice->pitchCounter >> 4) & 0xFF;
+		spu->voiceSample[voiceNumber] =
+				(SPU_gaussTable[0xFF - fraction] * samples[0] +
+				SPU_gaussTable[0x1FF - fraction] * samples[1] +
+				SPU_gaussTable[0x100 + fraction] * samples[2] +
+				SPU_gaussTable[fraction] * samples[3]) >> 15;
+	}
+
+	// Update volumes
+	spu->currentVolumeLeft[voiceNumber] = SPU_stepVolume(voice->volumeLeft,
+			spu->currentVolumeLeft[voiceNumber], &voice->volumeCounter[0]);
+	spu->currentVolumeRight[voiceNumber] = SPU_stepVolume(voice->volumeRight,
+			spu->currentVolumeRight[voiceNumber], &voice->volumeCounter[1]);
+
+	// Step envelope
+	int32_t level = spu->envelopeLevel[voiceNumber];
+	int32_t low = voice->adsrLow, high = voice->adsrHigh;
+	switch (voice->envelopePhase) {
+		case PHILPSX_SPU_PHASE_ATTACK:
+			level = SPU_stepEnvelope(level, &voice->envelopeCounter,
+					low & 0x8000, false, (low >> 10) & 0x1F,
+					7 - ((low >> 8) & 0x3));
+			if (level == 0x7FFF) {
+				voice->envelopePhase = PHILPSX_SPU_PHASE_DECAY;
+				voice->envelopeCounter = 0;
+			}
+			break;
+		case PHILPSX_SPU_PHASE_DECAY:
+			level = SPU_stepEnvelope(level, &voice->envelopeCounter,
+					true, true, (low >> 4) & 0xF, -8);
+			if (level <= ((low & 0xF) + 1) * 0x800) {
+				voice->envelopePhase = PHILPSX_SPU_PHASE_SUSTAIN;
+				voice->envelopeCounter = 0;
+			}
+			break;
+		case PHILPSX_SPU_PHASE_SUSTAIN:
+		{
+			bool decrease = (high & 0x4000) != 0;
+			int32_t step = decrease ? -8 + ((high >> 6) & 0x3) :
+					7 - ((high >> 6) & 0x3);
+			level = SPU_stepEnvelope(level, &voice->envelopeCounter,
+					high & 0x8000, decrease, (high >> 8) & 0x1F, step);
+		}
+		break;
+		case PHILPSX_SPU_PHASE_RELEASE:
+			level = SPU_stepEnvelope(level, &voice->envelopeCounter,
+					high & 0x20, true, high & 0x1F, -8);
+			if (level == 0)
+				voice->envelopePhase = PHILPSX_SPU_PHASE_OFF;
+			break;
+	}
+	spu->envelopeLevel[voiceNumber] = level;
+
+	// Step position on, modulated by the previous voice's output if
+	// pitch modulation is on for this voice
+	int32_t step = voice->pitch;
+	if (voiceNumber > 0 && (spu->pitchModulation & (1 << voiceNumber)))
+		step = (int32_t)(((int64_t)step *
+				(spu->voiceOutput[voiceNumber - 1] + 0x8000)) >> 15);
+	voice->pitchCounter += min_value(step, 0x4000);
+
+	// Move on to the next block once this one runs out, jumping to the
+	// repeat address at the end of a loop and releasing straight away if
+	// the loop doesn't repeat
+	if ((voice->pitchCounter >> 12) >= 28) {
+		voice->pitchCounter -= 28 << 12;
+		if (voice->blockFlags & 0x1) {
+			spu->endx |= 1 << voiceNumber;
+			voice->currentAddress = voice->repeatAddress;
+			if (!(voice->blockFlags & 0x2) &&
+					!(spu->noiseMode & (1 << voiceNumber))) {
+				voice->envelopePhase = PHILPSX_SPU_PHASE_RELEASE;
+				spu->envelopeLevel[voiceNumber] = 0;
+			}
+		} else {
+			voice->currentAddress =
+					(voice->currentAddress + 16) & (PHILPSX_SPU_RAM_SIZE - 1);
+		}
+		SPU_decodeBlock(spu, voice);
+	}
+}
+
+/*
+ * This function works out the current value of a volume register for the
+ * next sample. Fixed volumes are stored halved in the register, while sweeps
+ * step the current value on like an envelope.
+ */
+static int32_t SPU_stepVolume(int32_t volume, int32_t current,
+		int32_t *counter)
+{
+	if (!(volume & 0x8000))
+		return (int16_t)(volume << 1);
+
+	bool decrease = (volume & 0x2000) != 0;
+	int32_t step = decrease ? -8 + (volume & 0x3) : 7 - (volume & 0x3);
+	int32_t level = SPU_stepEnvelope(current < 0 ? -current : current,
+			counter, volume & 0x4000, decrease, (volume >> 2) & 0x1F, step);
+
+	return (volume & 0x1000) ? -level : level;
+}
+
+/*
+ * This function writes an SPU register, given its offset from 0x1F801C00.
+ */
+static void SPU_writeRegister(SPU *spu, int32_t offset, int32_t value)
+{
+	value &= 0xFFFF;
+	write_le_halfword(&spu->registerSpace[offset], value);
+
+	// Voice registers
+	if (offset < 0x180) {
+		SPUVoice *voice = &spu->voices[offset >> 4];
+		switch (offset & 0xE) {
+			case 0x0:
+				voice->volumeLeft = value;
+				break;
+			case 0x2:
+				voice->volumeRight = value;
+				break;
+			case 0x4:
+				voice->pitch = value;
+				break;
+			case 0x6:
+				voice->startAddress = value * 8;
+				break;
+			case 0x8:
+				voice->adsrLow = value;
+				break;
+			case 0xA:
+				voice->adsrHigh = value;
+				break;
+			case 0xC:
+				spu->envelopeLevel[offset >> 4] = value & 0x7FFF;
+				break;
+			case 0xE:
+				voice->repeatAddress = value * 8;
+				break;
+		}
+		return;
+	}
+
+	switch (offset) {
+		case 0x188: // KON
+			SPU_keyOn(spu, value);
+			break;
+		case 0x18A:
+			SPU_keyOn(spu, value << 16);
+			break;
+		case 0x18C: // KOFF
+			SPU_keyOff(spu, value);
+			break;
+		case 0x18E:
+			SPU_keyOff(spu, value << 16);
+			break;
+		case 0x190: // PMON
+		case 0x192:
+			spu->pitchModulation =
+					read_le_word(&spu->registerSpace[0x190]) & 0xFFFFFE;
+			break;
+		case 0x194: // NON
+		case 0x196:
+			spu->noiseMode = read_le_word(&spu->registerSpace[0x194]);
+			break;
+		case 0x198: // EON
+		case 0x19A:
+		{
+			int32_t reverbVoices = read_le_word(&spu->registerSpace[0x198]);
+			for (int32_t i = 0; i < PHILPSX_SPU_VOICE_COUNT; ++i)
+				spu->reverbMask[i] = (reverbVoices & (1 << i)) ? -1 : 0;
+		}
+		break;
+		case 0x1A2: // Reverb work area start
+			spu->reverbBase = value * 8;
+			spu->reverbAddress = spu->reverbBase;
+			break;
+		case 0x1A4: // Interrupt address
+			spu->interruptAddress = value * 8;
+			break;
+		case 0x1A6: // Transfer address
+			spu->transferAddress = value * 8;
+			break;
+		case 0x1A8: // Transfer fifo, written straight to sound RAM
+			write_le_halfword(&spu->soundRam[spu->transferAddress], value);
+			SPU_checkInterrupt(spu, spu->transferAddress, 2);
+			spu->transferAddress =
+					(spu->transferAddress + 2) & (PHILPSX_SPU_RAM_SIZE - 1);
+			break;
+		case 0x1AA: // SPUCNT - clearing the interrupt enable acknowledges it
+			spu->control = value;
+			if (!(value & 0x40))
+				spu->interruptFlag = false;
+			break;
+	}
+}
+
+/*
+ * This function handles byte writes to the SPU registers.
+ */
+static void SPU_writeRegisterByte(void *component, int32_t address,
+		int32_t value)
+{
+	SPU_writeByte(component, address, (int8_t)value);
+}
+
+/*
+ * This function handles halfword writes to the SPU registers.
+ */
+static void SPU_writeRegisterHalfWord(void *component, int32_t address,
+		int32_t value)
+{
+	SPU *spu = component;
+	SPU_executeSPUCycles(spu);
+	SPU_writeRegister(spu, address & 0x3FE, value);
+}
+
+/*
+ * This function handles word writes to the SPU registers.
+ */
+static void SPU_writeRegisterWord(void *component, int32_t address,
+		int32_t value)
+{
+	SPU *spu = component;
+	SPU_executeSPUCycles(spu);
+	SPU_writeRegister(spu, address & 0x3FC, value);
+	SPU_writeRegister(spu, (address & 0x3FC) + 2, logical_rshift(value, 16));
+}
+
+/*
+ * This function writes a sample to the reverb work area, at the specified
+ * offset in bytes from the current position, if reverb is enabled.
+ */
+static void SPU_writeReverb(SPU *spu, int32_t offset, int32_t value)
+{
+	if (!(spu->control & 0x80))
+		return;
+
+	value = max_value(min_value(value, 0x7FFF), -0x8000);
+	write_le_halfword(&spu->soundRam[SPU_reverbAddress(spu, offset)], value);
+}
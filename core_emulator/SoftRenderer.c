@@ -0,0 +1,1642 @@
+/*
+ * This C file models the software renderer as a class. It keeps its own copy
+ * of vram as a 1024x512 array of 16-bit pixels in the PlayStation's native
+ * format (top row first), and draws polygons, rectangles and lines into it on
+ * the CPU, following the hardware's rasterisation rules rather than OpenGL's.
+ *
+ * Primitives are decoded on the rendering thread and gathered into a batch.
+ * When the batch is drawn, vram is split into horizontal bands which are
+ * shared out round-robin between a pool of worker threads, with the rendering
+ * thread drawing the first set itself - each thread draws every primitive in
+ * the batch in order, but only the rows within its own bands, so no two
+ * threads ever write the same pixel. A primitive that reads vram drawn by the
+ * batch (or draws over vram the batch reads) causes the batch to be drawn
+ * first, as another thread's band could otherwise be out of date. Operations
+ * that touch vram directly, such as copies and uploads, do the same.
+ *
+ * Flat spans and fills are drawn eight pixels at a time with SSE2 where it is
+ * available.
+ *
+ * It is assumed due to use case that non-init pthread functions will not fail,
+ * and therefore errors are not checked with these function calls, to simplify
+ * the code and make it more readable.
+ *
+ * SoftRenderer.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <SDL2/SDL.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "../headers/SoftRenderer.h"
+#include "../headers/GpuCommand.h"
+#include "../headers/VramDirtyMap.h"
+#include "../headers/endian_utils.h"
+#include "../headers/math_utils.h"
+
+// Limits for the worker pool, band height in rows and batch size in
+// primitives
+#define PHILPSX_SOFTRENDERER_MAX_THREADS 8
+#define PHILPSX_SOFTRENDERER_BAND_HEIGHT 16
+#define PHILPSX_SOFTRENDERER_BATCH_SIZE 1024
+
+// Primitive types
+#define PHILPSX_SOFTRENDERER_TRIANGLE 0
+#define PHILPSX_SOFTRENDERER_RECTANGLE 1
+#define PHILPSX_SOFTRENDERER_LINE 2
+
+// Number of interpolated attributes (red, green, blue, u and v)
+#define PHILPSX_SOFTRENDERER_ATTRIBUTES 5
+
+// Forward declarations for functions and subcomponents private to this class
+// Primitive stuff:
+typedef struct SoftRendererPrimitive SoftRendererPrimitive;
+typedef struct SoftRendererVertex SoftRendererVertex;
+static void SoftRenderer_addLine(SoftRenderer *sr,
+		const SoftRendererPrimitive *settings, int32_t offsetX,
+		int32_t offsetY, int32_t firstColour, int32_t firstVertex,
+		int32_t secondColour, int32_t secondVertex);
+static void SoftRenderer_addPrimitive(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive);
+static int32_t SoftRenderer_addReadArea(int32_t *areas, int32_t count,
+		int32_t x, int32_t y, int32_t width, int32_t height);
+static void SoftRenderer_addTriangle(SoftRenderer *sr,
+		const SoftRendererPrimitive *settings, const SoftRendererVertex *first,
+		const SoftRendererVertex *second, const SoftRendererVertex *third);
+static bool SoftRenderer_areasOverlap(const int32_t *first,
+		const int32_t *second);
+static int32_t SoftRenderer_getReadAreas(const SoftRendererPrimitive *primitive,
+		int32_t *areas);
+static void SoftRenderer_setTexturePage(SoftRendererPrimitive *primitive,
+		int32_t texturePage);
+static void SoftRenderer_setupPrimitive(SoftRendererPrimitive *primitive,
+		GpuCommand *command, int32_t *offsetX, int32_t *offsetY);
+static int32_t SoftRenderer_signExtend(int32_t value);
+
+// Drawing stuff:
+static inline int32_t SoftRenderer_blend(int32_t background,
+		int32_t foreground, int32_t mode);
+#if defined(__SSE2__)
+static inline __m128i SoftRenderer_blend8(__m128i background,
+		__m128i foreground, int32_t mode);
+#endif
+static void SoftRenderer_drawBatch(SoftRenderer *sr, int32_t worker);
+static void SoftRenderer_drawFlatSpan(uint16_t *row, int32_t left,
+		int32_t right, const SoftRendererPrimitive *primitive);
+static void SoftRenderer_drawLineRows(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t firstRow,
+		int32_t lastRow);
+static void SoftRenderer_drawPrimitiveRows(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t firstRow,
+		int32_t lastRow);
+static void SoftRenderer_drawRectangleRows(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t firstRow,
+		int32_t lastRow);
+static void SoftRenderer_drawSpan(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t y, int32_t left,
+		int32_t right);
+static void SoftRenderer_drawTriangleRows(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t firstRow,
+		int32_t lastRow);
+static int64_t SoftRenderer_floorDivide(int64_t numerator,
+		int64_t denominator);
+static inline int32_t SoftRenderer_getTexel(const uint16_t *vram,
+		const SoftRendererPrimitive *primitive, int32_t u, int32_t v);
+static inline void SoftRenderer_shadePixel(const uint16_t *vram,
+		const SoftRendererPrimitive *primitive, uint16_t *pixel, int32_t x,
+		int32_t y, int32_t red, int32_t green, int32_t blue, int32_t u,
+		int32_t v);
+
+// Batch and worker stuff:
+typedef struct SoftRendererWorker SoftRendererWorker;
+static void SoftRenderer_flush(SoftRenderer *sr);
+static uint64_t SoftRenderer_getTileMask(const int32_t *area);
+static void SoftRenderer_markTiles(uint64_t *tiles, const int32_t *area);
+static void SoftRenderer_stopWorkers(SoftRenderer *sr, int32_t threadCount);
+static bool SoftRenderer_testTiles(const uint64_t *tiles, const int32_t *area);
+static void *SoftRenderer_workerFunction(void *arg);
+
+/*
+ * This struct holds a decoded primitive, ready for drawing by any thread.
+ */
+struct SoftRendererPrimitive {
+
+	// Type of primitive, and the area of vram it can draw to as left, top,
+	// right and bottom (inclusive) - this starts out as the drawing area, and
+	// is then clipped to the primitive's bounds
+	int32_t type;
+	int32_t area[4];
+
+	// Drawing options, including the 15-bit colour of flat primitives
+	bool shaded;
+	bool textured;
+	bool rawTexture;
+	bool semiTransparent;
+	bool dither;
+	bool checkMask;
+	int32_t maskBit;
+	int32_t semiTransparencyMode;
+	int32_t flatColour;
+
+	// Texture page, colour mode and CLUT position, along with the texture
+	// window as a mask and offset for each coordinate
+	int32_t texBaseX;
+	int32_t texBaseY;
+	int32_t texColourMode;
+	int32_t clutX;
+	int32_t clutY;
+	int32_t texWindowMaskX;
+	int32_t texWindowOffsetX;
+	int32_t texWindowMaskY;
+	int32_t texWindowOffsetY;
+
+	// Attributes (red, green, blue, u and v) in 16.16 fixed point at the
+	// origin, and how they change per pixel across and down - lines use the
+	// per pixel change as the change per step instead
+	int32_t originX;
+	int32_t originY;
+	int64_t attributes[PHILPSX_SOFTRENDERER_ATTRIBUTES];
+	int64_t gradientX[PHILPSX_SOFTRENDERER_ATTRIBUTES];
+	int64_t gradientY[PHILPSX_SOFTRENDERER_ATTRIBUTES];
+
+	// Triangle edges, each as a*x + b*y + c which is never negative for
+	// pixels inside the triangle
+	int64_t edgeA[3];
+	int64_t edgeB[3];
+	int64_t edgeC[3];
+
+	// Line length in steps, and how the position changes per step in 16.16
+	// fixed point
+	int32_t lineSteps;
+	int64_t lineStepX;
+	int64_t lineStepY;
+};
+
+/*
+ * This struct holds a polygon vertex while it is being decoded.
+ */
+struct SoftRendererVertex {
+	int32_t x;
+	int32_t y;
+	int32_t attributes[PHILPSX_SOFTRENDERER_ATTRIBUTES];
+};
+
+/*
+ * This struct holds the state of a worker thread.
+ */
+struct SoftRendererWorker {
+	SoftRenderer *sr;
+	pthread_t thread;
+	int32_t index;
+};
+
+/*
+ * This struct holds the renderer's vram, the current batch and the worker
+ * pool.
+ */
+struct SoftRenderer {
+
+	// Vram, and a buffer for copying within it
+	uint16_t *vram;
+	uint16_t *copyBuffer;
+
+	// Map to mark each write to vram in, owned by the GPU
+	VramDirtyMap *dirtyMap;
+
+	// Current batch, with the 16x16 tiles of vram it draws to and reads from
+	// (one bit per tile column, one word per tile row)
+	SoftRendererPrimitive *primitives;
+	int32_t primitiveCount;
+	uint64_t batchDrawnTiles[32];
+	uint64_t batchReadTiles[32];
+
+	// Worker pool - the rendering thread counts as the first thread, so
+	// threadCount is one more than the number of workers
+	SoftRendererWorker *workers;
+	int32_t threadCount;
+	pthread_mutex_t workMutex;
+	pthread_cond_t workCondition;
+	pthread_cond_t doneCondition;
+	int64_t batchNumber;
+	int32_t workersRunning;
+	bool quit;
+
+	// Display surface, and the brightness of each 5-bit colour level
+	SDL_Surface *displaySurface;
+	uint8_t displayLevels[32];
+};
+
+// Dither offsets, indexed by y and then x (in the bottom two bits of each)
+static const int32_t SoftRenderer_ditherTable[4][4] = {
+	{-4, 0, -3, 1},
+	{2, -2, 3, -1},
+	{-3, 1, -4, 0},
+	{3, -1, 2, -2}
+};
+
+/*
+ * This constructs a SoftRenderer object, with blank vram, and starts its
+ * worker threads. Writes to vram are marked in the dirty map given.
+ */
+SoftRenderer *construct_SoftRenderer(VramDirtyMap *dirtyMap)
+{
+	// Allocate memory for struct
+	SoftRenderer *sr = calloc(1, sizeof(SoftRenderer));
+	if (!sr) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't allocate memory for "
+				"SoftRenderer struct\n");
+		goto end;
+	}
+
+	// Store dirty map reference
+	sr->dirtyMap = dirtyMap;
+
+	// Allocate vram, the copy buffer and the batch
+	sr->vram = calloc(1024 * 512, sizeof(uint16_t));
+	if (!sr->vram) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't allocate memory for "
+				"vram\n");
+		goto cleanup_softrenderer;
+	}
+	sr->copyBuffer = malloc(1024 * 512 * sizeof(uint16_t));
+	if (!sr->copyBuffer) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't allocate memory for "
+				"copy buffer\n");
+		goto cleanup_vram;
+	}
+	sr->primitives = malloc(PHILPSX_SOFTRENDERER_BATCH_SIZE *
+			sizeof(SoftRendererPrimitive));
+	if (!sr->primitives) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't allocate memory for "
+				"primitive batch\n");
+		goto cleanup_copybuffer;
+	}
+
+	// Setup worker synchronisation
+	if (pthread_mutex_init(&sr->workMutex, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't create work "
+				"mutex\n");
+		goto cleanup_primitives;
+	}
+	if (pthread_cond_init(&sr->workCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't create work "
+				"condition variable\n");
+		goto cleanup_workmutex;
+	}
+	if (pthread_cond_init(&sr->doneCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't create done "
+				"condition variable\n");
+		goto cleanup_workcondition;
+	}
+
+	// Use a thread per processor, leaving one for the emulator thread
+	int32_t threadCount = (int32_t)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	threadCount = max_value(threadCount, 1);
+	threadCount = min_value(threadCount, PHILPSX_SOFTRENDERER_MAX_THREADS);
+	sr->threadCount = threadCount;
+
+	// Start workers - the first entry stands for the rendering thread
+	sr->workers = calloc(threadCount, sizeof(SoftRendererWorker));
+	if (!sr->workers) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't allocate memory for "
+				"workers\n");
+		goto cleanup_donecondition;
+	}
+	for (int32_t i = 1; i < threadCount; ++i) {
+		sr->workers[i].sr = sr;
+		sr->workers[i].index = i;
+		if (pthread_create(&sr->workers[i].thread, NULL,
+				&SoftRenderer_workerFunction, &sr->workers[i]) != 0) {
+			fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't start worker "
+					"thread\n");
+			SoftRenderer_stopWorkers(sr, i);
+			goto cleanup_workers;
+		}
+	}
+
+	// Work out the brightness of each colour level, following the response
+	// of a real PlayStation's video output
+	for (int32_t i = 0; i < 32; ++i) {
+		float level = (i <= 8) ? i * 2.0f : 16.0f + (i - 8) * 0.65217f;
+		sr->displayLevels[i] =
+				(uint8_t)min_value((int32_t)(level * 8.225f + 0.5f), 255);
+	}
+
+	// Normal return:
+	return sr;
+
+	// Cleanup path:
+	cleanup_workers:
+	free(sr->workers);
+
+	cleanup_donecondition:
+	pthread_cond_destroy(&sr->doneCondition);
+
+	cleanup_workcondition:
+	pthread_cond_destroy(&sr->workCondition);
+
+	cleanup_workmutex:
+	pthread_mutex_destroy(&sr->workMutex);
+
+	cleanup_primitives:
+	free(sr->primitives);
+
+	cleanup_copybuffer:
+	free(sr->copyBuffer);
+
+	cleanup_vram:
+	free(sr->vram);
+
+	cleanup_softrenderer:
+	free(sr);
+	sr = NULL;
+
+	end:
+	return sr;
+}
+
+/*
+ * This destructs a SoftRenderer object, stopping its worker threads.
+ */
+void destruct_SoftRenderer(SoftRenderer *sr)
+{
+	SoftRenderer_stopWorkers(sr, sr->threadCount);
+	free(sr->workers);
+	pthread_cond_destroy(&sr->doneCondition);
+	pthread_cond_destroy(&sr->workCondition);
+	pthread_mutex_destroy(&sr->workMutex);
+	SDL_FreeSurface(sr->displaySurface);
+	free(sr->primitives);
+	free(sr->copyBuffer);
+	free(sr->vram);
+	free(sr);
+}
+
+/*
+ * This function copies a rectangle of vram to another position (GP0(80)).
+ * The source is copied out first, so overlapping copies read what was there
+ * before the copy began.
+ */
+void SoftRenderer_copyRectangle(SoftRenderer *sr, GpuCommand *command)
+{
+	// Draw any batched primitives, as this touches vram directly
+	SoftRenderer_flush(sr);
+
+	// Determine needed dimensions
+	int32_t width = command->parameter4 & 0xFFFF;
+	width = ((width - 1) & 0x3FF) + 1;
+	int32_t height = logical_rshift(command->parameter4, 16) & 0xFFFF;
+	height = ((height - 1) & 0x1FF) + 1;
+
+	// Determine source and destination positions
+	int32_t sourceX = command->parameter2 & 0x3FF;
+	int32_t sourceY = logical_rshift(command->parameter2, 16) & 0x1FF;
+	int32_t destX = command->parameter3 & 0x3FF;
+	int32_t destY = logical_rshift(command->parameter3, 16) & 0x1FF;
+
+	// Split out masking bits from status register
+	int32_t maskBit = (command->statusRegister & 0x800) ? 0x8000 : 0;
+	bool checkMask = (command->statusRegister & 0x1000) != 0;
+
+	// Copy source out, wrapping at the edges of vram
+	for (int32_t row = 0; row < height; ++row) {
+		const uint16_t *source = sr->vram + ((sourceY + row) & 0x1FF) * 1024;
+		uint16_t *temp = sr->copyBuffer + row * width;
+		for (int32_t column = 0; column < width; ++column)
+			temp[column] = source[(sourceX + column) & 0x3FF];
+	}
+
+	// Write it to the destination
+	VramDirtyMap_markArea(sr->dirtyMap, destX, destY, width, height);
+	for (int32_t row = 0; row < height; ++row) {
+		uint16_t *dest = sr->vram + ((destY + row) & 0x1FF) * 1024;
+		const uint16_t *temp = sr->copyBuffer + row * width;
+		for (int32_t column = 0; column < width; ++column) {
+			uint16_t *pixel = dest + ((destX + column) & 0x3FF);
+			if (checkMask && (*pixel & 0x8000))
+				continue;
+			*pixel = temp[column] | maskBit;
+		}
+	}
+}
+
+/*
+ * This function shows the display area of vram in the window, scaled to the
+ * real resolution. The window is owned by the SDL window surface rather than
+ * an OpenGL context in this mode.
+ */
+void SoftRenderer_displayScreen(SoftRenderer *sr, SDL_Window *window,
+		int32_t topX, int32_t topY, int32_t width, int32_t height,
+		int32_t realHorizontalRes, int32_t realVerticalRes)
+{
+	// Convert the display area, which also completes the frame
+	const uint32_t *pixels = SoftRenderer_readDisplay(sr, topX, topY, width,
+			height);
+
+	// Check we have something to display
+	if (!window || !pixels)
+		return;
+
+	// Scale it into the window
+	SDL_Surface *windowSurface = SDL_GetWindowSurface(window);
+	if (!windowSurface) {
+		fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't get window "
+				"surface\n");
+		return;
+	}
+	SDL_Rect destRect = {0, 0, realHorizontalRes, realVerticalRes};
+	SDL_BlitScaled(sr->displaySurface, NULL, windowSurface, &destRect);
+	SDL_UpdateWindowSurface(window);
+}
+
+/*
+ * This function draws a line (GP0(40) to GP0(5F)), including both end
+ * points. Polylines arrive here a packet of up to five vertices at a time,
+ * with the vertex count in the bottom byte of the command word.
+ */
+void SoftRenderer_drawLine(SoftRenderer *sr, GpuCommand *command)
+{
+	// Setup primitive from GPU state
+	SoftRendererPrimitive primitive;
+	int32_t offsetX, offsetY;
+	SoftRenderer_setupPrimitive(&primitive, command, &offsetX, &offsetY);
+	primitive.type = PHILPSX_SOFTRENDERER_LINE;
+	primitive.shaded = (command->parameter1 & 0x10000000) != 0;
+	primitive.semiTransparent = (command->parameter1 & 0x2000000) != 0;
+	primitive.dither = primitive.dither && primitive.shaded;
+
+	// Add each segment in turn
+	int32_t vertexCount = command->parameter1 & 0xFF;
+	const int32_t lineWords[] = {
+		command->parameter2, command->parameter3, command->parameter4,
+		command->parameter5, command->parameter6, command->parameter7,
+		command->parameter8, command->parameter9, command->parameter10,
+		command->parameter11
+	};
+	for (int32_t i = 0; i < vertexCount - 1; ++i)
+		SoftRenderer_addLine(sr, &primitive, offsetX, offsetY,
+				lineWords[i * 2], lineWords[i * 2 + 1], lineWords[i * 2 + 2],
+				lineWords[i * 2 + 3]);
+}
+
+/*
+ * This function draws a three or four point polygon (GP0(20) to GP0(3F)),
+ * four point polygons being drawn as two triangles.
+ */
+void SoftRenderer_drawPolygon(SoftRenderer *sr, GpuCommand *command)
+{
+	// Setup primitive from GPU state and command byte
+	SoftRendererPrimitive primitive;
+	int32_t offsetX, offsetY;
+	SoftRenderer_setupPrimitive(&primitive, command, &offsetX, &offsetY);
+	primitive.type = PHILPSX_SOFTRENDERER_TRIANGLE;
+	primitive.shaded = (command->parameter1 & 0x10000000) != 0;
+	bool quad = (command->parameter1 & 0x8000000) != 0;
+	primitive.textured = (command->parameter1 & 0x4000000) != 0;
+	primitive.semiTransparent = (command->parameter1 & 0x2000000) != 0;
+	primitive.rawTexture =
+			primitive.textured && (command->parameter1 & 0x1000000) != 0;
+	primitive.dither = primitive.dither &&
+			(primitive.shaded ||
+			(primitive.textured && !primitive.rawTexture));
+
+	// Gather parameters, which are laid out per vertex as an optional colour
+	// (the first colour being in the command word), the vertex itself and an
+	// optional texture coordinate
+	int32_t parameters[] = {
+		command->parameter1, command->parameter2, command->parameter3,
+		command->parameter4, command->parameter5, command->parameter6,
+		command->parameter7, command->parameter8, command->parameter9,
+		command->parameter10, command->parameter11, command->parameter12
+	};
+	int32_t vertexCount = quad ? 4 : 3;
+	SoftRendererVertex vertices[4];
+	int32_t index = 0;
+	for (int32_t i = 0; i < vertexCount; ++i) {
+
+		// Get colour
+		int32_t colour = parameters[0];
+		if (primitive.shaded && i > 0)
+			colour = parameters[index++];
+		else if (i == 0)
+			++index;
+
+		// Get vertex
+		int32_t vertex = parameters[index++];
+		vertices[i].x = SoftRenderer_signExtend(vertex);
+		vertices[i].y = SoftRenderer_signExtend(logical_rshift(vertex, 16));
+
+		// Get texture coordinate, along with the CLUT and texture page
+		int32_t texCoord = 0;
+		if (primitive.textured) {
+			texCoord = parameters[index++];
+			if (i == 0) {
+				primitive.clutX = (logical_rshift(texCoord, 16) & 0x3F) * 16;
+				primitive.clutY = logical_rshift(texCoord, 22) & 0x1FF;
+			} else if (i == 1) {
+				SoftRenderer_setTexturePage(&primitive,
+						logical_rshift(texCoord, 16));
+			}
+		}
+
+		// Store attributes
+		vertices[i].attributes[0] = colour & 0xFF;
+		vertices[i].attributes[1] = logical_rshift(colour, 8) & 0xFF;
+		vertices[i].attributes[2] = logical_rshift(colour, 16) & 0xFF;
+		vertices[i].attributes[3] = texCoord & 0xFF;
+		vertices[i].attributes[4] = logical_rshift(texCoord, 8) & 0xFF;
+	}
+
+	// Store flat colour for untextured, unshaded polygons
+	primitive.flatColour = (vertices[0].attributes[0] >> 3) |
+			(vertices[0].attributes[1] >> 3) << 5 |
+			(vertices[0].attributes[2] >> 3) << 10;
+
+	// Skip polygons with edges too long for the GPU to draw, then apply the
+	// drawing offset
+	for (int32_t i = 1; i < vertexCount; ++i)
+		if (abs(vertices[i].x - vertices[i - 1].x) > 1023 ||
+				abs(vertices[i].y - vertices[i - 1].y) > 511)
+			return;
+	if (quad && (abs(vertices[3].x - vertices[1].x) > 1023 ||
+			abs(vertices[3].y - vertices[1].y) > 511))
+		return;
+	for (int32_t i = 0; i < vertexCount; ++i) {
+		vertices[i].x += offsetX;
+		vertices[i].y += offsetY;
+	}
+
+	// Add triangles
+	SoftRenderer_addTriangle(sr, &primitive, &vertices[0], &vertices[1],
+			&vertices[2]);
+	if (quad)
+		SoftRenderer_addTriangle(sr, &primitive, &vertices[1], &vertices[2],
+				&vertices[3]);
+}
+
+/*
+ * This function draws a rectangle (GP0(60) to GP0(7F)). Rectangles are never
+ * dithered, and take their texture page from the status register.
+ */
+void SoftRenderer_drawRectangle(SoftRenderer *sr, GpuCommand *command)
+{
+	// Setup primitive from GPU state and command byte
+	SoftRendererPrimitive primitive;
+	int32_t offsetX, offsetY;
+	SoftRenderer_setupPrimitive(&primitive, command, &offsetX, &offsetY);
+	primitive.type = PHILPSX_SOFTRENDERER_RECTANGLE;
+	primitive.textured = (command->parameter1 & 0x4000000) != 0;
+	primitive.semiTransparent = (command->parameter1 & 0x2000000) != 0;
+	primitive.rawTexture =
+			primitive.textured && (command->parameter1 & 0x1000000) != 0;
+	primitive.dither = false;
+
+	// Get size, which follows the texture coordinate if there is one
+	int32_t texCoord = primitive.textured ? command->parameter3 : 0;
+	int32_t size =
+			primitive.textured ? command->parameter4 : command->parameter3;
+	int32_t width = size & 0xFFFF;
+	width = ((width - 1) & 0x3FF) + 1;
+	int32_t height = logical_rshift(size, 16) & 0xFFFF;
+	height = ((height - 1) & 0x1FF) + 1;
+
+	// Get position and clip area to it
+	int32_t x = SoftRenderer_signExtend(command->parameter2) + offsetX;
+	int32_t y = SoftRenderer_signExtend(logical_rshift(command->parameter2,
+			16)) + offsetY;
+	primitive.area[0] = max_value(primitive.area[0], x);
+	primitive.area[1] = max_value(primitive.area[1], y);
+	primitive.area[2] = min_value(primitive.area[2], x + width - 1);
+	primitive.area[3] = min_value(primitive.area[3], y + height - 1);
+
+	// Set colour
+	int32_t colour = command->parameter1;
+	primitive.flatColour = ((colour & 0xFF) >> 3) |
+			((logical_rshift(colour, 8) & 0xFF) >> 3) << 5 |
+			((logical_rshift(colour, 16) & 0xFF) >> 3) << 10;
+	primitive.originX = x;
+	primitive.originY = y;
+	for (int32_t i = 0; i < 3; ++i)
+		primitive.attributes[i] =
+				((int64_t)(logical_rshift(colour, i * 8) & 0xFF) << 16) +
+				0x8000;
+
+	// Set texture coordinates, which step one texel per pixel
+	if (primitive.textured) {
+		primitive.clutX = (logical_rshift(texCoord, 16) & 0x3F) * 16;
+		primitive.clutY = logical_rshift(texCoord, 22) & 0x1FF;
+		primitive.attributes[3] = (int64_t)(texCoord & 0xFF) << 16;
+		primitive.attributes[4] =
+				(int64_t)(logical_rshift(texCoord, 8) & 0xFF) << 16;
+		primitive.gradientX[3] = 0x10000;
+		primitive.gradientY[4] = 0x10000;
+	}
+
+	SoftRenderer_addPrimitive(sr, &primitive);
+}
+
+/*
+ * This function fills a rectangle of vram with a colour (GP0(02)), ignoring
+ * the drawing area and mask settings, and wrapping at the edges of vram.
+ */
+void SoftRenderer_fillRectangle(SoftRenderer *sr, GpuCommand *command)
+{
+	// Determine needed dimensions
+	int32_t width = command->parameter3 & 0xFFFF;
+	width = ((width & 0x3FF) + 0xF) & ~(0xF);
+	int32_t height = logical_rshift(command->parameter3, 16) & 0xFFFF;
+	height &= 0x1FF;
+	if (width == 0 || height == 0)
+		return;
+
+	// Determine starting position
+	int32_t x = command->parameter2 & 0x3F0;
+	int32_t y = logical_rshift(command->parameter2, 16) & 0x1FF;
+
+	// Setup a flat rectangle of the right colour
+	SoftRendererPrimitive primitive;
+	memset(&primitive, 0, sizeof(primitive));
+	primitive.type = PHILPSX_SOFTRENDERER_RECTANGLE;
+	primitive.flatColour = ((command->parameter1 & 0xFF) >> 3) |
+			((logical_rshift(command->parameter1, 8) & 0xFF) >> 3) << 5 |
+			((logical_rshift(command->parameter1, 16) & 0xFF) >> 3) << 10;
+
+	// Split it where it wraps, so each piece lies within vram
+	int32_t columns[2][2] = {{x, min_value(x + width, 1024) - 1},
+			{0, x + width - 1025}};
+	int32_t rows[2][2] = {{y, min_value(y + height, 512) - 1},
+			{0, y + height - 513}};
+	for (int32_t row = 0; row < 2; ++row) {
+		for (int32_t column = 0; column < 2; ++column) {
+			primitive.area[0] = columns[column][0];
+			primitive.area[1] = rows[row][0];
+			primitive.area[2] = columns[column][1];
+			primitive.area[3] = rows[row][1];
+			SoftRenderer_addPrimitive(sr, &primitive);
+		}
+	}
+}
+
+/*
+ * This function converts the display area of vram to 32-bit ARGB pixels,
+ * after drawing any batched primitives so that the frame is complete. The
+ * pixels are packed width to a row, and stay valid until the next call -
+ * NULL is returned if there is nothing to convert.
+ */
+const uint32_t *SoftRenderer_readDisplay(SoftRenderer *sr, int32_t topX,
+		int32_t topY, int32_t width, int32_t height)
+{
+	// Draw any batched primitives, so the frame is complete
+	SoftRenderer_flush(sr);
+
+	// Check we have something to convert
+	if (width <= 0 || height <= 0)
+		return NULL;
+
+	// Make sure the display surface matches the display area
+	if (!sr->displaySurface || sr->displaySurface->w != width ||
+			sr->displaySurface->h != height) {
+		SDL_FreeSurface(sr->displaySurface);
+		sr->displaySurface = SDL_CreateRGBSurfaceWithFormat(0, width, height,
+				32, SDL_PIXELFORMAT_ARGB8888);
+		if (!sr->displaySurface) {
+			fprintf(stderr, "PhilPSX: SoftRenderer: Couldn't create display "
+					"surface\n");
+			return NULL;
+		}
+	}
+
+	// Convert the display area to 8 bits per channel
+	for (int32_t row = 0; row < height; ++row) {
+		const uint16_t *source = sr->vram + ((topY + row) & 0x1FF) * 1024;
+		uint32_t *dest = (uint32_t *)((uint8_t *)sr->displaySurface->pixels +
+				row * sr->displaySurface->pitch);
+		for (int32_t column = 0; column < width; ++column) {
+			int32_t pixel = source[(topX + column) & 0x3FF];
+			dest[column] = 0xFF000000 |
+					(uint32_t)sr->displayLevels[pixel & 0x1F] << 16 |
+					(uint32_t)sr->displayLevels[(pixel >> 5) & 0x1F] << 8 |
+					(uint32_t)sr->displayLevels[(pixel >> 10) & 0x1F];
+		}
+	}
+
+	return sr->displaySurface->pixels;
+}
+
+/*
+ * This function reads a rectangle of vram (GP0(C0)) into the buffer, in the
+ * same layout as the OpenGL renderer's readback - four bytes per pixel (red,
+ * green, blue and mask bit), with the bottom row first.
+ */
+void SoftRenderer_readRectangle(SoftRenderer *sr, GpuCommand *command,
+		int8_t *buffer)
+{
+	// Draw any batched primitives, as this touches vram directly
+	SoftRenderer_flush(sr);
+
+	// Determine needed dimensions
+	int32_t width = command->parameter3 & 0xFFFF;
+	width = ((width - 1) & 0x3FF) + 1;
+	int32_t height = logical_rshift(command->parameter3, 16) & 0xFFFF;
+	height = ((height - 1) & 0x1FF) + 1;
+
+	// Determine starting position
+	int32_t x = command->parameter2 & 0x3FF;
+	int32_t y = logical_rshift(command->parameter2, 16) & 0x1FF;
+
+	// Read pixels, wrapping at the edges of vram
+	for (int32_t row = 0; row < height; ++row) {
+		const uint16_t *source = sr->vram + ((y + row) & 0x1FF) * 1024;
+		int8_t *dest = buffer + (height - 1 - row) * width * 4;
+		for (int32_t column = 0; column < width; ++column) {
+			int32_t pixel = source[(x + column) & 0x3FF];
+			dest[column * 4] = (int8_t)(pixel & 0x1F);
+			dest[column * 4 + 1] = (int8_t)((pixel >> 5) & 0x1F);
+			dest[column * 4 + 2] = (int8_t)((pixel >> 10) & 0x1F);
+			dest[column * 4 + 3] = (int8_t)(pixel >> 15);
+		}
+	}
+}
+
+/*
+ * This function copies the whole of vram into the buffer as 1024x512
+ * little-endian halfwords, top row first, for a save state.
+ */
+void SoftRenderer_readVram(SoftRenderer *sr, int8_t *vram)
+{
+	// Draw any batched primitives, as this touches vram directly
+	SoftRenderer_flush(sr);
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(vram, sr->vram, 1024 * 512 * sizeof(uint16_t));
+#else
+	for (int32_t i = 0; i < 1024 * 512; ++i)
+		write_le_halfword(vram + i * 2, sr->vram[i]);
+#endif
+}
+
+/*
+ * This function writes a rectangle of pixels into vram (GP0(A0)). The data
+ * holds the pixels as little-endian halfwords, in order from the top row.
+ */
+void SoftRenderer_writeRectangle(SoftRenderer *sr, GpuCommand *command,
+		const int8_t *data)
+{
+	// Draw any batched primitives, as this touches vram directly
+	SoftRenderer_flush(sr);
+
+	// Determine needed dimensions
+	int32_t width = command->parameter3 & 0xFFFF;
+	width = ((width - 1) & 0x3FF) + 1;
+	int32_t height = logical_rshift(command->parameter3, 16) & 0xFFFF;
+	height = ((height - 1) & 0x1FF) + 1;
+
+	// Determine starting position
+	int32_t x = command->parameter2 & 0x3FF;
+	int32_t y = logical_rshift(command->parameter2, 16) & 0x1FF;
+
+	// Split out masking bits from status register
+	int32_t maskBit = (command->statusRegister & 0x800) ? 0x8000 : 0;
+	bool checkMask = (command->statusRegister & 0x1000) != 0;
+
+	// Write pixels, wrapping at the edges of vram
+	VramDirtyMap_markArea(sr->dirtyMap, x, y, width, height);
+	for (int32_t row = 0; row < height; ++row) {
+		uint16_t *dest = sr->vram + ((y + row) & 0x1FF) * 1024;
+		const int8_t *source = data + row * width * 2;
+		for (int32_t column = 0; column < width; ++column) {
+			uint16_t *pixel = dest + ((x + column) & 0x3FF);
+			if (checkMask && (*pixel & 0x8000))
+				continue;
+			*pixel = (uint16_t)(read_le_halfword(source + column * 2) |
+					maskBit);
+		}
+	}
+}
+
+/*
+ * This function replaces the whole of vram with the contents of the buffer,
+ * held as SoftRenderer_readVram gives them, when loading a save state.
+ */
+void SoftRenderer_writeVram(SoftRenderer *sr, const int8_t *vram)
+{
+	// Draw any batched primitives, as this touches vram directly
+	SoftRenderer_flush(sr);
+
+	VramDirtyMap_markArea(sr->dirtyMap, 0, 0, 1024, 512);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(sr->vram, vram, 1024 * 512 * sizeof(uint16_t));
+#else
+	for (int32_t i = 0; i < 1024 * 512; ++i)
+		sr->vram[i] = (uint16_t)read_le_halfword(vram + i * 2);
+#endif
+}
+
+/*
+ * This function adds one line segment to the batch, using settings as the
+ * template for the primitive.
+ */
+static void SoftRenderer_addLine(SoftRenderer *sr,
+		const SoftRendererPrimitive *settings, int32_t offsetX,
+		int32_t offsetY, int32_t firstColour, int32_t firstVertex,
+		int32_t secondColour, int32_t secondVertex)
+{
+	SoftRendererPrimitive primitive = *settings;
+
+	// Get end points, skipping lines too long for the GPU to draw
+	int32_t firstX = SoftRenderer_signExtend(firstVertex);
+	int32_t firstY =
+			SoftRenderer_signExtend(logical_rshift(firstVertex, 16));
+	int32_t secondX = SoftRenderer_signExtend(secondVertex);
+	int32_t secondY =
+			SoftRenderer_signExtend(logical_rshift(secondVertex, 16));
+	int32_t deltaX = secondX - firstX;
+	int32_t deltaY = secondY - firstY;
+	if (abs(deltaX) > 1023 || abs(deltaY) > 511)
+		return;
+	firstX += offsetX;
+	firstY += offsetY;
+	secondX += offsetX;
+	secondY += offsetY;
+
+	// Clip area to the line's bounds
+	primitive.area[0] = max_value(primitive.area[0], min_value(firstX, secondX));
+	primitive.area[1] = max_value(primitive.area[1], min_value(firstY, secondY));
+	primitive.area[2] = min_value(primitive.area[2], max_value(firstX, secondX));
+	primitive.area[3] = min_value(primitive.area[3], max_value(firstY, secondY));
+
+	// Work out steps along the line, and the colour change per step
+	int32_t steps = max_value(abs(deltaX), abs(deltaY));
+	if (!primitive.shaded)
+		secondColour = firstColour;
+	primitive.originX = firstX;
+	primitive.originY = firstY;
+	primitive.lineSteps = steps;
+	if (steps > 0) {
+		primitive.lineStepX = ((int64_t)deltaX << 16) / steps;
+		primitive.lineStepY = ((int64_t)deltaY << 16) / steps;
+	}
+	for (int32_t i = 0; i < 3; ++i) {
+		int32_t first = logical_rshift(firstColour, i * 8) & 0xFF;
+		int32_t second = logical_rshift(secondColour, i * 8) & 0xFF;
+		primitive.attributes[i] = ((int64_t)first << 16) + 0x8000;
+		if (steps > 0)
+			primitive.gradientX[i] =
+					((int64_t)(second - first) << 16) / steps;
+	}
+
+	SoftRenderer_addPrimitive(sr, &primitive);
+}
+
+
+/*
+ * This function adds a primitive to the current batch, drawing the batch
+ * first if the primitive depends on it or it is full.
+ */
+static void SoftRenderer_addPrimitive(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive)
+{
+	// Nothing to do if the primitive has been clipped away
+	if (primitive->area[0] > primitive->area[2] ||
+			primitive->area[1] > primitive->area[3])
+		return;
+	VramDirtyMap_markArea(sr->dirtyMap, primitive->area[0],
+			primitive->area[1], primitive->area[2] - primitive->area[0] + 1,
+			primitive->area[3] - primitive->area[1] + 1);
+
+	// Check whether the primitive reads vram the batch draws to, or draws
+	// to vram the batch reads - with only one thread, the batch is drawn in
+	// order anyway
+	int32_t readAreas[16];
+	int32_t readAreaCount = SoftRenderer_getReadAreas(primitive, readAreas);
+	bool dependent = false;
+	bool selfDependent = false;
+	if (sr->threadCount > 1) {
+		dependent = SoftRenderer_testTiles(sr->batchReadTiles,
+				primitive->area);
+		for (int32_t i = 0; i < readAreaCount; ++i) {
+			dependent = dependent || SoftRenderer_testTiles(
+					sr->batchDrawnTiles, &readAreas[i * 4]);
+			selfDependent = selfDependent || SoftRenderer_areasOverlap(
+					primitive->area, &readAreas[i * 4]);
+		}
+	}
+	if (dependent || selfDependent ||
+			sr->primitiveCount == PHILPSX_SOFTRENDERER_BATCH_SIZE)
+		SoftRenderer_flush(sr);
+
+	// A primitive reading vram it draws to is drawn by this thread alone,
+	// so it sees its own pixels in the same order as with one thread
+	if (selfDependent) {
+		SoftRenderer_drawPrimitiveRows(sr, primitive, primitive->area[1],
+				primitive->area[3]);
+		return;
+	}
+
+	// Add primitive, recording the tiles it touches
+	sr->primitives[sr->primitiveCount++] = *primitive;
+	SoftRenderer_markTiles(sr->batchDrawnTiles, primitive->area);
+	for (int32_t i = 0; i < readAreaCount; ++i)
+		SoftRenderer_markTiles(sr->batchReadTiles, &readAreas[i * 4]);
+}
+
+/*
+ * This function adds an area of vram to a list of areas, as left, top, right
+ * and bottom (inclusive), splitting it in two if it wraps past the right
+ * edge of vram. It returns the new number of areas.
+ */
+static int32_t SoftRenderer_addReadArea(int32_t *areas, int32_t count,
+		int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	int32_t *area = &areas[count * 4];
+	area[0] = x;
+	area[1] = y;
+	area[2] = min_value(x + width, 1024) - 1;
+	area[3] = y + height - 1;
+	++count;
+
+	if (x + width > 1024) {
+		area = &areas[count * 4];
+		area[0] = 0;
+		area[1] = y;
+		area[2] = x + width - 1025;
+		area[3] = y + height - 1;
+		++count;
+	}
+
+	return count;
+}
+
+/*
+ * This function sets up a triangle from the primitive settings and three
+ * vertices (after the drawing offset is applied), and adds it to the current
+ * batch. Attribute gradients are worked out from the triangle's plane
+ * equations.
+ */
+static void SoftRenderer_addTriangle(SoftRenderer *sr,
+		const SoftRendererPrimitive *settings, const SoftRendererVertex *first,
+		const SoftRendererVertex *second, const SoftRendererVertex *third)
+{
+	// Put vertices in clockwise order (on screen, with y going down),
+	// skipping triangles with no area
+	const SoftRendererVertex *vertices[3] = {first, second, third};
+	int64_t area =
+			(int64_t)(second->x - first->x) * (third->y - first->y) -
+			(int64_t)(third->x - first->x) * (second->y - first->y);
+	if (area == 0)
+		return;
+	if (area < 0) {
+		vertices[1] = third;
+		vertices[2] = second;
+		area = -area;
+	}
+
+	// Clip area to the triangle's bounds
+	SoftRendererPrimitive primitive = *settings;
+	int32_t minX = min_value(min_value(first->x, second->x), third->x);
+	int32_t minY = min_value(min_value(first->y, second->y), third->y);
+	int32_t maxX = max_value(max_value(first->x, second->x), third->x);
+	int32_t maxY = max_value(max_value(first->y, second->y), third->y);
+	primitive.area[0] = max_value(primitive.area[0], minX);
+	primitive.area[1] = max_value(primitive.area[1], minY);
+	primitive.area[2] = min_value(primitive.area[2], maxX);
+	primitive.area[3] = min_value(primitive.area[3], maxY);
+
+	// Setup edges - pixels lying exactly on an edge are only drawn if it is
+	// a top or left edge, so triangles sharing an edge don't overlap
+	for (int32_t i = 0; i < 3; ++i) {
+		const SoftRendererVertex *start = vertices[i];
+		const SoftRendererVertex *end = vertices[(i + 1) % 3];
+		int64_t a = start->y - end->y;
+		int64_t b = end->x - start->x;
+		primitive.edgeA[i] = a;
+		primitive.edgeB[i] = b;
+		primitive.edgeC[i] = -a * start->x - b * start->y;
+		if (!(a > 0 || (a == 0 && b > 0)))
+			primitive.edgeC[i] -= 1;
+	}
+
+	// Setup attribute gradients, with colours rounded to nearest
+	int64_t x1 = vertices[1]->x - vertices[0]->x;
+	int64_t y1 = vertices[1]->y - vertices[0]->y;
+	int64_t x2 = vertices[2]->x - vertices[0]->x;
+	int64_t y2 = vertices[2]->y - vertices[0]->y;
+	primitive.originX = vertices[0]->x;
+	primitive.originY = vertices[0]->y;
+	for (int32_t i = 0; i < PHILPSX_SOFTRENDERER_ATTRIBUTES; ++i) {
+		int64_t delta1 =
+				vertices[1]->attributes[i] - vertices[0]->attributes[i];
+		int64_t delta2 =
+				vertices[2]->attributes[i] - vertices[0]->attributes[i];
+		primitive.attributes[i] =
+				((int64_t)vertices[0]->attributes[i] << 16) +
+				(i < 3 ? 0x8000 : 0);
+		primitive.gradientX[i] = (delta1 * y2 - delta2 * y1) * 65536 / area;
+		primitive.gradientY[i] = (delta2 * x1 - delta1 * x2) * 65536 / area;
+	}
+
+	SoftRenderer_addPrimitive(sr, &primitive);
+}
+
+/*
+ * This function checks whether two areas of vram, each given as left, top,
+ * right and bottom (inclusive), overlap.
+ */
+static bool SoftRenderer_areasOverlap(const int32_t *first,
+		const int32_t *second)
+{
+	return first[0] <= second[2] && second[0] <= first[2] &&
+			first[1] <= second[3] && second[1] <= first[3];
+}
+
+/*
+ * This function blends a foreground colour onto a background colour, both in
+ * 15-bit format, using the given semi-transparency mode.
+ */
+static inline int32_t SoftRenderer_blend(int32_t background,
+		int32_t foreground, int32_t mode)
+{
+	int32_t result = 0;
+	for (int32_t shift = 0; shift < 15; shift += 5) {
+		int32_t back = (background >> shift) & 0x1F;
+		int32_t fore = (foreground >> shift) & 0x1F;
+		int32_t channel;
+		switch (mode) {
+			case 0:
+				channel = (back + fore) >> 1;
+				break;
+			case 1:
+				channel = min_value(back + fore, 31);
+				break;
+			case 2:
+				channel = max_value(back - fore, 0);
+				break;
+			default:
+				channel = min_value(back + (fore >> 2), 31);
+				break;
+		}
+		result |= channel << shift;
+	}
+	return result;
+}
+
+#if defined(__SSE2__)
+/*
+ * This function blends eight foreground colours onto eight background
+ * colours at once, as SoftRenderer_blend does. Mask bits in the result are
+ * clear.
+ */
+static inline __m128i SoftRenderer_blend8(__m128i background,
+		__m128i foreground, int32_t mode)
+{
+	__m128i channelMask = _mm_set1_epi16(0x1F);
+	__m128i maximum = _mm_set1_epi16(31);
+	__m128i result = _mm_setzero_si128();
+	for (int32_t shift = 0; shift < 15; shift += 5) {
+		__m128i back = _mm_and_si128(
+				_mm_srl_epi16(background, _mm_cvtsi32_si128(shift)),
+				channelMask);
+		__m128i fore = _mm_and_si128(
+				_mm_srl_epi16(foreground, _mm_cvtsi32_si128(shift)),
+				channelMask);
+		__m128i channel;
+		switch (mode) {
+			case 0:
+				channel = _mm_srli_epi16(_mm_add_epi16(back, fore), 1);
+				break;
+			case 1:
+				channel = _mm_min_epi16(_mm_add_epi16(back, fore), maximum);
+				break;
+			case 2:
+				channel = _mm_max_epi16(_mm_sub_epi16(back, fore),
+						_mm_setzero_si128());
+				break;
+			default:
+				channel = _mm_min_epi16(
+						_mm_add_epi16(back, _mm_srli_epi16(fore, 2)),
+						maximum);
+				break;
+		}
+		result = _mm_or_si128(result,
+				_mm_sll_epi16(channel, _mm_cvtsi32_si128(shift)));
+	}
+	return result;
+}
+#endif
+
+/*
+ * This function draws this thread's bands of every primitive in the current
+ * batch, in order.
+ */
+static void SoftRenderer_drawBatch(SoftRenderer *sr, int32_t worker)
+{
+	int32_t threadCount = sr->threadCount;
+	for (int32_t i = 0; i < sr->primitiveCount; ++i) {
+		const SoftRendererPrimitive *primitive = &sr->primitives[i];
+
+		// Find the first band of the primitive that belongs to this thread
+		int32_t band = primitive->area[1] / PHILPSX_SOFTRENDERER_BAND_HEIGHT;
+		band += (worker - band % threadCount + threadCount) % threadCount;
+
+		// Draw each of this thread's bands
+		for (; band * PHILPSX_SOFTRENDERER_BAND_HEIGHT <= primitive->area[3];
+				band += threadCount) {
+			int32_t firstRow = max_value(primitive->area[1],
+					band * PHILPSX_SOFTRENDERER_BAND_HEIGHT);
+			int32_t lastRow = min_value(primitive->area[3],
+					band * PHILPSX_SOFTRENDERER_BAND_HEIGHT +
+					PHILPSX_SOFTRENDERER_BAND_HEIGHT - 1);
+			SoftRenderer_drawPrimitiveRows(sr, primitive, firstRow, lastRow);
+		}
+	}
+}
+
+/*
+ * This function draws a span of a flat, untextured primitive, which needs no
+ * interpolation - eight pixels at a time where SSE2 is available.
+ */
+static void SoftRenderer_drawFlatSpan(uint16_t *row, int32_t left,
+		int32_t right, const SoftRendererPrimitive *primitive)
+{
+	int32_t colour = primitive->flatColour;
+	int32_t x = left;
+
+#if defined(__SSE2__)
+	__m128i colours = _mm_set1_epi16((int16_t)colour);
+	__m128i maskBits = _mm_set1_epi16((int16_t)primitive->maskBit);
+	__m128i maskTest = _mm_set1_epi16((int16_t)0x8000);
+	for (; x + 7 <= right; x += 8) {
+		__m128i *pixels = (__m128i *)&row[x];
+
+		// Opaque pixels with no mask check can just be stored
+		if (!primitive->semiTransparent && !primitive->checkMask) {
+			_mm_storeu_si128(pixels, _mm_or_si128(colours, maskBits));
+			continue;
+		}
+
+		// Otherwise blend, and keep any pixels the mask protects
+		__m128i background = _mm_loadu_si128(pixels);
+		__m128i result = colours;
+		if (primitive->semiTransparent)
+			result = SoftRenderer_blend8(background, colours,
+					primitive->semiTransparencyMode);
+		result = _mm_or_si128(result, maskBits);
+		if (primitive->checkMask) {
+			__m128i keep = _mm_cmpeq_epi16(
+					_mm_and_si128(background, maskTest), maskTest);
+			result = _mm_or_si128(_mm_and_si128(keep, background),
+					_mm_andnot_si128(keep, result));
+		}
+		_mm_storeu_si128(pixels, result);
+	}
+#endif
+
+	for (; x <= right; ++x) {
+		if (primitive->checkMask && (row[x] & 0x8000))
+			continue;
+		int32_t result = colour;
+		if (primitive->semiTransparent)
+			result = SoftRenderer_blend(row[x], colour,
+					primitive->semiTransparencyMode);
+		row[x] = (uint16_t)(result | primitive->maskBit);
+	}
+}
+
+/*
+ * This function draws the pixels of a line within the given rows. Each
+ * thread steps along the whole line, but only draws its own rows.
+ */
+static void SoftRenderer_drawLineRows(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t firstRow,
+		int32_t lastRow)
+{
+	int64_t x = ((int64_t)primitive->originX << 16) + 0x8000;
+	int64_t y = ((int64_t)primitive->originY << 16) + 0x8000;
+	int64_t colours[3] = {primitive->attributes[0], primitive->attributes[1],
+			primitive->attributes[2]};
+
+	for (int32_t i = 0; i <= primitive->lineSteps; ++i) {
+		int32_t pixelX = (int32_t)(x >> 16);
+		int32_t pixelY = (int32_t)(y >> 16);
+		if (pixelY >= firstRow && pixelY <= lastRow &&
+				pixelX >= primitive->area[0] && pixelX <= primitive->area[2])
+			SoftRenderer_shadePixel(sr->vram, primitive,
+					&sr->vram[pixelY * 1024 + pixelX], pixelX, pixelY,
+					(int32_t)(colours[0] >> 16), (int32_t)(colours[1] >> 16),
+					(int32_t)(colours[2] >> 16), 0, 0);
+
+		x += primitive->lineStepX;
+		y += primitive->lineStepY;
+		for (int32_t j = 0; j < 3; ++j)
+			colours[j] += primitive->gradientX[j];
+	}
+}
+
+/*
+ * This function draws the given rows of a primitive of any type.
+ */
+static void SoftRenderer_drawPrimitiveRows(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t firstRow,
+		int32_t lastRow)
+{
+	switch (primitive->type) {
+		case PHILPSX_SOFTRENDERER_TRIANGLE:
+			SoftRenderer_drawTriangleRows(sr, primitive, firstRow, lastRow);
+			break;
+		case PHILPSX_SOFTRENDERER_RECTANGLE:
+			SoftRenderer_drawRectangleRows(sr, primitive, firstRow, lastRow);
+			break;
+		case PHILPSX_SOFTRENDERER_LINE:
+			SoftRenderer_drawLineRows(sr, primitive, firstRow, lastRow);
+			break;
+	}
+}
+
+/*
+ * This function draws the given rows of a rectangle, which covers its whole
+ * area.
+ */
+static void SoftRenderer_drawRectangleRows(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t firstRow,
+		int32_t lastRow)
+{
+	for (int32_t y = firstRow; y <= lastRow; ++y)
+		SoftRenderer_drawSpan(sr, primitive, y, primitive->area[0],
+				primitive->area[2]);
+}
+
+/*
+ * This function draws one span of a triangle or rectangle, interpolating its
+ * attributes across the span.
+ */
+static void SoftRenderer_drawSpan(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t y, int32_t left,
+		int32_t right)
+{
+	uint16_t *row = &sr->vram[y * 1024];
+
+	// Flat, untextured spans need no interpolation
+	if (!primitive->shaded && !primitive->textured) {
+		SoftRenderer_drawFlatSpan(row, left, right, primitive);
+		return;
+	}
+
+	// Work out attributes at the start of the span
+	int64_t values[PHILPSX_SOFTRENDERER_ATTRIBUTES];
+	for (int32_t i = 0; i < PHILPSX_SOFTRENDERER_ATTRIBUTES; ++i)
+		values[i] = primitive->attributes[i] +
+				primitive->gradientX[i] * (left - primitive->originX) +
+				primitive->gradientY[i] * (y - primitive->originY);
+
+	for (int32_t x = left; x <= right; ++x) {
+		SoftRenderer_shadePixel(sr->vram, primitive, &row[x], x, y,
+				(int32_t)(values[0] >> 16), (int32_t)(values[1] >> 16),
+				(int32_t)(values[2] >> 16), (int32_t)(values[3] >> 16) & 0xFF,
+				(int32_t)(values[4] >> 16) & 0xFF);
+		for (int32_t i = 0; i < PHILPSX_SOFTRENDERER_ATTRIBUTES; ++i)
+			values[i] += primitive->gradientX[i];
+	}
+}
+
+/*
+ * This function draws the given rows of a triangle, working out the span of
+ * each row from the triangle's edges.
+ */
+static void SoftRenderer_drawTriangleRows(SoftRenderer *sr,
+		const SoftRendererPrimitive *primitive, int32_t firstRow,
+		int32_t lastRow)
+{
+	for (int32_t y = firstRow; y <= lastRow; ++y) {
+
+		// Narrow the span by each edge in turn - for a*x + k >= 0, a
+		// positive a gives a left limit, and a negative one a right limit
+		int64_t left = primitive->area[0];
+		int64_t right = primitive->area[2];
+		for (int32_t i = 0; i < 3; ++i) {
+			int64_t a = primitive->edgeA[i];
+			int64_t k = primitive->edgeB[i] * y + primitive->edgeC[i];
+			if (a > 0)
+				left = max_value(left, -SoftRenderer_floorDivide(k, a));
+			else if (a < 0)
+				right = min_value(right, SoftRenderer_floorDivide(k, -a));
+			else if (k < 0)
+				right = left - 1;
+		}
+
+		if (left <= right)
+			SoftRenderer_drawSpan(sr, primitive, y, (int32_t)left,
+					(int32_t)right);
+	}
+}
+
+/*
+ * This function divides one number by another (which must be positive),
+ * rounding down rather than towards zero.
+ */
+static int64_t SoftRenderer_floorDivide(int64_t numerator,
+		int64_t denominator)
+{
+	int64_t quotient = numerator / denominator;
+	if (numerator % denominator < 0)
+		--quotient;
+	return quotient;
+}
+
+/*
+ * This function draws the current batch across all threads, then empties
+ * it.
+ */
+static void SoftRenderer_flush(SoftRenderer *sr)
+{
+	if (sr->primitiveCount == 0)
+		return;
+
+	// Wake workers, then draw the first set of bands ourselves
+	if (sr->threadCount > 1) {
+		pthread_mutex_lock(&sr->workMutex);
+		++sr->batchNumber;
+		sr->workersRunning = sr->threadCount - 1;
+		pthread_cond_broadcast(&sr->workCondition);
+		pthread_mutex_unlock(&sr->workMutex);
+	}
+	SoftRenderer_drawBatch(sr, 0);
+
+	// Wait for workers to finish
+	if (sr->threadCount > 1) {
+		pthread_mutex_lock(&sr->workMutex);
+		while (sr->workersRunning > 0)
+			pthread_cond_wait(&sr->doneCondition, &sr->workMutex);
+		pthread_mutex_unlock(&sr->workMutex);
+	}
+
+	// Empty batch
+	sr->primitiveCount = 0;
+	memset(sr->batchDrawnTiles, 0, sizeof(sr->batchDrawnTiles));
+	memset(sr->batchReadTiles, 0, sizeof(sr->batchReadTiles));
+}
+
+/*
+ * This function reads the areas of vram a primitive takes texels from -
+ * the texture page, and the CLUT if it uses one. It returns the number of
+ * areas.
+ */
+static int32_t SoftRenderer_getReadAreas(const SoftRendererPrimitive *primitive,
+		int32_t *areas)
+{
+	if (!primitive->textured)
+		return 0;
+
+	// Work out width of the texture page and CLUT in vram pixels
+	int32_t pageWidth = 256;
+	int32_t clutWidth = 0;
+	switch (primitive->texColourMode) {
+		case 0:
+			pageWidth = 64;
+			clutWidth = 16;
+			break;
+		case 1:
+			pageWidth = 128;
+			clutWidth = 256;
+			break;
+	}
+
+	int32_t count = SoftRenderer_addReadArea(areas, 0, primitive->texBaseX,
+			primitive->texBaseY, pageWidth, 256);
+	if (clutWidth > 0)
+		count = SoftRenderer_addReadArea(areas, count, primitive->clutX,
+				primitive->clutY, clutWidth, 1);
+	return count;
+}
+
+/*
+ * This function fetches a texel for a primitive, applying the texture window
+ * and looking it up in the CLUT if needed.
+ */
+static inline int32_t SoftRenderer_getTexel(const uint16_t *vram,
+		const SoftRendererPrimitive *primitive, int32_t u, int32_t v)
+{
+	u = (u & ~primitive->texWindowMaskX) | primitive->texWindowOffsetX;
+	v = (v & ~primitive->texWindowMaskY) | primitive->texWindowOffsetY;
+	const uint16_t *row = &vram[(primitive->texBaseY + v) * 1024];
+
+	switch (primitive->texColourMode) {
+		case 0: {
+			int32_t pixel = row[(primitive->texBaseX + (u >> 2)) & 0x3FF];
+			int32_t index = (pixel >> ((u & 0x3) * 4)) & 0xF;
+			return vram[primitive->clutY * 1024 +
+					((primitive->clutX + index) & 0x3FF)];
+		}
+		case 1: {
+			int32_t pixel = row[(primitive->texBaseX + (u >> 1)) & 0x3FF];
+			int32_t index = (pixel >> ((u & 0x1) * 8)) & 0xFF;
+			return vram[primitive->clutY * 1024 +
+					((primitive->clutX + index) & 0x3FF)];
+		}
+		default:
+			return row[(primitive->texBaseX + u) & 0x3FF];
+	}
+}
+
+/*
+ * This function works out the tile column mask for an area.
+ */
+static uint64_t SoftRenderer_getTileMask(const int32_t *area)
+{
+	int32_t first = area[0] / 16;
+	int32_t last = area[2] / 16;
+	return (UINT64_MAX >> (63 - (last - first))) << first;
+}
+
+/*
+ * This function marks the tiles an area covers.
+ */
+static void SoftRenderer_markTiles(uint64_t *tiles, const int32_t *area)
+{
+	uint64_t mask = SoftRenderer_getTileMask(area);
+	for (int32_t row = area[1] / 16; row <= area[3] / 16; ++row)
+		tiles[row] |= mask;
+}
+
+/*
+ * This function sets the texture page, colour mode and semi-transparency
+ * mode of a primitive, from bits laid out as in the status register.
+ */
+static void SoftRenderer_setTexturePage(SoftRendererPrimitive *primitive,
+		int32_t texturePage)
+{
+	primitive->texBaseX = (texturePage & 0xF) * 64;
+	primitive->texBaseY = ((texturePage >> 4) & 0x1) * 256;
+	primitive->semiTransparencyMode = (texturePage >> 5) & 0x3;
+	primitive->texColourMode = (texturePage >> 7) & 0x3;
+}
+
+/*
+ * This function sets up a primitive from the GPU state held in a command -
+ * the drawing area, mask and dither settings, texture window, and texture
+ * page from the status register. It also returns the drawing offset.
+ */
+static void SoftRenderer_setupPrimitive(SoftRendererPrimitive *primitive,
+		GpuCommand *command, int32_t *offsetX, int32_t *offsetY)
+{
+	memset(primitive, 0, sizeof(SoftRendererPrimitive));
+
+	// Setup drawing area and offset
+	primitive->area[0] = command->drawingAreaTopLeft & 0x3FF;
+	primitive->area[1] =
+			logical_rshift(command->drawingAreaTopLeft, 10) & 0x1FF;
+	primitive->area[2] = command->drawingAreaBottomRight & 0x3FF;
+	primitive->area[3] =
+			logical_rshift(command->drawingAreaBottomRight, 10) & 0x1FF;
+	*offsetX = SoftRenderer_signExtend(command->drawingOffset);
+	*offsetY =
+			SoftRenderer_signExtend(logical_rshift(command->drawingOffset, 11));
+
+	// Split out masking and dither bits from status register
+	primitive->maskBit = (command->statusRegister & 0x800) ? 0x8000 : 0;
+	primitive->checkMask = (command->statusRegister & 0x1000) != 0;
+	primitive->dither = (command->statusRegister & 0x200) != 0;
+
+	// Setup texture window, in texels
+	int32_t textureWindow = command->textureWindow;
+	int32_t maskX = textureWindow & 0x1F;
+	int32_t maskY = logical_rshift(textureWindow, 5) & 0x1F;
+	int32_t offsetWindowX = logical_rshift(textureWindow, 10) & 0x1F;
+	int32_t offsetWindowY = logical_rshift(textureWindow, 15) & 0x1F;
+	primitive->texWindowMaskX = maskX * 8;
+	primitive->texWindowOffsetX = (offsetWindowX & maskX) * 8;
+	primitive->texWindowMaskY = maskY * 8;
+	primitive->texWindowOffsetY = (offsetWindowY & maskY) * 8;
+
+	SoftRenderer_setTexturePage(primitive, command->statusRegister);
+}
+
+/*
+ * This function shades and writes a single pixel - texturing, modulating,
+ * dithering, blending and masking it as the primitive requires.
+ */
+static inline void SoftRenderer_shadePixel(const uint16_t *vram,
+		const SoftRendererPrimitive *primitive, uint16_t *pixel, int32_t x,
+		int32_t y, int32_t red, int32_t green, int32_t blue, int32_t u,
+		int32_t v)
+{
+	// Leave pixels the mask protects alone
+	if (primitive->checkMask && (*pixel & 0x8000))
+		return;
+
+	// Fetch texel, skipping fully transparent (zero) ones, and modulate
+	// colour by it
+	int32_t texel = 0;
+	red = min_value(max_value(red, 0), 255);
+	green = min_value(max_value(green, 0), 255);
+	blue = min_value(max_value(blue, 0), 255);
+	if (primitive->textured) {
+		texel = SoftRenderer_getTexel(vram, primitive, u, v);
+		if (texel == 0)
+			return;
+		if (primitive->rawTexture) {
+			red = (texel & 0x1F) << 3;
+			green = ((texel >> 5) & 0x1F) << 3;
+			blue = ((texel >> 10) & 0x1F) << 3;
+		} else {
+			red = ((texel & 0x1F) * red) >> 4;
+			green = (((texel >> 5) & 0x1F) * green) >> 4;
+			blue = (((texel >> 10) & 0x1F) * blue) >> 4;
+		}
+	}
+
+	// Dither, then reduce to 15-bit colour
+	if (primitive->dither) {
+		int32_t offset = SoftRenderer_ditherTable[y & 0x3][x & 0x3];
+		red = max_value(red + offset, 0);
+		green = max_value(green + offset, 0);
+		blue = max_value(blue + offset, 0);
+	}
+	int32_t colour = (min_value(red, 255) >> 3) |
+			(min_value(green, 255) >> 3) << 5 |
+			(min_value(blue, 255) >> 3) << 10;
+
+	// Blend if semi-transparent - textured pixels are only blended if their
+	// texel has its top bit set
+	if (primitive->semiTransparent &&
+			(!primitive->textured || (texel & 0x8000)))
+		colour = SoftRenderer_blend(*pixel, colour,
+				primitive->semiTransparencyMode);
+
+	*pixel = (uint16_t)(colour | primitive->maskBit | (texel & 0x8000));
+}
+
+/*
+ * This function returns the sign extended value of an 11-bit coordinate.
+ */
+static int32_t SoftRenderer_signExtend(int32_t value)
+{
+	return ((value & 0x7FF) ^ 0x400) - 0x400;
+}
+
+/*
+ * This function tells the first threadCount - 1 workers to quit, and waits
+ * for them to do so.
+ */
+static void SoftRenderer_stopWorkers(SoftRenderer *sr, int32_t threadCount)
+{
+	pthread_mutex_lock(&sr->workMutex);
+	sr->quit = true;
+	pthread_cond_broadcast(&sr->workCondition);
+	pthread_mutex_unlock(&sr->workMutex);
+
+	for (int32_t i = 1; i < threadCount; ++i)
+		pthread_join(sr->workers[i].thread, NULL);
+}
+
+/*
+ * This function checks whether an area covers any of the marked tiles.
+ */
+static bool SoftRenderer_testTiles(const uint64_t *tiles, const int32_t *area)
+{
+	uint64_t mask = SoftRenderer_getTileMask(area);
+	for (int32_t row = area[1] / 16; row <= area[3] / 16; ++row)
+		if (tiles[row] & mask)
+			return true;
+	return false;
+}
+
+/*
+ * This function is the body of each worker thread, drawing its bands of
+ * each batch as it arrives.
+ */
+static void *SoftRenderer_workerFunction(void *arg)
+{
+	SoftRendererWorker *worker = arg;
+	SoftRenderer *sr = worker->sr;
+	int64_t lastBatch = 0;
+
+	for (;;) {
+
+		// Wait for the next batch, or for the signal to quit
+		pthread_mutex_lock(&sr->workMutex);
+		while (!sr->quit && sr->batchNumber == lastBatch)
+			pthread_cond_wait(&sr->workCondition, &sr->workMutex);
+		if (sr->quit) {
+			pthread_mutex_unlock(&sr->workMutex);
+			break;
+		}
+		lastBatch = sr->batchNumber;
+		pthread_mutex_unlock(&sr->workMutex);
+
+		SoftRenderer_drawBatch(sr, worker->index);
+
+		// Tell the rendering thread we are done
+		pthread_mutex_lock(&sr->workMutex);
+		if (--sr->workersRunning == 0)
+			pthread_cond_signal(&sr->doneCondition);
+		pthread_mutex_unlock(&sr->workMutex);
+	}
+
+	return NULL;
+}
@@ -18,35 +18,156 @@
 #include "../headers/R3051.h"
 #include "../headers/DMAArbiter.h"
 #include "../headers/GPU.h"
+#include "../headers/GuestMemory.h"
+#include "../headers/PerfCounters.h"
+#include "../headers/SaveState.h"
 #include "../headers/SPU.h"
+#include "../headers/endian_utils.h"
 #include "../headers/math_utils.h"
 
+// Events the scheduler can hold, each of which is scheduled at most once
+#define PHILPSX_EVENT_GPU_INTERRUPT 0
+#define PHILPSX_EVENT_DMA_INTERRUPT 1
+#define PHILPSX_EVENT_CDROM_INTERRUPT 2
+#define PHILPSX_EVENT_VBLANK 3
+#define PHILPSX_EVENT_TIMER0 4
+#define PHILPSX_EVENT_TIMER1 5
+#define PHILPSX_EVENT_TIMER2 6
+#define PHILPSX_EVENT_SPU_INTERRUPT 7
+#define PHILPSX_EVENT_SPU 8
+#define PHILPSX_EVENT_CDROM_SECTOR 9
+#define PHILPSX_EVENT_DMA_COMPLETE 10
+#define PHILPSX_EVENT_SIO_TRANSFER 11
+#define PHILPSX_EVENT_SIO_INTERRUPT 12
+#define PHILPSX_EVENT_COUNT 13
+
+// How often in CPU cycles to sample HBlank and VBlank status for timers
+// using them for synchronisation
+#define PHILPSX_TIMER_SYNC_INTERVAL 64
+
+// The I/O port region is split into 4-byte slots for dispatch, each of which
+// refers to one of a small number of windows registered by components
+#define PHILPSX_IO_PORT_BASE 0x1F801000
+#define PHILPSX_IO_PORT_SLOT_SHIFT 2
+#define PHILPSX_IO_PORT_SLOT_COUNT 1024
+#define PHILPSX_IO_PORT_MAX_WINDOWS 32
+
+// Stall cycles are looked up per 64 KB page of the physical address space,
+// matching the granularity of the CPU's page table
+#define PHILPSX_STALL_PAGE_SHIFT 16
+#define PHILPSX_STALL_PAGE_COUNT 65536
+
 // Forward declarations for functions and subcomponents private to this class
 // SystemInterlink-related stuff:
+static int32_t *SystemInterlink_getRegister(SystemInterlink *smi,
+		int32_t address);
 static bool SystemInterlink_loadBiosFileToMemory(const char *biosPath,
 		int8_t *biosMemory);
+static int32_t SystemInterlink_readIoPort(SystemInterlink *smi, int32_t width,
+		int32_t address);
+static int32_t SystemInterlink_readRegisterByte(void *component,
+		int32_t address);
+static int32_t SystemInterlink_readRegisterHalfWord(void *component,
+		int32_t address);
+static int32_t SystemInterlink_readRegisterWord(void *component,
+		int32_t address);
+static void SystemInterlink_rebuildStallTable(SystemInterlink *smi);
+static void SystemInterlink_registerWritten(SystemInterlink *smi,
+		int32_t address);
+static void SystemInterlink_scheduleEvent(SystemInterlink *smi,
+		int32_t event, int64_t delay);
+static void SystemInterlink_syncPeripherals(SystemInterlink *smi);
+static void SystemInterlink_updateIrqLine(SystemInterlink *smi);
+static void SystemInterlink_writeIoPort(SystemInterlink *smi, int32_t width,
+		int32_t address, int32_t value);
+static void SystemInterlink_writeRegisterByte(void *component, int32_t address,
+		int32_t value);
+static void SystemInterlink_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value);
+static void SystemInterlink_writeRegisterWord(void *component, int32_t address,
+		int32_t value);
+
+// IoWindow-related stuff:
+typedef struct IoWindow IoWindow;
+
+// Scheduler-related stuff:
+typedef struct Scheduler Scheduler;
+static void Scheduler_cancelEvent(Scheduler *scheduler, int32_t event);
+static int64_t Scheduler_getNextDeadline(Scheduler *scheduler);
+static int32_t Scheduler_popEvent(Scheduler *scheduler);
+static void Scheduler_scheduleEvent(Scheduler *scheduler, int32_t event,
+		int64_t deadline);
+static void Scheduler_siftDown(Scheduler *scheduler, int32_t position);
+static void Scheduler_siftUp(Scheduler *scheduler, int32_t position);
+static void Scheduler_swapEvents(Scheduler *scheduler, int32_t first,
+		int32_t second);
 
 // TimerModule-related stuff:
 typedef struct TimerModule TimerModule;
-static void TimerModule_appendSyncCycles(TimerModule *timerModule,
-		int32_t cycles);
+static int64_t TimerModule_countPasses(int64_t from, int64_t to,
+		int64_t value, int64_t period);
+static int64_t TimerModule_getIncrements(TimerModule *timerModule,
+		int32_t timer, int64_t cycles);
 static int32_t TimerModule_readCounterValue(TimerModule *timerModule,
 		int32_t timer);
 static int32_t TimerModule_readMode(TimerModule *timerModule,
 		int32_t timer, bool override);
+static int32_t TimerModule_readRegisterByte(void *component,
+		int32_t address);
+static int32_t TimerModule_readRegisterHalfWord(void *component,
+		int32_t address);
+static int32_t TimerModule_readRegisterWord(void *component,
+		int32_t address);
 static int32_t TimerModule_readTargetValue(TimerModule *timerModule,
 		int32_t timer);
-static void TimerModule_resync(TimerModule *timerModule);
-static int32_t TimerModule_swapEndianness(int32_t word);
+static void TimerModule_rebase(TimerModule *timerModule, int32_t timer,
+		int32_t value);
+static void TimerModule_scheduleEvent(TimerModule *timerModule,
+		int32_t timer);
+static void TimerModule_setClockRate(TimerModule *timerModule,
+		int32_t timer);
 static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 		int32_t timer);
+static void TimerModule_update(TimerModule *timerModule, int32_t timer);
 static void TimerModule_writeCounterValue(TimerModule *timerModule,
 		int32_t timer, int32_t value);
 static void TimerModule_writeMode(TimerModule *timerModule,
 		int32_t timer, int32_t value);
+static void TimerModule_writeRegisterByte(void *component, int32_t address,
+		int32_t value);
+static void TimerModule_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value);
+static void TimerModule_writeRegisterWord(void *component, int32_t address,
+		int32_t value);
 static void TimerModule_writeTargetValue(TimerModule *timerModule,
 		int32_t timer, int32_t value);
 
+/*
+ * This struct models a window of I/O ports belonging to one component, along
+ * with the handlers it has registered for each access width.
+ */
+struct IoWindow {
+	void *component;
+	SystemInterlinkReadHandler readHandlers[PHILPSX_IO_WIDTH_COUNT];
+	SystemInterlinkWriteHandler writeHandlers[PHILPSX_IO_WIDTH_COUNT];
+};
+
+/*
+ * This struct models a scheduler of timestamped events, held in a min-heap
+ * ordered by the cycle count each one is due at.
+ */
+struct Scheduler {
+
+	// Deadline of each event, and its position in the heap (-1 if it is
+	// not scheduled)
+	int64_t deadlines[PHILPSX_EVENT_COUNT];
+	int32_t heapPositions[PHILPSX_EVENT_COUNT];
+
+	// Heap of scheduled events
+	int32_t heap[PHILPSX_EVENT_COUNT];
+	int32_t heapSize;
+};
+
 /*
  * This struct models all three timers within a single object.
  */
@@ -59,18 +180,16 @@ struct TimerModule {
 	int32_t timerMode[3];
 	int32_t timerCounterValue[3];
 	int32_t timerTargetValue[3];
-	int32_t clockSource[3];
-	int32_t incrementBy[3];
-	int32_t newValue[3];
 	bool interruptHappenedOnceOrMore[3];
-
-	// Variables to track CPU cycles and GPU cycles
-	int32_t cpuCyclesToSync[3];
-	int32_t gpuCyclesToSync[3];
-	int32_t cpuTopup[3];
-	int32_t gpuTopup[3];
-	bool hblankHappened[3];
-	bool vblankHappened[3];
+	bool blankHappened[3];
+
+	// Counters are worked out on demand from the system cycle count - each
+	// one counts periodIncrements every periodCycles CPU cycles, starting
+	// from baseValue at baseCycles
+	int64_t baseValue[3];
+	int64_t baseCycles[3];
+	int64_t periodCycles[3];
+	int64_t periodIncrements[3];
 };
 
 /*
@@ -90,13 +209,34 @@ struct SystemInterlink {
 	int8_t *scratchpad;	// Allocated dynamically due to size
 	int8_t *bios;		// Allocated dynamically due to size
 
+	// Guest memory holding RAM, BIOS and scratchpad, each in a region of its
+	// own with RAM on huge pages where available
+	GuestMemory *memory;
+
+	// Bitmap of 4 KB RAM pages holding code the CPU has cached, so writes
+	// to them can invalidate it
+	uint32_t codePages[16];
+
 	// Timers declaration
 	TimerModule timerModule;
 
+	// I/O port dispatch table, with window 0 left empty for unmapped ports
+	uint8_t ioPortSlots[PHILPSX_IO_PORT_SLOT_COUNT];
+	IoWindow ioWindows[PHILPSX_IO_PORT_MAX_WINDOWS];
+	int32_t ioWindowCount;
+
+	// Stall cycles for accessing each page, rebuilt whenever a memory
+	// control register is written
+	uint8_t stallTable[PHILPSX_STALL_PAGE_COUNT];
+
 	// Register declarations
 	int32_t cacheControlReg;
 	int32_t interruptStatusReg;
 	int32_t interruptMaskReg;
+
+	// Whether any interrupt is both flagged and unmasked, worked out
+	// whenever the interrupt status or mask register changes
+	bool irqLineAsserted;
 	int32_t expansion1BaseAddress;
 	int32_t expansion2BaseAddress;
 	int32_t expansion1DelaySize;
@@ -109,19 +249,19 @@ struct SystemInterlink {
 	int32_t ramSize;
 	int8_t biosPost;
 
-	// These registers can allow us to delay interrupts so they trigger at
-	// the proper time
-	int64_t gpuInterruptDelay;
-	int64_t dmaInterruptDelay;
-	int64_t cdromInterruptDelay;
-	int64_t gpuInterruptCounter;
-	int64_t dmaInterruptCounter;
-	int64_t cdromInterruptCounter;
-	int64_t timersInterruptDelay[3];
-	int64_t timersInterruptCounter[3];
+	// Whether the instruction cache is enabled, worked out whenever the
+	// cache control register is written
+	bool instructionCacheEnabled;
+
+	// Event scheduler, along with the total number of CPU cycles executed
+	// and how many of those the peripherals have been synced by
+	Scheduler scheduler;
+	int64_t systemCycles;
+	int64_t syncedCycles;
+
+	// CD-ROM interrupt details
 	int32_t cdromInterruptNumber;
 	bool cdromInterruptEnabled;
-	int32_t interruptCycles;
 };
 
 /*
@@ -138,40 +278,36 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
 		goto end;
 	}
 	
-	// Allocate 2 MB system RAM
-	smi->ram = calloc(2097152, sizeof(int8_t));
-	if (!smi->ram) {
+	// Allocate 2 MB system RAM, 512 KB BIOS area and scratchpad
+	const size_t regionSizes[] = {2097152, 524288, 1024};
+	smi->memory = construct_GuestMemory(regionSizes, 3);
+	if (!smi->memory) {
 		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't allocate memory "
-				"for ram array\n");
+				"for ram, bios and scratchpad arrays\n");
 		goto cleanup_systeminterlink;
 	}
-
-	// Allocate 512 KB BIOS area
-	smi->bios = calloc(524288, sizeof(int8_t));
-	if (!smi->bios) {
-		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't allocate memory "
-				"for bios array\n");
-		goto cleanup_ram;
-	}
-
-	// Allocate scratchpad
-	smi->scratchpad = calloc(1024, sizeof(int8_t));
-	if (!smi->scratchpad) {
-		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't allocate memory "
-				"for scratchpad array\n");
-		goto cleanup_bios;
-	}
+	smi->ram = GuestMemory_getRegion(smi->memory, 0);
+	smi->bios = GuestMemory_getRegion(smi->memory, 1);
+	smi->scratchpad = GuestMemory_getRegion(smi->memory, 2);
 	
 	// Load BIOS
 	if (!SystemInterlink_loadBiosFileToMemory(biosPath, smi->bios)) {
 		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't copy BIOS data "
 				"to memory\n");
-		goto cleanup_scratchpad;
+		goto cleanup_memory;
 	}
 	
-	// Zero out timer module and set interlink reference
+	// No code has been cached yet
+	memset(smi->codePages, 0, sizeof(smi->codePages));
+
+	// Zero out timer module and set interlink reference, with all timers
+	// counting at the system clock rate
 	memset(&smi->timerModule, 0, sizeof(smi->timerModule));
 	smi->timerModule.smi = smi;
+	for (int32_t i = 0; i < 3; ++i) {
+		smi->timerModule.periodCycles[i] = 1;
+		smi->timerModule.periodIncrements[i] = 1;
+	}
 	
 	// Set all component references to NULL
 	smi->dma = NULL;
@@ -181,25 +317,26 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
 	smi->cdrom = NULL;
 	smi->cio = NULL;
 	
-	// Setup interrupt delays
-	smi->gpuInterruptDelay = -1L;
-	smi->dmaInterruptDelay = -1L;
-	smi->cdromInterruptDelay = -1L;
-	smi->gpuInterruptCounter = 0;
-	smi->dmaInterruptCounter = 0;
-	smi->cdromInterruptCounter = 0;
-	for (int32_t i = 0; i < 3; ++i) {
-		smi->timersInterruptDelay[i] = -1L;
-		smi->timersInterruptCounter[i] = 0;
+	// Setup scheduler with no events, then schedule the vblank and SPU
+	// events straight away so the GPU and SPU can tell us when they are
+	// really due
+	smi->scheduler.heapSize = 0;
+	for (int32_t i = 0; i < PHILPSX_EVENT_COUNT; ++i) {
+		smi->scheduler.deadlines[i] = 0;
+		smi->scheduler.heapPositions[i] = -1;
 	}
+	smi->systemCycles = 0;
+	smi->syncedCycles = 0;
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_VBLANK, 0);
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_SPU, 0);
 	smi->cdromInterruptNumber = 0;
 	smi->cdromInterruptEnabled = false;
-	smi->interruptCycles = 0;
 
 	// Setup registers
 	smi->cacheControlReg = 0;
 	smi->interruptStatusReg = 0;
 	smi->interruptMaskReg = 0;
+	smi->irqLineAsserted = false;
 	smi->expansion1BaseAddress = 0;
 	smi->expansion2BaseAddress = 0;
 	smi->expansion1DelaySize = 0;
@@ -211,19 +348,61 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
 	smi->commonDelay = 0;
 	smi->ramSize = 0;
 	smi->biosPost = 0;
+	smi->instructionCacheEnabled = false;
+	SystemInterlink_rebuildStallTable(smi);
+
+	// Setup I/O port dispatch table with nothing mapped, then install the
+	// handlers for registers we hold ourselves
+	memset(smi->ioPortSlots, 0, sizeof(smi->ioPortSlots));
+	memset(smi->ioWindows, 0, sizeof(smi->ioWindows));
+	smi->ioWindowCount = 1;
+	SystemInterlink_registerIoHandlers(smi, 0x1F801000, 0x24,
+			PHILPSX_IO_BYTE, smi, SystemInterlink_readRegisterByte,
+			SystemInterlink_writeRegisterByte);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801000, 0x24,
+			PHILPSX_IO_HALFWORD, smi,
+			SystemInterlink_readRegisterHalfWord,
+			SystemInterlink_writeRegisterHalfWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801000, 0x24,
+			PHILPSX_IO_WORD, smi, SystemInterlink_readRegisterWord,
+			SystemInterlink_writeRegisterWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801060, 0x4,
+			PHILPSX_IO_BYTE, smi, SystemInterlink_readRegisterByte,
+			SystemInterlink_writeRegisterByte);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801060, 0x4,
+			PHILPSX_IO_HALFWORD, smi,
+			SystemInterlink_readRegisterHalfWord,
+			SystemInterlink_writeRegisterHalfWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801060, 0x4,
+			PHILPSX_IO_WORD, smi, SystemInterlink_readRegisterWord,
+			SystemInterlink_writeRegisterWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801070, 0x8,
+			PHILPSX_IO_BYTE, smi, SystemInterlink_readRegisterByte,
+			SystemInterlink_writeRegisterByte);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801070, 0x8,
+			PHILPSX_IO_HALFWORD, smi,
+			SystemInterlink_readRegisterHalfWord,
+			SystemInterlink_writeRegisterHalfWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801070, 0x8,
+			PHILPSX_IO_WORD, smi, SystemInterlink_readRegisterWord,
+			SystemInterlink_writeRegisterWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801100, 0x30,
+			PHILPSX_IO_BYTE, &smi->timerModule, TimerModule_readRegisterByte,
+			TimerModule_writeRegisterByte);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801100, 0x30,
+			PHILPSX_IO_HALFWORD, &smi->timerModule,
+			TimerModule_readRegisterHalfWord,
+			TimerModule_writeRegisterHalfWord);
+	SystemInterlink_registerIoHandlers(smi, 0x1F801100, 0x30,
+			PHILPSX_IO_WORD, &smi->timerModule, TimerModule_readRegisterWord,
+			TimerModule_writeRegisterWord);
 	
 	// Normal return:
 	return smi;
 	
 	// Cleanup path:
-	cleanup_scratchpad:
-	free(smi->scratchpad);
-	
-	cleanup_bios:
-	free(smi->bios);
-	
-	cleanup_ram:
-	free(smi->ram);
+	cleanup_memory:
+	destruct_GuestMemory(smi->memory);
 	
 	cleanup_systeminterlink:
 	free(smi);
@@ -238,29 +417,35 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
  */
 void destruct_SystemInterlink(SystemInterlink *smi)
 {
-	free(smi->scratchpad);
-	free(smi->bios);
-	free(smi->ram);
+	destruct_GuestMemory(smi->memory);
 	free(smi);
 }
 
 /*
- * This function appends CPU cycles to the timer module.
+ * This function moves the system cycle count on by the number of cycles the
+ * CPU has executed. Peripherals only catch up when their registers are
+ * accessed or one of their events is processed.
  */
 void SystemInterlink_appendSyncCycles(SystemInterlink *smi, int32_t cycles)
 {
-	smi->interruptCycles += cycles;
-	GPU_appendSyncCycles(smi->gpu, cycles);
-	ControllerIO_appendSyncCycles(smi->cio, cycles);
-	TimerModule_appendSyncCycles(&smi->timerModule, cycles);
+	smi->systemCycles += cycles;
+}
+
+/*
+ * This function allows us to return a reference to the BIOS array.
+ */
+int8_t *SystemInterlink_getBiosArray(SystemInterlink *smi)
+{
+	return smi->bios;
 }
 
 /*
- * This function wraps the GPU function to execute accumulated cycles.
+ * This function returns the bitmap of RAM pages holding cached code, so the
+ * CPU can check it when writing to RAM directly.
  */
-void SystemInterlink_executeGPUCycles(SystemInterlink *smi)
+uint32_t *SystemInterlink_getCodePageBitmap(SystemInterlink *smi)
 {
-	GPU_executeGPUCycles(smi->gpu);
+	return smi->codePages;
 }
 
 /*
@@ -325,124 +510,210 @@ SPU *SystemInterlink_getSpu(SystemInterlink *smi)
 int32_t SystemInterlink_howManyStallCycles(SystemInterlink *smi,
 		int32_t address)
 {
-	// Convert address to long so we can do arithmetic on it, aligning to
-	// word boundary, and declare return value
-	int64_t tempAddress = 0xFFFFFFFCL & address;
-
-	// Set to 4 as this is the delay of most registers
-	int32_t cycles = 4;
-
-	// Check which area the address is in and set cycles accordingly
-	if (tempAddress >= 0L && tempAddress < 0x200000L) {
-		// RAM
-		cycles = 6;
-	} else if (tempAddress >= 0x1FC00000L && tempAddress < 0x1FC80000L) {
-		// BIOS
-		cycles = 1;
-	} else if (tempAddress == 0xFFFE0130L) {
-		// Cache control register
-		cycles = 1;
-	}
-
-	return cycles;
+	return smi->stallTable[
+			logical_rshift(address, PHILPSX_STALL_PAGE_SHIFT)];
 }
 
 /*
- * This function updates the counters of all the peripherals capable of
- * generating interrupts, and sets flags in the interrupt status register at
- * the right time.
+ * This tests the cache control register to see if the instruction
+ * cache is enabled.
  */
-void SystemInterlink_incrementInterruptCounters(SystemInterlink *smi)
+bool SystemInterlink_instructionCacheEnabled(SystemInterlink *smi)
 {
-	smi->gpuInterruptCounter += smi->interruptCycles;
-	smi->dmaInterruptCounter += smi->interruptCycles;
-	smi->cdromInterruptCounter += smi->interruptCycles;
-	for (int32_t i = 0; i < 3; ++i) {
-		smi->timersInterruptCounter[i] += smi->interruptCycles;
-	}
-
-	// Handle GPU
-	if (smi->gpuInterruptDelay != -1L &&
-			smi->gpuInterruptCounter > smi->gpuInterruptDelay) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x01000000;
-		smi->gpuInterruptDelay = -1L;
-	}
+	return smi->instructionCacheEnabled;
+}
 
-	// Handle DMA
-	if (smi->dmaInterruptDelay != -1L &&
-			smi->dmaInterruptCounter > smi->dmaInterruptDelay) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x08000000;
-		smi->dmaInterruptDelay = -1L;
-	}
+/*
+ * This function returns whether the interrupt line to the CPU is asserted,
+ * which it is while any interrupt is both flagged and unmasked.
+ */
+bool SystemInterlink_irqLineAsserted(SystemInterlink *smi)
+{
+	return smi->irqLineAsserted;
+}
 
-	// Handle CD-ROM
-	if (smi->cdromInterruptDelay != -1L &&
-			smi->cdromInterruptCounter > smi->cdromInterruptDelay) {
-		// Set in little-endian mode for speed
-		if (smi->cdromInterruptEnabled) {
-			smi->interruptStatusReg |= 0x04000000;
+/*
+ * This function tells the CPU that the specified range of RAM has been
+ * written to, so that any code it has cached from the pages involved is
+ * thrown away. Anything writing to the RAM array directly must call this.
+ */
+void SystemInterlink_invalidateCode(SystemInterlink *smi, int32_t address,
+		int32_t length)
+{
+	// Clamp range to RAM
+	int64_t startAddress = address & 0xFFFFFFFFL;
+	int64_t endAddress = startAddress + length;
+	if (length <= 0 || startAddress >= 0x200000L)
+		return;
+	if (endAddress > 0x200000L)
+		endAddress = 0x200000L;
+
+	// Invalidate each flagged page
+	for (int64_t page = startAddress >> 12; page <= (endAddress - 1) >> 12;
+			++page) {
+		uint32_t mask = 1U << (page & 0x1F);
+		if (smi->codePages[page >> 5] & mask) {
+			smi->codePages[page >> 5] &= ~mask;
+			R3051_invalidateCodePage(smi->cpu, (int32_t)(page << 12));
 		}
-
-		// Set this interrupt handler back to inactive
-		smi->cdromInterruptDelay = -1L;
-
-		// Also set interrupt number in CD-ROM interrupt flag register
-		CDROMDrive_setInterruptNumber(smi->cdrom, smi->cdromInterruptNumber);
-	}
-
-	// Handle Timer 0
-	if (smi->timersInterruptDelay[0] != -1L &&
-			smi->timersInterruptCounter[0] > smi->timersInterruptDelay[0]) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x10000000;
-		smi->timersInterruptDelay[0] = -1L;
-	}
-
-	// Handle Timer 1
-	if (smi->timersInterruptDelay[1] != -1L &&
-			smi->timersInterruptCounter[1] > smi->timersInterruptDelay[1]) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x20000000;
-		smi->timersInterruptDelay[1] = -1L;
 	}
+}
 
-	// Handle Timer 2
-	if (smi->timersInterruptDelay[2] != -1L &&
-			smi->timersInterruptCounter[2] > smi->timersInterruptDelay[2]) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x40000000;
-		smi->timersInterruptDelay[2] = -1L;
+/*
+ * This function reads the interlink's state back from a save state, in the
+ * order SystemInterlink_saveState wrote it. Cached code is only thrown away
+ * for RAM pages whose contents actually change, so loading a state taken a
+ * moment ago keeps nearly all of it.
+ */
+void SystemInterlink_loadState(SystemInterlink *smi, SaveState *state)
+{
+	// RAM, invalidating any cached code on pages that differ
+	const int8_t *ram = SaveState_readRegion(state, 0x200000);
+	if (ram) {
+		for (int32_t page = 0; page < 512; ++page) {
+			uint32_t mask = 1U << (page & 0x1F);
+			if ((smi->codePages[page >> 5] & mask) &&
+					memcmp(smi->ram + (page << 12), ram + (page << 12),
+					0x1000) != 0)
+				SystemInterlink_invalidateCode(smi, page << 12, 0x1000);
+		}
+		memcpy(smi->ram, ram, 0x200000);
 	}
-
-	// Reset interrupt cycles
-	smi->interruptCycles = 0;
+	SaveState_read(state, smi->scratchpad, 1024);
+
+	// Timers
+	TimerModule *tm = &smi->timerModule;
+	SaveState_read(state, tm->timerMode, sizeof(tm->timerMode));
+	SaveState_read(state, tm->timerCounterValue,
+			sizeof(tm->timerCounterValue));
+	SaveState_read(state, tm->timerTargetValue, sizeof(tm->timerTargetValue));
+	SaveState_read(state, tm->interruptHappenedOnceOrMore,
+			sizeof(tm->interruptHappenedOnceOrMore));
+	SaveState_read(state, tm->blankHappened, sizeof(tm->blankHappened));
+	SaveState_read(state, tm->baseValue, sizeof(tm->baseValue));
+	SaveState_read(state, tm->baseCycles, sizeof(tm->baseCycles));
+	SaveState_read(state, tm->periodCycles, sizeof(tm->periodCycles));
+	SaveState_read(state, tm->periodIncrements, sizeof(tm->periodIncrements));
+
+	// Registers
+	SaveState_read(state, &smi->cacheControlReg, sizeof(int32_t));
+	SaveState_read(state, &smi->interruptStatusReg, sizeof(int32_t));
+	SaveState_read(state, &smi->interruptMaskReg, sizeof(int32_t));
+	SystemInterlink_updateIrqLine(smi);
+	SaveState_read(state, &smi->expansion1BaseAddress, sizeof(int32_t));
+	SaveState_read(state, &smi->expansion2BaseAddress, sizeof(int32_t));
+	SaveState_read(state, &smi->expansion1DelaySize, sizeof(int32_t));
+	SaveState_read(state, &smi->expansion3DelaySize, sizeof(int32_t));
+	SaveState_read(state, &smi->biosRomDelaySize, sizeof(int32_t));
+	SaveState_read(state, &smi->spuDelaySize, sizeof(int32_t));
+	SaveState_read(state, &smi->cdromDelaySize, sizeof(int32_t));
+	SaveState_read(state, &smi->expansion2DelaySize, sizeof(int32_t));
+	SaveState_read(state, &smi->commonDelay, sizeof(int32_t));
+	SaveState_read(state, &smi->ramSize, sizeof(int32_t));
+	SaveState_read(state, &smi->biosPost, sizeof(int8_t));
+	smi->instructionCacheEnabled = (smi->cacheControlReg & 0x800) == 0x800;
+
+	// Scheduler, which holds the pending interrupt delays, along with the
+	// cycle counts it works from
+	SaveState_read(state, &smi->scheduler, sizeof(Scheduler));
+	SaveState_read(state, &smi->systemCycles, sizeof(int64_t));
+	SaveState_read(state, &smi->syncedCycles, sizeof(int64_t));
+
+	// CD-ROM interrupt details
+	SaveState_read(state, &smi->cdromInterruptNumber, sizeof(int32_t));
+	SaveState_read(state, &smi->cdromInterruptEnabled, sizeof(bool));
 }
 
 /*
- * This tests the cache control register to see if the instruction
- * cache is enabled.
+ * This function flags the RAM page containing the specified address as
+ * holding code the CPU has cached.
  */
-bool SystemInterlink_instructionCacheEnabled(SystemInterlink *smi)
+void SystemInterlink_markCodePage(SystemInterlink *smi, int32_t address)
 {
-	// swap endianness of reg
-	int32_t tempReg = ((smi->cacheControlReg << 24) & 0xFF000000) | 
-			((smi->cacheControlReg << 8) & 0xFF0000) | 
-			(logical_rshift(smi->cacheControlReg, 8) & 0xFF00) | 
-			(logical_rshift(smi->cacheControlReg, 24) & 0xFF);
-
-	return((tempReg & 0x800) == 0x800);
+	int64_t tempAddress = address & 0xFFFFFFFFL;
+	if (tempAddress < 0x200000L)
+		smi->codePages[tempAddress >> 17] |=
+				1U << ((tempAddress >> 12) & 0x1F);
 }
 
 /*
- * This function lets us know whether or not an address should be incremented -
- * it is mainly useful for halfword accesses where each byte should come from
- * the same address.
+ * This function handles any events that are now due, such as delayed
+ * interrupts, vblank, timers reaching their target or overflow values, the
+ * SPU's next batch of samples, the CD-ROM drive moving on to its next
+ * sector, DMA transfers finishing and bytes being exchanged with the
+ * controllers and memory cards.
+ * It is intended to be called from the CPU's execution loop, and returns
+ * true if any events were handled.
  */
-bool SystemInterlink_okToIncrement(SystemInterlink *smi, int64_t address)
+bool SystemInterlink_processEvents(SystemInterlink *smi)
 {
-	return !(address >= 0x1F801800 && address <= 0x1F801803);
+	// Leave straight away if nothing is due yet
+	if (Scheduler_getNextDeadline(&smi->scheduler) > smi->systemCycles)
+		return false;
+
+	// Bring peripherals up to date first
+	SystemInterlink_syncPeripherals(smi);
+
+	// Handle due events in order, including any they schedule for right now
+	while (Scheduler_getNextDeadline(&smi->scheduler) <= smi->systemCycles) {
+		int32_t event = Scheduler_popEvent(&smi->scheduler);
+		switch (event) {
+			case PHILPSX_EVENT_GPU_INTERRUPT:
+				smi->interruptStatusReg |= 0x1;
+				break;
+			case PHILPSX_EVENT_DMA_INTERRUPT:
+				smi->interruptStatusReg |= 0x8;
+				break;
+			case PHILPSX_EVENT_CDROM_INTERRUPT:
+				if (smi->cdromInterruptEnabled) {
+					smi->interruptStatusReg |= 0x4;
+				}
+
+				// Also set interrupt number in CD-ROM interrupt flag register
+				CDROMDrive_setInterruptNumber(smi->cdrom,
+						smi->cdromInterruptNumber);
+				break;
+			case PHILPSX_EVENT_VBLANK:
+				GPU_executeGPUCycles(smi->gpu);
+				SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_VBLANK,
+						GPU_howManyCyclesToNextEvent(smi->gpu));
+				break;
+			case PHILPSX_EVENT_TIMER0:
+			case PHILPSX_EVENT_TIMER1:
+			case PHILPSX_EVENT_TIMER2:
+				TimerModule_update(&smi->timerModule,
+						event - PHILPSX_EVENT_TIMER0);
+				break;
+			case PHILPSX_EVENT_SPU_INTERRUPT:
+				smi->interruptStatusReg |= 0x200;
+				break;
+			case PHILPSX_EVENT_SPU:
+				SPU_executeSPUCycles(smi->spu);
+				SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_SPU,
+						SPU_howManyCyclesToNextEvent(smi->spu));
+				break;
+			case PHILPSX_EVENT_CDROM_SECTOR:
+				CDROMDrive_readNextSector(smi->cdrom);
+				break;
+			case PHILPSX_EVENT_DMA_COMPLETE:
+				// The next transfer may stall the CPU, so bring the
+				// peripherals up to date again afterwards
+				DMAArbiter_completeTransfer(smi->dma);
+				SystemInterlink_syncPeripherals(smi);
+				break;
+			case PHILPSX_EVENT_SIO_TRANSFER:
+				ControllerIO_finishTransfer(smi->cio);
+				break;
+			case PHILPSX_EVENT_SIO_INTERRUPT:
+				smi->interruptStatusReg |= 0x80;
+				break;
+		}
+	}
+
+	// Events may have flagged interrupts
+	SystemInterlink_updateIrqLine(smi);
+
+	return true;
 }
 
 /*
@@ -464,6 +735,9 @@ int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address)
 		retVal = smi->bios[(int32_t)(tempAddress - 0x1FC00000L)];
 	} else { // Everything else
 
+		// Bring peripherals up to date before touching their registers
+		SystemInterlink_syncPeripherals(smi);
+
 		if (tempAddress >= 0x1F000000L && tempAddress < 0x1F800000L) {
 			// Expansion Region 1
 			// Do nothing for now
@@ -479,730 +753,9 @@ int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address)
 		}
 		else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
 			// I/O Ports
-			if (tempAddress >= 0x1F801000L && tempAddress < 0x1F801004L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1BaseAddress,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1BaseAddress,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1BaseAddress,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion1BaseAddress;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801004L && tempAddress < 0x1F801008L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2BaseAddress,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2BaseAddress,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2BaseAddress,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion2BaseAddress;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801008L && tempAddress < 0x1F80100CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1DelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1DelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1DelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion1DelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F80100CL && tempAddress < 0x1F801010L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion3DelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion3DelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion3DelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion3DelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801010L && tempAddress < 0x1F801014L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->biosRomDelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->biosRomDelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->biosRomDelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->biosRomDelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801014L && tempAddress < 0x1F801018L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->spuDelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->spuDelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->spuDelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->spuDelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801018L && tempAddress < 0x1F80101CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->cdromDelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->cdromDelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->cdromDelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->cdromDelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F80101CL && tempAddress < 0x1F801020L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2DelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2DelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2DelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion2DelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801020L && tempAddress < 0x1F801024L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->commonDelay,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->commonDelay,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->commonDelay,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->commonDelay;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801040L && tempAddress < 0x1F801050L) {
-				// Read from ControllerIO object
-				retVal = ControllerIO_readByte(smi->cio, (int32_t)tempAddress);
-			}
-			else if (tempAddress >= 0x1F801060L && tempAddress < 0x1F801064L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->ramSize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->ramSize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->ramSize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->ramSize;
-						break;
-				}
-			} // Interrupt Status Register
-			else if (tempAddress >= 0x1F801070L && tempAddress < 0x1F801074L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptStatusReg,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptStatusReg,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptStatusReg,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->interruptStatusReg;
-						break;
-				}
-			} // Interrupt Mask Register
-			else if (tempAddress >= 0x1F801074L && tempAddress < 0x1F801078L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptMaskReg,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptMaskReg,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptMaskReg,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->interruptMaskReg;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801080L && tempAddress < 0x1F801100L) {
-				retVal = DMAArbiter_readByte(smi->dma, address);
-			}
-			else if (tempAddress >= 0x1F801100L && tempAddress < 0x1F801104L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								0),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								0),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								0),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readCounterValue(
-								&smi->timerModule,
-								0
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801104L && tempAddress < 0x1F801108L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								0,
-								false),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								0,
-								false),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								0,
-								false),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readMode(
-								&smi->timerModule,
-								0,
-								false
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801108L && tempAddress < 0x1F80110CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								0),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								0),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								0),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readTargetValue(
-								&smi->timerModule,
-								0
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801110L && tempAddress < 0x1F801114L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								1),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								1),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								1),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readCounterValue(
-								&smi->timerModule,
-								1
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801114L && tempAddress < 0x1F801118L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								1,
-								false),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								1,
-								false),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								1,
-								false),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readMode(
-								&smi->timerModule,
-								1,
-								false
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801118L && tempAddress < 0x1F80111CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								1),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								1),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								1),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readTargetValue(
-								&smi->timerModule,
-								1
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801120L && tempAddress < 0x1F801124L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								2),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								2),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								2),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readCounterValue(
-								&smi->timerModule,
-								2
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801124L && tempAddress < 0x1F801128L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								2,
-								false),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								2,
-								false),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								2,
-								false),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readMode(
-								&smi->timerModule,
-								2,
-								false
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801128L && tempAddress < 0x1F80112CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								2),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								2),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								2),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readTargetValue(
-								&smi->timerModule,
-								2
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801810L && tempAddress < 0x1F801814L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								GPU_readResponse(
-								smi->gpu),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								GPU_readResponse(
-								smi->gpu),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								GPU_readResponse(
-								smi->gpu),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)GPU_readResponse(smi->gpu);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801814L && tempAddress < 0x1F801818L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								GPU_readStatus(
-								smi->gpu),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								GPU_readStatus(
-								smi->gpu),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								GPU_readStatus(
-								smi->gpu),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)GPU_readStatus(smi->gpu);
-						break;
-				}
-			} // CD-ROM
-			else if (tempAddress >= 0x1F801800L && tempAddress < 0x1F801804L) {
-				switch ((int32_t)tempAddress & 0xF) {
-					case 0:
-						retVal = CDROMDrive_read1800(smi->cdrom);
-						break;
-					case 1:
-						retVal = CDROMDrive_read1801(smi->cdrom);
-						break;
-					case 2:
-						retVal = CDROMDrive_read1802(smi->cdrom);
-						break;
-					case 3:
-						retVal = CDROMDrive_read1803(smi->cdrom);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801C00L && tempAddress < 0x1F802000L) {
-				// Fake SPU read
-				retVal = SPU_readByte(smi->spu, address);
-			}
+			// Read through whichever handler is registered for the port
+			retVal = (int8_t)SystemInterlink_readIoPort(smi, PHILPSX_IO_BYTE,
+					address);
 		} // Expansion Region 2 (I/O Ports)
 		else if (tempAddress >= 0x1F802000L && tempAddress < 0x1F803000L) {
 			// Read from BIOS post register
@@ -1217,30 +770,8 @@ int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address)
 		else if (tempAddress >= 0xFFFE0000L && tempAddress < 0xFFFE0200L) {
 			// Cache Control Register
 			if (tempAddress >= 0xFFFE0130L && tempAddress < 0xFFFE0134L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->cacheControlReg,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->cacheControlReg,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->cacheControlReg,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->cacheControlReg;
-						break;
-				}
+				retVal = (int8_t)SystemInterlink_readRegisterByte(smi,
+						address);
 			}
 		}
 	}
@@ -1248,6 +779,47 @@ int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address)
 	return retVal;
 }
 
+/*
+ * This reads a halfword from the correct area depending on the address.
+ */
+int32_t SystemInterlink_readHalfWord(SystemInterlink *smi, int32_t address)
+{
+	int64_t tempAddress = address & 0xFFFFFFFEL;
+	address = (int32_t)tempAddress;
+	int32_t retVal = 0;
+
+	// Handle RAM, ROM and scratchpad directly rather than going to readByte
+	if (tempAddress >= 0L && tempAddress < 0x200000L) {
+		retVal = read_le_halfword(&smi->ram[address]);
+	}
+	else if (tempAddress >= 0x1FC00000L && tempAddress < 0x1FC80000L) {
+		retVal = read_le_halfword(&smi->bios[address - 0x1FC00000]);
+	}
+	else if (tempAddress >= 0x1F800000L && tempAddress < 0x1F800400L) {
+		if (SystemInterlink_scratchpadEnabled(smi))
+			retVal = read_le_halfword(&smi->scratchpad[address - 0x1F800000]);
+	} // Handle everything else
+	else {
+		// Bring peripherals up to date before touching their registers
+		SystemInterlink_syncPeripherals(smi);
+
+		if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+			// Read I/O ports through whichever handler is registered
+			retVal = SystemInterlink_readIoPort(smi, PHILPSX_IO_HALFWORD,
+					address) & 0xFFFF;
+		} else {
+			// Use readByte method to read two bytes
+			retVal = SystemInterlink_readByte(
+					smi, (int32_t)tempAddress) & 0xFF;
+			++tempAddress;
+			retVal |= (SystemInterlink_readByte(
+					smi, (int32_t)tempAddress) & 0xFF) << 8;
+		}
+	}
+
+	return retVal;
+}
+
 /*
  * This function reads the interrupt status.
  */
@@ -1256,6 +828,14 @@ int32_t SystemInterlink_readInterruptStatus(SystemInterlink *smi)
 	return smi->interruptStatusReg;
 }
 
+/*
+ * This function returns the interrupt mask register.
+ */
+int32_t SystemInterlink_readInterruptMask(SystemInterlink *smi)
+{
+	return smi->interruptMaskReg;
+}
+
 /*
  * This reads a word from the correct area depending on the address.
  */
@@ -1267,242 +847,40 @@ int32_t SystemInterlink_readWord(SystemInterlink *smi, int32_t address)
 
 	// Handle RAM directly rather than going to readByte method
 	if (tempAddress >= 0L && tempAddress < 0x200000L) {
-		retVal = (smi->ram[address] & 0xFF) << 24 |
-				(smi->ram[address + 1] & 0xFF) << 16 |
-				(smi->ram[address + 2] & 0xFF) << 8 |
-				(smi->ram[address + 3] & 0xFF);
+		retVal = read_le_word(&smi->ram[address]);
 	} // Handle ROM directly rather than going to readByte method
 	else if (tempAddress >= 0x1FC00000L && tempAddress < 0x1FC80000L) {
-		address -= 0x1FC00000;
-		retVal = (smi->bios[address] & 0xFF) << 24 |
-				(smi->bios[address + 1] & 0xFF) << 16 |
-				(smi->bios[address + 2] & 0xFF) << 8 |
-				(smi->bios[address + 3] & 0xFF);
+		retVal = read_le_word(&smi->bios[address - 0x1FC00000]);
+	} // Handle scratchpad directly too, if enabled
+	else if (tempAddress >= 0x1F800000L && tempAddress < 0x1F800400L) {
+		if (SystemInterlink_scratchpadEnabled(smi))
+			retVal = read_le_word(&smi->scratchpad[address - 0x1F800000]);
 	} // Handle everything else
 	else {
-		switch (address) {
-			case 0x1F801070:
-				retVal = smi->interruptStatusReg;
-				break;
-			case 0x1F801074:
-				retVal = smi->interruptMaskReg;
-				break;
-			case 0xFFFE0130:
-				retVal = smi->cacheControlReg;
-				break;
-			case 0x1F801080:
-			case 0x1F801081:
-			case 0x1F801082:
-			case 0x1F801083:
-			case 0x1F801084:
-			case 0x1F801085:
-			case 0x1F801086:
-			case 0x1F801087:
-			case 0x1F801088:
-			case 0x1F801089:
-			case 0x1F80108A:
-			case 0x1F80108B:
-			case 0x1F80108C:
-			case 0x1F80108D:
-			case 0x1F80108E:
-			case 0x1F80108F:
-			case 0x1F801090:
-			case 0x1F801091:
-			case 0x1F801092:
-			case 0x1F801093:
-			case 0x1F801094:
-			case 0x1F801095:
-			case 0x1F801096:
-			case 0x1F801097:
-			case 0x1F801098:
-			case 0x1F801099:
-			case 0x1F80109A:
-			case 0x1F80109B:
-			case 0x1F80109C:
-			case 0x1F80109D:
-			case 0x1F80109E:
-			case 0x1F80109F:
-			case 0x1F8010A0:
-			case 0x1F8010A1:
-			case 0x1F8010A2:
-			case 0x1F8010A3:
-			case 0x1F8010A4:
-			case 0x1F8010A5:
-			case 0x1F8010A6:
-			case 0x1F8010A7:
-			case 0x1F8010A8:
-			case 0x1F8010A9:
-			case 0x1F8010AA:
-			case 0x1F8010AB:
-			case 0x1F8010AC:
-			case 0x1F8010AD:
-			case 0x1F8010AE:
-			case 0x1F8010AF:
-			case 0x1F8010B0:
-			case 0x1F8010B1:
-			case 0x1F8010B2:
-			case 0x1F8010B3:
-			case 0x1F8010B4:
-			case 0x1F8010B5:
-			case 0x1F8010B6:
-			case 0x1F8010B7:
-			case 0x1F8010B8:
-			case 0x1F8010B9:
-			case 0x1F8010BA:
-			case 0x1F8010BB:
-			case 0x1F8010BC:
-			case 0x1F8010BD:
-			case 0x1F8010BE:
-			case 0x1F8010BF:
-			case 0x1F8010C0:
-			case 0x1F8010C1:
-			case 0x1F8010C2:
-			case 0x1F8010C3:
-			case 0x1F8010C4:
-			case 0x1F8010C5:
-			case 0x1F8010C6:
-			case 0x1F8010C7:
-			case 0x1F8010C8:
-			case 0x1F8010C9:
-			case 0x1F8010CA:
-			case 0x1F8010CB:
-			case 0x1F8010CC:
-			case 0x1F8010CD:
-			case 0x1F8010CE:
-			case 0x1F8010CF:
-			case 0x1F8010D0:
-			case 0x1F8010D1:
-			case 0x1F8010D2:
-			case 0x1F8010D3:
-			case 0x1F8010D4:
-			case 0x1F8010D5:
-			case 0x1F8010D6:
-			case 0x1F8010D7:
-			case 0x1F8010D8:
-			case 0x1F8010D9:
-			case 0x1F8010DA:
-			case 0x1F8010DB:
-			case 0x1F8010DC:
-			case 0x1F8010DD:
-			case 0x1F8010DE:
-			case 0x1F8010DF:
-			case 0x1F8010E0:
-			case 0x1F8010E1:
-			case 0x1F8010E2:
-			case 0x1F8010E3:
-			case 0x1F8010E4:
-			case 0x1F8010E5:
-			case 0x1F8010E6:
-			case 0x1F8010E7:
-			case 0x1F8010E8:
-			case 0x1F8010E9:
-			case 0x1F8010EA:
-			case 0x1F8010EB:
-			case 0x1F8010EC:
-			case 0x1F8010ED:
-			case 0x1F8010EE:
-			case 0x1F8010EF:
-			case 0x1F8010F0:
-			case 0x1F8010F1:
-			case 0x1F8010F2:
-			case 0x1F8010F3:
-			case 0x1F8010F4:
-			case 0x1F8010F5:
-			case 0x1F8010F6:
-			case 0x1F8010F7:
-			case 0x1F8010F8:
-			case 0x1F8010F9:
-			case 0x1F8010FA:
-			case 0x1F8010FB:
-			case 0x1F8010FC:
-			case 0x1F8010FD:
-			case 0x1F8010FE:
-			case 0x1F8010FF:
-				retVal = DMAArbiter_readWord(smi->dma, address);
-				break;
-			case 0x1F801100:
-				retVal = TimerModule_readCounterValue(&smi->timerModule, 0);
-				break;
-			case 0x1F801104:
-				retVal = TimerModule_readMode(&smi->timerModule, 0, false);
-				break;
-			case 0x1F801108:
-				retVal = TimerModule_readTargetValue(&smi->timerModule, 0);
-				break;
-			case 0x1F801110:
-				retVal = TimerModule_readCounterValue(&smi->timerModule, 1);
-				break;
-			case 0x1F801114:
-				retVal = TimerModule_readMode(&smi->timerModule, 1, false);
-				break;
-			case 0x1F801118:
-				retVal = TimerModule_readTargetValue(&smi->timerModule, 1);
-				break;
-			case 0x1F801120:
-				retVal = TimerModule_readCounterValue(&smi->timerModule, 2);
-				break;
-			case 0x1F801124:
-				retVal = TimerModule_readMode(&smi->timerModule, 2, false);
-				break;
-			case 0x1F801128:
-				retVal = TimerModule_readTargetValue(&smi->timerModule, 2);
-				break;
-			case 0x1F801000:
-				retVal = smi->expansion1BaseAddress;
-				break;
-			case 0x1F801004:
-				retVal = smi->expansion2BaseAddress;
-				break;
-			case 0x1F801008:
-				retVal = smi->expansion1DelaySize;
-				break;
-			case 0x1F80100C:
-				retVal = smi->expansion3DelaySize;
-				break;
-			case 0x1F801010:
-				retVal = smi->biosRomDelaySize;
-				break;
-			case 0x1F801014:
-				retVal = smi->spuDelaySize;
-				break;
-			case 0x1F801018:
-				retVal = smi->cdromDelaySize;
-				break;
-			case 0x1F80101C:
-				retVal = smi->expansion2DelaySize;
-				break;
-			case 0x1F801020:
-				retVal = smi->commonDelay;
-				break;
-			case 0x1F801060:
-				retVal = smi->ramSize;
-				break;
-			case 0x1F801810:
-				retVal = GPU_readResponse(smi->gpu);
-				break;
-			case 0x1F801814:
-				retVal = GPU_readStatus(smi->gpu);
-				break;
-			case 0x1F801800:
-			case 0x1F801801:
-			case 0x1F801802:
-			case 0x1F801803:
-				// Do nothing as we don't allow word reads from CD-ROM range
-				break;
-			default:
-				// Use readByte method to read four bytes
-				retVal = (SystemInterlink_readByte(
-						smi, (int32_t)tempAddress) & 0xFF) << 24;
-				++tempAddress;
-				retVal |= (SystemInterlink_readByte(
-						smi, (int32_t)tempAddress) & 0xFF) << 16;
-				++tempAddress;
-				retVal |= (SystemInterlink_readByte(
-						smi, (int32_t)tempAddress) & 0xFF) << 8;
-				++tempAddress;
-				retVal |= SystemInterlink_readByte(
-						smi, (int32_t)tempAddress) & 0xFF;
-				break;
+		// Bring peripherals up to date before touching their registers
+		SystemInterlink_syncPeripherals(smi);
+
+		if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+			// Read I/O ports through whichever handler is registered
+			retVal = SystemInterlink_readIoPort(smi, PHILPSX_IO_WORD,
+					address);
+		}
+		else if (tempAddress == 0xFFFE0130L) {
+			// Read cache control register
+			retVal = SystemInterlink_readRegisterWord(smi, address);
+		} else {
+			// Use readByte method to read four bytes
+			retVal = SystemInterlink_readByte(
+					smi, (int32_t)tempAddress) & 0xFF;
+			++tempAddress;
+			retVal |= (SystemInterlink_readByte(
+					smi, (int32_t)tempAddress) & 0xFF) << 8;
+			++tempAddress;
+			retVal |= (SystemInterlink_readByte(
+					smi, (int32_t)tempAddress) & 0xFF) << 16;
+			++tempAddress;
+			retVal |= (SystemInterlink_readByte(
+					smi, (int32_t)tempAddress) & 0xFF) << 24;
 		}
 	}
 
@@ -1510,11 +888,101 @@ int32_t SystemInterlink_readWord(SystemInterlink *smi, int32_t address)
 }
 
 /*
- * This function syncs all timers up to the current point.
+ * This function installs handlers for a component's window of I/O ports at
+ * the specified access width. Windows are tracked at 4-byte granularity, and
+ * a component registering the same window again for another width shares
+ * the existing entry.
+ */
+void SystemInterlink_registerIoHandlers(SystemInterlink *smi, int32_t address,
+		int32_t length, int32_t width, void *component,
+		SystemInterlinkReadHandler readHandler,
+		SystemInterlinkWriteHandler writeHandler)
+{
+	// Make sure the window lies within the I/O port region
+	int64_t tempAddress = address & 0xFFFFFFFFL;
+	if (tempAddress < 0x1F801000L || length <= 0 ||
+			tempAddress + length > 0x1F802000L) {
+		fprintf(stderr, "PhilPSX: SystemInterlink: Can't register I/O "
+				"handlers outside of I/O port region\n");
+		return;
+	}
+
+	// Work out which slots the window covers
+	int32_t firstSlot = (address - PHILPSX_IO_PORT_BASE) >>
+			PHILPSX_IO_PORT_SLOT_SHIFT;
+	int32_t lastSlot = (address + length - 1 - PHILPSX_IO_PORT_BASE) >>
+			PHILPSX_IO_PORT_SLOT_SHIFT;
+
+	// Claim a new window unless this component already owns these slots
+	int32_t window = smi->ioPortSlots[firstSlot];
+	if (window == 0 || smi->ioWindows[window].component != component) {
+		if (smi->ioWindowCount == PHILPSX_IO_PORT_MAX_WINDOWS) {
+			fprintf(stderr, "PhilPSX: SystemInterlink: Too many I/O "
+					"windows registered\n");
+			return;
+		}
+		window = smi->ioWindowCount++;
+		smi->ioWindows[window].component = component;
+		for (int32_t slot = firstSlot; slot <= lastSlot; ++slot)
+			smi->ioPortSlots[slot] = (uint8_t)window;
+	}
+
+	// Install handlers
+	smi->ioWindows[window].readHandlers[width] = readHandler;
+	smi->ioWindows[window].writeHandlers[width] = writeHandler;
+}
+
+/*
+ * This function writes the interlink's state to a save state - RAM and
+ * scratchpad, the timers, registers and the event scheduler. The BIOS and
+ * the tables set up at construction aren't included.
  */
-void SystemInterlink_resyncAllTimers(SystemInterlink *smi)
+void SystemInterlink_saveState(SystemInterlink *smi, SaveState *state)
 {
-	TimerModule_resync(&smi->timerModule);
+	// RAM and scratchpad
+	SaveState_write(state, smi->ram, 0x200000);
+	SaveState_write(state, smi->scratchpad, 1024);
+
+	// Timers
+	TimerModule *tm = &smi->timerModule;
+	SaveState_write(state, tm->timerMode, sizeof(tm->timerMode));
+	SaveState_write(state, tm->timerCounterValue,
+			sizeof(tm->timerCounterValue));
+	SaveState_write(state, tm->timerTargetValue,
+			sizeof(tm->timerTargetValue));
+	SaveState_write(state, tm->interruptHappenedOnceOrMore,
+			sizeof(tm->interruptHappenedOnceOrMore));
+	SaveState_write(state, tm->blankHappened, sizeof(tm->blankHappened));
+	SaveState_write(state, tm->baseValue, sizeof(tm->baseValue));
+	SaveState_write(state, tm->baseCycles, sizeof(tm->baseCycles));
+	SaveState_write(state, tm->periodCycles, sizeof(tm->periodCycles));
+	SaveState_write(state, tm->periodIncrements,
+			sizeof(tm->periodIncrements));
+
+	// Registers
+	SaveState_write(state, &smi->cacheControlReg, sizeof(int32_t));
+	SaveState_write(state, &smi->interruptStatusReg, sizeof(int32_t));
+	SaveState_write(state, &smi->interruptMaskReg, sizeof(int32_t));
+	SaveState_write(state, &smi->expansion1BaseAddress, sizeof(int32_t));
+	SaveState_write(state, &smi->expansion2BaseAddress, sizeof(int32_t));
+	SaveState_write(state, &smi->expansion1DelaySize, sizeof(int32_t));
+	SaveState_write(state, &smi->expansion3DelaySize, sizeof(int32_t));
+	SaveState_write(state, &smi->biosRomDelaySize, sizeof(int32_t));
+	SaveState_write(state, &smi->spuDelaySize, sizeof(int32_t));
+	SaveState_write(state, &smi->cdromDelaySize, sizeof(int32_t));
+	SaveState_write(state, &smi->expansion2DelaySize, sizeof(int32_t));
+	SaveState_write(state, &smi->commonDelay, sizeof(int32_t));
+	SaveState_write(state, &smi->ramSize, sizeof(int32_t));
+	SaveState_write(state, &smi->biosPost, sizeof(int8_t));
+
+	// Scheduler, along with the cycle counts it works from
+	SaveState_write(state, &smi->scheduler, sizeof(Scheduler));
+	SaveState_write(state, &smi->systemCycles, sizeof(int64_t));
+	SaveState_write(state, &smi->syncedCycles, sizeof(int64_t));
+
+	// CD-ROM interrupt details
+	SaveState_write(state, &smi->cdromInterruptNumber, sizeof(int32_t));
+	SaveState_write(state, &smi->cdromInterruptEnabled, sizeof(bool));
 }
 
 /*
@@ -1522,23 +990,49 @@ void SystemInterlink_resyncAllTimers(SystemInterlink *smi)
  */
 bool SystemInterlink_scratchpadEnabled(SystemInterlink *smi)
 {
-	// Swap endianness of reg
-	int32_t tempReg = ((smi->cacheControlReg << 24) & 0xFF000000) |
-			((smi->cacheControlReg << 8) & 0xFF0000) |
-			(logical_rshift(smi->cacheControlReg, 8) & 0xFF00) |
-			(logical_rshift(smi->cacheControlReg, 24) & 0xFF);
+	return (smi->cacheControlReg & 0x88) == 0x88;
+}
 
-	return ((tempReg & 0x88) == 0x88);
+/*
+ * This function moves the system cycle count on by as many whole iterations
+ * of an idle loop as will fit before the next event is due, returning the
+ * number of cycles skipped. The iteration the event falls due in is left
+ * for the CPU to run.
+ */
+int64_t SystemInterlink_skipToNextEvent(SystemInterlink *smi,
+		int64_t cyclesPerIteration)
+{
+	int64_t cyclesLeft =
+			Scheduler_getNextDeadline(&smi->scheduler) - smi->systemCycles;
+	if (cyclesLeft <= 0 || cyclesPerIteration <= 0)
+		return 0;
+
+	int64_t skippedCycles =
+			(cyclesLeft - 1) / cyclesPerIteration * cyclesPerIteration;
+	smi->systemCycles += skippedCycles;
+	return skippedCycles;
 }
 
 /*
- * This sets the CD-ROM interrupt delay.
+ * This sets the CD-ROM interrupt delay. The interrupt fires once more than
+ * the specified number of cycles have passed.
  */
 void SystemInterlink_setCDROMInterruptDelay(SystemInterlink *smi,
 		int32_t delay)
 {
-	smi->cdromInterruptDelay = delay;
-	smi->cdromInterruptCounter = 0;
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_CDROM_INTERRUPT,
+			delay + 1L);
+}
+
+/*
+ * This sets the delay until the CD-ROM drive moves on to the next sector by
+ * itself, for sectors it reads without raising an interrupt. The drive is
+ * called once more than the specified number of cycles have passed.
+ */
+void SystemInterlink_setCDROMSectorDelay(SystemInterlink *smi, int32_t delay)
+{
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_CDROM_SECTOR,
+			delay + 1L);
 }
 
 /*
@@ -1586,12 +1080,25 @@ void SystemInterlink_setCpu(SystemInterlink *smi, R3051 *cpu)
 }
 
 /*
- * This sets the DMA interrupt delay.
+ * This sets the delay until the DMA transfer in progress finishes. The
+ * transfer finishes once more than the specified number of cycles have
+ * passed.
+ */
+void SystemInterlink_setDMACompletionDelay(SystemInterlink *smi,
+		int32_t delay)
+{
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_DMA_COMPLETE,
+			delay + 1L);
+}
+
+/*
+ * This sets the DMA interrupt delay. The interrupt fires once more than
+ * the specified number of cycles have passed.
  */
 void SystemInterlink_setDMAInterruptDelay(SystemInterlink *smi, int32_t delay)
 {
-	smi->dmaInterruptDelay = delay;
-	smi->dmaInterruptCounter = 0;
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_DMA_INTERRUPT,
+			delay + 1L);
 }
 
 /*
@@ -1603,12 +1110,13 @@ void SystemInterlink_setDma(SystemInterlink *smi, DMAArbiter *dma)
 }
 
 /*
- * This sets the GPU interrupt delay.
+ * This sets the GPU interrupt delay. The interrupt fires once more than
+ * the specified number of cycles have passed.
  */
 void SystemInterlink_setGPUInterruptDelay(SystemInterlink *smi, int32_t delay)
 {
-	smi->gpuInterruptDelay = delay;
-	smi->gpuInterruptCounter = 0;
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_GPU_INTERRUPT,
+			delay + 1L);
 }
 
 /*
@@ -1619,6 +1127,37 @@ void SystemInterlink_setGpu(SystemInterlink *smi, GPU *gpu)
 	smi->gpu = gpu;
 }
 
+/*
+ * This sets the controller and memory card interrupt delay. The interrupt
+ * fires once more than the specified number of cycles have passed.
+ */
+void SystemInterlink_setSIOInterruptDelay(SystemInterlink *smi, int32_t delay)
+{
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_SIO_INTERRUPT,
+			delay + 1L);
+}
+
+/*
+ * This sets the delay until the byte being sent to the controllers and
+ * memory cards has been exchanged. The exchange finishes once more than the
+ * specified number of cycles have passed.
+ */
+void SystemInterlink_setSIOTransferDelay(SystemInterlink *smi, int32_t delay)
+{
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_SIO_TRANSFER,
+			delay + 1L);
+}
+
+/*
+ * This sets the SPU interrupt delay. The interrupt fires once more than
+ * the specified number of cycles have passed.
+ */
+void SystemInterlink_setSPUInterruptDelay(SystemInterlink *smi, int32_t delay)
+{
+	SystemInterlink_scheduleEvent(smi, PHILPSX_EVENT_SPU_INTERRUPT,
+			delay + 1L);
+}
+
 /*
  * This sets the SPU reference to that supplied by the argument.
  */
@@ -1632,13 +1171,7 @@ void SystemInterlink_setSpu(SystemInterlink *smi, SPU *spu)
  */
 bool SystemInterlink_tagTestEnabled(SystemInterlink *smi)
 {
-	// Swap endianness of reg
-	int32_t tempReg = ((smi->cacheControlReg << 24) & 0xFF000000) |
-			((smi->cacheControlReg << 8) & 0xFF0000) |
-			(logical_rshift(smi->cacheControlReg, 8) & 0xFF00) |
-			(logical_rshift(smi->cacheControlReg, 24) & 0xFF);
-
-	return ((tempReg & 0x4) == 0x4);
+	return (smi->cacheControlReg & 0x4) == 0x4;
 }
 
 /*
@@ -1652,6 +1185,9 @@ void SystemInterlink_writeByte(SystemInterlink *smi, int32_t address,
 	// RAM
 	if (tempAddress >= 0L && tempAddress < 0x200000L) {
 		smi->ram[(int32_t)tempAddress] = value;
+		if (smi->codePages[tempAddress >> 17] &
+				(1U << ((tempAddress >> 12) & 0x1F)))
+			SystemInterlink_invalidateCode(smi, address, 1);
 	} // Expansion Region 1
 	else if (tempAddress >= 0x1F000000L && tempAddress < 0x1F800000L) {
 		// Do nothing for now
@@ -1665,390 +1201,15 @@ void SystemInterlink_writeByte(SystemInterlink *smi, int32_t address,
 		}
 	} // I/O Ports
 	else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
-		if (tempAddress >= 0x1F801000L && tempAddress < 0x1F801004L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion1BaseAddress = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion1BaseAddress =
-							(smi->expansion1BaseAddress & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801004L && tempAddress < 0x1F801008L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion2BaseAddress = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion2BaseAddress =
-							(smi->expansion2BaseAddress & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801008L && tempAddress < 0x1F80100CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion1DelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion1DelaySize =
-							(smi->expansion1DelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F80100CL && tempAddress < 0x1F801010L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion3DelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion3DelaySize =
-							(smi->expansion3DelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801010L && tempAddress < 0x1F801014L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->biosRomDelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->biosRomDelaySize =
-							(smi->biosRomDelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801014L && tempAddress < 0x1F801018L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->spuDelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->spuDelaySize =
-							(smi->spuDelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801018L && tempAddress < 0x1F80101CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->cdromDelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->cdromDelaySize =
-							(smi->cdromDelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F80101CL && tempAddress < 0x1F801020L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion2DelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion2DelaySize =
-							(smi->expansion2DelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801020L && tempAddress < 0x1F801024L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->commonDelay = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->commonDelay =
-							(smi->commonDelay & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801040L && tempAddress < 0x1F801050L) {
-			// Write to ControllerIO object
-			ControllerIO_writeByte(smi->cio, (int32_t)tempAddress, value);
-		}
-		else if (tempAddress >= 0x1F801060L && tempAddress < 0x1F801064L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->ramSize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->ramSize =
-							(smi->ramSize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		} // Interrupt Status Register
-		else if (tempAddress >= 0x1F801070L && tempAddress < 0x1F801074L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					// Mask first byte
-					smi->interruptStatusReg &=
-							((value & 0xFF) << 24) |
-							(smi->interruptStatusReg & 0xFF0000);
-					break;
-				case 1:
-					// Mask second byte
-					smi->interruptStatusReg &=
-							(smi->interruptStatusReg & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		} // Interrupt Mask Register
-		else if (tempAddress >= 0x1F801074L && tempAddress < 0x1F801078L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					// Write full 32-bits, with zeroes for remaining
-					// three bytes
-					smi->interruptMaskReg = (value & 0xFF) << 24;
-					break;
-				case 1:
-					// Keep first byte of interrupt mask, merge with this
-					// one, and set last two to zeroes
-					smi->interruptMaskReg =
-							(smi->interruptMaskReg & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801080L && tempAddress < 0x1F801100L) {
-			DMAArbiter_writeByte(smi->dma, address, value);
-		}
-		else if (tempAddress >= 0x1F801100L && tempAddress < 0x1F801104L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							0,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							0,
-							(TimerModule_readCounterValue(&smi->timerModule, 0)
-							& 0xFF000000) | 
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801104L && tempAddress < 0x1F801108L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							0,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							0,
-							(TimerModule_readMode(&smi->timerModule, 0, true)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801108L && tempAddress < 0x1F80110CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							0,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							0,
-							(TimerModule_readTargetValue(&smi->timerModule, 0)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801110L && tempAddress < 0x1F801114L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							1,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							1,
-							(TimerModule_readCounterValue(&smi->timerModule, 1)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801114L && tempAddress < 0x1F801118L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							1,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							1,
-							(TimerModule_readMode(&smi->timerModule, 1, true)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801118L && tempAddress < 0x1F80111CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							1,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							1,
-							(TimerModule_readTargetValue(&smi->timerModule, 1)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801120L && tempAddress < 0x1F801124L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							2,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							2,
-							(TimerModule_readCounterValue(&smi->timerModule, 2)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801124L && tempAddress < 0x1F801128L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							2,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							2,
-							(TimerModule_readMode(&smi->timerModule, 2, true)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801128L && tempAddress < 0x1F80112CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							2,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							2,
-							(TimerModule_readTargetValue(&smi->timerModule, 2)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		} // CD-ROM
-		else if (tempAddress >= 0x1F801800L && tempAddress < 0x1F801804L) {
-			switch ((int32_t)tempAddress & 0xF) {
-				case 0:
-					CDROMDrive_write1800(smi->cdrom, value);
-					break;
-				case 1:
-					CDROMDrive_write1801(smi->cdrom, value);
-					break;
-				case 2:
-					CDROMDrive_write1802(smi->cdrom, value);
-					break;
-				case 3:
-					CDROMDrive_write1803(smi->cdrom, value);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801C00L && tempAddress < 0x1F802000L) {
-			// Fake SPU write
-			SPU_writeByte(smi->spu, address, value);
-		}
-	} // Expansion Region 2 (I/O Ports)
-	else if (tempAddress >= 0x1F802000L && tempAddress < 0x1F803000L) {
-		if (tempAddress == 0x1F802041L) {
-			smi->biosPost = value;
+		// Bring peripherals up to date before touching their registers
+		SystemInterlink_syncPeripherals(smi);
+
+		// Write through whichever handler is registered for the port
+		SystemInterlink_writeIoPort(smi, PHILPSX_IO_BYTE, address, value);
+	} // Expansion Region 2 (I/O Ports)
+	else if (tempAddress >= 0x1F802000L && tempAddress < 0x1F803000L) {
+		if (tempAddress == 0x1F802041L) {
+			smi->biosPost = value;
 		}
 	} // Expansion Region 3 (Multipurpose)
 	else if (tempAddress >= 0x1FA00000L && tempAddress < 0x1FC00000L) {
@@ -2062,21 +1223,52 @@ void SystemInterlink_writeByte(SystemInterlink *smi, int32_t address,
 	else if (tempAddress >= 0xFFFE0000L && tempAddress < 0xFFFE0200L) {
 		// Cache Control Register
 		if (tempAddress >= 0xFFFE0130L && tempAddress < 0xFFFE0134L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					// Write full 32-bits, with zeroes for remaining
-					// three bytes
-					smi->cacheControlReg = (value & 0xFF) << 24;
-					break;
-				case 1:
-					// Keep first byte of cache control, merge with this
-					// one, and set last two to zeroes
-					smi->cacheControlReg =
-							(smi->cacheControlReg & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
+			SystemInterlink_writeRegisterByte(smi, address, value);
+		}
+	}
+}
+
+/*
+ * This writes a halfword to the correct area depending on the address.
+ */
+void SystemInterlink_writeHalfWord(SystemInterlink *smi, int32_t address,
+		int32_t halfWord)
+{
+	int64_t tempAddress = address & 0xFFFFFFFE;
+	address = (int32_t)tempAddress;
+
+	// Handle RAM and scratchpad directly rather than going to writeByte
+	if (tempAddress >= 0L && tempAddress < 0x200000L) {
+		write_le_halfword(&smi->ram[address], halfWord);
+		if (smi->codePages[address >> 17] & (1U << ((address >> 12) & 0x1F)))
+			SystemInterlink_invalidateCode(smi, address, 2);
+	}
+	else if (tempAddress >= 0x1F800000L && tempAddress < 0x1F800400L) {
+		if (SystemInterlink_scratchpadEnabled(smi))
+			write_le_halfword(&smi->scratchpad[address - 0x1F800000],
+					halfWord);
+	} // Everything else
+	else {
+		// Bring peripherals up to date before touching their registers
+		SystemInterlink_syncPeripherals(smi);
+
+		if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+			// Write I/O ports through whichever handler is registered
+			SystemInterlink_writeIoPort(smi, PHILPSX_IO_HALFWORD, address,
+					halfWord);
+		} else {
+			// Use writeByte to write two bytes
+			SystemInterlink_writeByte(
+					smi,
+					(int32_t)tempAddress,
+					(int8_t)halfWord
+					);
+			++tempAddress;
+			SystemInterlink_writeByte(
+					smi,
+					(int32_t)tempAddress,
+					(int8_t)logical_rshift(halfWord, 8)
+					);
 		}
 	}
 }
@@ -2088,6 +1280,7 @@ void SystemInterlink_writeInterruptStatus(SystemInterlink *smi,
 		int32_t interruptStatus)
 {
 	smi->interruptStatusReg = interruptStatus;
+	SystemInterlink_updateIrqLine(smi);
 }
 
 /*
@@ -2101,250 +1294,106 @@ void SystemInterlink_writeWord(SystemInterlink *smi, int32_t address,
 
 	// Handle RAM specially due to its frequent use
 	if (tempAddress >= 0L && tempAddress < 0x200000L) {
-		smi->ram[address] = (int8_t)logical_rshift(word, 24);
-		smi->ram[address + 1] = (int8_t)logical_rshift(word, 16);
-		smi->ram[address + 2] = (int8_t)logical_rshift(word, 8);
-		smi->ram[address + 3] = (int8_t)word;
+		write_le_word(&smi->ram[address], word);
+		if (smi->codePages[address >> 17] & (1U << ((address >> 12) & 0x1F)))
+			SystemInterlink_invalidateCode(smi, address, 4);
+	} // Scratchpad, if enabled
+	else if (tempAddress >= 0x1F800000L && tempAddress < 0x1F800400L) {
+		if (SystemInterlink_scratchpadEnabled(smi))
+			write_le_word(&smi->scratchpad[address - 0x1F800000], word);
 	} // Everything else
 	else {
-		switch (address) {
-			case 0x1F801070:
-				// Mask interrupt bits
-				smi->interruptStatusReg &= word;
-				break;
-			case 0x1F801074:
-				smi->interruptMaskReg = word;
-				break;
-			case 0xFFFE0130:
-				smi->cacheControlReg = word;
-				break;
-			case 0x1F801080:
-			case 0x1F801081:
-			case 0x1F801082:
-			case 0x1F801083:
-			case 0x1F801084:
-			case 0x1F801085:
-			case 0x1F801086:
-			case 0x1F801087:
-			case 0x1F801088:
-			case 0x1F801089:
-			case 0x1F80108A:
-			case 0x1F80108B:
-			case 0x1F80108C:
-			case 0x1F80108D:
-			case 0x1F80108E:
-			case 0x1F80108F:
-			case 0x1F801090:
-			case 0x1F801091:
-			case 0x1F801092:
-			case 0x1F801093:
-			case 0x1F801094:
-			case 0x1F801095:
-			case 0x1F801096:
-			case 0x1F801097:
-			case 0x1F801098:
-			case 0x1F801099:
-			case 0x1F80109A:
-			case 0x1F80109B:
-			case 0x1F80109C:
-			case 0x1F80109D:
-			case 0x1F80109E:
-			case 0x1F80109F:
-			case 0x1F8010A0:
-			case 0x1F8010A1:
-			case 0x1F8010A2:
-			case 0x1F8010A3:
-			case 0x1F8010A4:
-			case 0x1F8010A5:
-			case 0x1F8010A6:
-			case 0x1F8010A7:
-			case 0x1F8010A8:
-			case 0x1F8010A9:
-			case 0x1F8010AA:
-			case 0x1F8010AB:
-			case 0x1F8010AC:
-			case 0x1F8010AD:
-			case 0x1F8010AE:
-			case 0x1F8010AF:
-			case 0x1F8010B0:
-			case 0x1F8010B1:
-			case 0x1F8010B2:
-			case 0x1F8010B3:
-			case 0x1F8010B4:
-			case 0x1F8010B5:
-			case 0x1F8010B6:
-			case 0x1F8010B7:
-			case 0x1F8010B8:
-			case 0x1F8010B9:
-			case 0x1F8010BA:
-			case 0x1F8010BB:
-			case 0x1F8010BC:
-			case 0x1F8010BD:
-			case 0x1F8010BE:
-			case 0x1F8010BF:
-			case 0x1F8010C0:
-			case 0x1F8010C1:
-			case 0x1F8010C2:
-			case 0x1F8010C3:
-			case 0x1F8010C4:
-			case 0x1F8010C5:
-			case 0x1F8010C6:
-			case 0x1F8010C7:
-			case 0x1F8010C8:
-			case 0x1F8010C9:
-			case 0x1F8010CA:
-			case 0x1F8010CB:
-			case 0x1F8010CC:
-			case 0x1F8010CD:
-			case 0x1F8010CE:
-			case 0x1F8010CF:
-			case 0x1F8010D0:
-			case 0x1F8010D1:
-			case 0x1F8010D2:
-			case 0x1F8010D3:
-			case 0x1F8010D4:
-			case 0x1F8010D5:
-			case 0x1F8010D6:
-			case 0x1F8010D7:
-			case 0x1F8010D8:
-			case 0x1F8010D9:
-			case 0x1F8010DA:
-			case 0x1F8010DB:
-			case 0x1F8010DC:
-			case 0x1F8010DD:
-			case 0x1F8010DE:
-			case 0x1F8010DF:
-			case 0x1F8010E0:
-			case 0x1F8010E1:
-			case 0x1F8010E2:
-			case 0x1F8010E3:
-			case 0x1F8010E4:
-			case 0x1F8010E5:
-			case 0x1F8010E6:
-			case 0x1F8010E7:
-			case 0x1F8010E8:
-			case 0x1F8010E9:
-			case 0x1F8010EA:
-			case 0x1F8010EB:
-			case 0x1F8010EC:
-			case 0x1F8010ED:
-			case 0x1F8010EE:
-			case 0x1F8010EF:
-			case 0x1F8010F0:
-			case 0x1F8010F1:
-			case 0x1F8010F2:
-			case 0x1F8010F3:
-			case 0x1F8010F4:
-			case 0x1F8010F5:
-			case 0x1F8010F6:
-			case 0x1F8010F7:
-			case 0x1F8010F8:
-			case 0x1F8010F9:
-			case 0x1F8010FA:
-			case 0x1F8010FB:
-			case 0x1F8010FC:
-			case 0x1F8010FD:
-			case 0x1F8010FE:
-			case 0x1F8010FF:
-				DMAArbiter_writeWord(smi->dma, address, word);
-				break;
-			case 0x1F801100:
-				TimerModule_writeCounterValue(&smi->timerModule, 0, word);
-				break;
-			case 0x1F801104:
-				TimerModule_writeMode(&smi->timerModule, 0, word);
-				break;
-			case 0x1F801108:
-				TimerModule_writeTargetValue(&smi->timerModule, 0, word);
-				break;
-			case 0x1F801110:
-				TimerModule_writeCounterValue(&smi->timerModule, 1, word);
-				break;
-			case 0x1F801114:
-				TimerModule_writeMode(&smi->timerModule, 1, word);
-				break;
-			case 0x1F801118:
-				TimerModule_writeTargetValue(&smi->timerModule, 1, word);
-				break;
-			case 0x1F801120:
-				TimerModule_writeCounterValue(&smi->timerModule, 2, word);
-				break;
-			case 0x1F801124:
-				TimerModule_writeMode(&smi->timerModule, 2, word);
-				break;
-			case 0x1F801128:
-				TimerModule_writeTargetValue(&smi->timerModule, 2, word);
-				break;
-			case 0x1F801000:
-				smi->expansion1BaseAddress = word;
-				break;
-			case 0x1F801004:
-				smi->expansion2BaseAddress = word;
-				break;
-			case 0x1F801008:
-				smi->expansion1DelaySize = word;
-				break;
-			case 0x1F80100C:
-				smi->expansion3DelaySize = word;
-				break;
-			case 0x1F801010:
-				smi->biosRomDelaySize = word;
-				break;
-			case 0x1F801014:
-				smi->spuDelaySize = word;
-				break;
-			case 0x1F801018:
-				smi->cdromDelaySize = word;
-				break;
-			case 0x1F80101C:
-				smi->expansion2DelaySize = word;
-				break;
-			case 0x1F801020:
-				smi->commonDelay = word;
-				break;
-			case 0x1F801060:
-				smi->ramSize = word;
-				break;
-			case 0x1F801810:
-				GPU_submitToGP0(smi->gpu, word);
-				break;
-			case 0x1F801814:
-				GPU_submitToGP1(smi->gpu, word);
-				break;
-			case 0x1F801800:
-			case 0x1F801801:
-			case 0x1F801802:
-			case 0x1F801803:
-				// Do nothing as we don't allow word writes to CDROM range
-				break;
-			default:
-				// Use writeByte to write four bytes
-				SystemInterlink_writeByte(
-						smi,
-						(int32_t)tempAddress,
-						(int8_t)logical_rshift(word, 24)
-						);
-				++tempAddress;
-				SystemInterlink_writeByte(
-						smi,
-						(int32_t)tempAddress,
-						(int8_t)logical_rshift(word, 16)
-						);
-				++tempAddress;
-				SystemInterlink_writeByte(
-						smi,
-						(int32_t)tempAddress,
-						(int8_t)logical_rshift(word, 8)
-						);
-				++tempAddress;
-				SystemInterlink_writeByte(
-						smi,
-						(int32_t)tempAddress,
-						(int8_t)word
-						);
-				break;
+		// Bring peripherals up to date before touching their registers
+		SystemInterlink_syncPeripherals(smi);
+
+		if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+			// Write I/O ports through whichever handler is registered
+			SystemInterlink_writeIoPort(smi, PHILPSX_IO_WORD, address, word);
 		}
+		else if (tempAddress == 0xFFFE0130L) {
+			// Write cache control register
+			SystemInterlink_writeRegisterWord(smi, address, word);
+		} else {
+			// Use writeByte to write four bytes
+			SystemInterlink_writeByte(
+					smi,
+					(int32_t)tempAddress,
+					(int8_t)word
+					);
+			++tempAddress;
+			SystemInterlink_writeByte(
+					smi,
+					(int32_t)tempAddress,
+					(int8_t)logical_rshift(word, 8)
+					);
+			++tempAddress;
+			SystemInterlink_writeByte(
+					smi,
+					(int32_t)tempAddress,
+					(int8_t)logical_rshift(word, 16)
+					);
+			++tempAddress;
+			SystemInterlink_writeByte(
+					smi,
+					(int32_t)tempAddress,
+					(int8_t)logical_rshift(word, 24)
+					);
+		}
+	}
+}
+
+/*
+ * This function returns the register held by the interlink itself that the
+ * specified address falls within.
+ */
+static int32_t *SystemInterlink_getRegister(SystemInterlink *smi,
+		int32_t address)
+{
+	int32_t *retVal = NULL;
+
+	switch (address & 0xFFFFFFFC) {
+		case 0x1F801000:
+			retVal = &smi->expansion1BaseAddress;
+			break;
+		case 0x1F801004:
+			retVal = &smi->expansion2BaseAddress;
+			break;
+		case 0x1F801008:
+			retVal = &smi->expansion1DelaySize;
+			break;
+		case 0x1F80100C:
+			retVal = &smi->expansion3DelaySize;
+			break;
+		case 0x1F801010:
+			retVal = &smi->biosRomDelaySize;
+			break;
+		case 0x1F801014:
+			retVal = &smi->spuDelaySize;
+			break;
+		case 0x1F801018:
+			retVal = &smi->cdromDelaySize;
+			break;
+		case 0x1F80101C:
+			retVal = &smi->expansion2DelaySize;
+			break;
+		case 0x1F801020:
+			retVal = &smi->commonDelay;
+			break;
+		case 0x1F801060:
+			retVal = &smi->ramSize;
+			break;
+		case 0x1F801070:
+			retVal = &smi->interruptStatusReg;
+			break;
+		case 0x1F801074:
+			retVal = &smi->interruptMaskReg;
+			break;
+		case 0xFFFE0130:
+			retVal = &smi->cacheControlReg;
+			break;
 	}
+
+	return retVal;
 }
 
 /*
@@ -2415,13 +1464,390 @@ static bool SystemInterlink_loadBiosFileToMemory(const char *biosPath,
 }
 
 /*
- * This tells the timer to add some cycles to the count it needs to sync by.
+ * This function reads from the I/O ports through the handler registered for
+ * the access width. Where there isn't one, the value is built from two reads
+ * of half the width instead, with unmapped bytes reading as zero.
+ */
+static int32_t SystemInterlink_readIoPort(SystemInterlink *smi, int32_t width,
+		int32_t address)
+{
+	// Use the registered handler if there is one
+	IoWindow *window = &smi->ioWindows[smi->ioPortSlots[
+			(address - PHILPSX_IO_PORT_BASE) >> PHILPSX_IO_PORT_SLOT_SHIFT]];
+	if (window->readHandlers[width]) {
+		PHILPSX_PERF_ADD(PHILPSX_PERF_MMIO +
+				PerfCounters_getMmioRegion(address), 1);
+		return window->readHandlers[width](window->component, address);
+	}
+	if (width == PHILPSX_IO_BYTE)
+		return 0;
+
+	// Otherwise combine two reads of half the width
+	int32_t halfWidth = width - 1;
+	int32_t halfBits = 8 << halfWidth;
+	uint32_t halfMask = (1U << halfBits) - 1;
+	uint32_t lowValue = (uint32_t)SystemInterlink_readIoPort(smi, halfWidth,
+			address) & halfMask;
+	uint32_t highValue = (uint32_t)SystemInterlink_readIoPort(smi, halfWidth,
+			address + (1 << halfWidth)) & halfMask;
+	return (int32_t)(lowValue | (highValue << halfBits));
+}
+
+/*
+ * This function handles byte reads from the registers held by the interlink.
+ */
+static int32_t SystemInterlink_readRegisterByte(void *component,
+		int32_t address)
+{
+	int32_t *reg = SystemInterlink_getRegister(component, address);
+	return (int8_t)logical_rshift(*reg, (address & 0x3) * 8);
+}
+
+/*
+ * This function handles halfword reads from the registers held by the
+ * interlink.
+ */
+static int32_t SystemInterlink_readRegisterHalfWord(void *component,
+		int32_t address)
+{
+	int32_t *reg = SystemInterlink_getRegister(component, address);
+	return logical_rshift(*reg, (address & 0x2) * 8) & 0xFFFF;
+}
+
+/*
+ * This function handles word reads from the registers held by the interlink.
+ */
+static int32_t SystemInterlink_readRegisterWord(void *component,
+		int32_t address)
+{
+	return *SystemInterlink_getRegister(component, address);
+}
+
+/*
+ * This function works out the stall cycles for each page of the physical
+ * address space from the memory control registers.
+ */
+static void SystemInterlink_rebuildStallTable(SystemInterlink *smi)
+{
+	// Set to 4 as this is the delay of most registers
+	memset(smi->stallTable, 4, sizeof(smi->stallTable));
+
+	// RAM
+	memset(smi->stallTable, 6, 0x200000 >> PHILPSX_STALL_PAGE_SHIFT);
+
+	// BIOS
+	memset(&smi->stallTable[0x1FC00000 >> PHILPSX_STALL_PAGE_SHIFT], 1,
+			0x80000 >> PHILPSX_STALL_PAGE_SHIFT);
+
+	// Cache control register, which is the only thing in its page
+	smi->stallTable[0xFFFE0130 >> PHILPSX_STALL_PAGE_SHIFT] = 1;
+}
+
+/*
+ * This function updates anything derived from the register held by the
+ * interlink at the specified address, after it has been written.
+ */
+static void SystemInterlink_registerWritten(SystemInterlink *smi,
+		int32_t address)
+{
+	// Rebuild stall table if this was a memory control register
+	if ((address & 0xFFFFFF80) == 0x1F801000 && (address & 0x70) != 0x70)
+		SystemInterlink_rebuildStallTable(smi);
+
+	// Check instruction cache enable bit if this was the cache control
+	// register
+	if ((address & 0xFFFFFFFC) == 0xFFFE0130)
+		smi->instructionCacheEnabled =
+				(smi->cacheControlReg & 0x800) == 0x800;
+
+	// Work out the interrupt line again if this was the interrupt status
+	// or mask register
+	if ((address & 0xFFFFFFF8) == 0x1F801070)
+		SystemInterlink_updateIrqLine(smi);
+}
+
+/*
+ * This function schedules an event to happen the specified number of cycles
+ * from now, replacing any existing deadline for it.
+ */
+static void SystemInterlink_scheduleEvent(SystemInterlink *smi,
+		int32_t event, int64_t delay)
+{
+	Scheduler_scheduleEvent(&smi->scheduler, event, smi->systemCycles + delay);
+}
+
+/*
+ * This function passes on the cycles executed since the last sync to the
+ * peripherals that count them.
+ */
+static void SystemInterlink_syncPeripherals(SystemInterlink *smi)
+{
+	int32_t cycles = (int32_t)(smi->systemCycles - smi->syncedCycles);
+	if (cycles == 0)
+		return;
+
+	GPU_appendSyncCycles(smi->gpu, cycles);
+	ControllerIO_appendSyncCycles(smi->cio, cycles);
+	SPU_appendSyncCycles(smi->spu, cycles);
+	smi->syncedCycles = smi->systemCycles;
+}
+
+/*
+ * This function works out whether the interrupt line to the CPU is
+ * asserted, from the interrupt status and mask registers.
  */
-static void TimerModule_appendSyncCycles(TimerModule *timerModule,
-		int32_t cycles)
+static void SystemInterlink_updateIrqLine(SystemInterlink *smi)
 {
-	for (int32_t i = 0; i < 3; ++i)
-		timerModule->cpuCyclesToSync[i] += cycles;
+	smi->irqLineAsserted =
+			(smi->interruptStatusReg & smi->interruptMaskReg & 0x7FF) != 0;
+}
+
+/*
+ * This function writes to the I/O ports through the handler registered for
+ * the access width. Where there isn't one, the value is split into two writes
+ * of half the width instead, with writes to unmapped bytes ignored.
+ */
+static void SystemInterlink_writeIoPort(SystemInterlink *smi, int32_t width,
+		int32_t address, int32_t value)
+{
+	// Use the registered handler if there is one
+	IoWindow *window = &smi->ioWindows[smi->ioPortSlots[
+			(address - PHILPSX_IO_PORT_BASE) >> PHILPSX_IO_PORT_SLOT_SHIFT]];
+	if (window->writeHandlers[width]) {
+		PHILPSX_PERF_ADD(PHILPSX_PERF_MMIO +
+				PerfCounters_getMmioRegion(address), 1);
+		window->writeHandlers[width](window->component, address, value);
+		return;
+	}
+	if (width == PHILPSX_IO_BYTE)
+		return;
+
+	// Otherwise split into two writes of half the width
+	int32_t halfWidth = width - 1;
+	int32_t halfBits = 8 << halfWidth;
+	SystemInterlink_writeIoPort(smi, halfWidth, address, value);
+	SystemInterlink_writeIoPort(smi, halfWidth, address + (1 << halfWidth),
+			logical_rshift(value, halfBits));
+}
+
+/*
+ * This function handles byte writes to the registers held by the interlink.
+ * Only the bottom two bytes of each can be written, with the first one
+ * clearing the second, and the interrupt status register only ever has bits
+ * cleared by writes.
+ */
+static void SystemInterlink_writeRegisterByte(void *component, int32_t address,
+		int32_t value)
+{
+	SystemInterlink *smi = component;
+	int32_t shift = address & 0x3;
+	if (shift > 1)
+		return;
+
+	// Merge byte with what is already there
+	int32_t *reg = SystemInterlink_getRegister(smi, address);
+	int32_t mergedValue = (shift == 0) ? value & 0xFF :
+			(*reg & 0xFF) | ((value & 0xFF) << 8);
+
+	if (reg == &smi->interruptStatusReg) {
+		if (shift == 0)
+			mergedValue |= *reg & 0xFF00;
+		*reg &= mergedValue;
+	} else {
+		*reg = mergedValue;
+	}
+
+	SystemInterlink_registerWritten(smi, address);
+}
+
+/*
+ * This function handles halfword writes to the registers held by the
+ * interlink. As with byte writes, only the bottom halfword of each can be
+ * written, and the interrupt status register only ever has bits cleared.
+ */
+static void SystemInterlink_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value)
+{
+	SystemInterlink *smi = component;
+	if ((address & 0x2) != 0)
+		return;
+
+	int32_t *reg = SystemInterlink_getRegister(smi, address);
+	if (reg == &smi->interruptStatusReg)
+		*reg &= value & 0xFFFF;
+	else
+		*reg = value & 0xFFFF;
+
+	SystemInterlink_registerWritten(smi, address);
+}
+
+/*
+ * This function handles word writes to the registers held by the interlink.
+ */
+static void SystemInterlink_writeRegisterWord(void *component, int32_t address,
+		int32_t value)
+{
+	SystemInterlink *smi = component;
+	int32_t *reg = SystemInterlink_getRegister(smi, address);
+
+	// Mask interrupt bits if writing the interrupt status register
+	if (reg == &smi->interruptStatusReg)
+		*reg &= value;
+	else
+		*reg = value;
+
+	SystemInterlink_registerWritten(smi, address);
+}
+
+/*
+ * This function removes an event from the scheduler if it is scheduled.
+ */
+static void Scheduler_cancelEvent(Scheduler *scheduler, int32_t event)
+{
+	int32_t position = scheduler->heapPositions[event];
+	if (position == -1)
+		return;
+
+	// Move the last event into the gap and restore heap order around it
+	Scheduler_swapEvents(scheduler, position, scheduler->heapSize - 1);
+	--scheduler->heapSize;
+	scheduler->heapPositions[event] = -1;
+	if (position < scheduler->heapSize) {
+		int32_t movedEvent = scheduler->heap[position];
+		Scheduler_siftUp(scheduler, position);
+		Scheduler_siftDown(scheduler, scheduler->heapPositions[movedEvent]);
+	}
+}
+
+/*
+ * This function returns the deadline of the earliest scheduled event, or the
+ * largest possible deadline if nothing is scheduled.
+ */
+static int64_t Scheduler_getNextDeadline(Scheduler *scheduler)
+{
+	if (scheduler->heapSize == 0)
+		return INT64_MAX;
+
+	return scheduler->deadlines[scheduler->heap[0]];
+}
+
+/*
+ * This function removes the earliest scheduled event and returns it.
+ */
+static int32_t Scheduler_popEvent(Scheduler *scheduler)
+{
+	int32_t event = scheduler->heap[0];
+	Scheduler_cancelEvent(scheduler, event);
+	return event;
+}
+
+/*
+ * This function schedules an event at the specified deadline, replacing any
+ * deadline it already had.
+ */
+static void Scheduler_scheduleEvent(Scheduler *scheduler, int32_t event,
+		int64_t deadline)
+{
+	// Add event to end of heap if it isn't scheduled already
+	int32_t position = scheduler->heapPositions[event];
+	if (position == -1) {
+		position = scheduler->heapSize++;
+		scheduler->heap[position] = event;
+		scheduler->heapPositions[event] = position;
+	}
+
+	// Set deadline and restore heap order
+	scheduler->deadlines[event] = deadline;
+	Scheduler_siftUp(scheduler, position);
+	Scheduler_siftDown(scheduler, scheduler->heapPositions[event]);
+}
+
+/*
+ * This function moves the event at the specified heap position down until
+ * neither of its children is due before it.
+ */
+static void Scheduler_siftDown(Scheduler *scheduler, int32_t position)
+{
+	while (true) {
+		int32_t earliest = position;
+		int32_t left = position * 2 + 1;
+		int32_t right = left + 1;
+
+		if (left < scheduler->heapSize &&
+				scheduler->deadlines[scheduler->heap[left]] <
+				scheduler->deadlines[scheduler->heap[earliest]])
+			earliest = left;
+		if (right < scheduler->heapSize &&
+				scheduler->deadlines[scheduler->heap[right]] <
+				scheduler->deadlines[scheduler->heap[earliest]])
+			earliest = right;
+		if (earliest == position)
+			break;
+
+		Scheduler_swapEvents(scheduler, position, earliest);
+		position = earliest;
+	}
+}
+
+/*
+ * This function moves the event at the specified heap position up until
+ * its parent is not due after it.
+ */
+static void Scheduler_siftUp(Scheduler *scheduler, int32_t position)
+{
+	while (position > 0) {
+		int32_t parent = (position - 1) / 2;
+		if (scheduler->deadlines[scheduler->heap[parent]] <=
+				scheduler->deadlines[scheduler->heap[position]])
+			break;
+
+		Scheduler_swapEvents(scheduler, position, parent);
+		position = parent;
+	}
+}
+
+/*
+ * This function swaps the events at two heap positions.
+ */
+static void Scheduler_swapEvents(Scheduler *scheduler, int32_t first,
+		int32_t second)
+{
+	int32_t firstEvent = scheduler->heap[first];
+	int32_t secondEvent = scheduler->heap[second];
+	scheduler->heap[first] = secondEvent;
+	scheduler->heap[second] = firstEvent;
+	scheduler->heapPositions[firstEvent] = second;
+	scheduler->heapPositions[secondEvent] = first;
+}
+
+/*
+ * This counts how many numbers in the range (from, to] are equal to value
+ * modulo period, which tells us how many times a counter hit that value.
+ */
+static int64_t TimerModule_countPasses(int64_t from, int64_t to,
+		int64_t value, int64_t period)
+{
+	int64_t toOffset = to - value;
+	int64_t fromOffset = from - value;
+
+	// Divide rounding towards negative infinity
+	int64_t toPasses = (toOffset >= 0) ?
+			toOffset / period : -((period - 1 - toOffset) / period);
+	int64_t fromPasses = (fromOffset >= 0) ?
+			fromOffset / period : -((period - 1 - fromOffset) / period);
+
+	return toPasses - fromPasses;
+}
+
+/*
+ * This tells us how many times the specified timer increments in the given
+ * number of CPU cycles from its base point.
+ */
+static int64_t TimerModule_getIncrements(TimerModule *timerModule,
+		int32_t timer, int64_t cycles)
+{
+	return cycles * timerModule->periodIncrements[timer] /
+			timerModule->periodCycles[timer];
 }
 
 /*
@@ -2431,14 +1857,14 @@ static int32_t TimerModule_readCounterValue(TimerModule *timerModule,
 		int32_t timer)
 {
 	// Catch up to current cycle count
-	TimerModule_resync(timerModule);
+	TimerModule_update(timerModule, timer);
 
 	// If in pulse mode, set bit 10 back to 1 now
 	if ((timerModule->timerMode[timer] & 0x80) == 0) {
 		timerModule->timerMode[timer] |= 0x400;
 	}
 
-	return TimerModule_swapEndianness(timerModule->timerCounterValue[timer]);
+	return timerModule->timerCounterValue[timer];
 }
 
 /*
@@ -2448,7 +1874,7 @@ static int32_t TimerModule_readMode(TimerModule *timerModule,
 		int32_t timer, bool override)
 {
 	// Catch up to current cycle count
-	TimerModule_resync(timerModule);
+	TimerModule_update(timerModule, timer);
 
 	// If in pulse mode, set bit 10 back to 1 now
 	if ((timerModule->timerMode[timer] & 0x80) == 0 && !override) {
@@ -2464,7 +1890,55 @@ static int32_t TimerModule_readMode(TimerModule *timerModule,
 		timerModule->timerMode[timer] &= 0xFFFFE7FF;
 	}
 
-	return TimerModule_swapEndianness(retVal);
+	return retVal;
+}
+
+/*
+ * This function handles byte reads from the timer registers.
+ */
+static int32_t TimerModule_readRegisterByte(void *component,
+		int32_t address)
+{
+	int32_t word = TimerModule_readRegisterWord(component,
+			address & 0xFFFFFFFC);
+	return (int8_t)logical_rshift(word, (address & 0x3) * 8);
+}
+
+/*
+ * This function handles halfword reads from the timer registers.
+ */
+static int32_t TimerModule_readRegisterHalfWord(void *component,
+		int32_t address)
+{
+	int32_t word = TimerModule_readRegisterWord(component,
+			address & 0xFFFFFFFC);
+	return logical_rshift(word, (address & 0x2) * 8) & 0xFFFF;
+}
+
+/*
+ * This function handles word reads from the timer registers, each timer
+ * having a counter, mode and target register in a 16-byte block.
+ */
+static int32_t TimerModule_readRegisterWord(void *component,
+		int32_t address)
+{
+	TimerModule *timerModule = component;
+	int32_t timer = (address >> 4) & 0xF;
+	int32_t retVal = 0;
+
+	switch (address & 0xC) {
+		case 0x0:
+			retVal = TimerModule_readCounterValue(timerModule, timer);
+			break;
+		case 0x4:
+			retVal = TimerModule_readMode(timerModule, timer, false);
+			break;
+		case 0x8:
+			retVal = TimerModule_readTargetValue(timerModule, timer);
+			break;
+	}
+
+	return retVal;
 }
 
 /*
@@ -2478,204 +1952,109 @@ static int32_t TimerModule_readTargetValue(TimerModule *timerModule,
 		timerModule->timerMode[timer] |= 0x400;
 	}
 
-	return TimerModule_swapEndianness(timerModule->timerTargetValue[timer]);
+	return timerModule->timerTargetValue[timer];
 }
 
 /*
- * Resync all timers to the current point.
+ * Set the specified timer's counter to a new value, counting on from there
+ * as of the current cycle count.
  */
-static void TimerModule_resync(TimerModule *timerModule)
+static void TimerModule_rebase(TimerModule *timerModule, int32_t timer,
+		int32_t value)
 {
-	// Get HBlank and VBlank status
-	bool hblank = GPU_isInHblank(timerModule->smi->gpu);
-	bool vblank = GPU_isInVblank(timerModule->smi->gpu);
-
-	if (hblank) {
-		timerModule->hblankHappened[0] = true;
-		timerModule->hblankHappened[1] = true;
-		timerModule->hblankHappened[2] = true;
-	}
-	if (vblank) {
-		timerModule->vblankHappened[0] = true;
-		timerModule->vblankHappened[1] = true;
-		timerModule->vblankHappened[2] = true;
-	}
-
-	// Convert sync figure to GPU cycles in case needed
-	for (int32_t i = 0; i < 3; ++i) {
-		timerModule->gpuCyclesToSync[i] +=
-				timerModule->cpuCyclesToSync[i] / 7.0f * 11.0f;
-
-		// Add in top up values
-		timerModule->cpuCyclesToSync[i] += timerModule->cpuTopup[i];
-		timerModule->gpuCyclesToSync[i] += timerModule->gpuTopup[i];
-	}
-
-	// Get clock source for all three timers
-	timerModule->clockSource[0] =
-			logical_rshift(timerModule->timerMode[0], 8) & 0x3;
-	timerModule->clockSource[1] =
-			logical_rshift(timerModule->timerMode[1], 8) & 0x3;
-	timerModule->clockSource[2] =
-			logical_rshift(timerModule->timerMode[2], 8) & 0x3;
-
-	// Calculate future topup values
-	timerModule->cpuTopup[0] = 0;
-	timerModule->gpuTopup[0] = (timerModule->clockSource[0] == 0 ||
-			timerModule->clockSource[0] == 2) ?
-			0 : GPU_howManyDotclockGpuCyclesLeft(timerModule->smi->gpu,
-			timerModule->gpuCyclesToSync[0]);
-	timerModule->cpuTopup[1] = 0;
-	timerModule->gpuTopup[1] = (timerModule->clockSource[1] == 0 ||
-			timerModule->clockSource[1] == 2) ?
-			0 : GPU_howManyHblankGpuCyclesLeft(timerModule->smi->gpu,
-			timerModule->gpuCyclesToSync[1]);
-	timerModule->cpuTopup[2] = (timerModule->clockSource[2] < 2) ?
-			0 : timerModule->cpuCyclesToSync[2] % 8;
-	timerModule->gpuTopup[2] = 0;
-
-	// Get increment count for all three timers
-	timerModule->incrementBy[0] = (timerModule->clockSource[0] == 0 ||
-			timerModule->clockSource[0] == 2) ?
-			timerModule->cpuCyclesToSync[0] :
-			GPU_howManyDotclockIncrements(timerModule->smi->gpu,
-			timerModule->gpuCyclesToSync[0]);
-	timerModule->incrementBy[1] = (timerModule->clockSource[1] == 0 ||
-			timerModule->clockSource[1] == 2) ?
-			timerModule->cpuCyclesToSync[1] :
-			GPU_howManyHblankIncrements(timerModule->smi->gpu,
-			timerModule->gpuCyclesToSync[1]);
-	timerModule->incrementBy[2] = (timerModule->clockSource[2] < 2) ?
-			timerModule->cpuCyclesToSync[2] :
-			timerModule->cpuCyclesToSync[2] / 8;
-
-	// Do increment to temporary value
-	timerModule->newValue[0] =
-			timerModule->timerCounterValue[0] + timerModule->incrementBy[0];
-	timerModule->newValue[1] =
-			timerModule->timerCounterValue[1] + timerModule->incrementBy[1];
-	timerModule->newValue[2] =
-			timerModule->timerCounterValue[2] + timerModule->incrementBy[2];
-
-	// Adjust as required by synchronisation mode
-	// Timer 0
-	switch (timerModule->timerMode[0] & 0x1) {
-		case 1:
-			switch (logical_rshift(timerModule->timerMode[0], 1) & 0x3) {
-				case 0:
-					if (hblank)
-						timerModule->newValue[0] =
-								timerModule->timerCounterValue[0];
-					break;
-				case 1:
-					if (hblank)
-						timerModule->newValue[0] = 0;
-					break;
-				case 2:
-					if (hblank)
-						timerModule->newValue[0] = 0;
-					else
-						timerModule->newValue[0] =
-								timerModule->timerCounterValue[0];
-					break;
-				case 3:
-					if (!timerModule->hblankHappened[0])
-						timerModule->newValue[0] =
-								timerModule->timerCounterValue[0];
-					break;
-			}
-			break;
-	}
+	timerModule->timerCounterValue[timer] = value;
+	timerModule->baseValue[timer] = value;
+	timerModule->baseCycles[timer] = timerModule->smi->systemCycles;
+}
 
-	// Timer 1
-	switch (timerModule->timerMode[1] & 0x1) {
-		case 1:
-			switch (logical_rshift(timerModule->timerMode[1], 1) & 0x3) {
-				case 0:
-					if (vblank)
-						timerModule->newValue[1] =
-								timerModule->timerCounterValue[1];
-					break;
-				case 1:
-					if (vblank)
-						timerModule->newValue[1] = 0;
-					break;
-				case 2:
-					if (vblank)
-						timerModule->newValue[1] = 0;
-					else
-						timerModule->newValue[1] =
-								timerModule->timerCounterValue[1];
-					break;
-				case 3:
-					if (!timerModule->vblankHappened[1])
-						timerModule->newValue[1] =
-								timerModule->timerCounterValue[1];
-					break;
-			}
-			break;
+/*
+ * Schedule the specified timer's event for the point it will next reach a
+ * value it can interrupt on, or sample blank status if it needs to.
+ */
+static void TimerModule_scheduleEvent(TimerModule *timerModule,
+		int32_t timer)
+{
+	SystemInterlink *smi = timerModule->smi;
+	int32_t mode = timerModule->timerMode[timer];
+	int32_t counter = timerModule->timerCounterValue[timer];
+	int32_t target = timerModule->timerTargetValue[timer];
+	int64_t wrapPeriod = ((mode & 0x8) == 0x8) ? target + 1 : 0x10000;
+	int64_t increments = -1;
+
+	// Find increments until target or overflow is next reached, if either
+	// of those can raise an interrupt
+	if (timerModule->periodIncrements[timer] != 0) {
+		if ((mode & 0x10) == 0x10) {
+			increments = (target - counter) % wrapPeriod;
+			if (increments <= 0)
+				increments += wrapPeriod;
+		}
+		if ((mode & 0x20) == 0x20 && wrapPeriod == 0x10000) {
+			int64_t overflowIncrements = (0xFFFF - counter) % wrapPeriod;
+			if (overflowIncrements <= 0)
+				overflowIncrements += wrapPeriod;
+			if (increments == -1 || overflowIncrements < increments)
+				increments = overflowIncrements;
+		}
 	}
 
-	// Timer 2
-	switch (timerModule->timerMode[2] & 0x1) {
-		case 1:
-			switch (logical_rshift(timerModule->timerMode[2], 1) & 0x3) {
-				case 0:
-				case 3:
-					timerModule->newValue[2] =
-							timerModule->timerCounterValue[2];
-					break;
-			}
-			break;
+	// Convert to a deadline, rounding up to the cycle the increment lands on
+	int64_t deadline = INT64_MAX;
+	if (increments != -1) {
+		int64_t totalIncrements = increments +
+				timerModule->timerCounterValue[timer] -
+				timerModule->baseValue[timer];
+		deadline = timerModule->baseCycles[timer] +
+				(totalIncrements * timerModule->periodCycles[timer] +
+				timerModule->periodIncrements[timer] - 1) /
+				timerModule->periodIncrements[timer];
 	}
 
-	timerModule->timerCounterValue[0] = timerModule->newValue[0];
-	timerModule->timerCounterValue[1] = timerModule->newValue[1];
-	timerModule->timerCounterValue[2] = timerModule->newValue[2];
-
-	// Deal with interrupts and target values
-	for (int32_t i = 0; i < 3; ++i) {
-		// Wipe cycles
-		timerModule->cpuCyclesToSync[i] = 0;
-		timerModule->gpuCyclesToSync[i] = 0;
-
-		// Check for interrupts
-		bool intFlag = false;
-		if (timerModule->timerCounterValue[i] >=
-				timerModule->timerTargetValue[i]) {
-			timerModule->timerMode[i] |= 0x800;
-			if ((timerModule->timerMode[i] & 0x10) == 0x10) {
-				intFlag = true;
-			}
-		}
-		if (timerModule->timerCounterValue[i] >= 0xFFFF) {
-			timerModule->timerMode[i] |= 0x1000;
-			if ((timerModule->timerMode[i] & 0x20) == 0x20) {
-				intFlag = true;
-			}
-		}
-		if (intFlag)
-			TimerModule_triggerTimerInterrupt(timerModule, i);
-
-		// Reset values here if needed
-		if (timerModule->timerCounterValue[i] > 0xFFFF &&
-				(timerModule->timerMode[i] & 0x8) == 0) {
-			timerModule->timerCounterValue[i] = 0;
-		} else if (timerModule->timerCounterValue[i] >
-				timerModule->timerTargetValue[i] &&
-				(timerModule->timerMode[i] & 0x8) == 0x8) {
-			timerModule->timerCounterValue[i] = 0;
-		}
-	}
+	// Timers 0 and 1 need HBlank and VBlank sampling regularly when
+	// synchronisation is enabled
+	if (timer < 2 && (mode & 0x1) == 0x1 &&
+			smi->systemCycles + PHILPSX_TIMER_SYNC_INTERVAL < deadline)
+		deadline = smi->systemCycles + PHILPSX_TIMER_SYNC_INTERVAL;
+
+	if (deadline == INT64_MAX)
+		Scheduler_cancelEvent(&smi->scheduler, PHILPSX_EVENT_TIMER0 + timer);
+	else
+		Scheduler_scheduleEvent(&smi->scheduler,
+				PHILPSX_EVENT_TIMER0 + timer, deadline);
 }
 
 /*
- * This swaps the endianness of an incoming or outgoing word.
+ * Work out how fast the specified timer counts from its clock source and
+ * synchronisation mode.
  */
-static int32_t TimerModule_swapEndianness(int32_t word)
+static void TimerModule_setClockRate(TimerModule *timerModule,
+		int32_t timer)
 {
-	return word << 24 | (word & 0xFF00) << 8 |
-			logical_rshift(word & 0xFF0000, 8) | logical_rshift(word, 24);
+	int32_t mode = timerModule->timerMode[timer];
+	int32_t clockSource = logical_rshift(mode, 8) & 0x3;
+	int32_t syncMode = logical_rshift(mode, 1) & 0x3;
+	GPU *gpu = timerModule->smi->gpu;
+
+	// Default to system clock, then check other sources - the GPU runs 11
+	// cycles for every 7 CPU cycles
+	timerModule->periodCycles[timer] = 1;
+	timerModule->periodIncrements[timer] = 1;
+	if (timer == 0 && (clockSource == 1 || clockSource == 3)) {
+		timerModule->periodCycles[timer] =
+				7 * GPU_howManyGpuCyclesPerDot(gpu);
+		timerModule->periodIncrements[timer] = 11;
+	} else if (timer == 1 && (clockSource == 1 || clockSource == 3)) {
+		timerModule->periodCycles[timer] =
+				7 * GPU_howManyGpuCyclesPerScanline(gpu);
+		timerModule->periodIncrements[timer] = 11;
+	} else if (timer == 2 && clockSource >= 2) {
+		timerModule->periodCycles[timer] = 8;
+	}
+
+	// Timer 2 stops counting altogether in some synchronisation modes
+	if (timer == 2 && (mode & 0x1) == 0x1 &&
+			(syncMode == 0 || syncMode == 3))
+		timerModule->periodIncrements[timer] = 0;
 }
 
 /*
@@ -2693,16 +2072,14 @@ static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 				// Just set bit 10 to 0 and be done with it,
 				// triggering IRQ as well
 				timerModule->timerMode[timer] &= 0xFFFFFBFF;
-				timerModule->smi->timersInterruptDelay[timer] = 0;
-				timerModule->smi->timersInterruptCounter[timer] = 0;
+				timerModule->smi->interruptStatusReg |= 0x10 << timer;
 				timerModule->interruptHappenedOnceOrMore[timer] = true;
 			} else {
 				// Invert flag, triggering IRQ if it is then 0
 				if ((timerModule->timerMode[timer] & 0x400) == 0x400) {
 					// Flip to 0 and trigger interrupt
 					timerModule->timerMode[timer] &= 0xFFFFFBFF;
-					timerModule->smi->timersInterruptDelay[timer] = 0;
-					timerModule->smi->timersInterruptCounter[timer] = 0;
+					timerModule->smi->interruptStatusReg |= 0x10 << timer;
 					timerModule->interruptHappenedOnceOrMore[timer] = true;
 				} else {
 					// Flip back to 1 and do nothing
@@ -2716,21 +2093,95 @@ static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 			// Just set bit 10 to 0 and be done with it,
 			// triggering IRQ as well
 			timerModule->timerMode[timer] &= 0xFFFFFBFF;
-			timerModule->smi->timersInterruptDelay[timer] = 0;
-			timerModule->smi->timersInterruptCounter[timer] = 0;
+			timerModule->smi->interruptStatusReg |= 0x10 << timer;
 		} else {
 			// Invert flag, triggering IRQ if it is then 0
 			if ((timerModule->timerMode[timer] & 0x400) == 0x400) {
 				// Flip to 0 and trigger interrupt
 				timerModule->timerMode[timer] &= 0xFFFFFBFF;
-				timerModule->smi->timersInterruptDelay[timer] = 0;
-				timerModule->smi->timersInterruptCounter[timer] = 0;
+				timerModule->smi->interruptStatusReg |= 0x10 << timer;
 			} else {
 				// Flip back to 1 and do nothing
 				timerModule->timerMode[timer] |= 0x400;
 			}
 		}
 	}
+
+	// Work out the interrupt line again, as an interrupt may have been
+	// flagged
+	SystemInterlink_updateIrqLine(timerModule->smi);
+}
+
+/*
+ * Bring the specified timer up to the current cycle count, setting flags and
+ * raising interrupts for any values it reached along the way.
+ */
+static void TimerModule_update(TimerModule *timerModule, int32_t timer)
+{
+	SystemInterlink *smi = timerModule->smi;
+	int32_t mode = timerModule->timerMode[timer];
+	int32_t previousValue = timerModule->timerCounterValue[timer];
+	int32_t target = timerModule->timerTargetValue[timer];
+
+	// Apply synchronisation to timers 0 and 1 using HBlank and VBlank status
+	if (timer < 2 && (mode & 0x1) == 0x1) {
+		GPU_executeGPUCycles(smi->gpu);
+		bool blank = (timer == 0) ?
+				GPU_isInHblank(smi->gpu) : GPU_isInVblank(smi->gpu);
+		if (blank)
+			timerModule->blankHappened[timer] = true;
+
+		// Pause or reset counter as needed
+		int32_t syncMode = logical_rshift(mode, 1) & 0x3;
+		if ((syncMode == 0 && blank) || (syncMode == 2 && !blank) ||
+				(syncMode == 3 && !timerModule->blankHappened[timer])) {
+			TimerModule_rebase(timerModule, timer, previousValue);
+			goto end;
+		}
+		if (syncMode == 1 && blank) {
+			TimerModule_rebase(timerModule, timer, 0);
+			goto end;
+		}
+	}
+
+	// Work out the raw counter value, then move the base on by whole clock
+	// periods so the numbers involved stay small
+	int64_t elapsedCycles = smi->systemCycles - timerModule->baseCycles[timer];
+	int64_t newValue = timerModule->baseValue[timer] +
+			TimerModule_getIncrements(timerModule, timer, elapsedCycles);
+	int64_t periods = elapsedCycles / timerModule->periodCycles[timer];
+	timerModule->baseCycles[timer] +=
+			periods * timerModule->periodCycles[timer];
+	timerModule->baseValue[timer] +=
+			periods * timerModule->periodIncrements[timer];
+
+	// Check for interrupts
+	bool intFlag = false;
+	int64_t wrapPeriod = ((mode & 0x8) == 0x8) ? target + 1 : 0x10000;
+	if (TimerModule_countPasses(previousValue, newValue, target,
+			wrapPeriod) > 0) {
+		timerModule->timerMode[timer] |= 0x800;
+		if ((mode & 0x10) == 0x10) {
+			intFlag = true;
+		}
+	}
+	if (wrapPeriod == 0x10000 && TimerModule_countPasses(previousValue,
+			newValue, 0xFFFF, wrapPeriod) > 0) {
+		timerModule->timerMode[timer] |= 0x1000;
+		if ((mode & 0x20) == 0x20) {
+			intFlag = true;
+		}
+	}
+	if (intFlag)
+		TimerModule_triggerTimerInterrupt(timerModule, timer);
+
+	// Wrap counter back round, either at target or after 0xFFFF
+	int64_t wrappedValue = newValue % wrapPeriod;
+	timerModule->baseValue[timer] -= newValue - wrappedValue;
+	timerModule->timerCounterValue[timer] = (int32_t)wrappedValue;
+
+	end:
+	TimerModule_scheduleEvent(timerModule, timer);
 }
 
 /*
@@ -2739,9 +2190,9 @@ static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 static void TimerModule_writeCounterValue(TimerModule *timerModule,
 		int32_t timer, int32_t value)
 {
-	TimerModule_resync(timerModule);
-	value = TimerModule_swapEndianness(value);
-	timerModule->timerCounterValue[timer] = 0xFFFF & value;
+	TimerModule_update(timerModule, timer);
+	TimerModule_rebase(timerModule, timer, 0xFFFF & value);
+	TimerModule_scheduleEvent(timerModule, timer);
 }
 
 /*
@@ -2750,8 +2201,7 @@ static void TimerModule_writeCounterValue(TimerModule *timerModule,
 static void TimerModule_writeMode(TimerModule *timerModule,
 		int32_t timer, int32_t value)
 {
-	TimerModule_resync(timerModule);
-	value = TimerModule_swapEndianness(value);
+	TimerModule_update(timerModule, timer);
 
 	// Set bit 10 to turn off interrupt request
 	value |= 0x400;
@@ -2759,17 +2209,94 @@ static void TimerModule_writeMode(TimerModule *timerModule,
 	// Set bits 13-15 to 0
 	value &= 0xFFFF1FFF;
 
-	// Reset hblank and vblank happened markers
-	timerModule->hblankHappened[timer] = false;
-	timerModule->vblankHappened[timer] = false;
+	// Reset blank happened marker
+	timerModule->blankHappened[timer] = false;
 
 	// Reset one-shot marker
 	timerModule->interruptHappenedOnceOrMore[timer] = false;
 
 	timerModule->timerMode[timer] = value;
+	TimerModule_setClockRate(timerModule, timer);
 
 	// Reset counter value
-	timerModule->timerCounterValue[timer] = 0;
+	TimerModule_rebase(timerModule, timer, 0);
+	TimerModule_scheduleEvent(timerModule, timer);
+}
+
+/*
+ * This function handles byte writes to the timer registers. Only the bottom
+ * two bytes of each can be written, with the first one clearing the second.
+ */
+static void TimerModule_writeRegisterByte(void *component, int32_t address,
+		int32_t value)
+{
+	TimerModule *timerModule = component;
+	int32_t timer = (address >> 4) & 0xF;
+
+	switch (address & 0x3) {
+		case 0:
+			value &= 0xFF;
+			break;
+		case 1: {
+			// Merge with the first byte of the current value
+			int32_t oldValue = 0;
+			switch (address & 0xC) {
+				case 0x0:
+					oldValue = TimerModule_readCounterValue(timerModule,
+							timer);
+					break;
+				case 0x4:
+					oldValue = TimerModule_readMode(timerModule, timer,
+							true);
+					break;
+				case 0x8:
+					oldValue = TimerModule_readTargetValue(timerModule,
+							timer);
+					break;
+			}
+			value = (oldValue & 0xFF) | ((value & 0xFF) << 8);
+			break;
+		}
+		default:
+			return;
+	}
+
+	TimerModule_writeRegisterWord(component, address & 0xFFFFFFFC, value);
+}
+
+/*
+ * This function handles halfword writes to the timer registers, of which
+ * only the bottom halfword of each can be written.
+ */
+static void TimerModule_writeRegisterHalfWord(void *component,
+		int32_t address, int32_t value)
+{
+	if ((address & 0x2) != 0)
+		return;
+
+	TimerModule_writeRegisterWord(component, address, value & 0xFFFF);
+}
+
+/*
+ * This function handles word writes to the timer registers.
+ */
+static void TimerModule_writeRegisterWord(void *component, int32_t address,
+		int32_t value)
+{
+	TimerModule *timerModule = component;
+	int32_t timer = (address >> 4) & 0xF;
+
+	switch (address & 0xC) {
+		case 0x0:
+			TimerModule_writeCounterValue(timerModule, timer, value);
+			break;
+		case 0x4:
+			TimerModule_writeMode(timerModule, timer, value);
+			break;
+		case 0x8:
+			TimerModule_writeTargetValue(timerModule, timer, value);
+			break;
+	}
 }
 
 /*
@@ -2778,7 +2305,7 @@ static void TimerModule_writeMode(TimerModule *timerModule,
 static void TimerModule_writeTargetValue(TimerModule *timerModule,
 		int32_t timer, int32_t value)
 {
-	TimerModule_resync(timerModule);
-	value = TimerModule_swapEndianness(value);
+	TimerModule_update(timerModule, timer);
 	timerModule->timerTargetValue[timer] = 0xFFFF & value;
-}
\ No newline at end of file
+	TimerModule_scheduleEvent(timerModule, timer);
+}
@@ -0,0 +1,360 @@
+/*
+ * This C file models the XA-ADPCM decoder of the CD-ROM controller as a
+ * class. XA audio sectors are decoded and resampled to the SPU's 44.1 kHz
+ * rate by the CD read-ahead worker, and the resulting stereo frames are
+ * passed to the SPU's CD audio input through a bounded ring. As there is
+ * exactly one producer and one consumer, the ring is managed through a pair
+ * of atomic indices, and neither side ever blocks the other. Reads can also
+ * be held, so that frames run ahead of the real timeline can use the ring
+ * without taking anything away from it.
+ *
+ * XAAudio.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "../headers/XAAudio.h"
+#include "../headers/math_utils.h"
+
+// Ring size in stereo frames (must be a power of two, so indices can wrap
+// with a mask) - a little over a third of a second
+#define PHILPSX_XAAUDIO_SIZE 16384
+#define PHILPSX_XAAUDIO_MASK (PHILPSX_XAAUDIO_SIZE - 1)
+
+// Layout of an XA audio sector - the subheader byte describing how it is
+// coded, and the 18 sound groups of 128 bytes following the subheader
+#define PHILPSX_XAAUDIO_CODING_INFO 19
+#define PHILPSX_XAAUDIO_GROUP_START 24
+#define PHILPSX_XAAUDIO_GROUP_COUNT 18
+#define PHILPSX_XAAUDIO_GROUP_SIZE 128
+
+// Most frames a sector can turn into, which is for 18.9 kHz mono - 4032
+// samples, doubled to 37.8 kHz then stretched by 7/6 to 44.1 kHz
+#define PHILPSX_XAAUDIO_MAX_SECTOR_FRAMES 9412
+
+/*
+ * This struct models the state of the decoder and the ring of decoded
+ * frames. Everything other than the ring indices and counters is only
+ * touched by the decoding thread.
+ */
+struct XAAudio {
+
+	// Backing store of interleaved left and right samples
+	int16_t backingStore[PHILPSX_XAAUDIO_SIZE * 2];
+
+	// Ring indices - writeMarker is only written by the decoding thread, and
+	// readMarker only by the SPU
+	atomic_size_t writeMarker;
+	atomic_size_t readMarker;
+
+	// Number of frames that had to be dropped as the ring was full
+	atomic_int_least64_t droppedFrames;
+
+	// This tells the decoding thread to start afresh with the next sector
+	atomic_bool resetPending;
+
+	// While reads are held, the SPU moves this marker on instead of
+	// readMarker, so the frames stay in the ring until reads are released
+	size_t heldReadMarker;
+	bool readsHeld;
+
+	// Two most recent samples of each channel for the ADPCM filter
+	int32_t adpcmOld[2];
+	int32_t adpcmOlder[2];
+
+	// Resampler state - the last two 37.8 kHz frames, and how far we are
+	// between them in 1/7ths
+	int32_t previous[2];
+	int32_t current[2];
+	int32_t phase;
+
+	// Frames decoded from the current sector, before they enter the ring
+	int16_t sectorFrames[PHILPSX_XAAUDIO_MAX_SECTOR_FRAMES * 2];
+	int32_t sectorFrameCount;
+};
+
+// Forward declarations for functions private to this class
+static void XAAudio_decodeGroup(XAAudio *xa, const uint8_t *group,
+		bool stereo, bool eightBit, bool halfRate);
+static void XAAudio_resample(XAAudio *xa, int32_t left, int32_t right);
+static void XAAudio_resetDecoder(XAAudio *xa);
+
+// ADPCM filter coefficients, in 1/64ths
+static const int32_t XAAudio_adpcmPositive[4] = { 0, 60, 115, 98 };
+static const int32_t XAAudio_adpcmNegative[4] = { 0, 0, -52, -55 };
+
+/*
+ * This constructs an XAAudio object.
+ */
+XAAudio *construct_XAAudio(void)
+{
+	// Allocate XAAudio struct
+	XAAudio *xa = calloc(1, sizeof(XAAudio));
+	if (!xa) {
+		fprintf(stderr, "PhilPSX: XAAudio: Couldn't allocate memory for "
+				"XAAudio struct\n");
+		goto end;
+	}
+
+	// Set markers and counters - everything else starts off zeroed
+	atomic_init(&xa->writeMarker, 0);
+	atomic_init(&xa->readMarker, 0);
+	atomic_init(&xa->droppedFrames, 0);
+	atomic_init(&xa->resetPending, false);
+
+	end:
+	return xa;
+}
+
+/*
+ * This destructs an XAAudio object.
+ */
+void destruct_XAAudio(XAAudio *xa)
+{
+	free(xa);
+}
+
+/*
+ * This decodes the specified raw sector of 2352 bytes, adding its frames to
+ * the ring. Any that don't fit are dropped. It should only be called from
+ * the decoding thread.
+ */
+void XAAudio_decodeSector(XAAudio *xa, const int8_t *sector)
+{
+	if (atomic_exchange(&xa->resetPending, false))
+		XAAudio_resetDecoder(xa);
+
+	// Read coding info - channel count, sample rate and bits per sample
+	int32_t codingInfo = sector[PHILPSX_XAAUDIO_CODING_INFO] & 0xFF;
+	bool stereo = (codingInfo & 0x3) == 1;
+	bool halfRate = ((codingInfo >> 2) & 0x3) == 1;
+	bool eightBit = ((codingInfo >> 4) & 0x3) == 1;
+
+	// Decode each sound group in turn
+	xa->sectorFrameCount = 0;
+	const uint8_t *group =
+			(const uint8_t *)&sector[PHILPSX_XAAUDIO_GROUP_START];
+	for (int32_t i = 0; i < PHILPSX_XAAUDIO_GROUP_COUNT; ++i) {
+		XAAudio_decodeGroup(xa, group, stereo, eightBit, halfRate);
+		group += PHILPSX_XAAUDIO_GROUP_SIZE;
+	}
+
+	// Copy frames into the ring in up to two pieces, either side of the end
+	size_t writeMarker = atomic_load_explicit(&xa->writeMarker,
+			memory_order_relaxed);
+	size_t space = PHILPSX_XAAUDIO_SIZE - (writeMarker -
+			atomic_load_explicit(&xa->readMarker, memory_order_acquire));
+	size_t frameCount = xa->sectorFrameCount;
+	if (frameCount > space) {
+		atomic_fetch_add_explicit(&xa->droppedFrames,
+				(int64_t)(frameCount - space), memory_order_relaxed);
+		frameCount = space;
+	}
+	size_t start = writeMarker & PHILPSX_XAAUDIO_MASK;
+	size_t firstPiece = PHILPSX_XAAUDIO_SIZE - start;
+	if (firstPiece > frameCount)
+		firstPiece = frameCount;
+	memcpy(&xa->backingStore[start * 2], xa->sectorFrames,
+			firstPiece * 2 * sizeof(int16_t));
+	memcpy(xa->backingStore, &xa->sectorFrames[firstPiece * 2],
+			(frameCount - firstPiece) * 2 * sizeof(int16_t));
+
+	// Make them visible to the SPU
+	atomic_store_explicit(&xa->writeMarker, writeMarker + frameCount,
+			memory_order_release);
+}
+
+/*
+ * This returns the number of frames dropped so far because the ring was
+ * full.
+ */
+int64_t XAAudio_getDroppedFrameCount(XAAudio *xa)
+{
+	return atomic_load(&xa->droppedFrames);
+}
+
+/*
+ * This sets whether reads are held. While they are, reads and resets only
+ * move a private marker, and releasing them goes back to where the first
+ * held read started, leaving the decoding thread none the wiser. It should
+ * only be called from the emulator thread.
+ */
+void XAAudio_holdReads(XAAudio *xa, bool held)
+{
+	if (held && !xa->readsHeld)
+		xa->heldReadMarker = atomic_load_explicit(&xa->readMarker,
+				memory_order_relaxed);
+	xa->readsHeld = held;
+}
+
+/*
+ * This moves up to frameCount stereo frames from the ring to frames, oldest
+ * first, returning how many were moved. It should only be called from the
+ * emulator thread.
+ */
+int32_t XAAudio_readFrames(XAAudio *xa, int16_t *frames, int32_t frameCount)
+{
+	size_t readMarker = xa->readsHeld ? xa->heldReadMarker :
+			atomic_load_explicit(&xa->readMarker, memory_order_relaxed);
+	size_t available = atomic_load_explicit(&xa->writeMarker,
+			memory_order_acquire) - readMarker;
+	if ((size_t)frameCount > available)
+		frameCount = (int32_t)available;
+
+	// Copy out in up to two pieces, either side of the end of the ring
+	size_t start = readMarker & PHILPSX_XAAUDIO_MASK;
+	size_t firstPiece = PHILPSX_XAAUDIO_SIZE - start;
+	if (firstPiece > (size_t)frameCount)
+		firstPiece = frameCount;
+	memcpy(frames, &xa->backingStore[start * 2],
+			firstPiece * 2 * sizeof(int16_t));
+	memcpy(&frames[firstPiece * 2], xa->backingStore,
+			(frameCount - firstPiece) * 2 * sizeof(int16_t));
+
+	// Release the frames we have consumed, unless reads are held
+	if (xa->readsHeld)
+		xa->heldReadMarker = readMarker + frameCount;
+	else
+		atomic_store_explicit(&xa->readMarker, readMarker + frameCount,
+				memory_order_release);
+	return frameCount;
+}
+
+/*
+ * This throws away any frames waiting in the ring, and tells the decoding
+ * thread to start afresh with the next sector, for when the drive moves to
+ * a new stream. It should only be called from the emulator thread.
+ */
+void XAAudio_reset(XAAudio *xa)
+{
+	// Leave the ring and decoder alone while reads are held
+	if (xa->readsHeld) {
+		xa->heldReadMarker = atomic_load_explicit(&xa->writeMarker,
+				memory_order_acquire);
+		return;
+	}
+
+	atomic_store_explicit(&xa->readMarker,
+			atomic_load_explicit(&xa->writeMarker, memory_order_acquire),
+			memory_order_release);
+	atomic_store(&xa->resetPending, true);
+}
+
+/*
+ * This decodes one 128-byte sound group, passing its frames on to the
+ * resampler. Stereo groups alternate between left and right sound units.
+ */
+static void XAAudio_decodeGroup(XAAudio *xa, const uint8_t *group,
+		bool stereo, bool eightBit, bool halfRate)
+{
+	int32_t unitCount = eightBit ? 4 : 8;
+
+	// Read headers - shifts above 12 behave like 9
+	int32_t shift[8], filter[8];
+	for (int32_t unit = 0; unit < unitCount; ++unit) {
+		shift[unit] = group[4 + unit] & 0xF;
+		if (shift[unit] > 12)
+			shift[unit] = 9;
+		filter[unit] = (group[4 + unit] >> 4) & 0x3;
+	}
+
+	// Expand the samples of every unit first, as they don't depend on each
+	// other - each row of the group holds one sample of every unit, so the
+	// inner loop is laid out for the compiler to do a row at a time in
+	// parallel lanes
+	int32_t expanded[28][8];
+	if (eightBit) {
+		for (int32_t i = 0; i < 28; ++i) {
+			const uint8_t *row = &group[16 + i * 4];
+			for (int32_t unit = 0; unit < 4; ++unit)
+				expanded[i][unit] = (int16_t)(row[unit] << 8) >> shift[unit];
+		}
+	} else {
+		for (int32_t i = 0; i < 28; ++i) {
+			const uint8_t *row = &group[16 + i * 4];
+			for (int32_t unit = 0; unit < 8; ++unit) {
+				int32_t nibble = (row[unit >> 1] >> ((unit & 0x1) * 4)) & 0xF;
+				expanded[i][unit] = (int16_t)(nibble << 12) >> shift[unit];
+			}
+		}
+	}
+
+	// Then apply the filter, which depends on the previous two samples of
+	// the same channel
+	int16_t decoded[8][28];
+	for (int32_t unit = 0; unit < unitCount; ++unit) {
+		int32_t channel = stereo ? (unit & 0x1) : 0;
+		int32_t positive = XAAudio_adpcmPositive[filter[unit]];
+		int32_t negative = XAAudio_adpcmNegative[filter[unit]];
+		int32_t old = xa->adpcmOld[channel];
+		int32_t older = xa->adpcmOlder[channel];
+		for (int32_t i = 0; i < 28; ++i) {
+			int32_t sample = expanded[i][unit] +
+					((old * positive + older * negative + 32) >> 6);
+			sample = max_value(min_value(sample, 0x7FFF), -0x8000);
+			decoded[unit][i] = (int16_t)sample;
+			older = old;
+			old = sample;
+		}
+		xa->adpcmOld[channel] = old;
+		xa->adpcmOlder[channel] = older;
+	}
+
+	// Pass frames on in order, doubling each up at 18.9 kHz
+	int32_t repeats = halfRate ? 2 : 1;
+	if (stereo) {
+		for (int32_t unit = 0; unit < unitCount; unit += 2) {
+			for (int32_t i = 0; i < 28; ++i) {
+				for (int32_t j = 0; j < repeats; ++j)
+					XAAudio_resample(xa, decoded[unit][i],
+							decoded[unit + 1][i]);
+			}
+		}
+	} else {
+		for (int32_t unit = 0; unit < unitCount; ++unit) {
+			for (int32_t i = 0; i < 28; ++i) {
+				for (int32_t j = 0; j < repeats; ++j)
+					XAAudio_resample(xa, decoded[unit][i], decoded[unit][i]);
+			}
+		}
+	}
+}
+
+/*
+ * This takes the next 37.8 kHz frame, and adds any 44.1 kHz frames now due
+ * to the sector's frames. Seven frames come out for every six that go in,
+ * each interpolated between the two input frames either side of it.
+ */
+static void XAAudio_resample(XAAudio *xa, int32_t left, int32_t right)
+{
+	xa->previous[0] = xa->current[0];
+	xa->previous[1] = xa->current[1];
+	xa->current[0] = left;
+	xa->current[1] = right;
+
+	while (xa->phase < 7) {
+		int16_t *frame = &xa->sectorFrames[xa->sectorFrameCount++ * 2];
+		for (int32_t channel = 0; channel < 2; ++channel)
+			frame[channel] = (int16_t)(xa->previous[channel] +
+					(xa->current[channel] - xa->previous[channel]) *
+					xa->phase / 7);
+		xa->phase += 6;
+	}
+	xa->phase -= 7;
+}
+
+/*
+ * This clears the filter and resampler history, so that the next sector
+ * decodes as the start of a new stream.
+ */
+static void XAAudio_resetDecoder(XAAudio *xa)
+{
+	memset(xa->adpcmOld, 0, sizeof(xa->adpcmOld));
+	memset(xa->adpcmOlder, 0, sizeof(xa->adpcmOlder));
+	memset(xa->previous, 0, sizeof(xa->previous));
+	memset(xa->current, 0, sizeof(xa->current));
+	xa->phase = 0;
+}
\ No newline at end of file
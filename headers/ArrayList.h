@@ -9,7 +9,8 @@
  * operations individually when enabled.
  * 
  * The array list is backed by a malloc'ed array which is grown and shrunk
- * according to certain metrics.
+ * according to certain metrics, and which keeps its size when the list is
+ * wiped.
  * 
  * ArrayList.h - Copyright Phillip Potter, 2020, under GPLv3
  */
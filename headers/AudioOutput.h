@@ -0,0 +1,32 @@
+/*
+ * This header file provides the public API for the audio output, which
+ * passes samples from the emulator thread to the host's audio device through
+ * a lock-free ring, resampling them to absorb the difference between the two
+ * clocks.
+ *
+ * AudioOutput.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_AUDIOOUTPUT_HEADER
+#define PHILPSX_AUDIOOUTPUT_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Rate samples are pushed at, matching the SPU
+#define PHILPSX_AUDIOOUTPUT_SAMPLE_RATE 44100
+
+// Typedefs
+typedef struct AudioOutput AudioOutput;
+
+// Public functions
+AudioOutput *construct_AudioOutput(void);
+void destruct_AudioOutput(AudioOutput *ao);
+int32_t AudioOutput_getFillLevel(AudioOutput *ao);
+void AudioOutput_getStats(AudioOutput *ao, int64_t *underruns,
+		int64_t *overruns);
+void AudioOutput_pace(AudioOutput *ao);
+void AudioOutput_pushSamples(AudioOutput *ao, const int16_t *samples,
+		int32_t frameCount);
+
+#endif
\ No newline at end of file
@@ -11,14 +11,33 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Sector reading modes - the 2048 bytes of user data, or the 2340 bytes of
+// the whole sector following the sync pattern
+#define PHILPSX_CD_SECTOR_DATA 0
+#define PHILPSX_CD_SECTOR_WHOLE 1
+
+// Number of bytes read in each mode
+#define PHILPSX_CD_DATA_SECTOR_SIZE 0x800
+#define PHILPSX_CD_WHOLE_SECTOR_SIZE 0x924
+
 // Typedefs
 typedef struct CD CD;
 
+// Callback through which the read-ahead worker passes on a whole raw sector
+// read for CD_readSectorAsync
+typedef void (*CDSectorCallback)(void *arg, const int8_t *sector);
+
 // Public functions
 CD *construct_CD(void);
 void destruct_CD(CD *cd);
 bool CD_isEmpty(CD *cd);
 bool CD_loadCD(CD *cd, const char *cdPath);
+const int8_t *CD_getSector(CD *cd, int64_t sector);
 int8_t CD_readByte(CD *cd, int64_t position);
+int32_t CD_readSector(CD *cd, int64_t sector, int8_t *dst, int32_t mode);
+void CD_readSectorAsync(CD *cd, int64_t sector, CDSectorCallback callback,
+		void *arg);
+void CD_prefetch(CD *cd, int64_t sector);
+void CD_getReadAheadStats(CD *cd, int64_t *hits, int64_t *misses);
 
 #endif
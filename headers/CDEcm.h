@@ -0,0 +1,25 @@
+/*
+ * This header file provides the public API for the CDEcm class, which reads
+ * CD images compressed in the ECM format. Sectors are decoded on demand, a
+ * hunk at a time, into a cache of bounded size. It can be used from any
+ * thread.
+ *
+ * CDEcm.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_CDECM_HEADER
+#define PHILPSX_CDECM_HEADER
+
+// System includes
+#include <stdint.h>
+
+// Typedefs
+typedef struct CDEcm CDEcm;
+
+// Public functions
+CDEcm *construct_CDEcm(const char *path);
+void destruct_CDEcm(CDEcm *ecm);
+int64_t CDEcm_getSize(CDEcm *ecm);
+void CDEcm_prefetch(CDEcm *ecm, int64_t position, int64_t length);
+void CDEcm_read(CDEcm *ecm, int64_t position, int8_t *dst, int32_t length);
+
+#endif
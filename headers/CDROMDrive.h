@@ -15,6 +15,8 @@
 typedef struct CDROMDrive CDROMDrive;
 
 // Includes
+#include "CD.h"
+#include "SaveState.h"
 #include "SystemInterlink.h"
 
 // Public functions
@@ -22,13 +24,22 @@ CDROMDrive *construct_CDROMDrive(void);
 void destruct_CDROMDrive(CDROMDrive *cdrom);
 void CDROMDrive_chunkCopy(CDROMDrive *cdrom, int8_t *destination,
 		int32_t startIndex, int32_t length);
+CD *CDROMDrive_getCD(CDROMDrive *cdrom);
+void CDROMDrive_getReadAheadStats(CDROMDrive *cdrom, int64_t *hits,
+		int64_t *misses);
 bool CDROMDrive_loadCD(CDROMDrive *cdrom, const char *cdPath);
+void CDROMDrive_loadState(CDROMDrive *cdrom, SaveState *state);
+int32_t CDROMDrive_readAudioFrames(CDROMDrive *cdrom, int16_t *frames,
+		int32_t frameCount);
 int8_t CDROMDrive_read1800(CDROMDrive *cdrom);
 int8_t CDROMDrive_read1801(CDROMDrive *cdrom);
 int8_t CDROMDrive_read1802(CDROMDrive *cdrom);
 int8_t CDROMDrive_read1803(CDROMDrive *cdrom);
+void CDROMDrive_readNextSector(CDROMDrive *cdrom);
+void CDROMDrive_saveState(CDROMDrive *cdrom, SaveState *state);
 void CDROMDrive_setInterruptNumber(CDROMDrive *cdrom, int32_t interruptNum);
 void CDROMDrive_setMemoryInterface(CDROMDrive *cdrom, SystemInterlink *smi);
+void CDROMDrive_setSpeculative(CDROMDrive *cdrom, bool speculative);
 void CDROMDrive_write1800(CDROMDrive *cdrom, int8_t value);
 void CDROMDrive_write1801(CDROMDrive *cdrom, int8_t value);
 void CDROMDrive_write1802(CDROMDrive *cdrom, int8_t value);
@@ -0,0 +1,36 @@
+/*
+ * This header file provides the public API for a command channel, which
+ * passes small fixed-size commands from any number of threads to the single
+ * thread reading them, without any locking.
+ *
+ * CommandChannel.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_COMMANDCHANNEL_HEADER
+#define PHILPSX_COMMANDCHANNEL_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct ChannelCommand ChannelCommand;
+typedef struct CommandChannel CommandChannel;
+
+/*
+ * This struct holds one command, whose type and arguments mean whatever the
+ * threads using the channel agree on.
+ */
+struct ChannelCommand {
+	int32_t type;
+	int32_t arguments[3];
+};
+
+// Public functions
+CommandChannel *construct_CommandChannel(int32_t capacity);
+void destruct_CommandChannel(CommandChannel *channel);
+bool CommandChannel_isEmpty(CommandChannel *channel);
+bool CommandChannel_pop(CommandChannel *channel, ChannelCommand *command);
+bool CommandChannel_push(CommandChannel *channel,
+		const ChannelCommand *command);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+/*
+ * This header file provides implementation details regarding the struct
+ * for a whole virtual PlayStation, so that the PhilPSX front end can set up
+ * a console around its own window, work queue and rendering thread, and
+ * reach the components directly. It also includes the public header.
+ *
+ * Console_all.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_CONSOLE_ALL_HEADER
+#define PHILPSX_CONSOLE_ALL_HEADER
+
+// System includes
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of stereo frames read from the SPU at a time
+#define PHILPSX_CONSOLE_AUDIO_CHUNK_FRAMES 1024
+
+// Includes
+#include "Console_public.h"
+#include "CDROMDrive.h"
+#include "ControllerIO.h"
+#include "DMAArbiter.h"
+#include "GPU.h"
+#include "MDEC.h"
+#include "R3051.h"
+#include "SPU.h"
+#include "SystemInterlink.h"
+#include "WorkQueue.h"
+
+/*
+ * This struct stores references to all emulated components, along with what
+ * a console constructed for embedding needs to run on its own.
+ */
+struct Console {
+
+	// Components
+	R3051 *cpu;
+	GPU *gpu;
+	SPU *spu;
+	CDROMDrive *cdrom;
+	MDEC *mdec;
+	DMAArbiter *dma;
+	ControllerIO *cio;
+	SystemInterlink *smi;
+	int32_t rendererMode;
+
+	// Work queue and rendering thread, which are only owned by consoles
+	// constructed for embedding
+	WorkQueue *wq;
+	pthread_t renderingThread;
+	bool ownsRenderingThread;
+
+	// Sinks for sound and frames, and a copy of the last frame shown, which
+	// is written from the rendering thread
+	void (*audioSink)(void *userData, const int16_t *samples,
+			int32_t frameCount);
+	void *audioSinkData;
+	void (*frameSink)(void *userData, const uint32_t *pixels,
+			int32_t width, int32_t height);
+	void *frameSinkData;
+	pthread_mutex_t frameMutex;
+	uint32_t *frame;
+	int32_t frameWidth;
+	int32_t frameHeight;
+	int64_t audioFrame;
+	int16_t samples[PHILPSX_CONSOLE_AUDIO_CHUNK_FRAMES * 2];
+};
+
+// Functions for the front end
+void Console_cleanupComponents(Console *console);
+bool Console_setupComponents(Console *console, const char *biosPath,
+		WorkQueue *wq, int32_t rendererMode);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*
+ * This header file provides the public API for a whole virtual PlayStation,
+ * for embedding the emulator in other programs. Each console owns all of its
+ * components, its work queue and its rendering thread, and draws with the
+ * software renderer into memory rather than a window, so any number of them
+ * can be run side by side from different threads.
+ *
+ * Console_public.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_CONSOLE_PUBLIC_HEADER
+#define PHILPSX_CONSOLE_PUBLIC_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct Console Console;
+
+// Largest frame the console can show, in pixels
+#define PHILPSX_CONSOLE_MAX_FRAME_WIDTH 1024
+#define PHILPSX_CONSOLE_MAX_FRAME_HEIGHT 512
+
+// Buttons of the pads, for Console_setPadInput
+#define PHILPSX_CONSOLE_BUTTON_SELECT 0x0001
+#define PHILPSX_CONSOLE_BUTTON_L3 0x0002
+#define PHILPSX_CONSOLE_BUTTON_R3 0x0004
+#define PHILPSX_CONSOLE_BUTTON_START 0x0008
+#define PHILPSX_CONSOLE_BUTTON_UP 0x0010
+#define PHILPSX_CONSOLE_BUTTON_RIGHT 0x0020
+#define PHILPSX_CONSOLE_BUTTON_DOWN 0x0040
+#define PHILPSX_CONSOLE_BUTTON_LEFT 0x0080
+#define PHILPSX_CONSOLE_BUTTON_L2 0x0100
+#define PHILPSX_CONSOLE_BUTTON_R2 0x0200
+#define PHILPSX_CONSOLE_BUTTON_L1 0x0400
+#define PHILPSX_CONSOLE_BUTTON_R1 0x0800
+#define PHILPSX_CONSOLE_BUTTON_TRIANGLE 0x1000
+#define PHILPSX_CONSOLE_BUTTON_CIRCLE 0x2000
+#define PHILPSX_CONSOLE_BUTTON_CROSS 0x4000
+#define PHILPSX_CONSOLE_BUTTON_SQUARE 0x8000
+
+// Includes
+#include "SaveState.h"
+
+// Public functions
+Console *construct_Console(const char *biosPath);
+void destruct_Console(Console *console);
+bool Console_getFramebuffer(Console *console, uint32_t *pixels,
+		int32_t *width, int32_t *height);
+int64_t Console_getFrameCount(Console *console);
+bool Console_loadCD(Console *console, const char *cdPath);
+bool Console_loadMemoryCard(Console *console, int32_t slot,
+		const char *path);
+bool Console_loadState(Console *console, SaveState *state);
+int64_t Console_runCycles(Console *console, int64_t cycles);
+void Console_saveState(Console *console, SaveState *state);
+void Console_setAudioSink(Console *console,
+		void (*audioSink)(void *userData, const int16_t *samples,
+		int32_t frameCount), void *userData);
+void Console_setFrameSink(Console *console,
+		void (*frameSink)(void *userData, const uint32_t *pixels,
+		int32_t width, int32_t height), void *userData);
+void Console_setPadInput(Console *console, int32_t port, uint16_t buttons,
+		const uint8_t *axes);
+
+#endif
\ No newline at end of file
@@ -1,7 +1,8 @@
 /*
  * This header file provides the public API for the controllers and memory cards
- * of the PlayStation. At the moment, most functionality is stubbed out/not
- * implemented.
+ * of the PlayStation. Each of the two ports has a pad plugged in, and can have
+ * a memory card inserted, backed by a mapped image file that is written back
+ * by a thread of its own.
  * 
  * ControllerIO.h - Copyright Phillip Potter, 2020, under GPLv3
  */
@@ -9,19 +10,36 @@
 #define PHILPSX_CONTROLLERIO_HEADER
 
 // System includes
+#include <stdbool.h>
 #include <stdint.h>
 
 // Typedefs
 typedef struct ControllerIO ControllerIO;
 
+// Number of controller ports, each with a memory card slot
+#define PHILPSX_CONTROLLERIO_PORT_COUNT 2
+
 // Includes
+#include "SaveState.h"
 #include "SystemInterlink.h"
 
 // Public functions
 ControllerIO *construct_ControllerIO(void);
 void destruct_ControllerIO(ControllerIO *cio);
 void ControllerIO_appendSyncCycles(ControllerIO *cio, int32_t cycles);
+void ControllerIO_finishTransfer(ControllerIO *cio);
+void ControllerIO_flushMemoryCards(ControllerIO *cio);
+bool ControllerIO_getMemoryCardStats(ControllerIO *cio, int32_t slot,
+		int64_t *sectorsWritten, int64_t *flushes, int64_t *sectorsFlushed);
+void ControllerIO_latchInput(ControllerIO *cio);
+bool ControllerIO_loadMemoryCard(ControllerIO *cio, int32_t slot,
+		const char *path);
+void ControllerIO_loadState(ControllerIO *cio, SaveState *state);
 int8_t ControllerIO_readByte(ControllerIO *cio, int32_t address);
+void ControllerIO_saveState(ControllerIO *cio, SaveState *state);
+void ControllerIO_setHostInput(ControllerIO *cio, int32_t port,
+		uint16_t buttons, const uint8_t *axes);
+void ControllerIO_startWriteBack(ControllerIO *cio);
 void ControllerIO_writeByte(ControllerIO *cio, int32_t address, int8_t value);
 void ControllerIO_setMemoryInterface(ControllerIO *cio, SystemInterlink *smi);
 
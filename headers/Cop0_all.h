@@ -19,6 +19,10 @@ struct Cop0 {
 
 	// Condition line
 	bool conditionLine;
+
+	// Whether an interrupt is pending and enabled by the status register,
+	// worked out whenever the status or cause register changes
+	bool interruptPending;
 };
 
 // Includes
@@ -19,6 +19,8 @@ void construct_Cop0(Cop0 *sccp); // Needs a pre-allocated memory region
 void Cop0_reset(Cop0 *sccp);
 bool Cop0_getConditionLineStatus(Cop0 *sccp);
 void Cop0_setConditionLineStatus(Cop0 *sccp, bool status);
+bool Cop0_isInterruptPending(Cop0 *sccp);
+void Cop0_setInterruptLine(Cop0 *sccp, bool asserted);
 void Cop0_rfe(Cop0 *sccp);
 int32_t Cop0_getResetExceptionVector(Cop0 *sccp);
 int32_t Cop0_getGeneralExceptionVector(Cop0 *sccp);
@@ -11,14 +11,42 @@
 /*
  * The Cop2 struct models the Geometry Transformation Engine, which is a
  * co-processor in the PlayStation responsible for matrix calculations amongst
- * other things.
+ * other things. Registers are kept in their native widths rather than as the
+ * 32-bit words the CPU sees - Cop2_readDataReg and friends pack and unpack
+ * them at the boundary.
  */
 struct Cop2 {
-	// Control registers
-	int32_t controlRegisters[32];
+	// Data registers - V0 to V2, RGBC, OTZ, IR0 to IR3, the screen XY,
+	// screen Z and colour FIFOs, MAC0 to MAC3 and LZCS. RES1 has no storage,
+	// while SXYP, IRGB, ORGB and LZCR are worked out from other registers
+	int16_t vectors[3][3];
+	uint8_t rgbc[4];
+	uint16_t otz;
+	int16_t ir[4];
+	int16_t sxy[3][2];
+	uint16_t sz[4];
+	uint8_t rgb[3][4];
+	int32_t mac[4];
+	int32_t lzcs;
 
-	// Data registers
-	int32_t dataRegisters[32];
+	// Control registers - rotation matrix and translation vector, light
+	// matrix and background colour, light colour matrix and far colour,
+	// screen offset, projection plane distance, depth cueing coefficients,
+	// Z scale factors and FLAG
+	int16_t rotation[3][3];
+	int32_t translation[3];
+	int16_t light[3][3];
+	int32_t background[3];
+	int16_t colour[3][3];
+	int32_t farColour[3];
+	int32_t ofx;
+	int32_t ofy;
+	uint16_t h;
+	int16_t dqa;
+	int32_t dqb;
+	int16_t zsf3;
+	int16_t zsf4;
+	int32_t flag;
 
 	// Condition line
 	bool conditionLine;
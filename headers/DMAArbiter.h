@@ -17,17 +17,25 @@ typedef struct DMAArbiter DMAArbiter;
 #include "CDROMDrive.h"
 #include "R3051.h"
 #include "GPU.h"
+#include "MDEC.h"
+#include "SaveState.h"
+#include "SPU.h"
 #include "SystemInterlink.h"
 
 // Public functions
 DMAArbiter *construct_DMAArbiter(void);
 void destruct_DMAArbiter(DMAArbiter *dma);
+void DMAArbiter_completeTransfer(DMAArbiter *dma);
+void DMAArbiter_loadState(DMAArbiter *dma, SaveState *state);
 int8_t DMAArbiter_readByte(DMAArbiter *dma, int32_t address);
 int32_t DMAArbiter_readWord(DMAArbiter *dma, int32_t address);
+void DMAArbiter_saveState(DMAArbiter *dma, SaveState *state);
 void DMAArbiter_setCdrom(DMAArbiter *dma, CDROMDrive *cdrom);
 void DMAArbiter_setCpu(DMAArbiter *dma, R3051 *cpu);
 void DMAArbiter_setGpu(DMAArbiter *dma, GPU *gpu);
+void DMAArbiter_setMdec(DMAArbiter *dma, MDEC *mdec);
 void DMAArbiter_setMemoryInterface(DMAArbiter *dma, SystemInterlink *smi);
+void DMAArbiter_setSpu(DMAArbiter *dma, SPU *spu);
 void DMAArbiter_writeByte(DMAArbiter *dma, int32_t address, int8_t value);
 void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word);
 
@@ -16,6 +16,7 @@
 typedef struct GLFunctionPointers GLFunctionPointers;
 typedef void (APIENTRY *glActiveTexture_type)(GLenum texture);
 typedef void (APIENTRY *glAttachShader_type)(GLuint program, GLuint shader);
+typedef void (APIENTRY *glBindBuffer_type)(GLenum target, GLuint buffer);
 typedef void (APIENTRY *glBindBufferBase_type)(GLenum target, GLuint index,
 		GLuint buffer);
 typedef void (APIENTRY *glBindFramebuffer_type)(GLenum target,
@@ -25,8 +26,14 @@ typedef void (APIENTRY *glBindImageTexture_type)(GLuint unit, GLuint texture,
 		GLenum format);
 typedef void (APIENTRY *glBindTexture_type)(GLenum target, GLuint texture);
 typedef void (APIENTRY *glBindVertexArray_type)(GLuint array);
+typedef void (APIENTRY *glBlitNamedFramebuffer_type)(
+		GLuint readFramebuffer, GLuint drawFramebuffer, GLint srcX0,
+		GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0,
+		GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
 typedef void (APIENTRY *glBufferStorage_type)(GLenum target, GLsizeiptr size,
 		const GLvoid *data, GLbitfield flags);
+typedef GLenum (APIENTRY *glClientWaitSync_type)(GLsync sync,
+		GLbitfield flags, GLuint64 timeout);
 typedef void (APIENTRY *glCompileShader_type)(GLuint shader);
 typedef void (APIENTRY *glCreateBuffers_type)(GLsizei n, GLuint *buffers);
 typedef void (APIENTRY *glCreateFramebuffers_type)(GLsizei n, GLuint *ids);
@@ -35,30 +42,63 @@ typedef GLuint (APIENTRY *glCreateShader_type)(GLenum shaderType);
 typedef void (APIENTRY *glCreateTextures_type)(GLenum target, GLsizei n,
 		GLuint *textures);
 typedef void (APIENTRY *glCreateVertexArrays_type)(GLsizei n, GLuint *arrays);
+typedef void (APIENTRY *glDebugMessageCallback_type)(
+		GLDEBUGPROC callback, const void *userParam);
 typedef void (APIENTRY *glDeleteBuffers_type)(GLsizei n,
 		const GLuint *buffers);
 typedef void (APIENTRY *glDeleteFramebuffers_type)(GLsizei n,
 		const GLuint *framebuffers);
 typedef void (APIENTRY *glDeleteProgram_type)(GLuint program);
 typedef void (APIENTRY *glDeleteShader_type)(GLuint shader);
+typedef void (APIENTRY *glDeleteSync_type)(GLsync sync);
 typedef void (APIENTRY *glDeleteTextures_type)(GLsizei n,
 		const GLuint *textures);
 typedef void (APIENTRY *glDeleteVertexArrays_type)(GLsizei n,
 		const GLuint *arrays);
 typedef void (APIENTRY *glDetachShader_type)(GLuint program, GLuint shader);
 typedef void (APIENTRY *glDisable_type)(GLenum cap);
+typedef void (APIENTRY *glDispatchCompute_type)(GLuint num_groups_x,
+		GLuint num_groups_y, GLuint num_groups_z);
 typedef void (APIENTRY *glDrawArrays_type)(GLenum mode, GLint first,
 		GLsizei count);
 typedef void (APIENTRY *glDrawBuffers_type)(GLsizei n, const GLenum *bufs);
+typedef void (APIENTRY *glEnable_type)(GLenum cap);
+typedef void (APIENTRY *glEnableVertexArrayAttrib_type)(GLuint vaobj,
+		GLuint index);
+typedef GLsync (APIENTRY *glFenceSync_type)(GLenum condition,
+		GLbitfield flags);
+typedef void (APIENTRY *glFlush_type)(void);
 typedef void (APIENTRY *glFramebufferParameteri_type)(GLenum target,
 		GLenum pname, GLint param);
 typedef void (APIENTRY *glFramebufferTexture2D_type)(GLenum target,
 		GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+typedef void (APIENTRY *glFramebufferTextureLayer_type)(GLenum target,
+		GLenum attachment, GLuint texture, GLint level, GLint layer);
 typedef GLenum (APIENTRY *glGetError_type)(void);
+typedef void (APIENTRY *glGetIntegerv_type)(GLenum pname, GLint *data);
+typedef void (APIENTRY *glGetProgramBinary_type)(GLuint program,
+		GLsizei bufSize, GLsizei *length, GLenum *binaryFormat,
+		void *binary);
+typedef void (APIENTRY *glGetProgramiv_type)(GLuint program, GLenum pname,
+		GLint *params);
 typedef void (APIENTRY *glGetShaderiv_type)(GLuint shader, GLenum pname,
 		GLuint *params);
+typedef const GLubyte *(APIENTRY *glGetString_type)(GLenum name);
+typedef const GLubyte *(APIENTRY *glGetStringi_type)(GLenum name,
+		GLuint index);
 typedef void (APIENTRY *glLinkProgram_type)(GLuint program);
+typedef void *(APIENTRY *glMapNamedBufferRange_type)(GLuint buffer,
+		GLintptr offset, GLsizeiptr length, GLbitfield access);
 typedef void (APIENTRY *glMemoryBarrier_type)(GLbitfield barriers);
+typedef void (APIENTRY *glNamedBufferStorage_type)(GLuint buffer,
+		GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRY *glNamedFramebufferTexture_type)(GLuint framebuffer,
+		GLenum attachment, GLuint texture, GLint level);
+typedef void (APIENTRY *glPixelStorei_type)(GLenum pname, GLint param);
+typedef void (APIENTRY *glProgramBinary_type)(GLuint program,
+		GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRY *glProgramParameteri_type)(GLuint program,
+		GLenum pname, GLint value);
 typedef void (APIENTRY *glReadPixels_type)(GLint x, GLint y, GLsizei width,
 		GLsizei height, GLenum format, GLenum type, GLvoid *data);
 typedef void (APIENTRY *glShaderSource_type)(GLuint shader, GLsizei count,
@@ -67,15 +107,31 @@ typedef void (APIENTRY *glTexParameteri_type)(GLenum target, GLenum pname,
 		GLint param);
 typedef void (APIENTRY *glTexStorage2D_type)(GLenum target, GLsizei levels,
 		GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRY *glTexStorage3D_type)(GLenum target, GLsizei levels,
+		GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
 typedef void (APIENTRY *glTexSubImage2D_type)(GLenum target, GLint level,
 		GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
 		GLenum format, GLenum type, const GLvoid *pixels);
+typedef void (APIENTRY *glTextureStorage2D_type)(GLuint texture,
+		GLsizei levels, GLenum internalformat, GLsizei width,
+		GLsizei height);
 typedef void (APIENTRY *glUniform1i_type)(GLint location, GLint v0);
 typedef void (APIENTRY *glUniform3iv_type)(GLint location, GLsizei count,
 		const GLint *value);
+typedef void (APIENTRY *glUniform4iv_type)(GLint location, GLsizei count,
+		const GLint *value);
+typedef GLboolean (APIENTRY *glUnmapNamedBuffer_type)(GLuint buffer);
 typedef void (APIENTRY *glUseProgram_type)(GLuint program);
+typedef void (APIENTRY *glVertexArrayAttribBinding_type)(GLuint vaobj,
+		GLuint attribindex, GLuint bindingindex);
+typedef void (APIENTRY *glVertexArrayAttribIFormat_type)(GLuint vaobj,
+		GLuint attribindex, GLint size, GLenum type, GLuint relativeoffset);
+typedef void (APIENTRY *glVertexArrayVertexBuffer_type)(GLuint vaobj,
+		GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
 typedef void (APIENTRY *glViewport_type)(GLint x, GLint y, GLsizei width,
 		GLsizei height);
+typedef void (APIENTRY *glWaitSync_type)(GLsync sync, GLbitfield flags,
+		GLuint64 timeout);
 
 // Struct definition - all these member pointers should be initialised
 // externally with the correct function address before use. Above each
@@ -86,6 +142,8 @@ struct GLFunctionPointers {
 	glActiveTexture_type glActiveTexture;
 	// >= 2.0
 	glAttachShader_type glAttachShader;
+	// >= 2.1 with GL_PIXEL_PACK_BUFFER
+	glBindBuffer_type glBindBuffer;
 	// >= 4.3 with GL_SHADER_STORAGE_BUFFER,
 	// >= 4.2 with GL_ATOMIC_COUNTER_BUFFER,
 	// >= 3.0 otherwise
@@ -100,8 +158,12 @@ struct GLFunctionPointers {
 	glBindTexture_type glBindTexture;
 	// >= 3.0
 	glBindVertexArray_type glBindVertexArray;
+	// >= 4.5
+	glBlitNamedFramebuffer_type glBlitNamedFramebuffer;
 	// >= 4.4
 	glBufferStorage_type glBufferStorage;
+	// >= 3.2
+	glClientWaitSync_type glClientWaitSync;
 	// >= 2.0
 	glCompileShader_type glCompileShader;
 	// >= 4.5
@@ -117,6 +179,8 @@ struct GLFunctionPointers {
 	glCreateTextures_type glCreateTextures;
 	// >= 4.5
 	glCreateVertexArrays_type glCreateVertexArrays;
+	// >= 4.3
+	glDebugMessageCallback_type glDebugMessageCallback;
 	// >= 2.0
 	glDeleteBuffers_type glDeleteBuffers;
 	// >= 3.0
@@ -125,6 +189,8 @@ struct GLFunctionPointers {
 	glDeleteProgram_type glDeleteProgram;
 	// >= 2.0
 	glDeleteShader_type glDeleteShader;
+	// >= 3.2
+	glDeleteSync_type glDeleteSync;
 	// >= 2.0
 	glDeleteTextures_type glDeleteTextures;
 	// >= 3.0
@@ -137,26 +203,66 @@ struct GLFunctionPointers {
 	// >= 3.1 with GL_PRIMITIVE_RESTART,
 	// >= 2.0 otherwise
 	glDisable_type glDisable;
+	// >= 4.3
+	glDispatchCompute_type glDispatchCompute;
 	// >= 3.2 with GL_LINE_STRIP_ADJACENCY, GL_LINES_ADJACENCY,
 	// GL_TRIANGLE_STRIP_ADJACENCY and GL_TRIANGLES_ADJACENCY
 	// >= 2.0 otherwise
 	glDrawArrays_type glDrawArrays;
 	// >= 2.0
 	glDrawBuffers_type glDrawBuffers;
+	// >= 4.3 with GL_PRIMITIVE_RESTART_FIXED_INDEX, GL_DEBUG_OUTPUT and
+	// GL_DEBUG_OUTPUT_SYNCHRONOUS,
+	// >= 3.2 with GL_TEXTURE_CUBE_MAP_SEAMLESS,
+	// >= 3.1 with GL_PRIMITIVE_RESTART,
+	// >= 2.0 otherwise
+	glEnable_type glEnable;
+	// >= 4.5
+	glEnableVertexArrayAttrib_type glEnableVertexArrayAttrib;
+	// >= 3.2
+	glFenceSync_type glFenceSync;
+	// >= 2.0
+	glFlush_type glFlush;
 	// >= 4.3
 	glFramebufferParameteri_type glFramebufferParameteri;
 	// >= 3.0
 	glFramebufferTexture2D_type glFramebufferTexture2D;
+	// >= 3.0
+	glFramebufferTextureLayer_type glFramebufferTextureLayer;
 	// >= 2.0
 	glGetError_type glGetError;
+	// >= 3.0 with GL_NUM_EXTENSIONS,
+	// >= 2.0 otherwise
+	glGetIntegerv_type glGetIntegerv;
+	// >= 4.1
+	glGetProgramBinary_type glGetProgramBinary;
+	// >= 4.1 with GL_PROGRAM_BINARY_LENGTH,
+	// >= 2.0 otherwise
+	glGetProgramiv_type glGetProgramiv;
 	// >= 2.0
 	glGetShaderiv_type glGetShaderiv;
 	// >= 2.0
+	glGetString_type glGetString;
+	// >= 3.0
+	glGetStringi_type glGetStringi;
+	// >= 2.0
 	glLinkProgram_type glLinkProgram;
+	// >= 4.5
+	glMapNamedBufferRange_type glMapNamedBufferRange;
 	// >= 4.4 with GL_QUERY_BUFFER_BARRIER_BIT,
 	// >= 4.3 with GL_SHADER_STORAGE_BARRIER_BIT,
 	// >= 4.2 otherwise
 	glMemoryBarrier_type glMemoryBarrier;
+	// >= 4.5
+	glNamedBufferStorage_type glNamedBufferStorage;
+	// >= 4.5
+	glNamedFramebufferTexture_type glNamedFramebufferTexture;
+	// >= 2.0
+	glPixelStorei_type glPixelStorei;
+	// >= 4.1
+	glProgramBinary_type glProgramBinary;
+	// >= 4.1
+	glProgramParameteri_type glProgramParameteri;
 	// >= 2.0
 	glReadPixels_type glReadPixels;
 	// >= 2.0
@@ -168,17 +274,33 @@ struct GLFunctionPointers {
 	// >= 4.4 with GL_STENCIL_INDEX8 as internalformat,
 	// >= 4.2 otherwise
 	glTexStorage2D_type glTexStorage2D;
+	// >= 4.2
+	glTexStorage3D_type glTexStorage3D;
 	// >= 4.4 with GL_STENCIL_INDEX as format,
 	// >= 2.0 otherwise
 	glTexSubImage2D_type glTexSubImage2D;
+	// >= 4.5
+	glTextureStorage2D_type glTextureStorage2D;
 	// >= 2.0
 	glUniform1i_type glUniform1i;
 	// >= 2.0
 	glUniform3iv_type glUniform3iv;
 	// >= 2.0
+	glUniform4iv_type glUniform4iv;
+	// >= 4.5
+	glUnmapNamedBuffer_type glUnmapNamedBuffer;
+	// >= 2.0
 	glUseProgram_type glUseProgram;
+	// >= 4.5
+	glVertexArrayAttribBinding_type glVertexArrayAttribBinding;
+	// >= 4.5
+	glVertexArrayAttribIFormat_type glVertexArrayAttribIFormat;
+	// >= 4.5
+	glVertexArrayVertexBuffer_type glVertexArrayVertexBuffer;
 	// >= 2.0
 	glViewport_type glViewport;
+	// >= 3.2
+	glWaitSync_type glWaitSync;
 };
 
 // Public functions
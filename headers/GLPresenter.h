@@ -0,0 +1,38 @@
+/*
+ * This header file provides the public API for a GL presenter, which shows
+ * frames in a window from a thread and GL context of its own, so that the
+ * rendering thread never waits for the display to refresh. Frames are drawn
+ * into one of three textures shared with the rendering thread's context, and
+ * only the newest finished one is shown at each refresh.
+ *
+ * GLPresenter.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_GLPRESENTER_HEADER
+#define PHILPSX_GLPRESENTER_HEADER
+
+// System includes
+#include <stdint.h>
+#include <GL/gl.h>
+#include <SDL2/SDL.h>
+
+// Typedefs
+typedef struct GLPresenter GLPresenter;
+
+// Largest frame that can be presented
+#define PHILPSX_GLPRESENTER_MAX_WIDTH 1024
+#define PHILPSX_GLPRESENTER_MAX_HEIGHT 512
+
+// Includes
+#include "GLFunctionPointers.h"
+
+// Public functions
+GLPresenter *construct_GLPresenter(GLFunctionPointers *gl,
+		SDL_Window *window);
+void destruct_GLPresenter(GLPresenter *presenter);
+GLuint GLPresenter_beginFrame(GLPresenter *presenter);
+void GLPresenter_endFrame(GLPresenter *presenter, int32_t width,
+		int32_t height, int32_t windowWidth, int32_t windowHeight);
+void GLPresenter_getStats(GLPresenter *presenter, int64_t *presented,
+		int64_t *dropped);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+/*
+ * This header file provides the public API for a GL program cache, which
+ * keeps linked shader program binaries on disk so that later runs can load
+ * them instead of compiling the shaders again. Entries are keyed by the GL
+ * driver's vendor, renderer and version strings along with a hash of the
+ * shader source, so a driver update or shader change just misses. It should
+ * only be used from the GL context thread.
+ *
+ * GLProgramCache.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_GLPROGRAMCACHE_HEADER
+#define PHILPSX_GLPROGRAMCACHE_HEADER
+
+// System includes
+#include <GL/gl.h>
+
+// Typedefs
+typedef struct GLProgramCache GLProgramCache;
+
+// Includes
+#include "GLFunctionPointers.h"
+
+// Public functions
+GLProgramCache *construct_GLProgramCache(GLFunctionPointers *gl);
+void destruct_GLProgramCache(GLProgramCache *cache);
+GLuint GLProgramCache_loadProgram(GLProgramCache *cache, const char *name,
+		const char *vertexShaderSource, const char *fragmentShaderSource);
+void GLProgramCache_prepareProgram(GLProgramCache *cache, GLuint program);
+void GLProgramCache_storeProgram(GLProgramCache *cache, const char *name,
+		const char *vertexShaderSource, const char *fragmentShaderSource,
+		GLuint program);
+
+#endif
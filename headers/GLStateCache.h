@@ -0,0 +1,34 @@
+/*
+ * This header file provides the public API for a GL state cache, which sits
+ * in front of the GL function pointers and remembers the framebuffer,
+ * program, viewport, active texture unit and integer uniform values last
+ * set, so that calls which wouldn't change anything can be skipped. It
+ * should only be used from the GL context thread.
+ *
+ * GLStateCache.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_GLSTATECACHE_HEADER
+#define PHILPSX_GLSTATECACHE_HEADER
+
+// System includes
+#include <GL/gl.h>
+
+// Typedefs
+typedef struct GLStateCache GLStateCache;
+
+// Includes
+#include "GLFunctionPointers.h"
+
+// Public functions
+GLStateCache *construct_GLStateCache(GLFunctionPointers *gl);
+void destruct_GLStateCache(GLStateCache *cache);
+void GLStateCache_invalidate(GLStateCache *cache);
+void GLStateCache_activeTexture(GLStateCache *cache, GLenum texture);
+void GLStateCache_bindFramebuffer(GLStateCache *cache, GLenum target,
+		GLuint framebuffer);
+void GLStateCache_uniform1i(GLStateCache *cache, GLint location, GLint v0);
+void GLStateCache_useProgram(GLStateCache *cache, GLuint program);
+void GLStateCache_viewport(GLStateCache *cache, GLint x, GLint y,
+		GLsizei width, GLsizei height);
+
+#endif
@@ -15,8 +15,14 @@
 // Typedefs
 typedef struct GPU GPU;
 
+// Renderers
+#define PHILPSX_GPU_RENDERER_OPENGL 0
+#define PHILPSX_GPU_RENDERER_SOFTWARE 1
+
 // Includes
+#include "SaveState.h"
 #include "SystemInterlink.h"
+#include "VramDirtyMap.h"
 #include "WorkQueue.h"
 
 // Public functions
@@ -24,22 +30,44 @@ GPU *construct_GPU(void);
 void destruct_GPU(GPU *gpu);
 void GPU_appendSyncCycles(GPU *gpu, int32_t cycles);
 void GPU_cleanupGL(GPU *gpu);
+void GPU_cleanupSoftRenderer(GPU *gpu);
+void GPU_executeCommand(GpuCommand *command);
 void GPU_executeGPUCycles(GPU *gpu);
-int32_t GPU_howManyDotclockGpuCyclesLeft(GPU *gpu, int32_t gpuCycles);
-int32_t GPU_howManyDotclockIncrements(GPU *gpu, int32_t gpuCycles);
-int32_t GPU_howManyHblankGpuCyclesLeft(GPU *gpu, int32_t gpuCycles);
-int32_t GPU_howManyHblankIncrements(GPU *gpu, int32_t gpuCycles);
+void GPU_flushRenderer(GPU *gpu);
+int64_t GPU_getCommandCount(GPU *gpu);
+int64_t GPU_getFrameCount(GPU *gpu);
+int64_t GPU_getLastFrameTime(GPU *gpu);
+bool GPU_getPresentationStats(GPU *gpu, int64_t *presented, int64_t *dropped);
+int64_t GPU_getSkippedFrameCount(GPU *gpu);
+VramDirtyMap *GPU_getVramDirtyMap(GPU *gpu);
+uint64_t GPU_hashVram(GPU *gpu);
+int32_t GPU_howManyCyclesToNextEvent(GPU *gpu);
+int32_t GPU_howManyGpuCyclesPerDot(GPU *gpu);
+int32_t GPU_howManyGpuCyclesPerScanline(GPU *gpu);
 bool GPU_initGL(GPU *gpu);
+bool GPU_initSoftRenderer(GPU *gpu);
+bool GPU_isIdle(GPU *gpu);
 bool GPU_isInHblank(GPU *gpu);
 bool GPU_isInVblank(GPU *gpu);
+void GPU_loadState(GPU *gpu, SaveState *state);
 int32_t GPU_readResponse(GPU *gpu);
 int32_t GPU_readStatus(GPU *gpu);
+bool GPU_replayTrace(GPU *gpu, const char *path, bool serialise);
+void GPU_saveState(GPU *gpu, SaveState *state);
+void GPU_setDrawingSuppressed(GPU *gpu, bool suppressed);
+void GPU_setFrameSink(GPU *gpu,
+		void (*frameSink)(void *userData, const uint32_t *pixels,
+		int32_t width, int32_t height), void *userData);
+void GPU_setFrameskip(GPU *gpu, int32_t maxSkippedFrames);
 void GPU_setGLFunctionPointers(GPU *gpu);
 void GPU_setMemoryInterface(GPU *gpu, SystemInterlink *smi);
+void GPU_setPresentationEnabled(GPU *gpu, bool enabled);
 void GPU_setResolution(GPU *gpu, int32_t horizontal, int32_t vertical);
 void GPU_setSDLWindowReference(GPU *gpu, SDL_Window *window);
 void GPU_setWorkQueue(GPU *gpu, WorkQueue *wq);
+void GPU_startTrace(GPU *gpu, const char *path);
 void GPU_submitToGP0(GPU *gpu, int32_t word);
+void GPU_submitToGP0Block(GPU *gpu, const int8_t *data, int32_t wordCount);
 void GPU_submitToGP1(GPU *gpu, int32_t word);
 
 #endif
\ No newline at end of file
@@ -1,8 +1,10 @@
 /*
  * This header file provides the struct definition for a GPU command -
  * essentially this allows us to encapsulate a function pointer with all the
- * state required for it to execute, and then submit it to a queue where it
- * can be executed on the rendering thread.
+ * state required for it to execute on the rendering thread. Commands travel
+ * through the work queue as compact packets, and are decoded into this form
+ * just before execution - the state fields persist between commands, and are
+ * only updated when the emulator thread submits a change to them.
  * 
  * PhilPSXCommand.h - Copyright Phillip Potter, 2020, under GPLv3
  */
@@ -15,6 +17,25 @@
 // Typedefs
 typedef struct GpuCommand GpuCommand;
 
+// Maximum number of parameters a command can carry
+#define PHILPSX_GPUCOMMAND_MAX_PARAMETERS 12
+
+// Identifiers for the state fields, used when submitting state changes
+#define PHILPSX_GPUCOMMAND_STATUS_REGISTER 0
+#define PHILPSX_GPUCOMMAND_DRAWING_AREA_TOP_LEFT 1
+#define PHILPSX_GPUCOMMAND_DRAWING_AREA_BOTTOM_RIGHT 2
+#define PHILPSX_GPUCOMMAND_DRAWING_OFFSET 3
+#define PHILPSX_GPUCOMMAND_TEXTURE_WINDOW 4
+#define PHILPSX_GPUCOMMAND_X_START 5
+#define PHILPSX_GPUCOMMAND_Y_START 6
+#define PHILPSX_GPUCOMMAND_X1 7
+#define PHILPSX_GPUCOMMAND_X2 8
+#define PHILPSX_GPUCOMMAND_Y1 9
+#define PHILPSX_GPUCOMMAND_Y2 10
+#define PHILPSX_GPUCOMMAND_REAL_HORIZONTAL_RES 11
+#define PHILPSX_GPUCOMMAND_REAL_VERTICAL_RES 12
+#define PHILPSX_GPUCOMMAND_STATE_COUNT 13
+
 // Includes
 #include "GPU.h"
 
@@ -41,6 +62,8 @@ struct GpuCommand {
 	int32_t parameter10;
 	int32_t parameter11;
 	int32_t parameter12;
+	
+	// State - this is kept up to date by the rendering thread
 	int32_t statusRegister;
 	int32_t drawingAreaTopLeft;
 	int32_t drawingAreaBottomRight;
@@ -0,0 +1,35 @@
+/*
+ * This header file provides the public API for a GPU trace file, which
+ * records the words written to GP0 and GP1, reads of GPUREAD and the end of
+ * each frame, after a snapshot of vram taken when the trace started. A trace
+ * is either being written or read, never both.
+ *
+ * GpuTrace.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_GPUTRACE_HEADER
+#define PHILPSX_GPUTRACE_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Record types - GP0 and GP1 records carry the word written, while read and
+// frame records carry nothing
+#define PHILPSX_GPUTRACE_GP0 0
+#define PHILPSX_GPUTRACE_GP1 1
+#define PHILPSX_GPUTRACE_READ 2
+#define PHILPSX_GPUTRACE_FRAME 3
+
+// Size of the vram snapshot, as 1024x512 little-endian 16-bit pixels
+#define PHILPSX_GPUTRACE_VRAM_SIZE (1024 * 512 * 2)
+
+// Typedefs
+typedef struct GpuTrace GpuTrace;
+
+// Public functions
+GpuTrace *construct_GpuTrace(const char *path, int8_t *vram, bool writing);
+void destruct_GpuTrace(GpuTrace *trace);
+bool GpuTrace_readRecord(GpuTrace *trace, int32_t *type, int32_t *word);
+bool GpuTrace_writeRecord(GpuTrace *trace, int32_t type, int32_t word);
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ * This header file provides the public API for the GTE conformance check and
+ * micro-benchmark, which runs every GTE function over a fixed series of
+ * register states, checks the results against recorded digests and times
+ * each function.
+ *
+ * GteBench.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_GTEBENCH_HEADER
+#define PHILPSX_GTEBENCH_HEADER
+
+// System includes
+#include <stdbool.h>
+
+// Public functions
+bool GteBench_run(bool timed);
+
+#endif
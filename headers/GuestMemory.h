@@ -0,0 +1,30 @@
+/*
+ * This header file provides the public API for guest memory, which places a
+ * component's large buffers (such as RAM and the BIOS) in one mapping, each
+ * starting on a 2 MiB boundary with inaccessible pages after it to catch
+ * overruns. Regions that are a whole number of 2 MiB pages long are backed
+ * by huge pages where the host has them, to cut TLB misses. Every region
+ * starts out zeroed.
+ *
+ * GuestMemory.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_GUESTMEMORY_HEADER
+#define PHILPSX_GUESTMEMORY_HEADER
+
+// System includes
+#include <stddef.h>
+#include <stdint.h>
+
+// Most regions a single mapping can hold
+#define PHILPSX_GUESTMEMORY_MAX_REGIONS 4
+
+// Typedefs
+typedef struct GuestMemory GuestMemory;
+
+// Public functions
+GuestMemory *construct_GuestMemory(const size_t *regionSizes,
+		int32_t regionCount);
+void destruct_GuestMemory(GuestMemory *gm);
+void *GuestMemory_getRegion(GuestMemory *gm, int32_t region);
+
+#endif
\ No newline at end of file
@@ -8,15 +8,30 @@
 #ifndef PHILPSX_INSTRUCTION_CACHE_ALL_HEADER
 #define PHILPSX_INSTRUCTION_CACHE_ALL_HEADER
 
+// Includes
+#include "GuestMemory.h"
+
+// Cache geometry - 256 lines of four words each
+#define PHILPSX_ICACHE_LINE_COUNT 256
+#define PHILPSX_ICACHE_LINE_WORDS 4
+
+// Valid flag, packed into the bottom bit of each tag as the tag itself only
+// uses the top 20 bits
+#define PHILPSX_ICACHE_VALID 0x1
+
 /*
  * This struct models the R3051 instruction cache.
  */
 struct InstructionCache {
 	
-	// Cache variables
-	int8_t *cacheData;
-	int32_t *cacheTag;
-	bool *cacheValid;
+	// Cache variables - the tag of each line holds bits 12-31 of the
+	// address along with the valid flag, and the data is held as
+	// host-native words
+	uint32_t *cacheTag;
+	int32_t *cacheData;
+
+	// Guest memory holding both arrays
+	GuestMemory *memory;
 };
 
 // Includes
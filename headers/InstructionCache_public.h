@@ -29,6 +29,6 @@ void InstructionCache_writeWord(InstructionCache *cache, Cop0 *sccp,
 void InstructionCache_writeByte(InstructionCache *cache, Cop0 *sccp,
 		int32_t address, int8_t value);
 void InstructionCache_refillLine(InstructionCache *cache, Cop0 *sccp,
-		SystemInterlink *system, int32_t address);
+		SystemInterlink *system, int32_t address, const int8_t *lineData);
 
 #endif
\ No newline at end of file
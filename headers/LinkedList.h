@@ -9,7 +9,8 @@
  * operations individually when enabled.
  * 
  * The linked list is backed by individual nodes which refer to each other, one
- * to the next.
+ * to the next. Nodes are allocated from a pool belonging to the list, and a
+ * wipe gives them all back at once.
  * 
  * LinkedList.h - Copyright Phillip Potter, 2020, under GPLv3
  */
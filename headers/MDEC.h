@@ -0,0 +1,33 @@
+/*
+ * This header file provides the public API for the MDEC (motion decoder) of
+ * the PlayStation, which decompresses the macroblocks used for FMV.
+ * 
+ * MDEC.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_MDEC_HEADER
+#define PHILPSX_MDEC_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct MDEC MDEC;
+
+// Includes
+#include "SaveState.h"
+#include "SystemInterlink.h"
+
+// Public functions
+MDEC *construct_MDEC(void);
+void destruct_MDEC(MDEC *mdec);
+bool MDEC_hasOutput(MDEC *mdec);
+void MDEC_loadState(MDEC *mdec, SaveState *state);
+void MDEC_readBlock(MDEC *mdec, int8_t *data, int32_t wordCount);
+int32_t MDEC_readWord(MDEC *mdec, int32_t address);
+void MDEC_saveState(MDEC *mdec, SaveState *state);
+void MDEC_setMemoryInterface(MDEC *mdec, SystemInterlink *smi);
+void MDEC_writeBlock(MDEC *mdec, const int8_t *data, int32_t wordCount);
+void MDEC_writeWord(MDEC *mdec, int32_t address, int32_t word);
+
+#endif
\ No newline at end of file
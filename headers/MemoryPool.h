@@ -0,0 +1,28 @@
+/*
+ * This header file provides the public API for a memory pool, which hands
+ * out objects of one fixed size from large blocks, so that containers and
+ * other short-lived objects don't need a malloc and free of their own. Freed
+ * objects are reused before the pool grows, and a reset takes every object
+ * back at once while keeping the blocks for next time. The pool doesn't
+ * lock, so it should only be used from one thread, or under the lock of
+ * whatever owns it.
+ *
+ * MemoryPool.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_MEMORYPOOL_HEADER
+#define PHILPSX_MEMORYPOOL_HEADER
+
+// System includes
+#include <stddef.h>
+
+// Typedefs
+typedef struct MemoryPool MemoryPool;
+
+// Public functions
+MemoryPool *construct_MemoryPool(size_t objectSize, size_t objectsPerBlock);
+void destruct_MemoryPool(MemoryPool *pool);
+void *MemoryPool_allocate(MemoryPool *pool);
+void MemoryPool_free(MemoryPool *pool, void *object);
+void MemoryPool_reset(MemoryPool *pool);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+/*
+ * This header file provides the public API for the performance counters,
+ * which count what each subsystem is doing from whichever thread it runs
+ * on. They are compiled out unless PHILPSX_PERF_COUNTERS is defined, in
+ * which case PHILPSX_PERF_ADD costs a thread-local add.
+ *
+ * PerfCounters.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_PERFCOUNTERS_HEADER
+#define PHILPSX_PERFCOUNTERS_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Counters - the ones that are groups are indexed by adding the region,
+// channel, primitive type or GTE opcode to the first of them
+#define PHILPSX_PERF_INSTRUCTIONS 0
+#define PHILPSX_PERF_EXCEPTIONS 1
+#define PHILPSX_PERF_INTERRUPTS 2
+#define PHILPSX_PERF_MMIO 3
+#define PHILPSX_PERF_DMA_WORDS 13
+#define PHILPSX_PERF_GPU_PRIMITIVES 20
+#define PHILPSX_PERF_WORKQUEUE_COMMANDS 27
+#define PHILPSX_PERF_WORKQUEUE_DEPTH 28
+#define PHILPSX_PERF_WORKQUEUE_STALLS 29
+#define PHILPSX_PERF_WORKQUEUE_STALL_NS 30
+#define PHILPSX_PERF_CD_SECTORS 31
+#define PHILPSX_PERF_CD_XA_SECTORS 32
+#define PHILPSX_PERF_GTE_OPS 33
+#define PHILPSX_PERF_COUNTER_COUNT 97
+
+// MMIO regions, within the I/O port region at 0x1F801000
+#define PHILPSX_PERF_MMIO_MEMCTRL 0
+#define PHILPSX_PERF_MMIO_PERIPHERAL 1
+#define PHILPSX_PERF_MMIO_INTERRUPT 2
+#define PHILPSX_PERF_MMIO_DMA 3
+#define PHILPSX_PERF_MMIO_TIMERS 4
+#define PHILPSX_PERF_MMIO_CDROM 5
+#define PHILPSX_PERF_MMIO_GPU 6
+#define PHILPSX_PERF_MMIO_MDEC 7
+#define PHILPSX_PERF_MMIO_SPU 8
+#define PHILPSX_PERF_MMIO_OTHER 9
+
+// GPU primitive types
+#define PHILPSX_PERF_PRIMITIVE_POLYGON 0
+#define PHILPSX_PERF_PRIMITIVE_RECTANGLE 1
+#define PHILPSX_PERF_PRIMITIVE_LINE 2
+#define PHILPSX_PERF_PRIMITIVE_FILL 3
+#define PHILPSX_PERF_PRIMITIVE_VRAM_COPY 4
+#define PHILPSX_PERF_PRIMITIVE_VRAM_WRITE 5
+#define PHILPSX_PERF_PRIMITIVE_VRAM_READ 6
+
+// Passed in place of a thread index to read the sum over every thread
+#define PHILPSX_PERF_ALL_THREADS -1
+
+// Public functions
+void PerfCounters_cleanup(void);
+const char *PerfCounters_getName(int32_t counter);
+int32_t PerfCounters_getMmioRegion(int32_t address);
+int32_t PerfCounters_getThreadCount(void);
+const char *PerfCounters_getThreadName(int32_t thread);
+int64_t PerfCounters_getTime(void);
+bool PerfCounters_isEnabled(void);
+void PerfCounters_read(int32_t thread, int64_t *values);
+int64_t *PerfCounters_registerThread(void);
+void PerfCounters_setThreadName(const char *name);
+
+// Counting, which must never happen from a thread as it is ending
+#ifdef PHILPSX_PERF_COUNTERS
+extern _Thread_local int64_t *PerfCounters_threadValues;
+
+static inline void PerfCounters_add(int32_t counter, int64_t value)
+{
+	int64_t *values = PerfCounters_threadValues;
+	if (!values && !(values = PerfCounters_registerThread()))
+		return;
+	__atomic_store_n(&values[counter], values[counter] + value,
+			__ATOMIC_RELAXED);
+}
+
+#define PHILPSX_PERF_ADD(counter, value) PerfCounters_add((counter), (value))
+#else
+#define PHILPSX_PERF_ADD(counter, value) ((void)0)
+#endif
+
+#endif
\ No newline at end of file
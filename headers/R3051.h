@@ -14,19 +14,41 @@
 // Typedefs
 typedef struct R3051 R3051;
 
+// Execution modes
+#define PHILPSX_R3051_MODE_INTERPRETER 0
+#define PHILPSX_R3051_MODE_RECOMPILER 1
+#define PHILPSX_R3051_MODE_CACHED_INTERPRETER 2
+
 // Includes
+#include "CD.h"
 #include "Cop0_public.h"
 #include "Cop2_public.h"
+#include "R3051Debugger.h"
+#include "R3051Profiler.h"
+#include "SaveState.h"
 #include "SystemInterlink.h"
 
 // Public functions
 R3051 *construct_R3051(void);
 void destruct_R3051(R3051 *cpu);
+bool R3051_attachDebugger(R3051 *cpu);
+bool R3051_attachProfiler(R3051 *cpu);
 int64_t R3051_executeInstructions(R3051 *cpu);
 int32_t R3051_getBusHolder(R3051 *cpu);
 Cop0 *R3051_getCop0(R3051 *cpu);
 Cop2 *R3051_getCop2(R3051 *cpu);
+R3051Debugger *R3051_getDebugger(R3051 *cpu);
+int64_t R3051_getIdleCyclesSkipped(R3051 *cpu);
+int64_t R3051_getInstructionCount(R3051 *cpu);
+R3051Profiler *R3051_getProfiler(R3051 *cpu);
+void R3051_invalidateCodePage(R3051 *cpu, int32_t physicalAddress);
+void R3051_loadState(R3051 *cpu, SaveState *state);
+void R3051_saveState(R3051 *cpu, SaveState *state);
+bool R3051_setBootCD(R3051 *cpu, CD *cd);
+bool R3051_setBootExe(R3051 *cpu, const char *path);
 void R3051_setBusHolder(R3051 *cpu, int32_t holder);
+bool R3051_setExecutionMode(R3051 *cpu, int32_t mode);
+bool R3051_setHleFunctions(R3051 *cpu, const char *functions);
 void R3051_setMemoryInterface(R3051 *cpu, SystemInterlink *system);
 
 #endif
\ No newline at end of file
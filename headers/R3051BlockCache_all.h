@@ -0,0 +1,72 @@
+/*
+ * This header file provides implementation details regarding the structs
+ * for the block cache of the R3051 processor, and also includes its public
+ * header.
+ * 
+ * R3051BlockCache_all.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051_BLOCK_CACHE_ALL_HEADER
+#define PHILPSX_R3051_BLOCK_CACHE_ALL_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Includes
+#include "R3051BlockCache_public.h"
+
+/*
+ * This struct describes a basic block of R3051 code. Writes to memory
+ * invalidate any blocks in the page written to, and we keep a copy of the
+ * instruction bytes for the rare cases where that isn't enough. The data
+ * pointer holds whatever the user of the cache has
+ * translated the block into, and is NULL until then.
+ */
+struct R3051Block {
+
+	// Location and size of block
+	int32_t virtualAddress;
+	int32_t physicalAddress;
+	int32_t instructionCount;
+
+	// This tells us if the block is fetched from the instruction cache, and
+	// if so whether the cache held different code to memory when the block
+	// was built, meaning its contents must be checked before each use
+	bool cached;
+	bool verifyContents;
+
+	// This tells us if the block has been invalidated by a write to its page,
+	// and links it into the list of such blocks waiting to be freed
+	bool invalidated;
+	R3051Block *nextRetired;
+
+	// Instruction bytes as stored in memory, and host pointer to the
+	// memory they came from (NULL if it is read-only)
+	int8_t *sourceBytes;
+	int8_t *memory;
+
+	// Stall cycles for fetching each instruction
+	int32_t *stallCycles;
+
+	// Translated form of block
+	void *data;
+};
+
+/*
+ * This struct contains the lookup tables for blocks, which are indexed by
+ * physical word address.
+ */
+struct R3051BlockCache {
+
+	// Block lookup tables
+	R3051Block **ramBlocks;
+	R3051Block **biosBlocks;
+
+	// Invalidated blocks, which are freed once no block is running
+	R3051Block *retiredBlocks;
+
+	// This frees the translated form of a block
+	void (*destructBlockData)(void *data);
+};
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * This header file provides the public API for the block cache shared by the
+ * cached interpreter and the recompiler of the R3051 processor.
+ * 
+ * R3051BlockCache_public.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051_BLOCK_CACHE_PUBLIC_HEADER
+#define PHILPSX_R3051_BLOCK_CACHE_PUBLIC_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct R3051Block R3051Block;
+typedef struct R3051BlockCache R3051BlockCache;
+
+// The most instructions placed in one block, and the size of the pages
+// that blocks are confined to
+#define PHILPSX_R3051BLOCKCACHE_MAX_BLOCK_LENGTH 256
+#define PHILPSX_R3051BLOCKCACHE_PAGE_SIZE 0x1000
+
+// Includes
+#include "R3051.h"
+
+// Public functions
+R3051BlockCache *construct_R3051BlockCache(
+		void (*destructBlockData)(void *data));
+void destruct_R3051BlockCache(R3051BlockCache *cache);
+void R3051BlockCache_flush(R3051BlockCache *cache);
+R3051Block *R3051BlockCache_getBlock(R3051BlockCache *cache, R3051 *cpu);
+void R3051BlockCache_invalidatePage(R3051BlockCache *cache,
+		int32_t physicalAddress);
+bool R3051BlockCache_needsRevalidation(int32_t instruction);
+bool R3051Block_revalidate(R3051Block *block, R3051 *cpu, int32_t index);
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * This header file provides the public API for the debugger of the R3051
+ * implementation of PhilPSX, which stops the processor at breakpoints,
+ * watchpoints and after single steps, and shows its registers and memory.
+ *
+ * R3051Debugger.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051DEBUGGER_HEADER
+#define PHILPSX_R3051DEBUGGER_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct R3051Debugger R3051Debugger;
+
+// Commands, which take up to two arguments
+#define PHILPSX_R3051DEBUGGER_COMMAND_HALT 0
+#define PHILPSX_R3051DEBUGGER_COMMAND_CONTINUE 1
+#define PHILPSX_R3051DEBUGGER_COMMAND_STEP 2
+#define PHILPSX_R3051DEBUGGER_COMMAND_RUN_TO 3
+#define PHILPSX_R3051DEBUGGER_COMMAND_BREAK 4
+#define PHILPSX_R3051DEBUGGER_COMMAND_WATCH_READ 5
+#define PHILPSX_R3051DEBUGGER_COMMAND_WATCH_WRITE 6
+#define PHILPSX_R3051DEBUGGER_COMMAND_REMOVE 7
+#define PHILPSX_R3051DEBUGGER_COMMAND_REGISTERS 8
+#define PHILPSX_R3051DEBUGGER_COMMAND_MEMORY 9
+#define PHILPSX_R3051DEBUGGER_COMMAND_HELP 10
+
+// What the processor should do about the next instruction - run it however
+// the execution mode likes, interpret it on its own, or stop before it
+#define PHILPSX_R3051DEBUGGER_RUN 0
+#define PHILPSX_R3051DEBUGGER_INTERPRET 1
+#define PHILPSX_R3051DEBUGGER_BREAK 2
+
+// Includes
+#include "R3051.h"
+
+// Public functions
+R3051Debugger *construct_R3051Debugger(R3051 *cpu);
+void destruct_R3051Debugger(R3051Debugger *debugger);
+void R3051Debugger_checkAccess(R3051Debugger *debugger,
+		int32_t physicalAddress, bool write);
+int32_t R3051Debugger_checkExecution(R3051Debugger *debugger);
+void R3051Debugger_handleCommand(R3051Debugger *debugger, int32_t command,
+		int32_t argument0, int32_t argument1);
+bool R3051Debugger_isHalted(R3051Debugger *debugger);
+bool R3051Debugger_parseCommand(const char *line, int32_t *command,
+		int32_t *argument0, int32_t *argument1);
+void R3051Debugger_unmapWatchedPages(R3051Debugger *debugger);
+
+#endif
\ No newline at end of file
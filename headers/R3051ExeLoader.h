@@ -0,0 +1,29 @@
+/*
+ * This header file provides the public API for side-loading PS-X EXE
+ * programs into the R3051 implementation of PhilPSX, either from a file or
+ * from the boot file named on a CD, in place of the BIOS shell.
+ *
+ * R3051ExeLoader.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051EXELOADER_HEADER
+#define PHILPSX_R3051EXELOADER_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct R3051ExeLoader R3051ExeLoader;
+
+// Includes
+#include "CD.h"
+#include "R3051.h"
+
+// Public functions
+R3051ExeLoader *construct_R3051ExeLoader(void);
+void destruct_R3051ExeLoader(R3051ExeLoader *loader);
+bool R3051ExeLoader_handleBoot(R3051ExeLoader *loader, R3051 *cpu);
+bool R3051ExeLoader_loadCD(R3051ExeLoader *loader, CD *cd);
+bool R3051ExeLoader_loadFile(R3051ExeLoader *loader, const char *path);
+
+#endif
\ No newline at end of file
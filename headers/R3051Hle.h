@@ -0,0 +1,25 @@
+/*
+ * This header file provides the public API for the high-level emulation of
+ * BIOS kernel functions used by the R3051 implementation of PhilPSX.
+ *
+ * R3051Hle.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051HLE_HEADER
+#define PHILPSX_R3051HLE_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct R3051Hle R3051Hle;
+
+// Includes
+#include "R3051.h"
+
+// Public functions
+R3051Hle *construct_R3051Hle(const char *functions);
+void destruct_R3051Hle(R3051Hle *hle);
+bool R3051Hle_handleCall(R3051Hle *hle, R3051 *cpu);
+
+#endif
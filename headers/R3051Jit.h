@@ -0,0 +1,27 @@
+/*
+ * This header file provides the public API for the R3051 dynamic recompiler
+ * of PhilPSX.
+ *
+ * R3051Jit.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051JIT_HEADER
+#define PHILPSX_R3051JIT_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct R3051Jit R3051Jit;
+
+// Includes
+#include "R3051.h"
+#include "R3051BlockCache_public.h"
+
+// Public functions
+R3051Jit *construct_R3051Jit(R3051BlockCache *blockCache);
+void destruct_R3051Jit(R3051Jit *jit);
+bool R3051Jit_executeBlock(R3051Jit *jit, R3051 *cpu);
+void R3051Jit_flush(R3051Jit *jit);
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * This header file provides the public API for the profiler of the R3051
+ * implementation of PhilPSX, which counts how often each block of code is
+ * entered and how many cycles are spent in it, and samples what called it.
+ *
+ * R3051Profiler.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051PROFILER_HEADER
+#define PHILPSX_R3051PROFILER_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct R3051Profiler R3051Profiler;
+
+// Public functions
+R3051Profiler *construct_R3051Profiler(void);
+void destruct_R3051Profiler(R3051Profiler *profiler);
+bool R3051Profiler_loadSymbols(R3051Profiler *profiler, const char *path);
+void R3051Profiler_printHotBlocks(R3051Profiler *profiler, int32_t count);
+void R3051Profiler_recordBlock(R3051Profiler *profiler, int32_t address,
+		int64_t cycles, int32_t returnAddress);
+bool R3051Profiler_writeFoldedStacks(R3051Profiler *profiler,
+		const char *path);
+
+#endif
\ No newline at end of file
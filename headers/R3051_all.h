@@ -0,0 +1,176 @@
+/*
+ * This header file provides implementation details regarding the struct
+ * for the MIPS R3051 implementation of PhilPSX, so that the recompiler can
+ * share the processor state with the interpreter. It also includes the
+ * public header.
+ *
+ * R3051_all.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051_ALL_HEADER
+#define PHILPSX_R3051_ALL_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Typedefs
+typedef struct MIPSException MIPSException;
+typedef struct R3051MemoryPage R3051MemoryPage;
+
+// Cycles executed are handed on to the system in bulk, just before anything
+// that could observe them such as an I/O access or an interrupt check.
+// Defining PHILPSX_R3051_SYNC_EVERY_INSTRUCTION hands them on after every
+// instruction instead, so that the accuracy of the two can be compared.
+#ifdef PHILPSX_R3051_SYNC_EVERY_INSTRUCTION
+#define R3051_appendSyncCycles(cpu, x) \
+		SystemInterlink_appendSyncCycles((cpu)->system, (x))
+#else
+#define R3051_appendSyncCycles(cpu, x) ((cpu)->pendingSyncCycles += (x))
+#endif
+
+// Size of the pages used for fast memory access
+#define PHILPSX_R3051_PAGE_SHIFT 16
+#define PHILPSX_R3051_PAGE_SIZE (1 << PHILPSX_R3051_PAGE_SHIFT)
+#define PHILPSX_R3051_PAGE_COUNT (1 << (32 - PHILPSX_R3051_PAGE_SHIFT))
+
+// Includes
+#include "Cop0_all.h"
+#include "Cop2_all.h"
+#include "InstructionCache_all.h"
+#include "R3051BlockCache_public.h"
+#include "R3051Debugger.h"
+#include "R3051ExeLoader.h"
+#include "R3051Hle.h"
+#include "R3051Jit.h"
+#include "R3051Profiler.h"
+
+/*
+ * This inner struct models a processor exception, which can occur during
+ * any stage of the pipeline.
+ */
+struct MIPSException {
+
+	// Exception variables
+	int32_t exceptionReason;
+	int32_t programCounterOrigin;
+	int32_t badAddress;
+	int32_t coProcessorNum;
+	bool isInBranchDelaySlot;
+};
+
+/*
+ * This inner struct describes one page of the virtual address space, so
+ * that RAM and BIOS can be accessed without going through the system
+ * interlink. Pages with NULL data pointers must use the system interlink.
+ */
+struct R3051MemoryPage {
+
+	// Host memory backing the page for reads and writes
+	int8_t *readData;
+	int8_t *writeData;
+
+	// Physical address of the start of the page, stall cycles for accessing
+	// it, and whether it goes through the instruction cache
+	int32_t physicalAddress;
+	int32_t stallCycles;
+	bool cacheable;
+};
+
+/*
+ * This struct contains registers, and pointers to subcomponents.
+ */
+struct R3051 {
+
+	// Component ID
+	int32_t componentId;
+
+	// Register definitions
+	int32_t generalRegisters[32];
+	int32_t programCounter;
+	int32_t hiReg;
+	int32_t loReg;
+
+	// Jump address holder and boolean
+	int32_t jumpAddress;
+	bool jumpPending;
+
+	// Co-processor definitions
+	Cop0 sccp;
+	Cop2 gte;
+
+	// Bus holder definition
+	int32_t busHolder;
+
+	// System link
+	SystemInterlink *system;
+
+	// Page table for fast memory access, and the system's bitmap of RAM
+	// pages holding cached code, which fast writes must check
+	R3051MemoryPage *memoryPages;
+	uint32_t *codePages;
+
+	// This stores the current exception
+	MIPSException exception;
+
+	// This stores the instruction cache
+	InstructionCache instructionCache;
+
+	// This tells us if the last instruction was a branch/jump instruction
+	bool prevWasBranch;
+	bool isBranch;
+
+	// This counts the cycles of the current instruction
+	int32_t cycles;
+	int32_t gteCycles;
+	int64_t totalCycles;
+
+	// This counts the cycles not yet handed on to the system
+	int64_t pendingSyncCycles;
+
+	// This stores the execution mode, along with the block cache and the
+	// recompiler if they are in use
+	int32_t executionMode;
+	R3051BlockCache *blockCache;
+	R3051Jit *jit;
+
+	// High-level emulation of kernel functions, if enabled
+	R3051Hle *hle;
+
+	// Program to side-load in place of the BIOS shell, if any, and whether
+	// it is yet to be loaded
+	R3051ExeLoader *exeLoader;
+	bool exeBootPending;
+
+	// Debugger, if attached, and whether it needs asking about each
+	// instruction
+	R3051Debugger *debugger;
+	bool debuggerArmed;
+
+	// Profiler, if attached
+	R3051Profiler *profiler;
+
+	// Idle loop detection - this tells us if the block being run did
+	// anything other than read memory that only changes when an event
+	// happens, and stores the register state at the end of the last
+	// iteration of a loop, along with how many cycles have been skipped
+	bool hadSideEffects;
+	bool idleLoopValid;
+	int32_t idleLoopAddress;
+	int32_t idleGeneralRegisters[32];
+	int32_t idleHiReg;
+	int32_t idleLoReg;
+	int64_t idleCyclesSkipped;
+
+	// Instructions executed so far, for benchmarking
+	int64_t instructionCount;
+};
+
+// Includes
+#include "R3051.h"
+
+// Functions shared with the recompiler and debugger
+void R3051_completeInstruction(R3051 *cpu, int32_t instruction,
+		int32_t tempAddress);
+void R3051_mapMemoryPages(R3051 *cpu);
+
+#endif
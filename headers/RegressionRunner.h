@@ -0,0 +1,19 @@
+/*
+ * This header file provides the public API for the regression runner, which
+ * boots every BIOS and CD listed in a manifest in consoles of their own,
+ * several at a time, and checks the frames they show against recorded
+ * hashes.
+ *
+ * RegressionRunner.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_REGRESSIONRUNNER_HEADER
+#define PHILPSX_REGRESSIONRUNNER_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Public functions
+bool RegressionRunner_run(const char *manifestPath, int32_t jobCount);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,30 @@
+/*
+ * This header file provides the public API for a rewind buffer, which keeps
+ * a history of save states within a fixed memory budget so that emulation
+ * can be stepped back through it.
+ *
+ * RewindBuffer.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_REWINDBUFFER_HEADER
+#define PHILPSX_REWINDBUFFER_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Includes
+#include "SaveState.h"
+
+// Typedefs
+typedef struct RewindBuffer RewindBuffer;
+
+// Public functions
+RewindBuffer *construct_RewindBuffer(int64_t budget);
+void destruct_RewindBuffer(RewindBuffer *rb);
+void RewindBuffer_getStats(RewindBuffer *rb, int32_t *snapshots,
+		int64_t *bytes);
+bool RewindBuffer_isIdle(RewindBuffer *rb);
+bool RewindBuffer_push(RewindBuffer *rb, SaveState *state);
+bool RewindBuffer_stepBack(RewindBuffer *rb, SaveState *state);
+
+#endif
\ No newline at end of file
@@ -1,7 +1,6 @@
 /*
  * This header file provides the public API for the SPU (sound chip) of the
- * PlayStation. At the moment, most functionality is stubbed out/not
- * implemented.
+ * PlayStation.
  * 
  * SPU.h - Copyright Phillip Potter, 2020, under GPLv3
  */
@@ -15,13 +14,23 @@
 typedef struct SPU SPU;
 
 // Includes
+#include "SaveState.h"
 #include "SystemInterlink.h"
 
 // Public functions
 SPU *construct_SPU(void);
 void destruct_SPU(SPU *spu);
-void SPU_writeByte(SPU *spu, int32_t address, int8_t value);
+void SPU_appendSyncCycles(SPU *spu, int32_t cycles);
+void SPU_executeSPUCycles(SPU *spu);
+int64_t SPU_getDroppedFrameCount(SPU *spu);
+int32_t SPU_howManyCyclesToNextEvent(SPU *spu);
+void SPU_loadState(SPU *spu, SaveState *state);
+void SPU_readBlock(SPU *spu, int8_t *data, int32_t wordCount);
 int8_t SPU_readByte(SPU *spu, int32_t address);
+int32_t SPU_readSamples(SPU *spu, int16_t *samples, int32_t frameCount);
+void SPU_saveState(SPU *spu, SaveState *state);
 void SPU_setMemoryInterface(SPU *spu, SystemInterlink *smi);
+void SPU_writeBlock(SPU *spu, const int8_t *data, int32_t wordCount);
+void SPU_writeByte(SPU *spu, int32_t address, int8_t value);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+/*
+ * This header file provides the public API for a save state, which holds a
+ * snapshot of the whole console in memory so it can be written to or read
+ * from a file in one go.
+ *
+ * SaveState.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_SAVESTATE_HEADER
+#define PHILPSX_SAVESTATE_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct SaveState SaveState;
+
+// Public functions
+SaveState *construct_SaveState(void);
+void destruct_SaveState(SaveState *state);
+void SaveState_clear(SaveState *state);
+void SaveState_fail(SaveState *state);
+const int8_t *SaveState_getData(SaveState *state);
+int32_t SaveState_getSize(SaveState *state);
+bool SaveState_hasFailed(SaveState *state);
+bool SaveState_isFinished(SaveState *state);
+bool SaveState_loadFile(SaveState *state, const char *path);
+void SaveState_read(SaveState *state, void *data, int32_t length);
+const int8_t *SaveState_readRegion(SaveState *state, int32_t length);
+int8_t *SaveState_reserve(SaveState *state, int32_t length);
+void SaveState_rewind(SaveState *state);
+bool SaveState_saveFile(SaveState *state, const char *path);
+void SaveState_write(SaveState *state, const void *data, int32_t length);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+ * This header file provides the public API for the software renderer, which
+ * draws the GPU's commands into its own copy of vram on the CPU, for use
+ * where OpenGL 4.5 isn't available. Drawing is shared out between a pool of
+ * threads, each owning a set of horizontal bands of vram. It should only be
+ * used from the rendering thread.
+ *
+ * SoftRenderer.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_SOFTRENDERER_HEADER
+#define PHILPSX_SOFTRENDERER_HEADER
+
+// System includes
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+// Typedefs
+typedef struct SoftRenderer SoftRenderer;
+
+// Includes
+#include "GpuCommand.h"
+#include "VramDirtyMap.h"
+
+// Public functions
+SoftRenderer *construct_SoftRenderer(VramDirtyMap *dirtyMap);
+void destruct_SoftRenderer(SoftRenderer *sr);
+void SoftRenderer_copyRectangle(SoftRenderer *sr, GpuCommand *command);
+void SoftRenderer_displayScreen(SoftRenderer *sr, SDL_Window *window,
+		int32_t topX, int32_t topY, int32_t width, int32_t height,
+		int32_t realHorizontalRes, int32_t realVerticalRes);
+void SoftRenderer_drawLine(SoftRenderer *sr, GpuCommand *command);
+void SoftRenderer_drawPolygon(SoftRenderer *sr, GpuCommand *command);
+void SoftRenderer_drawRectangle(SoftRenderer *sr, GpuCommand *command);
+void SoftRenderer_fillRectangle(SoftRenderer *sr, GpuCommand *command);
+const uint32_t *SoftRenderer_readDisplay(SoftRenderer *sr, int32_t topX,
+		int32_t topY, int32_t width, int32_t height);
+void SoftRenderer_readRectangle(SoftRenderer *sr, GpuCommand *command,
+		int8_t *buffer);
+void SoftRenderer_readVram(SoftRenderer *sr, int8_t *vram);
+void SoftRenderer_writeRectangle(SoftRenderer *sr, GpuCommand *command,
+		const int8_t *data);
+void SoftRenderer_writeVram(SoftRenderer *sr, const int8_t *vram);
+
+#endif
@@ -10,8 +10,18 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Access widths that I/O port handlers can be registered for
+#define PHILPSX_IO_BYTE 0
+#define PHILPSX_IO_HALFWORD 1
+#define PHILPSX_IO_WORD 2
+#define PHILPSX_IO_WIDTH_COUNT 3
+
 // Typedefs
 typedef struct SystemInterlink SystemInterlink;
+typedef int32_t (*SystemInterlinkReadHandler)(void *component,
+		int32_t address);
+typedef void (*SystemInterlinkWriteHandler)(void *component, int32_t address,
+		int32_t value);
 
 // Includes
 #include "CDROMDrive.h"
@@ -19,13 +29,15 @@ typedef struct SystemInterlink SystemInterlink;
 #include "R3051.h"
 #include "DMAArbiter.h"
 #include "GPU.h"
+#include "SaveState.h"
 #include "SPU.h"
 
 // Public functions
 SystemInterlink *construct_SystemInterlink(const char *biosPath);
 void destruct_SystemInterlink(SystemInterlink *smi);
 void SystemInterlink_appendSyncCycles(SystemInterlink *smi, int32_t cycles);
-void SystemInterlink_executeGPUCycles(SystemInterlink *smi);
+int8_t *SystemInterlink_getBiosArray(SystemInterlink *smi);
+uint32_t *SystemInterlink_getCodePageBitmap(SystemInterlink *smi);
 CDROMDrive *SystemInterlink_getCdrom(SystemInterlink *smi);
 ControllerIO *SystemInterlink_getControllerIO(SystemInterlink *smi);
 R3051 *SystemInterlink_getCpu(SystemInterlink *smi);
@@ -35,16 +47,29 @@ int8_t *SystemInterlink_getRamArray(SystemInterlink *smi);
 SPU *SystemInterlink_getSpu(SystemInterlink *smi);
 int32_t SystemInterlink_howManyStallCycles(SystemInterlink *smi,
 		int32_t address);
-void SystemInterlink_incrementInterruptCounters(SystemInterlink *smi);
 bool SystemInterlink_instructionCacheEnabled(SystemInterlink *smi);
-bool SystemInterlink_okToIncrement(SystemInterlink *smi, int64_t address);
+void SystemInterlink_invalidateCode(SystemInterlink *smi, int32_t address,
+		int32_t length);
+bool SystemInterlink_irqLineAsserted(SystemInterlink *smi);
+void SystemInterlink_loadState(SystemInterlink *smi, SaveState *state);
+void SystemInterlink_markCodePage(SystemInterlink *smi, int32_t address);
+bool SystemInterlink_processEvents(SystemInterlink *smi);
 int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address);
+int32_t SystemInterlink_readHalfWord(SystemInterlink *smi, int32_t address);
+int32_t SystemInterlink_readInterruptMask(SystemInterlink *smi);
 int32_t SystemInterlink_readInterruptStatus(SystemInterlink *smi);
 int32_t SystemInterlink_readWord(SystemInterlink *smi, int32_t address);
-void SystemInterlink_resyncAllTimers(SystemInterlink *smi);
+void SystemInterlink_registerIoHandlers(SystemInterlink *smi, int32_t address,
+		int32_t length, int32_t width, void *component,
+		SystemInterlinkReadHandler readHandler,
+		SystemInterlinkWriteHandler writeHandler);
+void SystemInterlink_saveState(SystemInterlink *smi, SaveState *state);
 bool SystemInterlink_scratchpadEnabled(SystemInterlink *smi);
+int64_t SystemInterlink_skipToNextEvent(SystemInterlink *smi,
+		int64_t cyclesPerIteration);
 void SystemInterlink_setCDROMInterruptDelay(SystemInterlink *smi,
 		int32_t delay);
+void SystemInterlink_setCDROMSectorDelay(SystemInterlink *smi, int32_t delay);
 void SystemInterlink_setCDROMInterruptEnabled(SystemInterlink *smi,
 		bool enabled);
 void SystemInterlink_setCDROMInterruptNumber(SystemInterlink *smi,
@@ -54,14 +79,21 @@ void SystemInterlink_setCdrom(SystemInterlink *smi,
 void SystemInterlink_setControllerIO(SystemInterlink *smi,
 		ControllerIO *cio);
 void SystemInterlink_setCpu(SystemInterlink *smi, R3051 *cpu);
+void SystemInterlink_setDMACompletionDelay(SystemInterlink *smi,
+		int32_t delay);
 void SystemInterlink_setDMAInterruptDelay(SystemInterlink *smi, int32_t delay);
 void SystemInterlink_setDma(SystemInterlink *smi, DMAArbiter *dma);
 void SystemInterlink_setGPUInterruptDelay(SystemInterlink *smi, int32_t delay);
 void SystemInterlink_setGpu(SystemInterlink *smi, GPU *gpu);
+void SystemInterlink_setSIOInterruptDelay(SystemInterlink *smi, int32_t delay);
+void SystemInterlink_setSIOTransferDelay(SystemInterlink *smi, int32_t delay);
+void SystemInterlink_setSPUInterruptDelay(SystemInterlink *smi, int32_t delay);
 void SystemInterlink_setSpu(SystemInterlink *smi, SPU *spu);
 bool SystemInterlink_tagTestEnabled(SystemInterlink *smi);
 void SystemInterlink_writeByte(SystemInterlink *smi, int32_t address,
 		int8_t value);
+void SystemInterlink_writeHalfWord(SystemInterlink *smi, int32_t address,
+		int32_t halfWord);
 void SystemInterlink_writeInterruptStatus(SystemInterlink *smi,
 		int32_t interruptStatus);
 void SystemInterlink_writeWord(SystemInterlink *smi, int32_t address,
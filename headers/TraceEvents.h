@@ -0,0 +1,83 @@
+/*
+ * This header file provides the public API for trace events, which record
+ * how long things take on whichever thread they run on, for viewing on one
+ * timeline as a Chrome trace. They are compiled out unless
+ * PHILPSX_TRACE_EVENTS is defined, and even then nothing is recorded until
+ * TraceEvents_start is called. While recording, an event costs two clock
+ * reads and storing it to the thread's own buffer.
+ *
+ * TraceEvents.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_TRACEEVENTS_HEADER
+#define PHILPSX_TRACEEVENTS_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Events, with GPU commands split up by type
+#define PHILPSX_TRACE_CPU_BATCH 0
+#define PHILPSX_TRACE_DMA 1
+#define PHILPSX_TRACE_GPU_POLYGON 2
+#define PHILPSX_TRACE_GPU_RECTANGLE 3
+#define PHILPSX_TRACE_GPU_LINE 4
+#define PHILPSX_TRACE_GPU_FILL 5
+#define PHILPSX_TRACE_GPU_VRAM_COPY 6
+#define PHILPSX_TRACE_GPU_VRAM_WRITE 7
+#define PHILPSX_TRACE_GPU_VRAM_READ 8
+#define PHILPSX_TRACE_GPU_DISPLAY 9
+#define PHILPSX_TRACE_GPU_SYNC 10
+#define PHILPSX_TRACE_MEMORY_BARRIER 11
+#define PHILPSX_TRACE_VRAM_READ_WAIT 12
+#define PHILPSX_TRACE_SWAP 13
+#define PHILPSX_TRACE_CD_SECTOR 14
+#define PHILPSX_TRACE_WORKQUEUE_FULL 15
+#define PHILPSX_TRACE_WORKQUEUE_COMPLETION 16
+#define PHILPSX_TRACE_WORKQUEUE_IDLE 17
+#define PHILPSX_TRACE_EVENT_COUNT 18
+
+// Passed in place of an argument for events that don't have one
+#define PHILPSX_TRACE_NO_ARGUMENT -1
+
+// Cycles of R3051 code recorded as one CPU batch at most, which is about
+// a millisecond - blocks are too short to be recorded one at a time
+#define PHILPSX_TRACE_CPU_BATCH_CYCLES 33868
+
+// Public functions
+void TraceEvents_cleanup(void);
+int64_t TraceEvents_getTime(void);
+bool TraceEvents_isEnabled(void);
+void TraceEvents_record(int32_t event, int64_t start, int32_t argument);
+void TraceEvents_setThreadName(const char *name);
+bool TraceEvents_start(void);
+bool TraceEvents_write(const char *path);
+
+// Recording, which must never happen from a thread as it is ending - an
+// event is begun by keeping the time from PHILPSX_TRACE_BEGIN, which is 0
+// when not recording, and ended by passing it to PHILPSX_TRACE_END
+#ifdef PHILPSX_TRACE_EVENTS
+extern bool TraceEvents_recording;
+
+static inline int64_t TraceEvents_begin(void)
+{
+	if (!__atomic_load_n(&TraceEvents_recording, __ATOMIC_RELAXED))
+		return 0;
+	return TraceEvents_getTime();
+}
+
+static inline void TraceEvents_end(int32_t event, int64_t start,
+		int32_t argument)
+{
+	if (start != 0)
+		TraceEvents_record(event, start, argument);
+}
+
+#define PHILPSX_TRACE_BEGIN() TraceEvents_begin()
+#define PHILPSX_TRACE_END(event, start, argument) \
+		TraceEvents_end((event), (start), (argument))
+#else
+#define PHILPSX_TRACE_BEGIN() ((int64_t)0)
+#define PHILPSX_TRACE_END(event, start, argument) ((void)(start))
+#endif
+
+#endif
\ No newline at end of file
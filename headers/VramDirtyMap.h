@@ -0,0 +1,42 @@
+/*
+ * This header file provides the public API for a vram dirty map, which
+ * records which 16x16 tiles of vram have been written to. Each subsystem
+ * that wants to know about changes registers as a client, and then queries
+ * and clears its own copy of the map - writes mark every client's copy.
+ * Areas use the PlayStation's vram coordinates (top row first), and wrap
+ * around the edges of vram as the GPU does. It can be used from any thread.
+ *
+ * VramDirtyMap.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_VRAMDIRTYMAP_HEADER
+#define PHILPSX_VRAMDIRTYMAP_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Map layout - each row of tiles is one 64-bit mask, with bit 0 for the
+// leftmost tile
+#define PHILPSX_VRAMDIRTYMAP_TILE_SIZE 16
+#define PHILPSX_VRAMDIRTYMAP_ROWS 32
+#define PHILPSX_VRAMDIRTYMAP_MAX_CLIENTS 8
+
+// Typedefs
+typedef struct VramDirtyMap VramDirtyMap;
+
+// Public functions
+VramDirtyMap *construct_VramDirtyMap(void);
+void destruct_VramDirtyMap(VramDirtyMap *map);
+int32_t VramDirtyMap_addClient(VramDirtyMap *map);
+void VramDirtyMap_clearAll(VramDirtyMap *map, int32_t client);
+void VramDirtyMap_clearArea(VramDirtyMap *map, int32_t client, int32_t x,
+		int32_t y, int32_t width, int32_t height);
+uint64_t VramDirtyMap_getTileRow(VramDirtyMap *map, int32_t client,
+		int32_t row);
+bool VramDirtyMap_isAreaDirty(VramDirtyMap *map, int32_t client, int32_t x,
+		int32_t y, int32_t width, int32_t height);
+void VramDirtyMap_markAll(VramDirtyMap *map);
+void VramDirtyMap_markArea(VramDirtyMap *map, int32_t x, int32_t y,
+		int32_t width, int32_t height);
+
+#endif
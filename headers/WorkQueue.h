@@ -10,6 +10,7 @@
 
 // System includes
 #include <stdbool.h>
+#include <stdint.h>
 
 // Typedefs
 typedef struct WorkQueue WorkQueue;
@@ -22,8 +23,11 @@ WorkQueue *construct_WorkQueue(void);
 void destruct_WorkQueue(WorkQueue *wq);
 GpuCommand *WorkQueue_waitForItem(WorkQueue *wq);
 void WorkQueue_returnItem(WorkQueue *wq, GpuCommand *object);
-void WorkQueue_addItem(WorkQueue *wq, GpuCommand *source,
+void WorkQueue_addItem(WorkQueue *wq,
+		void (*functionPointer)(GpuCommand *command), GPU *gpu,
+		const int32_t *parameters, int32_t parameterCount,
 		bool waitForCompletion);
+void WorkQueue_setState(WorkQueue *wq, int32_t state, int32_t value);
 void WorkQueue_endProcessingByRenderingThread(WorkQueue *wq);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+/*
+ * This header file provides the public API for the XA-ADPCM decoder of the
+ * CD-ROM controller, which turns XA audio sectors into samples for the SPU's
+ * CD audio input.
+ *
+ * XAAudio.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_XAAUDIO_HEADER
+#define PHILPSX_XAAUDIO_HEADER
+
+// System includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typedefs
+typedef struct XAAudio XAAudio;
+
+// Public functions
+XAAudio *construct_XAAudio(void);
+void destruct_XAAudio(XAAudio *xa);
+void XAAudio_decodeSector(XAAudio *xa, const int8_t *sector);
+int64_t XAAudio_getDroppedFrameCount(XAAudio *xa);
+void XAAudio_holdReads(XAAudio *xa, bool held);
+int32_t XAAudio_readFrames(XAAudio *xa, int16_t *frames, int32_t frameCount);
+void XAAudio_reset(XAAudio *xa);
+
+#endif
\ No newline at end of file
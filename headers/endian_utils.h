@@ -0,0 +1,54 @@
+/*
+ * This header file contains utility functions for accessing little-endian
+ * values held in byte arrays, such as RAM. On a little-endian host each of
+ * these compiles down to a single load or store.
+ *
+ * endian_utils.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_ENDIAN_UTILS_HEADER
+#define PHILPSX_ENDIAN_UTILS_HEADER
+
+// System includes
+#include <stdint.h>
+#include <string.h>
+
+// Utility functions
+static inline int32_t read_le_word(const int8_t *bytes)
+{
+	uint32_t value;
+	memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap32(value);
+#endif
+	return (int32_t)value;
+}
+
+static inline int32_t read_le_halfword(const int8_t *bytes)
+{
+	uint16_t value;
+	memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap16(value);
+#endif
+	return value;
+}
+
+static inline void write_le_word(int8_t *bytes, int32_t value)
+{
+	uint32_t tempValue = (uint32_t)value;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	tempValue = __builtin_bswap32(tempValue);
+#endif
+	memcpy(bytes, &tempValue, sizeof(tempValue));
+}
+
+static inline void write_le_halfword(int8_t *bytes, int32_t value)
+{
+	uint16_t tempValue = (uint16_t)value;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	tempValue = __builtin_bswap16(tempValue);
+#endif
+	memcpy(bytes, &tempValue, sizeof(tempValue));
+}
+
+#endif
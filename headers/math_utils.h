@@ -53,4 +53,19 @@ static int64_t min_value_64(int64_t left, int64_t right)
 		int64_t:min_value_64 \
 		)(x, y)
 
+static int32_t max_value_32(int32_t left, int32_t right)
+{
+	return left >= right ? left : right;
+}
+
+static int64_t max_value_64(int64_t left, int64_t right)
+{
+	return left >= right ? left : right;
+}
+
+#define max_value(x, y) _Generic((x)+(y), \
+		int32_t:max_value_32, \
+		int64_t:max_value_64 \
+		)(x, y)
+
 #endif
\ No newline at end of file
@@ -1,6 +1,6 @@
 /*
- * This header file provides the OpenGL vertex shader for the AnyLine
- * routine.
+ * This header file provides the OpenGL vertex shader for the
+ * AnyLine routine.
  * 
  * AnyLine_VertexShader1.h - Copyright Phillip Potter, 2020, under GPLv3
  */
@@ -12,58 +12,34 @@ static const char *GPU_getAnyLine_VertexShader1Source(void)
 	return
 	"#version 450 core\n"
 	"\n"
-	"// Uniforms to specify parameters of line drawing\n"
-	"layout (location = 0) uniform int first_x;\n"
-	"layout (location = 1) uniform int first_y;\n"
-	"layout (location = 2) uniform int second_x;\n"
-	"layout (location = 3) uniform int second_y;\n"
-	"layout (location = 4) uniform int firstRed;\n"
-	"layout (location = 5) uniform int firstGreen;\n"
-	"layout (location = 6) uniform int firstBlue;\n"
-	"layout (location = 7) uniform int secondRed;\n"
-	"layout (location = 8) uniform int secondGreen;\n"
-	"layout (location = 9) uniform int secondBlue;\n"
+	"// Vertex attributes, filled in by the primitive batch\n"
+	"layout (location = 0) in ivec2 position;\n"
+	"layout (location = 1) in ivec3 vertexRgb;\n"
+	"layout (location = 3) in ivec4 primitive1;\n"
 	"\n"
 	"// Output value to allow colour interpolation\n"
 	"out vec3 vertexColour;\n"
 	"\n"
-	"// Draw line\n"
+	"// Values that stay the same across the primitive\n"
+	"flat out int semiTransparencyEnabled;\n"
+	"\n"
 	"void main(void) {\n"
 	"\n"
-	"	// Convert coordinates of line to floating point and normalise\n"
-	"	float x = 0.0;\n"
-	"	float y = 0.0;\n"
-	"	switch (gl_VertexID) {\n"
-	"		case 0:\n"
-	"			x = float(first_x);\n"
-	"			y = float(first_y);\n"
-	"			break;\n"
-	"		case 1:\n"
-	"			x = float(second_x);\n"
-	"			y = float(second_y);\n"
-	"			break;\n"
-	"	}\n"
+	"	// Convert coordinates into floating point and normalise them\n"
+	"	float x = float(position.x);\n"
+	"	float y = float(position.y);\n"
 	"	x = (x / 512) - 1.0;\n"
 	"	y = (y / 256) - 1.0;\n"
 	"\n"
-	"	// Store for fragment shader\n"
+	"	// Output vertex coordinate\n"
 	"	gl_Position = vec4(x, y, 0.0, 1.0);\n"
 	"\n"
-	"	// Store output colour\n"
-	"	vec3 tempColour = vec3(0.0, 0.0, 0.0);\n"
-	"	switch (gl_VertexID) {\n"
-	"		case 0:\n"
-	"			tempColour.r = float(firstRed);\n"
-	"			tempColour.g = float(firstGreen);\n"
-	"			tempColour.b = float(firstBlue);\n"
-	"			break;\n"
-	"		case 1:\n"
-	"			tempColour.r = float(secondRed);\n"
-	"			tempColour.g = float(secondGreen);\n"
-	"			tempColour.b = float(secondBlue);\n"
-	"			break;\n"
-	"	}\n"
-	"	vertexColour = tempColour;\n"
+	"	// Output colour\n"
+	"	vertexColour = vec3(float(vertexRgb.r), float(vertexRgb.g),\n"
+	"			float(vertexRgb.b));\n"
+	"\n"
+	"	// Output primitive settings\n"
+	"	semiTransparencyEnabled = primitive1.x;\n"
 	"}\n";
 }
 
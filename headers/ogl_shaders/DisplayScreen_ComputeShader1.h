@@ -0,0 +1,78 @@
+/*
+ * This header file provides the OpenGL compute shader for the DisplayScreen
+ * routine, which converts the displayed area of vram into a texture for the
+ * presenting thread.
+ * 
+ * DisplayScreen_ComputeShader1.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_DISPLAYSCREEN_COMPUTESHADER1
+#define PHILPSX_DISPLAYSCREEN_COMPUTESHADER1
+
+static const char *GPU_getDisplayScreen_ComputeShader1Source(void)
+{
+	return
+	"#version 450 core\n"
+	"\n"
+	"layout (local_size_x = 16, local_size_y = 16) in;\n"
+	"\n"
+	"layout (binding = 0) uniform usampler2D vramTexture;\n"
+	"layout (binding = 2, rgba8) uniform writeonly image2D frameImage;\n"
+	"\n"
+	"layout (location = 0) uniform int consoleHorizontalRes;\n"
+	"layout (location = 1) uniform int consoleVerticalRes;\n"
+	"layout (location = 2) uniform int topX;\n"
+	"layout (location = 3) uniform int bottomY;\n"
+	"layout (location = 4) uniform int colourDepth24;\n"
+	"\n"
+	"// Account for RGB intensity on real PSX\n"
+	"float intensity(uint value) {\n"
+	"	if (value <= 8)\n"
+	"		return float(value) * 2;\n"
+	"	else\n"
+	"		return 16.0 + (float(value - 8) * 0.65217);\n"
+	"}\n"
+	"\n"
+	"// Read a 16-bit halfword back from the vram texture\n"
+	"uint readHalfWord(int x, int y) {\n"
+	"	uvec4 pixel = texelFetch(vramTexture, ivec2(x & 1023, y), 0);\n"
+	"	return pixel.r | (pixel.g << 5) | (pixel.b << 10) | (pixel.a << 15);\n"
+	"}\n"
+	"\n"
+	"// Convert pixels into RGBA format for screen display, one per\n"
+	"// invocation, with the frame starting at the bottom left\n"
+	"void main(void) {\n"
+	"\n"
+	"	// Skip invocations outside of the frame\n"
+	"	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);\n"
+	"	if (coord.x >= consoleHorizontalRes ||\n"
+	"			coord.y >= consoleVerticalRes)\n"
+	"		return;\n"
+	"	int y = coord.y + bottomY;\n"
+	"\n"
+	"	// In 24-bit colour, each pixel is three bytes packed across\n"
+	"	// halfwords, so gather the pair holding it\n"
+	"	vec4 colour;\n"
+	"	if (colourDepth24 != 0) {\n"
+	"		int byteOffset = coord.x * 3;\n"
+	"		int halfWordX = topX + (byteOffset >> 1);\n"
+	"		uint pair = readHalfWord(halfWordX, y) |\n"
+	"			(readHalfWord(halfWordX + 1, y) << 16);\n"
+	"		if ((byteOffset & 1) != 0)\n"
+	"			pair >>= 8;\n"
+	"		colour = vec4(float(pair & 0xFF) / 255.0,\n"
+	"			float((pair >> 8) & 0xFF) / 255.0,\n"
+	"			float((pair >> 16) & 0xFF) / 255.0, 1.0);\n"
+	"	} else {\n"
+	"		uvec4 pixel = texelFetch(vramTexture,\n"
+	"			ivec2(coord.x + topX, y), 0);\n"
+	"		colour = vec4(intensity(pixel.r) * 8.225 / 255.0,\n"
+	"			intensity(pixel.g) * 8.225 / 255.0,\n"
+	"			intensity(pixel.b) * 8.225 / 255.0, 1.0);\n"
+	"	}\n"
+	"\n"
+	"	// Output\n"
+	"	imageStore(frameImage, coord, colour);\n"
+	"}\n";
+}
+
+#endif
\ No newline at end of file
@@ -11,22 +11,30 @@ static const char *GPU_getMonochromePolygon_FragmentShader1Source(void)
 {
 	return
 	"#version 450 core\n"
+	"#extension GL_ARB_fragment_shader_interlock : enable\n"
+	"\n"
+	"// Keep accesses to each pixel in primitive order where supported\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"layout (pixel_interlock_ordered) in;\n"
+	"#endif\n"
 	"\n"
 	"// Image corresponding to vram texture\n"
 	"layout (binding = 1, rgba8ui) uniform uimage2D vramImage;\n"
 	"\n"
 	"// Uniforms to control draw process\n"
-	"layout (location = 2) uniform int red;\n"
-	"layout (location = 3) uniform int green;\n"
-	"layout (location = 4) uniform int blue;\n"
-	"layout (location = 5) uniform int semiTransparencyEnabled;\n"
-	"layout (location = 6) uniform int semiTransparencyMode;\n"
-	"layout (location = 7) uniform int setMask;\n"
-	"layout (location = 8) uniform int checkMask;\n"
-	"layout (location = 9) uniform int drawTopLeftX;\n"
-	"layout (location = 10) uniform int drawTopLeftY;\n"
-	"layout (location = 11) uniform int drawBottomRightX;\n"
-	"layout (location = 12) uniform int drawBottomRightY;\n"
+	"layout (location = 0) uniform int semiTransparencyMode;\n"
+	"layout (location = 1) uniform int setMask;\n"
+	"layout (location = 2) uniform int checkMask;\n"
+	"layout (location = 3) uniform int drawTopLeftX;\n"
+	"layout (location = 4) uniform int drawTopLeftY;\n"
+	"layout (location = 5) uniform int drawBottomRightX;\n"
+	"layout (location = 6) uniform int drawBottomRightY;\n"
+	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat in int red;\n"
+	"flat in int green;\n"
+	"flat in int blue;\n"
+	"flat in int semiTransparencyEnabled;\n"
 	"\n"
 	"// Function declarations\n"
 	"bool inDrawingArea(ivec2 pixelCoord);\n"
@@ -44,6 +52,11 @@ static const char *GPU_getMonochromePolygon_FragmentShader1Source(void)
 	"							(uint(green) >> 3) & uint(0x1F),\n"
 	"							(uint(blue) >> 3) & uint(0x1F), 0);\n"
 	"\n"
+	"	// Start of critical section for this pixel\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	beginInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Load vram pixel\n"
 	"	uvec4 vramPixel = imageLoad(vramImage, tempDrawCoord);\n"
 	"\n"
@@ -127,6 +140,11 @@ static const char *GPU_getMonochromePolygon_FragmentShader1Source(void)
 	"		imageStore(vramImage, tempDrawCoord, texPixel);\n"
 	"	}\n"
 	"\n"
+	"	// End of critical section\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	endInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Set dummy output value\n"
 	"	colour = vec4(0.0, 0.0, 0.0, 0.0);\n"
 	"}\n"
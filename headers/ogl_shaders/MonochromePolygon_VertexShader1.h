@@ -12,34 +12,35 @@ static const char *GPU_getMonochromePolygon_VertexShader1Source(void)
 	return
 	"#version 450 core\n"
 	"\n"
-	"layout (location = 0) uniform ivec3 vertex_x;\n"
-	"layout (location = 1) uniform ivec3 vertex_y;\n"
+	"// Vertex attributes, filled in by the primitive batch\n"
+	"layout (location = 0) in ivec2 position;\n"
+	"layout (location = 1) in ivec3 vertexRgb;\n"
+	"layout (location = 3) in ivec4 primitive1;\n"
+	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat out int red;\n"
+	"flat out int green;\n"
+	"flat out int blue;\n"
+	"flat out int semiTransparencyEnabled;\n"
 	"\n"
 	"void main(void) {\n"
 	"\n"
 	"	// Convert coordinates into floating point and normalise them\n"
-	"	float x = 0.0;\n"
-	"	float y = 0.0;\n"
-	"\n"
-	"	switch (gl_VertexID) {\n"
-	"		case 0:\n"
-	"			x = float(vertex_x.x);\n"
-	"			y = float(vertex_y.x);\n"
-	"			break;\n"
-	"		case 1:\n"
-	"			x = float(vertex_x.y);\n"
-	"			y = float(vertex_y.y);\n"
-	"			break;\n"
-	"		case 2:\n"
-	"			x = float(vertex_x.z);\n"
-	"			y = float(vertex_y.z);\n"
-	"			break;\n"
-	"	}\n"
+	"	float x = float(position.x);\n"
+	"	float y = float(position.y);\n"
 	"	x = (x / 512) - 1.0;\n"
 	"	y = (y / 256) - 1.0;\n"
 	"\n"
 	"	// Output vertex coordinate\n"
 	"	gl_Position = vec4(x, y, 0.0, 1.0);\n"
+	"\n"
+	"	// Output flat colour\n"
+	"	red = vertexRgb.r;\n"
+	"	green = vertexRgb.g;\n"
+	"	blue = vertexRgb.b;\n"
+	"\n"
+	"	// Output primitive settings\n"
+	"	semiTransparencyEnabled = primitive1.x;\n"
 	"}\n";
 }
 
@@ -11,25 +11,30 @@ static const char *GPU_getMonochromeRectangle_FragmentShader1Source(void)
 {
 	return
 	"#version 450 core\n"
+	"#extension GL_ARB_fragment_shader_interlock : enable\n"
+	"\n"
+	"// Keep accesses to each pixel in primitive order where supported\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"layout (pixel_interlock_ordered) in;\n"
+	"#endif\n"
 	"\n"
 	"// Image corresponding to vram texture\n"
 	"layout (binding = 1, rgba8ui) uniform uimage2D vramImage;\n"
 	"\n"
 	"// Uniforms to control copy process\n"
-	"layout (location = 0) uniform int xOffset;\n"
-	"layout (location = 1) uniform int yOffset;\n"
-	"layout (location = 2) uniform int height;\n"
-	"layout (location = 3) uniform int red;\n"
-	"layout (location = 4) uniform int green;\n"
-	"layout (location = 5) uniform int blue;\n"
-	"layout (location = 6) uniform int semiTransparencyEnabled;\n"
-	"layout (location = 7) uniform int semiTransparencyMode;\n"
-	"layout (location = 8) uniform int setMask;\n"
-	"layout (location = 9) uniform int checkMask;\n"
-	"layout (location = 10) uniform int drawTopLeftX;\n"
-	"layout (location = 11) uniform int drawTopLeftY;\n"
-	"layout (location = 12) uniform int drawBottomRightX;\n"
-	"layout (location = 13) uniform int drawBottomRightY;\n"
+	"layout (location = 0) uniform int semiTransparencyMode;\n"
+	"layout (location = 1) uniform int setMask;\n"
+	"layout (location = 2) uniform int checkMask;\n"
+	"layout (location = 3) uniform int drawTopLeftX;\n"
+	"layout (location = 4) uniform int drawTopLeftY;\n"
+	"layout (location = 5) uniform int drawBottomRightX;\n"
+	"layout (location = 6) uniform int drawBottomRightY;\n"
+	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat in int red;\n"
+	"flat in int green;\n"
+	"flat in int blue;\n"
+	"flat in int semiTransparencyEnabled;\n"
 	"\n"
 	"// Function declarations\n"
 	"bool inDrawingArea(ivec2 pixelCoord);\n"
@@ -50,6 +55,11 @@ static const char *GPU_getMonochromeRectangle_FragmentShader1Source(void)
 	"	// vram texture\n"
 	"	ivec2 vramCoord = ivec2(gl_FragCoord.xy);\n"
 	"\n"
+	"	// Start of critical section for this pixel\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	beginInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Load vram pixel\n"
 	"	uvec4 vramPixel = imageLoad(vramImage, vramCoord);\n"
 	"\n"
@@ -133,6 +143,11 @@ static const char *GPU_getMonochromeRectangle_FragmentShader1Source(void)
 	"		imageStore(vramImage, vramCoord, rectPixel);\n"
 	"	}\n"
 	"	\n"
+	"	// End of critical section\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	endInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Set dummy output value\n"
 	"	colour = vec4(0.0, 0.0, 0.0, 0.0);\n"
 	"}\n"
@@ -11,20 +11,28 @@ static const char *GPU_getShadedPolygon_FragmentShader1Source(void)
 {
 	return
 	"#version 450 core\n"
+	"#extension GL_ARB_fragment_shader_interlock : enable\n"
+	"\n"
+	"// Keep accesses to each pixel in primitive order where supported\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"layout (pixel_interlock_ordered) in;\n"
+	"#endif\n"
 	"\n"
 	"// Image corresponding to vram texture\n"
 	"layout (binding = 1, rgba8ui) uniform uimage2D vramImage;\n"
 	"\n"
 	"// Uniforms to control draw process\n"
-	"layout (location = 5) uniform int dither;\n"
-	"layout (location = 6) uniform int semiTransparencyEnabled;\n"
-	"layout (location = 7) uniform int semiTransparencyMode;\n"
-	"layout (location = 8) uniform int setMask;\n"
-	"layout (location = 9) uniform int checkMask;\n"
-	"layout (location = 10) uniform int drawTopLeftX;\n"
-	"layout (location = 11) uniform int drawTopLeftY;\n"
-	"layout (location = 12) uniform int drawBottomRightX;\n"
-	"layout (location = 13) uniform int drawBottomRightY;\n"
+	"layout (location = 0) uniform int dither;\n"
+	"layout (location = 1) uniform int semiTransparencyMode;\n"
+	"layout (location = 2) uniform int setMask;\n"
+	"layout (location = 3) uniform int checkMask;\n"
+	"layout (location = 4) uniform int drawTopLeftX;\n"
+	"layout (location = 5) uniform int drawTopLeftY;\n"
+	"layout (location = 6) uniform int drawBottomRightX;\n"
+	"layout (location = 7) uniform int drawBottomRightY;\n"
+	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat in int semiTransparencyEnabled;\n"
 	"\n"
 	"// Colour input value\n"
 	"in vec3 interpolated_colour;\n"
@@ -127,6 +135,11 @@ static const char *GPU_getShadedPolygon_FragmentShader1Source(void)
 	"		texPixel.b = 0x1F;\n"
 	"	}\n"
 	"\n"
+	"	// Start of critical section for this pixel\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	beginInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Load existing vram pixel\n"
 	"	uvec4 vramPixel = imageLoad(vramImage, tempDrawCoord);\n"
 	"\n"
@@ -210,6 +223,11 @@ static const char *GPU_getShadedPolygon_FragmentShader1Source(void)
 	"		imageStore(vramImage, tempDrawCoord, texPixel);\n"
 	"	}\n"
 	"\n"
+	"	// End of critical section\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	endInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Set dummy output value\n"
 	"	colour = vec4(0.0, 0.0, 0.0, 0.0);\n"
 	"}\n"
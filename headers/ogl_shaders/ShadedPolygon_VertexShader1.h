@@ -12,46 +12,21 @@ static const char *GPU_getShadedPolygon_VertexShader1Source(void)
 	return
 	"#version 450 core\n"
 	"\n"
-	"layout (location = 0) uniform ivec3 vertex_x;\n"
-	"layout (location = 1) uniform ivec3 vertex_y;\n"
-	"layout (location = 2) uniform ivec3 redArray;\n"
-	"layout (location = 3) uniform ivec3 greenArray;\n"
-	"layout (location = 4) uniform ivec3 blueArray;\n"
+	"// Vertex attributes, filled in by the primitive batch\n"
+	"layout (location = 0) in ivec2 position;\n"
+	"layout (location = 1) in ivec3 vertexRgb;\n"
+	"layout (location = 3) in ivec4 primitive1;\n"
 	"\n"
 	"out vec3 interpolated_colour;\n"
 	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat out int semiTransparencyEnabled;\n"
+	"\n"
 	"void main(void) {\n"
 	"\n"
 	"	// Convert coordinates into floating point and normalise them\n"
-	"	float x = 0.0;\n"
-	"	float y = 0.0;\n"
-	"	float red = 0.0;\n"
-	"	float green = 0.0;\n"
-	"	float blue = 0.0;\n"
-	"\n"
-	"	switch (gl_VertexID) {\n"
-	"		case 0:\n"
-	"			x = float(vertex_x.x);\n"
-	"			y = float(vertex_y.x);\n"
-	"			red = float(redArray.x);\n"
-	"			green = float(greenArray.x);\n"
-	"			blue = float(blueArray.x);\n"
-	"			break;\n"
-	"		case 1:\n"
-	"			x = float(vertex_x.y);\n"
-	"			y = float(vertex_y.y);\n"
-	"			red = float(redArray.y);\n"
-	"			green = float(greenArray.y);\n"
-	"			blue = float(blueArray.y);\n"
-	"			break;\n"
-	"		case 2:\n"
-	"			x = float(vertex_x.z);\n"
-	"			y = float(vertex_y.z);\n"
-	"			red = float(redArray.z);\n"
-	"			green = float(greenArray.z);\n"
-	"			blue = float(blueArray.z);\n"
-	"			break;\n"
-	"	}\n"
+	"	float x = float(position.x);\n"
+	"	float y = float(position.y);\n"
 	"	x = (x / 512) - 1.0;\n"
 	"	y = (y / 256) - 1.0;\n"
 	"\n"
@@ -59,7 +34,11 @@ static const char *GPU_getShadedPolygon_VertexShader1Source(void)
 	"	gl_Position = vec4(x, y, 0.0, 1.0);\n"
 	"\n"
 	"	// Output colour\n"
-	"	interpolated_colour = vec3(red, green, blue);\n"
+	"	interpolated_colour = vec3(float(vertexRgb.r), float(vertexRgb.g),\n"
+	"			float(vertexRgb.b));\n"
+	"\n"
+	"	// Output primitive settings\n"
+	"	semiTransparencyEnabled = primitive1.x;\n"
 	"}\n";
 }
 
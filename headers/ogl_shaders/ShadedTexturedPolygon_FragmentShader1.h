@@ -11,32 +11,42 @@ static const char *GPU_getShadedTexturedPolygon_FragmentShader1Source(void)
 {
 	return
 	"#version 450 core\n"
+	"#extension GL_ARB_fragment_shader_interlock : enable\n"
+	"\n"
+	"// Keep accesses to each pixel in primitive order where supported\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"layout (pixel_interlock_ordered) in;\n"
+	"#endif\n"
 	"\n"
 	"// Image corresponding to vram texture\n"
 	"layout (binding = 1, rgba8ui) uniform uimage2D vramImage;\n"
 	"\n"
+	"// Texture pages already decoded through their CLUT, one per layer\n"
+	"layout (binding = 2) uniform usampler2DArray textureCache;\n"
+	"\n"
 	"// Uniforms to control draw process\n"
-	"layout (location = 2) uniform ivec3 texture_x;\n"
-	"layout (location = 3) uniform ivec3 texture_y;\n"
-	"layout (location = 4) uniform int texBaseX;\n"
-	"layout (location = 5) uniform int texBaseY;\n"
-	"layout (location = 6) uniform int texColourMode;\n"
-	"layout (location = 7) uniform int texWidthMask;\n"
-	"layout (location = 8) uniform int texHeightMask;\n"
-	"layout (location = 9) uniform int texWinOffsetX;\n"
-	"layout (location = 10) uniform int texWinOffsetY;\n"
-	"layout (location = 14) uniform int dither;\n"
-	"layout (location = 15) uniform int disableBlending;\n"
-	"layout (location = 16) uniform int clut_x;\n"
-	"layout (location = 17) uniform int clut_y;\n"
-	"layout (location = 18) uniform int setMask;\n"
-	"layout (location = 19) uniform int checkMask;\n"
-	"layout (location = 20) uniform int semiTransparencyEnabled;\n"
-	"layout (location = 21) uniform int semiTransparencyMode;\n"
-	"layout (location = 22) uniform int drawTopLeftX;\n"
-	"layout (location = 23) uniform int drawTopLeftY;\n"
-	"layout (location = 24) uniform int drawBottomRightX;\n"
-	"layout (location = 25) uniform int drawBottomRightY;\n"
+	"layout (location = 0) uniform int texWidthMask;\n"
+	"layout (location = 1) uniform int texHeightMask;\n"
+	"layout (location = 2) uniform int texWinOffsetX;\n"
+	"layout (location = 3) uniform int texWinOffsetY;\n"
+	"layout (location = 4) uniform int dither;\n"
+	"layout (location = 5) uniform int setMask;\n"
+	"layout (location = 6) uniform int checkMask;\n"
+	"layout (location = 7) uniform int drawTopLeftX;\n"
+	"layout (location = 8) uniform int drawTopLeftY;\n"
+	"layout (location = 9) uniform int drawBottomRightX;\n"
+	"layout (location = 10) uniform int drawBottomRightY;\n"
+	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat in int texBaseX;\n"
+	"flat in int texBaseY;\n"
+	"flat in int texColourMode;\n"
+	"flat in int disableBlending;\n"
+	"flat in int clut_x;\n"
+	"flat in int clut_y;\n"
+	"flat in int semiTransparencyEnabled;\n"
+	"flat in int semiTransparencyMode;\n"
+	"flat in int textureCacheLayer;\n"
 	"\n"
 	"// Texture coordinate input value\n"
 	"in vec2 interpolated_tex_coord;\n"
@@ -58,8 +68,23 @@ static const char *GPU_getShadedTexturedPolygon_FragmentShader1Source(void)
 	"	// Declare texture pixel variable and make 0 for now\n"
 	"	uvec4 texPixel = uvec4(0, 0, 0, 0);\n"
 	"\n"
-	"	// Handle differently depending on colour mode\n"
-	"	if (texColourMode == 0) { // 4-bit colour mode\n"
+	"	// Calculate texture pixel coordinates within the page using texture\n"
+	"	// window settings, for reading from the texture cache\n"
+	"	int page_tex_x =\n"
+	"		(int(interpolated_tex_coord.x) & ~(texWidthMask * 8)) |\n"
+	"		((texWinOffsetX & texWidthMask) * 8);\n"
+	"	int page_tex_y =\n"
+	"		(int(interpolated_tex_coord.y) & ~(texHeightMask * 8)) |\n"
+	"		((texWinOffsetY & texHeightMask) * 8);\n"
+	"\n"
+	"	// Read decoded texture pixel if the page is in the texture cache,\n"
+	"	// else handle differently depending on colour mode\n"
+	"	if (textureCacheLayer >= 0 && page_tex_x >= 0 && page_tex_x < 256 &&\n"
+	"		page_tex_y >= 0 && page_tex_y < 256) {\n"
+	"		texPixel = texelFetch(textureCache,\n"
+	"			ivec3(page_tex_x, page_tex_y, textureCacheLayer), 0);\n"
+	"	}\n"
+	"	else if (texColourMode == 0) { // 4-bit colour mode\n"
 	"\n"
 	"		// Calculate texture pixel coordinates using texture\n"
 	"		// window settings\n"
@@ -147,6 +172,11 @@ static const char *GPU_getShadedTexturedPolygon_FragmentShader1Source(void)
 	"		texPixel = imageLoad(vramImage, ivec2(new_tex_x, new_tex_y));\n"
 	"	}\n"
 	"\n"
+	"	// Start of critical section for this pixel\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	beginInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Load vram pixel\n"
 	"	uvec4 vramPixel = imageLoad(vramImage, tempDrawCoord);\n"
 	"\n"
@@ -333,6 +363,11 @@ static const char *GPU_getShadedTexturedPolygon_FragmentShader1Source(void)
 	"		imageStore(vramImage, tempDrawCoord, texPixel);\n"
 	"	}\n"
 	"\n"
+	"	// End of critical section\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	endInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Set dummy output value\n"
 	"	colour = vec4(0.0, 0.0, 0.0, 0.0);\n"
 	"}\n"
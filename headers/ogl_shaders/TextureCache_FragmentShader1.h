@@ -0,0 +1,60 @@
+/*
+ * This header file provides the OpenGL fragment shader for the TextureCache
+ * routine, which decodes a whole texture page through its CLUT into one
+ * layer of the texture cache.
+ * 
+ * TextureCache_FragmentShader1.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_TEXTURECACHE_FRAGMENTSHADER1
+#define PHILPSX_TEXTURECACHE_FRAGMENTSHADER1
+
+static const char *GPU_getTextureCache_FragmentShader1Source(void)
+{
+	return
+	"#version 450 core\n"
+	"\n"
+	"// Image corresponding to vram texture\n"
+	"layout (binding = 1, rgba8ui) uniform readonly uimage2D vramImage;\n"
+	"\n"
+	"// Uniforms to control decode process\n"
+	"layout (location = 0) uniform int texBaseX;\n"
+	"layout (location = 1) uniform int texBaseY;\n"
+	"layout (location = 2) uniform int texColourMode;\n"
+	"layout (location = 3) uniform int clut_x;\n"
+	"layout (location = 4) uniform int clut_y;\n"
+	"\n"
+	"// Decoded texture pixel output value\n"
+	"layout (location = 0) out uvec4 texel;\n"
+	"\n"
+	"// Decode texture pixel exactly as the textured primitive shaders would\n"
+	"void main(void) {\n"
+	"	// Get texture pixel coordinates within page from gl_FragCoord\n"
+	"	ivec2 texCoord = ivec2(gl_FragCoord.xy);\n"
+	"\n"
+	"	// Get vram pixel holding texture pixel, and the CLUT index within it\n"
+	"	int clutIndex = 0;\n"
+	"	if (texColourMode == 0) { // 4-bit colour mode\n"
+	"		uvec4 texPixel = imageLoad(vramImage,\n"
+	"				ivec2(texBaseX + (texCoord.x / 4), texBaseY - texCoord.y));\n"
+	"		int texPixeli = ((int(texPixel.a) & 0x1) << 15) |\n"
+	"							((int(texPixel.b) & 0x1F) << 10) |\n"
+	"							((int(texPixel.g) & 0x1F) << 5) |\n"
+	"							(int(texPixel.r) & 0x1F);\n"
+	"		clutIndex = (texPixeli >> ((texCoord.x % 4) * 4)) & 0xF;\n"
+	"	}\n"
+	"	else { // 8-bit colour mode\n"
+	"		uvec4 texPixel = imageLoad(vramImage,\n"
+	"				ivec2(texBaseX + (texCoord.x / 2), texBaseY - texCoord.y));\n"
+	"		int texPixeli = ((int(texPixel.a) & 0x1) << 15) |\n"
+	"							((int(texPixel.b) & 0x1F) << 10) |\n"
+	"							((int(texPixel.g) & 0x1F) << 5) |\n"
+	"							(int(texPixel.r) & 0x1F);\n"
+	"		clutIndex = (texPixeli >> ((texCoord.x % 2) * 8)) & 0xFF;\n"
+	"	}\n"
+	"\n"
+	"	// Read correct pixel from CLUT\n"
+	"	texel = imageLoad(vramImage, ivec2(clut_x + clutIndex, clut_y));\n"
+	"}\n";
+}
+
+#endif
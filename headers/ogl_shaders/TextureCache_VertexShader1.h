@@ -1,13 +1,13 @@
 /*
- * This header file provides the first OpenGL vertex shader for the GP0_80
+ * This header file provides the OpenGL vertex shader for the TextureCache
  * routine.
  * 
- * GP0_80_VertexShader1.h - Copyright Phillip Potter, 2020, under GPLv3
+ * TextureCache_VertexShader1.h - Copyright Phillip Potter, 2020, under GPLv3
  */
-#ifndef PHILPSX_GP0_80_VERTEXSHADER1
-#define PHILPSX_GP0_80_VERTEXSHADER1
+#ifndef PHILPSX_TEXTURECACHE_VERTEXSHADER1
+#define PHILPSX_TEXTURECACHE_VERTEXSHADER1
 
-static const char *GPU_getGP0_80_VertexShader1Source(void)
+static const char *GPU_getTextureCache_VertexShader1Source(void)
 {
 	return
 	"#version 450 core\n"
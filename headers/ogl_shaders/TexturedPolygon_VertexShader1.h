@@ -12,42 +12,35 @@ static const char *GPU_getTexturedPolygon_VertexShader1Source(void)
 	return
 	"#version 450 core\n"
 	"\n"
-	"layout (location = 0) uniform ivec3 vertex_x;\n"
-	"layout (location = 1) uniform ivec3 vertex_y;\n"
-	"layout (location = 2) uniform ivec3 texture_x;\n"
-	"layout (location = 3) uniform ivec3 texture_y;\n"
+	"// Vertex attributes, filled in by the primitive batch\n"
+	"layout (location = 0) in ivec2 position;\n"
+	"layout (location = 1) in ivec3 vertexRgb;\n"
+	"layout (location = 2) in ivec2 texCoord;\n"
+	"layout (location = 3) in ivec4 primitive1;\n"
+	"layout (location = 4) in ivec4 primitive2;\n"
+	"layout (location = 5) in int cacheLayer;\n"
 	"\n"
 	"out vec2 interpolated_tex_coord;\n"
 	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat out int red;\n"
+	"flat out int green;\n"
+	"flat out int blue;\n"
+	"flat out int texBaseX;\n"
+	"flat out int texBaseY;\n"
+	"flat out int texColourMode;\n"
+	"flat out int semiTransparencyMode;\n"
+	"flat out int clut_x;\n"
+	"flat out int clut_y;\n"
+	"flat out int rawTextureEnabled;\n"
+	"flat out int semiTransparencyEnabled;\n"
+	"flat out int textureCacheLayer;\n"
+	"\n"
 	"void main(void) {\n"
 	"\n"
-	"	// Convert coordinates into floating point and normalise them, also\n"
-	"	// Dealing with texture coordinates\n"
-	"	float x = 0.0;\n"
-	"	float y = 0.0;\n"
-	"	float tex_x = 0.0;\n"
-	"	float tex_y = 0.0;\n"
-	"\n"
-	"	switch (gl_VertexID) {\n"
-	"		case 0:\n"
-	"			x = float(vertex_x.x);\n"
-	"			y = float(vertex_y.x);\n"
-	"			tex_x = float(texture_x.x);\n"
-	"			tex_y = float(texture_y.x);\n"
-	"			break;\n"
-	"		case 1:\n"
-	"			x = float(vertex_x.y);\n"
-	"			y = float(vertex_y.y);\n"
-	"			tex_x = float(texture_x.y);\n"
-	"			tex_y = float(texture_y.y);\n"
-	"			break;\n"
-	"		case 2:\n"
-	"			x = float(vertex_x.z);\n"
-	"			y = float(vertex_y.z);\n"
-	"			tex_x = float(texture_x.z);\n"
-	"			tex_y = float(texture_y.z);\n"
-	"			break;\n"
-	"	}\n"
+	"	// Convert coordinates into floating point and normalise them\n"
+	"	float x = float(position.x);\n"
+	"	float y = float(position.y);\n"
 	"	x = (x / 512) - 1.0;\n"
 	"	y = (y / 256) - 1.0;\n"
 	"\n"
@@ -55,7 +48,23 @@ static const char *GPU_getTexturedPolygon_VertexShader1Source(void)
 	"	gl_Position = vec4(x, y, 0.0, 1.0);\n"
 	"\n"
 	"	// Output texture coordinate\n"
-	"	interpolated_tex_coord = vec2(tex_x, tex_y);\n"
+	"	interpolated_tex_coord = vec2(float(texCoord.x), float(texCoord.y));\n"
+	"\n"
+	"	// Output primitive settings\n"
+	"	texBaseX = primitive1.x;\n"
+	"	texBaseY = primitive1.y;\n"
+	"	texColourMode = primitive1.z;\n"
+	"	semiTransparencyMode = primitive1.w;\n"
+	"	clut_x = primitive2.x;\n"
+	"	clut_y = primitive2.y;\n"
+	"	rawTextureEnabled = primitive2.z;\n"
+	"	semiTransparencyEnabled = primitive2.w;\n"
+	"	textureCacheLayer = cacheLayer;\n"
+	"\n"
+	"	// Output flat colour\n"
+	"	red = vertexRgb.r;\n"
+	"	green = vertexRgb.g;\n"
+	"	blue = vertexRgb.b;\n"
 	"}\n";
 }
 
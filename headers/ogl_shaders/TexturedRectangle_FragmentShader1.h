@@ -11,37 +11,49 @@ static const char *GPU_getTexturedRectangle_FragmentShader1Source(void)
 {
 	return
 	"#version 450 core\n"
+	"#extension GL_ARB_fragment_shader_interlock : enable\n"
+	"\n"
+	"// Keep accesses to each pixel in primitive order where supported\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"layout (pixel_interlock_ordered) in;\n"
+	"#endif\n"
 	"\n"
 	"// Image corresponding to vram texture\n"
 	"layout (binding = 1, rgba8ui) uniform uimage2D vramImage;\n"
 	"\n"
+	"// Texture pages already decoded through their CLUT, one per layer\n"
+	"layout (binding = 2) uniform usampler2DArray textureCache;\n"
+	"\n"
 	"// Uniforms to control copy process\n"
-	"layout (location = 0) uniform int xOffset;\n"
-	"layout (location = 1) uniform int yOffset;\n"
-	"layout (location = 2) uniform int height;\n"
-	"layout (location = 3) uniform int texBaseX;\n"
-	"layout (location = 4) uniform int texBaseY;\n"
-	"layout (location = 5) uniform int tex_x;\n"
-	"layout (location = 6) uniform int tex_y;\n"
-	"layout (location = 7) uniform int texColourMode;\n"
-	"layout (location = 8) uniform int texWidthMask;\n"
-	"layout (location = 9) uniform int texHeightMask;\n"
-	"layout (location = 10) uniform int texWinOffsetX;\n"
-	"layout (location = 11) uniform int texWinOffsetY;\n"
-	"layout (location = 12) uniform int red;\n"
-	"layout (location = 13) uniform int green;\n"
-	"layout (location = 14) uniform int blue;\n"
-	"layout (location = 15) uniform int rawTextureEnabled;\n"
-	"layout (location = 16) uniform int clut_x;\n"
-	"layout (location = 17) uniform int clut_y;\n"
-	"layout (location = 18) uniform int setMask;\n"
-	"layout (location = 19) uniform int checkMask;\n"
-	"layout (location = 20) uniform int semiTransparencyEnabled;\n"
-	"layout (location = 21) uniform int semiTransparencyMode;\n"
-	"layout (location = 22) uniform int drawTopLeftX;\n"
-	"layout (location = 23) uniform int drawTopLeftY;\n"
-	"layout (location = 24) uniform int drawBottomRightX;\n"
-	"layout (location = 25) uniform int drawBottomRightY;\n"
+	"layout (location = 0) uniform int texBaseX;\n"
+	"layout (location = 1) uniform int texBaseY;\n"
+	"layout (location = 2) uniform int texColourMode;\n"
+	"layout (location = 3) uniform int texWidthMask;\n"
+	"layout (location = 4) uniform int texHeightMask;\n"
+	"layout (location = 5) uniform int texWinOffsetX;\n"
+	"layout (location = 6) uniform int texWinOffsetY;\n"
+	"layout (location = 7) uniform int setMask;\n"
+	"layout (location = 8) uniform int checkMask;\n"
+	"layout (location = 9) uniform int semiTransparencyMode;\n"
+	"layout (location = 10) uniform int drawTopLeftX;\n"
+	"layout (location = 11) uniform int drawTopLeftY;\n"
+	"layout (location = 12) uniform int drawBottomRightX;\n"
+	"layout (location = 13) uniform int drawBottomRightY;\n"
+	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat in int xOffset;\n"
+	"flat in int yOffset;\n"
+	"flat in int height;\n"
+	"flat in int tex_x;\n"
+	"flat in int tex_y;\n"
+	"flat in int red;\n"
+	"flat in int green;\n"
+	"flat in int blue;\n"
+	"flat in int rawTextureEnabled;\n"
+	"flat in int clut_x;\n"
+	"flat in int clut_y;\n"
+	"flat in int semiTransparencyEnabled;\n"
+	"flat in int textureCacheLayer;\n"
 	"\n"
 	"// Dummy output value\n"
 	"out vec4 colour;\n"
@@ -60,8 +72,29 @@ static const char *GPU_getTexturedRectangle_FragmentShader1Source(void)
 	"	// Declare texture pixel variable and make 0 for now\n"
 	"	uvec4 texPixel = uvec4(0, 0, 0, 0);\n"
 	"\n"
-	"	// Handle differently depending on colour mode\n"
-	"	if (texColourMode == 0) { // 4-bit colour mode\n"
+	"	// Calculate texture pixel coordinates within the page using texture\n"
+	"	// window settings, for reading from the texture cache - the low\n"
+	"	// bits pick the same CLUT index within a vram pixel as below\n"
+	"	int page_tex_x =\n"
+	"		((tex_x + (tempDrawCoord.x % 256)) & ~(texWidthMask * 8)) |\n"
+	"		((texWinOffsetX & texWidthMask) * 8);\n"
+	"	int page_tex_y =\n"
+	"		((tex_y + (tempDrawCoord.y % 256)) & ~(texHeightMask * 8)) |\n"
+	"		((texWinOffsetY & texHeightMask) * 8);\n"
+	"	if (texColourMode == 0) {\n"
+	"		page_tex_x = (page_tex_x & ~0x3) | (tempDrawCoord.x % 4);\n"
+	"	}\n"
+	"	else {\n"
+	"		page_tex_x = (page_tex_x & ~0x1) | (tempDrawCoord.x % 2);\n"
+	"	}\n"
+	"\n"
+	"	// Read decoded texture pixel if the page is in the texture cache,\n"
+	"	// else handle differently depending on colour mode\n"
+	"	if (textureCacheLayer >= 0 && page_tex_x < 256 && page_tex_y < 256) {\n"
+	"		texPixel = texelFetch(textureCache,\n"
+	"			ivec3(page_tex_x, page_tex_y, textureCacheLayer), 0);\n"
+	"	}\n"
+	"	else if (texColourMode == 0) { // 4-bit colour mode\n"
 	"		\n"
 	"		// Calculate texture pixel coordinates using texture\n"
 	"		// window settings\n"
@@ -156,6 +189,11 @@ static const char *GPU_getTexturedRectangle_FragmentShader1Source(void)
 	"	ivec2 vramCoord = ivec2(gl_FragCoord.xy);\n"
 	"	vramCoord.y = tempDrawCoord.y + yOffset;\n"
 	"\n"
+	"	// Start of critical section for this pixel\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	beginInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Load vram pixel\n"
 	"	uvec4 vramPixel = imageLoad(vramImage, vramCoord);\n"
 	"\n"
@@ -272,6 +310,11 @@ static const char *GPU_getTexturedRectangle_FragmentShader1Source(void)
 	"		imageStore(vramImage, vramCoord, texPixel);\n"
 	"	}\n"
 	"\n"
+	"	// End of critical section\n"
+	"#ifdef GL_ARB_fragment_shader_interlock\n"
+	"	endInvocationInterlockARB();\n"
+	"#endif\n"
+	"\n"
 	"	// Set dummy output value\n"
 	"	colour = vec4(0.0, 0.0, 0.0, 0.0);\n"
 	"}\n"
@@ -12,13 +12,56 @@ static const char *GPU_getTexturedRectangle_VertexShader1Source(void)
 	return
 	"#version 450 core\n"
 	"\n"
-	"// Fill whole viewport\n"
+	"// Vertex attributes, filled in by the primitive batch\n"
+	"layout (location = 0) in ivec2 position;\n"
+	"layout (location = 1) in ivec3 vertexRgb;\n"
+	"layout (location = 2) in ivec2 texCoord;\n"
+	"layout (location = 3) in ivec4 primitive1;\n"
+	"layout (location = 4) in ivec4 primitive2;\n"
+	"layout (location = 5) in int cacheLayer;\n"
+	"\n"
+	"// Values that stay the same across the primitive\n"
+	"flat out int xOffset;\n"
+	"flat out int yOffset;\n"
+	"flat out int height;\n"
+	"flat out int tex_x;\n"
+	"flat out int tex_y;\n"
+	"flat out int red;\n"
+	"flat out int green;\n"
+	"flat out int blue;\n"
+	"flat out int rawTextureEnabled;\n"
+	"flat out int clut_x;\n"
+	"flat out int clut_y;\n"
+	"flat out int semiTransparencyEnabled;\n"
+	"flat out int textureCacheLayer;\n"
+	"\n"
 	"void main(void) {\n"
-	"	const vec4 positions[4] = vec4[4](vec4(-1.0, -1.0, 0.0, 1.0),\n"
-	"									  vec4(-1.0, 1.0, 0.0, 1.0),\n"
-	"									  vec4(1.0, -1.0, 0.0, 1.0),\n"
-	"									  vec4(1.0, 1.0, 0.0, 1.0));\n"
-	"	gl_Position = positions[gl_VertexID];\n"
+	"\n"
+	"	// Convert coordinates into floating point and normalise them\n"
+	"	float x = float(position.x);\n"
+	"	float y = float(position.y);\n"
+	"	x = (x / 512) - 1.0;\n"
+	"	y = (y / 256) - 1.0;\n"
+	"\n"
+	"	// Output vertex coordinate\n"
+	"	gl_Position = vec4(x, y, 0.0, 1.0);\n"
+	"\n"
+	"	// Output primitive settings\n"
+	"	xOffset = primitive1.x;\n"
+	"	yOffset = primitive1.y;\n"
+	"	height = primitive1.z;\n"
+	"	semiTransparencyEnabled = primitive1.w;\n"
+	"	textureCacheLayer = cacheLayer;\n"
+	"	tex_x = texCoord.x;\n"
+	"	tex_y = texCoord.y;\n"
+	"	clut_x = primitive2.x;\n"
+	"	clut_y = primitive2.y;\n"
+	"	rawTextureEnabled = primitive2.z;\n"
+	"\n"
+	"	// Output flat colour\n"
+	"	red = vertexRgb.r;\n"
+	"	green = vertexRgb.g;\n"
+	"	blue = vertexRgb.b;\n"
 	"}\n";
 }
 
@@ -0,0 +1,65 @@
+/*
+ * This header file provides the OpenGL compute shader for the VramTransfer
+ * routine, which runs a batch of GP0_02 fills and GP0_80 copies on the vram
+ * image, one transfer per layer of work groups.
+ * 
+ * VramTransfer_ComputeShader1.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_VRAMTRANSFER_COMPUTESHADER1
+#define PHILPSX_VRAMTRANSFER_COMPUTESHADER1
+
+static const char *GPU_getVramTransfer_ComputeShader1Source(void)
+{
+	return
+	"#version 450 core\n"
+	"\n"
+	"layout (local_size_x = 16, local_size_y = 16) in;\n"
+	"\n"
+	"// Image corresponding to vram texture\n"
+	"layout (binding = 1, rgba8ui) uniform uimage2D vramImage;\n"
+	"\n"
+	"// Each transfer is two vectors - the source and destination\n"
+	"// positions, then the size, fill colour and flags (1 for a fill,\n"
+	"// 2 to set the mask bit and 4 to check it)\n"
+	"layout (location = 0) uniform ivec4 transfers[64];\n"
+	"\n"
+	"// Convert a vram position into image coordinates, wrapping at the\n"
+	"// edges of vram\n"
+	"ivec2 imageCoord(int x, int y) {\n"
+	"	return ivec2(x & 1023, 511 - (y & 511));\n"
+	"}\n"
+	"\n"
+	"// Fill or copy one pixel of a transfer per invocation\n"
+	"void main(void) {\n"
+	"\n"
+	"	// Skip invocations outside of the transfer\n"
+	"	int index = int(gl_GlobalInvocationID.z) * 2;\n"
+	"	ivec4 positions = transfers[index];\n"
+	"	ivec4 details = transfers[index + 1];\n"
+	"	ivec2 offset = ivec2(gl_GlobalInvocationID.xy);\n"
+	"	if (offset.x >= details.x || offset.y >= details.y)\n"
+	"		return;\n"
+	"	ivec2 destinationCoord = imageCoord(positions.z + offset.x,\n"
+	"		positions.w + offset.y);\n"
+	"\n"
+	"	// Fills ignore the mask settings\n"
+	"	if ((details.w & 1) != 0) {\n"
+	"		uint colour = uint(details.z);\n"
+	"		imageStore(vramImage, destinationCoord, uvec4(colour & 0x1F,\n"
+	"			(colour >> 5) & 0x1F, (colour >> 10) & 0x1F, 0));\n"
+	"		return;\n"
+	"	}\n"
+	"\n"
+	"	// Copies leave masked pixels alone if checking is enabled\n"
+	"	if ((details.w & 4) != 0 &&\n"
+	"			imageLoad(vramImage, destinationCoord).a == 1)\n"
+	"		return;\n"
+	"	uvec4 pixel = imageLoad(vramImage, imageCoord(positions.x + offset.x,\n"
+	"		positions.y + offset.y));\n"
+	"	if ((details.w & 2) != 0)\n"
+	"		pixel.a = 1;\n"
+	"	imageStore(vramImage, destinationCoord, pixel);\n"
+	"}\n";
+}
+
+#endif
\ No newline at end of file
@@ -17,8 +17,9 @@
 #include <pthread.h>
 #include "../headers/ArrayList.h"
 
-// Sizes for array list
-#define PHILPSX_ARRAYLIST_INITIAL_SIZE 1
+// Sizes for array list - the initial size is enough for most uses (such as
+// the tracks of a CD) to never have to grow
+#define PHILPSX_ARRAYLIST_INITIAL_SIZE 16
 #define PHILPSX_ARRAYLIST_SCALE_FACTOR 2
 #define PHILPSX_ARRAYLIST_NO_SHRINK_BELOW_SIZE 10
 
@@ -360,9 +361,10 @@ void *ArrayList_getObject(ArrayList *al, size_t index)
 }
 
 /*
- * This destructs an ArrayList object. It will also destruct any objects
+ * This empties an ArrayList object. It will also destruct any objects
  * referenced by the slots of the array (if enabled) using the function pointer
- * supplied at construction time, or by calling free if this was NULL.
+ * supplied at construction time, or by calling free if this was NULL. The
+ * array keeps its size, so that filling the list again doesn't allocate.
  */
 void ArrayList_wipeAllObjects(ArrayList *al)
 {
@@ -390,20 +392,6 @@ void ArrayList_wipeAllObjects(ArrayList *al)
 	// Set size (number of elements) to zero
 	al->size = 0;
 	
-	// Shrink array back to original size
-	void **tempPtr = realloc(al->dataArray, sizeof(void *)
-						* PHILPSX_ARRAYLIST_INITIAL_SIZE);
-	if (!tempPtr) {
-		// Contraction failed
-		fprintf(stderr, "PhilPSX: ArrayList: Couldn't shrink array back to "
-				"original size in ArrayList_wipeAllObjects\n");
-	} else {
-		// Contraction succeeded, set dataArray to the new pointer and
-		// set actualSize
-		al->dataArray = tempPtr;
-		al->actualSize = PHILPSX_ARRAYLIST_INITIAL_SIZE;
-	}
-	
 	// Unlock mutex (if enabled)
 	if (!al->notThreadSafe)
 		pthread_mutex_unlock(&al->mutex);
@@ -451,13 +439,14 @@ ArrayList *ArrayList_clone(ArrayList *original)
 			// set actualSize
 			newList->dataArray = tempPtr;
 			newList->actualSize = original->actualSize;
-			
-			// Do the memcpy and set number of objects size
-			memcpy(newList->dataArray, original->dataArray, numOfBytes);
-			newList->size = original->size;
 		}
 	}
 	
+	// Do the memcpy and set number of objects size
+	memcpy(newList->dataArray, original->dataArray,
+			sizeof(void *) * original->size);
+	newList->size = original->size;
+	
 	// Normal return:
 	// Unlock source mutex (if enabled)
 	original->notThreadSafe = notThreadSafe;
@@ -0,0 +1,275 @@
+/*
+ * This C file models the audio output as a class. Stereo samples pushed by
+ * the emulator thread go into a ring buffer, which the SDL audio callback
+ * drains on its own thread. As there is exactly one producer and one
+ * consumer, the ring is managed through a pair of atomic indices, and
+ * neither side ever blocks the other.
+ *
+ * The emulated and host clocks never quite agree, so the callback resamples
+ * at a rate nudged up or down by a fraction of a percent according to how
+ * far the ring is from its target fill level. This keeps the ring from
+ * slowly running dry or overflowing, without an audible change in pitch.
+ *
+ * AudioOutput.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+#include "../headers/AudioOutput.h"
+
+// Ring size in stereo frames (must be a power of two, so indices can wrap
+// with a mask), and the fill level we aim to keep it at - about 46 ms
+#define PHILPSX_AUDIOOUTPUT_SIZE 8192
+#define PHILPSX_AUDIOOUTPUT_MASK (PHILPSX_AUDIOOUTPUT_SIZE - 1)
+#define PHILPSX_AUDIOOUTPUT_TARGET_FRAMES 2048
+
+// Size of the device's own buffer in frames, and the most the resampling
+// rate is moved away from the nominal one to correct the fill level
+#define PHILPSX_AUDIOOUTPUT_DEVICE_FRAMES 512
+#define PHILPSX_AUDIOOUTPUT_MAX_DRIFT 0.005
+
+// Longest AudioOutput_pace will wait, in case the device has stalled
+#define PHILPSX_AUDIOOUTPUT_MAX_PACE_NS 100000000
+
+/*
+ * This struct models the structure of the ring and the state of the audio
+ * device. The indices increase monotonically and are masked on access, so
+ * the ring is empty when they are equal.
+ */
+struct AudioOutput {
+
+	// Backing store of interleaved left and right samples
+	int16_t backingStore[PHILPSX_AUDIOOUTPUT_SIZE * 2];
+
+	// Ring indices - writeMarker is only written by the emulator thread, and
+	// readMarker only by the audio callback
+	atomic_size_t writeMarker;
+	atomic_size_t readMarker;
+
+	// Number of callbacks that ran out of samples, and pushes that found the
+	// ring full
+	atomic_int_least64_t underruns;
+	atomic_int_least64_t overruns;
+
+	// Audio device, and the ratio of our sample rate to its own
+	SDL_AudioDeviceID device;
+	double rateRatio;
+
+	// Callback state - whether the ring has filled up enough to start
+	// playing (which it has to again after an underrun), how far we are
+	// between the first two frames in the ring, and the last frame played
+	bool playing;
+	double position;
+	int16_t lastFrame[2];
+};
+
+// Forward declarations for functions private to this class
+static void AudioOutput_callback(void *userdata, Uint8 *stream, int len);
+
+/*
+ * This constructs an AudioOutput object, opening and starting the default
+ * audio device. It returns NULL if there is no usable device.
+ */
+AudioOutput *construct_AudioOutput(void)
+{
+	// Allocate memory for struct
+	AudioOutput *ao = calloc(1, sizeof(AudioOutput));
+	if (!ao) {
+		fprintf(stderr, "PhilPSX: AudioOutput: Couldn't allocate memory for "
+				"AudioOutput struct\n");
+		goto end;
+	}
+
+	// Set markers and counters
+	atomic_init(&ao->writeMarker, 0);
+	atomic_init(&ao->readMarker, 0);
+	atomic_init(&ao->underruns, 0);
+	atomic_init(&ao->overruns, 0);
+
+	// Open audio device, letting it pick its own rate if ours isn't
+	// supported
+	SDL_AudioSpec desired, obtained;
+	SDL_zero(desired);
+	desired.freq = PHILPSX_AUDIOOUTPUT_SAMPLE_RATE;
+	desired.format = AUDIO_S16SYS;
+	desired.channels = 2;
+	desired.samples = PHILPSX_AUDIOOUTPUT_DEVICE_FRAMES;
+	desired.callback = AudioOutput_callback;
+	desired.userdata = ao;
+	ao->device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained,
+			SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+	if (ao->device == 0) {
+		fprintf(stderr, "PhilPSX: AudioOutput: Couldn't open audio device: "
+				"%s\n", SDL_GetError());
+		goto cleanup_audiooutput;
+	}
+	ao->rateRatio = (double)PHILPSX_AUDIOOUTPUT_SAMPLE_RATE / obtained.freq;
+
+	// Start callbacks - these play silence until the ring has filled up
+	SDL_PauseAudioDevice(ao->device, 0);
+
+	// Normal path:
+	return ao;
+
+	// Cleanup path:
+	cleanup_audiooutput:
+	free(ao);
+	ao = NULL;
+
+	end:
+	return ao;
+}
+
+/*
+ * This destructs an AudioOutput object, closing the audio device.
+ */
+void destruct_AudioOutput(AudioOutput *ao)
+{
+	SDL_CloseAudioDevice(ao->device);
+	free(ao);
+}
+
+/*
+ * This returns the number of frames currently waiting in the ring.
+ */
+int32_t AudioOutput_getFillLevel(AudioOutput *ao)
+{
+	return (int32_t)(atomic_load_explicit(&ao->writeMarker,
+			memory_order_relaxed) - atomic_load_explicit(&ao->readMarker,
+			memory_order_relaxed));
+}
+
+/*
+ * This returns the number of times the ring has run out of samples, and the
+ * number of times samples had to be dropped because it was full.
+ */
+void AudioOutput_getStats(AudioOutput *ao, int64_t *underruns,
+		int64_t *overruns)
+{
+	*underruns = atomic_load(&ao->underruns);
+	*overruns = atomic_load(&ao->overruns);
+}
+
+/*
+ * This waits until the ring has drained down to its target fill level, so
+ * that the audio device rather than the vertical retrace sets the speed of
+ * emulation. It should only be called from the emulator thread.
+ */
+void AudioOutput_pace(AudioOutput *ao)
+{
+	struct timespec nap = { 0, 1000000 };
+	int64_t waited = 0;
+	while (AudioOutput_getFillLevel(ao) > PHILPSX_AUDIOOUTPUT_TARGET_FRAMES &&
+			waited < PHILPSX_AUDIOOUTPUT_MAX_PACE_NS) {
+		nanosleep(&nap, NULL);
+		waited += nap.tv_nsec;
+	}
+}
+
+/*
+ * This copies the specified number of interleaved stereo frames into the
+ * ring. Any that don't fit are dropped. It should only be called from the
+ * emulator thread.
+ */
+void AudioOutput_pushSamples(AudioOutput *ao, const int16_t *samples,
+		int32_t frameCount)
+{
+	size_t writeMarker = atomic_load_explicit(&ao->writeMarker,
+			memory_order_relaxed);
+	size_t space = PHILPSX_AUDIOOUTPUT_SIZE - (writeMarker -
+			atomic_load_explicit(&ao->readMarker, memory_order_acquire));
+	if ((size_t)frameCount > space) {
+		frameCount = (int32_t)space;
+		atomic_fetch_add_explicit(&ao->overruns, 1, memory_order_relaxed);
+	}
+
+	// Copy in up to two pieces, either side of the end of the ring
+	size_t start = writeMarker & PHILPSX_AUDIOOUTPUT_MASK;
+	size_t firstPiece = PHILPSX_AUDIOOUTPUT_SIZE - start;
+	if (firstPiece > (size_t)frameCount)
+		firstPiece = frameCount;
+	memcpy(&ao->backingStore[start * 2], samples,
+			firstPiece * 2 * sizeof(int16_t));
+	memcpy(ao->backingStore, &samples[firstPiece * 2],
+			(frameCount - firstPiece) * 2 * sizeof(int16_t));
+
+	// Make them visible to the callback
+	atomic_store_explicit(&ao->writeMarker, writeMarker + frameCount,
+			memory_order_release);
+}
+
+/*
+ * This is the SDL audio callback, which fills the device's buffer from the
+ * ring, interpolating between frames at the drift-corrected rate. When the
+ * ring runs dry, the last frame is held until it has filled up again.
+ */
+static void AudioOutput_callback(void *userdata, Uint8 *stream, int len)
+{
+	AudioOutput *ao = userdata;
+	int16_t *output = (int16_t *)stream;
+	int32_t outputFrames = len / (2 * sizeof(int16_t));
+
+	size_t readMarker = atomic_load_explicit(&ao->readMarker,
+			memory_order_relaxed);
+	size_t writeMarker = atomic_load_explicit(&ao->writeMarker,
+			memory_order_acquire);
+	int32_t fill = (int32_t)(writeMarker - readMarker);
+
+	// Wait for the ring to fill up before (re)starting
+	if (!ao->playing && fill >= PHILPSX_AUDIOOUTPUT_TARGET_FRAMES)
+		ao->playing = true;
+
+	// Work out resampling step, nudged towards keeping the ring at the
+	// target fill level
+	double deviation = (double)(fill - PHILPSX_AUDIOOUTPUT_TARGET_FRAMES) /
+			PHILPSX_AUDIOOUTPUT_TARGET_FRAMES;
+	if (deviation > 1.0)
+		deviation = 1.0;
+	else if (deviation < -1.0)
+		deviation = -1.0;
+	double step = ao->rateRatio *
+			(1.0 + PHILPSX_AUDIOOUTPUT_MAX_DRIFT * deviation);
+
+	for (int32_t i = 0; i < outputFrames; ++i) {
+		// Hold last frame if we have run out, which counts as an underrun
+		// if we were playing
+		if (!ao->playing || writeMarker - readMarker < 2) {
+			if (ao->playing) {
+				ao->playing = false;
+				atomic_fetch_add_explicit(&ao->underruns, 1,
+						memory_order_relaxed);
+			}
+			output[i * 2] = ao->lastFrame[0];
+			output[i * 2 + 1] = ao->lastFrame[1];
+			continue;
+		}
+
+		// Interpolate between the first two frames in the ring
+		const int16_t *first = &ao->backingStore[
+				(readMarker & PHILPSX_AUDIOOUTPUT_MASK) * 2];
+		const int16_t *second = &ao->backingStore[
+				((readMarker + 1) & PHILPSX_AUDIOOUTPUT_MASK) * 2];
+		for (int32_t channel = 0; channel < 2; ++channel) {
+			ao->lastFrame[channel] = (int16_t)(first[channel] +
+					(second[channel] - first[channel]) * ao->position);
+			output[i * 2 + channel] = ao->lastFrame[channel];
+		}
+
+		// Move on, consuming frames we have passed
+		ao->position += step;
+		while (ao->position >= 1.0 && writeMarker - readMarker >= 2) {
+			ao->position -= 1.0;
+			++readMarker;
+		}
+	}
+
+	// Release the frames we have consumed
+	atomic_store_explicit(&ao->readMarker, readMarker, memory_order_release);
+}
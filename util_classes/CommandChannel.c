@@ -0,0 +1,163 @@
+/*
+ * This C file models a command channel as a class. Commands are held in a
+ * ring of slots, each with a sequence number saying whether it is free for
+ * the writer whose turn it is or holds a command for the reader. Writers
+ * claim their turn with a compare-and-swap on the write position, so any
+ * number of them can push at once, and the one reader never has to wait for
+ * anyone - checking for commands costs a single atomic load, so it can be
+ * done as often as the reader likes.
+ *
+ * CommandChannel.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../headers/CommandChannel.h"
+
+// Forward declarations for subcomponents private to this class
+typedef struct CommandChannelSlot CommandChannelSlot;
+
+/*
+ * This struct models one slot of the ring. Its sequence number equals the
+ * write position that may fill it while it is free, and is one past that
+ * once it holds a command.
+ */
+struct CommandChannelSlot {
+	atomic_uint_fast64_t sequence;
+	ChannelCommand command;
+};
+
+/*
+ * This struct models the channel, with the positions of the next slot to be
+ * written and read.
+ */
+struct CommandChannel {
+	CommandChannelSlot *slots;
+	uint64_t mask;
+	atomic_uint_fast64_t writePosition;
+	atomic_uint_fast64_t readPosition;
+};
+
+/*
+ * This constructs a CommandChannel object, able to hold the given number of
+ * commands at once, rounded up to a power of two.
+ */
+CommandChannel *construct_CommandChannel(int32_t capacity)
+{
+	// Allocate channel
+	CommandChannel *channel = malloc(sizeof(CommandChannel));
+	if (!channel) {
+		fprintf(stderr, "PhilPSX: CommandChannel: Couldn't allocate memory "
+				"for CommandChannel struct\n");
+		goto end;
+	}
+
+	// Allocate slots, each free for the write position matching its index
+	uint64_t slotCount = 1;
+	while (slotCount < (uint64_t)capacity)
+		slotCount <<= 1;
+	channel->slots = malloc(slotCount * sizeof(CommandChannelSlot));
+	if (!channel->slots) {
+		fprintf(stderr, "PhilPSX: CommandChannel: Couldn't allocate memory "
+				"for slots\n");
+		goto cleanup_channel;
+	}
+	for (uint64_t i = 0; i < slotCount; ++i)
+		atomic_init(&channel->slots[i].sequence, i);
+	channel->mask = slotCount - 1;
+	atomic_init(&channel->writePosition, 0);
+	atomic_init(&channel->readPosition, 0);
+
+	// Normal return:
+	return channel;
+
+	// Cleanup path:
+	cleanup_channel:
+	free(channel);
+	channel = NULL;
+
+	end:
+	return channel;
+}
+
+/*
+ * This destructs a CommandChannel object, dropping any commands not read.
+ */
+void destruct_CommandChannel(CommandChannel *channel)
+{
+	free(channel->slots);
+	free(channel);
+}
+
+/*
+ * This function returns true if no command is waiting to be read. It must
+ * only be called from the reading thread.
+ */
+bool CommandChannel_isEmpty(CommandChannel *channel)
+{
+	uint64_t position = atomic_load_explicit(&channel->readPosition,
+			memory_order_relaxed);
+	return atomic_load_explicit(
+			&channel->slots[position & channel->mask].sequence,
+			memory_order_acquire) != position + 1;
+}
+
+/*
+ * This function reads the oldest waiting command into command, returning
+ * false if there isn't one. It must only be called from the reading thread.
+ */
+bool CommandChannel_pop(CommandChannel *channel, ChannelCommand *command)
+{
+	uint64_t position = atomic_load_explicit(&channel->readPosition,
+			memory_order_relaxed);
+	CommandChannelSlot *slot = &channel->slots[position & channel->mask];
+	if (atomic_load_explicit(&slot->sequence, memory_order_acquire) !=
+			position + 1)
+		return false;
+
+	// Take command, then free the slot for the write position that comes
+	// round to it next
+	*command = slot->command;
+	atomic_store_explicit(&channel->readPosition, position + 1,
+			memory_order_relaxed);
+	atomic_store_explicit(&slot->sequence, position + channel->mask + 1,
+			memory_order_release);
+	return true;
+}
+
+/*
+ * This function writes a command to the channel from any thread, returning
+ * false if the channel is full.
+ */
+bool CommandChannel_push(CommandChannel *channel,
+		const ChannelCommand *command)
+{
+	uint64_t position = atomic_load_explicit(&channel->writePosition,
+			memory_order_relaxed);
+	for (;;) {
+		CommandChannelSlot *slot = &channel->slots[position & channel->mask];
+		uint64_t sequence = atomic_load_explicit(&slot->sequence,
+				memory_order_acquire);
+
+		// Claim the slot if it is free for this position - a failed claim
+		// reloads the position another writer moved it on to
+		if (sequence == position) {
+			if (atomic_compare_exchange_weak_explicit(
+					&channel->writePosition, &position, position + 1,
+					memory_order_relaxed, memory_order_relaxed)) {
+				slot->command = *command;
+				atomic_store_explicit(&slot->sequence, position + 1,
+						memory_order_release);
+				return true;
+			}
+		} else if (sequence < position) {
+			// Still holds a command from the last time round
+			return false;
+		} else {
+			position = atomic_load_explicit(&channel->writePosition,
+					memory_order_relaxed);
+		}
+	}
+}
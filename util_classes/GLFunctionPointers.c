@@ -24,6 +24,8 @@ void GLFunctionPointers_setFunctionPointers(GLFunctionPointers *gl)
 		(glActiveTexture_type)SDL_GL_GetProcAddress("glActiveTexture");
 	gl->glAttachShader =
 		(glAttachShader_type)SDL_GL_GetProcAddress("glAttachShader");
+	gl->glBindBuffer =
+		(glBindBuffer_type)SDL_GL_GetProcAddress("glBindBuffer");
 	gl->glBindBufferBase =
 		(glBindBufferBase_type)SDL_GL_GetProcAddress("glBindBufferBase");
 	gl->glBindFramebuffer =
@@ -34,8 +36,13 @@ void GLFunctionPointers_setFunctionPointers(GLFunctionPointers *gl)
 		(glBindTexture_type)SDL_GL_GetProcAddress("glBindTexture");
 	gl->glBindVertexArray =
 		(glBindVertexArray_type)SDL_GL_GetProcAddress("glBindVertexArray");
+	gl->glBlitNamedFramebuffer =
+		(glBlitNamedFramebuffer_type)SDL_GL_GetProcAddress(
+			"glBlitNamedFramebuffer");
 	gl->glBufferStorage =
 		(glBufferStorage_type)SDL_GL_GetProcAddress("glBufferStorage");
+	gl->glClientWaitSync =
+		(glClientWaitSync_type)SDL_GL_GetProcAddress("glClientWaitSync");
 	gl->glCompileShader =
 		(glCompileShader_type)SDL_GL_GetProcAddress("glCompileShader");
 	gl->glCreateBuffers =
@@ -52,6 +59,9 @@ void GLFunctionPointers_setFunctionPointers(GLFunctionPointers *gl)
 	gl->glCreateVertexArrays =
 		(glCreateVertexArrays_type)SDL_GL_GetProcAddress(
 			"glCreateVertexArrays");
+	gl->glDebugMessageCallback =
+		(glDebugMessageCallback_type)SDL_GL_GetProcAddress(
+			"glDebugMessageCallback");
 	gl->glDeleteBuffers =
 		(glDeleteBuffers_type)SDL_GL_GetProcAddress("glDeleteBuffers");
 	gl->glDeleteFramebuffers =
@@ -61,6 +71,8 @@ void GLFunctionPointers_setFunctionPointers(GLFunctionPointers *gl)
 		(glDeleteProgram_type)SDL_GL_GetProcAddress("glDeleteProgram");
 	gl->glDeleteShader =
 		(glDeleteShader_type)SDL_GL_GetProcAddress("glDeleteShader");
+	gl->glDeleteSync =
+		(glDeleteSync_type)SDL_GL_GetProcAddress("glDeleteSync");
 	gl->glDeleteTextures =
 		(glDeleteTextures_type)SDL_GL_GetProcAddress("glDeleteTextures");
 	gl->glDeleteVertexArrays =
@@ -70,24 +82,64 @@ void GLFunctionPointers_setFunctionPointers(GLFunctionPointers *gl)
 			(glDetachShader_type)SDL_GL_GetProcAddress("glDetachShader");
 	gl->glDisable =
 		(glDisable_type)SDL_GL_GetProcAddress("glDisable");
+	gl->glDispatchCompute =
+		(glDispatchCompute_type)SDL_GL_GetProcAddress("glDispatchCompute");
 	gl->glDrawArrays =
 		(glDrawArrays_type)SDL_GL_GetProcAddress("glDrawArrays");
 	gl->glDrawBuffers =
 		(glDrawBuffers_type)SDL_GL_GetProcAddress("glDrawBuffers");
+	gl->glEnable =
+		(glEnable_type)SDL_GL_GetProcAddress("glEnable");
+	gl->glEnableVertexArrayAttrib =
+		(glEnableVertexArrayAttrib_type)SDL_GL_GetProcAddress(
+			"glEnableVertexArrayAttrib");
+	gl->glFenceSync =
+		(glFenceSync_type)SDL_GL_GetProcAddress("glFenceSync");
+	gl->glFlush =
+		(glFlush_type)SDL_GL_GetProcAddress("glFlush");
 	gl->glFramebufferParameteri =
 		(glFramebufferParameteri_type)SDL_GL_GetProcAddress(
 			"glFramebufferParameteri");
 	gl->glFramebufferTexture2D =
 		(glFramebufferTexture2D_type)SDL_GL_GetProcAddress(
 			"glFramebufferTexture2D");
+	gl->glFramebufferTextureLayer =
+		(glFramebufferTextureLayer_type)SDL_GL_GetProcAddress(
+			"glFramebufferTextureLayer");
 	gl->glGetError =
 		(glGetError_type)SDL_GL_GetProcAddress("glGetError");
+	gl->glGetIntegerv =
+		(glGetIntegerv_type)SDL_GL_GetProcAddress("glGetIntegerv");
+	gl->glGetProgramBinary =
+		(glGetProgramBinary_type)SDL_GL_GetProcAddress("glGetProgramBinary");
+	gl->glGetProgramiv =
+		(glGetProgramiv_type)SDL_GL_GetProcAddress("glGetProgramiv");
 	gl->glGetShaderiv =
 		(glGetShaderiv_type)SDL_GL_GetProcAddress("glGetShaderiv");
+	gl->glGetString =
+		(glGetString_type)SDL_GL_GetProcAddress("glGetString");
+	gl->glGetStringi =
+		(glGetStringi_type)SDL_GL_GetProcAddress("glGetStringi");
 	gl->glLinkProgram =
 		(glLinkProgram_type)SDL_GL_GetProcAddress("glLinkProgram");
+	gl->glMapNamedBufferRange =
+		(glMapNamedBufferRange_type)SDL_GL_GetProcAddress(
+			"glMapNamedBufferRange");
 	gl->glMemoryBarrier =
 		(glMemoryBarrier_type)SDL_GL_GetProcAddress("glMemoryBarrier");
+	gl->glNamedBufferStorage =
+		(glNamedBufferStorage_type)SDL_GL_GetProcAddress(
+			"glNamedBufferStorage");
+	gl->glNamedFramebufferTexture =
+		(glNamedFramebufferTexture_type)SDL_GL_GetProcAddress(
+			"glNamedFramebufferTexture");
+	gl->glPixelStorei =
+		(glPixelStorei_type)SDL_GL_GetProcAddress("glPixelStorei");
+	gl->glProgramBinary =
+		(glProgramBinary_type)SDL_GL_GetProcAddress("glProgramBinary");
+	gl->glProgramParameteri =
+		(glProgramParameteri_type)SDL_GL_GetProcAddress(
+			"glProgramParameteri");
 	gl->glReadPixels =
 		(glReadPixels_type)SDL_GL_GetProcAddress("glReadPixels");
 	gl->glShaderSource =
@@ -96,14 +148,33 @@ void GLFunctionPointers_setFunctionPointers(GLFunctionPointers *gl)
 		(glTexParameteri_type)SDL_GL_GetProcAddress("glTexParameteri");
 	gl->glTexStorage2D =
 		(glTexStorage2D_type)SDL_GL_GetProcAddress("glTexStorage2D");
+	gl->glTexStorage3D =
+		(glTexStorage3D_type)SDL_GL_GetProcAddress("glTexStorage3D");
 	gl->glTexSubImage2D =
 		(glTexSubImage2D_type)SDL_GL_GetProcAddress("glTexSubImage2D");
+	gl->glTextureStorage2D =
+		(glTextureStorage2D_type)SDL_GL_GetProcAddress("glTextureStorage2D");
 	gl->glUniform1i =
 		(glUniform1i_type)SDL_GL_GetProcAddress("glUniform1i");
 	gl->glUniform3iv =
 		(glUniform3iv_type)SDL_GL_GetProcAddress("glUniform3iv");
+	gl->glUniform4iv =
+		(glUniform4iv_type)SDL_GL_GetProcAddress("glUniform4iv");
+	gl->glUnmapNamedBuffer =
+		(glUnmapNamedBuffer_type)SDL_GL_GetProcAddress("glUnmapNamedBuffer");
 	gl->glUseProgram =
 		(glUseProgram_type)SDL_GL_GetProcAddress("glUseProgram");
+	gl->glVertexArrayAttribBinding =
+		(glVertexArrayAttribBinding_type)SDL_GL_GetProcAddress(
+			"glVertexArrayAttribBinding");
+	gl->glVertexArrayAttribIFormat =
+		(glVertexArrayAttribIFormat_type)SDL_GL_GetProcAddress(
+			"glVertexArrayAttribIFormat");
+	gl->glVertexArrayVertexBuffer =
+		(glVertexArrayVertexBuffer_type)SDL_GL_GetProcAddress(
+			"glVertexArrayVertexBuffer");
 	gl->glViewport =
 		(glViewport_type)SDL_GL_GetProcAddress("glViewport");
+	gl->glWaitSync =
+		(glWaitSync_type)SDL_GL_GetProcAddress("glWaitSync");
 }
\ No newline at end of file
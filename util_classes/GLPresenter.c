@@ -0,0 +1,384 @@
+/*
+ * This C file models a GL presenter as a class. It owns three textures,
+ * which at any moment are being drawn into by the rendering thread, waiting
+ * to be shown, or being shown by the presenting thread. Finishing a frame
+ * swaps the texture drawn into with the waiting one, so if the presenting
+ * thread hasn't got to the last frame yet it is simply replaced (mailbox
+ * presentation), and neither thread ever waits for the other to finish.
+ *
+ * The presenting thread has a GL context of its own, sharing objects with
+ * the rendering thread's, and it alone swaps the window's buffers - so it is
+ * the only thread held up by the vertical retrace. Each texture carries a
+ * fence for the last GL work done with it, which whoever takes it next waits
+ * on in the GL command stream rather than on the CPU.
+ *
+ * GLPresenter.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <GL/gl.h>
+#include <SDL2/SDL.h>
+#include "../headers/GLPresenter.h"
+#include "../headers/TraceEvents.h"
+
+// Number of textures frames move between
+#define PHILPSX_GLPRESENTER_TEXTURE_COUNT 3
+
+// States of the presenting thread, while the constructor waits for it to
+// set up its context
+#define PHILPSX_GLPRESENTER_STARTING 0
+#define PHILPSX_GLPRESENTER_RUNNING 1
+#define PHILPSX_GLPRESENTER_FAILED 2
+
+// Forward declarations for functions private to this class
+static void *GLPresenter_presentFunction(void *arg);
+
+/*
+ * This struct holds the textures and the presenting thread, along with
+ * which texture each side currently has.
+ */
+struct GLPresenter {
+
+	// GL function pointers, window and the presenting thread's context
+	GLFunctionPointers *gl;
+	SDL_Window *window;
+	SDL_GLContext context;
+	int swapInterval;
+
+	// Textures, and fences for the last GL work with each of them
+	GLuint textures[PHILPSX_GLPRESENTER_TEXTURE_COUNT];
+	GLsync fences[PHILPSX_GLPRESENTER_TEXTURE_COUNT];
+
+	// Size of the frame in each texture and of the window it is to fill
+	int32_t widths[PHILPSX_GLPRESENTER_TEXTURE_COUNT];
+	int32_t heights[PHILPSX_GLPRESENTER_TEXTURE_COUNT];
+	int32_t windowWidths[PHILPSX_GLPRESENTER_TEXTURE_COUNT];
+	int32_t windowHeights[PHILPSX_GLPRESENTER_TEXTURE_COUNT];
+
+	// Which texture is being drawn into (only touched by the rendering
+	// thread), shown (only touched by the presenting thread) or waiting to
+	// be shown, and whether the waiting one holds a frame not yet shown
+	int32_t drawIndex;
+	int32_t presentIndex;
+	int32_t readyIndex;
+	bool frameReady;
+
+	// Frames shown, and frames replaced before they could be
+	int64_t framesPresented;
+	int64_t framesDropped;
+
+	// Presenting thread and its synchronisation primitives - the mutex
+	// guards everything from readyIndex down
+	pthread_t presentThread;
+	pthread_mutex_t mutex;
+	pthread_cond_t frameCondition;
+	int32_t threadState;
+	bool quit;
+};
+
+/*
+ * This constructs a GLPresenter object for the given window, and starts
+ * its presenting thread. It must be called with the rendering thread's GL
+ * context current, which is current again when this returns, and the swap
+ * interval of that context is used for presenting. It returns NULL if a
+ * shared context couldn't be set up.
+ */
+GLPresenter *construct_GLPresenter(GLFunctionPointers *gl,
+		SDL_Window *window)
+{
+	// Allocate GLPresenter struct
+	GLPresenter *presenter = malloc(sizeof(GLPresenter));
+	if (!presenter) {
+		fprintf(stderr, "PhilPSX: GLPresenter: Couldn't allocate memory for "
+				"GLPresenter struct\n");
+		goto end;
+	}
+	presenter->gl = gl;
+	presenter->window = window;
+	presenter->swapInterval = SDL_GL_GetSwapInterval();
+
+	// Create textures in the current context, so they are shared with ours
+	gl->glCreateTextures(GL_TEXTURE_2D, PHILPSX_GLPRESENTER_TEXTURE_COUNT,
+			presenter->textures);
+	for (int32_t i = 0; i < PHILPSX_GLPRESENTER_TEXTURE_COUNT; ++i) {
+		gl->glTextureStorage2D(presenter->textures[i], 1, GL_RGBA8,
+				PHILPSX_GLPRESENTER_MAX_WIDTH, PHILPSX_GLPRESENTER_MAX_HEIGHT);
+		presenter->fences[i] = NULL;
+		presenter->widths[i] = 0;
+		presenter->heights[i] = 0;
+		presenter->windowWidths[i] = 0;
+		presenter->windowHeights[i] = 0;
+	}
+	if (gl->glGetError() != GL_NO_ERROR) {
+		fprintf(stderr, "PhilPSX: GLPresenter: Couldn't create textures\n");
+		goto cleanup_textures;
+	}
+
+	// Create presenting context, sharing with the current one, then put the
+	// current one back
+	SDL_GLContext renderingContext = SDL_GL_GetCurrentContext();
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+	presenter->context = SDL_GL_CreateContext(window);
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+	if (!presenter->context) {
+		fprintf(stderr, "PhilPSX: GLPresenter: Couldn't create shared "
+				"context: %s\n", SDL_GetError());
+		SDL_GL_MakeCurrent(window, renderingContext);
+		goto cleanup_textures;
+	}
+	if (SDL_GL_MakeCurrent(window, renderingContext)) {
+		fprintf(stderr, "PhilPSX: GLPresenter: Couldn't make rendering "
+				"context current again: %s\n", SDL_GetError());
+		goto cleanup_context;
+	}
+
+	// Start with nothing to show
+	presenter->drawIndex = 0;
+	presenter->readyIndex = 1;
+	presenter->presentIndex = 2;
+	presenter->frameReady = false;
+	presenter->framesPresented = 0;
+	presenter->framesDropped = 0;
+	presenter->threadState = PHILPSX_GLPRESENTER_STARTING;
+	presenter->quit = false;
+
+	// Setup synchronisation primitives
+	if (pthread_mutex_init(&presenter->mutex, NULL)) {
+		fprintf(stderr, "PhilPSX: GLPresenter: Couldn't initialise mutex\n");
+		goto cleanup_context;
+	}
+	if (pthread_cond_init(&presenter->frameCondition, NULL)) {
+		fprintf(stderr, "PhilPSX: GLPresenter: Couldn't initialise "
+				"frameCondition\n");
+		goto cleanup_mutex;
+	}
+
+	// Start presenting thread, and wait for it to take its context
+	if (pthread_create(&presenter->presentThread, NULL,
+			&GLPresenter_presentFunction, presenter)) {
+		fprintf(stderr, "PhilPSX: GLPresenter: Couldn't start presenting "
+				"thread\n");
+		goto cleanup_condition;
+	}
+	pthread_mutex_lock(&presenter->mutex);
+	while (presenter->threadState == PHILPSX_GLPRESENTER_STARTING)
+		pthread_cond_wait(&presenter->frameCondition, &presenter->mutex);
+	bool started = presenter->threadState == PHILPSX_GLPRESENTER_RUNNING;
+	pthread_mutex_unlock(&presenter->mutex);
+	if (!started) {
+		pthread_join(presenter->presentThread, NULL);
+		goto cleanup_condition;
+	}
+
+	// Normal return:
+	return presenter;
+
+	// Cleanup path:
+	cleanup_condition:
+	pthread_cond_destroy(&presenter->frameCondition);
+
+	cleanup_mutex:
+	pthread_mutex_destroy(&presenter->mutex);
+
+	cleanup_context:
+	SDL_GL_DeleteContext(presenter->context);
+
+	cleanup_textures:
+	gl->glDeleteTextures(PHILPSX_GLPRESENTER_TEXTURE_COUNT,
+			presenter->textures);
+	free(presenter);
+	presenter = NULL;
+
+	end:
+	return presenter;
+}
+
+/*
+ * This destructs a GLPresenter object, once its presenting thread has shown
+ * what it is showing. It must be called with the rendering thread's GL
+ * context current.
+ */
+void destruct_GLPresenter(GLPresenter *presenter)
+{
+	// Stop presenting thread
+	pthread_mutex_lock(&presenter->mutex);
+	presenter->quit = true;
+	pthread_cond_signal(&presenter->frameCondition);
+	pthread_mutex_unlock(&presenter->mutex);
+	pthread_join(presenter->presentThread, NULL);
+
+	// Free everything shared between the contexts - there is nothing we can
+	// do if these calls fail
+	GLFunctionPointers *gl = presenter->gl;
+	for (int32_t i = 0; i < PHILPSX_GLPRESENTER_TEXTURE_COUNT; ++i)
+		if (presenter->fences[i])
+			gl->glDeleteSync(presenter->fences[i]);
+	gl->glDeleteTextures(PHILPSX_GLPRESENTER_TEXTURE_COUNT,
+			presenter->textures);
+	SDL_GL_DeleteContext(presenter->context);
+
+	pthread_cond_destroy(&presenter->frameCondition);
+	pthread_mutex_destroy(&presenter->mutex);
+	free(presenter);
+}
+
+/*
+ * This function returns the texture the next frame should be drawn into,
+ * with the origin at the bottom left and the frame starting there. GL work
+ * submitted after this call waits for the presenting thread to have
+ * finished with the texture. It is intended to be called from the rendering
+ * thread.
+ */
+GLuint GLPresenter_beginFrame(GLPresenter *presenter)
+{
+	int32_t index = presenter->drawIndex;
+	if (presenter->fences[index]) {
+		presenter->gl->glWaitSync(presenter->fences[index], 0,
+				GL_TIMEOUT_IGNORED);
+		presenter->gl->glDeleteSync(presenter->fences[index]);
+		presenter->fences[index] = NULL;
+	}
+
+	return presenter->textures[index];
+}
+
+/*
+ * This function hands the frame drawn since GLPresenter_beginFrame to the
+ * presenting thread, to be scaled from the given size to fill the window,
+ * replacing the last frame handed over if it hasn't been shown yet. It is
+ * intended to be called from the rendering thread.
+ */
+void GLPresenter_endFrame(GLPresenter *presenter, int32_t width,
+		int32_t height, int32_t windowWidth, int32_t windowHeight)
+{
+	// Fence the drawing, and make sure it reaches the GPU before the
+	// presenting thread waits on it
+	GLFunctionPointers *gl = presenter->gl;
+	int32_t index = presenter->drawIndex;
+	presenter->fences[index] = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,
+			0);
+	gl->glFlush();
+	presenter->widths[index] = width;
+	presenter->heights[index] = height;
+	presenter->windowWidths[index] = windowWidth;
+	presenter->windowHeights[index] = windowHeight;
+
+	// Swap it with the waiting texture
+	pthread_mutex_lock(&presenter->mutex);
+	if (presenter->frameReady)
+		++presenter->framesDropped;
+	presenter->drawIndex = presenter->readyIndex;
+	presenter->readyIndex = index;
+	presenter->frameReady = true;
+	pthread_cond_signal(&presenter->frameCondition);
+	pthread_mutex_unlock(&presenter->mutex);
+}
+
+/*
+ * This function gives the number of frames shown so far, and the number
+ * replaced by a newer one before they could be shown. It can be called from
+ * any thread.
+ */
+void GLPresenter_getStats(GLPresenter *presenter, int64_t *presented,
+		int64_t *dropped)
+{
+	pthread_mutex_lock(&presenter->mutex);
+	*presented = presenter->framesPresented;
+	*dropped = presenter->framesDropped;
+	pthread_mutex_unlock(&presenter->mutex);
+}
+
+/*
+ * This function is the presenting thread, which shows the newest frame
+ * handed over at each refresh until told to quit.
+ */
+static void *GLPresenter_presentFunction(void *arg)
+{
+	// Cast void argument back to object
+	GLPresenter *presenter = arg;
+	GLFunctionPointers *gl = presenter->gl;
+	TraceEvents_setThreadName("presenting");
+
+	// Take our context, and attach each texture to a framebuffer to blit
+	// from, as framebuffers aren't shared between contexts
+	GLuint framebuffers[PHILPSX_GLPRESENTER_TEXTURE_COUNT];
+	bool started = false;
+	if (SDL_GL_MakeCurrent(presenter->window, presenter->context)) {
+		fprintf(stderr, "PhilPSX: GLPresenter: Couldn't make presenting "
+				"context current: %s\n", SDL_GetError());
+	} else {
+		SDL_GL_SetSwapInterval(presenter->swapInterval);
+		gl->glCreateFramebuffers(PHILPSX_GLPRESENTER_TEXTURE_COUNT,
+				framebuffers);
+		for (int32_t i = 0; i < PHILPSX_GLPRESENTER_TEXTURE_COUNT; ++i)
+			gl->glNamedFramebufferTexture(framebuffers[i],
+					GL_COLOR_ATTACHMENT0, presenter->textures[i], 0);
+		started = gl->glGetError() == GL_NO_ERROR;
+		if (!started) {
+			fprintf(stderr, "PhilPSX: GLPresenter: Couldn't create "
+					"framebuffers\n");
+			gl->glDeleteFramebuffers(PHILPSX_GLPRESENTER_TEXTURE_COUNT,
+					framebuffers);
+			SDL_GL_MakeCurrent(presenter->window, NULL);
+		}
+	}
+
+	// Tell the constructor how it went
+	pthread_mutex_lock(&presenter->mutex);
+	presenter->threadState = started ? PHILPSX_GLPRESENTER_RUNNING :
+			PHILPSX_GLPRESENTER_FAILED;
+	pthread_cond_signal(&presenter->frameCondition);
+	pthread_mutex_unlock(&presenter->mutex);
+	if (!started)
+		return NULL;
+
+	while (true) {
+
+		// Wait for a frame, and swap the texture we last showed for it
+		pthread_mutex_lock(&presenter->mutex);
+		while (!presenter->frameReady && !presenter->quit)
+			pthread_cond_wait(&presenter->frameCondition, &presenter->mutex);
+		if (presenter->quit) {
+			pthread_mutex_unlock(&presenter->mutex);
+			break;
+		}
+		int32_t index = presenter->readyIndex;
+		presenter->readyIndex = presenter->presentIndex;
+		presenter->presentIndex = index;
+		presenter->frameReady = false;
+		pthread_mutex_unlock(&presenter->mutex);
+
+		// Wait in GL for the frame to be drawn, then scale it to fill the
+		// window, fencing the blit for the next time the texture is drawn
+		// into
+		if (presenter->fences[index]) {
+			gl->glWaitSync(presenter->fences[index], 0, GL_TIMEOUT_IGNORED);
+			gl->glDeleteSync(presenter->fences[index]);
+		}
+		gl->glBlitNamedFramebuffer(framebuffers[index], 0, 0, 0,
+				presenter->widths[index], presenter->heights[index], 0, 0,
+				presenter->windowWidths[index],
+				presenter->windowHeights[index], GL_COLOR_BUFFER_BIT,
+				GL_NEAREST);
+		presenter->fences[index] = gl->glFenceSync(
+				GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		// Show it, which is the only place we wait for the display
+		int64_t traceStart = PHILPSX_TRACE_BEGIN();
+		SDL_GL_SwapWindow(presenter->window);
+		PHILPSX_TRACE_END(PHILPSX_TRACE_SWAP, traceStart,
+				PHILPSX_TRACE_NO_ARGUMENT);
+		pthread_mutex_lock(&presenter->mutex);
+		++presenter->framesPresented;
+		pthread_mutex_unlock(&presenter->mutex);
+	}
+
+	// Give up our context
+	gl->glDeleteFramebuffers(PHILPSX_GLPRESENTER_TEXTURE_COUNT, framebuffers);
+	SDL_GL_MakeCurrent(presenter->window, NULL);
+
+	return NULL;
+}
@@ -0,0 +1,326 @@
+/*
+ * This C file models a cache of linked GL program binaries as a class. Each
+ * program is stored in its own file in the user's preference directory, with
+ * a header holding a key built from the driver strings and shader source -
+ * loading a program whose key doesn't match, or which the driver refuses,
+ * just reports a miss so the caller can compile it as normal. If the driver
+ * supports no binary formats, or there is nowhere to write to, the cache
+ * stays disabled and every load misses.
+ *
+ * GLProgramCache.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+#include <SDL2/SDL.h>
+#include "../headers/GLProgramCache.h"
+
+// File layout details
+#define PHILPSX_GLPROGRAMCACHE_MAGIC 0x42505350
+#define PHILPSX_GLPROGRAMCACHE_VERSION 1
+#define PHILPSX_GLPROGRAMCACHE_MAX_BINARY_SIZE (16 * 1024 * 1024)
+
+// Forward declarations for functions and subcomponents private to this class
+// File stuff:
+typedef struct GLProgramCacheHeader GLProgramCacheHeader;
+static char *GLProgramCache_getFilePath(GLProgramCache *cache,
+		const char *name, const char *suffix);
+static uint64_t GLProgramCache_getKey(GLProgramCache *cache,
+		const char *vertexShaderSource, const char *fragmentShaderSource);
+static uint64_t GLProgramCache_hash(uint64_t hash, const char *string);
+
+/*
+ * This struct is written at the start of each cache file, ahead of the
+ * program binary itself.
+ */
+struct GLProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t binaryFormat;
+	uint32_t binaryLength;
+};
+
+/*
+ * This struct stores the directory cache files live in, along with the hash
+ * of the driver strings that every key starts from.
+ */
+struct GLProgramCache {
+
+	// GL function pointers to make the actual calls with
+	GLFunctionPointers *gl;
+
+	// Directory to store files in (ending in a path separator), or NULL if
+	// the cache is disabled
+	char *directory;
+
+	// Hash of the vendor, renderer and version strings
+	uint64_t driverHash;
+};
+
+/*
+ * This constructs a GLProgramCache object. It is assumed that the GL context
+ * has been made current and the function pointers set before calling this.
+ */
+GLProgramCache *construct_GLProgramCache(GLFunctionPointers *gl)
+{
+	// Allocate memory for struct
+	GLProgramCache *cache = calloc(1, sizeof(GLProgramCache));
+	if (!cache) {
+		fprintf(stderr, "PhilPSX: GLProgramCache: Couldn't allocate memory "
+				"for GLProgramCache struct\n");
+		goto end;
+	}
+
+	// Store function pointers
+	cache->gl = gl;
+
+	// Leave the cache disabled if program binaries can't be loaded back in
+	GLint formatCount = 0;
+	gl->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	while (gl->glGetError() != GL_NO_ERROR);
+	if (formatCount <= 0)
+		goto end;
+
+	// Find directory to store files in, leaving the cache disabled if
+	// there isn't one
+	char *prefPath = SDL_GetPrefPath("Phillip Potter", "PhilPSX");
+	if (!prefPath) {
+		fprintf(stderr, "PhilPSX: GLProgramCache: Couldn't find preference "
+				"directory, shader programs won't be cached: %s\n",
+				SDL_GetError());
+		goto end;
+	}
+	cache->directory = malloc(strlen(prefPath) + 1);
+	if (cache->directory)
+		strcpy(cache->directory, prefPath);
+	SDL_free(prefPath);
+
+	// Hash driver strings
+	const char *driverStrings[] = {
+		(const char *)gl->glGetString(GL_VENDOR),
+		(const char *)gl->glGetString(GL_RENDERER),
+		(const char *)gl->glGetString(GL_VERSION)
+	};
+	cache->driverHash = 0xCBF29CE484222325;
+	for (int32_t i = 0; i < 3; ++i)
+		cache->driverHash = GLProgramCache_hash(cache->driverHash,
+				driverStrings[i] ? driverStrings[i] : "");
+
+	end:
+	return cache;
+}
+
+/*
+ * This destructs a GLProgramCache object.
+ */
+void destruct_GLProgramCache(GLProgramCache *cache)
+{
+	free(cache->directory);
+	free(cache);
+}
+
+/*
+ * This function tries to load the named program from the cache, returning
+ * the linked program if it was there and built from the same source by the
+ * same driver, or 0 otherwise.
+ */
+GLuint GLProgramCache_loadProgram(GLProgramCache *cache, const char *name,
+		const char *vertexShaderSource, const char *fragmentShaderSource)
+{
+	// Get GLFunctionPointers reference
+	GLFunctionPointers *gl = cache->gl;
+
+	// Open file for this program
+	GLuint program = 0;
+	char *path = GLProgramCache_getFilePath(cache, name, ".bin");
+	if (!path)
+		goto end;
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		goto cleanup_path;
+
+	// Check header matches what we'd store now
+	GLProgramCacheHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+			header.magic != PHILPSX_GLPROGRAMCACHE_MAGIC ||
+			header.version != PHILPSX_GLPROGRAMCACHE_VERSION ||
+			header.key != GLProgramCache_getKey(cache, vertexShaderSource,
+			fragmentShaderSource) || header.binaryLength == 0 ||
+			header.binaryLength > PHILPSX_GLPROGRAMCACHE_MAX_BINARY_SIZE)
+		goto cleanup_file;
+
+	// Read binary
+	void *binary = malloc(header.binaryLength);
+	if (!binary)
+		goto cleanup_file;
+	if (fread(binary, header.binaryLength, 1, file) != 1)
+		goto cleanup_binary;
+
+	// Hand it to the driver, which may still refuse it - any GL errors this
+	// raises are cleared, as a refused binary is just a miss
+	program = gl->glCreateProgram();
+	if (program == 0)
+		goto cleanup_binary;
+	gl->glProgramBinary(program, header.binaryFormat, binary,
+			(GLsizei)header.binaryLength);
+	GLint linkStatus = GL_FALSE;
+	gl->glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+	bool failed = false;
+	while (gl->glGetError() != GL_NO_ERROR)
+		failed = true;
+	if (failed || linkStatus != GL_TRUE) {
+		gl->glDeleteProgram(program);
+		program = 0;
+	}
+
+	// Cleanup path:
+	cleanup_binary:
+	free(binary);
+
+	cleanup_file:
+	fclose(file);
+
+	cleanup_path:
+	free(path);
+
+	end:
+	return program;
+}
+
+/*
+ * This function asks the driver to keep a program's binary around so it can
+ * be stored afterwards. It should be called after attaching shaders, but
+ * before linking.
+ */
+void GLProgramCache_prepareProgram(GLProgramCache *cache, GLuint program)
+{
+	if (!cache->directory)
+		return;
+
+	cache->gl->glProgramParameteri(program,
+			GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+/*
+ * This function stores a freshly linked program in the cache under the
+ * given name. The file is written under a temporary name and then renamed
+ * over the old one, so a reader never sees it half written. Failing to
+ * store silently leaves the cache as it was.
+ */
+void GLProgramCache_storeProgram(GLProgramCache *cache, const char *name,
+		const char *vertexShaderSource, const char *fragmentShaderSource,
+		GLuint program)
+{
+	// Nothing to do if the cache is disabled
+	if (!cache->directory)
+		goto end;
+
+	// Get GLFunctionPointers reference
+	GLFunctionPointers *gl = cache->gl;
+
+	// Fetch binary from driver
+	GLint binaryLength = 0;
+	gl->glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0 ||
+			binaryLength > PHILPSX_GLPROGRAMCACHE_MAX_BINARY_SIZE)
+		goto end;
+	void *binary = malloc(binaryLength);
+	if (!binary)
+		goto end;
+	GLProgramCacheHeader header = {
+		.magic = PHILPSX_GLPROGRAMCACHE_MAGIC,
+		.version = PHILPSX_GLPROGRAMCACHE_VERSION,
+		.key = GLProgramCache_getKey(cache, vertexShaderSource,
+				fragmentShaderSource)
+	};
+	GLenum binaryFormat = 0;
+	GLsizei length = 0;
+	gl->glGetProgramBinary(program, binaryLength, &length, &binaryFormat,
+			binary);
+	bool failed = false;
+	while (gl->glGetError() != GL_NO_ERROR)
+		failed = true;
+	if (failed || length <= 0)
+		goto cleanup_binary;
+	header.binaryFormat = binaryFormat;
+	header.binaryLength = (uint32_t)length;
+
+	// Write it out under a temporary name
+	char *tempPath = GLProgramCache_getFilePath(cache, name, ".tmp");
+	if (!tempPath)
+		goto cleanup_binary;
+	char *path = GLProgramCache_getFilePath(cache, name, ".bin");
+	if (!path)
+		goto cleanup_temp_path;
+	FILE *file = fopen(tempPath, "wb");
+	if (!file)
+		goto cleanup_path;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(binary, header.binaryLength, 1, file) == 1;
+	written = (fclose(file) == 0) && written;
+
+	// Move it into place
+	if (!written || rename(tempPath, path) != 0)
+		remove(tempPath);
+
+	// Cleanup path:
+	cleanup_path:
+	free(path);
+
+	cleanup_temp_path:
+	free(tempPath);
+
+	cleanup_binary:
+	free(binary);
+
+	end:
+	return;
+}
+
+/*
+ * This function builds the path of a cache file from the program name and a
+ * suffix, returning NULL if the cache is disabled or memory runs out. The
+ * caller frees the path.
+ */
+static char *GLProgramCache_getFilePath(GLProgramCache *cache,
+		const char *name, const char *suffix)
+{
+	if (!cache->directory)
+		return NULL;
+
+	size_t length = strlen(cache->directory) + strlen("shader_") +
+			strlen(name) + strlen(suffix) + 1;
+	char *path = malloc(length);
+	if (path)
+		snprintf(path, length, "%sshader_%s%s", cache->directory, name,
+				suffix);
+	return path;
+}
+
+/*
+ * This function builds the key for a program from the driver hash and its
+ * shader source.
+ */
+static uint64_t GLProgramCache_getKey(GLProgramCache *cache,
+		const char *vertexShaderSource, const char *fragmentShaderSource)
+{
+	uint64_t key = GLProgramCache_hash(cache->driverHash, vertexShaderSource);
+	return GLProgramCache_hash(key, fragmentShaderSource);
+}
+
+/*
+ * This function adds a string to a 64-bit FNV-1a hash, including its
+ * terminator so that neighbouring strings can't run together.
+ */
+static uint64_t GLProgramCache_hash(uint64_t hash, const char *string)
+{
+	do {
+		hash ^= (uint8_t)*string;
+		hash *= 0x100000001B3;
+	} while (*string++ != '\0');
+	return hash;
+}
@@ -0,0 +1,222 @@
+/*
+ * This C file models a small cache of OpenGL state as a class. Each setter
+ * compares against the value it last passed to GL, and only makes the GL
+ * call if something would change. Integer uniform values are remembered per
+ * program, as GL keeps them with the program object. Anything set behind the
+ * cache's back must be followed by a call to GLStateCache_invalidate.
+ *
+ * GLStateCache.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <GL/gl.h>
+#include "../headers/GLStateCache.h"
+
+// Sizes for the uniform cache
+#define PHILPSX_GLSTATECACHE_MAX_PROGRAMS 16
+#define PHILPSX_GLSTATECACHE_MAX_UNIFORMS 16
+
+// Forward declarations for functions and subcomponents private to this class
+// Uniform cache stuff:
+typedef struct GLStateCacheProgram GLStateCacheProgram;
+static GLStateCacheProgram *GLStateCache_findProgram(GLStateCache *cache,
+		GLuint program);
+
+/*
+ * This struct holds the uniform values last set for one program, with a
+ * bit set in validUniforms for each location whose value is known.
+ */
+struct GLStateCacheProgram {
+	GLuint program;
+	GLint uniforms[PHILPSX_GLSTATECACHE_MAX_UNIFORMS];
+	uint32_t validUniforms;
+};
+
+/*
+ * This struct stores the state last set through the cache, along with flags
+ * saying which parts of it are known to match GL.
+ */
+struct GLStateCache {
+
+	// GL function pointers to make the actual calls with
+	GLFunctionPointers *gl;
+
+	// Framebuffer bound to GL_FRAMEBUFFER
+	GLuint framebuffer;
+	bool framebufferValid;
+
+	// Program in use, and its uniform values if we are tracking them
+	GLuint program;
+	bool programValid;
+	GLStateCacheProgram *currentProgram;
+	GLStateCacheProgram programs[PHILPSX_GLSTATECACHE_MAX_PROGRAMS];
+	int32_t programCount;
+
+	// Active texture unit
+	GLenum activeTexture;
+	bool activeTextureValid;
+
+	// Viewport rectangle
+	GLint viewport[4];
+	bool viewportValid;
+};
+
+/*
+ * This constructs a GLStateCache object, which starts out knowing nothing
+ * about the current GL state.
+ */
+GLStateCache *construct_GLStateCache(GLFunctionPointers *gl)
+{
+	// Allocate memory for struct
+	GLStateCache *cache = calloc(1, sizeof(GLStateCache));
+	if (!cache) {
+		fprintf(stderr, "PhilPSX: GLStateCache: Couldn't allocate memory for "
+				"GLStateCache struct\n");
+		goto end;
+	}
+
+	// Store function pointers and mark everything as unknown
+	cache->gl = gl;
+	GLStateCache_invalidate(cache);
+
+	end:
+	return cache;
+}
+
+/*
+ * This destructs a GLStateCache object.
+ */
+void destruct_GLStateCache(GLStateCache *cache)
+{
+	free(cache);
+}
+
+/*
+ * This function forgets everything the cache knows, so that the next call
+ * to each setter goes through to GL. Uniform values are forgotten too, so
+ * this should be called whenever programs are deleted.
+ */
+void GLStateCache_invalidate(GLStateCache *cache)
+{
+	cache->framebufferValid = false;
+	cache->programValid = false;
+	cache->currentProgram = NULL;
+	cache->programCount = 0;
+	cache->activeTextureValid = false;
+	cache->viewportValid = false;
+}
+
+/*
+ * This function selects the active texture unit.
+ */
+void GLStateCache_activeTexture(GLStateCache *cache, GLenum texture)
+{
+	if (cache->activeTextureValid && cache->activeTexture == texture)
+		return;
+
+	cache->gl->glActiveTexture(texture);
+	cache->activeTexture = texture;
+	cache->activeTextureValid = true;
+}
+
+/*
+ * This function binds a framebuffer. Only the GL_FRAMEBUFFER target is
+ * tracked, as binding that sets both the draw and read framebuffers - other
+ * targets go straight through and leave the tracked binding unknown.
+ */
+void GLStateCache_bindFramebuffer(GLStateCache *cache, GLenum target,
+		GLuint framebuffer)
+{
+	if (target != GL_FRAMEBUFFER) {
+		cache->gl->glBindFramebuffer(target, framebuffer);
+		cache->framebufferValid = false;
+		return;
+	}
+	if (cache->framebufferValid && cache->framebuffer == framebuffer)
+		return;
+
+	cache->gl->glBindFramebuffer(target, framebuffer);
+	cache->framebuffer = framebuffer;
+	cache->framebufferValid = true;
+}
+
+/*
+ * This function sets an integer uniform of the program in use. Values for
+ * locations beyond the cache, or for programs it has no room to track, go
+ * straight through.
+ */
+void GLStateCache_uniform1i(GLStateCache *cache, GLint location, GLint v0)
+{
+	GLStateCacheProgram *program = cache->currentProgram;
+	if (!program || location < 0 ||
+			location >= PHILPSX_GLSTATECACHE_MAX_UNIFORMS) {
+		cache->gl->glUniform1i(location, v0);
+		return;
+	}
+
+	uint32_t bit = (uint32_t)1 << location;
+	if ((program->validUniforms & bit) && program->uniforms[location] == v0)
+		return;
+
+	cache->gl->glUniform1i(location, v0);
+	program->uniforms[location] = v0;
+	program->validUniforms |= bit;
+}
+
+/*
+ * This function sets the program in use.
+ */
+void GLStateCache_useProgram(GLStateCache *cache, GLuint program)
+{
+	if (cache->programValid && cache->program == program)
+		return;
+
+	cache->gl->glUseProgram(program);
+	cache->program = program;
+	cache->programValid = true;
+	cache->currentProgram = GLStateCache_findProgram(cache, program);
+}
+
+/*
+ * This function sets the viewport rectangle.
+ */
+void GLStateCache_viewport(GLStateCache *cache, GLint x, GLint y,
+		GLsizei width, GLsizei height)
+{
+	if (cache->viewportValid && cache->viewport[0] == x &&
+			cache->viewport[1] == y && cache->viewport[2] == width &&
+			cache->viewport[3] == height)
+		return;
+
+	cache->gl->glViewport(x, y, width, height);
+	cache->viewport[0] = x;
+	cache->viewport[1] = y;
+	cache->viewport[2] = width;
+	cache->viewport[3] = height;
+	cache->viewportValid = true;
+}
+
+/*
+ * This function finds the uniform cache for a program, starting a new one if
+ * there is room. It returns NULL for program 0, or if the cache is full.
+ */
+static GLStateCacheProgram *GLStateCache_findProgram(GLStateCache *cache,
+		GLuint program)
+{
+	if (program == 0)
+		return NULL;
+
+	for (int32_t i = 0; i < cache->programCount; ++i)
+		if (cache->programs[i].program == program)
+			return &cache->programs[i];
+
+	if (cache->programCount == PHILPSX_GLSTATECACHE_MAX_PROGRAMS)
+		return NULL;
+
+	GLStateCacheProgram *newProgram = &cache->programs[cache->programCount++];
+	newProgram->program = program;
+	newProgram->validUniforms = 0;
+	return newProgram;
+}
@@ -0,0 +1,198 @@
+/*
+ * This C file models a GPU trace file as a class. After a small header and
+ * the vram snapshot, the file is a series of runs, each starting with a word
+ * holding the record type in the top four bits and the number of records in
+ * the rest - runs of GP0 and GP1 records are followed by their words. Runs
+ * are gathered in memory while writing, so a long stream of GP0 words costs
+ * little more than the words themselves. Everything is little-endian.
+ *
+ * GpuTrace.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../headers/GpuTrace.h"
+#include "../headers/endian_utils.h"
+#include "../headers/math_utils.h"
+
+// File layout details
+#define PHILPSX_GPUTRACE_MAGIC 0x54585350
+#define PHILPSX_GPUTRACE_VERSION 1
+#define PHILPSX_GPUTRACE_HEADER_SIZE 8
+#define PHILPSX_GPUTRACE_MAX_RUN 4096
+
+// Forward declarations for functions and subcomponents private to this class
+// Run stuff:
+static bool GpuTrace_flushRun(GpuTrace *trace);
+static bool GpuTrace_hasWords(int32_t type);
+
+/*
+ * This struct stores the file, along with the run currently being written
+ * or read.
+ */
+struct GpuTrace {
+
+	// File and mode
+	FILE *file;
+	bool writing;
+
+	// Type and length of the current run, how far through it a reader is,
+	// and the words of a run waiting to be written
+	int32_t runType;
+	int32_t runLength;
+	int32_t runPosition;
+	int8_t runWords[PHILPSX_GPUTRACE_MAX_RUN * 4];
+};
+
+/*
+ * This constructs a GpuTrace object. When writing, the file is created and
+ * vram written to it as the snapshot - when reading, the header is checked
+ * and the snapshot read into vram. Either way, vram must hold
+ * PHILPSX_GPUTRACE_VRAM_SIZE bytes.
+ */
+GpuTrace *construct_GpuTrace(const char *path, int8_t *vram, bool writing)
+{
+	// Allocate memory for struct
+	GpuTrace *trace = calloc(1, sizeof(GpuTrace));
+	if (!trace) {
+		fprintf(stderr, "PhilPSX: GpuTrace: Couldn't allocate memory for "
+				"GpuTrace struct\n");
+		goto end;
+	}
+	trace->writing = writing;
+
+	// Open file
+	trace->file = fopen(path, writing ? "wb" : "rb");
+	if (!trace->file) {
+		fprintf(stderr, "PhilPSX: GpuTrace: Couldn't open %s\n", path);
+		goto cleanup_trace;
+	}
+
+	// Write or check header, then the vram snapshot
+	int8_t header[PHILPSX_GPUTRACE_HEADER_SIZE];
+	if (writing) {
+		write_le_word(header, PHILPSX_GPUTRACE_MAGIC);
+		write_le_word(header + 4, PHILPSX_GPUTRACE_VERSION);
+		if (fwrite(header, sizeof(header), 1, trace->file) != 1 ||
+				fwrite(vram, PHILPSX_GPUTRACE_VRAM_SIZE, 1,
+				trace->file) != 1) {
+			fprintf(stderr, "PhilPSX: GpuTrace: Couldn't write to %s\n",
+					path);
+			goto cleanup_file;
+		}
+	} else {
+		if (fread(header, sizeof(header), 1, trace->file) != 1 ||
+				read_le_word(header) != PHILPSX_GPUTRACE_MAGIC ||
+				read_le_word(header + 4) != PHILPSX_GPUTRACE_VERSION ||
+				fread(vram, PHILPSX_GPUTRACE_VRAM_SIZE, 1,
+				trace->file) != 1) {
+			fprintf(stderr, "PhilPSX: GpuTrace: %s isn't a valid trace "
+					"file\n", path);
+			goto cleanup_file;
+		}
+	}
+
+	// Normal return:
+	return trace;
+
+	// Cleanup path:
+	cleanup_file:
+	fclose(trace->file);
+
+	cleanup_trace:
+	free(trace);
+	trace = NULL;
+
+	end:
+	return trace;
+}
+
+/*
+ * This destructs a GpuTrace object, writing out any run still pending.
+ */
+void destruct_GpuTrace(GpuTrace *trace)
+{
+	if (trace->writing && !GpuTrace_flushRun(trace))
+		fprintf(stderr, "PhilPSX: GpuTrace: Couldn't write end of trace\n");
+	fclose(trace->file);
+	free(trace);
+}
+
+/*
+ * This function reads the next record, storing its type and word (zero for
+ * records without one). It returns false at the end of the trace, or if the
+ * file is truncated.
+ */
+bool GpuTrace_readRecord(GpuTrace *trace, int32_t *type, int32_t *word)
+{
+	// Start the next run if we've finished this one
+	int8_t buffer[4];
+	if (trace->runPosition == trace->runLength) {
+		if (fread(buffer, sizeof(buffer), 1, trace->file) != 1)
+			return false;
+		int32_t tag = read_le_word(buffer);
+		trace->runType = logical_rshift(tag, 28) & 0xF;
+		trace->runLength = tag & 0xFFFFFFF;
+		trace->runPosition = 0;
+		if (trace->runLength == 0)
+			return false;
+	}
+
+	// Read word if this type has one
+	*type = trace->runType;
+	*word = 0;
+	if (GpuTrace_hasWords(trace->runType)) {
+		if (fread(buffer, sizeof(buffer), 1, trace->file) != 1)
+			return false;
+		*word = read_le_word(buffer);
+	}
+	++trace->runPosition;
+	return true;
+}
+
+/*
+ * This function adds a record to the trace, starting a new run if the type
+ * differs from the last one. It returns false if the file couldn't be
+ * written to.
+ */
+bool GpuTrace_writeRecord(GpuTrace *trace, int32_t type, int32_t word)
+{
+	if ((trace->runLength > 0 && trace->runType != type) ||
+			trace->runLength == PHILPSX_GPUTRACE_MAX_RUN) {
+		if (!GpuTrace_flushRun(trace))
+			return false;
+	}
+
+	trace->runType = type;
+	if (GpuTrace_hasWords(type))
+		write_le_word(trace->runWords + trace->runLength * 4, word);
+	++trace->runLength;
+	return true;
+}
+
+/*
+ * This function writes out the pending run, if there is one.
+ */
+static bool GpuTrace_flushRun(GpuTrace *trace)
+{
+	if (trace->runLength == 0)
+		return true;
+
+	int8_t tag[4];
+	write_le_word(tag, (trace->runType << 28) | trace->runLength);
+	bool success = fwrite(tag, sizeof(tag), 1, trace->file) == 1;
+	if (success && GpuTrace_hasWords(trace->runType))
+		success = fwrite(trace->runWords, trace->runLength * 4, 1,
+				trace->file) == 1;
+	trace->runLength = 0;
+	return success;
+}
+
+/*
+ * This function tells us whether records of a given type carry a word.
+ */
+static bool GpuTrace_hasWords(int32_t type)
+{
+	return type == PHILPSX_GPUTRACE_GP0 || type == PHILPSX_GPUTRACE_GP1;
+}
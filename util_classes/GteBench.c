@@ -0,0 +1,312 @@
+/*
+ * This C file provides a conformance check and micro-benchmark for the
+ * Geometry Transformation Engine. Every GTE function is run with each
+ * combination of its sf and lm bits (and for MVMVA, each multiply matrix,
+ * multiply vector and translation vector too) over a fixed series of
+ * register states - the first built from edge case values, the rest random.
+ * The registers read back after each run are hashed per function, and
+ * checked against digests recorded from a known good implementation. Each
+ * function can then be timed. Only Cop2 is needed, so defining
+ * PHILPSX_GTEBENCH_MAIN builds this file as a program of its own alongside
+ * Cop2.c.
+ *
+ * GteBench.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../headers/GteBench.h"
+#include "../headers/Cop2_all.h"
+
+// Register states to check each variant against, and how many of them are
+// built from edge case values
+#define PHILPSX_GTEBENCH_STATES 1024
+#define PHILPSX_GTEBENCH_EDGE_STATES 256
+
+// Register states and runs per state when timing each function
+#define PHILPSX_GTEBENCH_TIMED_STATES 16
+#define PHILPSX_GTEBENCH_TIMED_RUNS 65536
+
+// Opcode bits of the COP2 command instruction, and those selecting variants
+#define PHILPSX_GTEBENCH_COMMAND 0x4A000000
+#define PHILPSX_GTEBENCH_SF 0x80000
+#define PHILPSX_GTEBENCH_LM 0x400
+
+// FNV-1a parameters for hashing results
+#define PHILPSX_GTEBENCH_FNV_BASIS 0xCBF29CE484222325UL
+#define PHILPSX_GTEBENCH_FNV_PRIME 0x100000001B3UL
+
+/*
+ * This struct describes a GTE function - its number, name, the number of
+ * variants it has (always a power of two) and the digest of all its results.
+ */
+typedef struct {
+	int32_t function;
+	const char *name;
+	int32_t variants;
+	uint64_t digest;
+} GteBenchFunction;
+
+// Functions to check, in opcode order
+static const GteBenchFunction functions[] = {
+	{0x01, "RTPS", 4, 0x443A4405588B2981UL},
+	{0x06, "NCLIP", 4, 0xE20CBE9EEFF04725UL},
+	{0x0C, "OP", 4, 0xB3B55735BBEB7D00UL},
+	{0x10, "DPCS", 4, 0xC6C0D473B834010EUL},
+	{0x11, "INTPL", 4, 0x528AF55C5A89C30BUL},
+	{0x12, "MVMVA", 256, 0x05468F6B89497778UL},
+	{0x13, "NCDS", 4, 0xDF7E8800917D19A6UL},
+	{0x14, "CDP", 4, 0x239AD2F27E726258UL},
+	{0x16, "NCDT", 4, 0xBE75DE3420D7804EUL},
+	{0x1B, "NCCS", 4, 0x81F2BFFAF07A3107UL},
+	{0x1C, "CC", 4, 0x68B36F307C905204UL},
+	{0x1E, "NCS", 4, 0x664394CAFBC44C5CUL},
+	{0x20, "NCT", 4, 0x387A19A4CE59E67AUL},
+	{0x28, "SQR", 4, 0x2EA49029F35266A1UL},
+	{0x29, "DCPL", 4, 0xD6BD5B626334F56AUL},
+	{0x2A, "DPCT", 4, 0x243A117A63FA5D94UL},
+	{0x2D, "AVSZ3", 4, 0xD5D853290A781E45UL},
+	{0x2E, "AVSZ4", 4, 0xDA0932EADA306A05UL},
+	{0x30, "RTPT", 4, 0x7F4F3DBA3BE23839UL},
+	{0x3D, "GPF", 4, 0x5E26EF4F3BC9CB83UL},
+	{0x3E, "GPL", 4, 0xE29CBA70229D9A4CUL},
+	{0x3F, "NCCT", 4, 0xBA125E6C61550993UL}
+};
+
+// Edge case register values
+static const int32_t edgeValues[] = {
+	0, 1, -1, 0x7FFF, -0x8000, 0x8000, 0xFFFF, 0x1000, -0x1000, 0x10000,
+	0x7FFFFFFF, INT32_MIN, 0x7FFF7FFF, (int32_t)0x80008000, 0x00FF00FF,
+	0x3FF, -0x400
+};
+
+// Forward declarations for functions private to this class
+static void GteBench_loadState(Cop2 *gte, int32_t state);
+static int32_t GteBench_getOpcode(const GteBenchFunction *function,
+		int32_t variant);
+static int64_t GteBench_getTime(void);
+static uint64_t GteBench_hashResults(Cop2 *gte, int32_t cycles,
+		uint64_t hash);
+static int32_t GteBench_nextValue(uint64_t *seed, bool edge);
+
+/*
+ * This function checks every GTE function against its recorded digest,
+ * printing the result for each - if timed is set, it also prints the mean
+ * time each function takes. It returns true if every function matched.
+ */
+bool GteBench_run(bool timed)
+{
+	int32_t count = sizeof(functions) / sizeof(functions[0]);
+	int32_t failures = 0;
+	Cop2 gte;
+	construct_Cop2(&gte);
+
+	for (int32_t i = 0; i < count; ++i) {
+		const GteBenchFunction *function = &functions[i];
+
+		// Run each variant over every state, hashing the results
+		uint64_t digest = PHILPSX_GTEBENCH_FNV_BASIS;
+		for (int32_t variant = 0; variant < function->variants; ++variant) {
+			int32_t opcode = GteBench_getOpcode(function, variant);
+			for (int32_t state = 0; state < PHILPSX_GTEBENCH_STATES;
+					++state) {
+				GteBench_loadState(&gte, state);
+				int32_t cycles = Cop2_gteFunction(&gte, opcode);
+				digest = GteBench_hashResults(&gte, cycles, digest);
+			}
+		}
+
+		// Report on whether this function matched
+		if (digest == function->digest) {
+			printf("PhilPSX: GteBench: %-5s ok", function->name);
+		} else {
+			printf("PhilPSX: GteBench: %-5s FAILED (digest 0x%016lX, "
+					"expected 0x%016lX)", function->name, digest,
+					function->digest);
+			++failures;
+		}
+
+		// Time function by running its variants in turn on each timing
+		// state, leaving out the cost of loading the states
+		if (timed) {
+			int32_t opcodes[256];
+			for (int32_t variant = 0; variant < function->variants;
+					++variant)
+				opcodes[variant] = GteBench_getOpcode(function, variant);
+			int64_t time = 0;
+			for (int32_t state = 0; state < PHILPSX_GTEBENCH_TIMED_STATES;
+					++state) {
+				GteBench_loadState(&gte, state * (PHILPSX_GTEBENCH_STATES /
+						PHILPSX_GTEBENCH_TIMED_STATES));
+				int64_t start = GteBench_getTime();
+				for (int32_t run = 0; run < PHILPSX_GTEBENCH_TIMED_RUNS;
+						++run)
+					Cop2_gteFunction(&gte,
+							opcodes[run & (function->variants - 1)]);
+				time += GteBench_getTime() - start;
+			}
+			printf(", %8.2f ns each", (double)time /
+					(PHILPSX_GTEBENCH_TIMED_STATES *
+					PHILPSX_GTEBENCH_TIMED_RUNS));
+		}
+		printf("\n");
+	}
+
+	printf("PhilPSX: GteBench: %d of %d functions matched\n",
+			count - failures, count);
+	return failures == 0;
+}
+
+/*
+ * This function loads the given state into the GTE. Each register is given a
+ * value it could hold on real hardware - 16-bit registers are sign or zero
+ * extended as they would read back, SXYP mirrors SXY2, and registers with no
+ * storage of their own are left alone.
+ */
+static void GteBench_loadState(Cop2 *gte, int32_t state)
+{
+	// Seed generator from state number, so states are the same every run
+	uint64_t seed = PHILPSX_GTEBENCH_FNV_BASIS ^ (uint64_t)(state + 1);
+	bool edge = state < PHILPSX_GTEBENCH_EDGE_STATES;
+
+	// Load data registers
+	for (int32_t reg = 0; reg < 32; ++reg) {
+		int32_t value = GteBench_nextValue(&seed, edge);
+		switch (reg) {
+			case 1:
+			case 3:
+			case 5:
+			case 8:
+			case 9:
+			case 10:
+			case 11:
+				value = (int16_t)value;
+				break;
+			case 7:
+			case 16:
+			case 17:
+			case 18:
+			case 19:
+				value = (uint16_t)value;
+				break;
+			case 15:
+				value = Cop2_readDataReg(gte, 14);
+				break;
+			case 23:
+			case 28:
+			case 29:
+			case 31:
+				continue;
+		}
+		Cop2_writeDataReg(gte, reg, value, true);
+	}
+
+	// Load control registers
+	for (int32_t reg = 0; reg < 32; ++reg) {
+		int32_t value = GteBench_nextValue(&seed, edge);
+		switch (reg) {
+			case 4:
+			case 12:
+			case 20:
+			case 27:
+			case 29:
+			case 30:
+				value = (int16_t)value;
+				break;
+			case 26:
+				value = (uint16_t)value;
+				break;
+		}
+		Cop2_writeControlReg(gte, reg, value, true);
+	}
+}
+
+/*
+ * This function builds the opcode for a variant of a function. Bit 0 of the
+ * variant number selects sf, bit 1 selects lm, and the rest fill the
+ * translation vector, multiply vector and multiply matrix fields in turn.
+ */
+static int32_t GteBench_getOpcode(const GteBenchFunction *function,
+		int32_t variant)
+{
+	return PHILPSX_GTEBENCH_COMMAND | function->function |
+			((variant & 1) ? PHILPSX_GTEBENCH_SF : 0) |
+			((variant & 2) ? PHILPSX_GTEBENCH_LM : 0) |
+			((variant >> 2) << 13);
+}
+
+/*
+ * This function gets the time from the host's monotonic clock, in
+ * nanoseconds.
+ */
+static int64_t GteBench_getTime(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ * This function adds the cycle count and every register, as read back by the
+ * CPU, to the hash.
+ */
+static uint64_t GteBench_hashResults(Cop2 *gte, int32_t cycles,
+		uint64_t hash)
+{
+	hash = (hash ^ (uint32_t)cycles) * PHILPSX_GTEBENCH_FNV_PRIME;
+	for (int32_t reg = 0; reg < 32; ++reg) {
+		hash = (hash ^ (uint32_t)Cop2_readDataReg(gte, reg)) *
+				PHILPSX_GTEBENCH_FNV_PRIME;
+		hash = (hash ^ (uint32_t)Cop2_readControlReg(gte, reg)) *
+				PHILPSX_GTEBENCH_FNV_PRIME;
+	}
+	return hash;
+}
+
+/*
+ * This function generates the next register value from the seed, using an
+ * xorshift generator. Edge case values come from a fixed list, while random
+ * ones are spread over a range of magnitudes so that both in-range and
+ * saturating results are covered.
+ */
+static int32_t GteBench_nextValue(uint64_t *seed, bool edge)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 7;
+	*seed ^= *seed << 17;
+	uint32_t random = (uint32_t)(*seed >> 16);
+
+	if (edge)
+		return edgeValues[random % (sizeof(edgeValues) /
+				sizeof(edgeValues[0]))];
+
+	// Pick a magnitude from the low bits, then use the rest as the value
+	int32_t value = (int32_t)(random & 0xFFFFFFF0);
+	switch (random & 0x3) {
+		case 0:
+			return value;
+		case 1:
+			return value >> 12;
+		case 2:
+			return (int32_t)((uint32_t)(value >> 20) & 0xFFFF) |
+					((value >> 24) << 16);
+		default:
+			return value >> 23;
+	}
+}
+
+#ifdef PHILPSX_GTEBENCH_MAIN
+/*
+ * This is the entry point when built as a program of its own. Passing
+ * -check leaves out the timings. It returns non-zero if any function didn't
+ * match its recorded digest.
+ */
+int main(int argc, char **argv)
+{
+	bool timed = !(argc > 1 && strlen(argv[1]) == 6 &&
+			strncmp(argv[1], "-check", 6) == 0);
+	return GteBench_run(timed) ? 0 : 1;
+}
+#endif
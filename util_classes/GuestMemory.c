@@ -0,0 +1,159 @@
+/*
+ * This C file models guest memory as a class. The whole mapping is first
+ * reserved as inaccessible, aligned to a 2 MiB boundary, and each region is
+ * then given its own slot in it, rounded up to a whole number of 2 MiB
+ * pages with at least one ordinary page left over as a guard. Each region
+ * is mapped over its part of the reservation - with huge pages if it fills
+ * them exactly and the host has any free, or else with ordinary pages, with
+ * transparent huge pages asked for where the region is big enough to use
+ * them. A failed huge page mapping can take that part of the reservation
+ * with it, so the ordinary mapping is made over it in the same way.
+ *
+ * GuestMemory.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#define _DEFAULT_SOURCE
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../headers/GuestMemory.h"
+
+// Size of a huge page, which every region starts on a boundary of
+#define PHILPSX_GUESTMEMORY_HUGE_PAGE_SIZE 0x200000
+
+// Forward declarations for functions private to this class
+static size_t GuestMemory_roundUp(size_t value, size_t alignment);
+
+/*
+ * This struct models the mapping, along with where each region is in it.
+ */
+struct GuestMemory {
+
+	// Whole mapping, including the guard pages
+	uint8_t *mapping;
+	size_t mappingSize;
+
+	// Regions
+	void *regions[PHILPSX_GUESTMEMORY_MAX_REGIONS];
+	int32_t regionCount;
+};
+
+/*
+ * This constructs a GuestMemory object holding regions of the given sizes,
+ * in order. It returns NULL if the mapping couldn't be set up.
+ */
+GuestMemory *construct_GuestMemory(const size_t *regionSizes,
+		int32_t regionCount)
+{
+	// Allocate GuestMemory struct
+	GuestMemory *gm = calloc(1, sizeof(GuestMemory));
+	if (!gm) {
+		fprintf(stderr, "PhilPSX: GuestMemory: Couldn't allocate memory for "
+				"GuestMemory struct\n");
+		goto end;
+	}
+	if (regionCount < 1 || regionCount > PHILPSX_GUESTMEMORY_MAX_REGIONS) {
+		fprintf(stderr, "PhilPSX: GuestMemory: Invalid region count %d\n",
+				regionCount);
+		goto cleanup_guestmemory;
+	}
+	gm->regionCount = regionCount;
+
+	// Work out the size of the mapping, leaving a guard page after each
+	// region
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	for (int32_t i = 0; i < regionCount; ++i)
+		gm->mappingSize += GuestMemory_roundUp(regionSizes[i] + pageSize,
+				PHILPSX_GUESTMEMORY_HUGE_PAGE_SIZE);
+
+	// Reserve it with room to align it, then trim the excess off either end
+	size_t reservationSize = gm->mappingSize +
+			PHILPSX_GUESTMEMORY_HUGE_PAGE_SIZE;
+	uint8_t *reservation = mmap(NULL, reservationSize, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (reservation == MAP_FAILED) {
+		fprintf(stderr, "PhilPSX: GuestMemory: Couldn't reserve %zu bytes "
+				"of address space\n", reservationSize);
+		goto cleanup_guestmemory;
+	}
+	gm->mapping = (uint8_t *)GuestMemory_roundUp((uintptr_t)reservation,
+			PHILPSX_GUESTMEMORY_HUGE_PAGE_SIZE);
+	if (gm->mapping > reservation)
+		munmap(reservation, gm->mapping - reservation);
+	if (reservation + reservationSize > gm->mapping + gm->mappingSize)
+		munmap(gm->mapping + gm->mappingSize, reservation +
+				reservationSize - (gm->mapping + gm->mappingSize));
+
+	// Map each region, trying huge pages first where they fit it exactly -
+	// the guard pages after it are left inaccessible
+	uint8_t *region = gm->mapping;
+	for (int32_t i = 0; i < regionCount; ++i) {
+		size_t size = GuestMemory_roundUp(regionSizes[i], pageSize);
+		bool mapped = false;
+#ifdef MAP_HUGETLB
+		if (size % PHILPSX_GUESTMEMORY_HUGE_PAGE_SIZE == 0)
+			mapped = mmap(region, size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB,
+					-1, 0) != MAP_FAILED;
+#endif
+		if (!mapped) {
+			if (mmap(region, size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) ==
+					MAP_FAILED) {
+				fprintf(stderr, "PhilPSX: GuestMemory: Couldn't map "
+						"region %d\n", i);
+				goto cleanup_mapping;
+			}
+#ifdef MADV_HUGEPAGE
+			if (size >= PHILPSX_GUESTMEMORY_HUGE_PAGE_SIZE)
+				madvise(region, size, MADV_HUGEPAGE);
+#endif
+		}
+		gm->regions[i] = region;
+		region += GuestMemory_roundUp(regionSizes[i] + pageSize,
+				PHILPSX_GUESTMEMORY_HUGE_PAGE_SIZE);
+	}
+
+	// Normal return:
+	return gm;
+
+	// Cleanup path:
+	cleanup_mapping:
+	munmap(gm->mapping, gm->mappingSize);
+
+	cleanup_guestmemory:
+	free(gm);
+	gm = NULL;
+
+	end:
+	return gm;
+}
+
+/*
+ * This destructs a GuestMemory object, unmapping every region.
+ */
+void destruct_GuestMemory(GuestMemory *gm)
+{
+	munmap(gm->mapping, gm->mappingSize);
+	free(gm);
+}
+
+/*
+ * This function returns the start of the given region.
+ */
+void *GuestMemory_getRegion(GuestMemory *gm, int32_t region)
+{
+	return gm->regions[region];
+}
+
+/*
+ * This function rounds the value up to a multiple of the alignment, which
+ * must be a power of two.
+ */
+static size_t GuestMemory_roundUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
@@ -2,6 +2,8 @@
  * This C file models a simple singly-linked list implementation as a class. It
  * also performs bounds checking where appropriate (when using indexes).
  * Thread safety is provided for all operations individually when enabled.
+ * Nodes come from a memory pool belonging to the list, so adding and removing
+ * objects only allocates when the list grows past its largest size so far.
  * Most pthread errors (other than those related to mutex initialisation) are
  * not checked for, as it is assumed they cannot occur under the use case for
  * which this linked list was written.
@@ -16,12 +18,16 @@
 #include <string.h>
 #include <pthread.h>
 #include "../headers/LinkedList.h"
+#include "../headers/MemoryPool.h"
+
+// Number of nodes allocated at a time by the node pool
+#define PHILPSX_LINKEDLIST_NODES_PER_BLOCK 32
 
 // Forward declarations for functions and subcomponents private to this class
 // ListNode-related stuff:
 typedef struct ListNode ListNode;
-static ListNode *construct_ListNode(void);
-static void destruct_ListNode(ListNode *ln);
+static ListNode *construct_ListNode(LinkedList *ll);
+static void destruct_ListNode(LinkedList *ll, ListNode *ln);
 
 /*
  * This struct models the list, as well as other state info to help with
@@ -38,6 +44,9 @@ struct LinkedList {
 	// Pointer to the last node of the list
 	ListNode *end;
 	
+	// Pool the nodes are allocated from
+	MemoryPool *nodePool;
+	
 	// Function pointer for destructing objects stored in nodes
 	void (*destructPtr)(void *object);
 	
@@ -93,6 +102,15 @@ LinkedList *construct_LinkedList(void (*destructPtr)(void *object),
 		}
 	}
 	
+	// Setup node pool
+	ll->nodePool = construct_MemoryPool(sizeof(ListNode),
+			PHILPSX_LINKEDLIST_NODES_PER_BLOCK);
+	if (!ll->nodePool) {
+		fprintf(stderr, "PhilPSX: LinkedList: Couldn't construct node "
+				"pool\n");
+		goto cleanup_mutex;
+	}
+	
 	// Set head and end to NULL as we are currently empty
 	ll->head = NULL;
 	ll->end = NULL;
@@ -110,6 +128,10 @@ LinkedList *construct_LinkedList(void (*destructPtr)(void *object),
 	return ll;
 	
 	// Cleanup path:
+	cleanup_mutex:
+	if (!notThreadSafe)
+		pthread_mutex_destroy(&ll->mutex);
+	
 	cleanup_linkedlist:
 	free(ll);
 	ll = NULL;
@@ -144,9 +166,11 @@ void destruct_LinkedList(LinkedList *ll)
 					free(toDestruct->object);
 			}
 		}
-		destruct_ListNode(toDestruct);
 	}
 	
+	// Free every node at once
+	destruct_MemoryPool(ll->nodePool);
+	
 	// Destroy mutex (if enabled)
 	if (!ll->notThreadSafe)
 		pthread_mutex_destroy(&ll->mutex);
@@ -204,7 +228,7 @@ void *LinkedList_addObject(LinkedList *ll, void *object)
 	}
 
 	// Add new item to end of list
-	*listWalker = construct_ListNode();
+	*listWalker = construct_ListNode(ll);
 	if (!*listWalker) {
 		fprintf(stderr, "PhilPSX: LinkedList: Couldn't allocate memory for "
 				"ListNode struct...\n");
@@ -251,7 +275,7 @@ void *LinkedList_addObjectAt(LinkedList *ll, size_t index, void *object)
 		// we know construct function has succeeded, thus preventing change of
 		// the list until the last moment
 		ListNode *current = *toHead;
-		ListNode *new = construct_ListNode();
+		ListNode *new = construct_ListNode(ll);
 		if (!new) {
 			fprintf(stderr, "PhilPSX: LinkedList: Couldn't allocate memory for "
 					"ListNode struct...\n");
@@ -330,7 +354,7 @@ void LinkedList_removeObject(LinkedList *ll, size_t index)
 				// produce garbage - list is empty so set end to NULL
 				ll->end = NULL;				
 		}
-		destruct_ListNode(toDestruct);
+		destruct_ListNode(ll, toDestruct);
 
         // Decrement size
         --ll->size;
@@ -454,9 +478,11 @@ void LinkedList_wipeAllObjects(LinkedList *ll)
 					free(toDestruct->object);
 			}
 		}
-		destruct_ListNode(toDestruct);
 	}
 	
+	// Give every node back to the pool at once
+	MemoryPool_reset(ll->nodePool);
+	
 	// Set head and end back to NULL
 	ll->head = NULL;
 	ll->end = NULL;
@@ -534,12 +560,12 @@ LinkedList *LinkedList_clone(LinkedList *original)
 }
 
 /*
- * This constructs a ListNode object.
+ * This constructs a ListNode object from the list's node pool.
  */
-static ListNode *construct_ListNode(void)
+static ListNode *construct_ListNode(LinkedList *ll)
 {
 	// Allocate node
-	ListNode *ln = malloc(sizeof(ListNode));
+	ListNode *ln = MemoryPool_allocate(ll->nodePool);
 	if (!ln) {
 		fprintf(stderr, "PhilPSX: LinkedList: ListNode: Couldn't allocate "
 				"memory for ListNode struct\n");
@@ -555,9 +581,9 @@ static ListNode *construct_ListNode(void)
 }
 
 /*
- * This destructs a ListNode object.
+ * This destructs a ListNode object, giving it back to the list's node pool.
  */
-static void destruct_ListNode(ListNode *ln)
+static void destruct_ListNode(LinkedList *ll, ListNode *ln)
 {
-	free(ln);
+	MemoryPool_free(ll->nodePool, ln);
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+ * This C file models a memory pool as a class. Objects are carved from
+ * blocks in the order the blocks were allocated, and freed objects are kept
+ * on a list threaded through the objects themselves, which is used first.
+ * Resetting the pool empties the list and starts carving from the first
+ * block again, so a pool that is filled and reset over and over stops
+ * allocating once it has grown to its largest size.
+ *
+ * MemoryPool.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../headers/MemoryPool.h"
+
+// Alignment of every object, and the size of a block's header rounded up to
+// it so that the first object is aligned too
+#define PHILPSX_MEMORYPOOL_ALIGNMENT _Alignof(max_align_t)
+#define PHILPSX_MEMORYPOOL_HEADER_SIZE \
+		((sizeof(MemoryPoolBlock) + PHILPSX_MEMORYPOOL_ALIGNMENT - 1) & \
+		~(PHILPSX_MEMORYPOOL_ALIGNMENT - 1))
+
+// Forward declarations for subcomponents private to this class
+typedef struct MemoryPoolBlock MemoryPoolBlock;
+
+/*
+ * This struct models the pool, along with how far through its blocks it has
+ * got.
+ */
+struct MemoryPool {
+
+	// Size of each object rounded up to the alignment, and how many of them
+	// fit in each block
+	size_t slotSize;
+	size_t objectsPerBlock;
+
+	// Every block, in the order they were allocated
+	MemoryPoolBlock *firstBlock;
+
+	// Block objects are being carved from (NULL before the first one), and
+	// the next object in it that hasn't been handed out yet
+	MemoryPoolBlock *currentBlock;
+	size_t nextSlot;
+
+	// Objects freed since the last reset
+	void *freeList;
+};
+
+/*
+ * This struct models the header at the start of each block, with the
+ * objects following it.
+ */
+struct MemoryPoolBlock {
+	MemoryPoolBlock *next;
+};
+
+/*
+ * This constructs a MemoryPool object, handing out objects of the given size
+ * from blocks holding the given number of them. No block is allocated until
+ * the first object is asked for.
+ */
+MemoryPool *construct_MemoryPool(size_t objectSize, size_t objectsPerBlock)
+{
+	// Allocate pool
+	MemoryPool *pool = malloc(sizeof(MemoryPool));
+	if (!pool) {
+		fprintf(stderr, "PhilPSX: MemoryPool: Couldn't allocate memory for "
+				"MemoryPool struct\n");
+		goto end;
+	}
+
+	// Make room in each object for the free list, and keep them aligned
+	if (objectSize < sizeof(void *))
+		objectSize = sizeof(void *);
+	pool->slotSize = (objectSize + PHILPSX_MEMORYPOOL_ALIGNMENT - 1) &
+			~(PHILPSX_MEMORYPOOL_ALIGNMENT - 1);
+	pool->objectsPerBlock = objectsPerBlock > 0 ? objectsPerBlock : 1;
+
+	// Start with no blocks
+	pool->firstBlock = NULL;
+	pool->currentBlock = NULL;
+	pool->nextSlot = 0;
+	pool->freeList = NULL;
+
+	end:
+	return pool;
+}
+
+/*
+ * This destructs a MemoryPool object, along with every object it handed out.
+ */
+void destruct_MemoryPool(MemoryPool *pool)
+{
+	MemoryPoolBlock *block = pool->firstBlock;
+	while (block) {
+		MemoryPoolBlock *toFree = block;
+		block = block->next;
+		free(toFree);
+	}
+
+	free(pool);
+}
+
+/*
+ * This function hands out an object from the pool, reusing a freed one if
+ * there is one, and only allocating a new block when every block is full.
+ * It returns NULL if a new block couldn't be allocated.
+ */
+void *MemoryPool_allocate(MemoryPool *pool)
+{
+	// Reuse the most recently freed object
+	if (pool->freeList) {
+		void *object = pool->freeList;
+		pool->freeList = *(void **)object;
+		return object;
+	}
+
+	// Move on to the next block if the current one is full, allocating it
+	// if we have never got this far before
+	if (!pool->currentBlock || pool->nextSlot == pool->objectsPerBlock) {
+		MemoryPoolBlock *next = pool->currentBlock ?
+				pool->currentBlock->next : pool->firstBlock;
+		if (!next) {
+			next = malloc(PHILPSX_MEMORYPOOL_HEADER_SIZE +
+					pool->slotSize * pool->objectsPerBlock);
+			if (!next) {
+				fprintf(stderr, "PhilPSX: MemoryPool: Couldn't allocate "
+						"memory for block\n");
+				return NULL;
+			}
+			next->next = NULL;
+			if (pool->currentBlock)
+				pool->currentBlock->next = next;
+			else
+				pool->firstBlock = next;
+		}
+		pool->currentBlock = next;
+		pool->nextSlot = 0;
+	}
+
+	// Carve the next object from the current block
+	return (uint8_t *)pool->currentBlock + PHILPSX_MEMORYPOOL_HEADER_SIZE +
+			pool->slotSize * pool->nextSlot++;
+}
+
+/*
+ * This function gives an object back to the pool, to be handed out again
+ * before any more of the pool is used. Freeing NULL does nothing.
+ */
+void MemoryPool_free(MemoryPool *pool, void *object)
+{
+	if (!object)
+		return;
+
+	*(void **)object = pool->freeList;
+	pool->freeList = object;
+}
+
+/*
+ * This function takes back every object handed out by the pool at once,
+ * keeping its blocks to hand out again.
+ */
+void MemoryPool_reset(MemoryPool *pool)
+{
+	pool->freeList = NULL;
+	pool->currentBlock = NULL;
+	pool->nextSlot = 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * This C file models the performance counters. Each thread that counts
+ * something gets its own block of counters the first time it does so, which
+ * only it ever writes to, so counting needs no locking or atomic
+ * read-modify-write. Blocks are linked into a list so that any thread can
+ * read them, either one at a time or summed together, and are kept until
+ * the program ends so that counts from threads that have finished still
+ * show up in the totals.
+ *
+ * PerfCounters.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../headers/PerfCounters.h"
+
+// Longest thread name kept, including the terminator
+#define PHILPSX_PERF_THREAD_NAME_SIZE 32
+
+/*
+ * This struct holds one thread's counters, and links to the block of the
+ * thread registered before it.
+ */
+typedef struct PerfThread PerfThread;
+struct PerfThread {
+	char name[PHILPSX_PERF_THREAD_NAME_SIZE];
+	int64_t values[PHILPSX_PERF_COUNTER_COUNT];
+	PerfThread *next;
+};
+
+// Registered threads, newest first, along with how many there are - the
+// mutex is only taken to register a thread or walk the list
+static pthread_mutex_t PerfCounters_mutex = PTHREAD_MUTEX_INITIALIZER;
+static PerfThread *PerfCounters_threads = NULL;
+static int32_t PerfCounters_threadCount = 0;
+
+// The calling thread's block, and its counters for PerfCounters_add
+static _Thread_local PerfThread *PerfCounters_thread = NULL;
+_Thread_local int64_t *PerfCounters_threadValues = NULL;
+
+// Counter names, with GTE functions named after their opcodes
+static const char *PerfCounters_names[PHILPSX_PERF_COUNTER_COUNT] = {
+	[PHILPSX_PERF_INSTRUCTIONS] = "instructions",
+	[PHILPSX_PERF_EXCEPTIONS] = "exceptions",
+	[PHILPSX_PERF_INTERRUPTS] = "interrupts",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_MEMCTRL] = "mmio_memctrl",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_PERIPHERAL] = "mmio_peripheral",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_INTERRUPT] = "mmio_interrupt",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_DMA] = "mmio_dma",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_TIMERS] = "mmio_timers",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_CDROM] = "mmio_cdrom",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_GPU] = "mmio_gpu",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_MDEC] = "mmio_mdec",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_SPU] = "mmio_spu",
+	[PHILPSX_PERF_MMIO + PHILPSX_PERF_MMIO_OTHER] = "mmio_other",
+	[PHILPSX_PERF_DMA_WORDS + 0] = "dma_words_mdec_in",
+	[PHILPSX_PERF_DMA_WORDS + 1] = "dma_words_mdec_out",
+	[PHILPSX_PERF_DMA_WORDS + 2] = "dma_words_gpu",
+	[PHILPSX_PERF_DMA_WORDS + 3] = "dma_words_cdrom",
+	[PHILPSX_PERF_DMA_WORDS + 4] = "dma_words_spu",
+	[PHILPSX_PERF_DMA_WORDS + 5] = "dma_words_pio",
+	[PHILPSX_PERF_DMA_WORDS + 6] = "dma_words_otc",
+	[PHILPSX_PERF_GPU_PRIMITIVES + PHILPSX_PERF_PRIMITIVE_POLYGON] =
+			"gpu_polygons",
+	[PHILPSX_PERF_GPU_PRIMITIVES + PHILPSX_PERF_PRIMITIVE_RECTANGLE] =
+			"gpu_rectangles",
+	[PHILPSX_PERF_GPU_PRIMITIVES + PHILPSX_PERF_PRIMITIVE_LINE] =
+			"gpu_lines",
+	[PHILPSX_PERF_GPU_PRIMITIVES + PHILPSX_PERF_PRIMITIVE_FILL] =
+			"gpu_fills",
+	[PHILPSX_PERF_GPU_PRIMITIVES + PHILPSX_PERF_PRIMITIVE_VRAM_COPY] =
+			"gpu_vram_copies",
+	[PHILPSX_PERF_GPU_PRIMITIVES + PHILPSX_PERF_PRIMITIVE_VRAM_WRITE] =
+			"gpu_vram_writes",
+	[PHILPSX_PERF_GPU_PRIMITIVES + PHILPSX_PERF_PRIMITIVE_VRAM_READ] =
+			"gpu_vram_reads",
+	[PHILPSX_PERF_WORKQUEUE_COMMANDS] = "workqueue_commands",
+	[PHILPSX_PERF_WORKQUEUE_DEPTH] = "workqueue_depth_words",
+	[PHILPSX_PERF_WORKQUEUE_STALLS] = "workqueue_stalls",
+	[PHILPSX_PERF_WORKQUEUE_STALL_NS] = "workqueue_stall_ns",
+	[PHILPSX_PERF_CD_SECTORS] = "cd_sectors",
+	[PHILPSX_PERF_CD_XA_SECTORS] = "cd_xa_sectors",
+	[PHILPSX_PERF_GTE_OPS + 0x01] = "gte_rtps",
+	[PHILPSX_PERF_GTE_OPS + 0x06] = "gte_nclip",
+	[PHILPSX_PERF_GTE_OPS + 0x0C] = "gte_op",
+	[PHILPSX_PERF_GTE_OPS + 0x10] = "gte_dpcs",
+	[PHILPSX_PERF_GTE_OPS + 0x11] = "gte_intpl",
+	[PHILPSX_PERF_GTE_OPS + 0x12] = "gte_mvmva",
+	[PHILPSX_PERF_GTE_OPS + 0x13] = "gte_ncds",
+	[PHILPSX_PERF_GTE_OPS + 0x14] = "gte_cdp",
+	[PHILPSX_PERF_GTE_OPS + 0x16] = "gte_ncdt",
+	[PHILPSX_PERF_GTE_OPS + 0x1B] = "gte_nccs",
+	[PHILPSX_PERF_GTE_OPS + 0x1C] = "gte_cc",
+	[PHILPSX_PERF_GTE_OPS + 0x1E] = "gte_ncs",
+	[PHILPSX_PERF_GTE_OPS + 0x20] = "gte_nct",
+	[PHILPSX_PERF_GTE_OPS + 0x28] = "gte_sqr",
+	[PHILPSX_PERF_GTE_OPS + 0x29] = "gte_dcpl",
+	[PHILPSX_PERF_GTE_OPS + 0x2A] = "gte_dpct",
+	[PHILPSX_PERF_GTE_OPS + 0x2D] = "gte_avsz3",
+	[PHILPSX_PERF_GTE_OPS + 0x2E] = "gte_avsz4",
+	[PHILPSX_PERF_GTE_OPS + 0x30] = "gte_rtpt",
+	[PHILPSX_PERF_GTE_OPS + 0x3D] = "gte_gpf",
+	[PHILPSX_PERF_GTE_OPS + 0x3E] = "gte_gpl",
+	[PHILPSX_PERF_GTE_OPS + 0x3F] = "gte_ncct"
+};
+
+/*
+ * This function frees every thread's counters. It must only be called once
+ * all other threads that counted anything have ended.
+ */
+void PerfCounters_cleanup(void)
+{
+	pthread_mutex_lock(&PerfCounters_mutex);
+	PerfThread *thread = PerfCounters_threads;
+	while (thread) {
+		PerfThread *next = thread->next;
+		free(thread);
+		thread = next;
+	}
+	PerfCounters_threads = NULL;
+	PerfCounters_threadCount = 0;
+	pthread_mutex_unlock(&PerfCounters_mutex);
+
+	PerfCounters_thread = NULL;
+	PerfCounters_threadValues = NULL;
+}
+
+/*
+ * This function returns the name of the specified counter, which is
+ * "gte_unknown" for GTE opcodes that aren't real functions.
+ */
+const char *PerfCounters_getName(int32_t counter)
+{
+	if (counter < 0 || counter >= PHILPSX_PERF_COUNTER_COUNT)
+		return NULL;
+	return PerfCounters_names[counter] ? PerfCounters_names[counter] :
+			"gte_unknown";
+}
+
+/*
+ * This function works out which MMIO region the specified physical address
+ * falls in, which must be within the I/O port region.
+ */
+int32_t PerfCounters_getMmioRegion(int32_t address)
+{
+	int32_t offset = address & 0xFFF;
+	if (offset < 0x40 || (offset >= 0x60 && offset < 0x70))
+		return PHILPSX_PERF_MMIO_MEMCTRL;
+	if (offset < 0x60)
+		return PHILPSX_PERF_MMIO_PERIPHERAL;
+	if (offset < 0x80)
+		return PHILPSX_PERF_MMIO_INTERRUPT;
+	if (offset < 0x100)
+		return PHILPSX_PERF_MMIO_DMA;
+	if (offset < 0x130)
+		return PHILPSX_PERF_MMIO_TIMERS;
+	if (offset >= 0x800 && offset < 0x810)
+		return PHILPSX_PERF_MMIO_CDROM;
+	if (offset >= 0x810 && offset < 0x820)
+		return PHILPSX_PERF_MMIO_GPU;
+	if (offset >= 0x820 && offset < 0x830)
+		return PHILPSX_PERF_MMIO_MDEC;
+	if (offset >= 0xC00)
+		return PHILPSX_PERF_MMIO_SPU;
+	return PHILPSX_PERF_MMIO_OTHER;
+}
+
+/*
+ * This function returns how many threads have counters so far.
+ */
+int32_t PerfCounters_getThreadCount(void)
+{
+	pthread_mutex_lock(&PerfCounters_mutex);
+	int32_t threadCount = PerfCounters_threadCount;
+	pthread_mutex_unlock(&PerfCounters_mutex);
+	return threadCount;
+}
+
+/*
+ * This function returns the name of the specified thread, numbered in the
+ * order they were registered, or NULL if there is no such thread.
+ */
+const char *PerfCounters_getThreadName(int32_t thread)
+{
+	const char *name = NULL;
+	pthread_mutex_lock(&PerfCounters_mutex);
+	int32_t index = PerfCounters_threadCount - 1;
+	for (PerfThread *current = PerfCounters_threads; current;
+			current = current->next, --index) {
+		if (index == thread) {
+			name = current->name;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&PerfCounters_mutex);
+	return name;
+}
+
+/*
+ * This function returns the current time in nanoseconds, for timing stalls.
+ */
+int64_t PerfCounters_getTime(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ * This function tells the caller whether the counters were compiled in.
+ */
+bool PerfCounters_isEnabled(void)
+{
+#ifdef PHILPSX_PERF_COUNTERS
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * This function reads the counters of the specified thread into values, or
+ * the sum of every thread's if PHILPSX_PERF_ALL_THREADS is passed. Counts
+ * still being added to are read as they stand, so they are only roughly in
+ * step with each other.
+ */
+void PerfCounters_read(int32_t thread, int64_t *values)
+{
+	memset(values, 0, sizeof(int64_t) * PHILPSX_PERF_COUNTER_COUNT);
+
+	pthread_mutex_lock(&PerfCounters_mutex);
+	int32_t index = PerfCounters_threadCount - 1;
+	for (PerfThread *current = PerfCounters_threads; current;
+			current = current->next, --index) {
+		if (thread != PHILPSX_PERF_ALL_THREADS && index != thread)
+			continue;
+		for (int32_t i = 0; i < PHILPSX_PERF_COUNTER_COUNT; ++i)
+			values[i] += __atomic_load_n(&current->values[i],
+					__ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&PerfCounters_mutex);
+}
+
+/*
+ * This function gives the calling thread its own counters, named after the
+ * order it was registered in, and returns them. If the thread already has
+ * counters, they are simply returned. NULL is returned if there isn't
+ * enough memory, in which case nothing is counted.
+ */
+int64_t *PerfCounters_registerThread(void)
+{
+	if (PerfCounters_thread)
+		return PerfCounters_thread->values;
+
+	PerfThread *thread = calloc(1, sizeof(PerfThread));
+	if (!thread) {
+		fprintf(stderr, "PhilPSX: PerfCounters: Couldn't allocate memory "
+				"for thread counters\n");
+		return NULL;
+	}
+
+	pthread_mutex_lock(&PerfCounters_mutex);
+	snprintf(thread->name, sizeof(thread->name), "thread %d",
+			PerfCounters_threadCount);
+	thread->next = PerfCounters_threads;
+	PerfCounters_threads = thread;
+	++PerfCounters_threadCount;
+	pthread_mutex_unlock(&PerfCounters_mutex);
+
+	PerfCounters_thread = thread;
+	PerfCounters_threadValues = thread->values;
+	return thread->values;
+}
+
+/*
+ * This function names the calling thread's counters, registering them if
+ * they don't exist yet. It does nothing if the counters were compiled out.
+ */
+void PerfCounters_setThreadName(const char *name)
+{
+	if (!PerfCounters_isEnabled() || !PerfCounters_registerThread())
+		return;
+
+	pthread_mutex_lock(&PerfCounters_mutex);
+	snprintf(PerfCounters_thread->name, sizeof(PerfCounters_thread->name),
+			"%s", name);
+	pthread_mutex_unlock(&PerfCounters_mutex);
+}
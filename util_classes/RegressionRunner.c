@@ -0,0 +1,614 @@
+/*
+ * This C file provides a regression runner, which boots each BIOS and CD
+ * listed in a manifest in a console of its own through the library API, and
+ * checks the frames it shows against recorded hashes. Consoles are headless
+ * and independent, so as many are run at a time as there are worker
+ * threads.
+ *
+ * Each line of the manifest gives a BIOS image, a cue file (or "-" for
+ * none), the number of frames to run for and any number of FRAME=HASH
+ * checkpoints, separated by whitespace. Frames are counted as they are
+ * shown, from 1, and each hash is an FNV-1a hash of the frame's size and
+ * pixels, in hexadecimal. A line without checkpoints has the hash of its
+ * last frame printed instead, ready for pasting in. Blank lines and lines
+ * starting with # are skipped.
+ *
+ * Runs are shared out with work stealing - sorted by length, they are dealt
+ * out to a deque per worker, and each worker takes its longest run next
+ * while idle workers steal the shortest runs from the others, so that all
+ * of them finish at about the same time.
+ *
+ * RegressionRunner.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../headers/RegressionRunner.h"
+#include "../headers/Console_public.h"
+
+// Cycles run between checks of the frame count, about one frame's worth
+#define PHILPSX_REGRESSION_SLICE_CYCLES 564480
+
+// Longest manifest line read
+#define PHILPSX_REGRESSION_MAX_LINE 4096
+
+// FNV-1a parameters for hashing frames
+#define PHILPSX_REGRESSION_FNV_BASIS 0xCBF29CE484222325UL
+#define PHILPSX_REGRESSION_FNV_PRIME 0x100000001B3UL
+
+/*
+ * This struct holds a frame to check, along with the hash it should have
+ * and the one it had.
+ */
+typedef struct {
+	int64_t frame;
+	bool hasExpected;
+	uint64_t expected;
+	bool shown;
+	uint64_t actual;
+} RegressionCheckpoint;
+
+/*
+ * This struct holds one run from the manifest and its results. The frame
+ * count and checkpoints are updated by the frame sink on the console's
+ * rendering thread, and only read once the console has finished running.
+ */
+typedef struct {
+	int32_t line;
+	char *biosPath;
+	char *cdPath;
+	int64_t frames;
+	RegressionCheckpoint *checkpoints;
+	int32_t checkpointCount;
+	int64_t framesShown;
+	int32_t nextCheckpoint;
+	bool failed;
+	int64_t runTime;
+} RegressionRun;
+
+/*
+ * This struct holds a worker's deque of runs, by index, from the
+ * shortest at the head to the longest at the tail.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	int32_t *runs;
+	int32_t head;
+	int32_t tail;
+} RegressionDeque;
+
+/*
+ * This struct holds everything the workers share.
+ */
+typedef struct {
+	RegressionRun *runs;
+	int32_t runCount;
+	RegressionDeque *deques;
+	int32_t workerCount;
+	pthread_mutex_t printMutex;
+	int32_t passed;
+	int32_t mismatched;
+	int32_t failed;
+	int64_t framesRun;
+} RegressionRunner;
+
+/*
+ * This struct holds a worker thread.
+ */
+typedef struct {
+	RegressionRunner *runner;
+	int32_t index;
+	pthread_t thread;
+	bool started;
+} RegressionWorker;
+
+// Forward declarations for functions private to this class
+static void RegressionRunner_checkFrame(void *userData,
+		const uint32_t *pixels, int32_t width, int32_t height);
+static int RegressionRunner_compareCheckpoints(const void *first,
+		const void *second);
+static void RegressionRunner_freeRuns(RegressionRun *runs, int32_t runCount);
+static int64_t RegressionRunner_getTime(void);
+static bool RegressionRunner_parseLine(char *text, int32_t line,
+		RegressionRun *run);
+static bool RegressionRunner_readManifest(const char *path,
+		RegressionRun **runs, int32_t *runCount);
+static void RegressionRunner_report(RegressionRunner *runner,
+		RegressionRun *run);
+static void RegressionRunner_runOne(RegressionRunner *runner,
+		RegressionRun *run);
+static bool RegressionRunner_takeRun(RegressionRunner *runner,
+		int32_t worker, int32_t *index);
+static void *RegressionRunner_workerFunction(void *arg);
+
+/*
+ * This function runs every line of the manifest at the given path, with
+ * the given number of worker threads, or one per processor core if it is
+ * 0. It prints the result of each run as it finishes, followed by a
+ * summary, and returns true if every run finished and matched its hashes.
+ */
+bool RegressionRunner_run(const char *manifestPath, int32_t jobCount)
+{
+	bool retVal = false;
+	RegressionRunner runner;
+	memset(&runner, 0, sizeof(runner));
+
+	// Read the runs
+	if (!RegressionRunner_readManifest(manifestPath, &runner.runs,
+			&runner.runCount))
+		goto end;
+	if (runner.runCount == 0) {
+		fprintf(stderr, "PhilPSX: RegressionRunner: %s lists no runs\n",
+				manifestPath);
+		goto cleanup_runs;
+	}
+
+	// Use a worker per processor core unless told otherwise, but no more
+	// than there are runs
+	if (jobCount <= 0)
+		jobCount = (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobCount < 1)
+		jobCount = 1;
+	if (jobCount > runner.runCount)
+		jobCount = runner.runCount;
+	runner.workerCount = jobCount;
+
+	// Sort the runs by length, with an insertion sort of their indices as
+	// there are only so many of them
+	int32_t *order = malloc(runner.runCount * sizeof(int32_t));
+	if (!order) {
+		fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't allocate "
+				"memory for run order\n");
+		goto cleanup_runs;
+	}
+	for (int32_t i = 0; i < runner.runCount; ++i) {
+		int32_t j = i;
+		while (j > 0 && runner.runs[order[j - 1]].frames >
+				runner.runs[i].frames) {
+			order[j] = order[j - 1];
+			--j;
+		}
+		order[j] = i;
+	}
+
+	// Deal them out to the workers' deques, so that each deque runs from
+	// shortest to longest
+	runner.deques = calloc(jobCount, sizeof(RegressionDeque));
+	if (!runner.deques) {
+		fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't allocate "
+				"memory for work deques\n");
+		goto cleanup_order;
+	}
+	int32_t dequeSize = (runner.runCount + jobCount - 1) / jobCount;
+	int32_t dequesMade = 0;
+	for (; dequesMade < jobCount; ++dequesMade) {
+		RegressionDeque *deque = &runner.deques[dequesMade];
+		deque->runs = malloc(dequeSize * sizeof(int32_t));
+		if (!deque->runs) {
+			fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't allocate "
+					"memory for work deques\n");
+			goto cleanup_deques;
+		}
+		if (pthread_mutex_init(&deque->mutex, NULL) != 0) {
+			fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't "
+					"initialise deque mutex\n");
+			free(deque->runs);
+			goto cleanup_deques;
+		}
+	}
+	for (int32_t i = 0; i < runner.runCount; ++i) {
+		RegressionDeque *deque = &runner.deques[i % jobCount];
+		deque->runs[deque->tail++] = order[i];
+	}
+	if (pthread_mutex_init(&runner.printMutex, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't initialise "
+				"print mutex\n");
+		goto cleanup_deques;
+	}
+
+	// Start the workers, with this thread acting as the first of them -
+	// any that can't be started have their runs stolen by the others
+	RegressionWorker *workers = calloc(jobCount, sizeof(RegressionWorker));
+	if (!workers) {
+		fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't allocate "
+				"memory for workers\n");
+		goto cleanup_printmutex;
+	}
+	printf("PhilPSX: RegressionRunner: Running %" PRId32 " runs from %s on "
+			"%" PRId32 " threads\n", runner.runCount, manifestPath,
+			jobCount);
+	int64_t startTime = RegressionRunner_getTime();
+	for (int32_t i = 0; i < jobCount; ++i) {
+		workers[i].runner = &runner;
+		workers[i].index = i;
+		if (i > 0) {
+			workers[i].started = pthread_create(&workers[i].thread, NULL,
+					&RegressionRunner_workerFunction, &workers[i]) == 0;
+			if (!workers[i].started)
+				fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't start "
+						"worker thread\n");
+		}
+	}
+	RegressionRunner_workerFunction(&workers[0]);
+	for (int32_t i = 1; i < jobCount; ++i) {
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+	}
+	int64_t totalTime = RegressionRunner_getTime() - startTime;
+
+	// Summarise
+	double seconds = totalTime / 1000000000.0;
+	printf("PhilPSX: RegressionRunner: %" PRId32 " runs, %" PRId32
+			" passed, %" PRId32 " mismatched, %" PRId32 " failed in "
+			"%.1f s (%.0f frames per second in total)\n", runner.runCount,
+			runner.passed, runner.mismatched, runner.failed, seconds,
+			seconds > 0.0 ? runner.framesRun / seconds : 0.0);
+	retVal = runner.mismatched == 0 && runner.failed == 0;
+
+	// Cleanup path:
+	free(workers);
+
+	cleanup_printmutex:
+	pthread_mutex_destroy(&runner.printMutex);
+
+	cleanup_deques:
+	for (int32_t i = 0; i < dequesMade; ++i) {
+		pthread_mutex_destroy(&runner.deques[i].mutex);
+		free(runner.deques[i].runs);
+	}
+	free(runner.deques);
+
+	cleanup_order:
+	free(order);
+
+	cleanup_runs:
+	RegressionRunner_freeRuns(runner.runs, runner.runCount);
+
+	end:
+	return retVal;
+}
+
+/*
+ * This function is the frame sink of each console, counting the frames
+ * it shows and hashing those that are checkpoints.
+ */
+static void RegressionRunner_checkFrame(void *userData,
+		const uint32_t *pixels, int32_t width, int32_t height)
+{
+	RegressionRun *run = userData;
+	++run->framesShown;
+
+	while (run->nextCheckpoint < run->checkpointCount &&
+			run->checkpoints[run->nextCheckpoint].frame ==
+			run->framesShown) {
+		uint64_t hash = PHILPSX_REGRESSION_FNV_BASIS;
+		hash = (hash ^ (uint32_t)width) * PHILPSX_REGRESSION_FNV_PRIME;
+		hash = (hash ^ (uint32_t)height) * PHILPSX_REGRESSION_FNV_PRIME;
+		for (int32_t i = 0; i < width * height; ++i)
+			hash = (hash ^ pixels[i]) * PHILPSX_REGRESSION_FNV_PRIME;
+
+		RegressionCheckpoint *checkpoint =
+				&run->checkpoints[run->nextCheckpoint++];
+		checkpoint->shown = true;
+		checkpoint->actual = hash;
+	}
+}
+
+/*
+ * This function orders checkpoints by ascending frame for qsort.
+ */
+static int RegressionRunner_compareCheckpoints(const void *first,
+		const void *second)
+{
+	const RegressionCheckpoint *firstCheckpoint = first;
+	const RegressionCheckpoint *secondCheckpoint = second;
+	return firstCheckpoint->frame < secondCheckpoint->frame ? -1 :
+			firstCheckpoint->frame > secondCheckpoint->frame;
+}
+
+/*
+ * This function frees the runs read from a manifest.
+ */
+static void RegressionRunner_freeRuns(RegressionRun *runs, int32_t runCount)
+{
+	for (int32_t i = 0; i < runCount; ++i) {
+		free(runs[i].biosPath);
+		free(runs[i].cdPath);
+		free(runs[i].checkpoints);
+	}
+	free(runs);
+}
+
+/*
+ * This function returns the current time in nanoseconds.
+ */
+static int64_t RegressionRunner_getTime(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ * This function parses a manifest line into a run, which is cleared first.
+ * It returns false if the line is malformed, after saying why.
+ */
+static bool RegressionRunner_parseLine(char *text, int32_t line,
+		RegressionRun *run)
+{
+	memset(run, 0, sizeof(RegressionRun));
+	run->line = line;
+
+	// Read the BIOS, CD and frame count
+	char *save;
+	char *bios = strtok_r(text, " \t\r\n", &save);
+	char *cd = strtok_r(NULL, " \t\r\n", &save);
+	char *frames = strtok_r(NULL, " \t\r\n", &save);
+	char *end = NULL;
+	if (frames)
+		run->frames = strtoll(frames, &end, 10);
+	if (!bios || !cd || !frames || *end != '\0' || run->frames < 1) {
+		fprintf(stderr, "PhilPSX: RegressionRunner: Line %" PRId32 " needs "
+				"a BIOS, a CD (or -) and a number of frames\n", line);
+		return false;
+	}
+	run->biosPath = strdup(bios);
+	if (strcmp(cd, "-") != 0)
+		run->cdPath = strdup(cd);
+	if (!run->biosPath || (strcmp(cd, "-") != 0 && !run->cdPath))
+		goto nomemory;
+
+	// Read the checkpoints, adding one for the last frame if there aren't
+	// any so that its hash gets printed
+	char *token;
+	int32_t capacity = 0;
+	while ((token = strtok_r(NULL, " \t\r\n", &save)) ||
+			run->checkpointCount == 0) {
+		if (run->checkpointCount == capacity) {
+			capacity = capacity ? capacity * 2 : 4;
+			RegressionCheckpoint *checkpoints = realloc(run->checkpoints,
+					capacity * sizeof(RegressionCheckpoint));
+			if (!checkpoints)
+				goto nomemory;
+			run->checkpoints = checkpoints;
+		}
+		RegressionCheckpoint *checkpoint =
+				&run->checkpoints[run->checkpointCount];
+		memset(checkpoint, 0, sizeof(RegressionCheckpoint));
+		if (!token) {
+			checkpoint->frame = run->frames;
+			++run->checkpointCount;
+			break;
+		}
+
+		char *hash = strchr(token, '=');
+		checkpoint->frame = strtoll(token, &end, 10);
+		if (hash && end == hash && hash[1] != '\0')
+			checkpoint->expected = strtoull(hash + 1, &end, 16);
+		if (!hash || *end != '\0' || checkpoint->frame < 1 ||
+				checkpoint->frame > run->frames) {
+			fprintf(stderr, "PhilPSX: RegressionRunner: Line %" PRId32
+					" has a bad checkpoint %s, which should be FRAME=HASH "
+					"within the frames run\n", line, token);
+			return false;
+		}
+		checkpoint->hasExpected = true;
+		++run->checkpointCount;
+	}
+	qsort(run->checkpoints, run->checkpointCount,
+			sizeof(RegressionCheckpoint),
+			&RegressionRunner_compareCheckpoints);
+	return true;
+
+	nomemory:
+	fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't allocate memory "
+			"for line %" PRId32 "\n", line);
+	return false;
+}
+
+/*
+ * This function reads every run from the manifest at the given path. It
+ * returns false if the file couldn't be read or any line is malformed, in
+ * which case nothing is kept.
+ */
+static bool RegressionRunner_readManifest(const char *path,
+		RegressionRun **runs, int32_t *runCount)
+{
+	*runs = NULL;
+	*runCount = 0;
+	int32_t capacity = 0;
+
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't open manifest "
+				"%s\n", path);
+		return false;
+	}
+
+	char text[PHILPSX_REGRESSION_MAX_LINE];
+	int32_t line = 0;
+	while (fgets(text, sizeof(text), file)) {
+		++line;
+		char *start = text + strspn(text, " \t\r\n");
+		if (*start == '\0' || *start == '#')
+			continue;
+
+		if (*runCount == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			RegressionRun *newRuns = realloc(*runs,
+					capacity * sizeof(RegressionRun));
+			if (!newRuns) {
+				fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't "
+						"allocate memory for runs\n");
+				goto cleanup_runs;
+			}
+			*runs = newRuns;
+		}
+		RegressionRun *run = &(*runs)[*runCount];
+		bool parsed = RegressionRunner_parseLine(start, line, run);
+		++*runCount;
+		if (!parsed)
+			goto cleanup_runs;
+	}
+	if (ferror(file)) {
+		fprintf(stderr, "PhilPSX: RegressionRunner: Couldn't read manifest "
+				"%s\n", path);
+		goto cleanup_runs;
+	}
+
+	// Normal return:
+	fclose(file);
+	return true;
+
+	// Cleanup path:
+	cleanup_runs:
+	RegressionRunner_freeRuns(*runs, *runCount);
+	*runs = NULL;
+	*runCount = 0;
+	fclose(file);
+	return false;
+}
+
+/*
+ * This function prints the result of a run and adds it to the totals.
+ */
+static void RegressionRunner_report(RegressionRunner *runner,
+		RegressionRun *run)
+{
+	// Work out how it went
+	bool mismatched = false;
+	bool recorded = false;
+	for (int32_t i = 0; i < run->checkpointCount; ++i) {
+		RegressionCheckpoint *checkpoint = &run->checkpoints[i];
+		if (!checkpoint->hasExpected)
+			recorded = true;
+		else if (!checkpoint->shown ||
+				checkpoint->actual != checkpoint->expected)
+			mismatched = true;
+	}
+	const char *status = run->failed ? "FAILED" : mismatched ? "MISMATCH" :
+			recorded ? "recorded" : "ok";
+
+	// Print it, along with each checkpoint that didn't match or has just
+	// been hashed
+	const char *title = run->cdPath ? run->cdPath : run->biosPath;
+	const char *slash = strrchr(title, '/');
+	if (slash)
+		title = slash + 1;
+	double seconds = run->runTime / 1000000000.0;
+	pthread_mutex_lock(&runner->printMutex);
+	printf("PhilPSX: RegressionRunner: Line %" PRId32 " %s: %s, %" PRId64
+			" frames in %.2f s (%.1f fps)\n", run->line, title, status,
+			run->framesShown, seconds,
+			seconds > 0.0 ? run->framesShown / seconds : 0.0);
+	for (int32_t i = 0; i < run->checkpointCount && !run->failed; ++i) {
+		RegressionCheckpoint *checkpoint = &run->checkpoints[i];
+		if (!checkpoint->shown)
+			printf("PhilPSX: RegressionRunner:     frame %" PRId64 " was "
+					"never shown\n", checkpoint->frame);
+		else if (!checkpoint->hasExpected)
+			printf("PhilPSX: RegressionRunner:     %" PRId64 "=%016" PRIX64
+					"\n", checkpoint->frame, checkpoint->actual);
+		else if (checkpoint->actual != checkpoint->expected)
+			printf("PhilPSX: RegressionRunner:     frame %" PRId64 " "
+					"expected %016" PRIX64 ", got %016" PRIX64 "\n",
+					checkpoint->frame, checkpoint->expected,
+					checkpoint->actual);
+	}
+	if (run->failed)
+		++runner->failed;
+	else if (mismatched)
+		++runner->mismatched;
+	else
+		++runner->passed;
+	runner->framesRun += run->framesShown;
+	pthread_mutex_unlock(&runner->printMutex);
+}
+
+/*
+ * This function boots a run in a console of its own and runs it for its
+ * frames, hashing its checkpoints on the way, then reports on it.
+ */
+static void RegressionRunner_runOne(RegressionRunner *runner,
+		RegressionRun *run)
+{
+	// Setup console
+	Console *console = construct_Console(run->biosPath);
+	if (!console) {
+		run->failed = true;
+		goto end;
+	}
+	if (run->cdPath && !Console_loadCD(console, run->cdPath)) {
+		run->failed = true;
+		goto cleanup_console;
+	}
+	Console_setFrameSink(console, &RegressionRunner_checkFrame, run);
+
+	// Run it, timing only the emulation itself - each slice ends with
+	// everything drawn so far shown, so the frame sink is up to date
+	int64_t startTime = RegressionRunner_getTime();
+	while (Console_getFrameCount(console) < run->frames)
+		Console_runCycles(console, PHILPSX_REGRESSION_SLICE_CYCLES);
+	run->runTime = RegressionRunner_getTime() - startTime;
+
+	// Cleanup path:
+	cleanup_console:
+	destruct_Console(console);
+
+	end:
+	RegressionRunner_report(runner, run);
+}
+
+/*
+ * This function takes the next run for a worker - its own longest, or
+ * failing that the shortest run of another worker. It returns false once
+ * there are none left anywhere, as no runs are ever added.
+ */
+static bool RegressionRunner_takeRun(RegressionRunner *runner,
+		int32_t worker, int32_t *index)
+{
+	// Take from the tail of our own deque
+	RegressionDeque *deque = &runner->deques[worker];
+	pthread_mutex_lock(&deque->mutex);
+	bool found = deque->tail > deque->head;
+	if (found)
+		*index = deque->runs[--deque->tail];
+	pthread_mutex_unlock(&deque->mutex);
+	if (found)
+		return true;
+
+	// Steal from the head of the others, starting with the next one along
+	for (int32_t i = 1; i < runner->workerCount; ++i) {
+		deque = &runner->deques[(worker + i) % runner->workerCount];
+		pthread_mutex_lock(&deque->mutex);
+		found = deque->tail > deque->head;
+		if (found)
+			*index = deque->runs[deque->head++];
+		pthread_mutex_unlock(&deque->mutex);
+		if (found)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * This function is run by each worker, taking runs until none are left.
+ */
+static void *RegressionRunner_workerFunction(void *arg)
+{
+	RegressionWorker *worker = arg;
+	RegressionRunner *runner = worker->runner;
+
+	int32_t index;
+	while (RegressionRunner_takeRun(runner, worker->index, &index))
+		RegressionRunner_runOne(runner, &runner->runs[index]);
+
+	return NULL;
+}
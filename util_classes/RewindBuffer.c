@@ -0,0 +1,570 @@
+/*
+ * This C file models a rewind buffer as a class. The newest save state is
+ * kept in full, and each older one is kept as the XOR of it with the one
+ * after it, so stepping back is a matter of XORing the newest delta into the
+ * current state. Deltas of save states taken a few frames apart are almost
+ * all zero, so they are stored as runs of zero blocks and runs of literal
+ * blocks (with the XOR and the test for zero done with SSE2 or AVX2 where
+ * they are available), in a ring that drops the oldest deltas to make room.
+ *
+ * Each state handed over is copied, and the copy is encoded by a worker
+ * thread while emulation carries on, so the emulator thread only pays for
+ * the copy. A state arriving while the worker is still busy is refused, and
+ * nothing else touches the ring or the current state until it is done.
+ *
+ * It is assumed due to use case that non-init pthread functions will not fail,
+ * and therefore errors are not checked with these function calls, to simplify
+ * the code and make it more readable.
+ *
+ * RewindBuffer.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "../headers/RewindBuffer.h"
+#include "../headers/endian_utils.h"
+#include "../headers/math_utils.h"
+
+// Largest save state that can be held
+#define PHILPSX_REWIND_STATE_CAPACITY 0x800000
+
+// Size of the blocks deltas are made of, and the most blocks a run can hold
+#define PHILPSX_REWIND_BLOCK_SIZE 32
+#define PHILPSX_REWIND_MAX_RUN 0xFFFF
+
+// Most deltas the ring can hold, whatever its size
+#define PHILPSX_REWIND_MAX_ENTRIES 16384
+
+// Forward declarations for functions and subcomponents private to this class
+// Delta stuff:
+static void RewindBuffer_applyDelta(int8_t *state, const int8_t *delta,
+		int32_t length);
+static inline void RewindBuffer_applyBlock(int8_t *state,
+		const int8_t *block);
+static int32_t RewindBuffer_encodeDelta(const int8_t *newer,
+		const int8_t *older, int32_t size, int8_t *delta);
+static inline bool RewindBuffer_xorBlock(const int8_t *newer,
+		const int8_t *older, int8_t *block);
+// Ring stuff:
+static void RewindBuffer_storeDelta(RewindBuffer *rb, int32_t length,
+		int32_t olderSize);
+// Worker stuff:
+static void *RewindBuffer_workerFunction(void *arg);
+
+/*
+ * This struct describes one delta in the ring - where its encoded bytes are
+ * and how big the save state it steps back to is.
+ */
+typedef struct {
+	int64_t offset;
+	int32_t length;
+	int32_t olderSize;
+} RewindEntry;
+
+/*
+ * This struct stores the ring of deltas, the states either side of the
+ * newest one and the worker's state.
+ */
+struct RewindBuffer {
+
+	// Ring of encoded deltas, and where the next one goes
+	int8_t *data;
+	int64_t dataCapacity;
+	int64_t dataHead;
+
+	// Deltas in the ring, oldest first
+	RewindEntry entries[PHILPSX_REWIND_MAX_ENTRIES];
+	int32_t firstEntry;
+	int32_t entryCount;
+
+	// Newest state, and the copy handed over to the worker - bytes past the
+	// size of each are always zero, so states of different sizes can be
+	// compared block by block
+	int8_t *current;
+	int32_t currentSize;
+	bool haveCurrent;
+	int8_t *pending;
+	int32_t pendingSize;
+
+	// Where the worker encodes a delta before it goes in the ring
+	int8_t *scratch;
+
+	// This tells us whether the console was last put back to the current
+	// state, in which case stepping back moves on to the one before it
+	bool atCurrent;
+
+	// Worker thread, and whether it has a state to encode
+	pthread_t workerThread;
+	pthread_mutex_t workerMutex;
+	pthread_cond_t workCondition;
+	pthread_cond_t idleCondition;
+	bool workerBusy;
+	bool workerQuit;
+};
+
+/*
+ * This constructs a RewindBuffer object, whose ring of deltas takes up the
+ * specified number of bytes.
+ */
+RewindBuffer *construct_RewindBuffer(int64_t budget)
+{
+	// Allocate memory for struct
+	RewindBuffer *rb = calloc(1, sizeof(RewindBuffer));
+	if (!rb) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't allocate memory for "
+				"RewindBuffer struct\n");
+		goto end;
+	}
+
+	// Allocate ring and states - the states must start out zeroed
+	rb->data = malloc(budget);
+	if (!rb->data) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't allocate memory for "
+				"ring\n");
+		goto cleanup_rewindbuffer;
+	}
+	rb->dataCapacity = budget;
+	rb->current = calloc(1, PHILPSX_REWIND_STATE_CAPACITY);
+	if (!rb->current) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't allocate memory for "
+				"current state\n");
+		goto cleanup_data;
+	}
+	rb->pending = calloc(1, PHILPSX_REWIND_STATE_CAPACITY);
+	if (!rb->pending) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't allocate memory for "
+				"pending state\n");
+		goto cleanup_current;
+	}
+
+	// A delta is four bytes for each pair of runs on top of its literal
+	// blocks, of which there is at most one pair for every two blocks
+	rb->scratch = malloc(PHILPSX_REWIND_STATE_CAPACITY +
+			PHILPSX_REWIND_STATE_CAPACITY / PHILPSX_REWIND_BLOCK_SIZE * 2 +
+			4);
+	if (!rb->scratch) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't allocate memory for "
+				"scratch buffer\n");
+		goto cleanup_pending;
+	}
+
+	// Setup and start worker
+	if (pthread_mutex_init(&rb->workerMutex, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't create worker "
+				"mutex\n");
+		goto cleanup_scratch;
+	}
+	if (pthread_cond_init(&rb->workCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't create worker work "
+				"condition variable\n");
+		goto cleanup_mutex;
+	}
+	if (pthread_cond_init(&rb->idleCondition, NULL) != 0) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't create worker idle "
+				"condition variable\n");
+		goto cleanup_workcondition;
+	}
+	if (pthread_create(&rb->workerThread, NULL, &RewindBuffer_workerFunction,
+			rb) != 0) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Couldn't start worker "
+				"thread\n");
+		goto cleanup_idlecondition;
+	}
+
+	// Normal return:
+	return rb;
+
+	// Cleanup path:
+	cleanup_idlecondition:
+	pthread_cond_destroy(&rb->idleCondition);
+
+	cleanup_workcondition:
+	pthread_cond_destroy(&rb->workCondition);
+
+	cleanup_mutex:
+	pthread_mutex_destroy(&rb->workerMutex);
+
+	cleanup_scratch:
+	free(rb->scratch);
+
+	cleanup_pending:
+	free(rb->pending);
+
+	cleanup_current:
+	free(rb->current);
+
+	cleanup_data:
+	free(rb->data);
+
+	cleanup_rewindbuffer:
+	free(rb);
+	rb = NULL;
+
+	end:
+	return rb;
+}
+
+/*
+ * This destructs a RewindBuffer object, once the worker has finished.
+ */
+void destruct_RewindBuffer(RewindBuffer *rb)
+{
+	pthread_mutex_lock(&rb->workerMutex);
+	rb->workerQuit = true;
+	pthread_cond_signal(&rb->workCondition);
+	pthread_mutex_unlock(&rb->workerMutex);
+	pthread_join(rb->workerThread, NULL);
+	pthread_cond_destroy(&rb->idleCondition);
+	pthread_cond_destroy(&rb->workCondition);
+	pthread_mutex_destroy(&rb->workerMutex);
+
+	free(rb->scratch);
+	free(rb->pending);
+	free(rb->current);
+	free(rb->data);
+	free(rb);
+}
+
+/*
+ * This function tells us how many save states can be stepped back to, and
+ * how many bytes of the ring their deltas take up.
+ */
+void RewindBuffer_getStats(RewindBuffer *rb, int32_t *snapshots,
+		int64_t *bytes)
+{
+	pthread_mutex_lock(&rb->workerMutex);
+	int64_t total = 0;
+	for (int32_t i = 0; i < rb->entryCount; ++i)
+		total += rb->entries[(rb->firstEntry + i) %
+				PHILPSX_REWIND_MAX_ENTRIES].length;
+	*snapshots = rb->entryCount + (rb->haveCurrent ? 1 : 0);
+	*bytes = total;
+	pthread_mutex_unlock(&rb->workerMutex);
+}
+
+/*
+ * This function tells us whether the worker is ready for another state, so
+ * that the caller can avoid taking one that would be refused.
+ */
+bool RewindBuffer_isIdle(RewindBuffer *rb)
+{
+	pthread_mutex_lock(&rb->workerMutex);
+	bool idle = !rb->workerBusy;
+	pthread_mutex_unlock(&rb->workerMutex);
+	return idle;
+}
+
+/*
+ * This function copies a save state and hands the copy to the worker, which
+ * makes it the newest state and stores a delta to step back to the one
+ * before it. It returns false, leaving the buffer as it was, if the worker
+ * is still busy or the state is too big. It is intended to be called from
+ * the emulator thread.
+ */
+bool RewindBuffer_push(RewindBuffer *rb, SaveState *state)
+{
+	if (!RewindBuffer_isIdle(rb))
+		return false;
+	int32_t size = SaveState_getSize(state);
+	if (size > PHILPSX_REWIND_STATE_CAPACITY) {
+		fprintf(stderr, "PhilPSX: RewindBuffer: Save state is too big to "
+				"hold\n");
+		return false;
+	}
+
+	// Copy state, zeroing whatever is left of the last one held here - the
+	// worker isn't touching this while it is idle
+	memcpy(rb->pending, SaveState_getData(state), size);
+	if (rb->pendingSize > size)
+		memset(rb->pending + size, 0, rb->pendingSize - size);
+	rb->pendingSize = size;
+	rb->atCurrent = false;
+
+	// Hand over to worker
+	pthread_mutex_lock(&rb->workerMutex);
+	rb->workerBusy = true;
+	pthread_cond_signal(&rb->workCondition);
+	pthread_mutex_unlock(&rb->workerMutex);
+	return true;
+}
+
+/*
+ * This function fills a save state with the state to step back to, waiting
+ * for the worker to finish first. The first step goes back to the newest
+ * state, and each one after moves on to the one before, dropping the delta
+ * it used. Once the oldest has been reached, it keeps returning that. It
+ * returns false if there is nothing to step back to, and is intended to be
+ * called from the emulator thread.
+ */
+bool RewindBuffer_stepBack(RewindBuffer *rb, SaveState *state)
+{
+	// Wait for worker, which leaves us the ring and current state
+	pthread_mutex_lock(&rb->workerMutex);
+	while (rb->workerBusy)
+		pthread_cond_wait(&rb->idleCondition, &rb->workerMutex);
+	if (!rb->haveCurrent) {
+		pthread_mutex_unlock(&rb->workerMutex);
+		return false;
+	}
+
+	// Turn current state into the one before it, if we are already there
+	// and there is one, making room in the ring for the next delta
+	if (rb->atCurrent && rb->entryCount > 0) {
+		RewindEntry *entry = &rb->entries[(rb->firstEntry +
+				rb->entryCount - 1) % PHILPSX_REWIND_MAX_ENTRIES];
+		RewindBuffer_applyDelta(rb->current, rb->data + entry->offset,
+				entry->length);
+		rb->currentSize = entry->olderSize;
+		rb->dataHead = entry->offset;
+		--rb->entryCount;
+	}
+	rb->atCurrent = true;
+	pthread_mutex_unlock(&rb->workerMutex);
+
+	// Hand current state over
+	SaveState_clear(state);
+	SaveState_write(state, rb->current, rb->currentSize);
+	return true;
+}
+
+/*
+ * This function XORs an encoded delta into a state, turning the state the
+ * delta was made against into the one it was made from, or the other way
+ * round.
+ */
+static void RewindBuffer_applyDelta(int8_t *state, const int8_t *delta,
+		int32_t length)
+{
+	const int8_t *end = delta + length;
+	while (delta < end) {
+		int32_t zeroBlocks = read_le_halfword(delta);
+		int32_t literalBlocks = read_le_halfword(delta + 2);
+		delta += 4;
+		state += zeroBlocks * PHILPSX_REWIND_BLOCK_SIZE;
+		for (int32_t i = 0; i < literalBlocks; ++i) {
+			RewindBuffer_applyBlock(state, delta);
+			state += PHILPSX_REWIND_BLOCK_SIZE;
+			delta += PHILPSX_REWIND_BLOCK_SIZE;
+		}
+	}
+}
+
+/*
+ * This function XORs one block of a delta into a state.
+ */
+static inline void RewindBuffer_applyBlock(int8_t *state,
+		const int8_t *block)
+{
+#if defined(__AVX2__)
+	__m256i value = _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *)state),
+			_mm256_loadu_si256((const __m256i *)block));
+	_mm256_storeu_si256((__m256i *)state, value);
+#elif defined(__SSE2__)
+	for (int32_t i = 0; i < PHILPSX_REWIND_BLOCK_SIZE; i += 16) {
+		__m128i value = _mm_xor_si128(
+				_mm_loadu_si128((const __m128i *)&state[i]),
+				_mm_loadu_si128((const __m128i *)&block[i]));
+		_mm_storeu_si128((__m128i *)&state[i], value);
+	}
+#else
+	for (int32_t i = 0; i < PHILPSX_REWIND_BLOCK_SIZE; i += 8) {
+		uint64_t value, delta;
+		memcpy(&value, &state[i], sizeof(value));
+		memcpy(&delta, &block[i], sizeof(delta));
+		value ^= delta;
+		memcpy(&state[i], &value, sizeof(value));
+	}
+#endif
+}
+
+/*
+ * This function encodes the XOR of two states of up to size bytes into
+ * delta, returning how many bytes it took. Each pair of runs is a count of
+ * zero blocks and a count of literal blocks (as little-endian halfwords),
+ * followed by the literal blocks.
+ */
+static int32_t RewindBuffer_encodeDelta(const int8_t *newer,
+		const int8_t *older, int32_t size, int8_t *delta)
+{
+	int32_t blockCount = (size + PHILPSX_REWIND_BLOCK_SIZE - 1) /
+			PHILPSX_REWIND_BLOCK_SIZE;
+	int8_t *out = delta;
+	int32_t block = 0;
+	while (block < blockCount) {
+
+		// Count zero blocks - a literal one ends the run already written
+		// to where it belongs
+		int8_t *counts = out;
+		out += 4;
+		int32_t zeroBlocks = 0;
+		while (block < blockCount && zeroBlocks < PHILPSX_REWIND_MAX_RUN &&
+				!RewindBuffer_xorBlock(
+				newer + block * PHILPSX_REWIND_BLOCK_SIZE,
+				older + block * PHILPSX_REWIND_BLOCK_SIZE, out)) {
+			++zeroBlocks;
+			++block;
+		}
+
+		// Gather literal blocks, until a zero one turns up
+		int32_t literalBlocks = 0;
+		if (block < blockCount && zeroBlocks < PHILPSX_REWIND_MAX_RUN) {
+			do {
+				out += PHILPSX_REWIND_BLOCK_SIZE;
+				++literalBlocks;
+				++block;
+			} while (block < blockCount &&
+					literalBlocks < PHILPSX_REWIND_MAX_RUN &&
+					RewindBuffer_xorBlock(
+					newer + block * PHILPSX_REWIND_BLOCK_SIZE,
+					older + block * PHILPSX_REWIND_BLOCK_SIZE, out));
+		}
+		write_le_halfword(counts, zeroBlocks);
+		write_le_halfword(counts + 2, literalBlocks);
+	}
+	return (int32_t)(out - delta);
+}
+
+/*
+ * This function writes the XOR of one block of two states to block,
+ * returning whether it holds anything other than zero.
+ */
+static inline bool RewindBuffer_xorBlock(const int8_t *newer,
+		const int8_t *older, int8_t *block)
+{
+#if defined(__AVX2__)
+	__m256i value = _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *)newer),
+			_mm256_loadu_si256((const __m256i *)older));
+	_mm256_storeu_si256((__m256i *)block, value);
+	return !_mm256_testz_si256(value, value);
+#elif defined(__SSE2__)
+	__m128i low = _mm_xor_si128(_mm_loadu_si128((const __m128i *)newer),
+			_mm_loadu_si128((const __m128i *)older));
+	__m128i high = _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *)&newer[16]),
+			_mm_loadu_si128((const __m128i *)&older[16]));
+	_mm_storeu_si128((__m128i *)block, low);
+	_mm_storeu_si128((__m128i *)&block[16], high);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(low, high),
+			_mm_setzero_si128())) != 0xFFFF;
+#else
+	uint64_t any = 0;
+	for (int32_t i = 0; i < PHILPSX_REWIND_BLOCK_SIZE; i += 8) {
+		uint64_t first, second;
+		memcpy(&first, &newer[i], sizeof(first));
+		memcpy(&second, &older[i], sizeof(second));
+		first ^= second;
+		memcpy(&block[i], &first, sizeof(first));
+		any |= first;
+	}
+	return any != 0;
+#endif
+}
+
+/*
+ * This function moves the delta in the scratch buffer into the ring, after
+ * dropping as many of the oldest deltas as it takes to make room. Deltas are
+ * kept whole, so one that won't fit before the end of the ring goes at the
+ * start. It must be called with the worker mutex held.
+ */
+static void RewindBuffer_storeDelta(RewindBuffer *rb, int32_t length,
+		int32_t olderSize)
+{
+	// A delta that can't fit at all breaks the chain back from the newest
+	// state, so everything before it has to go
+	if (length > rb->dataCapacity) {
+		rb->entryCount = 0;
+		return;
+	}
+
+	// Find room, dropping deltas until there is some
+	int64_t offset = -1;
+	while (offset == -1) {
+		if (rb->entryCount == 0) {
+			offset = 0;
+			break;
+		}
+		int64_t oldest = rb->entries[rb->firstEntry].offset;
+		if (rb->entryCount < PHILPSX_REWIND_MAX_ENTRIES) {
+			if (rb->dataHead > oldest) {
+				if (length <= rb->dataCapacity - rb->dataHead)
+					offset = rb->dataHead;
+				else if (length <= oldest)
+					offset = 0;
+			} else if (length <= oldest - rb->dataHead) {
+				offset = rb->dataHead;
+			}
+		}
+		if (offset == -1) {
+			rb->firstEntry = (rb->firstEntry + 1) %
+					PHILPSX_REWIND_MAX_ENTRIES;
+			--rb->entryCount;
+		}
+	}
+
+	// Copy delta in and record it
+	memcpy(rb->data + offset, rb->scratch, length);
+	RewindEntry *entry = &rb->entries[(rb->firstEntry + rb->entryCount) %
+			PHILPSX_REWIND_MAX_ENTRIES];
+	entry->offset = offset;
+	entry->length = length;
+	entry->olderSize = olderSize;
+	++rb->entryCount;
+	rb->dataHead = offset + length;
+}
+
+/*
+ * This function is the body of the worker thread. For each state handed
+ * over, it encodes a delta from it back to the current one, then makes it
+ * the current one.
+ */
+static void *RewindBuffer_workerFunction(void *arg)
+{
+	RewindBuffer *rb = arg;
+
+	for (;;) {
+
+		// Wait for the next state, or for the signal to quit
+		pthread_mutex_lock(&rb->workerMutex);
+		while (!rb->workerQuit && !rb->workerBusy)
+			pthread_cond_wait(&rb->workCondition, &rb->workerMutex);
+		if (rb->workerQuit) {
+			pthread_mutex_unlock(&rb->workerMutex);
+			break;
+		}
+		pthread_mutex_unlock(&rb->workerMutex);
+
+		// Encode delta, unless this is the first state
+		int32_t length = 0;
+		if (rb->haveCurrent)
+			length = RewindBuffer_encodeDelta(rb->pending, rb->current,
+					max_value(rb->pendingSize, rb->currentSize),
+					rb->scratch);
+
+		// Store delta, and swap states so the pending one becomes current
+		pthread_mutex_lock(&rb->workerMutex);
+		if (rb->haveCurrent)
+			RewindBuffer_storeDelta(rb, length, rb->currentSize);
+		int8_t *newer = rb->pending;
+		int32_t newerSize = rb->pendingSize;
+		rb->pending = rb->current;
+		rb->pendingSize = rb->currentSize;
+		rb->current = newer;
+		rb->currentSize = newerSize;
+		rb->haveCurrent = true;
+		rb->workerBusy = false;
+		pthread_cond_broadcast(&rb->idleCondition);
+		pthread_mutex_unlock(&rb->workerMutex);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,338 @@
+/*
+ * This C file models a save state as a class. Each component writes its
+ * state into one growable buffer in a fixed order, and reads it back in the
+ * same order, so a whole region such as RAM or vram costs one copy. Reads
+ * and writes don't return errors - instead, the first failure is remembered
+ * and can be checked once the whole state has been handled.
+ *
+ * When saved to a file, the buffer follows a small little-endian header
+ * holding the format version and its size, and is written or read with one
+ * call. The buffer itself holds values in the host's byte order, so the
+ * header also records that, and files are only loaded by hosts sharing it.
+ *
+ * SaveState.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/SaveState.h"
+#include "../headers/endian_utils.h"
+
+// File layout details - the byte order word is stored as the host holds it,
+// rather than little-endian like the rest of the header
+#define PHILPSX_SAVESTATE_MAGIC 0x53535350
+#define PHILPSX_SAVESTATE_VERSION 5
+#define PHILPSX_SAVESTATE_BYTE_ORDER 0x01020304
+#define PHILPSX_SAVESTATE_HEADER_SIZE 16
+
+// Initial capacity of the buffer, which fits a whole console without
+// needing to grow
+#define PHILPSX_SAVESTATE_INITIAL_CAPACITY 0x400000
+
+// Forward declarations for functions and subcomponents private to this class
+// Buffer stuff:
+static bool SaveState_ensureCapacity(SaveState *state, int64_t size);
+
+/*
+ * This struct stores the buffer, along with how much of it holds state and
+ * how far through it a reader is.
+ */
+struct SaveState {
+
+	// Buffer, its capacity and how many bytes of it are in use
+	int8_t *buffer;
+	int32_t capacity;
+	int32_t size;
+
+	// Read position, and whether anything has gone wrong since the state
+	// was last cleared or rewound
+	int32_t position;
+	bool failed;
+};
+
+/*
+ * This constructs a SaveState object, which starts out empty.
+ */
+SaveState *construct_SaveState(void)
+{
+	// Allocate memory for struct
+	SaveState *state = calloc(1, sizeof(SaveState));
+	if (!state) {
+		fprintf(stderr, "PhilPSX: SaveState: Couldn't allocate memory for "
+				"SaveState struct\n");
+		goto end;
+	}
+
+	// Allocate buffer
+	state->buffer = malloc(PHILPSX_SAVESTATE_INITIAL_CAPACITY);
+	if (!state->buffer) {
+		fprintf(stderr, "PhilPSX: SaveState: Couldn't allocate memory for "
+				"buffer\n");
+		goto cleanup_state;
+	}
+	state->capacity = PHILPSX_SAVESTATE_INITIAL_CAPACITY;
+
+	// Normal return:
+	return state;
+
+	// Cleanup path:
+	cleanup_state:
+	free(state);
+	state = NULL;
+
+	end:
+	return state;
+}
+
+/*
+ * This destructs a SaveState object.
+ */
+void destruct_SaveState(SaveState *state)
+{
+	free(state->buffer);
+	free(state);
+}
+
+/*
+ * This function empties the state, ready for a new one to be written.
+ */
+void SaveState_clear(SaveState *state)
+{
+	state->size = 0;
+	state->position = 0;
+	state->failed = false;
+}
+
+/*
+ * This function records that the state is unusable, for components to call
+ * when they read values they can't accept.
+ */
+void SaveState_fail(SaveState *state)
+{
+	state->failed = true;
+}
+
+/*
+ * This function returns a pointer to the bytes of state held, for copying
+ * the whole of it elsewhere. The pointer is only valid until the next write.
+ */
+const int8_t *SaveState_getData(SaveState *state)
+{
+	return state->buffer;
+}
+
+/*
+ * This function returns the number of bytes of state held.
+ */
+int32_t SaveState_getSize(SaveState *state)
+{
+	return state->size;
+}
+
+/*
+ * This function tells us whether a read or write has failed since the state
+ * was last cleared or rewound.
+ */
+bool SaveState_hasFailed(SaveState *state)
+{
+	return state->failed;
+}
+
+/*
+ * This function tells us whether everything has been read back without
+ * failing, which confirms that the state was the size its readers expected.
+ */
+bool SaveState_isFinished(SaveState *state)
+{
+	return !state->failed && state->position == state->size;
+}
+
+/*
+ * This function replaces the state with the one stored in a file, checking
+ * the header and reading the rest with one call. The state is left empty if
+ * the file isn't a valid save state for this host.
+ */
+bool SaveState_loadFile(SaveState *state, const char *path)
+{
+	bool retVal = false;
+	SaveState_clear(state);
+
+	// Open file
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "PhilPSX: SaveState: Couldn't open %s\n", path);
+		goto end;
+	}
+
+	// Check header
+	int8_t header[PHILPSX_SAVESTATE_HEADER_SIZE];
+	uint32_t byteOrder = 0;
+	if (fread(header, sizeof(header), 1, file) != 1 ||
+			read_le_word(header) != PHILPSX_SAVESTATE_MAGIC) {
+		fprintf(stderr, "PhilPSX: SaveState: %s isn't a save state\n", path);
+		goto cleanup_file;
+	}
+	memcpy(&byteOrder, header + 8, sizeof(byteOrder));
+	if (read_le_word(header + 4) != PHILPSX_SAVESTATE_VERSION ||
+			byteOrder != PHILPSX_SAVESTATE_BYTE_ORDER) {
+		fprintf(stderr, "PhilPSX: SaveState: %s was saved by a different "
+				"version or kind of host\n", path);
+		goto cleanup_file;
+	}
+
+	// Read buffer
+	int32_t size = read_le_word(header + 12);
+	if (size < 0 || !SaveState_ensureCapacity(state, size) ||
+			fread(state->buffer, 1, size, file) != (size_t)size) {
+		fprintf(stderr, "PhilPSX: SaveState: %s is truncated\n", path);
+		goto cleanup_file;
+	}
+	state->size = size;
+	retVal = true;
+
+	// Cleanup path:
+	cleanup_file:
+	fclose(file);
+
+	end:
+	return retVal;
+}
+
+/*
+ * This function copies the next length bytes of the state into data,
+ * leaving it untouched and recording a failure if there aren't enough.
+ */
+void SaveState_read(SaveState *state, void *data, int32_t length)
+{
+	const int8_t *region = SaveState_readRegion(state, length);
+	if (region)
+		memcpy(data, region, length);
+}
+
+/*
+ * This function returns a pointer to the next length bytes of the state, so
+ * that large regions can be compared or converted in place, and moves past
+ * them. It returns NULL, recording a failure, if there aren't enough.
+ */
+const int8_t *SaveState_readRegion(SaveState *state, int32_t length)
+{
+	if (state->failed || length < 0 || length > state->size - state->position) {
+		state->failed = true;
+		return NULL;
+	}
+
+	const int8_t *region = state->buffer + state->position;
+	state->position += length;
+	return region;
+}
+
+/*
+ * This function adds length bytes to the end of the state, returning a
+ * pointer for the caller to fill them in through. The pointer is only valid
+ * until the next write. It returns NULL, recording a failure, if the buffer
+ * couldn't grow.
+ */
+int8_t *SaveState_reserve(SaveState *state, int32_t length)
+{
+	if (state->failed || length < 0 ||
+			!SaveState_ensureCapacity(state, (int64_t)state->size + length)) {
+		state->failed = true;
+		return NULL;
+	}
+
+	int8_t *region = state->buffer + state->size;
+	state->size += length;
+	return region;
+}
+
+/*
+ * This function goes back to the start of the state, ready for it to be
+ * read.
+ */
+void SaveState_rewind(SaveState *state)
+{
+	state->position = 0;
+	state->failed = false;
+}
+
+/*
+ * This function writes the state to a file, after a header describing it,
+ * with one call for the whole buffer.
+ */
+bool SaveState_saveFile(SaveState *state, const char *path)
+{
+	bool retVal = false;
+
+	// Open file
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "PhilPSX: SaveState: Couldn't open %s\n", path);
+		goto end;
+	}
+
+	// Write header, then buffer
+	int8_t header[PHILPSX_SAVESTATE_HEADER_SIZE];
+	uint32_t byteOrder = PHILPSX_SAVESTATE_BYTE_ORDER;
+	write_le_word(header, PHILPSX_SAVESTATE_MAGIC);
+	write_le_word(header + 4, PHILPSX_SAVESTATE_VERSION);
+	memcpy(header + 8, &byteOrder, sizeof(byteOrder));
+	write_le_word(header + 12, state->size);
+	if (fwrite(header, sizeof(header), 1, file) != 1 ||
+			fwrite(state->buffer, 1, state->size, file) !=
+			(size_t)state->size) {
+		fprintf(stderr, "PhilPSX: SaveState: Couldn't write to %s\n", path);
+		goto cleanup_file;
+	}
+	retVal = true;
+
+	// Cleanup path:
+	cleanup_file:
+	if (fclose(file) != 0 && retVal) {
+		fprintf(stderr, "PhilPSX: SaveState: Couldn't write to %s\n", path);
+		retVal = false;
+	}
+
+	end:
+	return retVal;
+}
+
+/*
+ * This function adds a copy of length bytes from data to the end of the
+ * state.
+ */
+void SaveState_write(SaveState *state, const void *data, int32_t length)
+{
+	int8_t *region = SaveState_reserve(state, length);
+	if (region)
+		memcpy(region, data, length);
+}
+
+/*
+ * This function makes sure the buffer can hold size bytes, doubling its
+ * capacity as needed so that repeated writes stay cheap.
+ */
+static bool SaveState_ensureCapacity(SaveState *state, int64_t size)
+{
+	if (size <= state->capacity)
+		return true;
+	if (size > INT32_MAX)
+		return false;
+
+	int64_t capacity = state->capacity;
+	while (capacity < size)
+		capacity *= 2;
+	if (capacity > INT32_MAX)
+		capacity = INT32_MAX;
+
+	int8_t *buffer = realloc(state->buffer, capacity);
+	if (!buffer) {
+		fprintf(stderr, "PhilPSX: SaveState: Couldn't allocate memory for "
+				"buffer\n");
+		return false;
+	}
+	state->buffer = buffer;
+	state->capacity = (int32_t)capacity;
+	return true;
+}
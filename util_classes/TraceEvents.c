@@ -0,0 +1,352 @@
+/*
+ * This C file models the trace events. Each thread that records an event
+ * gets its own list of chunks the first time it does so, which only it ever
+ * appends to, so recording needs no locking. A chunk's count is published
+ * with a release store after its event is filled in, and new chunks are
+ * linked on the same way, so the events can be read without stopping the
+ * threads, although they are normally written out once the threads have
+ * ended. Each thread's events are capped so a long run can't use up all of
+ * memory, after which they are counted as dropped.
+ *
+ * Events are written out in the Chrome trace event format, as complete
+ * events on a thread of the timeline each, which chrome://tracing and
+ * Perfetto can both open.
+ *
+ * TraceEvents.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../headers/TraceEvents.h"
+
+// Events in each chunk, and most chunks kept for each thread, which makes
+// for about 2 million events or 48 MB a thread
+#define PHILPSX_TRACE_CHUNK_EVENTS 16384
+#define PHILPSX_TRACE_MAX_CHUNKS 128
+
+// Longest thread name kept, including the terminator
+#define PHILPSX_TRACE_THREAD_NAME_SIZE 32
+
+/*
+ * This struct holds one event, with times in nanoseconds.
+ */
+typedef struct {
+	int64_t start;
+	int64_t duration;
+	int32_t event;
+	int32_t argument;
+} TraceEvent;
+
+/*
+ * This struct holds a chunk of one thread's events, and links to the next
+ * chunk.
+ */
+typedef struct TraceChunk TraceChunk;
+struct TraceChunk {
+	TraceEvent events[PHILPSX_TRACE_CHUNK_EVENTS];
+	int32_t count;
+	TraceChunk *next;
+};
+
+/*
+ * This struct holds one thread's chunks, and links to the thread
+ * registered before it.
+ */
+typedef struct TraceThread TraceThread;
+struct TraceThread {
+	char name[PHILPSX_TRACE_THREAD_NAME_SIZE];
+	int32_t id;
+	TraceChunk *firstChunk;
+	TraceChunk *currentChunk;
+	int32_t chunkCount;
+	int64_t droppedEvents;
+	TraceThread *next;
+};
+
+/*
+ * This struct describes each event as it is written out - its name, the
+ * category it is shown under, and what its argument is called, if it has
+ * one.
+ */
+typedef struct {
+	const char *name;
+	const char *category;
+	const char *argumentName;
+} TraceEventInfo;
+
+// Whether events are being recorded, and when recording started
+bool TraceEvents_recording = false;
+static int64_t TraceEvents_startTime = 0;
+
+// Registered threads, newest first, along with how many there are - the
+// mutex is only taken to register a thread or walk the list
+static pthread_mutex_t TraceEvents_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceThread *TraceEvents_threads = NULL;
+static int32_t TraceEvents_threadCount = 0;
+
+// The calling thread's chunks
+static _Thread_local TraceThread *TraceEvents_thread = NULL;
+
+// Event descriptions
+static const TraceEventInfo TraceEvents_info[PHILPSX_TRACE_EVENT_COUNT] = {
+	[PHILPSX_TRACE_CPU_BATCH] = {"cpu_batch", "cpu", "cycles"},
+	[PHILPSX_TRACE_DMA] = {"dma_transfer", "dma", "channel"},
+	[PHILPSX_TRACE_GPU_POLYGON] = {"gpu_polygon", "gpu", "command"},
+	[PHILPSX_TRACE_GPU_RECTANGLE] = {"gpu_rectangle", "gpu", "command"},
+	[PHILPSX_TRACE_GPU_LINE] = {"gpu_line", "gpu", "command"},
+	[PHILPSX_TRACE_GPU_FILL] = {"gpu_fill", "gpu", "command"},
+	[PHILPSX_TRACE_GPU_VRAM_COPY] = {"gpu_vram_copy", "gpu", "command"},
+	[PHILPSX_TRACE_GPU_VRAM_WRITE] = {"gpu_vram_write", "gpu", "command"},
+	[PHILPSX_TRACE_GPU_VRAM_READ] = {"gpu_vram_read", "gpu", "command"},
+	[PHILPSX_TRACE_GPU_DISPLAY] = {"gpu_display", "gpu", NULL},
+	[PHILPSX_TRACE_GPU_SYNC] = {"gpu_sync", "gpu", NULL},
+	[PHILPSX_TRACE_MEMORY_BARRIER] = {"memory_barrier", "gpu", NULL},
+	[PHILPSX_TRACE_VRAM_READ_WAIT] = {"vram_read_wait", "stall", NULL},
+	[PHILPSX_TRACE_SWAP] = {"swap", "display", NULL},
+	[PHILPSX_TRACE_CD_SECTOR] = {"cd_sector_read", "cd", "sector"},
+	[PHILPSX_TRACE_WORKQUEUE_FULL] = {"workqueue_full", "stall", "words"},
+	[PHILPSX_TRACE_WORKQUEUE_COMPLETION] =
+			{"workqueue_wait_for_completion", "stall", NULL},
+	[PHILPSX_TRACE_WORKQUEUE_IDLE] =
+			{"workqueue_wait_for_item", "stall", NULL}
+};
+
+// Forward declarations for functions private to this class
+static TraceThread *TraceEvents_registerThread(void);
+
+/*
+ * This function frees every thread's events. It must only be called once
+ * all other threads that recorded anything have ended.
+ */
+void TraceEvents_cleanup(void)
+{
+	__atomic_store_n(&TraceEvents_recording, false, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&TraceEvents_mutex);
+	TraceThread *thread = TraceEvents_threads;
+	while (thread) {
+		TraceThread *next = thread->next;
+		TraceChunk *chunk = thread->firstChunk;
+		while (chunk) {
+			TraceChunk *nextChunk = chunk->next;
+			free(chunk);
+			chunk = nextChunk;
+		}
+		free(thread);
+		thread = next;
+	}
+	TraceEvents_threads = NULL;
+	TraceEvents_threadCount = 0;
+	pthread_mutex_unlock(&TraceEvents_mutex);
+
+	TraceEvents_thread = NULL;
+}
+
+/*
+ * This function returns the current time in nanoseconds, which is never 0.
+ */
+int64_t TraceEvents_getTime(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec + 1;
+}
+
+/*
+ * This function tells the caller whether trace events were compiled in.
+ */
+bool TraceEvents_isEnabled(void)
+{
+#ifdef PHILPSX_TRACE_EVENTS
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * This function records an event on the calling thread, which started at
+ * the specified time and ends now. It should be called through
+ * PHILPSX_TRACE_END.
+ */
+void TraceEvents_record(int32_t event, int64_t start, int32_t argument)
+{
+	int64_t end = TraceEvents_getTime();
+
+	TraceThread *thread = TraceEvents_thread;
+	if (!thread && !(thread = TraceEvents_registerThread()))
+		return;
+
+	// Move on to a new chunk if this one is full, unless the thread has
+	// used up all it is allowed
+	TraceChunk *chunk = thread->currentChunk;
+	if (!chunk || chunk->count == PHILPSX_TRACE_CHUNK_EVENTS) {
+		TraceChunk *newChunk = NULL;
+		if (thread->chunkCount < PHILPSX_TRACE_MAX_CHUNKS)
+			newChunk = malloc(sizeof(TraceChunk));
+		if (!newChunk) {
+			__atomic_store_n(&thread->droppedEvents,
+					thread->droppedEvents + 1, __ATOMIC_RELAXED);
+			return;
+		}
+		newChunk->count = 0;
+		newChunk->next = NULL;
+		if (chunk)
+			__atomic_store_n(&chunk->next, newChunk, __ATOMIC_RELEASE);
+		else
+			__atomic_store_n(&thread->firstChunk, newChunk,
+					__ATOMIC_RELEASE);
+		thread->currentChunk = newChunk;
+		++thread->chunkCount;
+		chunk = newChunk;
+	}
+
+	// Fill in the event and publish it
+	TraceEvent *traceEvent = &chunk->events[chunk->count];
+	traceEvent->start = start;
+	traceEvent->duration = end - start;
+	traceEvent->event = event;
+	traceEvent->argument = argument;
+	__atomic_store_n(&chunk->count, chunk->count + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * This function names the calling thread on the timeline, registering it
+ * if it hasn't recorded anything yet. It does nothing if trace events were
+ * compiled out.
+ */
+void TraceEvents_setThreadName(const char *name)
+{
+	if (!TraceEvents_isEnabled())
+		return;
+
+	TraceThread *thread = TraceEvents_thread;
+	if (!thread && !(thread = TraceEvents_registerThread()))
+		return;
+
+	pthread_mutex_lock(&TraceEvents_mutex);
+	snprintf(thread->name, sizeof(thread->name), "%s", name);
+	pthread_mutex_unlock(&TraceEvents_mutex);
+}
+
+/*
+ * This function starts recording events, with the timeline starting from
+ * now. It returns false if trace events were compiled out.
+ */
+bool TraceEvents_start(void)
+{
+	if (!TraceEvents_isEnabled())
+		return false;
+
+	TraceEvents_startTime = TraceEvents_getTime();
+	__atomic_store_n(&TraceEvents_recording, true, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ * This function stops recording events, and writes everything recorded to
+ * the specified file as a Chrome trace. It returns false if the file
+ * couldn't be written.
+ */
+bool TraceEvents_write(const char *path)
+{
+	__atomic_store_n(&TraceEvents_recording, false, __ATOMIC_RELAXED);
+
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "PhilPSX: TraceEvents: Couldn't open %s for "
+				"writing\n", path);
+		return false;
+	}
+
+	// Write each thread's name, followed by its events
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	bool first = true;
+	int64_t eventCount = 0;
+	pthread_mutex_lock(&TraceEvents_mutex);
+	for (TraceThread *thread = TraceEvents_threads; thread;
+			thread = thread->next) {
+		fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\","
+				"\"pid\":1,\"tid\":%" PRId32 ",\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",", thread->id, thread->name);
+		first = false;
+
+		for (TraceChunk *chunk = __atomic_load_n(&thread->firstChunk,
+				__ATOMIC_ACQUIRE); chunk; chunk = __atomic_load_n(
+				&chunk->next, __ATOMIC_ACQUIRE)) {
+			int32_t count = __atomic_load_n(&chunk->count,
+					__ATOMIC_ACQUIRE);
+			for (int32_t i = 0; i < count; ++i) {
+				TraceEvent *traceEvent = &chunk->events[i];
+				const TraceEventInfo *info =
+						&TraceEvents_info[traceEvent->event];
+				int64_t start = traceEvent->start - TraceEvents_startTime;
+				if (start < 0)
+					start = 0;
+				fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\","
+						"\"ph\":\"X\",\"pid\":1,\"tid\":%" PRId32 ","
+						"\"ts\":%" PRId64 ".%03" PRId64 ",\"dur\":%" PRId64
+						".%03" PRId64, info->name, info->category, thread->id,
+						start / 1000, start % 1000,
+						traceEvent->duration / 1000,
+						traceEvent->duration % 1000);
+				if (info->argumentName &&
+						traceEvent->argument != PHILPSX_TRACE_NO_ARGUMENT)
+					fprintf(file, ",\"args\":{\"%s\":%" PRId32 "}",
+							info->argumentName, traceEvent->argument);
+				fputc('}', file);
+				++eventCount;
+			}
+		}
+
+		int64_t droppedEvents = __atomic_load_n(&thread->droppedEvents,
+				__ATOMIC_RELAXED);
+		if (droppedEvents > 0)
+			fprintf(stderr, "PhilPSX: TraceEvents: %" PRId64 " events "
+					"dropped on %s\n", droppedEvents, thread->name);
+	}
+	pthread_mutex_unlock(&TraceEvents_mutex);
+	fprintf(file, "\n]}\n");
+
+	bool retVal = !ferror(file);
+	if (fclose(file) != 0)
+		retVal = false;
+	if (retVal)
+		printf("PhilPSX: TraceEvents: %" PRId64 " events written to %s\n",
+				eventCount, path);
+	else
+		fprintf(stderr, "PhilPSX: TraceEvents: Couldn't write %s\n", path);
+	return retVal;
+}
+
+/*
+ * This function gives the calling thread its own list of chunks, named
+ * after the order it was registered in, and returns it. NULL is returned
+ * if there isn't enough memory, in which case nothing is recorded.
+ */
+static TraceThread *TraceEvents_registerThread(void)
+{
+	TraceThread *thread = calloc(1, sizeof(TraceThread));
+	if (!thread) {
+		fprintf(stderr, "PhilPSX: TraceEvents: Couldn't allocate memory "
+				"for thread events\n");
+		return NULL;
+	}
+
+	pthread_mutex_lock(&TraceEvents_mutex);
+	thread->id = TraceEvents_threadCount;
+	snprintf(thread->name, sizeof(thread->name), "thread %" PRId32,
+			TraceEvents_threadCount);
+	thread->next = TraceEvents_threads;
+	TraceEvents_threads = thread;
+	++TraceEvents_threadCount;
+	pthread_mutex_unlock(&TraceEvents_mutex);
+
+	TraceEvents_thread = thread;
+	return thread;
+}
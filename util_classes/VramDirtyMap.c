@@ -0,0 +1,237 @@
+/*
+ * This C file models a vram dirty map as a class. Each client has its own
+ * array of tile rows, held as atomic 64-bit masks so that writes can be
+ * marked on one thread (normally the rendering thread) while the client
+ * queries and clears its copy on another. Marking only touches clients that
+ * have been added, so a map with no clients costs next to nothing.
+ *
+ * Areas wider or taller than vram are clamped to its size, and areas that
+ * run off the right or bottom edge wrap around to the left or top.
+ *
+ * VramDirtyMap.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "../headers/VramDirtyMap.h"
+#include "../headers/math_utils.h"
+
+// Sizes of vram in pixels and in tiles
+#define PHILPSX_VRAMDIRTYMAP_WIDTH 1024
+#define PHILPSX_VRAMDIRTYMAP_HEIGHT 512
+#define PHILPSX_VRAMDIRTYMAP_COLUMNS 64
+
+// Operations that can be applied to an area
+#define PHILPSX_VRAMDIRTYMAP_MARK 0
+#define PHILPSX_VRAMDIRTYMAP_CLEAR 1
+#define PHILPSX_VRAMDIRTYMAP_TEST 2
+
+// Forward declarations for functions and subcomponents private to this class
+// Area stuff:
+static bool VramDirtyMap_applyToArea(VramDirtyMap *map, int32_t client,
+		int32_t operation, int32_t x, int32_t y, int32_t width,
+		int32_t height);
+static uint64_t VramDirtyMap_getColumnMask(int32_t firstColumn,
+		int32_t lastColumn);
+
+/*
+ * This struct stores the tile rows of each client, along with how many
+ * clients have been added so far.
+ */
+struct VramDirtyMap {
+	atomic_uint_least64_t rows[PHILPSX_VRAMDIRTYMAP_MAX_CLIENTS]
+			[PHILPSX_VRAMDIRTYMAP_ROWS];
+	atomic_int clientCount;
+};
+
+/*
+ * This constructs a VramDirtyMap object, which starts out with no clients.
+ */
+VramDirtyMap *construct_VramDirtyMap(void)
+{
+	// Allocate memory for struct
+	VramDirtyMap *map = calloc(1, sizeof(VramDirtyMap));
+	if (!map) {
+		fprintf(stderr, "PhilPSX: VramDirtyMap: Couldn't allocate memory for "
+				"VramDirtyMap struct\n");
+		goto end;
+	}
+
+	// Setup atomics
+	for (int32_t i = 0; i < PHILPSX_VRAMDIRTYMAP_MAX_CLIENTS; ++i)
+		for (int32_t row = 0; row < PHILPSX_VRAMDIRTYMAP_ROWS; ++row)
+			atomic_init(&map->rows[i][row], 0);
+	atomic_init(&map->clientCount, 0);
+
+	end:
+	return map;
+}
+
+/*
+ * This destructs a VramDirtyMap object.
+ */
+void destruct_VramDirtyMap(VramDirtyMap *map)
+{
+	free(map);
+}
+
+/*
+ * This function adds a client to the map, returning the number it should
+ * pass when querying or clearing, or -1 if there is no room. As the client
+ * can't know what vram held before it was added, its copy starts out fully
+ * dirty.
+ */
+int32_t VramDirtyMap_addClient(VramDirtyMap *map)
+{
+	int32_t client = atomic_load(&map->clientCount);
+	if (client == PHILPSX_VRAMDIRTYMAP_MAX_CLIENTS)
+		return -1;
+
+	for (int32_t row = 0; row < PHILPSX_VRAMDIRTYMAP_ROWS; ++row)
+		atomic_store(&map->rows[client][row], UINT64_MAX);
+	atomic_store(&map->clientCount, client + 1);
+	return client;
+}
+
+/*
+ * This function clears the whole of a client's copy of the map.
+ */
+void VramDirtyMap_clearAll(VramDirtyMap *map, int32_t client)
+{
+	for (int32_t row = 0; row < PHILPSX_VRAMDIRTYMAP_ROWS; ++row)
+		atomic_store(&map->rows[client][row], 0);
+}
+
+/*
+ * This function clears every tile a vram area touches in a client's copy of
+ * the map.
+ */
+void VramDirtyMap_clearArea(VramDirtyMap *map, int32_t client, int32_t x,
+		int32_t y, int32_t width, int32_t height)
+{
+	VramDirtyMap_applyToArea(map, client, PHILPSX_VRAMDIRTYMAP_CLEAR, x, y,
+			width, height);
+}
+
+/*
+ * This function returns one row of tiles from a client's copy of the map,
+ * with bit 0 standing for the leftmost tile.
+ */
+uint64_t VramDirtyMap_getTileRow(VramDirtyMap *map, int32_t client,
+		int32_t row)
+{
+	return atomic_load(&map->rows[client][row]);
+}
+
+/*
+ * This function tells us if any tile a vram area touches is dirty in a
+ * client's copy of the map.
+ */
+bool VramDirtyMap_isAreaDirty(VramDirtyMap *map, int32_t client, int32_t x,
+		int32_t y, int32_t width, int32_t height)
+{
+	return VramDirtyMap_applyToArea(map, client, PHILPSX_VRAMDIRTYMAP_TEST,
+			x, y, width, height);
+}
+
+/*
+ * This function marks the whole of vram as dirty for every client.
+ */
+void VramDirtyMap_markAll(VramDirtyMap *map)
+{
+	int32_t clientCount = atomic_load(&map->clientCount);
+	for (int32_t i = 0; i < clientCount; ++i)
+		for (int32_t row = 0; row < PHILPSX_VRAMDIRTYMAP_ROWS; ++row)
+			atomic_store(&map->rows[i][row], UINT64_MAX);
+}
+
+/*
+ * This function marks every tile a vram area touches as dirty for every
+ * client.
+ */
+void VramDirtyMap_markArea(VramDirtyMap *map, int32_t x, int32_t y,
+		int32_t width, int32_t height)
+{
+	if (atomic_load(&map->clientCount) == 0)
+		return;
+
+	VramDirtyMap_applyToArea(map, -1, PHILPSX_VRAMDIRTYMAP_MARK, x, y,
+			width, height);
+}
+
+/*
+ * This function applies an operation to every tile a vram area touches,
+ * splitting the area where it wraps around the edges of vram. Marking
+ * applies to every client, ignoring the client number given. It returns
+ * whether any tile was dirty when testing, and false otherwise.
+ */
+static bool VramDirtyMap_applyToArea(VramDirtyMap *map, int32_t client,
+		int32_t operation, int32_t x, int32_t y, int32_t width,
+		int32_t height)
+{
+	// Nothing to do for an empty area
+	if (width <= 0 || height <= 0)
+		return false;
+
+	// Wrap start position into vram, and clamp size to it
+	x &= PHILPSX_VRAMDIRTYMAP_WIDTH - 1;
+	y &= PHILPSX_VRAMDIRTYMAP_HEIGHT - 1;
+	width = min_value(width, PHILPSX_VRAMDIRTYMAP_WIDTH);
+	height = min_value(height, PHILPSX_VRAMDIRTYMAP_HEIGHT);
+
+	// Build column mask, including any part that wraps to the left edge
+	int32_t right = x + width - 1;
+	uint64_t mask = VramDirtyMap_getColumnMask(
+			x / PHILPSX_VRAMDIRTYMAP_TILE_SIZE,
+			min_value(right, PHILPSX_VRAMDIRTYMAP_WIDTH - 1) /
+			PHILPSX_VRAMDIRTYMAP_TILE_SIZE);
+	if (right >= PHILPSX_VRAMDIRTYMAP_WIDTH)
+		mask |= VramDirtyMap_getColumnMask(0,
+				(right - PHILPSX_VRAMDIRTYMAP_WIDTH) /
+				PHILPSX_VRAMDIRTYMAP_TILE_SIZE);
+
+	// Work out the range of rows - when the area wraps to the top edge, the
+	// rows in between are skipped
+	int32_t firstRow = y / PHILPSX_VRAMDIRTYMAP_TILE_SIZE;
+	int32_t bottom = y + height - 1;
+	int32_t lastRow = min_value(bottom, PHILPSX_VRAMDIRTYMAP_HEIGHT - 1) /
+			PHILPSX_VRAMDIRTYMAP_TILE_SIZE;
+	int32_t wrappedLastRow = -1;
+	if (bottom >= PHILPSX_VRAMDIRTYMAP_HEIGHT)
+		wrappedLastRow = (bottom - PHILPSX_VRAMDIRTYMAP_HEIGHT) /
+				PHILPSX_VRAMDIRTYMAP_TILE_SIZE;
+
+	// Apply operation to each row
+	int32_t clientCount = atomic_load(&map->clientCount);
+	for (int32_t row = 0; row < PHILPSX_VRAMDIRTYMAP_ROWS; ++row) {
+		if ((row < firstRow || row > lastRow) && row > wrappedLastRow)
+			continue;
+		switch (operation) {
+			case PHILPSX_VRAMDIRTYMAP_MARK:
+				for (int32_t i = 0; i < clientCount; ++i)
+					atomic_fetch_or(&map->rows[i][row], mask);
+				break;
+			case PHILPSX_VRAMDIRTYMAP_CLEAR:
+				atomic_fetch_and(&map->rows[client][row], ~mask);
+				break;
+			case PHILPSX_VRAMDIRTYMAP_TEST:
+				if ((atomic_load(&map->rows[client][row]) & mask) != 0)
+					return true;
+				break;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * This function builds a mask with the bits for a range of tile columns set.
+ */
+static uint64_t VramDirtyMap_getColumnMask(int32_t firstColumn,
+		int32_t lastColumn)
+{
+	return (UINT64_MAX >> (PHILPSX_VRAMDIRTYMAP_COLUMNS - 1 -
+			(lastColumn - firstColumn))) << firstColumn;
+}
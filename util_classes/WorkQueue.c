@@ -1,9 +1,15 @@
 /*
- * This C file models a work queue implementation. GpuCommand objects are
- * stored and issued from an internal array in a thread-safe manner, for
- * submission by the emulator thread and execution by the rendering thread.
- * Doing it this way means no dynamic allocations after queue creation, but
- * could lead to lower performance - this is the initial design.
+ * This C file models a work queue implementation. GPU commands are packed
+ * into an internal ring buffer of 32-bit words, for submission by the
+ * emulator thread and execution by the rendering thread. Each command is a
+ * primitive packet sized to its parameter count, preceded by state packets
+ * only when the associated GPU state has actually changed - the rendering
+ * thread keeps the current state itself, decoding each primitive into a
+ * single GpuCommand object ready for execution.
+ * 
+ * As there is exactly one producer and one consumer, the ring is managed
+ * through a pair of atomic indices - the mutex and condition variables are
+ * only touched when one side has actually gone to sleep waiting on the other.
  * 
  * It is assumed due to use case that non-init pthread functions will not fail,
  * and therefore errors are not checked with these function calls, to simplify
@@ -17,52 +23,118 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include "../headers/WorkQueue.h"
 #include "../headers/GpuCommand.h"
+#include "../headers/PerfCounters.h"
+#include "../headers/TraceEvents.h"
 
-// Queue size
-#define PHILPSX_WORKQUEUE_SIZE 2048
+// Queue size in words (must be a power of two, so indices can wrap with a
+// mask)
+#define PHILPSX_WORKQUEUE_SIZE 65536
+#define PHILPSX_WORKQUEUE_MASK (PHILPSX_WORKQUEUE_SIZE - 1)
 
-/*
- * This struct contains a locking primitive that lets us decide when the
- * contained GPU command is in use.
- */
-typedef struct GpuCommandContainer {
+// Packet types, stored in the top byte of each packet's header word - the
+// bottom byte holds the state identifier or parameter count
+#define PHILPSX_WORKQUEUE_PACKET_STATE 0
+#define PHILPSX_WORKQUEUE_PACKET_GPU 1
+#define PHILPSX_WORKQUEUE_PACKET_PRIMITIVE 2
+#define PHILPSX_WORKQUEUE_PACKET_HEADER(type, value) (((type) << 24) | (value))
 
-	// Synchronisation primitives and related variables
-	pthread_mutex_t useLock;
-	bool inUseByRenderingThread;
-	bool completed;
-	
-	// Contained object
-	GpuCommand command;
-} GpuCommandContainer;
+// Number of words needed to store a pointer in the ring (function and data
+// pointers are assumed to be the same size, as POSIX requires)
+#define PHILPSX_WORKQUEUE_POINTER_WORDS \
+		((sizeof(void *) + sizeof(int32_t) - 1) / sizeof(int32_t))
 
 /*
  * This struct models the structure of the queue, and includes synchronisation
- * primitives.
+ * primitives. The indices increase monotonically and are masked on access,
+ * so the ring is empty when they are equal.
  */
 struct WorkQueue {
 	
 	// Backing store
-	GpuCommandContainer backingStore[PHILPSX_WORKQUEUE_SIZE];
+	int32_t backingStore[PHILPSX_WORKQUEUE_SIZE];
+
+	// Ring indices - submissionMarker is only written by the emulator thread,
+	// and retrievalMarker only by the rendering thread (once the packets
+	// before it have been consumed)
+	atomic_size_t submissionMarker;
+	atomic_size_t retrievalMarker;
+
+	// Emulator thread state - packets are written at writeMarker, and only
+	// become visible when submissionMarker catches up with it, while the
+	// submitted state mirrors what the rendering thread will have seen
+	size_t writeMarker;
+	int32_t submittedState[PHILPSX_GPUCOMMAND_STATE_COUNT];
+	GPU *submittedGpu;
 
-	// Synchronisation primitives and related variables
+	// Rendering thread state - the decoded command, and how many words of
+	// the ring it occupies until returned
+	GpuCommand currentCommand;
+	size_t currentCommandLength;
+
+	// Synchronisation primitives for sleeping, and flags which say whether
+	// either side is currently (about to be) asleep
 	pthread_mutex_t queueLock;
 	pthread_cond_t waitForWorkCond;
-	size_t retrievalMarker;
-	size_t submissionMarker;
-	bool endProcessingByRenderingThread;
+	pthread_cond_t waitForSpaceCond;
+	atomic_bool renderingThreadWaiting;
+	atomic_bool emulatorThreadWaiting;
+	atomic_bool endProcessingByRenderingThread;
+};
+
+// Offsets of the state and parameter fields within a GpuCommand, indexed by
+// state identifier and parameter number respectively
+static const size_t WorkQueue_stateOffsets[PHILPSX_GPUCOMMAND_STATE_COUNT] = {
+	offsetof(GpuCommand, statusRegister),
+	offsetof(GpuCommand, drawingAreaTopLeft),
+	offsetof(GpuCommand, drawingAreaBottomRight),
+	offsetof(GpuCommand, drawingOffset),
+	offsetof(GpuCommand, textureWindow),
+	offsetof(GpuCommand, xStart),
+	offsetof(GpuCommand, yStart),
+	offsetof(GpuCommand, x1),
+	offsetof(GpuCommand, x2),
+	offsetof(GpuCommand, y1),
+	offsetof(GpuCommand, y2),
+	offsetof(GpuCommand, realHorizontalRes),
+	offsetof(GpuCommand, realVerticalRes)
 };
+static const size_t WorkQueue_parameterOffsets[
+		PHILPSX_GPUCOMMAND_MAX_PARAMETERS] = {
+	offsetof(GpuCommand, parameter1),
+	offsetof(GpuCommand, parameter2),
+	offsetof(GpuCommand, parameter3),
+	offsetof(GpuCommand, parameter4),
+	offsetof(GpuCommand, parameter5),
+	offsetof(GpuCommand, parameter6),
+	offsetof(GpuCommand, parameter7),
+	offsetof(GpuCommand, parameter8),
+	offsetof(GpuCommand, parameter9),
+	offsetof(GpuCommand, parameter10),
+	offsetof(GpuCommand, parameter11),
+	offsetof(GpuCommand, parameter12)
+};
+
+// Forward declarations for functions private to this class
+static void WorkQueue_copyFromRing(WorkQueue *wq, size_t index, void *dest,
+		size_t words);
+static void WorkQueue_copyToRing(WorkQueue *wq, const void *source,
+		size_t words);
+static void WorkQueue_publish(WorkQueue *wq);
+static void WorkQueue_reserveSpace(WorkQueue *wq, size_t words);
+static void WorkQueue_wakeThread(WorkQueue *wq, atomic_bool *waiting,
+		pthread_cond_t *cond);
 
 /*
  * This constructs a WorkQueue object.
  */
 WorkQueue *construct_WorkQueue(void)
 {
-	// Allocate memory for struct (import to use calloc here as inUse variables
-	// in GpuCommandContainer array need to be zeroed)
+	// Allocate memory for struct (important to use calloc here, as the
+	// submitted and current state need to start out identical)
 	WorkQueue *wq = calloc(1, sizeof(WorkQueue));
 	if (!wq) {
 		fprintf(stderr, "PhilPSX: WorkQueue: Couldn't allocate memory for "
@@ -77,32 +149,32 @@ WorkQueue *construct_WorkQueue(void)
 		goto cleanup_workqueue;
 	}
 	
-	// Initialise condition variable
+	// Initialise condition variables
 	if (pthread_cond_init(&wq->waitForWorkCond, NULL)) {
 		fprintf(stderr, "PhilPSX: WorkQueue: Couldn't initialise "
 				"waitForWorkCond condition variable\n");
 		goto cleanup_mutex;
 	}
-	
-	// Setup mutexes in GpuCommandContainer array
-	for (size_t i = 0; i < PHILPSX_WORKQUEUE_SIZE; ++i) {
-		if (pthread_mutex_init(&wq->backingStore[i].useLock, NULL)) {
-			fprintf(stderr, "PhilPSX: WorkQueue: Couldn't initialise mutxes "
-					"inside the backing store objects\n");
-			for (size_t j = 0; j < i; ++j)
-				pthread_mutex_destroy(&wq->backingStore[j].useLock);
-			goto cleanup_mutex;
-		}
+	if (pthread_cond_init(&wq->waitForSpaceCond, NULL)) {
+		fprintf(stderr, "PhilPSX: WorkQueue: Couldn't initialise "
+				"waitForSpaceCond condition variable\n");
+		goto cleanup_workcond;
 	}
 	
-	// Set markers
-	wq->retrievalMarker = 0;
-	wq->submissionMarker = 0;
+	// Set markers and flags
+	atomic_init(&wq->submissionMarker, 0);
+	atomic_init(&wq->retrievalMarker, 0);
+	atomic_init(&wq->renderingThreadWaiting, false);
+	atomic_init(&wq->emulatorThreadWaiting, false);
+	atomic_init(&wq->endProcessingByRenderingThread, false);
 	
 	// Normal path:
 	return wq;
 
 	// Cleanup path:
+	cleanup_workcond:
+	pthread_cond_destroy(&wq->waitForWorkCond);
+
 	cleanup_mutex:
 	pthread_mutex_destroy(&wq->queueLock);
 
@@ -120,8 +192,7 @@ WorkQueue *construct_WorkQueue(void)
 void destruct_WorkQueue(WorkQueue *wq)
 {
 	// Cleanup resources
-	for (size_t i = 0; i < PHILPSX_WORKQUEUE_SIZE; ++i)
-		pthread_mutex_destroy(&wq->backingStore[i].useLock);
+	pthread_cond_destroy(&wq->waitForSpaceCond);
 	pthread_cond_destroy(&wq->waitForWorkCond);
 	pthread_mutex_destroy(&wq->queueLock);
 	free(wq);
@@ -129,41 +200,83 @@ void destruct_WorkQueue(WorkQueue *wq)
 
 /*
  * This returns a pointer to a GpuCommand object ready to be executed. It
- * should only be called from the rendering thread.
+ * should only be called from the rendering thread. Any state packets ahead
+ * of the next primitive are applied on the way, and the primitive's packet
+ * remains owned by the rendering thread until it is handed back with
+ * WorkQueue_returnItem.
  */
 GpuCommand *WorkQueue_waitForItem(WorkQueue *wq)
 {
-	// First lock the queue mutex
-	pthread_mutex_lock(&wq->queueLock);
+	GpuCommand *command = &wq->currentCommand;
+	size_t retrievalMarker = atomic_load_explicit(&wq->retrievalMarker,
+			memory_order_relaxed);
 
-	// Now we check the next item can be fetched
-	while (wq->retrievalMarker >= wq->submissionMarker) {
-		pthread_cond_wait(&wq->waitForWorkCond, &wq->queueLock);
-		if (wq->endProcessingByRenderingThread)
-			goto end;
+	while (true) {
+		
+		// Sleep if there is no work in the queue, announcing that we are
+		// going to do so before the final check, so that the emulator thread
+		// either sees the flag or we see its packets
+		if (atomic_load_explicit(&wq->submissionMarker,
+				memory_order_acquire) == retrievalMarker) {
+			int64_t traceStart = PHILPSX_TRACE_BEGIN();
+			atomic_store(&wq->renderingThreadWaiting, true);
+			pthread_mutex_lock(&wq->queueLock);
+			while (atomic_load(&wq->submissionMarker) == retrievalMarker &&
+					!atomic_load(&wq->endProcessingByRenderingThread))
+				pthread_cond_wait(&wq->waitForWorkCond, &wq->queueLock);
+			pthread_mutex_unlock(&wq->queueLock);
+			atomic_store_explicit(&wq->renderingThreadWaiting, false,
+					memory_order_relaxed);
+			PHILPSX_TRACE_END(PHILPSX_TRACE_WORKQUEUE_IDLE, traceStart,
+					PHILPSX_TRACE_NO_ARGUMENT);
+		}
+		if (atomic_load_explicit(&wq->endProcessingByRenderingThread,
+				memory_order_relaxed))
+			return NULL;
+		
+		// Decode the next packet
+		int32_t header = wq->backingStore[
+				retrievalMarker & PHILPSX_WORKQUEUE_MASK];
+		int32_t value = header & 0xFF;
+		switch ((header >> 24) & 0xFF) {
+			case PHILPSX_WORKQUEUE_PACKET_STATE:
+				*(int32_t *)((uint8_t *)command +
+						WorkQueue_stateOffsets[value]) =
+						wq->backingStore[
+						(retrievalMarker + 1) & PHILPSX_WORKQUEUE_MASK];
+				retrievalMarker += 2;
+				break;
+			case PHILPSX_WORKQUEUE_PACKET_GPU:
+				WorkQueue_copyFromRing(wq, retrievalMarker + 1,
+						&command->gpu, PHILPSX_WORKQUEUE_POINTER_WORDS);
+				retrievalMarker += 1 + PHILPSX_WORKQUEUE_POINTER_WORDS;
+				break;
+			case PHILPSX_WORKQUEUE_PACKET_PRIMITIVE:
+				WorkQueue_copyFromRing(wq, retrievalMarker + 1,
+						&command->functionPointer,
+						PHILPSX_WORKQUEUE_POINTER_WORDS);
+				for (int32_t i = 0; i < value; ++i)
+					*(int32_t *)((uint8_t *)command +
+							WorkQueue_parameterOffsets[i]) =
+							wq->backingStore[(retrievalMarker + 1 +
+							PHILPSX_WORKQUEUE_POINTER_WORDS + i) &
+							PHILPSX_WORKQUEUE_MASK];
+				wq->currentCommandLength =
+						1 + PHILPSX_WORKQUEUE_POINTER_WORDS + value;
+				return command;
+		}
+		
+		// Release the state packet's words straight away
+		atomic_store(&wq->retrievalMarker, retrievalMarker);
+		WorkQueue_wakeThread(wq, &wq->emulatorThreadWaiting,
+				&wq->waitForSpaceCond);
 	}
-	
-	// At this point, there is work for us in the queue, fetch it
-	GpuCommandContainer *container = &wq->backingStore[wq->retrievalMarker++];
-
-	// Lock the container (this remains locked until the associated GpuCommand
-	// is returned) and set as in us
-	pthread_mutex_lock(&container->useLock);
-	container->inUseByRenderingThread = true;
-	
-	end:
-	// Unlock the queue mutex
-	pthread_mutex_unlock(&wq->queueLock);
-	
-	// Return the object to the caller
-	return wq->endProcessingByRenderingThread ? NULL : &container->command;
 }
 
 /*
- * This lets us return a GpuCommand object so that its associated container
- * can be unlocked and set as no longer in use. This should only be used
- * from the rendering thread, with objects on which the lock is already held
- * by the rendering thread.
+ * This lets us return a GpuCommand object so that its packet can be reused by
+ * the emulator thread. This should only be used from the rendering thread,
+ * with the object most recently obtained from WorkQueue_waitForItem.
  */
 void WorkQueue_returnItem(WorkQueue *wq, GpuCommand *object)
 {
@@ -171,80 +284,94 @@ void WorkQueue_returnItem(WorkQueue *wq, GpuCommand *object)
 	if (!object)
 		return;
 	
-	// Calculate container object pointer using offset
-	size_t offset = offsetof(GpuCommandContainer, command);
-	GpuCommandContainer *container =
-			(GpuCommandContainer *)((uint8_t *)object - offset);
-	
-	// Set as unused and completed, and release lock
-	container->inUseByRenderingThread = false;
-	container->completed = true;
-	pthread_mutex_unlock(&container->useLock);
+	// Release the packet, and wake the emulator thread if it is waiting for
+	// either space or the completion of this item
+	atomic_fetch_add(&wq->retrievalMarker, wq->currentCommandLength);
+	WorkQueue_wakeThread(wq, &wq->emulatorThreadWaiting,
+			&wq->waitForSpaceCond);
 }
 
 /*
- * This copies the object referenced by source to the next available slot in
- * the backing store and makes it available for processing. This should only
- * be called from the emulator thread.
+ * This packs the specified function pointer and parameters into the next
+ * available space in the backing store, along with any pending state
+ * changes, and makes them available for processing. This should only be
+ * called from the emulator thread.
  */
-void WorkQueue_addItem(WorkQueue *wq, GpuCommand *source,
+void WorkQueue_addItem(WorkQueue *wq,
+		void (*functionPointer)(GpuCommand *command), GPU *gpu,
+		const int32_t *parameters, int32_t parameterCount,
 		bool waitForCompletion)
 {
-	// First lock the queue mutex
-	recheck_end_of_queue:
-	pthread_mutex_lock(&wq->queueLock);
-	
-	// Check the submission marker isn't at the end of the list
-	if (wq->submissionMarker == PHILPSX_WORKQUEUE_SIZE) {
-		// We are at the end of the list, check rendering thread has caught up
-		if (wq->retrievalMarker != wq->submissionMarker) {
-			// Release the mutex and wakeup rendering thread
-			pthread_mutex_unlock(&wq->queueLock);
-			pthread_cond_broadcast(&wq->waitForWorkCond);
-
-			goto recheck_end_of_queue;
-		}
-
-		// Set both markers to beginning of backing store
-		wq->retrievalMarker = wq->submissionMarker = 0;
+	// Bind the GPU if it differs from the one the rendering thread has
+	if (gpu != wq->submittedGpu) {
+		int32_t header = PHILPSX_WORKQUEUE_PACKET_HEADER(
+				PHILPSX_WORKQUEUE_PACKET_GPU, 0);
+		WorkQueue_reserveSpace(wq, 1 + PHILPSX_WORKQUEUE_POINTER_WORDS);
+		WorkQueue_copyToRing(wq, &header, 1);
+		WorkQueue_copyToRing(wq, &gpu, PHILPSX_WORKQUEUE_POINTER_WORDS);
+		wq->submittedGpu = gpu;
 	}
 	
-	// Obtain lock on current container
-	GpuCommandContainer *container = &wq->backingStore[wq->submissionMarker++];
-	pthread_mutex_lock(&container->useLock);
-	
-	// Copy GpuCommand object from source to destination
-	memcpy(&container->command, source, sizeof(GpuCommand));
-	
-	// Set completion status to false
-	container->completed = false;
+	// Copy primitive packet into the ring and publish it
+	int32_t header = PHILPSX_WORKQUEUE_PACKET_HEADER(
+			PHILPSX_WORKQUEUE_PACKET_PRIMITIVE, parameterCount);
+	WorkQueue_reserveSpace(wq,
+			1 + PHILPSX_WORKQUEUE_POINTER_WORDS + parameterCount);
+	WorkQueue_copyToRing(wq, &header, 1);
+	WorkQueue_copyToRing(wq, &functionPointer,
+			PHILPSX_WORKQUEUE_POINTER_WORDS);
+	WorkQueue_copyToRing(wq, parameters, parameterCount);
+	WorkQueue_publish(wq);
+	PHILPSX_PERF_ADD(PHILPSX_PERF_WORKQUEUE_COMMANDS, 1);
+	PHILPSX_PERF_ADD(PHILPSX_PERF_WORKQUEUE_DEPTH, wq->writeMarker -
+			atomic_load_explicit(&wq->retrievalMarker, memory_order_relaxed));
 	
-	// Release lock on current container
-	pthread_mutex_unlock(&container->useLock);
-	
-	// Unlock the queue mutex and wake rendering thread (if needed)
-	pthread_mutex_unlock(&wq->queueLock);
-	pthread_cond_broadcast(&wq->waitForWorkCond);
-	
-	// If it is required to wait for the completion of this GpuCommand object,
-	// do so here
-	while (waitForCompletion) {
-		begin_check:
-		pthread_mutex_lock(&container->useLock);
-		
-		// Check if object has been processed yet
-		if (!container->completed) {
-			// Object not processed yet, unlock mutex and try again
-			pthread_mutex_unlock(&container->useLock);
-			goto begin_check;
-		} else {
-			// Object processed, unlock mutex and end loop
-			pthread_mutex_unlock(&container->useLock);
-			break;
-		}
+	// If it is required to wait for the completion of this command, do so
+	// here - it is complete once the retrieval marker has moved past it
+	size_t endMarker = wq->writeMarker;
+	if (waitForCompletion && atomic_load_explicit(&wq->retrievalMarker,
+			memory_order_acquire) != endMarker) {
+#ifdef PHILPSX_PERF_COUNTERS
+		int64_t stallStart = PerfCounters_getTime();
+#endif
+		int64_t traceStart = PHILPSX_TRACE_BEGIN();
+		atomic_store(&wq->emulatorThreadWaiting, true);
+		pthread_mutex_lock(&wq->queueLock);
+		while (atomic_load(&wq->retrievalMarker) != endMarker)
+			pthread_cond_wait(&wq->waitForSpaceCond, &wq->queueLock);
+		pthread_mutex_unlock(&wq->queueLock);
+		atomic_store_explicit(&wq->emulatorThreadWaiting, false,
+				memory_order_relaxed);
+		PHILPSX_PERF_ADD(PHILPSX_PERF_WORKQUEUE_STALLS, 1);
+		PHILPSX_PERF_ADD(PHILPSX_PERF_WORKQUEUE_STALL_NS,
+				PerfCounters_getTime() - stallStart);
+		PHILPSX_TRACE_END(PHILPSX_TRACE_WORKQUEUE_COMPLETION, traceStart,
+				PHILPSX_TRACE_NO_ARGUMENT);
 	}
 }
 
+/*
+ * This records a change to one of the state fields seen by commands on the
+ * rendering thread. A state packet is only written if the value actually
+ * differs from what was last submitted, and it becomes visible along with
+ * the next command. This should only be called from the emulator thread.
+ */
+void WorkQueue_setState(WorkQueue *wq, int32_t state, int32_t value)
+{
+	// Check the value has changed
+	if (wq->submittedState[state] == value)
+		return;
+	wq->submittedState[state] = value;
+	
+	// Copy state packet into the ring
+	int32_t packet[2] = {
+		PHILPSX_WORKQUEUE_PACKET_HEADER(PHILPSX_WORKQUEUE_PACKET_STATE, state),
+		value
+	};
+	WorkQueue_reserveSpace(wq, 2);
+	WorkQueue_copyToRing(wq, packet, 2);
+}
+
 /*
  * This marks the work queue to say no further processing should be done,
  * and wakes the rendering thread, allowing the program to end cleanly. This
@@ -252,15 +379,99 @@ void WorkQueue_addItem(WorkQueue *wq, GpuCommand *source,
  */
 void WorkQueue_endProcessingByRenderingThread(WorkQueue *wq)
 {
-	// First lock the queue mutex
-	pthread_mutex_lock(&wq->queueLock);
-	
 	// Set work queue mode
-	wq->endProcessingByRenderingThread = true;
+	atomic_store(&wq->endProcessingByRenderingThread, true);
 	
-	// Unlock the queue mutex
+	// Wake rendering thread unconditionally
+	pthread_mutex_lock(&wq->queueLock);
+	pthread_cond_broadcast(&wq->waitForWorkCond);
 	pthread_mutex_unlock(&wq->queueLock);
+}
+
+/*
+ * This function copies the specified number of words out of the ring,
+ * starting at the specified index and wrapping round as needed.
+ */
+static void WorkQueue_copyFromRing(WorkQueue *wq, size_t index, void *dest,
+		size_t words)
+{
+	uint8_t *destBytes = dest;
+	for (size_t i = 0; i < words; ++i)
+		memcpy(destBytes + i * sizeof(int32_t),
+				&wq->backingStore[(index + i) & PHILPSX_WORKQUEUE_MASK],
+				sizeof(int32_t));
+}
+
+/*
+ * This function copies the specified number of words into the ring at the
+ * write marker, wrapping round as needed. Space must already have been
+ * reserved with WorkQueue_reserveSpace.
+ */
+static void WorkQueue_copyToRing(WorkQueue *wq, const void *source,
+		size_t words)
+{
+	const uint8_t *sourceBytes = source;
+	for (size_t i = 0; i < words; ++i)
+		memcpy(&wq->backingStore[wq->writeMarker++ & PHILPSX_WORKQUEUE_MASK],
+				sourceBytes + i * sizeof(int32_t), sizeof(int32_t));
+}
+
+/*
+ * This function makes everything written up to the write marker visible to
+ * the rendering thread, waking it if it is asleep.
+ */
+static void WorkQueue_publish(WorkQueue *wq)
+{
+	atomic_store(&wq->submissionMarker, wq->writeMarker);
+	WorkQueue_wakeThread(wq, &wq->renderingThreadWaiting,
+			&wq->waitForWorkCond);
+}
+
+/*
+ * This function waits until the specified number of words are free beyond
+ * the write marker. Anything already written is published first, as the
+ * rendering thread can't free space it hasn't been given.
+ */
+static void WorkQueue_reserveSpace(WorkQueue *wq, size_t words)
+{
+	if (wq->writeMarker + words - atomic_load_explicit(&wq->retrievalMarker,
+			memory_order_acquire) <= PHILPSX_WORKQUEUE_SIZE)
+		return;
 	
-	// Wake rendering thread (if needed)
-	pthread_cond_broadcast(&wq->waitForWorkCond);
+	WorkQueue_publish(wq);
+#ifdef PHILPSX_PERF_COUNTERS
+	int64_t stallStart = PerfCounters_getTime();
+#endif
+	int64_t traceStart = PHILPSX_TRACE_BEGIN();
+	atomic_store(&wq->emulatorThreadWaiting, true);
+	pthread_mutex_lock(&wq->queueLock);
+	while (wq->writeMarker + words - atomic_load(&wq->retrievalMarker) >
+			PHILPSX_WORKQUEUE_SIZE)
+		pthread_cond_wait(&wq->waitForSpaceCond, &wq->queueLock);
+	pthread_mutex_unlock(&wq->queueLock);
+	atomic_store_explicit(&wq->emulatorThreadWaiting, false,
+			memory_order_relaxed);
+	PHILPSX_PERF_ADD(PHILPSX_PERF_WORKQUEUE_STALLS, 1);
+	PHILPSX_PERF_ADD(PHILPSX_PERF_WORKQUEUE_STALL_NS,
+			PerfCounters_getTime() - stallStart);
+	PHILPSX_TRACE_END(PHILPSX_TRACE_WORKQUEUE_FULL, traceStart,
+			(int32_t)words);
+}
+
+/*
+ * This function wakes the thread sleeping on the specified condition variable,
+ * but only if its waiting flag says it is (about to be) asleep. The lock is
+ * taken so the wakeup cannot fall between the sleeper's final check of the
+ * indices and it actually waiting. The sequentially consistent ordering of
+ * the index update before this and the flag store by the sleeper guarantees
+ * at least one side sees the other.
+ */
+static void WorkQueue_wakeThread(WorkQueue *wq, atomic_bool *waiting,
+		pthread_cond_t *cond)
+{
+	if (atomic_load(waiting)) {
+		pthread_mutex_lock(&wq->queueLock);
+		pthread_cond_signal(cond);
+		pthread_mutex_unlock(&wq->queueLock);
+	}
 }